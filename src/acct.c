@@ -28,7 +28,7 @@
 #include "bgp/bgp.h"
 
 /* functions */
-struct acc *search_accounting_structure(struct primitives_ptrs *prim_ptrs)
+unsigned int hash_accounting_structure(struct primitives_ptrs *prim_ptrs)
 {
   struct pkt_data *data = prim_ptrs->data;
   struct pkt_primitives *addr = &data->primitives;
@@ -38,9 +38,7 @@ struct acc *search_accounting_structure(struct primitives_ptrs *prim_ptrs)
   struct pkt_mpls_primitives *pmpls = prim_ptrs->pmpls;
   struct pkt_tunnel_primitives *ptun = prim_ptrs->ptun;
   char *pcust = prim_ptrs->pcust;
-  struct pkt_vlen_hdr_primitives *pvlen = prim_ptrs->pvlen;
-  struct acc *elem_acc;
-  unsigned int hash, pos;
+  unsigned int hash;
   unsigned int pp_size = sizeof(struct pkt_primitives); 
   unsigned int pb_size = sizeof(struct pkt_bgp_primitives);
   unsigned int plb_size = sizeof(struct pkt_legacy_bgp_primitives);
@@ -57,6 +55,16 @@ struct acc *search_accounting_structure(struct primitives_ptrs *prim_ptrs)
   if (ptun) hash ^= cache_crc32((unsigned char *)ptun, pt_size);
   if (pcust && pc_size) hash ^= cache_crc32((unsigned char *)pcust, pc_size);
   // if (pvlen) hash ^= cache_crc32((unsigned char *)pvlen, (PvhdrSz + pvlen->tot_len));
+
+  return hash;
+}
+
+struct acc *search_accounting_structure(struct primitives_ptrs *prim_ptrs)
+{
+  struct acc *elem_acc;
+  unsigned int hash, pos;
+
+  hash = hash_accounting_structure(prim_ptrs);
   pos = hash % config.buckets;
 
   Log(LOG_DEBUG, "DEBUG ( %s/%s ): Selecting bucket %u.\n", config.name, config.type, pos);
@@ -136,9 +144,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
   unsigned char *elem, *new_elem;
   int solved = FALSE;
   unsigned int hash, pos;
-  unsigned int pp_size = sizeof(struct pkt_primitives);
   unsigned int pb_size = sizeof(struct pkt_bgp_primitives);
-  unsigned int plb_size = sizeof(struct pkt_legacy_bgp_primitives);
   unsigned int pn_size = sizeof(struct pkt_nat_primitives);
   unsigned int pm_size = sizeof(struct pkt_mpls_primitives);
   unsigned int pt_size = sizeof(struct pkt_tunnel_primitives);
@@ -174,14 +180,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
 
   elem = a;
 
-  hash = cache_crc32((unsigned char *)addr, pp_size);
-  if (pbgp) hash ^= cache_crc32((unsigned char *)pbgp, pb_size);
-  if (plbgp) hash ^= cache_crc32((unsigned char *)plbgp, plb_size);
-  if (pnat) hash ^= cache_crc32((unsigned char *)pnat, pn_size);
-  if (pmpls) hash ^= cache_crc32((unsigned char *)pmpls, pm_size);
-  if (ptun) hash ^= cache_crc32((unsigned char *)ptun, pt_size);
-  if (pcust && pc_size) hash ^= cache_crc32((unsigned char *)pcust, pc_size);
-  // if (pvlen) hash ^= cache_crc32((unsigned char *)pvlen, (PvhdrSz + pvlen->tot_len));
+  hash = hash_accounting_structure(prim_ptrs);
   pos = hash % config.buckets;
       
   Log(LOG_DEBUG, "DEBUG ( %s/%s ): Selecting bucket %u.\n", config.name, config.type, pos);
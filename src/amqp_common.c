@@ -236,14 +236,18 @@ int p_amqp_connect_to_publish(struct p_amqp_host *amqp_host)
 
 int p_amqp_publish_string(struct p_amqp_host *amqp_host, char *json_str)
 {
+  struct timespec stats_ts;
+
   if (p_amqp_is_alive(amqp_host) == ERR) {
     p_amqp_close(amqp_host, TRUE);
     return ERR;
   }
 
+  STATS_START(stats_ts);
   amqp_host->status = amqp_basic_publish(amqp_host->conn, 1, amqp_cstring_bytes(amqp_host->exchange),
 					 amqp_cstring_bytes(amqp_host->routing_key), 0, 0, &amqp_host->msg_props,
 					 amqp_cstring_bytes(json_str));
+  STATS_STOP(STATS_WRITE, stats_ts);
 
   if (amqp_host->status) {
     Log(LOG_ERR, "ERROR ( %s/%s ): Connection failed to RabbitMQ: p_amqp_publish_string() [E=%s RK=%s DM=%u]\n",
@@ -349,3 +353,24 @@ int write_and_free_json_amqp(void *amqp_log, void *obj)
   if (config.debug) Log(LOG_DEBUG, "DEBUG ( %s/%s ): write_and_free_json_amqp(): JSON object not created due to missing --enable-jansson\n", config.name, config.type);
 }
 #endif
+
+int write_binary_amqp(void *amqp_log, void *obj, u_int32_t len)
+{
+  char *orig_amqp_routing_key = NULL, dyn_amqp_routing_key[SRVBUFLEN];
+  struct p_amqp_host *alog = (struct p_amqp_host *) amqp_log;
+  int ret = ERR;
+
+  if (obj && len) {
+    if (alog->rk_rr.max) {
+      orig_amqp_routing_key = p_amqp_get_routing_key(alog);
+      P_handle_table_dyn_rr(dyn_amqp_routing_key, SRVBUFLEN, orig_amqp_routing_key, &alog->rk_rr);
+      p_amqp_set_routing_key(alog, dyn_amqp_routing_key);
+    }
+
+    ret = p_amqp_publish_binary(alog, obj, len);
+
+    if (alog->rk_rr.max) p_amqp_set_routing_key(alog, orig_amqp_routing_key);
+  }
+
+  return ret;
+}
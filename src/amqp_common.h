@@ -93,6 +93,7 @@ EXT void p_amqp_close(struct p_amqp_host *, int);
 EXT int p_amqp_is_alive(struct p_amqp_host *);
 
 EXT int write_and_free_json_amqp(void *, void *);
+EXT int write_binary_amqp(void *, void *, u_int32_t);
 
 /* global vars */
 EXT struct p_amqp_host amqpp_amqp_host;
@@ -0,0 +1,117 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#define __ARENA_C
+
+/* includes */
+#include "pmacct.h"
+
+#define ARENA_HDR_LEN ((sizeof(struct pm_arena_chunk) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+/* Functions */
+static struct pm_arena_chunk *pm_arena_chunk_new(size_t size)
+{
+  struct pm_arena_chunk *chunk;
+
+  chunk = malloc(ARENA_HDR_LEN + size);
+  if (!chunk) return NULL;
+
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+
+  return chunk;
+}
+
+void pm_arena_init(struct pm_arena *arena, size_t chunk_size)
+{
+  memset(arena, 0, sizeof(struct pm_arena));
+
+  if (!chunk_size) chunk_size = ARENA_DEFAULT_CHUNK;
+  arena->chunk_size = chunk_size;
+}
+
+void *pm_arena_alloc(struct pm_arena *arena, size_t len)
+{
+  struct pm_arena_chunk *chunk;
+  size_t size;
+  void *ptr;
+
+  if (!arena->chunk_size) pm_arena_init(arena, 0);
+
+  len = (len + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+  if (!len) len = ARENA_ALIGN;
+
+  chunk = arena->head;
+  if (!chunk || (chunk->size - chunk->used) < len) {
+    size = arena->chunk_size;
+    if (size < len) size = len;
+
+    chunk = pm_arena_chunk_new(size);
+    if (!chunk) return NULL;
+
+    chunk->next = arena->head;
+    arena->head = chunk;
+  }
+
+  ptr = ((char *) chunk) + ARENA_HDR_LEN + chunk->used;
+  chunk->used += len;
+
+  return ptr;
+}
+
+void pm_arena_reset(struct pm_arena *arena)
+{
+  struct pm_arena_chunk *chunk, *next;
+  size_t total = 0;
+
+  if (!arena->head) return;
+
+  for (chunk = arena->head; chunk; chunk = chunk->next) total += chunk->used;
+  if (total > arena->peak) arena->peak = total;
+
+  if (!arena->head->next) {
+    arena->head->used = 0;
+    return;
+  }
+
+  /* burst spilled over: consolidate into a single, larger chunk */
+  for (chunk = arena->head; chunk; chunk = next) {
+    next = chunk->next;
+    free(chunk);
+  }
+  arena->head = NULL;
+
+  if (arena->peak > arena->chunk_size) arena->chunk_size = arena->peak;
+  arena->head = pm_arena_chunk_new(arena->chunk_size);
+}
+
+void pm_arena_destroy(struct pm_arena *arena)
+{
+  struct pm_arena_chunk *chunk, *next;
+
+  for (chunk = arena->head; chunk; chunk = next) {
+    next = chunk->next;
+    free(chunk);
+  }
+
+  memset(arena, 0, sizeof(struct pm_arena));
+}
@@ -0,0 +1,60 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+/* defines */
+#define ARENA_DEFAULT_CHUNK	65536 /* bytes */
+#define ARENA_ALIGN		8
+
+/* structures */
+struct pm_arena_chunk {
+  struct pm_arena_chunk *next;
+  size_t size;
+  size_t used;
+};
+
+/*
+   Bump allocator for short-lived scratch objects: allocations are never
+   freed one by one, the whole arena is rewound with pm_arena_reset().
+   When a burst spilled into extra chunks, reset folds them back into a
+   single chunk large enough for it, so steady state does no malloc().
+*/
+struct pm_arena {
+  struct pm_arena_chunk *head;
+  size_t chunk_size;
+  size_t peak;
+};
+
+/* prototypes */
+#if (!defined __ARENA_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT void pm_arena_init(struct pm_arena *, size_t);
+EXT void *pm_arena_alloc(struct pm_arena *, size_t);
+EXT void pm_arena_reset(struct pm_arena *);
+EXT void pm_arena_destroy(struct pm_arena *);
+#undef EXT
+
+#endif /* _ARENA_H_ */
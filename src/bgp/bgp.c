@@ -57,6 +57,9 @@ void nfacctd_bgp_wrapper()
 
 void skinny_bgp_daemon()
 {
+  if (config.nfacctd_bgp_cpu_affinity) pm_set_placement(config.nfacctd_bgp_cpu_affinity, config.numa_bind, config.name, "core/BGP");
+  stats_set_worker("bgp");
+
   if (config.nfacctd_bgp == BGP_DAEMON_ONLINE)
     skinny_bgp_daemon_online();
   else if (config.nfacctd_bgp == BGP_DAEMON_OFFLINE)
@@ -82,7 +85,7 @@ void skinny_bgp_daemon_online()
   time_t now, dump_refresh_deadline;
   struct hosts_table allow;
   struct bgp_md5_table bgp_md5;
-  struct timeval dump_refresh_timeout, *drt_ptr;
+  struct timeval dump_refresh_timeout, batch_timeout, *drt_ptr;
   struct bgp_peer_batch bp_batch;
 
   /* select() stuff */
@@ -132,14 +135,19 @@ void skinny_bgp_daemon_online()
   }
 
   if (!config.nfacctd_bgp_max_peers) config.nfacctd_bgp_max_peers = MAX_BGP_PEERS_DEFAULT;
-  Log(LOG_INFO, "INFO ( %s/%s ): maximum BGP peers allowed: %d\n", config.name, bgp_misc_db->log_str, config.nfacctd_bgp_max_peers);
-
-  peers = malloc(config.nfacctd_bgp_max_peers*sizeof(struct bgp_peer));
+  if (config.nfacctd_bgp_max_peers_limit < config.nfacctd_bgp_max_peers)
+    config.nfacctd_bgp_max_peers_limit = config.nfacctd_bgp_max_peers;
+  bgp_misc_db->max_peers = config.nfacctd_bgp_max_peers;
+  bgp_misc_db->max_peers_limit = config.nfacctd_bgp_max_peers_limit;
+  Log(LOG_INFO, "INFO ( %s/%s ): maximum BGP peers allowed: %d (limit: %d)\n", config.name, bgp_misc_db->log_str,
+      config.nfacctd_bgp_max_peers, config.nfacctd_bgp_max_peers_limit);
+
+  peers = bgp_peers_table_reserve(sizeof(struct bgp_peer), config.nfacctd_bgp_max_peers_limit);
   if (!peers) {
     Log(LOG_ERR, "ERROR ( %s/%s ): Unable to malloc() BGP peers structure. Terminating thread.\n", config.name, bgp_misc_db->log_str);
     exit_all(1);
   }
-  memset(peers, 0, config.nfacctd_bgp_max_peers*sizeof(struct bgp_peer));
+  bgp_peers_idx_init(bgp_misc_db, peers, sizeof(struct bgp_peer), 0, config.nfacctd_bgp_max_peers_limit);
 
   if (config.nfacctd_bgp_msglog_file || config.nfacctd_bgp_msglog_amqp_routing_key || config.nfacctd_bgp_msglog_kafka_topic) {
     if (config.nfacctd_bgp_msglog_file) bgp_misc_db->msglog_backend_methods++;
@@ -151,12 +159,11 @@ void skinny_bgp_daemon_online()
       exit_all(1);
     }
 
-    bgp_misc_db->peers_log = malloc(config.nfacctd_bgp_max_peers*sizeof(struct bgp_peer_log));
+    bgp_misc_db->peers_log = bgp_peers_table_reserve(sizeof(struct bgp_peer_log), config.nfacctd_bgp_max_peers_limit);
     if (!bgp_misc_db->peers_log) {
       Log(LOG_ERR, "ERROR ( %s/%s ): Unable to malloc() BGP peers log structure. Terminating thread.\n", config.name, bgp_misc_db->log_str);
       exit_all(1);
     }
-    memset(bgp_misc_db->peers_log, 0, config.nfacctd_bgp_max_peers*sizeof(struct bgp_peer_log));
     bgp_peer_log_seq_init(&bgp_misc_db->log_seq);
 
     if (config.nfacctd_bgp_msglog_amqp_routing_key) {
@@ -380,6 +387,8 @@ void skinny_bgp_daemon_online()
     }
     else drt_ptr = NULL;
 
+    drt_ptr = bgp_peer_log_batch_timeout(FUNC_TYPE_BGP, drt_ptr, &batch_timeout);
+
     select_num = select(select_fd, &read_descs, NULL, NULL, drt_ptr);
     if (select_num < 0) goto select_again;
     now = time(NULL);
@@ -413,6 +422,7 @@ void skinny_bgp_daemon_online()
     if (bgp_misc_db->msglog_backend_methods || bgp_misc_db->dump_backend_methods) {
       gettimeofday(&bgp_misc_db->log_tstamp, NULL);
       compose_timestamp(bgp_misc_db->log_tstamp_str, SRVBUFLEN, &bgp_misc_db->log_tstamp, TRUE, config.timestamps_since_epoch);
+      bgp_peer_log_batch_flush_expired(FUNC_TYPE_BGP);
 
       if (bgp_misc_db->dump_backend_methods) {
 	while (bgp_misc_db->log_tstamp.tv_sec > dump_refresh_deadline) {
@@ -510,6 +520,24 @@ void skinny_bgp_daemon_online()
 	/* XXX: replenish sessions with expired keepalives */
       }
 
+      /* table full: grow it, the first new slot is then free */
+      if (!peer && peers_idx == config.nfacctd_bgp_max_peers && bgp_peers_table_grow(bgp_misc_db, &config.nfacctd_bgp_max_peers)) {
+        if (bgp_batch_is_admitted(&bp_batch, now)) {
+          peer = &peers[peers_idx];
+          if (bgp_peer_init(peer, FUNC_TYPE_BGP)) peer = NULL;
+          else recalc_fds = TRUE;
+
+          if (bgp_batch_is_enabled(&bp_batch) && peer) {
+            if (bgp_batch_is_expired(&bp_batch, now)) bgp_batch_reset(&bp_batch, now);
+            if (bgp_batch_is_not_empty(&bp_batch)) bgp_batch_decrease_counter(&bp_batch);
+          }
+        }
+        else {
+          close(fd);
+          goto read_data;
+        }
+      }
+
       if (!peer) {
 	/* We briefly accept the new connection to be able to drop it */
         Log(LOG_ERR, "ERROR ( %s/%s ): Insufficient number of BGP peers has been configured by 'bgp_daemon_max_peers' (%d).\n",
@@ -532,6 +560,7 @@ void skinny_bgp_daemon_online()
 	peer->tcp_port = ntohs(((struct sockaddr_in6 *)&client)->sin6_port);
       }
 #endif
+      bgp_peers_idx_add(bgp_misc_db, peer, BGP_PEERS_IDX_ADDR);
 
       if (bgp_misc_db->msglog_backend_methods)
 	bgp_peer_log_init(peer, config.nfacctd_bgp_msglog_output, FUNC_TYPE_BGP);
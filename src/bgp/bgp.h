@@ -104,8 +104,31 @@ struct bgp_rt_structs {
   struct bgp_table *rib[AFI_MAX][SAFI_MAX];
 };
 
+/* UPDATE attribute parsing counters, reported on SIGUSR1 */
+struct bgp_attr_parse_stats {
+  u_int64_t updates;
+  u_int64_t intern_hits;
+  u_int64_t intern_misses;
+  u_int64_t allocs;	/* heap allocations made when interning new attributes */
+};
+
+/* hash index over a peers table, keyed by peer address and BGP ID */
+#define BGP_PEERS_IDX_ADDR	0
+#define BGP_PEERS_IDX_ID	1
+#define BGP_PEERS_IDX_KEYS	2
+
+struct bgp_peers_idx {
+  u_int32_t *buckets;	/* chain head per bucket: slot * BGP_PEERS_IDX_KEYS + key + 1; 0 = empty */
+  u_int32_t mask;
+  char *base;		/* peers[] or bmp_peers[] */
+  size_t stride;
+  size_t offset;	/* of the struct bgp_peer within each table element */
+  u_int32_t max;	/* slots reserved at base */
+};
+
 struct bgp_misc_structs {
   struct bgp_peer_log *peers_log;
+  struct bgp_peers_idx peers_idx;
   u_int64_t log_seq;
   struct timeval log_tstamp;
   char log_tstamp_str[SRVBUFLEN];
@@ -124,6 +147,7 @@ struct bgp_misc_structs {
 #endif
   
   int max_peers;
+  int max_peers_limit; /* peers table may grow up to this */
   char *neighbors_file;
   char *dump_file;
   char *dump_amqp_routing_key;
@@ -136,6 +160,15 @@ struct bgp_misc_structs {
   int msglog_amqp_routing_key_rr;
   char *msglog_kafka_topic;
   int msglog_kafka_topic_rr;
+  int msglog_batch_size;
+  int msglog_batch_interval;
+  u_int32_t msglog_batch_pending;
+  struct timeval msglog_batch_deadline;
+  struct pm_jsonbuf log_jb;	/* msglog/dump records are serialized here */
+  struct pm_arena attr_arena;	/* scratch for attributes of the UPDATE being parsed */
+  struct bgp_attr_parse_stats attr_stats;
+
+  /* JSON extras are appended to a struct pm_jsonbuf with an open object */
   void (*bgp_peer_log_msg_extras)(struct bgp_peer *, int, void *);
   void (*bgp_peer_logdump_initclose_extras)(struct bgp_peer *, int, void *);
 
@@ -191,6 +224,9 @@ struct bgp_peer {
   struct bgp_peer_stats stats;
   struct bgp_peer_buf buf;
   struct bgp_peer_log *log;
+  u_int32_t idx_next[BGP_PEERS_IDX_KEYS];
+  u_int32_t idx_bucket[BGP_PEERS_IDX_KEYS];
+  u_int8_t idx_linked;
 
   /*
      bmp_peer.self.bmp_se:		pointer to struct bmp_dump_se_ll
@@ -721,14 +721,19 @@ aspath_hash_alloc (void *arg)
   return aspath;
 }
 
-/* parse as-segment in struct assegment */
+/* parse as-segment in struct assegment. Segments and ASNs are carved
+ * out of the parse arena and normalised on the fly: ASNs are laid out
+ * back to back, so merging a run of AS_SEQUENCEs just extends the previous
+ * segment, as long as ASSEGMENTS_PACKABLE() holds, ie. within
+ * AS_SEGMENT_MAX ASNs; SET segments are sorted and weeded of dupes in place.
+ */
 static struct assegment *
-assegments_parse(char *s, size_t length, int use32bit)
+assegments_parse(struct pm_arena *arena, char *s, size_t length, int use32bit)
 {
   struct assegment_header segh;
   struct assegment *seg, *prev = NULL, *head = NULL;
   size_t bytes = 0, aspathlen;
-  u_char *tmp8;
+  as_t *cursor;
   u_int16_t tmp16;
   u_int32_t tmp32;
 
@@ -738,6 +743,10 @@ assegments_parse(char *s, size_t length, int use32bit)
   /* basic checks; XXX: length? */
   if (length % AS16_VALUE_SIZE) return NULL;
 
+  /* upper bound to the ASNs the attribute can carry */
+  cursor = pm_arena_alloc(arena, (length / AS16_VALUE_SIZE) * sizeof(as_t));
+  if (!cursor) return NULL;
+
   aspathlen = length;
   
   while (aspathlen > 0) {
@@ -745,8 +754,9 @@ assegments_parse(char *s, size_t length, int use32bit)
       int seg_size;
 
       /* softly softly, get the header first on its own */
-      tmp8 = (u_char *) s; segh.type = *tmp8; s++;
-      tmp8 = (u_char *) s; segh.length = *tmp8; s++;
+      segh.type = (u_char) s[0];
+      segh.length = (u_char) s[1];
+      s += 2;
       
       seg_size = ASSEGMENT_SIZE(segh.length, use32bit);
 
@@ -756,27 +766,50 @@ assegments_parse(char *s, size_t length, int use32bit)
           || (segh.length == 0) 
           /* Paranoia in case someone changes type of segment length */
           || ((sizeof(segh.length) > 1) && (segh.length > AS_SEGMENT_MAX)) )
-        {
-          if (head)
-            assegment_free_all (head);
-          return NULL;
-        }
+        return NULL;
       
       /* now its safe to trust lengths */
-      seg = assegment_new (segh.type, segh.length);
-      
-      if (head)
-        prev->next = seg;
-      else /* it's the first segment */
-        head = prev = seg;
+      if (prev && ASSEGMENTS_PACKABLE(prev, &segh))
+        seg = prev;
+      else {
+        seg = pm_arena_alloc(arena, sizeof(struct assegment));
+        if (!seg) return NULL;
+
+        memset(seg, 0, sizeof(struct assegment));
+        seg->type = segh.type;
+        seg->as = cursor;
+
+        if (head) prev->next = seg;
+        else head = seg;
+      }
       
       for (i = 0; i < segh.length; i++) {
-		if (use32bit) {
-		  memcpy(&tmp32, s, 4); seg->as[i] = ntohl(tmp32); s += 4;
-		}
-		else {
-		  memcpy(&tmp16, s, 2); seg->as[i] = ntohs(tmp16); s += 2;
-		}
+	if (use32bit) {
+	  memcpy(&tmp32, s, 4); cursor[i] = ntohl(tmp32); s += 4;
+	}
+	else {
+	  memcpy(&tmp16, s, 2); cursor[i] = ntohs(tmp16); s += 2;
+	}
+      }
+
+      seg->length += segh.length;
+      cursor += segh.length;
+
+      /* Sort values SET segments, see assegment_normalise() */
+      if (seg->type == AS_SET || seg->type == AS_CONFED_SET) {
+	int tail = 0;
+
+	qsort (seg->as, seg->length, sizeof(as_t), int_cmp);
+
+	for (i = 1; i < seg->length; i++) {
+	  if (seg->as[tail] == seg->as[i]) continue;
+
+	  tail++;
+	  if (tail < i) seg->as[tail] = seg->as[i];
+	}
+
+	seg->length = tail + 1;
+	cursor = seg->as + seg->length;
       }
 	  
       bytes += seg_size;
@@ -784,22 +817,27 @@ assegments_parse(char *s, size_t length, int use32bit)
       prev = seg;
     }
  
-  return assegment_normalise (head);
+  return head;
 }
 
 /* AS path parse function. If there is same AS path in the the AS
-   path hash then return it else make new AS path structure. */
+   path hash then return it else make new AS path structure. The
+   lookup is done on the arena-backed copy, so that heap memory is
+   only touched for paths not seen before. */
 struct aspath *aspath_parse(struct bgp_peer *peer, char *s, size_t length, int use32bit)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
+  struct bgp_misc_structs *bms;
+  struct assegment *seg;
   struct aspath as;
   struct aspath *find;
 
   if (!peer) return NULL;
 
   inter_domain_routing_db = bgp_select_routing_db(peer->type);
+  bms = bgp_select_misc_db(peer->type);
 
-  if (!inter_domain_routing_db) return NULL;
+  if (!inter_domain_routing_db || !bms) return NULL;
 
   /* If length is odd it's malformed AS path. */
   /* Nit-picking: if (use32bit == 0) it is malformed if odd,
@@ -810,20 +848,25 @@ struct aspath *aspath_parse(struct bgp_peer *peer, char *s, size_t length, int u
   if (length % AS16_VALUE_SIZE ) return NULL;
 
   memset (&as, 0, sizeof (struct aspath));
-  as.segments = assegments_parse(s, length, use32bit);
+  as.segments = assegments_parse(&bms->attr_arena, s, length, use32bit);
   
   /* If already same aspath exist then return it. */
-  find = hash_get (peer, inter_domain_routing_db->ashash, &as, aspath_hash_alloc);
-  
-  /* aspath_hash_alloc dupes segments too. that probably could be
-   * optimised out.
-   */
-  assegment_free_all (as.segments);
-  if (as.str)
-    free(as.str);
-  
-  if (! find)
-    return NULL;
+  find = hash_get (peer, inter_domain_routing_db->ashash, &as, NULL);
+
+  if (find) bms->attr_stats.intern_hits++;
+  else {
+    find = aspath_hash_alloc (&as);
+    if (! find)
+      return NULL;
+
+    hash_get (peer, inter_domain_routing_db->ashash, find, hash_alloc_intern);
+
+    /* aspath, string and hash backet, plus segment and ASNs each */
+    bms->attr_stats.intern_misses++;
+    bms->attr_stats.allocs += 3;
+    for (seg = find->segments; seg; seg = seg->next) bms->attr_stats.allocs += 2;
+  }
+
   find->refcnt++;
 
   return find;
@@ -1062,17 +1105,20 @@ aspath_cmp_left_confed (const struct aspath *aspath1, const struct aspath *aspat
   return 0;
 }
 
-/* Make hash value by raw aspath data. */
+/* Make hash value by aspath segments. */
 unsigned int
 aspath_key_make (void *p)
 {
   struct aspath * aspath = (struct aspath *) p;
-  unsigned int key = 0;
-
-  if (!aspath->str)
-    aspath_str_update (aspath);
+  struct assegment *seg;
+  unsigned int key = 2334325;
 
-  key = jhash (aspath->str, strlen(aspath->str), 2334325);
+  /* Hash the segments rather than the string form: lookups can then be
+     done without building the string first. */
+  for (seg = aspath->segments; seg; seg = seg->next) {
+    key = jhash_2words (seg->type, seg->length, key);
+    if (seg->length) key = jhash2 (seg->as, seg->length, key);
+  }
 
   return key;
 }
@@ -27,6 +27,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define __BGP_COMMUNITY_C
 
 #include "pmacct.h"
+#include "jhash.h"
 #include "bgp.h"
 
 /* Allocate a new communities value.  */
@@ -390,22 +391,74 @@ community_unintern (struct bgp_peer *peer, struct community *com)
   }
 }
 
-/* Create new community attribute. */
+/* Create new community attribute. Values are sorted and uniq'ed in
+   the parse arena and looked up there first; heap memory is only
+   allocated for a community set not interned yet. */
 struct community *
 community_parse (struct bgp_peer *peer, u_int32_t *pnt, u_short length)
 {
+  struct bgp_rt_structs *inter_domain_routing_db;
+  struct bgp_misc_structs *bms;
   struct community tmp;
   struct community *new;
+  u_int32_t *val;
+  int i, tail;
 
   /* If length is malformed return NULL. */
   if (length % 4)
     return NULL;
 
+  if (!peer) return NULL;
+
+  inter_domain_routing_db = bgp_select_routing_db(peer->type);
+  bms = bgp_select_misc_db(peer->type);
+
+  if (!inter_domain_routing_db || !bms) return NULL;
+
   /* Make temporary community for hash look up. */
+  memset (&tmp, 0, sizeof (struct community));
   tmp.size = length / 4;
-  tmp.val = pnt;
 
-  new = community_uniq_sort (peer, &tmp);
+  if (tmp.size) {
+    val = pm_arena_alloc (&bms->attr_arena, length);
+    if (!val) return NULL;
+
+    memcpy (val, pnt, length);
+    qsort (val, tmp.size, sizeof (u_int32_t), community_compare);
+
+    for (i = 1, tail = 0; i < tmp.size; i++) {
+      if (val[tail] == val[i]) continue;
+
+      tail++;
+      if (tail < i) val[tail] = val[i];
+    }
+
+    tmp.size = tail + 1;
+    tmp.val = val;
+  }
+
+  new = hash_get (peer, inter_domain_routing_db->comhash, &tmp, NULL);
+  if (new) {
+    bms->attr_stats.intern_hits++;
+    new->refcnt++;
+    return new;
+  }
+
+  new = community_new (peer);
+  new->size = tmp.size;
+
+  if (new->size) {
+    new->val = malloc(com_length (new));
+    if (!new->val) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (community_parse). Exiting ..\n", config.name, bms->log_str);
+      exit_all(1);
+    }
+    memcpy (new->val, tmp.val, com_length (new));
+  }
+
+  /* community, values, string and hash backet */
+  bms->attr_stats.intern_misses++;
+  bms->attr_stats.allocs += 4;
 
   return community_intern (peer, new);
 }
@@ -415,17 +468,9 @@ community_parse (struct bgp_peer *peer, u_int32_t *pnt, u_short length)
 unsigned int
 community_hash_make (struct community *com)
 {
-  int c;
-  unsigned int key;
-  unsigned char *pnt;
+  if (!com->size) return 0;
 
-  key = 0;
-  pnt = (unsigned char *)com->val;
-  
-  for(c = 0; c < com->size * 4; c++)
-    key += pnt[c];
-      
-  return key;
+  return jhash (com->val, com_length (com), 0);
 }
 
 /* If two aspath have same value then return 1 else return 0. This
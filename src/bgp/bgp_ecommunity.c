@@ -27,6 +27,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #define __BGP_ECOMMUNITY_C
 
 #include "pmacct.h"
+#include "jhash.h"
 #include "bgp_prefix.h"
 #include "bgp.h"
 
@@ -62,102 +63,81 @@ ecommunity_free (struct ecommunity *ecom)
   free(ecom);
 }
 
-/* Add a new Extended Communities value to Extended Communities
-   Attribute structure.  When the value is already exists in the
-   structure, we don't add the value.  Newly added value is sorted by
-   numerical order.  When the value is added to the structure return 1
-   else return 0.  */
+/* Order Extended Communities values numerically, as seen on the wire.  */
 static int
-ecommunity_add_val (struct bgp_peer *peer, struct ecommunity *ecom, struct ecommunity_val *eval)
+ecommunity_val_cmp (const void *a1, const void *a2)
 {
+  return memcmp (a1, a2, ECOMMUNITY_SIZE);
+}
+
+/* Parse Extended Communities Attribute in BGP packet. Values are sorted
+   and uniq'ed in the parse arena and looked up there first; heap
+   memory is only allocated for a set not interned yet.  */
+struct ecommunity *
+ecommunity_parse (struct bgp_peer *peer, u_int8_t *pnt, u_short length)
+{
+  struct bgp_rt_structs *inter_domain_routing_db;
   struct bgp_misc_structs *bms;
-  u_int8_t *p;
-  int ret;
-  int c;
+  struct ecommunity tmp;
+  struct ecommunity *new;
+  u_int8_t *val;
+  int i, tail;
 
-  if (!peer) return ERR;
+  /* Length check.  */
+  if (length % ECOMMUNITY_SIZE)
+    return NULL;
 
-  bms = bgp_select_misc_db(peer->type);
+  if (!peer) return NULL;
 
-  if (!bms) return ERR;
+  inter_domain_routing_db = bgp_select_routing_db(peer->type);
+  bms = bgp_select_misc_db(peer->type);
 
-  /* When this is fist value, just add it.  */
-  if (ecom->val == NULL)
-    {
-      ecom->size++;
-      ecom->val = malloc(ecom_length (ecom));
-      if (!ecom->val) {
-	Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (ecommunity_add_val). Exiting ..\n", config.name, bms->log_str);
-	exit_all(1);
-      }
-      memcpy (ecom->val, eval->val, ECOMMUNITY_SIZE);
-      return 1;
-    }
+  if (!inter_domain_routing_db || !bms) return NULL;
 
-  /* If the value already exists in the structure return 0.  */
-  c = 0;
-  for (p = ecom->val; c < ecom->size; p += ECOMMUNITY_SIZE, c++)
-    {
-      ret = memcmp (p, eval->val, ECOMMUNITY_SIZE);
-      if (ret == 0)
-        return 0;
-      if (ret > 0)
-        break;
-    }
+  /* Prepare tmporary structure for hash look up.  */
+  memset (&tmp, 0, sizeof (struct ecommunity));
+  tmp.size = length / ECOMMUNITY_SIZE;
 
-  /* Add the value to the structure with numerical sorting.  */
-  ecom->size++;
-  ecom->val = realloc(ecom->val, ecom_length (ecom));
+  if (tmp.size) {
+    val = pm_arena_alloc (&bms->attr_arena, length);
+    if (!val) return NULL;
 
-  memmove (ecom->val + (c + 1) * ECOMMUNITY_SIZE,
-	   ecom->val + c * ECOMMUNITY_SIZE,
-	   (ecom->size - 1 - c) * ECOMMUNITY_SIZE);
-  memcpy (ecom->val + c * ECOMMUNITY_SIZE, eval->val, ECOMMUNITY_SIZE);
+    memcpy (val, pnt, length);
+    qsort (val, tmp.size, ECOMMUNITY_SIZE, ecommunity_val_cmp);
 
-  return 1;
-}
+    for (i = 1, tail = 0; i < tmp.size; i++) {
+      if (!memcmp (val + (tail * ECOMMUNITY_SIZE), val + (i * ECOMMUNITY_SIZE), ECOMMUNITY_SIZE)) continue;
 
-/* This function takes pointer to Extended Communites strucutre then
-   create a new Extended Communities structure by uniq and sort each
-   Exteneded Communities value.  */
-static struct ecommunity *
-ecommunity_uniq_sort (struct bgp_peer *peer, struct ecommunity *ecom)
-{
-  int i;
-  struct ecommunity *new;
-  struct ecommunity_val *eval;
-  
-  if (!ecom) return NULL;
-  
-  new = ecommunity_new (peer);
-  
-  for (i = 0; i < ecom->size; i++)
-    {
-      eval = (struct ecommunity_val *) (ecom->val + (i * ECOMMUNITY_SIZE));
-      ecommunity_add_val (peer, new, eval);
+      tail++;
+      if (tail < i) memcpy (val + (tail * ECOMMUNITY_SIZE), val + (i * ECOMMUNITY_SIZE), ECOMMUNITY_SIZE);
     }
-  return new;
-}
 
-/* Parse Extended Communites Attribute in BGP packet.  */
-struct ecommunity *
-ecommunity_parse (struct bgp_peer *peer, u_int8_t *pnt, u_short length)
-{
-  struct ecommunity tmp;
-  struct ecommunity *new;
+    tmp.size = tail + 1;
+    tmp.val = val;
+  }
 
-  /* Length check.  */
-  if (length % ECOMMUNITY_SIZE)
-    return NULL;
+  new = hash_get (peer, inter_domain_routing_db->ecomhash, &tmp, NULL);
+  if (new) {
+    bms->attr_stats.intern_hits++;
+    new->refcnt++;
+    return new;
+  }
 
-  /* Prepare tmporary structure for making a new Extended Communities
-     Attribute.  */
-  tmp.size = length / ECOMMUNITY_SIZE;
-  tmp.val = pnt;
+  new = ecommunity_new (peer);
+  new->size = tmp.size;
+
+  if (new->size) {
+    new->val = malloc(ecom_length (new));
+    if (!new->val) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (ecommunity_parse). Exiting ..\n", config.name, bms->log_str);
+      exit_all(1);
+    }
+    memcpy (new->val, tmp.val, ecom_length (new));
+  }
 
-  /* Create a new Extended Communities Attribute by uniq and sort each
-     Extended Communities value  */
-  new = ecommunity_uniq_sort (peer, &tmp);
+  /* ecommunity, values, string and hash backet */
+  bms->attr_stats.intern_misses++;
+  bms->attr_stats.allocs += 4;
 
   return ecommunity_intern (peer, new);
 }
@@ -221,17 +201,10 @@ unsigned int
 ecommunity_hash_make (void *arg)
 {
   const struct ecommunity *ecom = arg;
-  int c;
-  unsigned int key;
-  u_int8_t *pnt;
 
-  key = 0;
-  pnt = ecom->val;
-  
-  for (c = 0; c < ecom->size * ECOMMUNITY_SIZE; c++)
-    key += pnt[c];
+  if (!ecom->size) return 0;
 
-  return key;
+  return jhash (ecom->val, ecom_length (ecom), 0);
 }
 
 /* Compare two Extended Communities Attribute structure.  */
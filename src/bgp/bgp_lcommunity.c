@@ -24,6 +24,7 @@
 #define __BGP_LCOMMUNITY_C
 
 #include "pmacct.h"
+#include "jhash.h"
 #include "bgp_prefix.h"
 #include "bgp.h"
 
@@ -59,102 +60,81 @@ lcommunity_free (struct lcommunity *lcom)
   free(lcom);
 }
 
-/* Add a new Large Communities value to Large Communities
-   Attribute structure.  When the value already exists in
-   the structure, we don't add the value.  Newly added
-   value is sorted by numerical order.  When the value is
-   added to the structure return 1 else return 0.  */
+/* Order Large Communities values numerically, as seen on the wire.  */
 static int
-lcommunity_add_val (struct bgp_peer *peer, struct lcommunity *lcom, struct lcommunity_val *lval)
+lcommunity_val_cmp (const void *a1, const void *a2)
 {
+  return memcmp (a1, a2, LCOMMUNITY_SIZE);
+}
+
+/* Parse Large Communities Attribute in BGP packet. Values are sorted
+   and uniq'ed in the parse arena and looked up there first; heap
+   memory is only allocated for a set not interned yet.  */
+struct lcommunity *
+lcommunity_parse (struct bgp_peer *peer, u_int8_t *pnt, u_short length)
+{
+  struct bgp_rt_structs *inter_domain_routing_db;
   struct bgp_misc_structs *bms;
-  u_int8_t *p;
-  int ret;
-  int c;
+  struct lcommunity tmp;
+  struct lcommunity *new;
+  u_int8_t *val;
+  int i, tail;
 
-  if (!peer) return ERR;
+  /* Length check.  */
+  if (length % LCOMMUNITY_SIZE)
+    return NULL;
 
+  if (!peer) return NULL;
+
+  inter_domain_routing_db = bgp_select_routing_db(peer->type);
   bms = bgp_select_misc_db(peer->type);
 
-  if (!bms) return ERR;
-
-  /* When this is fist value, just add it.  */
-  if (lcom->val == NULL)
-    {
-      lcom->size++;
-      lcom->val = malloc(lcom_length (lcom));
-      if (!lcom->val) {
-	Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (lcommunity_add_val). Exiting ..\n", config.name, bms->log_str);
-	exit_all(1);
-      }
-      memcpy (lcom->val, lval->val, LCOMMUNITY_SIZE);
-      return 1;
-    }
+  if (!inter_domain_routing_db || !bms) return NULL;
 
-  /* If the value already exists in the structure return 0.  */
-  c = 0;
-  for (p = lcom->val; c < lcom->size; p += LCOMMUNITY_SIZE, c++)
-    {
-      ret = memcmp (p, lval->val, LCOMMUNITY_SIZE);
-      if (ret == 0)
-        return 0;
-      if (ret > 0)
-        break;
-    }
+  /* Prepare tmporary structure for hash look up.  */
+  memset (&tmp, 0, sizeof (struct lcommunity));
+  tmp.size = length / LCOMMUNITY_SIZE;
 
-  /* Add the value to the structure with numerical sorting.  */
-  lcom->size++;
-  lcom->val = realloc(lcom->val, lcom_length (lcom));
+  if (tmp.size) {
+    val = pm_arena_alloc (&bms->attr_arena, length);
+    if (!val) return NULL;
 
-  memmove (lcom->val + (c + 1) * LCOMMUNITY_SIZE,
-	   lcom->val + c * LCOMMUNITY_SIZE,
-	   (lcom->size - 1 - c) * LCOMMUNITY_SIZE);
-  memcpy (lcom->val + c * LCOMMUNITY_SIZE, lval->val, LCOMMUNITY_SIZE);
+    memcpy (val, pnt, length);
+    qsort (val, tmp.size, LCOMMUNITY_SIZE, lcommunity_val_cmp);
 
-  return 1;
-}
+    for (i = 1, tail = 0; i < tmp.size; i++) {
+      if (!memcmp (val + (tail * LCOMMUNITY_SIZE), val + (i * LCOMMUNITY_SIZE), LCOMMUNITY_SIZE)) continue;
 
-/* This function takes pointer to Large Communites strucutre then
-   create a new Large Communities structure by uniq and sort each
-   Exteneded Communities value.  */
-static struct lcommunity *
-lcommunity_uniq_sort (struct bgp_peer *peer, struct lcommunity *lcom)
-{
-  int i;
-  struct lcommunity *new;
-  struct lcommunity_val *lval;
-  
-  if (!lcom) return NULL;
-  
-  new = lcommunity_new (peer);
-  
-  for (i = 0; i < lcom->size; i++)
-    {
-      lval = (struct lcommunity_val *) (lcom->val + (i * LCOMMUNITY_SIZE));
-      lcommunity_add_val (peer, new, lval);
+      tail++;
+      if (tail < i) memcpy (val + (tail * LCOMMUNITY_SIZE), val + (i * LCOMMUNITY_SIZE), LCOMMUNITY_SIZE);
     }
-  return new;
-}
 
-/* Parse Large Communites Attribute in BGP packet.  */
-struct lcommunity *
-lcommunity_parse (struct bgp_peer *peer, u_int8_t *pnt, u_short length)
-{
-  struct lcommunity tmp;
-  struct lcommunity *new;
+    tmp.size = tail + 1;
+    tmp.val = val;
+  }
 
-  /* Length check.  */
-  if (length % LCOMMUNITY_SIZE)
-    return NULL;
+  new = hash_get (peer, inter_domain_routing_db->lcomhash, &tmp, NULL);
+  if (new) {
+    bms->attr_stats.intern_hits++;
+    new->refcnt++;
+    return new;
+  }
 
-  /* Prepare tmporary structure for making a new Large Communities
-     Attribute.  */
-  tmp.size = length / LCOMMUNITY_SIZE;
-  tmp.val = pnt;
+  new = lcommunity_new (peer);
+  new->size = tmp.size;
 
-  /* Create a new Large Communities Attribute by uniq and sort each
-     Large Communities value  */
-  new = lcommunity_uniq_sort (peer, &tmp);
+  if (new->size) {
+    new->val = malloc(lcom_length (new));
+    if (!new->val) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (lcommunity_parse). Exiting ..\n", config.name, bms->log_str);
+      exit_all(1);
+    }
+    memcpy (new->val, tmp.val, lcom_length (new));
+  }
+
+  /* lcommunity, values, string and hash backet */
+  bms->attr_stats.intern_misses++;
+  bms->attr_stats.allocs += 4;
 
   return lcommunity_intern (peer, new);
 }
@@ -218,17 +198,10 @@ unsigned int
 lcommunity_hash_make (void *arg)
 {
   const struct lcommunity *lcom = arg;
-  int c;
-  unsigned int key;
-  u_int8_t *pnt;
 
-  key = 0;
-  pnt = lcom->val;
-  
-  for (c = 0; c < lcom->size * LCOMMUNITY_SIZE; c++)
-    key += pnt[c];
+  if (!lcom->size) return 0;
 
-  return key;
+  return jhash (lcom->val, lcom_length (lcom), 0);
 }
 
 /* Compare two Large Communities Attribute structure.  */
@@ -34,14 +34,204 @@
 #include "kafka_common.h"
 #endif
 
+#ifdef WITH_JANSSON
+/*
+   bgp_peer_log_emit() ships the record serialized in bms->log_jb, with
+   the JSON object still open, to the file and broker outputs of a log.
+   Msglog records for the brokers can be coalesced, newline-separated,
+   in per-log batches bounded in size (msglog_batch_size) and in time
+   (msglog_batch_interval): all records of a peer go through the same
+   log hence per-peer ordering is preserved.
+*/
+static int bgp_peer_log_emit(struct bgp_misc_structs *bms, struct bgp_peer_log *log, int etype, int type)
+{
+  struct pm_jsonbuf *jb = &bms->log_jb;
+  int ret = 0, amqp_ret = 0, kafka_ret = 0;
+  int to_file = FALSE, to_amqp = FALSE, to_kafka = FALSE;
+  char wid[SHORTSHORTBUFLEN];
+  u_int32_t mark;
+
+  if (etype == BGP_LOGDUMP_ET_LOG) {
+    if (bms->msglog_file) to_file = TRUE;
+    if (bms->msglog_amqp_routing_key) to_amqp = TRUE;
+    if (bms->msglog_kafka_topic) to_kafka = TRUE;
+  }
+  else if (etype == BGP_LOGDUMP_ET_DUMP) {
+    if (bms->dump_file) to_file = TRUE;
+    if (bms->dump_amqp_routing_key) to_amqp = TRUE;
+    if (bms->dump_kafka_topic) to_kafka = TRUE;
+  }
+
+  if (jb->err) return ERR;
+
+  if (to_file && log->fd) {
+    mark = jb->len;
+    pm_jsonbuf_obj_close(jb);
+    pm_jsonbuf_append(jb, "\n", 1);
+    if (!jb->err) fwrite(jb->base, jb->len, 1, log->fd);
+    jb->len = mark;
+  }
+
+  if (!to_amqp && !to_kafka) return ret;
+
+  snprintf(wid, SHORTSHORTBUFLEN, "%s/%u", config.proc_name, getpid());
+  pm_jsonbuf_add_str(jb, "writer_id", wid);
+  pm_jsonbuf_obj_close(jb);
+  if (jb->err) return ERR;
+
+  if (etype == BGP_LOGDUMP_ET_LOG && bms->msglog_batch_size) {
+    if (log->batch.len && (log->batch.len + 1 + jb->len) > bms->msglog_batch_size)
+      ret = bgp_peer_log_batch_flush(log, type);
+
+    if (!log->batch.len) {
+      if (!log->batch.base) pm_jsonbuf_init(&log->batch, bms->msglog_batch_size);
+      pm_jsonbuf_reset(&log->batch);
+
+      log->batch_start = bms->log_tstamp;
+      if (!bms->msglog_batch_pending) {
+	bms->msglog_batch_deadline = log->batch_start;
+	bms->msglog_batch_deadline.tv_sec += (bms->msglog_batch_interval / 1000);
+	bms->msglog_batch_deadline.tv_usec += ((bms->msglog_batch_interval % 1000) * 1000);
+	if (bms->msglog_batch_deadline.tv_usec >= 1000000) {
+	  bms->msglog_batch_deadline.tv_sec++;
+	  bms->msglog_batch_deadline.tv_usec -= 1000000;
+	}
+      }
+      bms->msglog_batch_pending++;
+    }
+    else pm_jsonbuf_append(&log->batch, "\n", 1);
+
+    pm_jsonbuf_append(&log->batch, jb->base, jb->len);
+
+    if (log->batch.err) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): [%s] msglog batch dropped: buffer allocation failed.\n", config.name, bms->log_str, log->filename);
+      pm_jsonbuf_reset(&log->batch);
+      bms->msglog_batch_pending--;
+      return ERR;
+    }
+
+    if (log->batch.len >= bms->msglog_batch_size) ret |= bgp_peer_log_batch_flush(log, type);
+
+    return ret;
+  }
+
+#ifdef WITH_RABBITMQ
+  if (to_amqp) {
+    p_amqp_set_routing_key(log->amqp_host, log->filename);
+    amqp_ret = write_binary_amqp(log->amqp_host, jb->base, jb->len);
+    p_amqp_unset_routing_key(log->amqp_host);
+  }
+#endif
+
+#ifdef WITH_KAFKA
+  if (to_kafka) {
+    p_kafka_set_topic(log->kafka_host, log->filename);
+    kafka_ret = write_binary_kafka(log->kafka_host, jb->base, jb->len);
+    p_kafka_unset_topic(log->kafka_host);
+  }
+#endif
+
+  return (ret | amqp_ret | kafka_ret);
+}
+#endif
+
+int bgp_peer_log_batch_flush(struct bgp_peer_log *log, int type)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(type);
+  int amqp_ret = 0, kafka_ret = 0;
+
+  if (!bms || !log || !log->batch.len) return SUCCESS;
+
+#ifdef WITH_RABBITMQ
+  if (bms->msglog_amqp_routing_key && log->amqp_host) {
+    p_amqp_set_routing_key(log->amqp_host, log->filename);
+    amqp_ret = write_binary_amqp(log->amqp_host, log->batch.base, log->batch.len);
+    p_amqp_unset_routing_key(log->amqp_host);
+  }
+#endif
+
+#ifdef WITH_KAFKA
+  if (bms->msglog_kafka_topic && log->kafka_host) {
+    p_kafka_set_topic(log->kafka_host, log->filename);
+    kafka_ret = write_binary_kafka(log->kafka_host, log->batch.base, log->batch.len);
+    p_kafka_unset_topic(log->kafka_host);
+  }
+#endif
+
+  pm_jsonbuf_reset(&log->batch);
+  if (bms->msglog_batch_pending) bms->msglog_batch_pending--;
+
+  return (amqp_ret | kafka_ret);
+}
+
+/* flushes batches older than msglog_batch_interval; to be called from
+   the daemon loop after log_tstamp is refreshed */
+void bgp_peer_log_batch_flush_expired(int type)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(type);
+  struct bgp_peer_log *log;
+  struct timeval deadline, next;
+  int peer_idx, have_next = FALSE;
+
+  if (!bms || !bms->msglog_batch_pending) return;
+  if (timeval_cmp(&bms->log_tstamp, &bms->msglog_batch_deadline) < 0) return;
+
+  for (peer_idx = 0; peer_idx < bms->max_peers && bms->msglog_batch_pending; peer_idx++) {
+    log = &bms->peers_log[peer_idx];
+    if (!log->batch.len) continue;
+
+    deadline = log->batch_start;
+    deadline.tv_sec += (bms->msglog_batch_interval / 1000);
+    deadline.tv_usec += ((bms->msglog_batch_interval % 1000) * 1000);
+    if (deadline.tv_usec >= 1000000) {
+      deadline.tv_sec++;
+      deadline.tv_usec -= 1000000;
+    }
+
+    if (timeval_cmp(&bms->log_tstamp, &deadline) >= 0) bgp_peer_log_batch_flush(log, type);
+    else if (!have_next || timeval_cmp(&deadline, &next) < 0) {
+      next = deadline;
+      have_next = TRUE;
+    }
+  }
+
+  if (have_next) bms->msglog_batch_deadline = next;
+}
+
+/* returns the select() timeout to use: the one passed, 'drt', unless a
+   pending batch expires earlier */
+struct timeval *bgp_peer_log_batch_timeout(int type, struct timeval *drt, struct timeval *tv)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(type);
+  struct timeval now;
+
+  if (!bms || !bms->msglog_batch_pending || !tv) return drt;
+
+  gettimeofday(&now, NULL);
+  if (timeval_cmp(&now, &bms->msglog_batch_deadline) >= 0) {
+    tv->tv_sec = 0;
+    tv->tv_usec = 0;
+  }
+  else {
+    tv->tv_sec = (bms->msglog_batch_deadline.tv_sec - now.tv_sec);
+    tv->tv_usec = (bms->msglog_batch_deadline.tv_usec - now.tv_usec);
+    if (tv->tv_usec < 0) {
+      tv->tv_sec--;
+      tv->tv_usec += 1000000;
+    }
+  }
+
+  if (drt && timeval_cmp(drt, tv) < 0) return drt;
+
+  return tv;
+}
+
 int bgp_peer_log_msg(struct bgp_node *route, struct bgp_info *ri, afi_t afi, safi_t safi, char *event_type, int output, int log_type)
 {
   struct bgp_misc_structs *bms;
-  char log_rk[SRVBUFLEN];
   struct bgp_peer *peer;
   struct bgp_attr *attr;
-  int ret = 0, amqp_ret = 0, kafka_ret = 0, etype = BGP_LOGDUMP_ET_NONE;
-  pid_t writer_pid = getpid();
+  int ret = 0, etype = BGP_LOGDUMP_ET_NONE;
 
   if (!ri || !ri->peer || !ri->peer->log || !event_type) return ERR;
 
@@ -54,100 +244,91 @@ int bgp_peer_log_msg(struct bgp_node *route, struct bgp_info *ri, afi_t afi, saf
   if (!strcmp(event_type, "dump")) etype = BGP_LOGDUMP_ET_DUMP;
   else if (!strcmp(event_type, "log")) etype = BGP_LOGDUMP_ET_LOG;
 
-#ifdef WITH_RABBITMQ
-  if ((bms->msglog_amqp_routing_key && etype == BGP_LOGDUMP_ET_LOG) ||
-      (bms->dump_amqp_routing_key && etype == BGP_LOGDUMP_ET_DUMP))
-    p_amqp_set_routing_key(peer->log->amqp_host, peer->log->filename);
-#endif
-
-#ifdef WITH_KAFKA
-  if ((bms->msglog_kafka_topic && etype == BGP_LOGDUMP_ET_LOG) ||
-      (bms->dump_kafka_topic && etype == BGP_LOGDUMP_ET_DUMP))
-    p_kafka_set_topic(peer->log->kafka_host, peer->log->filename);
-#endif
-
   if (output == PRINT_OUTPUT_JSON) {
 #ifdef WITH_JANSSON
+    struct pm_jsonbuf *jb = &bms->log_jb;
     char ip_address[INET6_ADDRSTRLEN];
-    json_t *obj = json_object();
-
     char empty[] = "";
     char prefix_str[INET6_ADDRSTRLEN], nexthop_str[INET6_ADDRSTRLEN];
     char *aspath;
 
+    if (!jb->base) pm_jsonbuf_init(jb, 0);
+    pm_jsonbuf_reset(jb);
+    pm_jsonbuf_obj_open(jb);
+
     /* no need for seq for "dump" event_type */
     if (etype == BGP_LOGDUMP_ET_LOG) {
-      json_object_set_new_nocheck(obj, "seq", json_integer((json_int_t)bms->log_seq));
+      pm_jsonbuf_add_int(jb, "seq", bms->log_seq);
       bgp_peer_log_seq_increment(&bms->log_seq);
 
       switch (log_type) {
       case BGP_LOG_TYPE_UPDATE:
-	json_object_set_new_nocheck(obj, "log_type", json_string("update"));
+	pm_jsonbuf_add_str(jb, "log_type", "update");
 	break;
       case BGP_LOG_TYPE_WITHDRAW:
-	json_object_set_new_nocheck(obj, "log_type", json_string("withdraw"));
+	pm_jsonbuf_add_str(jb, "log_type", "withdraw");
 	break;
       case BGP_LOG_TYPE_DELETE:
-	json_object_set_new_nocheck(obj, "log_type", json_string("delete"));
+	pm_jsonbuf_add_str(jb, "log_type", "delete");
 	break;
       default:
-        json_object_set_new_nocheck(obj, "log_type", json_integer((json_int_t)log_type));
+        pm_jsonbuf_add_int(jb, "log_type", log_type);
 	break;
       }
     }
 
     if (etype == BGP_LOGDUMP_ET_LOG)
-      json_object_set_new_nocheck(obj, "timestamp", json_string(bms->log_tstamp_str));
+      pm_jsonbuf_add_str(jb, "timestamp", bms->log_tstamp_str);
     else if (etype == BGP_LOGDUMP_ET_DUMP)
-      json_object_set_new_nocheck(obj, "timestamp", json_string(bms->dump.tstamp_str));
+      pm_jsonbuf_add_str(jb, "timestamp", bms->dump.tstamp_str);
 
-    if (bms->bgp_peer_log_msg_extras) bms->bgp_peer_log_msg_extras(peer, output, obj);
+    if (bms->bgp_peer_log_msg_extras) bms->bgp_peer_log_msg_extras(peer, output, jb);
 
     if (ri && ri->extra && ri->extra->bmed.id && bms->bgp_peer_logdump_extra_data)
-      bms->bgp_peer_logdump_extra_data(&ri->extra->bmed, output, obj);
+      bms->bgp_peer_logdump_extra_data(&ri->extra->bmed, output, jb);
 
     addr_to_str(ip_address, &peer->addr);
-    json_object_set_new_nocheck(obj, bms->peer_str, json_string(ip_address));
+    pm_jsonbuf_add_str(jb, bms->peer_str, ip_address);
 
-    json_object_set_new_nocheck(obj, "event_type", json_string(event_type));
+    pm_jsonbuf_add_str(jb, "event_type", event_type);
 
-    json_object_set_new_nocheck(obj, "afi", json_integer((json_int_t)afi));
+    pm_jsonbuf_add_int(jb, "afi", afi);
 
-    json_object_set_new_nocheck(obj, "safi", json_integer((json_int_t)safi));
+    pm_jsonbuf_add_int(jb, "safi", safi);
 
     if (route) {
       memset(prefix_str, 0, INET6_ADDRSTRLEN);
       prefix2str(&route->p, prefix_str, INET6_ADDRSTRLEN);
-      json_object_set_new_nocheck(obj, "ip_prefix", json_string(prefix_str));
+      pm_jsonbuf_add_str(jb, "ip_prefix", prefix_str);
     }
 
     if (ri && ri->extra && ri->extra->path_id)
-      json_object_set_new_nocheck(obj, "as_path_id", json_integer((json_int_t)ri->extra->path_id));
+      pm_jsonbuf_add_int(jb, "as_path_id", ri->extra->path_id);
 
     if (attr) {
       memset(nexthop_str, 0, INET6_ADDRSTRLEN);
       if (attr->mp_nexthop.family) addr_to_str(nexthop_str, &attr->mp_nexthop);
       else inet_ntop(AF_INET, &attr->nexthop, nexthop_str, INET6_ADDRSTRLEN);
-      json_object_set_new_nocheck(obj, "bgp_nexthop", json_string(nexthop_str));
+      pm_jsonbuf_add_str(jb, "bgp_nexthop", nexthop_str);
 
       aspath = attr->aspath ? attr->aspath->str : empty;
-      json_object_set_new_nocheck(obj, "as_path", json_string(aspath));
+      pm_jsonbuf_add_str(jb, "as_path", aspath);
 
       if (attr->community)
-	json_object_set_new_nocheck(obj, "comms", json_string(attr->community->str));
+	pm_jsonbuf_add_str(jb, "comms", attr->community->str);
 
       if (attr->ecommunity)
-	json_object_set_new_nocheck(obj, "ecomms", json_string(attr->ecommunity->str));
+	pm_jsonbuf_add_str(jb, "ecomms", attr->ecommunity->str);
 
       if (attr->lcommunity)
-	json_object_set_new_nocheck(obj, "lcomms", json_string(attr->lcommunity->str));
+	pm_jsonbuf_add_str(jb, "lcomms", attr->lcommunity->str);
 
-      json_object_set_new_nocheck(obj, "origin", json_integer((json_int_t)attr->origin));
+      pm_jsonbuf_add_int(jb, "origin", attr->origin);
 
-      json_object_set_new_nocheck(obj, "local_pref", json_integer((json_int_t)attr->local_pref));
+      pm_jsonbuf_add_int(jb, "local_pref", attr->local_pref);
 
       if (attr->med)
-	json_object_set_new_nocheck(obj, "med", json_integer((json_int_t)attr->med));
+	pm_jsonbuf_add_int(jb, "med", attr->med);
     }
 
     if (safi == SAFI_MPLS_LABEL || safi == SAFI_MPLS_VPN) {
@@ -157,46 +338,25 @@ int bgp_peer_log_msg(struct bgp_node *route, struct bgp_info *ri, afi_t afi, saf
         u_char rd_str[SHORTSHORTBUFLEN];
 
         bgp_rd2str(rd_str, &ri->extra->rd);
-	json_object_set_new_nocheck(obj, "rd", json_string(rd_str));
+	pm_jsonbuf_add_str(jb, "rd", rd_str);
       }
 
       bgp_label2str(label_str, ri->extra->label);
-      json_object_set_new_nocheck(obj, "label", json_string(label_str));
-    }
-
-    if ((bms->msglog_file && etype == BGP_LOGDUMP_ET_LOG) ||
-	(bms->dump_file && etype == BGP_LOGDUMP_ET_DUMP))
-      write_and_free_json(peer->log->fd, obj);
-
-#ifdef WITH_RABBITMQ
-    if ((bms->msglog_amqp_routing_key && etype == BGP_LOGDUMP_ET_LOG) ||
-	(bms->dump_amqp_routing_key && etype == BGP_LOGDUMP_ET_DUMP)) {
-      add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-      amqp_ret = write_and_free_json_amqp(peer->log->amqp_host, obj);
-      p_amqp_unset_routing_key(peer->log->amqp_host);
+      pm_jsonbuf_add_str(jb, "label", label_str);
     }
-#endif
 
-#ifdef WITH_KAFKA
-    if ((bms->msglog_kafka_topic && etype == BGP_LOGDUMP_ET_LOG) ||
-        (bms->dump_kafka_topic && etype == BGP_LOGDUMP_ET_DUMP)) {
-      add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-      kafka_ret = write_and_free_json_kafka(peer->log->kafka_host, obj);
-      p_kafka_unset_topic(peer->log->kafka_host);
-    }
-#endif
+    ret = bgp_peer_log_emit(bms, peer->log, etype, peer->type);
 #endif
   }
 
-  return (ret | amqp_ret | kafka_ret);
+  return ret;
 }
 
 int bgp_peer_log_init(struct bgp_peer *peer, int output, int type)
 {
   struct bgp_misc_structs *bms = bgp_select_misc_db(type);
-  int peer_idx, have_it, ret = 0, amqp_ret = 0, kafka_ret = 0;
+  int peer_idx, have_it, ret = 0;
   char log_filename[SRVBUFLEN], event_type[] = "log_init";
-  pid_t writer_pid = getpid();
 
   if (!bms || !peer) return ERR;
 
@@ -243,9 +403,6 @@ int bgp_peer_log_init(struct bgp_peer *peer, int output, int type)
     bms->peers_log[peer_idx].refcnt++;
 
 #ifdef WITH_RABBITMQ
-    if (bms->msglog_amqp_routing_key)
-      p_amqp_set_routing_key(peer->log->amqp_host, peer->log->filename);
-
     if (bms->msglog_amqp_routing_key_rr && !p_amqp_get_routing_key_rr(peer->log->amqp_host)) {
       p_amqp_init_routing_key_rr(peer->log->amqp_host);
       p_amqp_set_routing_key_rr(peer->log->amqp_host, bms->msglog_amqp_routing_key_rr);
@@ -253,9 +410,6 @@ int bgp_peer_log_init(struct bgp_peer *peer, int output, int type)
 #endif
 
 #ifdef WITH_KAFKA
-    if (bms->msglog_kafka_topic)
-      p_kafka_set_topic(peer->log->kafka_host, peer->log->filename);
-
     if (bms->msglog_kafka_topic_rr && !p_kafka_get_topic_rr(peer->log->kafka_host)) {
       p_kafka_init_topic_rr(peer->log->kafka_host);
       p_kafka_set_topic_rr(peer->log->kafka_host, bms->msglog_kafka_topic_rr);
@@ -264,47 +418,34 @@ int bgp_peer_log_init(struct bgp_peer *peer, int output, int type)
 
     if (output == PRINT_OUTPUT_JSON) {
 #ifdef WITH_JANSSON
+      struct pm_jsonbuf *jb = &bms->log_jb;
       char ip_address[INET6_ADDRSTRLEN];
-      json_t *obj = json_object();
 
-      json_object_set_new_nocheck(obj, "seq", json_integer((json_int_t)bms->log_seq));
+      if (!jb->base) pm_jsonbuf_init(jb, 0);
+      pm_jsonbuf_reset(jb);
+      pm_jsonbuf_obj_open(jb);
+
+      pm_jsonbuf_add_int(jb, "seq", bms->log_seq);
       bgp_peer_log_seq_increment(&bms->log_seq);
 
-      json_object_set_new_nocheck(obj, "timestamp", json_string(bms->log_tstamp_str));
+      pm_jsonbuf_add_str(jb, "timestamp", bms->log_tstamp_str);
 
       if (bms->bgp_peer_logdump_initclose_extras)
-	bms->bgp_peer_logdump_initclose_extras(peer, output, obj);
+	bms->bgp_peer_logdump_initclose_extras(peer, output, jb);
 
       addr_to_str(ip_address, &peer->addr);
-      json_object_set_new_nocheck(obj, bms->peer_str, json_string(ip_address));
-
-      json_object_set_new_nocheck(obj, "event_type", json_string(event_type));
+      pm_jsonbuf_add_str(jb, bms->peer_str, ip_address);
 
-      if (bms->bgp_peer_log_msg_extras) bms->bgp_peer_log_msg_extras(peer, output, obj);
+      pm_jsonbuf_add_str(jb, "event_type", event_type);
 
-      if (bms->msglog_file)
-	write_and_free_json(peer->log->fd, obj);
-
-#ifdef WITH_RABBITMQ
-      if (bms->msglog_amqp_routing_key) {
-	add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-	amqp_ret = write_and_free_json_amqp(peer->log->amqp_host, obj); 
-	p_amqp_unset_routing_key(peer->log->amqp_host);
-      }
-#endif
+      if (bms->bgp_peer_log_msg_extras) bms->bgp_peer_log_msg_extras(peer, output, jb);
 
-#ifdef WITH_KAFKA
-      if (bms->msglog_kafka_topic) {
-	add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-        kafka_ret = write_and_free_json_kafka(peer->log->kafka_host, obj);
-        p_kafka_unset_topic(peer->log->kafka_host);
-      }
-#endif
+      ret = bgp_peer_log_emit(bms, peer->log, BGP_LOGDUMP_ET_LOG, type);
 #endif
     }
   }
 
-  return (ret | amqp_ret | kafka_ret);
+  return ret;
 }
 
 int bgp_peer_log_close(struct bgp_peer *peer, int output, int type)
@@ -312,25 +453,11 @@ int bgp_peer_log_close(struct bgp_peer *peer, int output, int type)
   struct bgp_misc_structs *bms = bgp_select_misc_db(type);
   char event_type[] = "log_close";
   struct bgp_peer_log *log_ptr;
-  void *amqp_log_ptr, *kafka_log_ptr;
-  int ret = 0, amqp_ret = 0, kafka_ret = 0;
-  pid_t writer_pid = getpid();
+  int ret = 0;
 
   if (!bms || !peer || !peer->log) return ERR;
 
-#ifdef WITH_RABBITMQ
-  if (bms->msglog_amqp_routing_key)
-    p_amqp_set_routing_key(peer->log->amqp_host, peer->log->filename);
-#endif
-
-#ifdef WITH_KAFKA
-  if (bms->msglog_kafka_topic)
-    p_kafka_set_topic(peer->log->kafka_host, peer->log->filename);
-#endif
-
   log_ptr = peer->log;
-  amqp_log_ptr = peer->log->amqp_host;
-  kafka_log_ptr = peer->log->kafka_host;
 
   assert(peer->log->refcnt);
   peer->log->refcnt--;
@@ -338,51 +465,42 @@ int bgp_peer_log_close(struct bgp_peer *peer, int output, int type)
 
   if (output == PRINT_OUTPUT_JSON) {
 #ifdef WITH_JANSSON
+    struct pm_jsonbuf *jb = &bms->log_jb;
     char ip_address[INET6_ADDRSTRLEN];
-    json_t *obj = json_object();
 
-    json_object_set_new_nocheck(obj, "seq", json_integer((json_int_t)bms->log_seq));
+    if (!jb->base) pm_jsonbuf_init(jb, 0);
+    pm_jsonbuf_reset(jb);
+    pm_jsonbuf_obj_open(jb);
+
+    pm_jsonbuf_add_int(jb, "seq", bms->log_seq);
     bgp_peer_log_seq_increment(&bms->log_seq);
 
-    json_object_set_new_nocheck(obj, "timestamp", json_string(bms->log_tstamp_str));
+    pm_jsonbuf_add_str(jb, "timestamp", bms->log_tstamp_str);
 
     if (bms->bgp_peer_logdump_initclose_extras)
-      bms->bgp_peer_logdump_initclose_extras(peer, output, obj);
+      bms->bgp_peer_logdump_initclose_extras(peer, output, jb);
 
     addr_to_str(ip_address, &peer->addr);
-    json_object_set_new_nocheck(obj, bms->peer_str, json_string(ip_address));
+    pm_jsonbuf_add_str(jb, bms->peer_str, ip_address);
 
-    json_object_set_new_nocheck(obj, "event_type", json_string(event_type));
+    pm_jsonbuf_add_str(jb, "event_type", event_type);
 
-    if (bms->msglog_file)
-      write_and_free_json(log_ptr->fd, obj);
-
-#ifdef WITH_RABBITMQ
-    if (bms->msglog_amqp_routing_key) {
-      add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-      amqp_ret = write_and_free_json_amqp(amqp_log_ptr, obj);
-      p_amqp_unset_routing_key(amqp_log_ptr);
-    }
-#endif
-
-#ifdef WITH_KAFKA
-    if (bms->msglog_kafka_topic) {
-      add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-      kafka_ret = write_and_free_json_kafka(kafka_log_ptr, obj);
-      p_kafka_unset_topic(kafka_log_ptr);
-    }
-#endif
+    ret = bgp_peer_log_emit(bms, log_ptr, BGP_LOGDUMP_ET_LOG, type);
 #endif
   }
 
   if (!log_ptr->refcnt) {
+    /* last user gone: nothing is to be left behind in the batch */
+    bgp_peer_log_batch_flush(log_ptr, type);
+    pm_jsonbuf_destroy(&log_ptr->batch);
+
     if (bms->msglog_file && !log_ptr->refcnt) {
       fclose(log_ptr->fd);
       memset(log_ptr, 0, sizeof(struct bgp_peer_log));
     }
   }
 
-  return (ret | amqp_ret | kafka_ret);
+  return ret;
 }
 
 void bgp_peer_log_seq_init(u_int64_t *seq)
@@ -439,15 +557,11 @@ int bgp_peer_dump_init(struct bgp_peer *peer, int output, int type)
 {
   struct bgp_misc_structs *bms = bgp_select_misc_db(type);
   char event_type[] = "dump_init";
-  int ret = 0, amqp_ret = 0, kafka_ret = 0;
-  pid_t writer_pid = getpid();
+  int ret = 0;
 
   if (!bms || !peer || !peer->log) return ERR;
 
 #ifdef WITH_RABBITMQ
-  if (bms->dump_amqp_routing_key)
-    p_amqp_set_routing_key(peer->log->amqp_host, peer->log->filename);
-
   if (bms->dump_amqp_routing_key_rr && !p_amqp_get_routing_key_rr(peer->log->amqp_host)) {
     p_amqp_init_routing_key_rr(peer->log->amqp_host);
     p_amqp_set_routing_key_rr(peer->log->amqp_host, bms->dump_amqp_routing_key_rr);
@@ -455,9 +569,6 @@ int bgp_peer_dump_init(struct bgp_peer *peer, int output, int type)
 #endif
 
 #ifdef WITH_KAFKA
-  if (bms->dump_kafka_topic)
-    p_kafka_set_topic(peer->log->kafka_host, peer->log->filename);
-
   if (bms->dump_kafka_topic_rr && !p_kafka_get_topic_rr(peer->log->kafka_host)) {
     p_kafka_init_topic_rr(peer->log->kafka_host);
     p_kafka_set_topic_rr(peer->log->kafka_host, bms->dump_kafka_topic_rr);
@@ -466,107 +577,70 @@ int bgp_peer_dump_init(struct bgp_peer *peer, int output, int type)
 
   if (output == PRINT_OUTPUT_JSON) {
 #ifdef WITH_JANSSON
+    struct pm_jsonbuf *jb = &bms->log_jb;
     char ip_address[INET6_ADDRSTRLEN];
-    json_t *obj = json_object();
 
-    json_object_set_new_nocheck(obj, "timestamp", json_string(bms->dump.tstamp_str));
+    if (!jb->base) pm_jsonbuf_init(jb, 0);
+    pm_jsonbuf_reset(jb);
+    pm_jsonbuf_obj_open(jb);
+
+    pm_jsonbuf_add_str(jb, "timestamp", bms->dump.tstamp_str);
 
     if (bms->bgp_peer_logdump_initclose_extras)
-      bms->bgp_peer_logdump_initclose_extras(peer, output, obj);
+      bms->bgp_peer_logdump_initclose_extras(peer, output, jb);
 
     addr_to_str(ip_address, &peer->addr);
-    json_object_set_new_nocheck(obj, bms->peer_str, json_string(ip_address));
-
-    json_object_set_new_nocheck(obj, "event_type", json_string(event_type));
+    pm_jsonbuf_add_str(jb, bms->peer_str, ip_address);
 
-    json_object_set_new_nocheck(obj, "dump_period", json_integer((json_int_t)bms->dump.period));
+    pm_jsonbuf_add_str(jb, "event_type", event_type);
 
-    if (bms->dump_file)
-      write_and_free_json(peer->log->fd, obj);
+    pm_jsonbuf_add_int(jb, "dump_period", bms->dump.period);
 
-#ifdef WITH_RABBITMQ
-    if (bms->dump_amqp_routing_key) {
-      add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-      amqp_ret = write_and_free_json_amqp(peer->log->amqp_host, obj);
-      p_amqp_unset_routing_key(peer->log->amqp_host);
-    }
-#endif
-
-#ifdef WITH_KAFKA
-    if (bms->dump_kafka_topic) {
-      add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-      kafka_ret = write_and_free_json_kafka(peer->log->kafka_host, obj);
-      p_kafka_unset_topic(peer->log->kafka_host);
-    }
-#endif
+    ret = bgp_peer_log_emit(bms, peer->log, BGP_LOGDUMP_ET_DUMP, type);
 #endif
   }
 
-  return (ret | amqp_ret | kafka_ret);
+  return ret;
 }
 
 int bgp_peer_dump_close(struct bgp_peer *peer, struct bgp_dump_stats *bds, int output, int type)
 {
   struct bgp_misc_structs *bms = bgp_select_misc_db(type);
   char event_type[] = "dump_close";
-  int ret = 0, amqp_ret = 0, kafka_ret = 0;
-  pid_t writer_pid = getpid();
+  int ret = 0;
 
   if (!bms || !peer || !peer->log) return ERR;
 
-#ifdef WITH_RABBITMQ
-  if (bms->dump_amqp_routing_key)
-    p_amqp_set_routing_key(peer->log->amqp_host, peer->log->filename);
-#endif
-
-#ifdef WITH_KAFKA
-  if (bms->dump_kafka_topic)
-    p_kafka_set_topic(peer->log->kafka_host, peer->log->filename);
-#endif
-
   if (output == PRINT_OUTPUT_JSON) {
 #ifdef WITH_JANSSON
+    struct pm_jsonbuf *jb = &bms->log_jb;
     char ip_address[INET6_ADDRSTRLEN];
-    json_t *obj = json_object(), *kv;
 
-    json_object_set_new_nocheck(obj, "timestamp", json_string(bms->dump.tstamp_str));
+    if (!jb->base) pm_jsonbuf_init(jb, 0);
+    pm_jsonbuf_reset(jb);
+    pm_jsonbuf_obj_open(jb);
+
+    pm_jsonbuf_add_str(jb, "timestamp", bms->dump.tstamp_str);
 
     if (bms->bgp_peer_logdump_initclose_extras)
-      bms->bgp_peer_logdump_initclose_extras(peer, output, obj);
+      bms->bgp_peer_logdump_initclose_extras(peer, output, jb);
 
     addr_to_str(ip_address, &peer->addr);
-    json_object_set_new_nocheck(obj, bms->peer_str, json_string(ip_address));
+    pm_jsonbuf_add_str(jb, bms->peer_str, ip_address);
 
-    json_object_set_new_nocheck(obj, "event_type", json_string(event_type));
+    pm_jsonbuf_add_str(jb, "event_type", event_type);
 
     if (bds) {
-      json_object_set_new_nocheck(obj, "entries", json_integer((json_int_t)bds->entries));
-
-      json_object_set_new_nocheck(obj, "tables", json_integer((json_int_t)bds->tables));
-    }
-
-    if (bms->dump_file)
-      write_and_free_json(peer->log->fd, obj);
+      pm_jsonbuf_add_int(jb, "entries", bds->entries);
 
-#ifdef WITH_RABBITMQ
-    if (bms->dump_amqp_routing_key) {
-      add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-      amqp_ret = write_and_free_json_amqp(peer->log->amqp_host, obj);
-      p_amqp_unset_routing_key(peer->log->amqp_host);
+      pm_jsonbuf_add_int(jb, "tables", bds->tables);
     }
-#endif
 
-#ifdef WITH_KAFKA
-    if (bms->dump_kafka_topic) {
-      add_writer_name_and_pid_json(obj, config.proc_name, writer_pid);
-      kafka_ret = write_and_free_json_kafka(peer->log->kafka_host, obj);
-      p_kafka_unset_topic(peer->log->kafka_host);
-    }
-#endif
+    ret = bgp_peer_log_emit(bms, peer->log, BGP_LOGDUMP_ET_DUMP, type);
 #endif
   }
 
-  return (ret | amqp_ret | kafka_ret);
+  return ret;
 }
 
 void bgp_handle_dump_event()
@@ -34,12 +34,16 @@
 #define BGP_LOG_TYPE_OPEN	4
 #define BGP_LOG_TYPE_CLOSE	5
 
+#define BGP_LOG_BATCH_INTERVAL_DEFAULT	1000	/* msecs */
+
 struct bgp_peer_log {
   FILE *fd;
   int refcnt;
   char filename[SRVBUFLEN];
   void *amqp_host;
   void *kafka_host;
+  struct pm_jsonbuf batch;	/* msglog records queued for the brokers */
+  struct timeval batch_start;
 };
 
 struct bgp_dump_stats {
@@ -59,6 +63,9 @@ EXT void bgp_peer_log_seq_init(u_int64_t *);
 EXT void bgp_peer_log_seq_increment(u_int64_t *);
 EXT void bgp_peer_log_dynname(char *, int, char *, struct bgp_peer *);
 EXT int bgp_peer_log_msg(struct bgp_node *, struct bgp_info *, afi_t, safi_t, char *, int, int);
+EXT int bgp_peer_log_batch_flush(struct bgp_peer_log *, int);
+EXT void bgp_peer_log_batch_flush_expired(int);
+EXT struct timeval *bgp_peer_log_batch_timeout(int, struct timeval *, struct timeval *);
 EXT int bgp_peer_dump_init(struct bgp_peer *, int, int);
 EXT int bgp_peer_dump_close(struct bgp_peer *, struct bgp_dump_stats *, int, int);
 EXT void bgp_handle_dump_event();
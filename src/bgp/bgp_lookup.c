@@ -49,12 +49,15 @@ void bgp_srcdst_lookup(struct packet_ptrs *pptrs, int type)
 #endif
   safi_t safi;
   rd_t rd;
+  struct timespec stats_ts;
 
   bms = bgp_select_misc_db(type);
   inter_domain_routing_db = bgp_select_routing_db(type);
 
   if (!bms || !inter_domain_routing_db) return;
 
+  STATS_START(stats_ts);
+
   pptrs->bgp_src = NULL;
   pptrs->bgp_dst = NULL;
   pptrs->bgp_src_info = NULL;
@@ -308,6 +311,8 @@ void bgp_srcdst_lookup(struct packet_ptrs *pptrs, int type)
     if (config.nfacctd_bgp_follow_nexthop[0].family && pptrs->bgp_dst && safi != SAFI_MPLS_VPN)
       bgp_follow_nexthop_lookup(pptrs, type);
   }
+
+  STATS_STOP(((type == FUNC_TYPE_BMP) ? STATS_BMP : STATS_BGP), stats_ts);
 }
 
 void bgp_follow_nexthop_lookup(struct packet_ptrs *pptrs, int type)
@@ -348,10 +353,16 @@ void bgp_follow_nexthop_lookup(struct packet_ptrs *pptrs, int type)
     }
   }
 
-  for (nh_peer = NULL, peers_idx = 0; peers_idx < bms->max_peers; peers_idx++) {
-    if (!sa_addr_cmp(sa, &peers[peers_idx].addr) || !sa_addr_cmp(sa, &peers[peers_idx].id)) {
-      nh_peer = &peers[peers_idx];
-      break;
+  if (bgp_misc_db->peers_idx.buckets) {
+    peers_idx = bgp_peers_idx_lookup(bgp_misc_db, sa, FALSE);
+    nh_peer = (peers_idx != ERR ? &peers[peers_idx] : NULL);
+  }
+  else {
+    for (nh_peer = NULL, peers_idx = 0; peers_idx < bms->max_peers; peers_idx++) {
+      if (!sa_addr_cmp(sa, &peers[peers_idx].addr) || !sa_addr_cmp(sa, &peers[peers_idx].id)) {
+        nh_peer = &peers[peers_idx];
+        break;
+      }
     }
   }
 
@@ -531,10 +542,18 @@ struct bgp_peer *bgp_lookup_find_bgp_peer(struct sockaddr *sa, struct xflow_stat
       peer = NULL;
     }
   }
+  else if (bgp_misc_db->peers_idx.buckets) {
+    peer = NULL;
+    peers_idx = bgp_peers_idx_lookup(bgp_misc_db, sa, compare_bgp_port);
+    if (peers_idx != ERR) {
+      peer = &peers[peers_idx];
+      if (xs_entry && peer_idx_ptr) *peer_idx_ptr = peers_idx;
+    }
+  }
   else {
     for (peer = NULL, peers_idx = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
       if ((!sa_addr_cmp(sa, &peers[peers_idx].addr) || !sa_addr_cmp(sa, &peers[peers_idx].id)) && 
-	  (!compare_bgp_port || !sa_port_cmp(sa, peers[peer_idx].tcp_port))) {
+	  (!compare_bgp_port || !sa_port_cmp(sa, peers[peers_idx].tcp_port))) {
         peer = &peers[peers_idx];
         if (xs_entry && peer_idx_ptr) *peer_idx_ptr = peers_idx;
         break;
@@ -177,6 +177,7 @@ int bgp_parse_open_msg(struct bgp_msg_data *bmd, char *bgp_packet_ptr, time_t no
       peer->ht = MAX(5, ntohs(bopen->bgpo_holdtime));
       peer->id.family = AF_INET; 
       peer->id.address.ipv4.s_addr = bopen->bgpo_id;
+      bgp_peers_idx_add(bms, peer, BGP_PEERS_IDX_ID);
 
       /* OPEN options parsing */
       if (bopen->bgpo_optlen && bopen->bgpo_optlen >= 2) {
@@ -556,6 +557,7 @@ int bgp_parse_notification_msg(struct bgp_msg_data *bmd, char *pkt, u_int8_t *re
 int bgp_parse_update_msg(struct bgp_msg_data *bmd, char *pkt)
 {
   struct bgp_peer *peer = bmd->peer;
+  struct bgp_misc_structs *bms;
   struct bgp_header bhdr;
   u_char *startp, *endp;
   struct bgp_attr attr;
@@ -571,6 +573,13 @@ int bgp_parse_update_msg(struct bgp_msg_data *bmd, char *pkt)
 
   if (!peer || !pkt) return ERR;
 
+  bms = bgp_select_misc_db(peer->type);
+  if (!bms) return ERR;
+
+  /* attributes are decoded into the arena, only new ones hit the heap */
+  pm_arena_reset(&bms->attr_arena);
+  bms->attr_stats.updates++;
+
   /* Set initial values. */
   memset(&attr, 0, sizeof (struct bgp_attr));
   memset(&update, 0, sizeof (struct bgp_nlri));
@@ -26,6 +26,7 @@
 #include "pmacct.h"
 #include "pmacct-data.h"
 #include "addr.h"
+#include "jhash.h"
 #include "bgp.h"
 #if defined WITH_RABBITMQ
 #include "amqp_common.h"
@@ -538,6 +539,8 @@ void bgp_peer_close(struct bgp_peer *peer, int type, int no_quiet, int send_noti
 
   if (peer->fd != ERR) close(peer->fd);
 
+  bgp_peers_idx_del(bms, peer);
+
   peer->fd = 0;
   memset(&peer->id, 0, sizeof(peer->id));
   memset(&peer->addr, 0, sizeof(peer->addr));
@@ -549,6 +552,217 @@ void bgp_peer_close(struct bgp_peer *peer, int type, int no_quiet, int send_noti
     write_neighbors_file(bms->neighbors_file, peer->type);
 }
 
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+/*
+  Peer tables are reserved up to their growth limit and handed out by
+  bumping max_peers, so a peer never moves: both the index and lookups
+  done from the collector thread, without locks, rely on that. Pages
+  past max_peers are not touched, hence not backed, until used.
+*/
+void *bgp_peers_table_reserve(size_t elem_size, int limit)
+{
+  void *table;
+
+  table = mmap(NULL, (size_t) limit * elem_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+  if (table == MAP_FAILED) return NULL;
+
+  return table;
+}
+
+int bgp_peers_table_grow(struct bgp_misc_structs *bms, int *max_peers)
+{
+  int new_max;
+
+  if (!bms || *max_peers >= bms->max_peers_limit) return FALSE;
+
+  new_max = MIN((*max_peers * 2), bms->max_peers_limit);
+  Log(LOG_INFO, "INFO ( %s/%s ): growing peers table: %d -> %d (limit: %d)\n", config.name, bms->log_str,
+      *max_peers, new_max, bms->max_peers_limit);
+
+  *max_peers = new_max;
+  bms->max_peers = new_max;
+
+  return TRUE;
+}
+
+static u_int32_t bgp_peers_idx_hash(void *key, u_int32_t len)
+{
+  return jhash(key, len, 0);
+}
+
+/* IPv4 and IPv4-mapped IPv6 hash alike, as sa_addr_cmp() finds them equal */
+static u_int32_t bgp_peers_idx_hash_host(struct host_addr *a)
+{
+#if defined ENABLE_IPV6
+  if (a->family == AF_INET6) {
+    if (IN6_IS_ADDR_V4MAPPED(&a->address.ipv6)) return bgp_peers_idx_hash(&a->address.ipv6.s6_addr[12], 4);
+    else return bgp_peers_idx_hash(&a->address.ipv6, 16);
+  }
+#endif
+
+  return bgp_peers_idx_hash(&a->address.ipv4, 4);
+}
+
+static u_int32_t bgp_peers_idx_hash_sa(struct sockaddr *sa)
+{
+#if defined ENABLE_IPV6
+  if (sa->sa_family == AF_INET6) {
+    struct sockaddr_in6 *sa6 = (struct sockaddr_in6 *) sa;
+
+    if (IN6_IS_ADDR_V4MAPPED(&sa6->sin6_addr)) return bgp_peers_idx_hash(&sa6->sin6_addr.s6_addr[12], 4);
+    else return bgp_peers_idx_hash(&sa6->sin6_addr, 16);
+  }
+#endif
+
+  return bgp_peers_idx_hash(&((struct sockaddr_in *) sa)->sin_addr, 4);
+}
+
+static struct bgp_peer *bgp_peers_idx_node2peer(struct bgp_peers_idx *idx, u_int32_t node)
+{
+  return (struct bgp_peer *) (idx->base + ((node - 1) / BGP_PEERS_IDX_KEYS) * idx->stride + idx->offset);
+}
+
+/* returns FALSE and the slot if peer belongs to the indexed table */
+static int bgp_peers_idx_slot(struct bgp_peers_idx *idx, struct bgp_peer *peer, u_int32_t *slot)
+{
+  char *ptr = (char *) peer;
+  size_t elem;
+
+  if (!idx->buckets || ptr < (idx->base + idx->offset)) return TRUE;
+
+  elem = (ptr - idx->base - idx->offset) / idx->stride;
+  if (elem >= idx->max) return TRUE;
+
+  (*slot) = elem;
+
+  return FALSE;
+}
+
+void bgp_peers_idx_init(struct bgp_misc_structs *bms, void *base, size_t stride, size_t offset, u_int32_t max)
+{
+  struct bgp_peers_idx *idx;
+  u_int32_t buckets;
+
+  if (!bms || !base) return;
+
+  idx = &bms->peers_idx;
+  memset(idx, 0, sizeof(struct bgp_peers_idx));
+
+  for (buckets = 64; buckets < (max * BGP_PEERS_IDX_KEYS) && buckets < (1 << 24); buckets <<= 1);
+
+  idx->buckets = calloc(buckets, sizeof(u_int32_t));
+  if (!idx->buckets) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (bgp_peers_idx_init). Exiting ..\n", config.name, bms->log_str);
+    exit_all(1);
+  }
+
+  idx->mask = (buckets - 1);
+  idx->base = base;
+  idx->stride = stride;
+  idx->offset = offset;
+  idx->max = max;
+}
+
+static void bgp_peers_idx_unlink(struct bgp_peers_idx *idx, struct bgp_peer *peer, u_int32_t slot, int key)
+{
+  u_int32_t node = (slot * BGP_PEERS_IDX_KEYS) + key + 1, *link, hops;
+  struct bgp_peer *cur;
+
+  for (link = &idx->buckets[peer->idx_bucket[key]], hops = 0; (*link) && hops < (idx->max * BGP_PEERS_IDX_KEYS); hops++) {
+    if ((*link) == node) {
+      (*link) = peer->idx_next[key];
+      break;
+    }
+
+    cur = bgp_peers_idx_node2peer(idx, (*link));
+    link = &cur->idx_next[((*link) - 1) % BGP_PEERS_IDX_KEYS];
+  }
+
+  peer->idx_next[key] = 0;
+  peer->idx_linked &= ~(1 << key);
+}
+
+/* (re-)indexes peer under its address or BGP ID, as set at that moment */
+void bgp_peers_idx_add(struct bgp_misc_structs *bms, struct bgp_peer *peer, int key)
+{
+  struct bgp_peers_idx *idx;
+  struct host_addr *a;
+  u_int32_t slot, bucket;
+
+  if (!bms || !peer) return;
+
+  idx = &bms->peers_idx;
+  if (bgp_peers_idx_slot(idx, peer, &slot)) return;
+
+  if (peer->idx_linked & (1 << key)) bgp_peers_idx_unlink(idx, peer, slot, key);
+
+  a = (key == BGP_PEERS_IDX_ID ? &peer->id : &peer->addr);
+  if (!a->family) return;
+
+  bucket = (bgp_peers_idx_hash_host(a) & idx->mask);
+  peer->idx_bucket[key] = bucket;
+  peer->idx_next[key] = idx->buckets[bucket];
+  peer->idx_linked |= (1 << key);
+  idx->buckets[bucket] = (slot * BGP_PEERS_IDX_KEYS) + key + 1;
+}
+
+void bgp_peers_idx_del(struct bgp_misc_structs *bms, struct bgp_peer *peer)
+{
+  struct bgp_peers_idx *idx;
+  u_int32_t slot;
+  int key;
+
+  if (!bms || !peer || !peer->idx_linked) return;
+
+  idx = &bms->peers_idx;
+  if (bgp_peers_idx_slot(idx, peer, &slot)) return;
+
+  for (key = 0; key < BGP_PEERS_IDX_KEYS; key++) {
+    if (peer->idx_linked & (1 << key)) bgp_peers_idx_unlink(idx, peer, slot, key);
+  }
+}
+
+/*
+  Returns the lowest slot matching sa by address or BGP ID, as a scan of
+  the table would, or ERR. Chains are changed by the BGP/BMP thread while
+  read here: candidates are verified and the walk is bounded.
+*/
+int bgp_peers_idx_lookup(struct bgp_misc_structs *bms, struct sockaddr *sa, int compare_bgp_port)
+{
+  struct bgp_peers_idx *idx;
+  struct bgp_peer *peer;
+  struct host_addr *a;
+  u_int32_t node, slot, hops;
+  int key, ret = ERR;
+
+  if (!bms || !sa) return ERR;
+
+  idx = &bms->peers_idx;
+  if (!idx->buckets) return ERR;
+
+  node = idx->buckets[bgp_peers_idx_hash_sa(sa) & idx->mask];
+
+  for (hops = 0; node && hops < (idx->max * BGP_PEERS_IDX_KEYS); hops++) {
+    slot = ((node - 1) / BGP_PEERS_IDX_KEYS);
+    key = ((node - 1) % BGP_PEERS_IDX_KEYS);
+    if (slot >= idx->max) break;
+
+    peer = bgp_peers_idx_node2peer(idx, node);
+    a = (key == BGP_PEERS_IDX_ID ? &peer->id : &peer->addr);
+
+    if (!sa_addr_cmp(sa, a) && (!compare_bgp_port || !sa_port_cmp(sa, peer->tcp_port))) {
+      if (ret == ERR || slot < ret) ret = slot;
+    }
+
+    node = peer->idx_next[key];
+  }
+
+  return ret;
+}
+
 void bgp_peer_print(struct bgp_peer *peer, char *buf, int len)
 {
   char dumb_buf[] = "0.0.0.0";
@@ -1131,6 +1345,23 @@ struct bgp_misc_structs *bgp_select_misc_db(int peer_type)
   return NULL;
 }
 
+void bgp_attr_parse_stats_log(int type)
+{
+  struct bgp_misc_structs *bms;
+  struct bgp_attr_parse_stats *stats;
+
+  bms = bgp_select_misc_db(type);
+
+  if (!bms || !bms->attr_stats.updates) return;
+
+  stats = &bms->attr_stats;
+
+  Log(LOG_NOTICE, "NOTICE ( %s/%s ): UPDATEs parsed: %llu, attributes interned: %llu reused, %llu new (%llu allocations, %.2f per UPDATE), parse arena peak: %llu bytes\n",
+	config.name, bms->log_str, (unsigned long long) stats->updates, (unsigned long long) stats->intern_hits,
+	(unsigned long long) stats->intern_misses, (unsigned long long) stats->allocs,
+	(double) stats->allocs / stats->updates, (unsigned long long) bms->attr_arena.peak);
+}
+
 void bgp_link_misc_structs(struct bgp_misc_structs *bms)
 {
 #if defined WITH_RABBITMQ
@@ -1152,6 +1383,9 @@ void bgp_link_misc_structs(struct bgp_misc_structs *bms)
   bms->msglog_amqp_routing_key_rr = config.nfacctd_bgp_msglog_amqp_routing_key_rr;
   bms->msglog_kafka_topic = config.nfacctd_bgp_msglog_kafka_topic;
   bms->msglog_kafka_topic_rr = config.nfacctd_bgp_msglog_kafka_topic_rr;
+  bms->msglog_batch_size = config.nfacctd_bgp_msglog_batch_size;
+  bms->msglog_batch_interval = config.nfacctd_bgp_msglog_batch_interval;
+  if (!bms->msglog_batch_interval) bms->msglog_batch_interval = BGP_LOG_BATCH_INTERVAL_DEFAULT;
   bms->peer_str = malloc(strlen("peer_ip_src") + 1);
   strcpy(bms->peer_str, "peer_ip_src");
   bms->peer_port_str = malloc(strlen("peer_ip_src_port") + 1);
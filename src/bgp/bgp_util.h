@@ -47,6 +47,7 @@ EXT void bgp_md5_file_unload(struct bgp_md5_table *);
 EXT void bgp_md5_file_process(int, struct bgp_md5_table *);
 EXT void bgp_config_checks(struct configuration *);
 EXT struct bgp_misc_structs *bgp_select_misc_db(int);
+EXT void bgp_attr_parse_stats_log(int);
 EXT void bgp_link_misc_structs(struct bgp_misc_structs *);
 
 EXT struct bgp_info_extra *bgp_info_extra_new(struct bgp_info *);
@@ -68,6 +69,12 @@ EXT int bgp_peer_init(struct bgp_peer *, int);
 EXT void bgp_peer_close(struct bgp_peer *, int, int, int, u_int8_t, u_int8_t, char *);
 EXT void bgp_peer_print(struct bgp_peer *, char *, int);
 EXT void bgp_peer_info_delete(struct bgp_peer *);
+EXT void *bgp_peers_table_reserve(size_t, int);
+EXT int bgp_peers_table_grow(struct bgp_misc_structs *, int *);
+EXT void bgp_peers_idx_init(struct bgp_misc_structs *, void *, size_t, size_t, u_int32_t);
+EXT void bgp_peers_idx_add(struct bgp_misc_structs *, struct bgp_peer *, int);
+EXT void bgp_peers_idx_del(struct bgp_misc_structs *, struct bgp_peer *);
+EXT int bgp_peers_idx_lookup(struct bgp_misc_structs *, struct sockaddr *, int);
 
 EXT void bgp_batch_init(struct bgp_peer_batch *, int, int);
 EXT void bgp_batch_reset(struct bgp_peer_batch *, time_t);
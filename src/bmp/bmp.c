@@ -83,9 +83,12 @@ void skinny_bmp_daemon()
 
   /* logdump time management */
   time_t dump_refresh_deadline;
-  struct timeval dump_refresh_timeout, *drt_ptr;
+  struct timeval dump_refresh_timeout, batch_timeout, *drt_ptr;
 
 
+  if (config.nfacctd_bmp_cpu_affinity) pm_set_placement(config.nfacctd_bmp_cpu_affinity, config.numa_bind, config.name, "core/BMP");
+  stats_set_worker("bmp");
+
   /* initial cleanups */
   reload_log_bmp_thread = FALSE;
   memset(&server, 0, sizeof(server));
@@ -126,14 +129,19 @@ void skinny_bmp_daemon()
   }
 
   if (!config.nfacctd_bmp_max_peers) config.nfacctd_bmp_max_peers = BMP_MAX_PEERS_DEFAULT;
-  Log(LOG_INFO, "INFO ( %s/%s ): maximum BMP peers allowed: %d\n", config.name, bmp_misc_db->log_str, config.nfacctd_bmp_max_peers);
-
-  bmp_peers = malloc(config.nfacctd_bmp_max_peers*sizeof(struct bmp_peer));
+  if (config.nfacctd_bmp_max_peers_limit < config.nfacctd_bmp_max_peers)
+    config.nfacctd_bmp_max_peers_limit = config.nfacctd_bmp_max_peers;
+  bmp_misc_db->max_peers = config.nfacctd_bmp_max_peers;
+  bmp_misc_db->max_peers_limit = config.nfacctd_bmp_max_peers_limit;
+  Log(LOG_INFO, "INFO ( %s/%s ): maximum BMP peers allowed: %d (limit: %d)\n", config.name, bmp_misc_db->log_str,
+      config.nfacctd_bmp_max_peers, config.nfacctd_bmp_max_peers_limit);
+
+  bmp_peers = bgp_peers_table_reserve(sizeof(struct bmp_peer), config.nfacctd_bmp_max_peers_limit);
   if (!bmp_peers) {
     Log(LOG_ERR, "ERROR ( %s/%s ): Unable to malloc() BMP peers structure. Terminating thread.\n", config.name, bmp_misc_db->log_str);
     exit_all(1);
   }
-  memset(bmp_peers, 0, config.nfacctd_bmp_max_peers*sizeof(struct bmp_peer));
+  bgp_peers_idx_init(bmp_misc_db, bmp_peers, sizeof(struct bmp_peer), offsetof(struct bmp_peer, self), config.nfacctd_bmp_max_peers_limit);
 
   if (config.nfacctd_bmp_msglog_file || config.nfacctd_bmp_msglog_amqp_routing_key || config.nfacctd_bmp_msglog_kafka_topic) {
     if (config.nfacctd_bmp_msglog_file) bmp_misc_db->msglog_backend_methods++;
@@ -161,12 +169,11 @@ void skinny_bmp_daemon()
     bgp_peer_log_seq_init(&bmp_misc_db->log_seq);
 
   if (bmp_misc_db->msglog_backend_methods) {
-    bmp_misc_db->peers_log = malloc(config.nfacctd_bmp_max_peers*sizeof(struct bgp_peer_log));
+    bmp_misc_db->peers_log = bgp_peers_table_reserve(sizeof(struct bgp_peer_log), config.nfacctd_bmp_max_peers_limit);
     if (!bmp_misc_db->peers_log) {
       Log(LOG_ERR, "ERROR ( %s/%s ): Unable to malloc() BMP peers log structure. Terminating thread.\n", config.name, bmp_misc_db->log_str);
       exit_all(1);
     }
-    memset(bmp_misc_db->peers_log, 0, config.nfacctd_bmp_max_peers*sizeof(struct bgp_peer_log));
 
     if (config.nfacctd_bmp_msglog_amqp_routing_key) {
 #ifdef WITH_RABBITMQ
@@ -377,6 +384,8 @@ void skinny_bmp_daemon()
     }
     else drt_ptr = NULL;
 
+    drt_ptr = bgp_peer_log_batch_timeout(FUNC_TYPE_BMP, drt_ptr, &batch_timeout);
+
     select_num = select(select_fd, &read_descs, NULL, NULL, drt_ptr);
     if (select_num < 0) goto select_again;
 
@@ -396,6 +405,7 @@ void skinny_bmp_daemon()
     if (bmp_misc_db->msglog_backend_methods || bmp_misc_db->dump_backend_methods) {
       gettimeofday(&bmp_misc_db->log_tstamp, NULL);
       compose_timestamp(bmp_misc_db->log_tstamp_str, SRVBUFLEN, &bmp_misc_db->log_tstamp, TRUE, config.timestamps_since_epoch);
+      bgp_peer_log_batch_flush_expired(FUNC_TYPE_BMP);
 
       if (bmp_misc_db->dump_backend_methods) {
         while (bmp_misc_db->log_tstamp.tv_sec > dump_refresh_deadline) {
@@ -499,6 +509,31 @@ void skinny_bmp_daemon()
         }
       }
 
+      /* table full: grow it, the first new slot is then free */
+      if (!peer && peers_idx == config.nfacctd_bmp_max_peers && bgp_peers_table_grow(bmp_misc_db, &config.nfacctd_bmp_max_peers)) {
+        now = time(NULL);
+
+        if (bgp_batch_is_admitted(&bp_batch, now)) {
+          peer = &bmp_peers[peers_idx].self;
+          bmpp = &bmp_peers[peers_idx];
+
+          if (bmp_peer_init(bmpp, FUNC_TYPE_BMP)) {
+            peer = NULL;
+            bmpp = NULL;
+          }
+          else recalc_fds = TRUE;
+
+          if (bgp_batch_is_enabled(&bp_batch) && peer) {
+            if (bgp_batch_is_expired(&bp_batch, now)) bgp_batch_reset(&bp_batch, now);
+            if (bgp_batch_is_not_empty(&bp_batch)) bgp_batch_decrease_counter(&bp_batch);
+          }
+        }
+        else {
+          close(fd);
+          goto read_data;
+        }
+      }
+
       if (!peer) {
         int fd;
 
@@ -524,6 +559,7 @@ void skinny_bmp_daemon()
 #endif
       addr_to_str(peer->addr_str, &peer->addr);
       memcpy(&peer->id, &peer->addr, sizeof(struct host_addr)); /* XXX: some inet_ntoa()'s could be around against peer->id */
+      bgp_peers_idx_add(bmp_misc_db, peer, BGP_PEERS_IDX_ADDR);
 
       if (bmp_misc_db->msglog_backend_methods)
         bgp_peer_log_init(peer, config.nfacctd_bmp_msglog_output, FUNC_TYPE_BMP);
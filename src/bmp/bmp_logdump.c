@@ -46,6 +46,9 @@ int bmp_log_msg(struct bgp_peer *peer, struct bmp_data *bdata, void *log_data, u
   if (!strcmp(event_type, "dump")) etype = BGP_LOGDUMP_ET_DUMP;
   else if (!strcmp(event_type, "log")) etype = BGP_LOGDUMP_ET_LOG;
 
+  /* route monitoring records queued for this router go out first */
+  if (etype == BGP_LOGDUMP_ET_LOG) bgp_peer_log_batch_flush(peer->log, FUNC_TYPE_BMP);
+
 #ifdef WITH_RABBITMQ
   if ((config.nfacctd_bmp_msglog_amqp_routing_key && etype == BGP_LOGDUMP_ET_LOG) ||
       (config.bmp_dump_amqp_routing_key && etype == BGP_LOGDUMP_ET_DUMP))
@@ -62,6 +62,14 @@ struct bgp_peer *bgp_lookup_find_bmp_peer(struct sockaddr *sa, struct xflow_stat
       peer = NULL;
     }
   }
+  else if (bmp_misc_db->peers_idx.buckets) {
+    peer = NULL;
+    peers_idx = bgp_peers_idx_lookup(bmp_misc_db, sa, FALSE);
+    if (peers_idx != ERR) {
+      peer = &bmp_peers[peers_idx].self;
+      if (xs_entry && peer_idx_ptr) *peer_idx_ptr = peers_idx;
+    }
+  }
   else {
     for (peer = NULL, peers_idx = 0; peers_idx < config.nfacctd_bmp_max_peers; peers_idx++) {
       if (!sa_addr_cmp(sa, &bmp_peers[peers_idx].self.addr) || !sa_addr_cmp(sa, &bmp_peers[peers_idx].self.id)) {
@@ -91,14 +91,14 @@ void bgp_peer_log_msg_extras_bmp(struct bgp_peer *peer, int output, void *void_o
   if (output == PRINT_OUTPUT_JSON) {
 #ifdef WITH_JANSSON
     char ip_address[INET6_ADDRSTRLEN];
-    json_t *obj = void_obj;
+    struct pm_jsonbuf *jb = void_obj;
 
     addr_to_str(ip_address, &bmpp->self.addr);
-    json_object_set_new_nocheck(obj, "bmp_router", json_string(ip_address));
+    pm_jsonbuf_add_str(jb, "bmp_router", ip_address);
 
-    json_object_set_new_nocheck(obj, "bmp_router_port", json_integer((json_int_t)bmpp->self.tcp_port));
+    pm_jsonbuf_add_int(jb, "bmp_router_port", bmpp->self.tcp_port);
 
-    json_object_set_new_nocheck(obj, "bmp_msg_type", json_string(bmp_msg_type));
+    pm_jsonbuf_add_str(jb, "bmp_msg_type", bmp_msg_type);
 #endif
   }
 }
@@ -116,9 +116,9 @@ void bgp_peer_logdump_initclose_extras_bmp(struct bgp_peer *peer, int output, vo
 
   if (output == PRINT_OUTPUT_JSON) {
 #ifdef WITH_JANSSON
-    json_t *obj = void_obj;
+    struct pm_jsonbuf *jb = void_obj;
 
-    json_object_set_new_nocheck(obj, "bmp_router_port", json_integer((json_int_t)peer->tcp_port));
+    pm_jsonbuf_add_int(jb, "bmp_router_port", peer->tcp_port);
 #endif
   }
 }
@@ -143,6 +143,9 @@ void bmp_link_misc_structs(struct bgp_misc_structs *bms)
   bms->msglog_amqp_routing_key_rr = config.nfacctd_bmp_msglog_amqp_routing_key_rr;
   bms->msglog_kafka_topic = config.nfacctd_bmp_msglog_kafka_topic;
   bms->msglog_kafka_topic_rr = config.nfacctd_bmp_msglog_kafka_topic_rr;
+  bms->msglog_batch_size = config.nfacctd_bmp_msglog_batch_size;
+  bms->msglog_batch_interval = config.nfacctd_bmp_msglog_batch_interval;
+  if (!bms->msglog_batch_interval) bms->msglog_batch_interval = BGP_LOG_BATCH_INTERVAL_DEFAULT;
   bms->peer_str = malloc(strlen("bmp_router") + 1);
   strcpy(bms->peer_str, "bmp_router");
   bms->peer_port_str = malloc(strlen("bmp_router_port") + 1);
@@ -273,9 +276,9 @@ void bgp_extra_data_print_bmp(struct bgp_msg_extra_data *bmed, int output, void
 
   if (output == PRINT_OUTPUT_JSON) {
 #ifdef WITH_JANSSON
-    json_t *obj = void_obj;
+    struct pm_jsonbuf *jb = void_obj;
 
-    json_object_set_new_nocheck(obj, "is_post", json_integer((json_int_t)bmed_bmp->is_post));
+    pm_jsonbuf_add_int(jb, "is_post", bmed_bmp->is_post);
 #endif
   }
 }
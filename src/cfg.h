@@ -85,18 +85,30 @@ struct configuration {
   int pmacctd_nonroot;
   char *proc_name;
   int proc_priority;
+  char *cpu_affinity;
+  int numa_bind;
   int sock;
   int bgp_sock;
   int acct_type; 
   int data_type; 
   int pipe_homegrown;
   u_int64_t pipe_size;
+  int hugepages;
   u_int64_t buffer_size;
   int buffer_immediate;
+  u_int32_t buffer_latency;
   int pipe_check_core_pid;
   int pipe_zmq;
   int pipe_zmq_retry;
   int pipe_zmq_profile;
+  int pipe_zmq_ipc;
+  int pipe_zmq_zerocopy;
+  int pipe_zmq_compress;
+  char *pipe_zmq_export;
+  char *pipe_zmq_import;
+  char *pipe_zmq_secret;
+  int shard_id;
+  int shard_num;
   int files_umask;
   int files_uid;
   int files_gid;
@@ -108,6 +120,10 @@ struct configuration {
   int conntrack_bufsz;
   int flow_lifetime;
   int flow_tcp_lifetime;
+  int capture_threads;
+  int tpacket_fanout_mode;
+  u_int32_t tpacket_block_size;
+  u_int32_t tpacket_blocks;
   int num_protos;
   int num_hosts;
   char *imt_plugin_path;
@@ -140,6 +156,8 @@ struct configuration {
   int sql_multi_values;
   char *sql_locking_style;
   int sql_use_copy;
+  int sql_prepared_statements;
+  int sql_upsert;
   char *sql_delimiter;
   int timestamps_secs;
   int timestamps_since_epoch;
@@ -166,6 +184,8 @@ struct configuration {
   int print_markers;
   int print_output;
   int print_output_file_append;
+  int print_output_threads;
+  int print_output_threads_unordered;
   char *print_output_lock_file;
   char *print_output_separator;
   char *print_output_file;
@@ -183,9 +203,11 @@ struct configuration {
   u_int32_t nfacctd_net;
   int nfacctd_pipe_size;
   int sfacctd_renormalize;
+  int sfacctd_full_decode;
   int sfacctd_counter_output;
   char *sfacctd_counter_file;
   int sfacctd_counter_max_nodes;
+  int sfacctd_counter_refresh_time;
   char *sfacctd_counter_amqp_host;
   char *sfacctd_counter_amqp_vhost;
   char *sfacctd_counter_amqp_user;
@@ -215,6 +237,9 @@ struct configuration {
   char *telemetry_decoder;
   int telemetry_max_peers;
   int telemetry_udp_timeout;
+  int telemetry_validate_json;
+  int telemetry_gpb_kv_decode;
+  char *telemetry_gpb_kv_filter_file;
   char *telemetry_allow_file;
   int telemetry_pipe_size;
   int telemetry_ipprec;
@@ -282,6 +307,8 @@ struct configuration {
   char *nfacctd_bgp_msglog_kafka_broker_host;
   char *nfacctd_bgp_msglog_kafka_topic;
   int nfacctd_bgp_msglog_kafka_topic_rr;
+  int nfacctd_bgp_msglog_batch_size;
+  int nfacctd_bgp_msglog_batch_interval;
   int nfacctd_bgp_msglog_kafka_partition;
   char *nfacctd_bgp_msglog_kafka_partition_key;
   int nfacctd_bgp_msglog_kafka_partition_keylen;
@@ -293,9 +320,11 @@ struct configuration {
   as_t nfacctd_bgp_as;
   int nfacctd_bgp_port;
   int nfacctd_bgp_pipe_size;
+  char *nfacctd_bgp_cpu_affinity;
   int nfacctd_bgp_ipprec;
   char *nfacctd_bgp_allow_file;
   int nfacctd_bgp_max_peers;
+  int nfacctd_bgp_max_peers_limit;
   int nfacctd_bgp_aspath_radius;
   char *nfacctd_bgp_stdcomm_pattern;
   char *nfacctd_bgp_extcomm_pattern;
@@ -356,7 +385,9 @@ struct configuration {
   char *nfacctd_bmp_ip;
   int nfacctd_bmp_port;
   int nfacctd_bmp_pipe_size;
+  char *nfacctd_bmp_cpu_affinity;
   int nfacctd_bmp_max_peers;
+  int nfacctd_bmp_max_peers_limit;
   char *nfacctd_bmp_allow_file;
   int nfacctd_bmp_ipprec;
   int nfacctd_bmp_batch;
@@ -378,6 +409,8 @@ struct configuration {
   char *nfacctd_bmp_msglog_kafka_broker_host;
   char *nfacctd_bmp_msglog_kafka_topic;
   int nfacctd_bmp_msglog_kafka_topic_rr;
+  int nfacctd_bmp_msglog_batch_size;
+  int nfacctd_bmp_msglog_batch_interval;
   int nfacctd_bmp_msglog_kafka_partition;
   char *nfacctd_bmp_msglog_kafka_partition_key;
   int nfacctd_bmp_msglog_kafka_partition_keylen;
@@ -438,9 +471,13 @@ struct configuration {
   char *dev;
   int if_wait;
   int sf_wait;
+  int pcap_savefile_pace;
+  char *stats_file;
+  int stats_refresh_time;
   int num_memory_pools;
   int memory_pool_size;
   int buckets;
+  int imt_snapshot_refresh_time;
   int daemon;
   int active_plugins;
   char *logfile; 
@@ -513,6 +550,7 @@ struct configuration {
   int tee_max_receiver_pools;
   char *tee_receivers;
   int tee_pipe_size;
+  int tee_batch_size;
   int tee_dissect_send_full_pkt;
   int uacctd_group;
   int uacctd_nl_size;
@@ -28,6 +28,7 @@
 #include "pmacct-data.h"
 #include "plugin_hooks.h"
 #include "cfg_handlers.h"
+#include "tpacket.h"
 #include "bgp/bgp.h"
 
 int parse_truefalse(char *value_ptr)
@@ -344,6 +345,52 @@ int cfg_key_proc_priority(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_cpu_affinity(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  if (strspn(value_ptr, "0123456789,-") != strlen(value_ptr)) {
+    Log(LOG_WARNING, "WARN: [%s] 'cpu_affinity' has to be a list of CPUs, ie. 0-3,8.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.cpu_affinity = value_ptr;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.cpu_affinity = value_ptr;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_numa_bind(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.numa_bind = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.numa_bind = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_snaplen(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -589,6 +636,48 @@ int cfg_key_pcap_savefile_wait(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_pcap_savefile_pace(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse_nonzero(value_ptr);
+  if (value == ERR) return ERR;
+
+  for (; list; list = list->next, changes++) list->cfg.pcap_savefile_pace = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'pcap_savefile_pace'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_stats_file(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  for (; list; list = list->next, changes++) list->cfg.stats_file = value_ptr;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'stats_file'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_stats_refresh_time(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_ERR, "WARN: [%s] 'stats_refresh_time' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.stats_refresh_time = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'stats_refresh_time'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_promisc(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -719,6 +808,31 @@ int cfg_key_imt_mem_pools_size(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_imt_snapshot_refresh_time(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'imt_snapshot_refresh_time' has to be >= 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.imt_snapshot_refresh_time = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.imt_snapshot_refresh_time = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_sql_db(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -920,6 +1034,53 @@ int cfg_key_print_output_file_append(char *filename, char *name, char *value_ptr
   return changes;
 }
 
+int cfg_key_print_output_threads(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_ERR, "WARN: [%s] 'print_output_threads' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.print_output_threads = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.print_output_threads = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_print_output_threads_unordered(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.print_output_threads_unordered = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.print_output_threads_unordered = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_print_output_lock_file(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -1948,6 +2109,50 @@ int cfg_key_sql_use_copy(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_sql_prepared_statements(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.sql_prepared_statements = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.sql_prepared_statements = value;
+	changes++;
+	break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_sql_upsert(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.sql_upsert = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.sql_upsert = value;
+	changes++;
+	break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_sql_delimiter(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -2025,6 +2230,34 @@ int cfg_key_plugin_pipe_size(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_plugin_hugepages(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  lower_string(value_ptr);
+  if (!strcmp(value_ptr, "false")) value = HUGEPAGES_NONE;
+  else if (!strcmp(value_ptr, "2m")) value = HUGEPAGES_2M;
+  else if (!strcmp(value_ptr, "1g")) value = HUGEPAGES_1G;
+  else {
+    Log(LOG_WARNING, "WARN: [%s] 'plugin_hugepages' has to be one of: false, 2M, 1G.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.hugepages = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.hugepages = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_plugin_pipe_check_core_pid(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -2052,14 +2285,176 @@ int cfg_key_plugin_pipe_zmq(char *filename, char *name, char *value_ptr)
   struct plugins_list_entry *list = plugins_list;
   int value, changes = 0;
 
-  value = parse_truefalse(value_ptr);
-  if (value < 0) return ERR;
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.pipe_zmq = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.pipe_zmq = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_plugin_pipe_zmq_ipc(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.pipe_zmq_ipc = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.pipe_zmq_ipc = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_plugin_pipe_zmq_zerocopy(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.pipe_zmq_zerocopy = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.pipe_zmq_zerocopy = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_plugin_pipe_zmq_compress(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.pipe_zmq_compress = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.pipe_zmq_compress = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_plugin_pipe_zmq_export(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.pipe_zmq_export = value_ptr;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.pipe_zmq_export = value_ptr;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_plugin_pipe_zmq_import(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.pipe_zmq_import = value_ptr;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.pipe_zmq_import = value_ptr;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_plugin_pipe_zmq_secret(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.pipe_zmq_secret = value_ptr;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.pipe_zmq_secret = value_ptr;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_plugin_shard(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0, shard_id, shard_num;
+  char *sep;
+
+  sep = strchr(value_ptr, '/');
+  if (!sep) {
+    Log(LOG_ERR, "WARN: [%s] 'plugin_shard' expects <shard>/<shards>.\n", filename);
+    return ERR;
+  }
+
+  shard_id = atoi(value_ptr);
+  shard_num = atoi(sep + 1);
+  if (shard_num < 1 || shard_id < 0 || shard_id >= shard_num) {
+    Log(LOG_ERR, "WARN: [%s] 'plugin_shard' has to be in the range 0/N to (N-1)/N.\n", filename);
+    return ERR;
+  }
 
-  if (!name) for (; list; list = list->next, changes++) list->cfg.pipe_zmq = value;
+  if (!name) {
+    for (; list; list = list->next, changes++) {
+      list->cfg.shard_id = shard_id;
+      list->cfg.shard_num = shard_num;
+    }
+  }
   else {
     for (; list; list = list->next) {
       if (!strcmp(name, list->name)) {
-        list->cfg.pipe_zmq = value;
+        list->cfg.shard_id = shard_id;
+        list->cfg.shard_num = shard_num;
         changes++;
         break;
       }
@@ -2227,6 +2622,22 @@ int cfg_key_nfacctd_bgp_pipe_size(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_nfacctd_bgp_cpu_affinity(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  if (strspn(value_ptr, "0123456789,-") != strlen(value_ptr)) {
+    Log(LOG_WARNING, "WARN: [%s] 'bgp_daemon_cpu_affinity' has to be a list of CPUs, ie. 0-3,8.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.nfacctd_bgp_cpu_affinity = value_ptr;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_daemon_cpu_affinity'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_plugin_buffer_size(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -2257,6 +2668,31 @@ int cfg_key_plugin_buffer_size(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_plugin_buffer_latency(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'plugin_buffer_latency' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.buffer_latency = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.buffer_latency = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_networks_mask(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -3247,6 +3683,23 @@ int cfg_key_nfacctd_bgp_max_peers(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_nfacctd_bgp_max_peers_limit(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 1) {
+        Log(LOG_ERR, "WARN: [%s] 'bgp_daemon_max_peers_limit' has to be >= 1.\n", filename);
+        return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.nfacctd_bgp_max_peers_limit = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_daemon_max_peers_limit'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bgp_ip(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -3531,6 +3984,22 @@ int cfg_key_nfacctd_bmp_pipe_size(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_nfacctd_bmp_cpu_affinity(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  if (strspn(value_ptr, "0123456789,-") != strlen(value_ptr)) {
+    Log(LOG_WARNING, "WARN: [%s] 'bmp_daemon_cpu_affinity' has to be a list of CPUs, ie. 0-3,8.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.nfacctd_bmp_cpu_affinity = value_ptr;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bmp_daemon_cpu_affinity'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bmp_max_peers(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -3548,6 +4017,23 @@ int cfg_key_nfacctd_bmp_max_peers(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_nfacctd_bmp_max_peers_limit(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 1) {
+        Log(LOG_ERR, "WARN: [%s] 'bmp_daemon_max_peers_limit' has to be >= 1.\n", filename);
+        return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.nfacctd_bmp_max_peers_limit = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bmp_daemon_max_peers_limit'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bmp_allow_file(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -4228,6 +4714,77 @@ int cfg_key_pmacctd_flow_buffer_size(char *filename, char *name, char *value_ptr
   return changes;
 }
 
+int cfg_key_pmacctd_capture_threads(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 0) {
+    Log(LOG_ERR, "WARN: [%s] 'pmacctd_capture_threads' has to be >= 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.capture_threads = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'pmacctd_capture_threads'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_pmacctd_fanout_mode(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  lower_string(value_ptr);
+  if (!strcmp(value_ptr, "hash")) value = TPACKET_FANOUT_HASH;
+  else if (!strcmp(value_ptr, "cpu")) value = TPACKET_FANOUT_CPU;
+  else {
+    Log(LOG_ERR, "WARN: [%s] Invalid 'pmacctd_fanout_mode' value '%s'\n", filename, value_ptr);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.tpacket_fanout_mode = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'pmacctd_fanout_mode'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_pmacctd_ring_block_size(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  u_int32_t value;
+  int changes = 0;
+
+  value = strtoul(value_ptr, NULL, 10);
+  if (value < getpagesize() || (value & (value - 1))) {
+    Log(LOG_ERR, "WARN: [%s] 'pmacctd_ring_block_size' has to be a power of 2 and at least a page in size.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.tpacket_block_size = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'pmacctd_ring_block_size'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_pmacctd_ring_blocks(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_ERR, "WARN: [%s] 'pmacctd_ring_blocks' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.tpacket_blocks = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'pmacctd_ring_blocks'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_pmacctd_flow_buffer_buckets(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -4341,6 +4898,20 @@ int cfg_key_sfacctd_renormalize(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_sfacctd_full_decode(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  for (; list; list = list->next, changes++) list->cfg.sfacctd_full_decode = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'sfacctd_full_decode'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_sfacctd_counter_file(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -4377,6 +4948,23 @@ int cfg_key_sfacctd_counter_output(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_sfacctd_counter_refresh_time(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 0) {
+    Log(LOG_ERR, "WARN: [%s] 'sfacctd_counter_refresh_time' has to be >= 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.sfacctd_counter_refresh_time = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'sfacctd_counter_refresh_time'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_sfacctd_counter_amqp_host(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -5402,6 +5990,31 @@ int cfg_key_tee_pipe_size(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_tee_batch_size(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 1 || value > SENDQ_MAX_BATCH) {
+    Log(LOG_WARNING, "WARN: [%s] 'tee_batch_size' has to be >= 1 and <= %u.\n", filename, SENDQ_MAX_BATCH);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.tee_batch_size = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.tee_batch_size = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_tee_dissect_send_full_pkt(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -6059,6 +6672,40 @@ int cfg_key_nfacctd_bgp_msglog_kafka_topic_rr(char *filename, char *name, char *
   return changes;
 }
 
+int cfg_key_nfacctd_bgp_msglog_batch_size(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0, value = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'bgp_daemon_msglog_batch_size' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.nfacctd_bgp_msglog_batch_size = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_daemon_msglog_batch_size'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_nfacctd_bgp_msglog_batch_interval(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0, value = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'bgp_daemon_msglog_batch_interval' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.nfacctd_bgp_msglog_batch_interval = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_daemon_msglog_batch_interval'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bgp_msglog_kafka_partition(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -6280,6 +6927,40 @@ int cfg_key_nfacctd_bmp_msglog_kafka_topic_rr(char *filename, char *name, char *
   return changes;
 }
 
+int cfg_key_nfacctd_bmp_msglog_batch_size(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0, value = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'bmp_daemon_msglog_batch_size' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.nfacctd_bmp_msglog_batch_size = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bmp_daemon_msglog_batch_size'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_nfacctd_bmp_msglog_batch_interval(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0, value = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'bmp_daemon_msglog_batch_interval' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.nfacctd_bmp_msglog_batch_interval = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bmp_daemon_msglog_batch_interval'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bmp_msglog_kafka_partition(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -6626,6 +7307,45 @@ int cfg_key_telemetry_udp_timeout(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_telemetry_validate_json(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  for (; list; list = list->next, changes++) list->cfg.telemetry_validate_json = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'telemetry_daemon_validate_json'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_telemetry_gpb_kv_decode(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  for (; list; list = list->next, changes++) list->cfg.telemetry_gpb_kv_decode = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'telemetry_daemon_gpb_kv_decode'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_telemetry_gpb_kv_filter_file(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  for (; list; list = list->next, changes++) list->cfg.telemetry_gpb_kv_filter_file = value_ptr;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'telemetry_daemon_gpb_kv_filter_file'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_telemetry_msglog_file(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
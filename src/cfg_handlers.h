@@ -37,6 +37,8 @@ EXT int cfg_key_pidfile(char *, char *, char *);
 EXT int cfg_key_daemonize(char *, char *, char *);
 EXT int cfg_key_proc_name(char *, char *, char *);
 EXT int cfg_key_proc_priority(char *, char *, char *);
+EXT int cfg_key_cpu_affinity(char *, char *, char *);
+EXT int cfg_key_numa_bind(char *, char *, char *);
 EXT int cfg_key_aggregate(char *, char *, char *);
 EXT int cfg_key_aggregate_primitives(char *, char *, char *);
 EXT int cfg_key_snaplen(char *, char *, char *);
@@ -45,6 +47,9 @@ EXT int cfg_key_pcap_filter(char *, char *, char *);
 EXT int cfg_key_pcap_protocol(char *, char *, char *);
 EXT int cfg_key_pcap_savefile(char *, char *, char *);
 EXT int cfg_key_pcap_savefile_wait(char *, char *, char *);
+EXT int cfg_key_pcap_savefile_pace(char *, char *, char *);
+EXT int cfg_key_stats_file(char *, char *, char *);
+EXT int cfg_key_stats_refresh_time(char *, char *, char *);
 EXT int cfg_key_use_ip_next_hop(char *, char *, char *);
 EXT int cfg_key_thread_stack(char *, char *, char *);
 EXT int cfg_key_interface(char *, char *, char *);
@@ -60,6 +65,7 @@ EXT int cfg_key_imt_passwd(char *, char *, char *);
 EXT int cfg_key_imt_buckets(char *, char *, char *);
 EXT int cfg_key_imt_mem_pools_number(char *, char *, char *);
 EXT int cfg_key_imt_mem_pools_size(char *, char *, char *);
+EXT int cfg_key_imt_snapshot_refresh_time(char *, char *, char *);
 EXT int cfg_key_sql_db(char *, char *, char *);
 EXT int cfg_key_sql_table(char *, char *, char *);
 EXT int cfg_key_sql_table_schema(char *, char *, char *);
@@ -85,6 +91,8 @@ EXT int cfg_key_sql_preprocess_type(char *, char *, char *);
 EXT int cfg_key_sql_multi_values(char *, char *, char *);
 EXT int cfg_key_sql_locking_style(char *, char *, char *);
 EXT int cfg_key_sql_use_copy(char *, char *, char *);
+EXT int cfg_key_sql_prepared_statements(char *, char *, char *);
+EXT int cfg_key_sql_upsert(char *, char *, char *);
 EXT int cfg_key_sql_delimiter(char *, char *, char *);
 EXT int cfg_key_timestamps_secs(char *, char *, char *);
 EXT int cfg_key_timestamps_since_epoch(char *, char *, char *);
@@ -107,11 +115,20 @@ EXT int cfg_key_kafka_avro_schema_topic(char *, char *, char *);
 EXT int cfg_key_kafka_avro_schema_refresh_time(char *, char *, char *);
 EXT int cfg_key_kafka_config_file(char *, char *, char *);
 EXT int cfg_key_plugin_pipe_size(char *, char *, char *);
+EXT int cfg_key_plugin_hugepages(char *, char *, char *);
 EXT int cfg_key_plugin_buffer_size(char *, char *, char *);
+EXT int cfg_key_plugin_buffer_latency(char *, char *, char *);
 EXT int cfg_key_plugin_pipe_check_core_pid(char *, char *, char *);
 EXT int cfg_key_plugin_pipe_zmq(char *, char *, char *);
 EXT int cfg_key_plugin_pipe_zmq_retry(char *, char *, char *);
 EXT int cfg_key_plugin_pipe_zmq_profile(char *, char *, char *);
+EXT int cfg_key_plugin_pipe_zmq_ipc(char *, char *, char *);
+EXT int cfg_key_plugin_pipe_zmq_zerocopy(char *, char *, char *);
+EXT int cfg_key_plugin_pipe_zmq_compress(char *, char *, char *);
+EXT int cfg_key_plugin_pipe_zmq_export(char *, char *, char *);
+EXT int cfg_key_plugin_pipe_zmq_import(char *, char *, char *);
+EXT int cfg_key_plugin_pipe_zmq_secret(char *, char *, char *);
+EXT int cfg_key_plugin_shard(char *, char *, char *);
 EXT int cfg_key_networks_mask(char *, char *, char *);
 EXT int cfg_key_networks_file(char *, char *, char *);
 EXT int cfg_key_networks_file_filter(char *, char *, char *);
@@ -124,6 +141,8 @@ EXT int cfg_key_print_markers(char *, char *, char *);
 EXT int cfg_key_print_output(char *, char *, char *);
 EXT int cfg_key_print_output_file(char *, char *, char *);
 EXT int cfg_key_print_output_file_append(char *, char *, char *);
+EXT int cfg_key_print_output_threads(char *, char *, char *);
+EXT int cfg_key_print_output_threads_unordered(char *, char *, char *);
 EXT int cfg_key_print_output_lock_file(char *, char *, char *);
 EXT int cfg_key_print_output_separator(char *, char *, char *);
 EXT int cfg_key_print_latest_file(char *, char *, char *);
@@ -145,6 +164,10 @@ EXT int cfg_key_nfacctd_stitching(char *, char *, char *);
 EXT int cfg_key_pmacctd_force_frag_handling(char *, char *, char *);
 EXT int cfg_key_pmacctd_frag_buffer_size(char *, char *, char *);
 EXT int cfg_key_pmacctd_flow_buffer_size(char *, char *, char *);
+EXT int cfg_key_pmacctd_capture_threads(char *, char *, char *);
+EXT int cfg_key_pmacctd_fanout_mode(char *, char *, char *);
+EXT int cfg_key_pmacctd_ring_block_size(char *, char *, char *);
+EXT int cfg_key_pmacctd_ring_blocks(char *, char *, char *);
 EXT int cfg_key_pmacctd_flow_buffer_buckets(char *, char *, char *);
 EXT int cfg_key_pmacctd_conntrack_buffer_size(char *, char *, char *);
 EXT int cfg_key_pmacctd_flow_lifetime(char *, char *, char *);
@@ -152,8 +175,10 @@ EXT int cfg_key_pmacctd_flow_tcp_lifetime(char *, char *, char *);
 EXT int cfg_key_pmacctd_ext_sampling_rate(char *, char *, char *);
 EXT int cfg_key_pmacctd_nonroot(char *, char *, char *);
 EXT int cfg_key_sfacctd_renormalize(char *, char *, char *);
+EXT int cfg_key_sfacctd_full_decode(char *, char *, char *);
 EXT int cfg_key_sfacctd_counter_output(char *, char *, char *);
 EXT int cfg_key_sfacctd_counter_file(char *, char *, char *);
+EXT int cfg_key_sfacctd_counter_refresh_time(char *, char *, char *);
 EXT int cfg_key_sfacctd_counter_amqp_host(char *, char *, char *);
 EXT int cfg_key_sfacctd_counter_amqp_vhost(char *, char *, char *);
 EXT int cfg_key_sfacctd_counter_amqp_user(char *, char *, char *);
@@ -179,6 +204,9 @@ EXT int cfg_key_telemetry_ip(char *, char *, char *);
 EXT int cfg_key_telemetry_decoder(char *, char *, char *);
 EXT int cfg_key_telemetry_max_peers(char *, char *, char *);
 EXT int cfg_key_telemetry_udp_timeout(char *, char *, char *);
+EXT int cfg_key_telemetry_validate_json(char *, char *, char *);
+EXT int cfg_key_telemetry_gpb_kv_decode(char *, char *, char *);
+EXT int cfg_key_telemetry_gpb_kv_filter_file(char *, char *, char *);
 EXT int cfg_key_telemetry_allow_file(char *, char *, char *);
 EXT int cfg_key_telemetry_pipe_size(char *, char *, char *);
 EXT int cfg_key_telemetry_ip_precedence(char *, char *, char *);
@@ -270,6 +298,7 @@ EXT int cfg_key_tee_transparent(char *, char *, char *);
 EXT int cfg_key_tee_max_receivers(char *, char *, char *);
 EXT int cfg_key_tee_max_receiver_pools(char *, char *, char *);
 EXT int cfg_key_tee_pipe_size(char *, char *, char *);
+EXT int cfg_key_tee_batch_size(char *, char *, char *);
 EXT int cfg_key_tee_dissect_send_full_pkt(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_msglog_output(char *, char *, char *);
@@ -290,11 +319,14 @@ EXT int cfg_key_nfacctd_bgp_msglog_kafka_broker_host(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_msglog_kafka_broker_port(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_msglog_kafka_topic(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_msglog_kafka_topic_rr(char *, char *, char *);
+EXT int cfg_key_nfacctd_bgp_msglog_batch_size(char *, char *, char *);
+EXT int cfg_key_nfacctd_bgp_msglog_batch_interval(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_msglog_kafka_partition(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_msglog_kafka_partition_key(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_msglog_kafka_retry(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_msglog_kafka_config_file(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_max_peers(char *, char *, char *);
+EXT int cfg_key_nfacctd_bgp_max_peers_limit(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_ip(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_id(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_as(char *, char *, char *);
@@ -352,6 +384,7 @@ EXT int cfg_key_nfacctd_bgp_table_dump_kafka_config_file(char *, char *, char *)
 EXT int cfg_key_nfacctd_bgp_batch(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_batch_interval(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_pipe_size(char *, char *, char *);
+EXT int cfg_key_nfacctd_bgp_cpu_affinity(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_offline_input(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_offline_file_spool(char *, char *, char *);
 EXT int cfg_key_nfacctd_bgp_offline_file_refresh_time(char *, char *, char *);
@@ -359,7 +392,9 @@ EXT int cfg_key_nfacctd_bmp(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_ip(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_port(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_pipe_size(char *, char *, char *);
+EXT int cfg_key_nfacctd_bmp_cpu_affinity(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_max_peers(char *, char *, char *);
+EXT int cfg_key_nfacctd_bmp_max_peers_limit(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_allow_file(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_ip_precedence(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_batch(char *, char *, char *);
@@ -382,6 +417,8 @@ EXT int cfg_key_nfacctd_bmp_msglog_kafka_broker_host(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_msglog_kafka_broker_port(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_msglog_kafka_topic(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_msglog_kafka_topic_rr(char *, char *, char *);
+EXT int cfg_key_nfacctd_bmp_msglog_batch_size(char *, char *, char *);
+EXT int cfg_key_nfacctd_bmp_msglog_batch_interval(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_msglog_kafka_partition(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_msglog_kafka_partition_key(char *, char *, char *);
 EXT int cfg_key_nfacctd_bmp_msglog_kafka_retry(char *, char *, char *);
@@ -50,6 +50,9 @@
 
 u_int32_t class_trivial_hash_rnd = 140281;
 
+/* all .pat classifiers in a single automaton */
+static struct pm_dfa *class_dfa = NULL;
+
 void init_classifiers(char *path)
 {
   char fname[MAX_FN_LEN];
@@ -68,6 +71,8 @@ void init_classifiers(char *path)
      in daemons requiring it - ie. pmacctd, uacctd, etc. */
   if (!path) return;
 
+  class_dfa = pm_dfa_new();
+
   entries = pm_scandir(path, &namelist, 0, pm_alphasort);
   if (entries > 0) {
     while (n < entries) {
@@ -84,10 +89,10 @@ void init_classifiers(char *path)
 	  }
 	  Log(LOG_DEBUG, "DEBUG: reading %s classifier.\n", fname);
 
+	  css.id = x+1; /* id are >= 1 */
 	  if (dot_pat(fname)) ret = parse_pattern_file(fname, &css);
           else if (dot_so(fname)) ret = parse_shared_object(fname, &css);
           if (ret) {
-            css.id = x+1; /* id are >= 1 */
 	    pmct_register(&css);
             x++;
           }
@@ -99,6 +104,11 @@ void init_classifiers(char *path)
     }
     free(namelist);
     Log(LOG_DEBUG, "DEBUG: %d classifiers successfully loaded.\n", x);
+
+    if (class_dfa) {
+      pm_dfa_compile(class_dfa);
+      Log(LOG_DEBUG, "DEBUG: %d pattern classifiers compiled into a single DFA.\n", class_dfa->num_patterns);
+    }
   }
   else {
     Log(LOG_ERR, "ERROR: Unable to open: '%s'\n", path);
@@ -146,22 +156,31 @@ void evaluate_classifiers(struct packet_ptrs *pptrs, struct ip_flow_common *fp,
     return;
   }
 
-  /* We will pre-process the payload section of the snapshot */
   if (pptrs->payload_ptr) {
     int caplen = ((struct pcap_pkthdr *)pptrs->pkthdr)->caplen - (pptrs->payload_ptr - pptrs->packet_ptr), x = 0, y = 0;
- 
-    while (x < caplen && y < plen) {
-      if (pptrs->payload_ptr[x] != '\0') {
-        if (isascii(pptrs->payload_ptr[x])) payload[y] = tolower(pptrs->payload_ptr[x]);
-	else payload[y] = pptrs->payload_ptr[x];
-	y++;
-      }
-      x++;
-    }
-    payload[y] = '\0';
+    int dfa_id = pm_dfa_exec(class_dfa, pptrs->payload_ptr, caplen, plen), processed = FALSE;
 
     while (class[j].id && j < max) {
-      if (class[j].pattern) ret = pm_regexec(class[j].pattern, payload);
+      ret = FALSE;
+
+      if (class[j].dfa) ret = (dfa_id == class[j].id);
+      else if (class[j].pattern) {
+        /* We will pre-process the payload section of the snapshot */
+        if (!processed) {
+          while (x < caplen && y < plen) {
+            if (pptrs->payload_ptr[x] != '\0') {
+              if (isascii(pptrs->payload_ptr[x])) payload[y] = tolower(pptrs->payload_ptr[x]);
+	      else payload[y] = pptrs->payload_ptr[x];
+	      y++;
+            }
+            x++;
+          }
+          payload[y] = '\0';
+          processed = TRUE;
+        }
+
+        ret = pm_regexec(class[j].pattern, payload);
+      }
       else if (*class[j].func) {
 	cc_node = search_context_chain(fp, idx, class[j].protocol);
 	cc_rev_node = search_context_chain(fp, reverse, class[j].protocol);
@@ -350,7 +369,7 @@ static char * pre_process(char * s)
 int parse_pattern_file(char *fname, struct pkt_classifier *css)
 {
   FILE *f;
-  char line[MAX_PATTERN_LEN];
+  char line[MAX_PATTERN_LEN], *re;
   int len = 0, linelen = 0, ret;
 
   enum { protocol, pattern, done } datatype = protocol;
@@ -380,12 +399,17 @@ int parse_pattern_file(char *fname, struct pkt_classifier *css)
         Log(LOG_ERR, "ERROR: Pattern in %s too long. A maximum of %d chars is allowed.\n", fname, MAX_PATTERN_LEN);
 	return 0;
       }
-      css->pattern = pm_regcomp(pre_process(line), &linelen);
+      re = pre_process(line);
+      css->pattern = pm_regcomp(re, &linelen);
       if (!css->pattern) {
 	Log(LOG_ERR, "ERROR: Failed compiling regular expression for protocol '%s'\n", css->protocol);
 	return 0;
       } 
 
+      /* patterns the DFA can't take are left to pm_regexec() */
+      if (class_dfa && pm_dfa_add(class_dfa, re, css->id) == SUCCESS) css->dfa = TRUE;
+      else Log(LOG_DEBUG, "DEBUG: pattern for protocol '%s' is matched on its own.\n", css->protocol);
+
       datatype = done;
       break;
     }
@@ -20,6 +20,7 @@
 */
 
 #include "regexp.h"
+#include "regexp_dfa.h"
 #include "conntrack.h"
 
 /* defines */
@@ -47,6 +48,7 @@ struct pkt_classifier {
   pm_class_t id;
   char protocol[MAX_PROTOCOL_LEN];
   regexp *pattern;
+  int dfa;				/* pattern is matched by class_dfa */
   pm_class_t (*func)(struct pkt_classifier_data *, int, void **, void **, void **);
   conntrack_helper ct_helper;
   void *extra;
@@ -28,19 +28,23 @@
 #include "classifier.h"
 #include "jhash.h"
 
-u_int32_t conntrack_total_nodes_v4;
-u_int32_t conntrack_total_nodes_v6;
+PM_TLS u_int32_t conntrack_total_nodes_v4;
+PM_TLS u_int32_t conntrack_total_nodes_v6;
 
 void init_conntrack_table()
 {
   if (config.conntrack_bufsz) conntrack_total_nodes_v4 = config.conntrack_bufsz / sizeof(struct conntrack_ipv4);
   else conntrack_total_nodes_v4 = DEFAULT_CONNTRACK_BUFFER_SIZE / sizeof(struct conntrack_ipv4);
   conntrack_ipv4_table = NULL;
+  pm_timer_wheel_init(&conntrack_ipv4_wheel, CONNTRACK_WHEEL_SLOTS, time(NULL));
+  pm_slab_init(&conntrack_ipv4_slab, sizeof(struct conntrack_ipv4));
 
 #if defined ENABLE_IPV6
   if (config.conntrack_bufsz) conntrack_total_nodes_v6 = config.conntrack_bufsz / sizeof(struct conntrack_ipv6);
   else conntrack_total_nodes_v6 = DEFAULT_CONNTRACK_BUFFER_SIZE / sizeof(struct conntrack_ipv6);
   conntrack_ipv6_table = NULL;
+  pm_timer_wheel_init(&conntrack_ipv6_wheel, CONNTRACK_WHEEL_SLOTS, time(NULL));
+  pm_slab_init(&conntrack_ipv6_slab, sizeof(struct conntrack_ipv6));
 #endif
 }
 
@@ -341,34 +345,21 @@ void insert_conntrack_ipv4(time_t now, u_int32_t ip_src, u_int32_t ip_dst,
 			   u_int16_t port_src, u_int16_t port_dst, u_int8_t proto,
 			   pm_class_t class, conntrack_helper helper, time_t exp)
 {
-  int size = sizeof(struct conntrack_ipv4);
   struct conntrack_ipv4 *ct_elem;
 
-  if (conntrack_ipv4_table) {
-    ct_elem = conntrack_ipv4_table;
-    while (ct_elem->next && now < ct_elem->stamp+ct_elem->expiration)
-      ct_elem = ct_elem->next;
-
-    /* no entry expired and we reached the tail: let's allocate a new one */ 
-    if (now < ct_elem->stamp+ct_elem->expiration && !ct_elem->next) {
-      if (conntrack_total_nodes_v4) {
-        ct_elem->next = malloc(size);
-        ct_elem->next->next = NULL;
-        ct_elem = ct_elem->next;
-	conntrack_total_nodes_v4--;
-      }
-      else {
-	Log(LOG_INFO, "INFO ( %s/core ): Conntrack/4 buffer full. Skipping packet.\n", config.name);
-	return;
-      }
-    }
-  }
-  /* let's allocate our first element */
-  else {
-    conntrack_ipv4_table = malloc(size);
-    ct_elem = conntrack_ipv4_table;
-    ct_elem->next = NULL;
+  /* expired entries are reclaimed by the wheel, new ones go on top */
+  pm_timer_wheel_expire(&conntrack_ipv4_wheel, now, expire_conntrack_ipv4);
+
+  if (!conntrack_total_nodes_v4 || !(ct_elem = pm_slab_alloc(&conntrack_ipv4_slab))) {
+    Log(LOG_INFO, "INFO ( %s/core ): Conntrack/4 buffer full. Skipping packet.\n", config.name);
+    return;
   }
+  conntrack_total_nodes_v4--;
+
+  memset(ct_elem, 0, sizeof(struct conntrack_ipv4));
+  ct_elem->next = conntrack_ipv4_table;
+  if (conntrack_ipv4_table) conntrack_ipv4_table->prev = ct_elem;
+  conntrack_ipv4_table = ct_elem;
 
   ct_elem->ip_src = ip_src;
   ct_elem->ip_dst = ip_dst;
@@ -379,6 +370,7 @@ void insert_conntrack_ipv4(time_t now, u_int32_t ip_src, u_int32_t ip_dst,
   ct_elem->stamp = now;
   ct_elem->helper = helper;
   ct_elem->expiration = exp;
+  pm_timer_add(&conntrack_ipv4_wheel, &ct_elem->tmr, now+exp);
 }
 
 void search_conntrack(struct ip_flow_common *fp, struct packet_ptrs *pptrs, unsigned int idx)
@@ -391,13 +383,16 @@ void search_conntrack(struct ip_flow_common *fp, struct packet_ptrs *pptrs, unsi
 
 void search_conntrack_ipv4(struct ip_flow_common *fp, struct packet_ptrs *pptrs, unsigned int idx)
 {
-  struct conntrack_ipv4 *ct_elem = conntrack_ipv4_table, *aux = NULL;
+  struct conntrack_ipv4 *ct_elem, *aux;
   struct pm_iphdr *iphp = (struct pm_iphdr *)pptrs->iph_ptr;
   struct pm_tlhdr *tlhp = (struct pm_tlhdr *)pptrs->tlh_ptr;
 
+  pm_timer_wheel_expire(&conntrack_ipv4_wheel, fp->last[idx].tv_sec, expire_conntrack_ipv4);
   if (!conntrack_ipv4_table) return;
 
-  while (ct_elem) {
+  for (ct_elem = conntrack_ipv4_table; ct_elem; ct_elem = aux) {
+    aux = ct_elem->next;
+
 /*
     if (fp->last[idx] < ct_elem->stamp+CONNTRACK_GENERIC_LIFETIME) {
       printf("IP SRC: %x %x\n", iphp->ip_src.s_addr, ct_elem->ip_src);
@@ -422,54 +417,49 @@ void search_conntrack_ipv4(struct ip_flow_common *fp, struct packet_ptrs *pptrs,
       fp->class[0] = ct_elem->class;
       fp->class[1] = ct_elem->class;
       fp->conntrack_helper = ct_elem->helper;
-      ct_elem->stamp = 0;
-
-      /* no aux means we are facing the first element in the chain */
-      if (aux) aux->next = ct_elem->next;
-      else conntrack_ipv4_table = ct_elem->next;
-      free(ct_elem);
 
+      unlink_conntrack_ipv4(ct_elem);
       return;
     }
-
-    aux = ct_elem;
-    ct_elem = ct_elem->next;
   }
 }
 
+void unlink_conntrack_ipv4(struct conntrack_ipv4 *ct_elem)
+{
+  if (ct_elem->prev) ct_elem->prev->next = ct_elem->next;
+  else conntrack_ipv4_table = ct_elem->next;
+  if (ct_elem->next) ct_elem->next->prev = ct_elem->prev;
+
+  pm_timer_del(&conntrack_ipv4_wheel, &ct_elem->tmr);
+  pm_slab_free(&conntrack_ipv4_slab, ct_elem);
+  conntrack_total_nodes_v4++;
+}
+
+void expire_conntrack_ipv4(struct pm_timer *t, time_t now)
+{
+  unlink_conntrack_ipv4((struct conntrack_ipv4 *) ((char *) t - offsetof(struct conntrack_ipv4, tmr)));
+}
+
 #if defined ENABLE_IPV6
 void insert_conntrack_ipv6(time_t now, struct in6_addr *ip_src, struct in6_addr *ip_dst,
                            u_int16_t port_src, u_int16_t port_dst, u_int8_t proto,
                            pm_class_t class, conntrack_helper helper, time_t exp)
 {
-  int size = sizeof(struct conntrack_ipv4);
   struct conntrack_ipv6 *ct_elem;
 
-  if (conntrack_ipv6_table) {
-    ct_elem = conntrack_ipv6_table;
-    while (ct_elem->next && now < ct_elem->stamp+ct_elem->expiration)
-      ct_elem = ct_elem->next;
-
-    /* no entry expired and we reached the tail: let's allocate a new one */
-    if (now < ct_elem->stamp+ct_elem->expiration && !ct_elem->next) {
-      if (conntrack_total_nodes_v6) {
-	ct_elem->next = malloc(size);
-	ct_elem->next->next = NULL;
-	ct_elem = ct_elem->next;
-	conntrack_total_nodes_v6--;
-      }
-      else {
-        Log(LOG_INFO, "INFO ( %s/core ): Conntrack/6 buffer full. Skipping packet.\n", config.name);
-        return;
-      }
-    }
-  }
-  /* let's allocate our first element */
-  else {
-    conntrack_ipv6_table = malloc(size);
-    ct_elem = conntrack_ipv6_table;
-    ct_elem->next = NULL;
+  /* expired entries are reclaimed by the wheel, new ones go on top */
+  pm_timer_wheel_expire(&conntrack_ipv6_wheel, now, expire_conntrack_ipv6);
+
+  if (!conntrack_total_nodes_v6 || !(ct_elem = pm_slab_alloc(&conntrack_ipv6_slab))) {
+    Log(LOG_INFO, "INFO ( %s/core ): Conntrack/6 buffer full. Skipping packet.\n", config.name);
+    return;
   }
+  conntrack_total_nodes_v6--;
+
+  memset(ct_elem, 0, sizeof(struct conntrack_ipv6));
+  ct_elem->next = conntrack_ipv6_table;
+  if (conntrack_ipv6_table) conntrack_ipv6_table->prev = ct_elem;
+  conntrack_ipv6_table = ct_elem;
 
   memcpy(&ct_elem->ip_src, ip_src, IP6AddrSz);
   memcpy(&ct_elem->ip_dst, ip_dst, IP6AddrSz);
@@ -480,17 +470,21 @@ void insert_conntrack_ipv6(time_t now, struct in6_addr *ip_src, struct in6_addr
   ct_elem->stamp = now;
   ct_elem->helper = helper;
   ct_elem->expiration = exp;
+  pm_timer_add(&conntrack_ipv6_wheel, &ct_elem->tmr, now+exp);
 }
 
 void search_conntrack_ipv6(struct ip_flow_common *fp, struct packet_ptrs *pptrs, unsigned int idx)
 {
-  struct conntrack_ipv6 *ct_elem = conntrack_ipv6_table, *aux = NULL;
+  struct conntrack_ipv6 *ct_elem, *aux;
   struct ip6_hdr *iphp = (struct ip6_hdr *)pptrs->iph_ptr;
   struct pm_tlhdr *tlhp = (struct pm_tlhdr *)pptrs->tlh_ptr;
 
+  pm_timer_wheel_expire(&conntrack_ipv6_wheel, fp->last[idx].tv_sec, expire_conntrack_ipv6);
   if (!conntrack_ipv6_table) return;
 
-  while (ct_elem) {
+  for (ct_elem = conntrack_ipv6_table; ct_elem; ct_elem = aux) {
+    aux = ct_elem->next;
+
     /* conntrack entries usually have incomplete informations about the upcoming
        data channels; missing primitives are to be considered always true; then,
        we assure a) full match on the remaining primitives and b) our conntrack
@@ -505,18 +499,26 @@ void search_conntrack_ipv6(struct ip_flow_common *fp, struct packet_ptrs *pptrs,
       fp->class[0] = ct_elem->class;
       fp->class[1] = ct_elem->class;
       fp->conntrack_helper = ct_elem->helper;
-      ct_elem->stamp = 0;
-
-      /* no aux means we are facing the first element in the chain */
-      if (aux) aux->next = ct_elem->next;
-      else conntrack_ipv6_table = ct_elem->next;
-      free(ct_elem);
 
+      unlink_conntrack_ipv6(ct_elem);
       return;
     }
-
-    aux = ct_elem;
-    ct_elem = ct_elem->next;
   }
 }
+
+void unlink_conntrack_ipv6(struct conntrack_ipv6 *ct_elem)
+{
+  if (ct_elem->prev) ct_elem->prev->next = ct_elem->next;
+  else conntrack_ipv6_table = ct_elem->next;
+  if (ct_elem->next) ct_elem->next->prev = ct_elem->prev;
+
+  pm_timer_del(&conntrack_ipv6_wheel, &ct_elem->tmr);
+  pm_slab_free(&conntrack_ipv6_slab, ct_elem);
+  conntrack_total_nodes_v6++;
+}
+
+void expire_conntrack_ipv6(struct pm_timer *t, time_t now)
+{
+  unlink_conntrack_ipv6((struct conntrack_ipv6 *) ((char *) t - offsetof(struct conntrack_ipv6, tmr)));
+}
 #endif
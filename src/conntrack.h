@@ -23,6 +23,7 @@
 #define CONNTRACK_GENERIC_LIFETIME 20 
 #define DEFAULT_CONNTRACK_BUFFER_SIZE 8192000 /* 8 Mb */
 #define MAX_CONNTRACKS 256
+#define CONNTRACK_WHEEL_SLOTS 256
 
 /* structures */
 typedef void (*conntrack_helper)(time_t, struct packet_ptrs *);
@@ -43,7 +44,9 @@ struct conntrack_ipv4 {
   time_t stamp;
   time_t expiration;
   conntrack_helper helper;
+  struct pm_timer tmr;
   struct conntrack_ipv4 *next;
+  struct conntrack_ipv4 *prev;
 };
 
 #if defined ENABLE_IPV6
@@ -58,7 +61,9 @@ struct conntrack_ipv6 {
   time_t stamp;
   time_t expiration;
   conntrack_helper helper;
+  struct pm_timer tmr;
   struct conntrack_ipv6 *next;
+  struct conntrack_ipv6 *prev;
 };
 #endif
 
@@ -74,15 +79,33 @@ EXT void conntrack_rtsp_helper(time_t, struct packet_ptrs *);
 EXT void search_conntrack(struct ip_flow_common *, struct packet_ptrs *, unsigned int);
 EXT void search_conntrack_ipv4(struct ip_flow_common *, struct packet_ptrs *, unsigned int);
 EXT void insert_conntrack_ipv4(time_t, u_int32_t, u_int32_t, u_int16_t, u_int16_t, u_int8_t, pm_class_t, conntrack_helper, time_t);
-EXT struct conntrack_ipv4 *conntrack_ipv4_table;
+EXT void unlink_conntrack_ipv4(struct conntrack_ipv4 *);
+EXT void expire_conntrack_ipv4(struct pm_timer *, time_t);
 #if defined ENABLE_IPV6
 EXT void search_conntrack_ipv6(struct ip_flow_common *, struct packet_ptrs *, unsigned int);
 EXT void insert_conntrack_ipv6(time_t, struct in6_addr *, struct in6_addr *, u_int16_t, u_int16_t, u_int8_t, pm_class_t, conntrack_helper, time_t);
-EXT struct conntrack_ipv6 *conntrack_ipv6_table;
+EXT void unlink_conntrack_ipv6(struct conntrack_ipv6 *);
+EXT void expire_conntrack_ipv6(struct pm_timer *, time_t);
 #endif
 
 #undef EXT
 
+/* thread-local storage can't be a tentative (common) definition: define it once */
+#if (!defined __CONNTRACK_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT PM_TLS struct conntrack_ipv4 *conntrack_ipv4_table;
+EXT PM_TLS struct pm_timer_wheel conntrack_ipv4_wheel;
+EXT PM_TLS struct pm_slab conntrack_ipv4_slab;
+#if defined ENABLE_IPV6
+EXT PM_TLS struct conntrack_ipv6 *conntrack_ipv6_table;
+EXT PM_TLS struct pm_timer_wheel conntrack_ipv6_wheel;
+EXT PM_TLS struct pm_slab conntrack_ipv6_slab;
+#endif
+#undef EXT
+
 #if defined __CONNTRACK_C || defined __CLASSIFIER_C
 static struct conntrack_helper_entry conntrack_helper_list[] = {
   { "ftp", conntrack_ftp_helper },
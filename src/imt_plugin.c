@@ -32,7 +32,7 @@
 /* Functions */
 void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr) 
 {
-  int maxqsize = (MAX_QUERIES*sizeof(struct pkt_primitives))+sizeof(struct query_header)+2;
+  int maxqsize = (MAX_QUERIES*sizeof(struct pkt_primitives))+sizeof(struct query_header)+sizeof(struct query_stream)+2;
   struct sockaddr cAddr;
   struct pkt_data *data;
   struct ports_table pt;
@@ -60,6 +60,7 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   char *pcust, empty_pcust[] = "";
   struct pkt_vlen_hdr_primitives *pvlen, empty_pvlen;
   struct networks_file_data nfd;
+  struct timespec stats_ts;
   struct primitives_ptrs prim_ptrs;
   struct plugins_list_entry *plugin_data = ((struct channels_list_entry *)ptr)->plugin;
 
@@ -154,6 +155,16 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
     }
   }
 
+  /* a memory pool smaller than a hugepage would waste most of it */
+  if (config.hugepages) {
+    u_int64_t hp_size = (config.hugepages == HUGEPAGES_1G ? HUGEPAGES_1G_SIZE : HUGEPAGES_2M_SIZE);
+
+    if (config.memory_pool_size < hp_size) {
+      Log(LOG_INFO, "INFO ( %s/%s ): plugin_hugepages: memory pool size raised to %llu bytes.\n", config.name, config.type, hp_size);
+      config.memory_pool_size = hp_size;
+    }
+  }
+
   if (!config.imt_plugin_path) config.imt_plugin_path = path; 
   if (!config.buckets) config.buckets = MAX_HOSTS;
 
@@ -203,6 +214,15 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   sd = build_query_server(config.imt_plugin_path);
   cLen = sizeof(cAddr);
 
+  if (config.imt_snapshot_refresh_time) {
+#if defined ENABLE_THREADS
+    imt_query_thread_wrapper();
+#else
+    Log(LOG_WARNING, "WARN ( %s/%s ): 'imt_snapshot_refresh_time' requires --enable-threads. Ignoring.\n", config.name, config.type);
+    config.imt_snapshot_refresh_time = 0;
+#endif
+  }
+
   qh = (struct query_header *) srvbuf;
 
   /* plugin main loop */
@@ -267,7 +287,10 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
       }
 
       request = qh->type;
-      if (request & WANT_RESET) request ^= WANT_RESET;
+      if (request & WANT_RESET) {
+	request ^= WANT_RESET;
+	imt_snapshot_invalidate();
+      }
       if (request & WANT_LOCK_OP) {
 	lock = TRUE;
 	request ^= WANT_LOCK_OP;
@@ -281,6 +304,9 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	   lock.
 	 - if query is matter of just a single short-lived walk through the
 	   table, we avoid fork(): the plugin will serve the request;
+	 - if snapshots are enabled, read-only queries are handed over to
+	   the query thread and served off a copy of the table at most
+	   imt_snapshot_refresh_time seconds old;
          - in all other cases, we fork; the newly created child will serve
 	   queries asyncronously.
       */
@@ -288,7 +314,7 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
       if (request & WANT_ERASE) {
 	request ^= WANT_ERASE;
 	if (request) {
-	  if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE);
+	  if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE, NULL);
 	  else Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d incoming bytes. Errno: %d\n", config.name, config.type, num, errno);
 	}
 	Log(LOG_DEBUG, "DEBUG ( %s/%s ): Closing connection with client ...\n", config.name, config.type);
@@ -296,26 +322,32 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
       }
       else if (((request == WANT_COUNTER) || (request == WANT_MATCH)) &&
 	(qh->num == 1) && (qh->what_to_count == config.what_to_count)) {
-	if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE);
+	if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE, NULL);
         else Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d incoming bytes. ERRNO: %d\n", config.name, config.type, num, errno);
         Log(LOG_DEBUG, "DEBUG ( %s/%s ): Closing connection with client ...\n", config.name, config.type);
       } 
       else if (request == WANT_CLASS_TABLE) {
-	if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE);
+	if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE, NULL);
         else Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d incoming bytes. ERRNO: %d\n", config.name, config.type, num, errno);
         Log(LOG_DEBUG, "DEBUG ( %s/%s ): Closing connection with client ...\n", config.name, config.type);
       }
       else if (request == WANT_PKT_LEN_DISTRIB_TABLE) {
-        if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE);
+        if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE, NULL);
         else Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d incoming bytes. ERRNO: %d\n", config.name, config.type, num, errno);
         Log(LOG_DEBUG, "DEBUG ( %s/%s ): Closing connection with client ...\n", config.name, config.type);
       }
       else {
 	if (lock) {
-	  if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE);
+	  if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE, NULL);
           else Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d incoming bytes. Errno: %d\n", config.name, config.type, num, errno);
           Log(LOG_DEBUG, "DEBUG ( %s/%s ): Closing connection with client ...\n", config.name, config.type);
 	}
+#if defined ENABLE_THREADS
+	else if (config.imt_snapshot_refresh_time && !(qh->type & WANT_RESET) && num > 0) {
+	  imt_query_enqueue(sd2, srvbuf, num, &extras, datasize);
+	  sd2 = ERR; /* now owned by the query thread */
+	}
+#endif
 	else { 
           switch (fork()) {
 	  case -1: /* Something went wrong */
@@ -324,7 +356,7 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
           case 0: /* Child */
             close(sd);
 	    pm_setproctitle("%s [%s]", "IMT Plugin -- serving client", config.name);
-            if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, TRUE);
+            if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, TRUE, NULL);
 	    else Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d incoming bytes. Errno: %d\n", config.name, config.type, num, errno);
             Log(LOG_DEBUG, "DEBUG ( %s/%s ): Closing connection with client ...\n", config.name, config.type);
             close(sd2);
@@ -334,7 +366,7 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
           } 
 	}
       }
-      close(sd2);
+      if (sd2 != ERR) close(sd2);
     }
 
     /* clearing stats if requested */
@@ -344,6 +376,7 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
       /* XXX: given the current use of empty_* vars we have always to
          free_extra_allocs() in order to prevent memory leaks */
 
+      imt_snapshot_invalidate();
       free_extra_allocs(); 
       clear_memory_pool_table();
       current_pool = request_memory_pool(config.buckets*sizeof(struct acc));
@@ -369,6 +402,14 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
       reload_map = FALSE;
     }
 
+#if defined ENABLE_THREADS
+    /* queries are served off the ingest path: the snapshot is built once the
+       pipe goes idle or, under sustained load, after IMT_QUERY_MAX_DEFER secs */
+    if (imt_query_pending_head && (!(poll_fd[0].revents & POLLIN) ||
+	(cycle_stamp.tv_sec - imt_query_pending_head->stamp) >= IMT_QUERY_MAX_DEFER))
+      imt_query_dispatch(&extras);
+#endif
+
     if (poll_fd[0].revents & POLLIN) {
       read_data:
       if (config.pipe_homegrown) {
@@ -447,8 +488,10 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	    pvlen = (struct pkt_vlen_hdr_primitives *) ((u_char *)data + extras.off_pkt_vlen_hdr_primitives); 
 	  else pvlen = &empty_pvlen;
 
+	  if (net_funcs[0]) STATS_START(stats_ts);
 	  for (num = 0; net_funcs[num]; num++)
 	    (*net_funcs[num])(&nt, &nc, &data->primitives, pbgp, &nfd);
+	  if (net_funcs[0]) STATS_STOP(STATS_NET, stats_ts);
 
 	  if (config.ports_file) {
 	    if (!pt.table[data->primitives.src_port]) data->primitives.src_port = 0;
@@ -468,7 +511,9 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	  prim_ptrs.pcust = pcust;
 	  prim_ptrs.pvlen = pvlen;
 	  
+          STATS_START(stats_ts);
           (*imt_insert_func)(&prim_ptrs);
+          STATS_STOP(STATS_INSERT, stats_ts);
 
 	  ((struct ch_buf_hdr *)pipebuf)->num--;
 	  if (((struct ch_buf_hdr *)pipebuf)->num) {
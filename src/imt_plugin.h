@@ -20,12 +20,22 @@
 */
 
 #include <sys/poll.h>
+#if defined ENABLE_THREADS
+#include "thread_pool.h"
+#endif
 
 /* defines */
 #define NUM_MEMORY_POOLS 16
 #define MEMORY_POOL_SIZE 8192
 #define MAX_HOSTS 32771 
 #define MAX_QUERIES 4096
+#define IMT_SNAPSHOT_MAX_INDEXES 6
+#define IMT_QUERY_MAX_DEFER 1 /* secs a query may wait for the snapshot build */
+
+/* WANT_STREAM reply frames */
+#define QUERY_FRAME_HEADER	1
+#define QUERY_FRAME_DATA	2
+#define QUERY_FRAME_END		3
 
 /* Structures */
 struct acc {
@@ -87,11 +97,32 @@ struct query_entry {
   struct pkt_vlen_hdr_primitives *pvlen;	/* variable-length data */
 };
 
+/* WANT_STREAM parameters, sent after the query entries */
+struct query_stream {
+  u_int64_t cursor;			/* records to skip */
+  u_int32_t page_size;			/* max records per reply, 0 for no limit */
+  u_int32_t topN;			/* rank only the N largest entries, 0 for all */
+  u_int8_t topN_counter;		/* rank by: 1 bytes, 2 packets, 3 flows; 0 for table order */
+  u_int8_t filter_counter;		/* filter by: 1 bytes, 2 packets, 3 flows; 0 for none */
+  pm_counter_t filter_min;		/* minimum value of filter_counter */
+};
+
+struct query_frame {
+  u_int32_t type;
+  u_int32_t len;			/* payload length, frame header excluded */
+};
+
+struct query_stream_end {
+  u_int64_t next_cursor;		/* cursor for the next page, 0 if no more records */
+  u_int64_t records;			/* records sent in this reply */
+};
+
 struct reply_buffer {
   unsigned char buf[LARGEBUFLEN];
   unsigned char *ptr;
   int len;
   int packed; 
+  int framed;				/* WANT_STREAM: flush as QUERY_FRAME_DATA */
 };
 
 struct stripped_class {
@@ -121,6 +152,42 @@ struct imt_custom_primitives {
   int num;
 };
 
+/* chained index over snapshot entries; positions are stored +1 so that 0 ends a chain */
+struct imt_snapshot_index {
+  pm_cfgreg_t type;			/* indexed primitive, ie. COUNT_SRC_HOST; 0 for signature */
+  u_int32_t modulo;
+  u_int32_t *head;			/* first entry in each slot */
+  u_int32_t *next;			/* next entry in the same slot */
+};
+
+/* read-only copy of the non-zero entries of the accounting table */
+struct imt_snapshot {
+  struct acc *entries;
+  u_int32_t num;
+  struct bucket_desc *bdesc;		/* pre-composed WANT_STATUS reply */
+  struct imt_snapshot_index exact;
+  struct imt_snapshot_index index[IMT_SNAPSHOT_MAX_INDEXES];
+  int num_indexes;
+  struct pkt_bgp_primitives *pbgp;	/* backing storage for entries' extras */
+  struct pkt_nat_primitives *pnat;
+  struct pkt_mpls_primitives *pmpls;
+  struct pkt_tunnel_primitives *ptun;
+  char *pcust;
+  struct timeval stamp;
+  int refcnt;
+};
+
+struct imt_query_job {
+  int sd;
+  unsigned char *buf;
+  int len;
+  struct extra_primitives extras;
+  int datasize;
+  struct imt_snapshot *snap;
+  time_t stamp;
+  struct imt_query_job *next;
+};
+
 /* prototypes */
 #if (!defined __ACCT_C)
 #define EXT extern
@@ -128,6 +195,7 @@ struct imt_custom_primitives {
 #define EXT
 #endif
 EXT void insert_accounting_structure(struct primitives_ptrs *);
+EXT unsigned int hash_accounting_structure(struct primitives_ptrs *);
 EXT struct acc *search_accounting_structure(struct primitives_ptrs *);
 EXT int compare_accounting_structure(struct acc *, struct primitives_ptrs *);
 #undef EXT
@@ -150,13 +218,44 @@ EXT struct memory_pool_desc *request_memory_pool(int);
 EXT void set_reset_flag(struct acc *);
 EXT void reset_counters(struct acc *);
 EXT int build_query_server(char *);
-EXT void process_query_data(int, unsigned char *, int, struct extra_primitives *, int, int);
+EXT void process_query_data(int, unsigned char *, int, struct extra_primitives *, int, int, struct imt_snapshot *);
 EXT void mask_elem(struct pkt_primitives *, struct pkt_bgp_primitives *, struct pkt_legacy_bgp_primitives *,
 			struct pkt_nat_primitives *, struct pkt_mpls_primitives *, struct pkt_tunnel_primitives *,
 			struct acc *, u_int64_t, u_int64_t, struct extra_primitives *);
+EXT int match_elem(struct acc *, struct query_entry *, struct extra_primitives *);
 EXT void enQueue_elem(int, struct reply_buffer *, void *, int, int);
+EXT void reply_buffer_flush(int, struct reply_buffer *);
+EXT void send_query_frame(int, u_int32_t, void *, u_int32_t);
+EXT void process_stream_query(int, struct reply_buffer *, unsigned char *, int, struct extra_primitives *, int, struct imt_snapshot *);
+EXT int stream_test_elem(struct acc *, struct query_entry *, u_int32_t, struct query_stream *, struct extra_primitives *);
+EXT pm_counter_t stream_counter(struct acc *, int);
+EXT void stream_heap_sift_up(struct acc **, u_int32_t, int);
+EXT void stream_heap_sift_down(struct acc **, u_int32_t, u_int32_t, int);
+EXT void enQueue_acc(int, struct reply_buffer *, struct acc *, struct extra_primitives *, int);
 EXT void Accumulate_Counters(struct pkt_data *, struct acc *);
 EXT int test_zero_elem(struct acc *);
+EXT struct imt_snapshot *imt_snapshot_build(struct extra_primitives *);
+EXT void imt_snapshot_index_build(struct imt_snapshot *, struct imt_snapshot_index *, pm_cfgreg_t);
+EXT u_int32_t imt_snapshot_key(pm_cfgreg_t, struct pkt_primitives *, struct pkt_bgp_primitives *);
+EXT struct imt_snapshot_index *imt_snapshot_select_index(struct imt_snapshot *, struct query_entry *);
+EXT struct acc *imt_snapshot_search(struct imt_snapshot *, struct primitives_ptrs *);
+EXT void imt_snapshot_release(struct imt_snapshot *);
+EXT void imt_snapshot_invalidate();
+#if defined ENABLE_THREADS
+EXT void imt_query_thread_wrapper();
+EXT void imt_query_daemon();
+EXT void imt_query_enqueue(int, unsigned char *, int, struct extra_primitives *, int);
+EXT void imt_query_dispatch(struct extra_primitives *);
+#endif
+
+EXT struct imt_snapshot *imt_snap_current; /* most recent snapshot handed to the query thread */
+#if defined ENABLE_THREADS
+EXT thread_pool_t *imt_query_pool;
+EXT pthread_mutex_t imt_query_mutex; /* protects the job queue and snapshot reference counts */
+EXT pthread_cond_t imt_query_cond;
+EXT struct imt_query_job *imt_query_head, *imt_query_tail;
+EXT struct imt_query_job *imt_query_pending_head, *imt_query_pending_tail; /* waiting for a snapshot; main loop only */
+#endif
 #undef EXT
 
 #if (!defined __IMT_PLUGIN_C)
@@ -29,17 +29,15 @@
 #include "classifier.h"
 #include "jhash.h"
 
-u_int32_t flt_total_nodes;  
-time_t flt_prune_deadline;
-time_t flt_emergency_prune;
+PM_TLS u_int32_t flt_total_nodes;  
+PM_TLS time_t flt_emergency_prune;
 time_t flow_generic_lifetime;
 time_t flow_tcpest_lifetime;
 u_int32_t flt_trivial_hash_rnd = 140281; /* ummmh */
 
 #if defined ENABLE_IPV6
-u_int32_t flt6_total_nodes;
-time_t flt6_prune_deadline;
-time_t flt6_emergency_prune;
+PM_TLS u_int32_t flt6_total_nodes;
+PM_TLS time_t flt6_emergency_prune;
 #endif
 
 void init_ip_flow_handler()
@@ -63,10 +61,8 @@ void init_ip4_flow_handler()
   assert(ip_flow_table);
 
   memset(ip_flow_table, 0, size);
-  flow_lru_list.root = (struct ip_flow *) malloc(sizeof(struct ip_flow)); 
-  flow_lru_list.last = flow_lru_list.root;
-  memset(flow_lru_list.root, 0, sizeof(struct ip_flow));
-  flt_prune_deadline = time(NULL)+FLOW_TABLE_PRUNE_INTERVAL;
+  pm_timer_wheel_init(&flow_wheel, TW_DEFAULT_SLOTS, time(NULL));
+  pm_slab_init(&flow_slab, sizeof(struct ip_flow));
   flt_emergency_prune = 0; 
 
   if (config.flow_lifetime) flow_generic_lifetime = config.flow_lifetime;
@@ -85,10 +81,8 @@ void ip_flow_handler(struct packet_ptrs *pptrs)
 
   gettimeofday(&now, NULL);
 
-  if (now.tv_sec > flt_prune_deadline) {
-    prune_old_flows(&now);
-    flt_prune_deadline = now.tv_sec+FLOW_TABLE_PRUNE_INTERVAL;
-  }
+  /* a no-op unless the clock ticked */
+  prune_old_flows(&now);
 
   find_flow(&now, pptrs);
 }
@@ -159,6 +153,7 @@ void find_flow(struct timeval *now, struct packet_ptrs *pptrs)
 	evaluate_tcp_flags(now, pptrs, &fp->cmn, idx);
 	fp->cmn.last[idx].tv_sec = now->tv_sec;
 	fp->cmn.last[idx].tv_usec = now->tv_usec;
+	refresh_flow_timer(&flow_wheel, &fp->tmr, &fp->cmn);
 	pptrs->new_flow = FALSE; 
 	if (config.classifiers_path) evaluate_classifiers(pptrs, &fp->cmn, idx);
 	return;
@@ -169,6 +164,7 @@ void find_flow(struct timeval *now, struct packet_ptrs *pptrs)
 	evaluate_tcp_flags(now, pptrs, &fp->cmn, idx);
 	fp->cmn.last[idx].tv_sec = now->tv_sec;
 	fp->cmn.last[idx].tv_usec = now->tv_usec;
+	refresh_flow_timer(&flow_wheel, &fp->tmr, &fp->cmn);
 	pptrs->new_flow = TRUE;
 	if (config.classifiers_path) evaluate_classifiers(pptrs, &fp->cmn, idx);
 	return;
@@ -191,7 +187,6 @@ void create_flow(struct timeval *now, struct ip_flow *fp, u_int8_t is_candidate,
     if (now->tv_sec > flt_emergency_prune+FLOW_TABLE_EMER_PRUNE_INTERVAL) {
       Log(LOG_INFO, "INFO ( %s/core ): Flow/4 buffer full. Skipping flows.\n", config.name); 
       flt_emergency_prune = now->tv_sec;
-      prune_old_flows(now);
     }
     pptrs->new_flow = FALSE; 
     return;
@@ -199,14 +194,13 @@ void create_flow(struct timeval *now, struct ip_flow *fp, u_int8_t is_candidate,
 
   if (fp) {
     /* a 'not candidate' is simply the tail (last node) of the
-       list. We need to allocate a new node */
+       bucket. We need to allocate a new node */
     if (!is_candidate) { 
-      newf = (struct ip_flow *) malloc(sizeof(struct ip_flow));
+      newf = (struct ip_flow *) pm_slab_alloc(&flow_slab);
       if (!newf) { 
 	if (now->tv_sec > flt_emergency_prune+FLOW_TABLE_EMER_PRUNE_INTERVAL) {
 	  Log(LOG_INFO, "INFO ( %s/core ): Flow/4 buffer finished memory. Skipping flows.\n", config.name);
 	  flt_emergency_prune = now->tv_sec;
-	  prune_old_flows(now);
 	}
 	pptrs->new_flow = FALSE;
 	return;
@@ -215,20 +209,9 @@ void create_flow(struct timeval *now, struct ip_flow *fp, u_int8_t is_candidate,
       memset(newf, 0, sizeof(struct ip_flow));
       fp->next = newf;
       newf->prev = fp;  
-      flow_lru_list.last->lru_next = newf; /* placing new node as LRU tail */
-      newf->lru_prev = flow_lru_list.last;
-      flow_lru_list.last = newf;
       fp = newf;
     }
     else {
-      if (fp->lru_next) { /* if fp->lru_next==NULL the node is already the tail */ 
-        fp->lru_prev->lru_next = fp->lru_next; 
-	fp->lru_next->lru_prev = fp->lru_prev;
-	flow_lru_list.last->lru_next = fp;
-	fp->lru_prev = flow_lru_list.last;
-	fp->lru_next = NULL;
-	flow_lru_list.last = fp;
-      }
       clear_context_chain(&fp->cmn, 0);
       clear_context_chain(&fp->cmn, 1);
       memset(&fp->cmn, 0, sizeof(struct ip_flow_common));
@@ -238,12 +221,11 @@ void create_flow(struct timeval *now, struct ip_flow *fp, u_int8_t is_candidate,
     /*	we don't have any pointer to existing flows; this is because the
 	current bucket doesn't contain any node; we'll allocate the first
 	one */ 
-    fp = (struct ip_flow *) malloc(sizeof(struct ip_flow));  
+    fp = (struct ip_flow *) pm_slab_alloc(&flow_slab);  
     if (!fp) {
       if (now->tv_sec > flt_emergency_prune+FLOW_TABLE_EMER_PRUNE_INTERVAL) {
         Log(LOG_INFO, "INFO ( %s/core ): Flow/4 buffer finished memory. Skipping flows.\n", config.name);
         flt_emergency_prune = now->tv_sec;
-        prune_old_flows(now);
       }
       pptrs->new_flow = FALSE;
       return;
@@ -251,9 +233,6 @@ void create_flow(struct timeval *now, struct ip_flow *fp, u_int8_t is_candidate,
     else flt_total_nodes--;
     memset(fp, 0, sizeof(struct ip_flow));
     ip_flow_table[bucket] = fp;
-    flow_lru_list.last->lru_next = fp; /* placing new node as LRU tail */ 
-    fp->lru_prev = flow_lru_list.last;
-    flow_lru_list.last = fp;
   }
 
   fp->ip_src = iphp->ip_src.s_addr;
@@ -265,6 +244,7 @@ void create_flow(struct timeval *now, struct ip_flow *fp, u_int8_t is_candidate,
   evaluate_tcp_flags(now, pptrs, &fp->cmn, idx); 
   fp->cmn.last[idx].tv_sec = now->tv_sec; 
   fp->cmn.last[idx].tv_usec = now->tv_usec; 
+  pm_timer_add(&flow_wheel, &fp->tmr, flow_deadline(&fp->cmn));
 
   pptrs->new_flow = TRUE;
   if (config.classifiers_path) evaluate_classifiers(pptrs, &fp->cmn, idx); 
@@ -272,49 +252,36 @@ void create_flow(struct timeval *now, struct ip_flow *fp, u_int8_t is_candidate,
 
 void prune_old_flows(struct timeval *now)
 {
-  struct ip_flow *fp, *temp, *last_seen = flow_lru_list.root;
-
-  fp = flow_lru_list.root->lru_next;
-  while (fp) {
-    if (is_expired(now, &fp->cmn)) {
-      /* we found a stale element; we'll prune it */
-      if (fp->lru_next) temp = fp->lru_next;
-      else temp = NULL;
-
-      /* rearranging bucket's pointers */ 
-      if (fp->prev && fp->next) {
-	fp->prev->next = fp->next;
-        fp->next->prev = fp->prev;
-      }
-      else if (fp->prev) fp->prev->next = NULL;
-      else if (fp->next) {
-	ip_flow_table[fp->cmn.bucket] = fp->next;
-	fp->next->prev = NULL; 
-      }
-      else ip_flow_table[fp->cmn.bucket] = NULL;
+  pm_timer_wheel_expire(&flow_wheel, now->tv_sec, expire_flow);
+}
 
-      /* rearranging LRU pointers */
-      if (fp->lru_next) {
-        fp->lru_next->lru_prev = fp->lru_prev;
-        fp->lru_prev->lru_next = fp->lru_next;
-      }
-      else fp->lru_prev->lru_next = NULL;
+void expire_flow(struct pm_timer *t, time_t now)
+{
+  struct ip_flow *fp = (struct ip_flow *) ((char *) t - offsetof(struct ip_flow, tmr));
+  time_t deadline = flow_deadline(&fp->cmn);
 
-      clear_context_chain(&fp->cmn, 0);
-      clear_context_chain(&fp->cmn, 1);
-      free(fp);
-      flt_total_nodes++;
+  /* the flow saw traffic since the timer was armed */
+  if (deadline > now) {
+    pm_timer_add(&flow_wheel, t, deadline);
+    return;
+  }
 
-      if (temp) fp = temp;
-      else fp = NULL;
-    }
-    else {
-      last_seen = fp;
-      fp = fp->lru_next;
-    }
+  /* rearranging bucket's pointers */ 
+  if (fp->prev && fp->next) {
+    fp->prev->next = fp->next;
+    fp->next->prev = fp->prev;
   }
+  else if (fp->prev) fp->prev->next = NULL;
+  else if (fp->next) {
+    ip_flow_table[fp->cmn.bucket] = fp->next;
+    fp->next->prev = NULL; 
+  }
+  else ip_flow_table[fp->cmn.bucket] = NULL;
 
-  flow_lru_list.last = last_seen;
+  clear_context_chain(&fp->cmn, 0);
+  clear_context_chain(&fp->cmn, 1);
+  pm_slab_free(&flow_slab, fp);
+  flt_total_nodes++;
 }
 
 unsigned int normalize_flow(u_int32_t *ip_src, u_int32_t *ip_dst,
@@ -393,6 +360,43 @@ unsigned int is_expired_uni(struct timeval *now, struct ip_flow_common *fp, unsi
   return FALSE;
 }
 
+/* flow_deadline() returns the first second at which is_expired() holds true for
+   the bi-directional flow; flow_deadline_uni() does the same for one direction */
+time_t flow_deadline(struct ip_flow_common *fp)
+{
+  time_t forward, reverse;
+
+  forward = flow_deadline_uni(fp, 0);
+  reverse = flow_deadline_uni(fp, 1);
+
+  return MAX(forward, reverse);
+}
+
+time_t flow_deadline_uni(struct ip_flow_common *fp, unsigned int idx)
+{
+  time_t lifetime;
+
+  if (fp->proto == IPPROTO_TCP) {
+    lifetime = flow_tcpest_lifetime;
+
+    if (fp->tcp_flags[idx] & TH_SYN) lifetime = MIN(lifetime, FLOW_TCPSYN_LIFETIME);
+    if (fp->tcp_flags[idx] & TH_FIN) lifetime = MIN(lifetime, FLOW_TCPFIN_LIFETIME);
+    if (fp->tcp_flags[idx] & TH_RST) lifetime = MIN(lifetime, FLOW_TCPRST_LIFETIME);
+  }
+  else lifetime = flow_generic_lifetime;
+
+  return fp->last[idx].tv_sec+lifetime+1;
+}
+
+/* refresh_flow_timer() re-arms the timer only when the flow got closer to its
+   end, ie. FIN/RST seen; extensions are dealt with lazily upon expiry */
+void refresh_flow_timer(struct pm_timer_wheel *tw, struct pm_timer *t, struct ip_flow_common *fp)
+{
+  time_t deadline = flow_deadline(fp);
+
+  if (deadline < t->deadline) pm_timer_add(tw, t, deadline);
+}
+
 #if defined ENABLE_IPV6
 void init_ip6_flow_handler()
 {
@@ -406,10 +410,8 @@ void init_ip6_flow_handler()
   ip_flow_table6 = (struct ip_flow6 **) malloc(size);
 
   memset(ip_flow_table6, 0, size);
-  flow_lru_list6.root = (struct ip_flow6 *) malloc(sizeof(struct ip_flow6));
-  flow_lru_list6.last = flow_lru_list6.root;
-  memset(flow_lru_list6.root, 0, sizeof(struct ip_flow6));
-  flt6_prune_deadline = time(NULL)+FLOW_TABLE_PRUNE_INTERVAL;
+  pm_timer_wheel_init(&flow_wheel6, TW_DEFAULT_SLOTS, time(NULL));
+  pm_slab_init(&flow_slab6, sizeof(struct ip_flow6));
   flt6_emergency_prune = 0;
 
   if (config.flow_lifetime) flow_generic_lifetime = config.flow_lifetime;
@@ -428,10 +430,8 @@ void ip_flow6_handler(struct packet_ptrs *pptrs)
 
   gettimeofday(&now, NULL);
 
-  if (now.tv_sec > flt6_prune_deadline) {
-    prune_old_flows6(&now);
-    flt6_prune_deadline = now.tv_sec+FLOW_TABLE_PRUNE_INTERVAL;
-  }
+  /* a no-op unless the clock ticked */
+  prune_old_flows6(&now);
 
   find_flow6(&now, pptrs);
 }
@@ -518,6 +518,7 @@ void find_flow6(struct timeval *now, struct packet_ptrs *pptrs)
 	evaluate_tcp_flags(now, pptrs, &fp->cmn, idx);
 	fp->cmn.last[idx].tv_sec = now->tv_sec;
 	fp->cmn.last[idx].tv_usec = now->tv_usec;
+	refresh_flow_timer(&flow_wheel6, &fp->tmr, &fp->cmn);
 	pptrs->new_flow = FALSE;
 	if (config.classifiers_path) evaluate_classifiers(pptrs, &fp->cmn, idx);
 	return;
@@ -528,6 +529,7 @@ void find_flow6(struct timeval *now, struct packet_ptrs *pptrs)
 	evaluate_tcp_flags(now, pptrs, &fp->cmn, idx);
 	fp->cmn.last[idx].tv_sec = now->tv_sec;
 	fp->cmn.last[idx].tv_usec = now->tv_usec;
+	refresh_flow_timer(&flow_wheel6, &fp->tmr, &fp->cmn);
 	pptrs->new_flow = TRUE;
 	if (config.classifiers_path) evaluate_classifiers(pptrs, &fp->cmn, idx);
 	return;
@@ -551,7 +553,6 @@ void create_flow6(struct timeval *now, struct ip_flow6 *fp, u_int8_t is_candidat
     if (now->tv_sec > flt6_emergency_prune+FLOW_TABLE_EMER_PRUNE_INTERVAL) {
       Log(LOG_INFO, "INFO ( %s/core ): Flow/6 buffer full. Skipping flows.\n", config.name);
       flt6_emergency_prune = now->tv_sec;
-      prune_old_flows6(now);
     }
     pptrs->new_flow = FALSE;
     return;
@@ -559,50 +560,38 @@ void create_flow6(struct timeval *now, struct ip_flow6 *fp, u_int8_t is_candidat
 
   if (fp) {
     /* a 'not candidate' is simply the tail (last node) of the
-       list. We need to allocate a new node */
-    if (!is_candidate) {
-      newf = (struct ip_flow6 *) malloc(sizeof(struct ip_flow6));
-      if (!newf) {
+       bucket. We need to allocate a new node */
+    if (!is_candidate) { 
+      newf = (struct ip_flow6 *) pm_slab_alloc(&flow_slab6);
+      if (!newf) { 
 	if (now->tv_sec > flt6_emergency_prune+FLOW_TABLE_EMER_PRUNE_INTERVAL) {
 	  Log(LOG_INFO, "INFO ( %s/core ): Flow/6 buffer full. Skipping flows.\n", config.name);
 	  flt6_emergency_prune = now->tv_sec;
-	  prune_old_flows6(now);
 	}
-        pptrs->new_flow = FALSE;
+	pptrs->new_flow = FALSE;
 	return;
       }
       else flt6_total_nodes--;
       memset(newf, 0, sizeof(struct ip_flow6));
       fp->next = newf;
-      newf->prev = fp;
-      flow_lru_list6.last->lru_next = newf; /* placing new node as LRU tail */
-      newf->lru_prev = flow_lru_list6.last;
-      flow_lru_list6.last = newf;
+      newf->prev = fp;  
       fp = newf;
     }
     else {
-      if (fp->lru_next) { /* if fp->lru_next==NULL the node is already the tail */
-        fp->lru_prev->lru_next = fp->lru_next;
-        fp->lru_next->lru_prev = fp->lru_prev;
-        flow_lru_list6.last->lru_next = fp;
-        fp->lru_prev = flow_lru_list6.last;
-        fp->lru_next = NULL;
-        flow_lru_list6.last = fp;
-      }
       clear_context_chain(&fp->cmn, 0);
       clear_context_chain(&fp->cmn, 1);
       memset(&fp->cmn, 0, sizeof(struct ip_flow_common));
     }
   }
   else {
-    /* we don't have any fragment pointer; this is because current
-       bucket doesn't contain any node; we'll allocate first one */
-    fp = (struct ip_flow6 *) malloc(sizeof(struct ip_flow6));
+    /*	we don't have any pointer to existing flows; this is because the
+	current bucket doesn't contain any node; we'll allocate the first
+	one */ 
+    fp = (struct ip_flow6 *) pm_slab_alloc(&flow_slab6);  
     if (!fp) {
       if (now->tv_sec > flt6_emergency_prune+FLOW_TABLE_EMER_PRUNE_INTERVAL) {
         Log(LOG_INFO, "INFO ( %s/core ): Flow/6 buffer full. Skipping flows.\n", config.name);
         flt6_emergency_prune = now->tv_sec;
-        prune_old_flows6(now);
       }
       pptrs->new_flow = FALSE;
       return;
@@ -610,9 +599,6 @@ void create_flow6(struct timeval *now, struct ip_flow6 *fp, u_int8_t is_candidat
     else flt6_total_nodes--;
     memset(fp, 0, sizeof(struct ip_flow6));
     ip_flow_table6[bucket] = fp;
-    flow_lru_list6.last->lru_next = fp; /* placing new node as LRU tail */
-    fp->lru_prev = flow_lru_list6.last;
-    flow_lru_list6.last = fp;
   }
 
   ip6_addr_cpy(&fp->ip_src, &iphp->ip6_src);
@@ -624,6 +610,7 @@ void create_flow6(struct timeval *now, struct ip_flow6 *fp, u_int8_t is_candidat
   evaluate_tcp_flags(now, pptrs, &fp->cmn, idx);
   fp->cmn.last[idx].tv_sec = now->tv_sec;
   fp->cmn.last[idx].tv_usec = now->tv_usec;
+  pm_timer_add(&flow_wheel6, &fp->tmr, flow_deadline(&fp->cmn));
 
   pptrs->new_flow = TRUE;
   if (config.classifiers_path) evaluate_classifiers(pptrs, &fp->cmn, idx); 
@@ -631,48 +618,35 @@ void create_flow6(struct timeval *now, struct ip_flow6 *fp, u_int8_t is_candidat
 
 void prune_old_flows6(struct timeval *now)
 {
-  struct ip_flow6 *fp, *temp, *last_seen = flow_lru_list6.root;
-
-  fp = flow_lru_list6.root->lru_next;
-  while (fp) {
-    if (is_expired(now, &fp->cmn)) {
-      /* we found a stale element; we'll prune it */
-      if (fp->lru_next) temp = fp->lru_next;
-      else temp = NULL;
-
-      /* rearranging bucket's pointers */
-      if (fp->prev && fp->next) {
-        fp->prev->next = fp->next;
-        fp->next->prev = fp->prev;
-      }
-      else if (fp->prev) fp->prev->next = NULL;
-      else if (fp->next) {
-        ip_flow_table6[fp->cmn.bucket] = fp->next;
-        fp->next->prev = NULL;
-      }
-      else ip_flow_table6[fp->cmn.bucket] = NULL;
+  pm_timer_wheel_expire(&flow_wheel6, now->tv_sec, expire_flow6);
+}
 
-      /* rearranging LRU pointers */
-      if (fp->lru_next) {
-        fp->lru_next->lru_prev = fp->lru_prev;
-        fp->lru_prev->lru_next = fp->lru_next;
-      }
-      else fp->lru_prev->lru_next = NULL;
+void expire_flow6(struct pm_timer *t, time_t now)
+{
+  struct ip_flow6 *fp = (struct ip_flow6 *) ((char *) t - offsetof(struct ip_flow6, tmr));
+  time_t deadline = flow_deadline(&fp->cmn);
 
-      clear_context_chain(&fp->cmn, 0);
-      clear_context_chain(&fp->cmn, 1);
-      free(fp);
-      flt6_total_nodes++;
+  /* the flow saw traffic since the timer was armed */
+  if (deadline > now) {
+    pm_timer_add(&flow_wheel6, t, deadline);
+    return;
+  }
 
-      if (temp) fp = temp;
-      else fp = NULL;
-    }
-    else {
-      last_seen = fp;
-      fp = fp->lru_next;
-    }
+  /* rearranging bucket's pointers */ 
+  if (fp->prev && fp->next) {
+    fp->prev->next = fp->next;
+    fp->next->prev = fp->prev;
+  }
+  else if (fp->prev) fp->prev->next = NULL;
+  else if (fp->next) {
+    ip_flow_table6[fp->cmn.bucket] = fp->next;
+    fp->next->prev = NULL; 
   }
+  else ip_flow_table6[fp->cmn.bucket] = NULL;
 
-  flow_lru_list6.last = last_seen;
+  clear_context_chain(&fp->cmn, 0);
+  clear_context_chain(&fp->cmn, 1);
+  pm_slab_free(&flow_slab6, fp);
+  flt6_total_nodes++;
 }
 #endif
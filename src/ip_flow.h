@@ -29,7 +29,6 @@
 #define FLOW_TCPEST_LIFETIME 432000
 #define FLOW_TCPFIN_LIFETIME 30 
 #define FLOW_TCPRST_LIFETIME 10 
-#define FLOW_TABLE_PRUNE_INTERVAL 3600 
 #define FLOW_TABLE_EMER_PRUNE_INTERVAL 60
 #define DEFAULT_FLOW_BUFFER_SIZE 16384000 /* 16 Mb */
 
@@ -66,17 +65,11 @@ struct ip_flow {
   u_int16_t port_dst;
   char *bgp_src; /* pointer to bgp_node structure for source prefix, if any */
   char *bgp_dst; /* pointer to bgp_node structure for destination prefix, if any */
-  struct ip_flow *lru_next;
-  struct ip_flow *lru_prev;
+  struct pm_timer tmr;
   struct ip_flow *next;
   struct ip_flow *prev;
 };
 
-struct flow_lru_l {
-  struct ip_flow *root;
-  struct ip_flow *last;
-};
-
 #if defined ENABLE_IPV6
 struct ip_flow6 {
   struct ip_flow_common cmn;
@@ -84,16 +77,10 @@ struct ip_flow6 {
   u_int32_t ip_dst[4];
   u_int16_t port_src;
   u_int16_t port_dst;
-  struct ip_flow6 *lru_next;
-  struct ip_flow6 *lru_prev;
+  struct pm_timer tmr;
   struct ip_flow6 *next;
   struct ip_flow6 *prev;
 };
-
-struct flow_lru_l6 {
-  struct ip_flow6 *root;
-  struct ip_flow6 *last;
-};
 #endif
 
 #if (!defined __IP_FLOW_C)
@@ -108,11 +95,15 @@ EXT void ip_flow_handler(struct packet_ptrs *);
 EXT void find_flow(struct timeval *, struct packet_ptrs *); 
 EXT void create_flow(struct timeval *, struct ip_flow *, u_int8_t, unsigned int, struct packet_ptrs *, struct pm_iphdr *, struct pm_tlhdr *, unsigned int); 
 EXT void prune_old_flows(struct timeval *); 
+EXT void expire_flow(struct pm_timer *, time_t);
 
 EXT unsigned int hash_flow(u_int32_t, u_int32_t, u_int16_t, u_int16_t, u_int8_t);
 EXT unsigned int normalize_flow(u_int32_t *, u_int32_t *, u_int16_t *, u_int16_t *);
 EXT unsigned int is_expired(struct timeval *, struct ip_flow_common *);
 EXT unsigned int is_expired_uni(struct timeval *, struct ip_flow_common *, unsigned int);
+EXT time_t flow_deadline(struct ip_flow_common *);
+EXT time_t flow_deadline_uni(struct ip_flow_common *, unsigned int);
+EXT void refresh_flow_timer(struct pm_timer_wheel *, struct pm_timer *, struct ip_flow_common *);
 EXT void evaluate_tcp_flags(struct timeval *, struct packet_ptrs *, struct ip_flow_common *, unsigned int);
 EXT void clear_tcp_flow_cmn(struct ip_flow_common *, unsigned int);
 
@@ -124,15 +115,18 @@ EXT unsigned int normalize_flow6(struct in6_addr *, struct in6_addr *, u_int16_t
 EXT void find_flow6(struct timeval *, struct packet_ptrs *);
 EXT void create_flow6(struct timeval *, struct ip_flow6 *, u_int8_t, unsigned int, struct packet_ptrs *, struct ip6_hdr *, struct pm_tlhdr *, unsigned int);
 EXT void prune_old_flows6(struct timeval *); 
+EXT void expire_flow6(struct pm_timer *, time_t);
 #endif
 
 /* global vars */
-EXT struct ip_flow **ip_flow_table;
-EXT struct flow_lru_l flow_lru_list;
+EXT PM_TLS struct ip_flow **ip_flow_table;
+EXT PM_TLS struct pm_timer_wheel flow_wheel;
+EXT PM_TLS struct pm_slab flow_slab;
 
 #if defined ENABLE_IPV6
-EXT struct ip_flow6 **ip_flow_table6;
-EXT struct flow_lru_l6 flow_lru_list6;
+EXT PM_TLS struct ip_flow6 **ip_flow_table6;
+EXT PM_TLS struct pm_timer_wheel flow_wheel6;
+EXT PM_TLS struct pm_slab flow_slab6;
 #endif
 #undef EXT
 
@@ -29,15 +29,13 @@
 #include "ip_frag.h"
 #include "jhash.h"
 
-u_int32_t ipft_total_nodes;  
-time_t prune_deadline;
-time_t emergency_prune;
+PM_TLS u_int32_t ipft_total_nodes;  
+PM_TLS time_t emergency_prune;
 u_int32_t trivial_hash_rnd = 140281; /* ummmh */
 
 #if defined ENABLE_IPV6
-u_int32_t ipft6_total_nodes;
-time_t prune_deadline6;
-time_t emergency_prune6;
+PM_TLS u_int32_t ipft6_total_nodes;
+PM_TLS time_t emergency_prune6;
 #endif
 
 void init_ip_fragment_handler()
@@ -54,10 +52,8 @@ void init_ip4_fragment_handler()
   else ipft_total_nodes = DEFAULT_FRAG_BUFFER_SIZE / sizeof(struct ip_fragment); 
 
   memset(ipft, 0, sizeof(ipft));
-  lru_list.root = (struct ip_fragment *) malloc(sizeof(struct ip_fragment)); 
-  lru_list.last = lru_list.root;
-  memset(lru_list.root, 0, sizeof(struct ip_fragment));
-  prune_deadline = time(NULL)+PRUNE_INTERVAL;
+  pm_timer_wheel_init(&ipft_wheel, IPFT_WHEEL_SLOTS, time(NULL));
+  pm_slab_init(&ipft_slab, sizeof(struct ip_fragment));
   emergency_prune = 0;
 }
 
@@ -65,10 +61,7 @@ int ip_fragment_handler(struct packet_ptrs *pptrs)
 {
   u_int32_t now = time(NULL);
 
-  if (now > prune_deadline) {
-    prune_old_fragments(now, PRUNE_OFFSET);
-    prune_deadline = now+PRUNE_INTERVAL;
-  }
+  prune_old_fragments(now);
   return find_fragment(now, pptrs);
 }
 
@@ -147,21 +140,19 @@ int create_fragment(u_int32_t now, struct ip_fragment *fp, u_int8_t is_candidate
     if (now > emergency_prune+EMER_PRUNE_INTERVAL) {
       Log(LOG_INFO, "INFO ( %s/core ): Fragment/4 buffer full. Skipping fragments.\n", config.name);
       emergency_prune = now;
-      prune_old_fragments(now, 0);
     }
     return FALSE; 
   }
 
   if (fp) {
     /* a 'not candidate' is simply the tail (last node) of the
-       list. We need to allocate a new node */
+       bucket. We need to allocate a new node */
     if (!is_candidate) { 
-      newf = (struct ip_fragment *) malloc(sizeof(struct ip_fragment));
+      newf = (struct ip_fragment *) pm_slab_alloc(&ipft_slab);
       if (!newf) { 
 	if (now > emergency_prune+EMER_PRUNE_INTERVAL) {
 	  Log(LOG_INFO, "INFO ( %s/core ): Fragment/4 buffer full. Skipping fragments.\n", config.name);
 	  emergency_prune = now;
-	  prune_old_fragments(now, 0);
 	}
 	return FALSE;
       }
@@ -169,43 +160,27 @@ int create_fragment(u_int32_t now, struct ip_fragment *fp, u_int8_t is_candidate
       memset(newf, 0, sizeof(struct ip_fragment));
       fp->next = newf;
       newf->prev = fp;  
-      lru_list.last->lru_next = newf; /* placing new node as LRU tail */
-      newf->lru_prev = lru_list.last;
-      lru_list.last = newf;
       fp = newf;
     }
-    else {
-      if (fp->lru_next) { /* if fp->lru_next==NULL the node is already the tail */ 
-        fp->lru_prev->lru_next = fp->lru_next; 
-	fp->lru_next->lru_prev = fp->lru_prev;
-	lru_list.last->lru_next = fp;
-	fp->lru_prev = lru_list.last;
-	fp->lru_next = NULL;
-	lru_list.last = fp;
-      }
-    }
   }
   else {
     /* we don't have any fragment pointer; this is because current
        bucket doesn't contain any node; we'll allocate first one */ 
-    fp = (struct ip_fragment *) malloc(sizeof(struct ip_fragment));  
+    fp = (struct ip_fragment *) pm_slab_alloc(&ipft_slab);  
     if (!fp) {
       if (now > emergency_prune+EMER_PRUNE_INTERVAL) {
         Log(LOG_INFO, "INFO ( %s/core ): Fragment/4 buffer full. Skipping fragments.\n", config.name);
         emergency_prune = now;
-        prune_old_fragments(now, 0);
       }
       return FALSE;
     }
     else ipft_total_nodes--;
     memset(fp, 0, sizeof(struct ip_fragment));
     ipft[bucket] = fp;
-    lru_list.last->lru_next = fp; /* placing new node as LRU tail */ 
-    fp->lru_prev = lru_list.last;
-    lru_list.last = fp;
   }
 
   fp->deadline = now+IPF_TIMEOUT;
+  pm_timer_add(&ipft_wheel, &fp->tmr, fp->deadline+1);
   fp->ip_id = iphp->ip_id;
   fp->ip_p = iphp->ip_p;
   fp->ip_src = iphp->ip_src.s_addr;
@@ -228,44 +203,31 @@ int create_fragment(u_int32_t now, struct ip_fragment *fp, u_int8_t is_candidate
   }
 }
 
-void prune_old_fragments(u_int32_t now, u_int32_t off)
+void prune_old_fragments(u_int32_t now)
 {
-  struct ip_fragment *fp, *temp;
-  u_int32_t deadline = now-off;
-
-  fp = lru_list.root->lru_next;
-  while (fp) {
-    if (deadline > fp->deadline) {
-      /* we found a stale element; we'll prune it */
-      if (fp->lru_next) temp = fp->lru_next;
-      else temp = NULL;
-
-      /* rearranging bucket's pointers */ 
-      if (fp->prev && fp->next) {
-	fp->prev->next = fp->next;
-        fp->next->prev = fp->prev;
-      }
-      else if (fp->prev) fp->prev->next = NULL;
-      else if (fp->next) {
-	ipft[fp->bucket] = fp->next;
-	fp->next->prev = NULL; 
-      }
-      else ipft[fp->bucket] = NULL;
+  pm_timer_wheel_expire(&ipft_wheel, now, expire_fragment);
+}
 
-      free(fp);
-      ipft_total_nodes++;
+void expire_fragment(struct pm_timer *t, time_t now)
+{
+  struct ip_fragment *fp = (struct ip_fragment *) ((char *) t - offsetof(struct ip_fragment, tmr));
 
-      if (temp) fp = temp;
-      else fp = NULL;
-    }
-    else break;
-  }
+  if (!fp->got_first) notify_orphan_fragment(fp);
 
-  if (fp) {
-    fp->lru_prev = lru_list.root;
-    lru_list.root->lru_next = fp;
+  /* rearranging bucket's pointers */ 
+  if (fp->prev && fp->next) {
+    fp->prev->next = fp->next;
+    fp->next->prev = fp->prev;
+  }
+  else if (fp->prev) fp->prev->next = NULL;
+  else if (fp->next) {
+    ipft[fp->bucket] = fp->next;
+    fp->next->prev = NULL; 
   }
-  else lru_list.last = lru_list.root;
+  else ipft[fp->bucket] = NULL;
+
+  pm_slab_free(&ipft_slab, fp);
+  ipft_total_nodes++;
 }
 
 /* hash_fragment() is taken (it has another name there) from Linux kernel 2.4;
@@ -298,10 +260,8 @@ void init_ip6_fragment_handler()
   else ipft6_total_nodes = DEFAULT_FRAG_BUFFER_SIZE / sizeof(struct ip6_fragment);
 
   memset(ipft6, 0, sizeof(ipft6));
-  lru_list6.root = (struct ip6_fragment *) malloc(sizeof(struct ip6_fragment));
-  lru_list6.last = lru_list6.root;
-  memset(lru_list6.root, 0, sizeof(struct ip6_fragment));
-  prune_deadline6 = time(NULL)+PRUNE_INTERVAL;
+  pm_timer_wheel_init(&ipft_wheel6, IPFT_WHEEL_SLOTS, time(NULL));
+  pm_slab_init(&ipft_slab6, sizeof(struct ip6_fragment));
   emergency_prune6 = 0;
 }
 
@@ -309,10 +269,7 @@ int ip6_fragment_handler(struct packet_ptrs *pptrs, struct ip6_frag *fhdr)
 {
   u_int32_t now = time(NULL);
 
-  if (now > prune_deadline6) {
-    prune_old_fragments6(now, PRUNE_OFFSET);
-    prune_deadline6 = now+PRUNE_INTERVAL;
-  }
+  prune_old_fragments6(now);
   return find_fragment6(now, pptrs, fhdr);
 }
 
@@ -408,21 +365,19 @@ int create_fragment6(u_int32_t now, struct ip6_fragment *fp, u_int8_t is_candida
     if (now > emergency_prune6+EMER_PRUNE_INTERVAL) {
       Log(LOG_INFO, "INFO ( %s/core ): Fragment/6 buffer full. Skipping fragments.\n", config.name);
       emergency_prune6 = now;
-      prune_old_fragments6(now, 0);
     }
     return FALSE;
   }
 
   if (fp) {
     /* a 'not candidate' is simply the tail (last node) of the
-       list. We need to allocate a new node */
+       bucket. We need to allocate a new node */
     if (!is_candidate) {
-      newf = (struct ip6_fragment *) malloc(sizeof(struct ip6_fragment));
+      newf = (struct ip6_fragment *) pm_slab_alloc(&ipft_slab6);
       if (!newf) {
 	if (now > emergency_prune6+EMER_PRUNE_INTERVAL) {
 	  Log(LOG_INFO, "INFO ( %s/core ): Fragment/6 buffer full. Skipping fragments.\n", config.name);
 	  emergency_prune6 = now;
-	  prune_old_fragments6(now, 0);
 	}
 	return FALSE;
       }
@@ -430,43 +385,27 @@ int create_fragment6(u_int32_t now, struct ip6_fragment *fp, u_int8_t is_candida
       memset(newf, 0, sizeof(struct ip6_fragment));
       fp->next = newf;
       newf->prev = fp;
-      lru_list6.last->lru_next = newf; /* placing new node as LRU tail */
-      newf->lru_prev = lru_list6.last;
-      lru_list6.last = newf;
       fp = newf;
     }
-    else {
-      if (fp->lru_next) { /* if fp->lru_next==NULL the node is already the tail */
-        fp->lru_prev->lru_next = fp->lru_next;
-        fp->lru_next->lru_prev = fp->lru_prev;
-        lru_list6.last->lru_next = fp;
-        fp->lru_prev = lru_list6.last;
-        fp->lru_next = NULL;
-        lru_list6.last = fp;
-      }
-    }
   }
   else {
     /* we don't have any fragment pointer; this is because current
        bucket doesn't contain any node; we'll allocate first one */
-    fp = (struct ip6_fragment *) malloc(sizeof(struct ip6_fragment));
+    fp = (struct ip6_fragment *) pm_slab_alloc(&ipft_slab6);
     if (!fp) {
       if (now > emergency_prune6+EMER_PRUNE_INTERVAL) {
         Log(LOG_INFO, "INFO ( %s/core ): Fragment/6 buffer full. Skipping fragments.\n", config.name);
         emergency_prune6 = now;
-        prune_old_fragments6(now, 0);
       }
       return FALSE;
     }
     else ipft6_total_nodes--;
     memset(fp, 0, sizeof(struct ip6_fragment));
     ipft6[bucket] = fp;
-    lru_list6.last->lru_next = fp; /* placing new node as LRU tail */
-    fp->lru_prev = lru_list6.last;
-    lru_list6.last = fp;
   }
 
   fp->deadline = now+IPF_TIMEOUT;
+  pm_timer_add(&ipft_wheel6, &fp->tmr, fp->deadline+1);
   fp->id = fhdr->ip6f_ident;
   ip6_addr_cpy(&fp->src, &iphp->ip6_src);
   ip6_addr_cpy(&fp->dst, &iphp->ip6_dst);
@@ -488,44 +427,31 @@ int create_fragment6(u_int32_t now, struct ip6_fragment *fp, u_int8_t is_candida
   }
 }
 
-void prune_old_fragments6(u_int32_t now, u_int32_t off)
+void prune_old_fragments6(u_int32_t now)
 {
-  struct ip6_fragment *fp, *temp;
-  u_int32_t deadline = now-off;
-
-  fp = lru_list6.root->lru_next;
-  while (fp) {
-    if (deadline > fp->deadline) {
-      /* we found a stale element; we'll prune it */
-      if (fp->lru_next) temp = fp->lru_next;
-      else temp = NULL;
-
-      /* rearranging bucket's pointers */
-      if (fp->prev && fp->next) {
-        fp->prev->next = fp->next;
-        fp->next->prev = fp->prev;
-      }
-      else if (fp->prev) fp->prev->next = NULL;
-      else if (fp->next) {
-        ipft6[fp->bucket] = fp->next;
-        fp->next->prev = NULL;
-      }
-      else ipft6[fp->bucket] = NULL;
+  pm_timer_wheel_expire(&ipft_wheel6, now, expire_fragment6);
+}
 
-      free(fp);
-      ipft6_total_nodes++;
+void expire_fragment6(struct pm_timer *t, time_t now)
+{
+  struct ip6_fragment *fp = (struct ip6_fragment *) ((char *) t - offsetof(struct ip6_fragment, tmr));
 
-      if (temp) fp = temp;
-      else fp = NULL;
-    }
-    else break;
-  }
+  if (!fp->got_first) notify_orphan_fragment6(fp);
 
-  if (fp) {
-    fp->lru_prev = lru_list6.root;
-    lru_list6.root->lru_next = fp;
+  /* rearranging bucket's pointers */ 
+  if (fp->prev && fp->next) {
+    fp->prev->next = fp->next;
+    fp->next->prev = fp->prev;
+  }
+  else if (fp->prev) fp->prev->next = NULL;
+  else if (fp->next) {
+    ipft6[fp->bucket] = fp->next;
+    fp->next->prev = NULL; 
   }
-  else lru_list6.last = lru_list6.root;
+  else ipft6[fp->bucket] = NULL;
+
+  pm_slab_free(&ipft_slab6, fp);
+  ipft6_total_nodes++;
 }
 
 void notify_orphan_fragment6(struct ip6_fragment *frag)
@@ -22,9 +22,8 @@
 /* defines */
 #define IPFT_HASHSZ 256 
 #define IPF_TIMEOUT 60 
-#define PRUNE_INTERVAL 7200
 #define EMER_PRUNE_INTERVAL 60
-#define PRUNE_OFFSET 1800 
+#define IPFT_WHEEL_SLOTS 256
 #define DEFAULT_FRAG_BUFFER_SIZE 4096000 /* 4 Mb */
 
 /* structures */
@@ -39,17 +38,11 @@ struct ip_fragment {
   u_int32_t ip_src;
   u_int32_t ip_dst;
   u_int16_t bucket;
-  struct ip_fragment *lru_next;
-  struct ip_fragment *lru_prev;
+  struct pm_timer tmr;
   struct ip_fragment *next;
   struct ip_fragment *prev;
 };
 
-struct lru_l {
-  struct ip_fragment *root;
-  struct ip_fragment *last;
-};
-
 #if defined ENABLE_IPV6
 struct ip6_fragment {
   unsigned char tlhdr[8];       /* upper level info */
@@ -61,16 +54,10 @@ struct ip6_fragment {
   u_int32_t src[4];
   u_int32_t dst[4];
   u_int16_t bucket;
-  struct ip6_fragment *lru_next;
-  struct ip6_fragment *lru_prev;
+  struct pm_timer tmr;
   struct ip6_fragment *next;
   struct ip6_fragment *prev;
 };
-
-struct lru_l6 {
-  struct ip6_fragment *root;
-  struct ip6_fragment *last;
-};
 #endif
 
 /* global vars */
@@ -79,12 +66,14 @@ struct lru_l6 {
 #else
 #define EXT
 #endif
-EXT struct ip_fragment *ipft[IPFT_HASHSZ];
-EXT struct lru_l lru_list;
+EXT PM_TLS struct ip_fragment *ipft[IPFT_HASHSZ];
+EXT PM_TLS struct pm_timer_wheel ipft_wheel;
+EXT PM_TLS struct pm_slab ipft_slab;
 
 #if defined ENABLE_IPV6
-EXT struct ip6_fragment *ipft6[IPFT_HASHSZ];
-EXT struct lru_l6 lru_list6;
+EXT PM_TLS struct ip6_fragment *ipft6[IPFT_HASHSZ];
+EXT PM_TLS struct pm_timer_wheel ipft_wheel6;
+EXT PM_TLS struct pm_slab ipft_slab6;
 #endif
 #undef EXT
 
@@ -100,7 +89,8 @@ EXT int ip_fragment_handler(struct packet_ptrs *);
 EXT int find_fragment(u_int32_t, struct packet_ptrs *); 
 EXT int create_fragment(u_int32_t, struct ip_fragment *, u_int8_t, unsigned int, struct packet_ptrs *); 
 EXT unsigned int hash_fragment(u_int16_t, u_int32_t, u_int32_t, u_int8_t);
-EXT void prune_old_fragments(u_int32_t, u_int32_t); 
+EXT void prune_old_fragments(u_int32_t); 
+EXT void expire_fragment(struct pm_timer *, time_t);
 EXT void notify_orphan_fragment(struct ip_fragment *);
 
 #if defined ENABLE_IPV6
@@ -109,7 +99,8 @@ EXT int ip6_fragment_handler6(struct packet_ptrs *, struct ip6_frag *);
 EXT unsigned int hash_fragment6(u_int32_t, struct in6_addr *, struct in6_addr *);
 EXT int find_fragment6(u_int32_t, struct packet_ptrs *, struct ip6_frag *);
 EXT int create_fragment6(u_int32_t, struct ip6_fragment *, u_int8_t, unsigned int, struct packet_ptrs *, struct ip6_frag *);
-EXT void prune_old_fragments6(u_int32_t, u_int32_t); 
+EXT void prune_old_fragments6(u_int32_t); 
+EXT void expire_fragment6(struct pm_timer *, time_t);
 EXT void notify_orphan_fragment6(struct ip6_fragment *);
 #endif
 #undef EXT
@@ -358,6 +358,9 @@ void isis_srcdst_lookup(struct packet_ptrs *pptrs)
 #if defined ENABLE_IPV6
   struct in6_addr pref6;
 #endif
+  struct timespec stats_ts;
+
+  STATS_START(stats_ts);
 
   pptrs->igp_src = NULL;
   pptrs->igp_dst = NULL;
@@ -430,6 +433,8 @@ void isis_srcdst_lookup(struct packet_ptrs *pptrs)
     }
 #endif
   }
+
+  STATS_STOP(STATS_ISIS, stats_ts);
 }
 
 int igp_daemon_map_node_handler(char *filename, struct id_entry *e, char *value, struct plugin_requests *req, int acct_type)
@@ -0,0 +1,155 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#define __JSONBUF_C
+
+/* includes */
+#include "pmacct.h"
+
+/* Functions */
+void pm_jsonbuf_init(struct pm_jsonbuf *jb, u_int32_t size)
+{
+  memset(jb, 0, sizeof(struct pm_jsonbuf));
+
+  if (!size) size = JSONBUF_DEFAULT_SIZE;
+  jb->base = malloc(size);
+  if (jb->base) jb->size = size;
+  else jb->err = TRUE;
+}
+
+void pm_jsonbuf_destroy(struct pm_jsonbuf *jb)
+{
+  if (jb->base) free(jb->base);
+  memset(jb, 0, sizeof(struct pm_jsonbuf));
+}
+
+void pm_jsonbuf_reset(struct pm_jsonbuf *jb)
+{
+  jb->len = 0;
+  jb->fields = 0;
+  jb->err = FALSE;
+}
+
+static int pm_jsonbuf_grow(struct pm_jsonbuf *jb, u_int32_t needed)
+{
+  u_int32_t size = (jb->size ? jb->size : JSONBUF_DEFAULT_SIZE);
+  char *base;
+
+  if (jb->err) return ERR;
+
+  while (size < (jb->len + needed)) size *= 2;
+
+  base = realloc(jb->base, size);
+  if (!base) {
+    jb->err = TRUE;
+    return ERR;
+  }
+
+  jb->base = base;
+  jb->size = size;
+
+  return SUCCESS;
+}
+
+int pm_jsonbuf_append(struct pm_jsonbuf *jb, const char *data, u_int32_t len)
+{
+  if ((jb->len + len) > jb->size && pm_jsonbuf_grow(jb, len) == ERR) return ERR;
+
+  memcpy(&jb->base[jb->len], data, len);
+  jb->len += len;
+
+  return SUCCESS;
+}
+
+void pm_jsonbuf_obj_open(struct pm_jsonbuf *jb)
+{
+  pm_jsonbuf_append(jb, "{", 1);
+  jb->fields = 0;
+}
+
+void pm_jsonbuf_obj_close(struct pm_jsonbuf *jb)
+{
+  pm_jsonbuf_append(jb, "}", 1);
+}
+
+static void pm_jsonbuf_key(struct pm_jsonbuf *jb, const char *key)
+{
+  if (jb->fields) pm_jsonbuf_append(jb, ", ", 2);
+  jb->fields++;
+
+  pm_jsonbuf_append(jb, "\"", 1);
+  pm_jsonbuf_append(jb, key, strlen(key));
+  pm_jsonbuf_append(jb, "\": ", 3);
+}
+
+void pm_jsonbuf_add_str(struct pm_jsonbuf *jb, const char *key, const char *value)
+{
+  static const char hex[] = "0123456789abcdef";
+  const char *run, *ptr;
+  char esc[6];
+  int esc_len;
+
+  pm_jsonbuf_key(jb, key);
+  pm_jsonbuf_append(jb, "\"", 1);
+
+  /* copy clean runs in one go, escape as jansson does */
+  for (run = ptr = value; *ptr; ptr++) {
+    if ((u_char) *ptr >= 0x20 && *ptr != '"' && *ptr != '\\') continue;
+
+    if (ptr > run) pm_jsonbuf_append(jb, run, (ptr - run));
+    run = (ptr + 1);
+
+    esc[0] = '\\';
+    esc_len = 2;
+
+    switch (*ptr) {
+    case '"': esc[1] = '"'; break;
+    case '\\': esc[1] = '\\'; break;
+    case '\b': esc[1] = 'b'; break;
+    case '\f': esc[1] = 'f'; break;
+    case '\n': esc[1] = 'n'; break;
+    case '\r': esc[1] = 'r'; break;
+    case '\t': esc[1] = 't'; break;
+    default:
+      esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+      esc[4] = hex[((u_char) *ptr) >> 4];
+      esc[5] = hex[((u_char) *ptr) & 0xf];
+      esc_len = 6;
+      break;
+    }
+
+    pm_jsonbuf_append(jb, esc, esc_len);
+  }
+
+  if (ptr > run) pm_jsonbuf_append(jb, run, (ptr - run));
+  pm_jsonbuf_append(jb, "\"", 1);
+}
+
+void pm_jsonbuf_add_int(struct pm_jsonbuf *jb, const char *key, int64_t value)
+{
+  char num[24];
+  int len;
+
+  pm_jsonbuf_key(jb, key);
+
+  len = snprintf(num, sizeof(num), "%lld", (long long) value);
+  pm_jsonbuf_append(jb, num, len);
+}
@@ -0,0 +1,62 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+#ifndef _JSONBUF_H_
+#define _JSONBUF_H_
+
+/* defines */
+#define JSONBUF_DEFAULT_SIZE	1024
+
+/* structures */
+/*
+   Append-only JSON writer: objects are serialized straight into a
+   growable buffer which is meant to be reused record after record, so
+   that once warmed up no allocations happen. Output is formatted the
+   same way json_dumps(JSON_PRESERVE_ORDER) does, ie. '"key": value'
+   pairs separated by ", ". Should the buffer fail to grow, 'err' is
+   set and the record is to be discarded.
+*/
+struct pm_jsonbuf {
+  char *base;
+  u_int32_t len;
+  u_int32_t size;
+  u_int32_t fields;		/* fields written to the open object */
+  int err;
+};
+
+/* prototypes */
+#if (!defined __JSONBUF_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT void pm_jsonbuf_init(struct pm_jsonbuf *, u_int32_t);
+EXT void pm_jsonbuf_destroy(struct pm_jsonbuf *);
+EXT void pm_jsonbuf_reset(struct pm_jsonbuf *);
+EXT int pm_jsonbuf_append(struct pm_jsonbuf *, const char *, u_int32_t);
+EXT void pm_jsonbuf_obj_open(struct pm_jsonbuf *);
+EXT void pm_jsonbuf_obj_close(struct pm_jsonbuf *);
+EXT void pm_jsonbuf_add_str(struct pm_jsonbuf *, const char *, const char *);
+EXT void pm_jsonbuf_add_int(struct pm_jsonbuf *, const char *, int64_t);
+#undef EXT
+
+#endif /* _JSONBUF_H_ */
@@ -92,6 +92,7 @@ EXT void p_kafka_close(struct p_kafka_host *, int);
 EXT int p_kafka_check_outq_len(struct p_kafka_host *);
 
 EXT int write_and_free_json_kafka(void *, void *);
+EXT int write_binary_kafka(void *, void *, u_int32_t);
 
 /* global vars */
 EXT struct p_kafka_host kafkap_kafka_host;
@@ -52,6 +52,7 @@ void kafka_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   u_int32_t bufsz = ((struct channels_list_entry *)ptr)->bufsize;
   pid_t core_pid = ((struct channels_list_entry *)ptr)->core_pid;
   struct networks_file_data nfd;
+  struct timespec stats_ts;
 
   unsigned char *rgptr;
   int pollagain = TRUE;
@@ -292,8 +293,10 @@ void kafka_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
         for (num = 0; primptrs_funcs[num]; num++)
           (*primptrs_funcs[num])((u_char *)data, &extras, &prim_ptrs);
 
+	if (net_funcs[0]) STATS_START(stats_ts);
 	for (num = 0; net_funcs[num]; num++)
 	  (*net_funcs[num])(&nt, &nc, &data->primitives, prim_ptrs.pbgp, &nfd);
+	if (net_funcs[0]) STATS_STOP(STATS_NET, stats_ts);
 
 	if (config.ports_file) {
           if (!pt.table[data->primitives.src_port]) data->primitives.src_port = 0;
@@ -305,7 +308,9 @@ void kafka_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
           evaluate_pkt_len_distrib(data);
 
         prim_ptrs.data = data;
+        STATS_START(stats_ts);
         (*insert_func)(&prim_ptrs, &idata);
+        STATS_STOP(STATS_INSERT, stats_ts);
 
 	((struct ch_buf_hdr *)pipebuf)->num--;
         if (((struct ch_buf_hdr *)pipebuf)->num) {
@@ -119,7 +119,7 @@ struct memory_pool_desc *request_memory_pool(int size)
 
   /* We found a free room in mpd table; now we have
      allocate needed memory */
-  memptr = (unsigned char *) map_shared(0, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  memptr = (unsigned char *) map_hugepages(size, NULL, config.hugepages, MAP_SHARED, (new_id <= 2 ? "memory pool" : NULL));
   if (memptr == MAP_FAILED) {
     Log(LOG_WARNING, "WARN ( %s/%s ): memory sold out ! Please, clear in-memory stats !\n", config.name, config.type);
     return NULL;
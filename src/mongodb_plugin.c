@@ -65,6 +65,7 @@ void mongodb_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   u_int32_t bufsz = ((struct channels_list_entry *)ptr)->bufsize;
   pid_t core_pid = ((struct channels_list_entry *)ptr)->core_pid;
   struct networks_file_data nfd;
+  struct timespec stats_ts;
 
   unsigned char *rgptr;
   int pollagain = TRUE;
@@ -260,8 +261,10 @@ void mongodb_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
         for (num = 0; primptrs_funcs[num]; num++)
           (*primptrs_funcs[num])((u_char *)data, &extras, &prim_ptrs);
 
+	if (net_funcs[0]) STATS_START(stats_ts);
 	for (num = 0; net_funcs[num]; num++)
 	  (*net_funcs[num])(&nt, &nc, &data->primitives, prim_ptrs.pbgp, &nfd);
+	if (net_funcs[0]) STATS_STOP(STATS_NET, stats_ts);
 
 	if (config.ports_file) {
           if (!pt.table[data->primitives.src_port]) data->primitives.src_port = 0;
@@ -273,7 +276,9 @@ void mongodb_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
           evaluate_pkt_len_distrib(data);
 
         prim_ptrs.data = data;
+        STATS_START(stats_ts);
         (*insert_func)(&prim_ptrs, &idata);
+        STATS_STOP(STATS_INSERT, stats_ts);
 
 	((struct ch_buf_hdr *)pipebuf)->num--;
         if (((struct ch_buf_hdr *)pipebuf)->num) {
@@ -482,7 +487,7 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
   
       if (config.what_to_count & COUNT_TAG) bson_append_long(bson_elem, "tag", data->tag);
       if (config.what_to_count & COUNT_TAG2) bson_append_long(bson_elem, "tag2", data->tag2);
-      if (config.what_to_count_2 & COUNT_LABEL) MongoDB_append_string(bson_elem, "label", pvlen, COUNT_INT_LABEL); 
+      if (config.what_to_count_2 & COUNT_LABEL) MongoDB_append_label(bson_elem, "label", data, pvlen);
 
       if (config.what_to_count & COUNT_CLASS) bson_append_string(bson_elem, "class", ((data->class && class[(data->class)-1].id) ? class[(data->class)-1].protocol : "unknown" ));
 
@@ -981,6 +986,14 @@ void MongoDB_create_indexes(mongo *db_conn, const char *table)
   else Log(LOG_WARNING, "WARN ( %s/%s ): mongo_indexes_file '%s' does not exist.\n", config.name, config.type, config.sql_table_schema);
 }
 
+void MongoDB_append_label(bson *bson_elem, char *name, struct pkt_primitives *data, struct pkt_vlen_hdr_primitives *pvlen)
+{
+  char *str_ptr = pretag_label_get(data, pvlen);
+
+  if (str_ptr) bson_append_string(bson_elem, name, str_ptr);
+  else bson_append_null(bson_elem, name);
+}
+
 void MongoDB_append_string(bson *bson_elem, char *name, struct pkt_vlen_hdr_primitives *pvlen, pm_cfgreg_t wtc)
 {
   char *str_ptr = NULL;
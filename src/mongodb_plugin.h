@@ -46,6 +46,7 @@ EXT void MongoDB_cache_purge(struct chained_cache *[], int, int);
 EXT void MongoDB_create_indexes(mongo *, const char *);
 EXT int MongoDB_get_database(char *, int, char *);
 EXT void MongoDB_append_string(bson *, char *, struct pkt_vlen_hdr_primitives *, pm_cfgreg_t);
+EXT void MongoDB_append_label(bson *, char *, struct pkt_primitives *, struct pkt_vlen_hdr_primitives *);
 EXT int MongoDB_oid_fuzz();
 
 /* global vars */
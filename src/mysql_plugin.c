@@ -29,6 +29,9 @@
 #include "mysql_plugin.h"
 #include "sql_common_m.c"
 
+/* variables */
+static char *MY_upsert_tail = "";
+
 /* Functions */
 void mysql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr) 
 {
@@ -46,6 +49,7 @@ void mysql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   u_int32_t bufsz = ((struct channels_list_entry *)ptr)->bufsize;
   pid_t core_pid = ((struct channels_list_entry *)ptr)->core_pid;
   struct networks_file_data nfd;
+  struct timespec stats_ts;
   char *dataptr;
 
   unsigned char *rgptr;
@@ -107,6 +111,8 @@ void mysql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   /* building up static SQL clauses */
   idata.num_primitives = MY_compose_static_queries();
   glob_num_primitives = idata.num_primitives; 
+  if (config.sql_upsert) sql_upsert_init(SQL_UPSERT_MYSQL);
+  if (config.sql_prepared_statements) sql_bind_init(idata.num_primitives, SQL_BIND_STYLE_QMARK);
 
   /* setting up environment variables */
   SQL_SetENV();
@@ -234,8 +240,10 @@ void mysql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
         for (num = 0; primptrs_funcs[num]; num++)
           (*primptrs_funcs[num])((u_char *)data, &extras, &prim_ptrs);
 
+	if (net_funcs[0]) STATS_START(stats_ts);
 	for (num = 0; net_funcs[num]; num++)
 	  (*net_funcs[num])(&nt, &nc, &data->primitives, prim_ptrs.pbgp, &nfd);
+	if (net_funcs[0]) STATS_STOP(STATS_NET, stats_ts);
 
 	if (config.ports_file) {
 	  if (!pt.table[data->primitives.src_port]) data->primitives.src_port = 0;
@@ -247,7 +255,9 @@ void mysql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
           evaluate_pkt_len_distrib(data);
 
         prim_ptrs.data = data;
+	STATS_START(stats_ts);
 	(*insert_func)(&prim_ptrs, &idata);
+	STATS_STOP(STATS_INSERT, stats_ts);
 	
 	((struct ch_buf_hdr *)pipebuf)->num--;
         if (((struct ch_buf_hdr *)pipebuf)->num) {
@@ -270,6 +280,7 @@ int MY_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
   int num=0, num_set=0, ret=0, have_flows=0, len=0;
 
   if (idata->mv.last_queue_elem) {
+    if (config.sql_upsert) strcat(multi_values_buffer, MY_upsert_tail);
     ret = mysql_query(db->desc, multi_values_buffer);
     Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d VALUES statements sent to the MySQL server.\n",
                     config.name, config.type, idata->mv.buffer_elem_num);
@@ -307,7 +318,7 @@ int MY_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
   
   /* sending UPDATE query a) if not switched off and
      b) if we actually have something to update */
-  if (!config.sql_dont_try_update && num_set) {
+  if (!config.sql_dont_try_update && !config.sql_upsert && num_set) {
     strncpy(sql_data, update_clause, SPACELEFT(sql_data));
     strncat(sql_data, set_clause, SPACELEFT(sql_data));
     strncat(sql_data, where_clause, SPACELEFT(sql_data));
@@ -316,7 +327,7 @@ int MY_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
     if (ret) goto signal_error; 
   }
 
-  if (config.sql_dont_try_update || !num_set || (mysql_affected_rows(db->desc) == 0)) {
+  if (config.sql_dont_try_update || config.sql_upsert || !num_set || (mysql_affected_rows(db->desc) == 0)) {
     /* UPDATE failed, trying with an INSERT query */ 
     if (cache_elem->flow_type == NF9_FTYPE_EVENT || cache_elem->flow_type == NF9_FTYPE_OPTION) {
       strncpy(insert_full_clause, insert_clause, SPACELEFT(insert_full_clause));
@@ -335,9 +346,13 @@ int MY_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
 #endif
     }
 
+    /* upsert: the conflict clause goes once at the end of the multi-values buffer */
+    if (config.sql_upsert) MY_upsert_tail = sql_upsert_clause(idata, (cache_elem->flow_type == NF9_FTYPE_EVENT ||
+			cache_elem->flow_type == NF9_FTYPE_OPTION));
+
     if (config.sql_multi_values) { 
       multi_values_handling:
-      len = config.sql_multi_values-idata->mv.buffer_offset; 
+      len = config.sql_multi_values-idata->mv.buffer_offset-strlen(MY_upsert_tail); 
       if (!idata->mv.buffer_elem_num) {
 	if (strlen(insert_full_clause) < len) {
 	  strncpy(multi_values_buffer, insert_full_clause, config.sql_multi_values);
@@ -351,7 +366,7 @@ int MY_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
           exit_plugin(1);
 	}
       }
-      len = config.sql_multi_values-idata->mv.buffer_offset; 
+      len = config.sql_multi_values-idata->mv.buffer_offset-strlen(MY_upsert_tail); 
       if (strlen(values_clause) < len) { 
 	if (idata->mv.buffer_elem_num) {
 	  strcpy(multi_values_buffer+idata->mv.buffer_offset, ",");
@@ -364,6 +379,7 @@ int MY_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
       }
       else {
 	if (idata->mv.buffer_elem_num) {
+	  if (config.sql_upsert) strcat(multi_values_buffer, MY_upsert_tail);
 	  ret = mysql_query(db->desc, multi_values_buffer);
 	  Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d VALUES statements sent to the MySQL server.\n",
 			  config.name, config.type, idata->mv.buffer_elem_num);
@@ -384,6 +400,7 @@ int MY_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
     else {
       strncpy(sql_data, insert_full_clause, sizeof(sql_data));
       strncat(sql_data, values_clause, SPACELEFT(sql_data));
+      if (config.sql_upsert) strncat(sql_data, MY_upsert_tail, SPACELEFT(sql_data));
 
       ret = mysql_query(db->desc, sql_data);
       if (ret) goto signal_error; 
@@ -417,9 +434,272 @@ int MY_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
   else return ret;
 }
 
+/*
+   Prepared statements. Parameters are all bound as strings, MySQL casts
+   them to the column type; with sql_multi_values rows are accumulated in
+   a multi-row prepared INSERT whose payload is kept in the multi-values
+   buffer, so that the 'sql_multi_values' size bounds both methods.
+*/
+#define MY_BIND_MAX_PARAMS 65535 /* placeholders per statement, protocol limit */
+
+static MYSQL_BIND MY_bind_params[SQL_BIND_MAX_PARAMS];
+static unsigned int MY_stmt_errno;
+static char MY_stmt_errmsg[SRVBUFLEN];
+
+struct MY_bind_batch {
+  char head[LONGSRVBUFLEN];
+  char row[LONGSRVBUFLEN];
+  char tail[LONGSRVBUFLEN];
+  char *text;
+  u_int32_t text_size;
+  MYSQL_BIND *bind;
+  int rows;
+  int max_rows;
+  int nparams;
+  u_int32_t data_off;
+};
+
+static struct MY_bind_batch MY_batch;
+
+static void MY_stmt_get_errmsg(struct DBdesc *db, MYSQL_STMT *handle)
+{
+  if (handle) {
+    MY_stmt_errno = mysql_stmt_errno(handle);
+    strlcpy(MY_stmt_errmsg, mysql_stmt_error(handle), sizeof(MY_stmt_errmsg));
+  }
+  else {
+    MY_stmt_errno = mysql_errno(db->desc);
+    strlcpy(MY_stmt_errmsg, mysql_error(db->desc), sizeof(MY_stmt_errmsg));
+  }
+
+  db->errmsg = MY_stmt_errmsg;
+}
+
+static void MY_bind_set(MYSQL_BIND *bind, char *value, unsigned long len)
+{
+  memset(bind, 0, sizeof(MYSQL_BIND));
+  bind->buffer_type = MYSQL_TYPE_STRING;
+  bind->buffer = value;
+  bind->buffer_length = len;
+}
+
+static int MY_stmt_exec(struct DBdesc *db, struct sql_stmt *stmt, char *text, MYSQL_BIND *bind)
+{
+  MYSQL_STMT *handle;
+
+  MY_stmt_errno = 0;
+
+  if (sql_stmt_changed(stmt, text)) {
+    if (stmt->handle) mysql_stmt_close(stmt->handle);
+    sql_stmt_set(stmt, NULL, NULL);
+
+    handle = mysql_stmt_init(db->desc);
+    if (!handle) {
+      MY_stmt_get_errmsg(db, NULL);
+      return ERR;
+    }
+
+    if (mysql_stmt_prepare(handle, text, strlen(text))) {
+      MY_stmt_get_errmsg(db, handle);
+      mysql_stmt_close(handle);
+      return ERR;
+    }
+
+    sql_stmt_set(stmt, handle, text);
+  }
+
+  handle = stmt->handle;
+  if (mysql_stmt_bind_param(handle, bind) || mysql_stmt_execute(handle)) {
+    MY_stmt_get_errmsg(db, handle);
+    return ERR;
+  }
+
+  return SUCCESS;
+}
+
+static int MY_stmt_exec_query(struct DBdesc *db, struct sql_stmt *stmt, struct sql_bind_query *q)
+{
+  int idx;
+
+  for (idx = 0; idx < q->nparams; idx++) MY_bind_set(&MY_bind_params[idx], q->params[idx], strlen(q->params[idx]));
+
+  return MY_stmt_exec(db, stmt, q->text, MY_bind_params);
+}
+
+static int MY_batch_flush(struct DBdesc *db, struct insert_data *idata)
+{
+  int idx, len, ret, rows = MY_batch.rows;
+  u_int32_t size;
+
+  size = strlen(MY_batch.head) + (rows * (strlen(MY_batch.row) + 1)) + strlen(MY_batch.tail) + 1;
+  if (size > MY_batch.text_size) {
+    MY_batch.text = realloc(MY_batch.text, size);
+    if (!MY_batch.text) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): Unable to get enough room for prepared multi value queries.\n", config.name, config.type);
+      exit_plugin(1);
+    }
+    MY_batch.text_size = size;
+  }
+
+  len = strlcpy(MY_batch.text, MY_batch.head, size);
+  for (idx = 0; idx < rows; idx++) {
+    if (idx) MY_batch.text[len++] = ',';
+    strcpy(MY_batch.text+len, MY_batch.row);
+    len += strlen(MY_batch.row);
+  }
+  strcpy(MY_batch.text+len, MY_batch.tail);
+
+  ret = MY_stmt_exec(db, &db->stmt[SQL_STMT_INSERT_BATCH], MY_batch.text, MY_batch.bind);
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d VALUES statements sent to the MySQL server.\n", config.name, config.type, rows);
+
+  /* on failure the batch is kept: the caller rewinds or retries it against the backup */
+  if (!ret) {
+    idata->iqn++;
+    MY_batch.rows = 0;
+    MY_batch.data_off = 0;
+    idata->mv.buffer_elem_num = 0;
+    idata->mv.buffer_offset = 0;
+  }
+
+  return ret;
+}
+
+static int MY_batch_add(struct DBdesc *db, struct insert_data *idata, struct sql_bind_query *q, char *tail)
+{
+  char *values, *row;
+  u_int32_t payload = 0;
+  int idx, head_len, ret, max_rows;
+
+  values = strstr(q->text, " VALUES (");
+  if (!values) return ERR;
+  head_len = (values - q->text) + strlen(" VALUES");
+  row = values + strlen(" VALUES ");
+
+  for (idx = 0; idx < q->nparams; idx++) payload += strlen(q->params[idx]);
+
+  if (MY_batch.rows) {
+    if (strncmp(MY_batch.head, q->text, head_len) || MY_batch.head[head_len] || strcmp(MY_batch.row, row) || strcmp(MY_batch.tail, tail) ||
+	MY_batch.rows == MY_batch.max_rows || (MY_batch.data_off + payload) > config.sql_multi_values) {
+      ret = MY_batch_flush(db, idata);
+      if (ret) return ret;
+    }
+  }
+
+  if (!MY_batch.rows) {
+    if (head_len >= sizeof(MY_batch.head) || strlen(row) >= sizeof(MY_batch.row) || strlen(tail) >= sizeof(MY_batch.tail) ||
+	payload > config.sql_multi_values) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): 'sql_multi_values' is too small (%d). Try with a larger value.\n",
+		config.name, config.type, config.sql_multi_values);
+      exit_plugin(1);
+    }
+
+    memcpy(MY_batch.head, q->text, head_len);
+    MY_batch.head[head_len] = '\0';
+    strlcpy(MY_batch.row, row, sizeof(MY_batch.row));
+    strlcpy(MY_batch.tail, tail, sizeof(MY_batch.tail));
+
+    /* batch geometry is fixed once, so that full batches share one statement */
+    if (MY_batch.nparams != q->nparams) {
+      max_rows = config.sql_multi_values / (strlen(row) + 1 + payload);
+      if (q->nparams && max_rows > (MY_BIND_MAX_PARAMS / q->nparams)) max_rows = MY_BIND_MAX_PARAMS / q->nparams;
+      if (max_rows < 1) max_rows = 1;
+
+      MY_batch.bind = realloc(MY_batch.bind, (max_rows * q->nparams + 1) * sizeof(MYSQL_BIND));
+      if (!MY_batch.bind) {
+	Log(LOG_ERR, "ERROR ( %s/%s ): Unable to get enough room for prepared multi value queries.\n", config.name, config.type);
+	exit_plugin(1);
+      }
+
+      MY_batch.max_rows = max_rows;
+      MY_batch.nparams = q->nparams;
+    }
+
+    idata->mv.head_buffer_elem = idata->current_queue_elem;
+  }
+
+  for (idx = 0; idx < q->nparams; idx++) {
+    u_int32_t len = strlen(q->params[idx]);
+
+    memcpy(multi_values_buffer+MY_batch.data_off, q->params[idx], len);
+    MY_bind_set(&MY_batch.bind[(MY_batch.rows * MY_batch.nparams) + idx], multi_values_buffer+MY_batch.data_off, len);
+    MY_batch.data_off += len;
+  }
+
+  MY_batch.rows++;
+  idata->mv.buffer_elem_num++;
+  idata->mv.buffer_offset = MY_batch.data_off;
+
+  return SUCCESS;
+}
+
+int MY_cache_dbop_bind(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata)
+{
+  static struct sql_bind_query upd, ins;
+  char *tail = "";
+  int num_set = 0, ret = 0;
+
+  if (idata->mv.last_queue_elem) {
+    ret = MY_batch_flush(db, idata);
+    if (ret) goto signal_error;
+
+    return FALSE;
+  }
+
+  num_set = sql_bind_compose(cache_elem, idata, &upd, &ins);
+
+  if (!config.sql_dont_try_update && !config.sql_upsert && num_set) {
+    ret = MY_stmt_exec_query(db, &db->stmt[SQL_STMT_UPDATE], &upd);
+    if (ret) goto signal_error;
+  }
+
+  if (config.sql_dont_try_update || config.sql_upsert || !num_set || (mysql_stmt_affected_rows(db->stmt[SQL_STMT_UPDATE].handle) == 0)) {
+    if (config.sql_upsert) tail = sql_upsert_clause(idata, (cache_elem->flow_type == NF9_FTYPE_EVENT ||
+			cache_elem->flow_type == NF9_FTYPE_OPTION));
+
+    if (config.sql_multi_values) {
+      ret = MY_batch_add(db, idata, &ins, tail);
+      if (ret) goto signal_error;
+    }
+    else {
+      strlcat(ins.text, tail, sizeof(ins.text));
+      ret = MY_stmt_exec_query(db, &db->stmt[SQL_STMT_INSERT], &ins);
+      if (ret) goto signal_error;
+      Log(LOG_DEBUG, "DEBUG ( %s/%s ): %s\n\n", config.name, config.type, ins.text);
+      idata->iqn++;
+    }
+  }
+  else {
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): %s\n\n", config.name, config.type, upd.text);
+    idata->uqn++;
+  }
+
+  idata->een++;
+
+  return ret;
+
+  signal_error:
+  if (!idata->mv.buffer_elem_num) Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED prepared statement follows:\n%s\n", config.name, config.type,
+					(config.sql_dont_try_update || config.sql_upsert || !num_set) ? ins.text : upd.text);
+  else {
+    if (!idata->recover || db->type != BE_TYPE_PRIMARY) {
+      /* DB failure: we will rewind the multi-values buffer */
+      idata->current_queue_elem = idata->mv.head_buffer_elem;
+      idata->mv.buffer_elem_num = 0;
+      idata->mv.buffer_offset = 0;
+      MY_batch.rows = 0;
+      MY_batch.data_off = 0;
+    }
+  }
+  if (db->errmsg) Log(LOG_ERR, "ERROR ( %s/%s ): %s\n\n", config.name, config.type, db->errmsg);
+
+  if (MY_stmt_errno == 1062) return FALSE; /* not signalling duplicate entry problems */
+  else return ret;
+}
+
 void MY_cache_purge(struct db_cache *queue[], int index, struct insert_data *idata)
 {
   struct db_cache *LastElemCommitted = NULL;
+  struct timeval start_tv;
   time_t start;
   int j, stop, ret, go_to_pending, saved_index = index;
   char orig_insert_clause[LONGSRVBUFLEN], orig_update_clause[LONGSRVBUFLEN], orig_lock_clause[LONGSRVBUFLEN];
@@ -447,6 +727,7 @@ void MY_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
 
   Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - START (PID: %u) ***\n", config.name, config.type, writer_pid);
   start = time(NULL);
+  gettimeofday(&start_tv, NULL);
 
   /* re-using pending queries queue stuff from parent and saving clauses */
   memcpy(pending_queries_queue, queue, index*sizeof(struct db_cache *));
@@ -536,8 +817,9 @@ void MY_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
   if (pqq_ptr) goto start;
   
   idata->elap_time = time(NULL)-start; 
-  Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %u) ***\n", 
-		config.name, config.type, writer_pid, idata->qn, saved_index, idata->elap_time); 
+  Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %u, RPS: %u) ***\n", 
+		config.name, config.type, writer_pid, idata->qn, saved_index, idata->elap_time,
+		sql_purge_rate(idata, &start_tv)); 
 
   if (config.sql_trigger_exec) {
     if (queue && queue[0]) idata->basetime = queue[0]->basetime;
@@ -679,8 +961,20 @@ void MY_DB_Connect(struct DBdesc *db, char *host)
   }
 }
 
+static void MY_stmt_close(struct DBdesc *db)
+{
+  int idx;
+
+  for (idx = 0; idx < SQL_STMT_MAX; idx++) {
+    if (db->stmt[idx].handle) mysql_stmt_close(db->stmt[idx].handle);
+    sql_stmt_set(&db->stmt[idx], NULL, NULL);
+  }
+}
+
 void MY_DB_Close(struct BE_descs *bed)
 {
+  MY_stmt_close(bed->p);
+  MY_stmt_close(bed->b);
   if (bed->p->connected) mysql_close(bed->p->desc);
   if (bed->b->connected) mysql_close(bed->b->desc);
 }
@@ -721,7 +1015,8 @@ void MY_set_callbacks(struct sqlfunc_cb_registry *cbr)
   cbr->close = MY_DB_Close;
   cbr->lock = MY_Lock;
   cbr->unlock = MY_Unlock;
-  cbr->op = MY_cache_dbop;
+  if (!config.sql_prepared_statements) cbr->op = MY_cache_dbop;
+  else cbr->op = MY_cache_dbop_bind;
   cbr->create_table = MY_create_dyn_table;
   cbr->purge = MY_cache_purge;
   cbr->create_backend = MY_create_backend;
@@ -753,6 +1048,11 @@ void MY_init_default_values(struct insert_data *idata)
 
   if (config.sql_backup_host) idata->recover = TRUE;
 
+  if (config.sql_upsert && config.sql_dont_try_update) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_upsert is incompatible with sql_dont_try_update. Ignored.\n", config.name, config.type);
+    config.sql_upsert = FALSE;
+  }
+
   if (config.sql_multi_values) {
     multi_values_buffer = malloc(config.sql_multi_values);
     if (!multi_values_buffer) {
@@ -29,6 +29,7 @@
 /* prototypes */
 void mysql_plugin(int, struct configuration *, void *);
 int MY_cache_dbop(struct DBdesc *, struct db_cache *, struct insert_data *);
+int MY_cache_dbop_bind(struct DBdesc *, struct db_cache *, struct insert_data *);
 void MY_cache_purge(struct db_cache *[], int, struct insert_data *);
 int MY_evaluate_history(int);
 int MY_compose_static_queries();
@@ -31,6 +31,7 @@
 #include "../ip_flow.h"
 #include "../classifier.h"
 #include "ndpi.h"
+#include "../jhash.h"
 
 void pm_ndpi_free_flow_info_half(struct pm_ndpi_flow_info *flow)
 {
@@ -40,31 +41,131 @@ void pm_ndpi_free_flow_info_half(struct pm_ndpi_flow_info *flow)
       flow->ndpi_flow = NULL;
     }
 
-    if (flow->src_id) {
-      ndpi_free(flow->src_id);
-      flow->src_id = NULL;
+    /* src_id, dst_id live in the flow slab object */
+  }
+}
+
+static u_int32_t pm_ndpi_flow_hash(struct pm_ndpi_flow_info *flow)
+{
+  u_int32_t key[4];
+
+  key[0] = flow->lower_ip;
+  key[1] = flow->upper_ip;
+  key[2] = (flow->lower_port << 16) | flow->upper_port;
+  key[3] = (flow->vlan_id << 8) | flow->protocol;
+
+  return jhash2(key, 4, 0);
+}
+
+static int pm_ndpi_flow_match(struct pm_ndpi_flow_info *fa, struct pm_ndpi_flow_info *fb)
+{
+  return (fa->lower_ip == fb->lower_ip && fa->upper_ip == fb->upper_ip &&
+	  fa->lower_port == fb->lower_port && fa->upper_port == fb->upper_port &&
+	  fa->protocol == fb->protocol && fa->vlan_id == fb->vlan_id);
+}
+
+/* returns the flow matching 'key', if any, and in 'slot' either its
+   position or the empty slot where it would go */
+static struct pm_ndpi_flow_info *pm_ndpi_flow_lookup(struct pm_ndpi_workflow *workflow,
+						     struct pm_ndpi_flow_info *key, u_int32_t *slot)
+{
+  struct pm_ndpi_flow_slot *flows = workflow->flows;
+  u_int32_t idx = key->hash & workflow->flows_mask;
+
+  workflow->stats.flow_lookups++;
+
+  for (; flows[idx].flow; idx = (idx + 1) & workflow->flows_mask) {
+    workflow->stats.flow_probes++;
+
+    if (flows[idx].hash == key->hash && pm_ndpi_flow_match(flows[idx].flow, key)) {
+      workflow->stats.flow_lookup_hits++;
+      *slot = idx;
+      return flows[idx].flow;
     }
+  }
 
-    if (flow->dst_id) {
-      ndpi_free(flow->dst_id);
-      flow->dst_id = NULL;
+  *slot = idx;
+
+  return NULL;
+}
+
+static int pm_ndpi_flow_table_grow(struct pm_ndpi_workflow *workflow)
+{
+  struct pm_ndpi_flow_slot *flows;
+  u_int32_t buckets = (workflow->flows_mask + 1) * 2, idx, new_idx;
+
+  if (buckets > workflow->max_buckets || buckets < workflow->flows_mask + 1) return ERR;
+
+  flows = calloc(buckets, sizeof(struct pm_ndpi_flow_slot));
+  if (!flows) return ERR;
+
+  for (idx = 0; idx <= workflow->flows_mask; idx++) {
+    if (!workflow->flows[idx].flow) continue;
+
+    new_idx = workflow->flows[idx].hash & (buckets - 1);
+    while (flows[new_idx].flow) new_idx = (new_idx + 1) & (buckets - 1);
+    flows[new_idx] = workflow->flows[idx];
+  }
+
+  free(workflow->flows);
+  workflow->flows = flows;
+  workflow->flows_mask = buckets - 1;
+
+  return SUCCESS;
+}
+
+/* backward shift deletion: no tombstones, probe sequences stay short */
+static void pm_ndpi_flow_delete(struct pm_ndpi_workflow *workflow, struct pm_ndpi_flow_info *flow)
+{
+  struct pm_ndpi_flow_slot *flows = workflow->flows;
+  u_int32_t mask = workflow->flows_mask, idx, next, home;
+
+  for (idx = flow->hash & mask; flows[idx].flow != flow; idx = (idx + 1) & mask);
+
+  for (next = (idx + 1) & mask; flows[next].flow; next = (next + 1) & mask) {
+    home = flows[next].hash & mask;
+
+    /* can the entry at 'next' move back to 'idx' ? */
+    if ((idx <= next) ? (home <= idx || home > next) : (home <= idx && home > next)) {
+      flows[idx] = flows[next];
+      idx = next;
     }
   }
+
+  flows[idx].flow = NULL;
 }
 
-int pm_ndpi_workflow_node_cmp(const void *a, const void *b)
+static void pm_ndpi_lru_unlink(struct pm_ndpi_workflow *workflow, struct pm_ndpi_flow_info *flow)
 {
-  struct pm_ndpi_flow_info *fa = (struct pm_ndpi_flow_info*)a;
-  struct pm_ndpi_flow_info *fb = (struct pm_ndpi_flow_info*)b;
+  if (flow->lru_prev) flow->lru_prev->lru_next = flow->lru_next;
+  else workflow->lru_head = flow->lru_next;
 
-  if(fa->vlan_id   < fb->vlan_id  )   return(-1); else { if(fa->vlan_id   > fb->vlan_id    ) return(1); }
-  if(fa->lower_ip   < fb->lower_ip  ) return(-1); else { if(fa->lower_ip   > fb->lower_ip  ) return(1); }
-  if(fa->lower_port < fb->lower_port) return(-1); else { if(fa->lower_port > fb->lower_port) return(1); }
-  if(fa->upper_ip   < fb->upper_ip  ) return(-1); else { if(fa->upper_ip   > fb->upper_ip  ) return(1); }
-  if(fa->upper_port < fb->upper_port) return(-1); else { if(fa->upper_port > fb->upper_port) return(1); }
-  if(fa->protocol   < fb->protocol  ) return(-1); else { if(fa->protocol   > fb->protocol  ) return(1); }
+  if (flow->lru_next) flow->lru_next->lru_prev = flow->lru_prev;
+  else workflow->lru_tail = flow->lru_prev;
 
-  return(0);
+  flow->lru_prev = flow->lru_next = NULL;
+}
+
+static void pm_ndpi_lru_append(struct pm_ndpi_workflow *workflow, struct pm_ndpi_flow_info *flow)
+{
+  flow->lru_next = NULL;
+  flow->lru_prev = workflow->lru_tail;
+
+  if (workflow->lru_tail) workflow->lru_tail->lru_next = flow;
+  else workflow->lru_head = flow;
+
+  workflow->lru_tail = flow;
+}
+
+static void pm_ndpi_lru_prepend(struct pm_ndpi_workflow *workflow, struct pm_ndpi_flow_info *flow)
+{
+  flow->lru_prev = NULL;
+  flow->lru_next = workflow->lru_head;
+
+  if (workflow->lru_head) workflow->lru_head->lru_prev = flow;
+  else workflow->lru_tail = flow;
+
+  workflow->lru_head = flow;
 }
 
 struct pm_ndpi_flow_info *pm_ndpi_get_flow_info(struct pm_ndpi_workflow *workflow,
@@ -90,8 +191,7 @@ struct pm_ndpi_flow_info *pm_ndpi_get_flow_info(struct pm_ndpi_workflow *workflo
   u_int32_t upper_ip;
   u_int16_t lower_port;
   u_int16_t upper_port;
-  struct pm_ndpi_flow_info flow;
-  void *ret;
+  struct pm_ndpi_flow_info flow, *ret;
   u_int8_t *l4;
 
   /* IPv4 fragments handling */
@@ -194,11 +294,19 @@ struct pm_ndpi_flow_info *pm_ndpi_get_flow_info(struct pm_ndpi_workflow *workflo
 	iph->protocol, lower_ip, ntohs(lower_port), upper_ip, ntohs(upper_port));
 */
 
-  idx = (vlan_id + lower_ip + upper_ip + iph->protocol + lower_port + upper_port) % workflow->prefs.num_roots;
-  ret = pm_tfind(&flow, &workflow->ndpi_flows_root[idx], pm_ndpi_workflow_node_cmp);
+  flow.hash = pm_ndpi_flow_hash(&flow);
+  ret = pm_ndpi_flow_lookup(workflow, &flow, &idx);
 
   if (ret == NULL) {
-    if (workflow->stats.ndpi_flow_count == workflow->prefs.max_ndpi_flows) {
+    u_int32_t buckets = workflow->flows_mask + 1;
+
+    /* keep the load factor below 1/2 while the table can grow, below 3/4 anyway */
+    if (workflow->stats.ndpi_flow_count >= (buckets / 2)) {
+      if (pm_ndpi_flow_table_grow(workflow) == SUCCESS) pm_ndpi_flow_lookup(workflow, &flow, &idx);
+    }
+
+    if (workflow->stats.ndpi_flow_count == workflow->prefs.max_ndpi_flows ||
+	workflow->stats.ndpi_flow_count >= (workflow->flows_mask + 1) - ((workflow->flows_mask + 1) / 4)) {
       if (!log_notification_isset(&log_notifications.ndpi_cache_full, pptrs->pkthdr->ts.tv_sec)) {
         Log(LOG_WARNING, "WARN ( %s/core ): nDPI maximum flow count (%u) has been exceeded.\n", config.name, workflow->prefs.max_ndpi_flows);
 	log_notification_set(&log_notifications.ndpi_cache_full, pptrs->pkthdr->ts.tv_sec, 60);
@@ -207,19 +315,20 @@ struct pm_ndpi_flow_info *pm_ndpi_get_flow_info(struct pm_ndpi_workflow *workflo
       return(NULL);
     }
     else {
-      struct pm_ndpi_flow_info *newflow = (struct pm_ndpi_flow_info*)malloc(sizeof(struct pm_ndpi_flow_info));
+      struct pm_ndpi_flow_info *newflow = pm_slab_alloc(&workflow->flow_slab);
 
       if (newflow == NULL) {
 	Log(LOG_ERR, "ERROR ( %s/core ): pm_ndpi_get_flow_info() not enough memory (1).\n", config.name);
 	exit(1);
       }
 
-      memset(newflow, 0, sizeof(struct pm_ndpi_flow_info));
+      memset(newflow, 0, NDPI_FLOW_INFO_SZ);
       newflow->protocol = iph->protocol, newflow->vlan_id = vlan_id;
       newflow->lower_ip = lower_ip, newflow->upper_ip = upper_ip;
       newflow->lower_port = lower_port, newflow->upper_port = upper_port;
       newflow->ip_version = pptrs->l3_proto;
       newflow->src_to_dst_direction = *src_to_dst_direction;
+      newflow->hash = flow.hash;
 
       if ((newflow->ndpi_flow = ndpi_flow_malloc(SIZEOF_FLOW_STRUCT)) == NULL) {
 	Log(LOG_ERR, "ERROR ( %s/core ): pm_ndpi_get_flow_info() not enough memory (2).\n", config.name);
@@ -227,19 +336,12 @@ struct pm_ndpi_flow_info *pm_ndpi_get_flow_info(struct pm_ndpi_workflow *workflo
       }
       else memset(newflow->ndpi_flow, 0, SIZEOF_FLOW_STRUCT);
 
-      if ((newflow->src_id = ndpi_malloc(SIZEOF_ID_STRUCT)) == NULL) {
-	Log(LOG_ERR, "ERROR ( %s/core ): pm_ndpi_get_flow_info() not enough memory (3).\n", config.name);
-	exit(1);
-      }
-      else memset(newflow->src_id, 0, SIZEOF_ID_STRUCT);
-
-      if ((newflow->dst_id = ndpi_malloc(SIZEOF_ID_STRUCT)) == NULL) {
-	Log(LOG_ERR, "ERROR ( %s/core ): pm_ndpi_get_flow_info() not enough memory (4).\n", config.name);
-	exit(1);
-      }
-      else memset(newflow->dst_id, 0, SIZEOF_ID_STRUCT);
+      newflow->src_id = ((u_char *) newflow) + sizeof(struct pm_ndpi_flow_info);
+      newflow->dst_id = ((u_char *) newflow->src_id) + NDPI_ID_STRUCT_SZ;
 
-      pm_tsearch(newflow, &workflow->ndpi_flows_root[idx], pm_ndpi_workflow_node_cmp, 0); /* Add */
+      workflow->flows[idx].hash = newflow->hash;
+      workflow->flows[idx].flow = newflow;
+      pm_ndpi_lru_append(workflow, newflow);
       workflow->stats.ndpi_flow_count++;
 
       *src = newflow->src_id, *dst = newflow->dst_id;
@@ -248,15 +350,19 @@ struct pm_ndpi_flow_info *pm_ndpi_get_flow_info(struct pm_ndpi_workflow *workflo
     }
   }
   else {
-    struct pm_ndpi_flow_info *flow = *(struct pm_ndpi_flow_info**)ret;
+    /* most recently seen last; finished TCP flows stay first in line for expiry */
+    if (!ret->tcp_finished && ret != workflow->lru_tail) {
+      pm_ndpi_lru_unlink(workflow, ret);
+      pm_ndpi_lru_append(workflow, ret);
+    }
 
-    if (flow->lower_ip == lower_ip && flow->upper_ip == upper_ip
-       && flow->lower_port == lower_port && flow->upper_port == upper_port)
-      *src = flow->src_id, *dst = flow->dst_id;
+    if (ret->lower_ip == lower_ip && ret->upper_ip == upper_ip
+       && ret->lower_port == lower_port && ret->upper_port == upper_port)
+      *src = ret->src_id, *dst = ret->dst_id;
     else
-      *src = flow->dst_id, *dst = flow->src_id;
+      *src = ret->dst_id, *dst = ret->src_id;
 
-    return flow;
+    return ret;
   }
 }
 
@@ -368,7 +474,14 @@ struct ndpi_proto pm_ndpi_packet_processing(struct pm_ndpi_workflow *workflow,
 
   if (proto == IPPROTO_TCP) {
     struct pm_tcphdr *tcph = (struct pm_tcphdr *) pptrs->tlh_ptr;
-    if (tcph->th_flags & (TH_FIN|TH_RST)) flow->tcp_finished = TRUE;
+
+    if ((tcph->th_flags & (TH_FIN|TH_RST)) && !flow->tcp_finished) {
+      flow->tcp_finished = TRUE;
+
+      /* to be expired by the next idle sweep */
+      pm_ndpi_lru_unlink(workflow, flow);
+      pm_ndpi_lru_prepend(workflow, flow);
+    }
   }
 
   if (flow->detection_completed || flow->tcp_finished) {
@@ -450,50 +563,53 @@ u_int16_t pm_ndpi_node_guess_undetected_protocol(struct pm_ndpi_workflow *workfl
 }
 
 /*
- * Idle Scan Walker
+ * Idle flows sweep: flows are kept in least recently seen order, so
+ * each sweep only looks at the ones that are due, up to the budget
  */
-int pm_ndpi_node_idle_scan_walker(const void *node, const pm_VISIT which, const int depth, void *user_data)
+void pm_ndpi_idle_flows_cleanup(struct pm_ndpi_workflow *workflow)
 {
-  struct pm_ndpi_flow_info *flow = *(struct pm_ndpi_flow_info **) node;
-  struct pm_ndpi_workflow *workflow = (struct pm_ndpi_workflow *) user_data;
+  struct pm_ndpi_flow_info *flow;
+  u_int64_t idle_max_time;
+  u_int32_t budget;
 
-  if (!flow || !workflow) return FALSE;
+  if (!workflow) return;
+
+  if ((workflow->last_idle_scan_time + (workflow->prefs.idle_scan_period * NDPI_TICK_RESOLUTION)) < workflow->last_time) {
+    idle_max_time = workflow->prefs.idle_max_time * NDPI_TICK_RESOLUTION;
 
-  if (workflow->num_idle_flows == workflow->prefs.idle_scan_budget) return FALSE;
+    for (budget = workflow->prefs.idle_scan_budget; budget && (flow = workflow->lru_head); budget--) {
+      if (!flow->tcp_finished && (flow->last_seen + idle_max_time >= workflow->last_time)) break;
 
-  if ((which == ndpi_preorder) || (which == ndpi_leaf)) { /* Avoid walking the same node multiple times */
-    /* expire Idle and TCP finished flows */
-    if ((flow->last_seen + workflow->prefs.idle_max_time < workflow->last_time) ||
-	(flow->tcp_finished == TRUE)) {
-      /* adding to a queue (we can't delete it from the tree inline) */
-      workflow->idle_flows[workflow->num_idle_flows++] = flow;
+      pm_ndpi_lru_unlink(workflow, flow);
+      pm_ndpi_flow_delete(workflow, flow);
+      pm_ndpi_free_flow_info_half(flow);
+      pm_slab_free(&workflow->flow_slab, flow);
+      workflow->stats.ndpi_flow_count--;
     }
-  }
 
-  return TRUE;
+    workflow->last_idle_scan_time = workflow->last_time;
+  }
 }
 
-void pm_ndpi_idle_flows_cleanup(struct pm_ndpi_workflow *workflow)
+void pm_ndpi_workflow_stats(struct pm_ndpi_workflow *workflow)
 {
-  if (!workflow) return;
+  time_t now = time(NULL);
+  u_int64_t lookups;
+  u_int32_t buckets;
 
-  if ((workflow->last_idle_scan_time + workflow->prefs.idle_scan_period) < workflow->last_time) {
-    /* scan for idle flows */
-    pm_twalk(workflow->ndpi_flows_root[workflow->idle_scan_idx], pm_ndpi_node_idle_scan_walker, workflow);
+  if (!workflow || !workflow->flows) return;
 
-    /* remove idle flows (unfortunately we cannot do this inline) */
-    while (workflow->num_idle_flows > 0) {
-      /* search and delete the idle flow from the "ndpi_flow_root" (see struct reader thread) - here flows are the node of a b-tree */
-      pm_tdelete(workflow->idle_flows[--workflow->num_idle_flows], &workflow->ndpi_flows_root[workflow->idle_scan_idx], pm_ndpi_workflow_node_cmp);
+  buckets = workflow->flows_mask + 1;
+  lookups = workflow->stats.flow_lookups - workflow->stats_lookups;
 
-      /* free the memory associated to idle flow in "idle_flows" - (see struct reader thread)*/
-      pm_ndpi_free_flow_info_half(workflow->idle_flows[workflow->num_idle_flows]);
-      ndpi_free(workflow->idle_flows[workflow->num_idle_flows]);
-      workflow->stats.ndpi_flow_count--;
-    }
+  Log(LOG_NOTICE, "NOTICE ( %s/%s ): nDPI flows: %u/%u buckets (%.1f%% full), %llu lookups/s, %.2f probes/lookup, %llu%% hits\n",
+	config.name, config.type, workflow->stats.ndpi_flow_count, buckets,
+	(double) workflow->stats.ndpi_flow_count * 100 / buckets,
+	(unsigned long long) (lookups / ((now > workflow->stats_time) ? (now - workflow->stats_time) : 1)),
+	workflow->stats.flow_lookups ? (double) workflow->stats.flow_probes / workflow->stats.flow_lookups : 0,
+	(unsigned long long) (workflow->stats.flow_lookups ? (workflow->stats.flow_lookup_hits * 100 / workflow->stats.flow_lookups) : 0));
 
-    if (++workflow->idle_scan_idx == workflow->prefs.num_roots) workflow->idle_scan_idx = 0;
-    workflow->last_idle_scan_time = workflow->last_time;
-  }
+  workflow->stats_time = now;
+  workflow->stats_lookups = workflow->stats.flow_lookups;
 }
 #endif
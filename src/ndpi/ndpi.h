@@ -31,7 +31,7 @@
 #define NDPI_IDLE_SCAN_PERIOD		10
 #define NDPI_IDLE_MAX_TIME		600
 #define NDPI_IDLE_SCAN_BUDGET		1024
-#define NDPI_NUM_ROOTS			512
+#define NDPI_NUM_ROOTS			512	/* initial flow table buckets */
 #define NDPI_MAXFLOWS			200000000
 #define NDPI_TICK_RESOLUTION		1000
 #define NDPI_GIVEUP_PROTO_TCP		10
@@ -61,8 +61,23 @@ typedef struct pm_ndpi_flow_info {
 
   void *src_id;
   void *dst_id;
+
+  /* flow table */
+  u_int32_t hash;
+  struct pm_ndpi_flow_info *lru_prev;
+  struct pm_ndpi_flow_info *lru_next;
 } pm_ndpi_flow_info_t;
 
+/* nDPI id structs are carved out of the same slab object as the flow */
+#define NDPI_ID_STRUCT_SZ		((SIZEOF_ID_STRUCT + 7) & ~7)
+#define NDPI_FLOW_INFO_SZ		(sizeof(struct pm_ndpi_flow_info) + 2 * NDPI_ID_STRUCT_SZ)
+
+/* flow table slot, open addressing with linear probing; empty if !flow */
+struct pm_ndpi_flow_slot {
+  u_int32_t hash;
+  struct pm_ndpi_flow_info *flow;
+};
+
 /* flow statistics info */
 typedef struct pm_ndpi_stats {
   u_int32_t guessed_flow_protocols;
@@ -77,6 +92,7 @@ typedef struct pm_ndpi_stats {
   u_int64_t mpls_count, pppoe_count, vlan_count, fragmented_count;
   u_int64_t packet_len[6];
   u_int16_t max_packet_len;
+  u_int64_t flow_lookups, flow_lookup_hits, flow_probes;
 } pm_ndpi_stats_t;
 
 /* flow preferences */
@@ -100,15 +116,23 @@ typedef struct pm_ndpi_workflow {
   u_int64_t last_time;
 
   u_int64_t last_idle_scan_time;
-  u_int32_t num_idle_flows;
-  u_int32_t idle_scan_idx;
-  struct pm_ndpi_flow_info *idle_flows[NDPI_IDLE_SCAN_BUDGET];
 
   struct pm_ndpi_workflow_prefs prefs;
   struct pm_ndpi_stats stats;
 
-  /* allocated by prefs */
-  void **ndpi_flows_root;
+  /* flow table: slots grow by doubling up to max_buckets; flows are kept
+     in least recently seen order for the idle sweep */
+  struct pm_ndpi_flow_slot *flows;
+  u_int32_t flows_mask;
+  u_int32_t max_buckets;
+  struct pm_slab flow_slab;
+  struct pm_ndpi_flow_info *lru_head;
+  struct pm_ndpi_flow_info *lru_tail;
+
+  /* last stats report */
+  time_t stats_time;
+  u_int64_t stats_lookups;
+
   struct ndpi_detection_module_struct *ndpi_struct;
 } pm_ndpi_workflow_t;
 
@@ -121,15 +145,12 @@ typedef struct pm_ndpi_workflow {
 EXT struct pm_ndpi_workflow *pm_ndpi_wfl;
 
 /* prototypes */
-/* Free flow_info ndpi support structures but not the flow_info itself */
+/* Free flow_info nDPI flow state but not the flow_info itself */
 EXT void pm_ndpi_free_flow_info_half(struct pm_ndpi_flow_info *);
 
 /* Process a packet and update the workflow  */
 EXT struct ndpi_proto pm_ndpi_workflow_process_packet(struct pm_ndpi_workflow *, struct packet_ptrs *);
 
-/* compare two nodes in workflow */
-EXT int pm_ndpi_workflow_node_cmp(const void *, const void *);
-
 EXT struct pm_ndpi_flow_info *pm_ndpi_get_flow_info(struct pm_ndpi_workflow *, struct packet_ptrs *, u_int16_t, const struct ndpi_iphdr *,
 						const struct ndpi_ipv6hdr *, u_int16_t, u_int16_t, u_int16_t, struct ndpi_tcphdr **,
 						struct ndpi_udphdr **, u_int16_t *, u_int16_t *, struct ndpi_id_struct **,
@@ -143,6 +164,5 @@ EXT struct ndpi_proto pm_ndpi_packet_processing(struct pm_ndpi_workflow *, struc
 
 EXT u_int16_t pm_ndpi_node_guess_undetected_protocol(struct pm_ndpi_workflow *, struct pm_ndpi_flow_info *);
 EXT void pm_ndpi_idle_flows_cleanup(struct pm_ndpi_workflow *);
-
-EXT int pm_ndpi_node_idle_scan_walker(const void *, const pm_VISIT, const int, void *);
+EXT void pm_ndpi_workflow_stats(struct pm_ndpi_workflow *);
 #undef EXT
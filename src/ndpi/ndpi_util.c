@@ -31,6 +31,7 @@ struct pm_ndpi_workflow *pm_ndpi_workflow_init()
 {
   struct ndpi_detection_module_struct *module = ndpi_init_detection_module();
   struct pm_ndpi_workflow *workflow = ndpi_calloc(1, sizeof(struct pm_ndpi_workflow));
+  u_int32_t buckets = 2;
 
   log_notification_init(&log_notifications.ndpi_cache_full);
   log_notification_init(&log_notifications.ndpi_tmp_frag_warn);
@@ -71,7 +72,21 @@ struct pm_ndpi_workflow *pm_ndpi_workflow_init()
     exit(1);
   }
 
-  workflow->ndpi_flows_root = ndpi_calloc(workflow->prefs.num_roots, sizeof(void *));
+  /* flow table: starts at num_roots, may grow until 2 x max_ndpi_flows */
+  while (buckets < workflow->prefs.num_roots && buckets < (1U << 31)) buckets <<= 1;
+  workflow->flows = calloc(buckets, sizeof(struct pm_ndpi_flow_slot));
+  workflow->flows_mask = buckets - 1;
+
+  for (workflow->max_buckets = buckets; workflow->max_buckets / 2 < workflow->prefs.max_ndpi_flows &&
+       workflow->max_buckets < (1U << 31); workflow->max_buckets <<= 1);
+
+  if (!workflow->flows) {
+    Log(LOG_ERR, "ERROR ( %s/core ): nDPI flow table allocation failed.\n", config.name);
+    exit(1);
+  }
+
+  pm_slab_init(&workflow->flow_slab, NDPI_FLOW_INFO_SZ);
+  workflow->stats_time = time(NULL);
 
   return workflow;
 }
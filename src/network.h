@@ -423,6 +423,7 @@ struct pkt_primitives {
 #endif
   pm_id_t tag;
   pm_id_t tag2;
+  u_int32_t label_id;
   pm_class_t class;
   u_int32_t sampling_rate;
   u_int16_t pkt_len_distrib;
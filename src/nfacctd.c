@@ -119,6 +119,7 @@ int main(int argc,char **argv, char **envp)
   struct ip_mreq multi_req4;
 
   struct pcap_device device;
+  struct timespec stats_ts;
 
   unsigned char dummy_packet[64]; 
   unsigned char dummy_packet_vlan[64]; 
@@ -407,6 +408,8 @@ int main(int argc,char **argv, char **envp)
     else Log(LOG_INFO, "INFO ( %s/core ): proc_priority set to %d\n", config.name, getpriority(PRIO_PROCESS, 0));
   }
 
+  if (config.cpu_affinity) pm_set_placement(config.cpu_affinity, config.numa_bind, config.name, "core");
+
   Log(LOG_INFO, "INFO ( %s/core ): %s (%s)\n", config.name, NFACCTD_USAGE_HEADER, PMACCT_BUILD);
   Log(LOG_INFO, "INFO ( %s/core ): %s\n", config.name, PMACCT_COMPILE_ARGS);
 
@@ -950,15 +953,29 @@ int main(int argc,char **argv, char **envp)
   /* fixing NetFlow v9/IPFIX template func pointers */
   get_ext_db_ie_by_type = &ext_db_get_ie;
 
+  /* wake up periodically to commit buffers held for too long, see plugin_buffer_latency */
+  if (pipe_buffer_latency && !config.pcap_savefile) {
+    struct timeval rcvtimeo;
+
+    rcvtimeo.tv_sec = (pipe_buffer_latency / 1000);
+    rcvtimeo.tv_usec = ((pipe_buffer_latency % 1000) * 1000);
+    if (setsockopt(config.sock, SOL_SOCKET, SO_RCVTIMEO, &rcvtimeo, sizeof(rcvtimeo)) < 0)
+      Log(LOG_WARNING, "WARN ( %s/core ): setsockopt() failed for SO_RCVTIMEO.\n", config.name);
+  }
+
   /* Main loop */
   for (;;) {
     if (!config.pcap_savefile) {
+      STATS_START(stats_ts);
       ret = recvfrom(config.sock, netflow_packet, NETFLOW_MSG_SIZE, 0, (struct sockaddr *) &client, &clen);
+      STATS_STOP(STATS_RECV, stats_ts);
     }
     else {
       ret = recvfrom_savefile(&device, (void **) &netflow_packet, (struct sockaddr *) &client, NULL);
     }
 
+    commit_expired_pipe_buffers();
+
     /* we have no data or not not enough data to decode the version */
     if (!netflow_packet || ret < 2) continue;
     pptrs.v4.f_len = ret;
@@ -998,6 +1015,8 @@ int main(int argc,char **argv, char **envp)
     }
 
     if (data_plugins) {
+      STATS_START(stats_ts);
+
       /* We will change byte ordering in order to avoid a bunch of ntohs() calls */
       ((struct struct_header_v5 *)netflow_packet)->version = ntohs(((struct struct_header_v5 *)netflow_packet)->version);
       reset_tag_label_status(&pptrs);
@@ -1028,6 +1047,8 @@ int main(int argc,char **argv, char **envp)
         }
 	break;
       }
+
+      STATS_STOP(STATS_DECODE, stats_ts);
     }
     else if (tee_plugins) {
       process_raw_packet(netflow_packet, ret, &pptrs, &req);
@@ -72,9 +72,9 @@ send_netflow_v1(struct FLOW **flows, int num_flows, int nfsock,
 	u_int8_t packet[NF1_MAXPACKET_SIZE];	/* Maximum allowed packet size (24 flows) */
 	struct NF1_HEADER *hdr = NULL;
 	struct NF1_FLOW *flw = NULL;
-	int i, j, offset, num_packets, err;
-	socklen_t errsz;
+	int i, j, offset, num_packets;
 	
+	nf_sendq.fd = nfsock;
 	gettimeofday(&now, NULL);
 	uptime_ms = timeval_sub_ms(&now, system_boot_time);
 
@@ -84,11 +84,8 @@ send_netflow_v1(struct FLOW **flows, int num_flows, int nfsock,
 			if (verbose_flag)
 				Log(LOG_DEBUG, "Sending flow packet len = %d\n", offset);
 			hdr->flows = htons(hdr->flows);
-			errsz = sizeof(err);
-			getsockopt(nfsock, SOL_SOCKET, SO_ERROR,
-			    &err, &errsz); /* Clear ICMP errors */
-			if (send(nfsock, packet, (size_t)offset, 0) == -1) {
-			  Log(LOG_WARNING, "WARN ( %s/%s ): send() failed: %s\n", config.name, config.type, strerror(errno));
+			if (pm_sendq_add(&nf_sendq, packet, offset) == ERR) {
+			  Log(LOG_WARNING, "WARN ( %s/%s ): send() failed: %s\n", config.name, config.type, strerror(nf_sendq.last_errno));
 			  return (-1);
 			}
 			*flows_exported += j;
@@ -162,16 +159,19 @@ send_netflow_v1(struct FLOW **flows, int num_flows, int nfsock,
 		if (verbose_flag)
 			Log(LOG_DEBUG, "Sending flow packet len = %d\n", offset);
 		hdr->flows = htons(hdr->flows);
-		errsz = sizeof(err);
-		getsockopt(nfsock, SOL_SOCKET, SO_ERROR,
-		    &err, &errsz); /* Clear ICMP errors */
-		if (send(nfsock, packet, (size_t)offset, 0) == -1) {
-		  Log(LOG_WARNING, "WARN ( %s/%s ): send() failed: %s\n", config.name, config.type, strerror(errno));
+		if (pm_sendq_add(&nf_sendq, packet, offset) == ERR) {
+		  Log(LOG_WARNING, "WARN ( %s/%s ): send() failed: %s\n", config.name, config.type, strerror(nf_sendq.last_errno));
 		  return (-1);
 		}
 		num_packets++;
 	}
 
 	*flows_exported += j;
+	/* Datagrams are queued by pm_sendq_add(), push out what is left */
+	if (pm_sendq_flush(&nf_sendq) == ERR) {
+	  Log(LOG_WARNING, "WARN ( %s/%s ): send() failed: %s\n", config.name, config.type, strerror(nf_sendq.last_errno));
+	  return (-1);
+	}
+
 	return (num_packets);
 }
@@ -2038,11 +2038,11 @@ send_netflow_v9(struct FLOW **flows, int num_flows, int nfsock,
 	u_int offset, last_af, flow_j, num_packets, inc, last_valid;
 	u_int num_class, class_j;
 	int direction, new_direction;
-	socklen_t errsz;
-	int err, r, flow_i, class_i;
+	int r, flow_i, class_i;
 	u_int8_t *sid_ptr;
 
 	memset(packet, 0, sizeof(packet));
+	nf_sendq.fd = nfsock;
 	gettimeofday(&now, NULL);
 
 	if (nf9_pkts_until_template == -1) {
@@ -2277,11 +2277,8 @@ send_netflow_v9(struct FLOW **flows, int num_flows, int nfsock,
 
 		  if (verbose_flag)
 		    Log(LOG_DEBUG, "DEBUG ( %s/%s ): Sending NetFlow v9/IPFIX packet: len = %d\n", config.name, config.type, offset);
-		  errsz = sizeof(err);
-		  /* Clear ICMP errors */
-		  getsockopt(nfsock, SOL_SOCKET, SO_ERROR, &err, &errsz); 
-		  if (send(nfsock, packet, (size_t)offset, 0) == -1) {
-		    Log(LOG_WARNING, "WARN ( %s/%s ): send() failed: %s\n", config.name, config.type, strerror(errno));
+		  if (pm_sendq_add(&nf_sendq, packet, offset) == ERR) {
+		    Log(LOG_WARNING, "WARN ( %s/%s ): send() failed: %s\n", config.name, config.type, strerror(nf_sendq.last_errno));
 		    return (-1);
 		  }
 		  num_packets++;
@@ -2296,5 +2293,11 @@ send_netflow_v9(struct FLOW **flows, int num_flows, int nfsock,
 	  }
 	}
 
+	/* Datagrams are queued by pm_sendq_add(), push out what is left */
+	if (pm_sendq_flush(&nf_sendq) == ERR) {
+	  Log(LOG_WARNING, "WARN ( %s/%s ): send() failed: %s\n", config.name, config.type, strerror(nf_sendq.last_errno));
+	  return (-1);
+	}
+
 	return (num_packets);
 }
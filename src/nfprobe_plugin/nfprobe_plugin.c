@@ -62,11 +62,19 @@
 #include "plugin_hooks.h"
 #include "net_aggr.h"
 #include "ports_aggr.h"
+#include "jhash.h"
 
 /* Global variables */
 static int verbose_flag = 0;		/* Debugging flag */
 static int timeout = 0;
 struct FLOWTRACK *glob_flowtrack = NULL;
+struct pm_sendq nf_sendq;
+
+static u_int32_t flow_hash_rnd = 140281;
+
+/* Flows queued for export by the current expiry scan */
+static struct FLOW **expired_flows = NULL;
+static int num_expired = 0, max_expired = 0;
 
 /* Prototypes */
 static void force_expire(struct FLOWTRACK *, u_int32_t);
@@ -156,29 +164,74 @@ flow_compare(struct FLOW *a, struct FLOW *b)
 	return (0);
 }
 
-/* Generate functions for flow tree */
-FLOW_PROTOTYPE(FLOWS, FLOW, trp, flow_compare);
-FLOW_GENERATE(FLOWS, FLOW, trp, flow_compare);
-
 /*
- * This is the expiry comparison function.
+ * Hash a flow identity; flows are stored in canonical format so both
+ * directions land in the same bucket.
  */
-static int
-expiry_compare(struct EXPIRY *a, struct EXPIRY *b)
+static u_int32_t
+flow_hash(struct FLOW *flow)
 {
-	if (a->expires_at != b->expires_at)
-		return (a->expires_at > b->expires_at ? 1 : -1);
+	u_int32_t a;
 
-	/* Make expiry entries unique by comparing flow sequence */
-	if (a->flow->flow_seq != b->flow->flow_seq)
-		return (a->flow->flow_seq > b->flow->flow_seq ? 1 : -1);
+	a = jhash(&flow->addr, sizeof(flow->addr), flow_hash_rnd);
 
-	return (0);
+	return (jhash_3words(a, ((u_int32_t)flow->port[0] << 16) | flow->port[1],
+	    ((u_int32_t)flow->af << 8) | flow->protocol, flow_hash_rnd));
 }
 
-/* Generate functions for flow tree */
-EXPIRY_PROTOTYPE(EXPIRIES, EXPIRY, trp, expiry_compare);
-EXPIRY_GENERATE(EXPIRIES, EXPIRY, trp, expiry_compare);
+static struct FLOW *
+flow_find(struct FLOWTRACK *ft, struct FLOW *key)
+{
+	struct FLOW *flow;
+
+	for (flow = ft->flows[key->hash & ft->flows_mask]; flow != NULL; flow = flow->hnext) {
+		if (flow->hash == key->hash && !flow_compare(flow, key))
+			return (flow);
+	}
+
+	return (NULL);
+}
+
+static void
+flow_link(struct FLOWTRACK *ft, struct FLOW *flow)
+{
+	struct FLOW **bucket = &ft->flows[flow->hash & ft->flows_mask];
+
+	flow->hprev = NULL;
+	flow->hnext = *bucket;
+	if (*bucket != NULL)
+		(*bucket)->hprev = flow;
+	*bucket = flow;
+}
+
+static void
+flow_unlink(struct FLOWTRACK *ft, struct FLOW *flow)
+{
+	if (flow->hprev != NULL)
+		flow->hprev->hnext = flow->hnext;
+	else
+		ft->flows[flow->hash & ft->flows_mask] = flow->hnext;
+
+	if (flow->hnext != NULL)
+		flow->hnext->hprev = flow->hprev;
+
+	flow->hnext = flow->hprev = NULL;
+}
+
+static struct FLOW *
+flow_from_timer(struct pm_timer *t)
+{
+	return ((struct FLOW *)((char *)t - offsetof(struct FLOW, expiry.tmr)));
+}
+
+/* Queue a flow for immediate disposal, in order of arrival */
+static void
+flow_expire_now(struct FLOWTRACK *ft, struct FLOW *flow)
+{
+	flow->expire_next = NULL;
+	*ft->expire_now_tail = flow;
+	ft->expire_now_tail = &flow->expire_next;
+}
 
 /* Format a time in an ISOish format */
 static const char *
@@ -566,28 +619,26 @@ ipv6_to_flowrec_update(struct FLOW *flow, struct primitives_ptrs *prim_ptrs, int
 static void
 flow_update_expiry(struct FLOWTRACK *ft, struct FLOW *flow)
 {
-	EXPIRY_REMOVE(EXPIRIES, &ft->expiries, flow->expiry);
-
 #if defined HAVE_64BIT_COUNTERS
         if (config.nfprobe_version == 9 || config.nfprobe_version == 10) {
 	  if (flow->octets[0] > (1ULL << 63) || flow->octets[1] > (1ULL << 63)) { 
-                flow->expiry->expires_at = 0;
-                flow->expiry->reason = R_OVERBYTES;
+                flow->expiry.expires_at = 0;
+                flow->expiry.reason = R_OVERBYTES;
                 goto out;
 	  }
         }
 	else {
           if (flow->octets[0] > (1U << 31) || flow->octets[1] > (1U << 31)) {
-                flow->expiry->expires_at = 0;
-                flow->expiry->reason = R_OVERBYTES;
+                flow->expiry.expires_at = 0;
+                flow->expiry.reason = R_OVERBYTES;
                 goto out;
           }
 	}
 #else
 	/* Flows over 2Gb traffic */
 	if (flow->octets[0] > (1U << 31) || flow->octets[1] > (1U << 31)) {
-		flow->expiry->expires_at = 0;
-		flow->expiry->reason = R_OVERBYTES;
+		flow->expiry.expires_at = 0;
+		flow->expiry.reason = R_OVERBYTES;
 		goto out;
 	}
 #endif
@@ -596,8 +647,8 @@ flow_update_expiry(struct FLOWTRACK *ft, struct FLOW *flow)
 	if (ft->maximum_lifetime != 0 && 
 	    flow->flow_last.tv_sec - flow->flow_start.tv_sec > 
 	    ft->maximum_lifetime) {
-		flow->expiry->expires_at = 0;
-		flow->expiry->reason = R_MAXLIFE;
+		flow->expiry.expires_at = 0;
+		flow->expiry.reason = R_MAXLIFE;
 		goto out;
 	}
 	
@@ -606,35 +657,35 @@ flow_update_expiry(struct FLOWTRACK *ft, struct FLOW *flow)
 		if (ft->tcp_rst_timeout != 0 &&
 		    ((flow->tcp_flags[0] & TH_RST) ||
 		    (flow->tcp_flags[1] & TH_RST))) {
-			flow->expiry->expires_at = flow->flow_last.tv_sec + 
+			flow->expiry.expires_at = flow->flow_last.tv_sec + 
 			    ft->tcp_rst_timeout;
-			flow->expiry->reason = R_TCP_RST;
+			flow->expiry.reason = R_TCP_RST;
 			goto out;
 		}
 		/* Finished TCP flows */
 		if (ft->tcp_fin_timeout != 0 &&
 		    ((flow->tcp_flags[0] & TH_FIN) &&
 		    (flow->tcp_flags[1] & TH_FIN))) {
-			flow->expiry->expires_at = flow->flow_last.tv_sec + 
+			flow->expiry.expires_at = flow->flow_last.tv_sec + 
 			    ft->tcp_fin_timeout;
-			flow->expiry->reason = R_TCP_FIN;
+			flow->expiry.reason = R_TCP_FIN;
 			goto out;
 		}
 
 		/* TCP flows */
 		if (ft->tcp_timeout != 0) {
-			flow->expiry->expires_at = flow->flow_last.tv_sec + 
+			flow->expiry.expires_at = flow->flow_last.tv_sec + 
 			    ft->tcp_timeout;
-			flow->expiry->reason = R_TCP;
+			flow->expiry.reason = R_TCP;
 			goto out;
 		}
 	}
 
 	if (ft->udp_timeout != 0 && flow->protocol == IPPROTO_UDP) {
 		/* UDP flows */
-		flow->expiry->expires_at = flow->flow_last.tv_sec + 
+		flow->expiry.expires_at = flow->flow_last.tv_sec + 
 		    ft->udp_timeout;
-		flow->expiry->reason = R_UDP;
+		flow->expiry.reason = R_UDP;
 		goto out;
 	}
 
@@ -645,19 +696,25 @@ flow_update_expiry(struct FLOWTRACK *ft, struct FLOW *flow)
 #endif
 	   )) {
 		/* UDP flows */
-		flow->expiry->expires_at = flow->flow_last.tv_sec + 
+		flow->expiry.expires_at = flow->flow_last.tv_sec + 
 		    ft->icmp_timeout;
-		flow->expiry->reason = R_ICMP;
+		flow->expiry.reason = R_ICMP;
 		goto out;
 	}
 
 	/* Everything else */
-	flow->expiry->expires_at = flow->flow_last.tv_sec + 
+	flow->expiry.expires_at = flow->flow_last.tv_sec + 
 	    ft->general_timeout;
-	flow->expiry->reason = R_GENERAL;
+	flow->expiry.reason = R_GENERAL;
 
  out:
-	EXPIRY_INSERT(EXPIRIES, &ft->expiries, flow->expiry);
+	if (flow->expiry.expires_at == 0) {
+		pm_timer_del(&ft->expiries, &flow->expiry.tmr);
+		flow_expire_now(ft, flow);
+	}
+	else if (flow->expiry.tmr.next == NULL ||
+	    flow->expiry.tmr.deadline != flow->expiry.expires_at)
+		pm_timer_add(&ft->expiries, &flow->expiry.tmr, flow->expiry.expires_at);
 }
 
 void free_flow_allocs(struct FLOW *flow)
@@ -712,25 +769,26 @@ process_packet(struct FLOWTRACK *ft, struct primitives_ptrs *prim_ptrs, const st
   if (frag)
     ft->frag_packets += data->pkt_num;
 
+  tmp.hash = flow_hash(&tmp);
+
   /* If a matching flow does not exist, create and insert one */
-  if (dont_summarize || ((flow = FLOW_FIND(FLOWS, &ft->flows, &tmp)) == NULL)) {
+  if (dont_summarize || ((flow = flow_find(ft, &tmp)) == NULL)) {
     /* Allocate and fill in the flow */
-    if ((flow = malloc(sizeof(*flow))) == NULL) return (PP_MALLOC_FAIL);
+    if ((flow = pm_slab_alloc(&ft->flow_slab)) == NULL) return (PP_MALLOC_FAIL);
     memcpy(flow, &tmp, sizeof(*flow));
     memcpy(&flow->flow_start, received_time, sizeof(flow->flow_start));
     flow->flow_seq = ft->next_flow_seq++;
-    FLOW_INSERT(FLOWS, &ft->flows, flow);
+    flow_link(ft, flow);
 
-    /* Allocate and fill in the associated expiry event */
-    if ((flow->expiry = malloc(sizeof(*flow->expiry))) == NULL)
-      return (PP_MALLOC_FAIL);
-    flow->expiry->flow = flow;
-    /* Expiration note: 0 means expire immediately; we prefer this to happen 
+    /* Fill in the associated expiry event (tmp is zeroed, timer unlinked).
+       Expiration note: 0 means expire immediately; we prefer this to happen 
        when attaching to nfacctd - ie. dont_summarize is TRUE */
-    if (!dont_summarize) flow->expiry->expires_at = 1;
-    else flow->expiry->expires_at = 0;
-    flow->expiry->reason = R_GENERAL;
-    EXPIRY_INSERT(EXPIRIES, &ft->expiries, flow->expiry);
+    flow->expiry.reason = R_GENERAL;
+    if (!dont_summarize) flow->expiry.expires_at = 1;
+    else {
+      flow->expiry.expires_at = 0;
+      flow_expire_now(ft, flow);
+    }
 
     if (data->flo_num) ft->num_flows += data->flo_num;
     else ft->num_flows++;
@@ -776,7 +834,7 @@ process_packet(struct FLOWTRACK *ft, struct primitives_ptrs *prim_ptrs, const st
 	
   memcpy(&flow->flow_last, received_time, sizeof(flow->flow_last));
 
-  if (flow->expiry->expires_at != 0) flow_update_expiry(ft, flow);
+  if (flow->expiry.expires_at != 0) flow_update_expiry(ft, flow);
 
   return (PP_OK);
 }
@@ -885,38 +943,76 @@ update_expiry_stats(struct FLOWTRACK *ft, struct EXPIRY *e)
 static int
 next_expire(struct FLOWTRACK *ft)
 {
-	struct EXPIRY *expiry;
 	struct timeval now;
-	u_int32_t expires_at, ret, fudge;
 
-	gettimeofday(&now, NULL);
+	/* Don't cluster urgent expiries */
+	if (ft->expire_now != NULL)
+		return (0); /* Now */
 
-	if ((expiry = EXPIRY_MIN(EXPIRIES, &ft->expiries)) == NULL)
+	if (ft->expiries.count == 0)
 		return (-1); /* indefinite */
 
-	expires_at = expiry->expires_at;
+	gettimeofday(&now, NULL);
 
-	/* Don't cluster urgent expiries */
-	if (expires_at == 0 && (expiry->reason == R_OVERBYTES || 
-	    expiry->reason == R_OVERFLOWS || expiry->reason == R_FLUSH))
+	/*
+	 * Expiries are clustered by expiry_interval: the wheel is only
+	 * scanned once per interval, picking up whatever fell due since.
+	 */
+	if (ft->next_expiry_check <= now.tv_sec)
 		return (0); /* Now */
 
-	/* Cluster expiries by expiry_interval */
-	if (ft->expiry_interval > 1) {
-		if ((fudge = expires_at % ft->expiry_interval) > 0)
-			expires_at += ft->expiry_interval - fudge;
+	return (999 + (ft->next_expiry_check - now.tv_sec - 1) * 1000);
+}
+
+/*
+ * Take an expired flow out of the hash table and queue it for export.
+ */
+static void
+queue_expired(struct FLOWTRACK *ft, struct FLOW *flow)
+{
+	struct FLOW **oldexp;
+
+	if (verbose_flag)
+		Log(LOG_DEBUG, "DEBUG ( %s/%s ): Queuing flow seq:%llu (%p) for expiry\n",
+		   config.name, config.type, flow->flow_seq, flow);
+
+	update_expiry_stats(ft, &flow->expiry);
+
+	/* Remove from flow table */
+	flow_unlink(ft, flow);
+	ft->num_flows--;
+
+	/* Add to array of expired flows */
+	if (num_expired == max_expired) {
+		oldexp = expired_flows;
+		expired_flows = realloc(expired_flows,
+		    sizeof(*expired_flows) * (max_expired ? max_expired * 2 : 64));
+		/* Don't fatal on realloc failures */
+		if (expired_flows == NULL) {
+			expired_flows = oldexp;
+			ft->flows_dropped++;
+			free_flow_allocs(flow);
+			pm_slab_free(&ft->flow_slab, flow);
+			return;
+		}
+		max_expired = (max_expired ? max_expired * 2 : 64);
 	}
 
-	if (expires_at < now.tv_sec)
-		return (0); /* Now */
+	expired_flows[num_expired] = flow;
+	num_expired++;
+}
 
-	ret = 999 + (expires_at - now.tv_sec) * 1000;
-	return (ret);
+/* Timer wheel callback: the timer comes in already unlinked */
+static void
+flow_timer_cb(struct pm_timer *t, time_t now)
+{
+	queue_expired(glob_flowtrack, flow_from_timer(t));
 }
 
 /*
- * Scan the tree of expiry events and process expired flows. If zap_all
- * is set, then forcibly expire all flows.
+ * Process expired flows: those queued for immediate disposal first, then
+ * the due ones off the timer wheel. If zap_all is set, then forcibly
+ * expire all flows.
  */
 #define CE_EXPIRE_NORMAL	0  /* Normal expiry processing */
 #define CE_EXPIRE_ALL		-1 /* Expire all flows immediately */
@@ -924,59 +1020,48 @@ next_expire(struct FLOWTRACK *ft)
 static int
 check_expired(struct FLOWTRACK *ft, struct NETFLOW_TARGET *target, int ex, u_int8_t engine_type, u_int8_t engine_id)
 {
-	struct FLOW **expired_flows, **oldexp;
-	int num_expired, i, r;
+	struct FLOW *flow, *nflow;
+	int i, r;
+	u_int32_t bucket;
 	struct timeval now;
 
-	struct EXPIRY *expiry, *nexpiry;
-
 	gettimeofday(&now, NULL);
 
 	r = 0;
 	num_expired = 0;
-	expired_flows = NULL;
 
 	if (verbose_flag)
 	  Log(LOG_DEBUG, "DEBUG ( %s/%s ): Starting expiry scan: mode %d\n", config.name, config.type, ex);
 
-	for(expiry = EXPIRY_MIN(EXPIRIES, &ft->expiries);
-	    expiry != NULL;
-	    expiry = nexpiry) {
-		nexpiry = EXPIRY_NEXT(EXPIRIES, &ft->expiries, expiry);
-		if ((expiry->expires_at == 0) || (ex == CE_EXPIRE_ALL) || 
-		    (ex != CE_EXPIRE_FORCED &&
-		    (expiry->expires_at < now.tv_sec))) {
-			/* Flow has expired */
-			if (verbose_flag)
-				Log(LOG_DEBUG, "DEBUG ( %s/%s ): Queuing flow seq:%llu (%p) for expiry\n",
-				   config.name, config.type, expiry->flow->flow_seq, expiry->flow);
-
-			/* Add to array of expired flows */
-			oldexp = expired_flows;
-			expired_flows = realloc(expired_flows,
-			    sizeof(*expired_flows) * (num_expired + 1));
-			/* Don't fatal on realloc failures */
-			if (expired_flows == NULL)
-				expired_flows = oldexp;
-			else {
-				expired_flows[num_expired] = expiry->flow;
-				num_expired++;
+	for (flow = ft->expire_now; flow != NULL; flow = nflow) {
+		nflow = flow->expire_next;
+		if (ex == CE_EXPIRE_ALL)
+			flow->expiry.reason = R_FLUSH;
+		queue_expired(ft, flow);
+	}
+	ft->expire_now = NULL;
+	ft->expire_now_tail = &ft->expire_now;
+
+	if (ex == CE_EXPIRE_ALL) {
+		/* Only flows with a timer armed are left in the table */
+		for (bucket = 0; bucket <= ft->flows_mask; bucket++) {
+			for (flow = ft->flows[bucket]; flow != NULL; flow = nflow) {
+				nflow = flow->hnext;
+				pm_timer_del(&ft->expiries, &flow->expiry.tmr);
+				flow->expiry.reason = R_FLUSH;
+				queue_expired(ft, flow);
 			}
-
-			if (ex == CE_EXPIRE_ALL)
-				expiry->reason = R_FLUSH;
-
-			update_expiry_stats(ft, expiry);
-
-			/* Remove from flow tree, destroy expiry event */
-			FLOW_REMOVE(FLOWS, &ft->flows, expiry->flow);
-			EXPIRY_REMOVE(EXPIRIES, &ft->expiries, expiry);
-			expiry->flow->expiry = NULL;
-			free(expiry);
-
-			ft->num_flows--;
 		}
 	}
+	else if (ex == CE_EXPIRE_NORMAL) {
+		/* The wheel fires deadline <= now: expire flows with expires_at < now */
+		pm_timer_wheel_expire(&ft->expiries, now.tv_sec - 1, flow_timer_cb);
+
+		ft->next_expiry_check = now.tv_sec + 1;
+		if (ft->expiry_interval > 1)
+			ft->next_expiry_check += ft->expiry_interval -
+			    (ft->next_expiry_check % ft->expiry_interval);
+	}
 
 	if (verbose_flag)
 		Log(LOG_DEBUG, "DEBUG ( %s/%s ): Finished scan %d flow(s) to be evicted\n", config.name, config.type, num_expired);
@@ -988,9 +1073,8 @@ check_expired(struct FLOWTRACK *ft, struct NETFLOW_TARGET *target, int ex, u_int
 			  Log(LOG_WARNING, "WARN ( %s/%s ): No connection to collector, discarding flows\n", config.name, config.type);
 			  for (i = 0; i < num_expired; i++) {
 				  free_flow_allocs(expired_flows[i]);
-				  free(expired_flows[i]);
+				  pm_slab_free(&ft->flow_slab, expired_flows[i]);
 			  }
-			  free(expired_flows);
 			  return -1;
                         }
 			else {
@@ -1016,10 +1100,8 @@ check_expired(struct FLOWTRACK *ft, struct NETFLOW_TARGET *target, int ex, u_int
 			update_statistics(ft, expired_flows[i]);
 
 			free_flow_allocs(expired_flows[i]);
-			free(expired_flows[i]);
+			pm_slab_free(&ft->flow_slab, expired_flows[i]);
 		}
-	
-		free(expired_flows);
 	}
 
 	return (r == -1 ? -1 : num_expired);
@@ -1031,8 +1113,9 @@ check_expired(struct FLOWTRACK *ft, struct NETFLOW_TARGET *target, int ex, u_int
 static void
 force_expire(struct FLOWTRACK *ft, u_int32_t num_to_expire)
 {
-	struct EXPIRY *expiry, **expiryv;
-	int i;
+	struct pm_timer *head, *t;
+	struct FLOW *flow;
+	u_int32_t i, slot;
 
 	/* XXX move all overflow processing here (maybe) */
 	if (verbose_flag)
@@ -1040,50 +1123,31 @@ force_expire(struct FLOWTRACK *ft, u_int32_t num_to_expire)
 		    config.name, config.type, num_to_expire);
 
 	/*
-	 * Do this in two steps, as it is dangerous to change a key on 
-	 * a tree entry without first removing it and then re-adding it.
-	 * It is even worse when this has to be done during a FOREACH :)
-	 * To get around this, we make a list of expired flows and _then_ 
-	 * alter them 
+	 * Walk the wheel from the next tick onwards so that flows closest
+	 * to their timeout are the first to go; flows farther than the
+	 * wheel horizon all sit in the last slot.
 	 */
-	 
-	if ((expiryv = malloc(sizeof(*expiryv) * num_to_expire)) == NULL) {
-		/*
-		 * On malloc failure, expire ALL flows. I assume that 
-		 * setting all the keys in a tree to the same value is 
-		 * safe.
-		 */
-		Log(LOG_ERR, "ERROR ( %s/%s ): Out of memory while expiring flows\n", config.name, config.type);
-		EXPIRY_FOREACH(expiry, EXPIRIES, &ft->expiries) {
-			expiry->expires_at = 0;
-			expiry->reason = R_OVERFLOWS;
+	for (i = 0, slot = ft->expiries.clock + 1;
+	    i < ft->expiries.mask && num_to_expire > 0; i++, slot++) {
+		head = &ft->expiries.slots[slot & ft->expiries.mask];
+
+		while (head->next != head && num_to_expire > 0) {
+			t = head->next;
+			pm_timer_del(&ft->expiries, t);
+
+			flow = flow_from_timer(t);
+			flow->expiry.expires_at = 0;
+			flow->expiry.reason = R_OVERFLOWS;
+			flow_expire_now(ft, flow);
+
 			ft->flows_force_expired++;
+			num_to_expire--;
 		}
-		return;
-	}
-	
-	/* Make the list of flows to expire */
-	i = 0;
-	EXPIRY_FOREACH(expiry, EXPIRIES, &ft->expiries) {
-		if (i >= num_to_expire)
-			break;
-		expiryv[i++] = expiry;
-	}
-	if (i < num_to_expire) {
-		Log(LOG_ERR, "ERROR ( %s/%s ): Needed to expire %d flows, but only %d active.\n",
-				config.name, config.type, num_to_expire, i);
-		num_to_expire = i;
 	}
 
-	for(i = 0; i < num_to_expire; i++) {
-		EXPIRY_REMOVE(EXPIRIES, &ft->expiries, expiryv[i]);
-		expiryv[i]->expires_at = 0;
-		expiryv[i]->reason = R_OVERFLOWS;
-		EXPIRY_INSERT(EXPIRIES, &ft->expiries, expiryv[i]);
-	}
-	ft->flows_force_expired += num_to_expire;
-	free(expiryv);
-	/* XXX - this is overcomplicated, perhaps use a separate queue */
+	if (num_to_expire > 0)
+		Log(LOG_ERR, "ERROR ( %s/%s ): Needed to expire %u more flows, but none active.\n",
+				config.name, config.type, num_to_expire);
 }
 
 /* Delete all flows that we know about without processing */
@@ -1091,22 +1155,28 @@ static int
 delete_all_flows(struct FLOWTRACK *ft)
 {
 	struct FLOW *flow, *nflow;
+	u_int32_t bucket;
 	int i;
 	
 	i = 0;
-	for(flow = FLOW_MIN(FLOWS, &ft->flows); flow != NULL; flow = nflow) {
-		nflow = FLOW_NEXT(FLOWS, &ft->flows, flow);
-		FLOW_REMOVE(FLOWS, &ft->flows, flow);
-		
-		EXPIRY_REMOVE(EXPIRIES, &ft->expiries, flow->expiry);
-		free(flow->expiry);
+	for (bucket = 0; bucket <= ft->flows_mask; bucket++) {
+		for (flow = ft->flows[bucket]; flow != NULL; flow = nflow) {
+			nflow = flow->hnext;
+			flow_unlink(ft, flow);
+
+			if (flow->expiry.expires_at != 0)
+				pm_timer_del(&ft->expiries, &flow->expiry.tmr);
 
-		ft->num_flows--;
+			ft->num_flows--;
 
-		free_flow_allocs(flow);
-		free(flow);
-		i++;
+			free_flow_allocs(flow);
+			pm_slab_free(&ft->flow_slab, flow);
+			i++;
+		}
 	}
+
+	ft->expire_now = NULL;
+	ft->expire_now_tail = &ft->expire_now;
 	
 	return (i);
 }
@@ -1232,8 +1302,7 @@ init_flowtrack(struct FLOWTRACK *ft)
 	/* Set up flow-tracking structure */
 	memset(ft, '\0', sizeof(*ft));
 	ft->next_flow_seq = 1;
-	FLOW_INIT(&ft->flows);
-	EXPIRY_INIT(&ft->expiries);
+	ft->expire_now_tail = &ft->expire_now;
 	
 	ft->tcp_timeout = DEFAULT_TCP_TIMEOUT;
 	ft->tcp_rst_timeout = DEFAULT_TCP_RST_TIMEOUT;
@@ -1245,6 +1314,24 @@ init_flowtrack(struct FLOWTRACK *ft)
 	ft->expiry_interval = DEFAULT_EXPIRY_INTERVAL;
 }
 
+/* Size the flow hash table after the maximum number of active flows */
+static void
+alloc_flowtrack(struct FLOWTRACK *ft, int max_flows)
+{
+	u_int32_t buckets = MIN_FLOW_BUCKETS;
+
+	while (buckets < (u_int32_t) max_flows) buckets <<= 1;
+
+	if ((ft->flows = calloc(buckets, sizeof(struct FLOW *))) == NULL) {
+		Log(LOG_ERR, "ERROR ( %s/%s ): Unable to allocate flow hash table. Exiting.\n", config.name, config.type);
+		exit_plugin(1);
+	}
+	ft->flows_mask = buckets - 1;
+
+	pm_slab_init(&ft->flow_slab, sizeof(struct FLOW));
+	pm_timer_wheel_init(&ft->expiries, TW_DEFAULT_SLOTS, time(NULL));
+}
+
 static void
 set_timeout(struct FLOWTRACK *ft, const char *to_spec)
 {
@@ -1399,6 +1486,7 @@ void nfprobe_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   u_int32_t bufsz = ((struct channels_list_entry *)ptr)->bufsize;
   pid_t core_pid = ((struct channels_list_entry *)ptr)->core_pid;
   struct networks_file_data nfd;
+  struct timespec stats_ts;
 
   unsigned char *rgptr, *dataptr;
   int pollagain = TRUE;
@@ -1471,6 +1559,12 @@ void nfprobe_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 
   if (!config.nfprobe_maxflows) max_flows = DEFAULT_MAX_FLOWS;
   else max_flows = config.nfprobe_maxflows;
+  alloc_flowtrack(&flowtrack, max_flows);
+
+  if (pm_sendq_init(&nf_sendq, ERR, NULL, 0, SENDQ_DEFAULT_BATCH, 0) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): Unable to allocate export send queue. Exiting.\n", config.name, config.type);
+    exit_plugin(1);
+  }
 
   if (config.debug) verbose_flag = TRUE;
   if (config.pcap_savefile) capfile = config.pcap_savefile;
@@ -1654,8 +1748,10 @@ read_data:
         for (num = 0; primptrs_funcs[num]; num++)
           (*primptrs_funcs[num])((u_char *)data, &extras, &prim_ptrs);
 
+        if (net_funcs[0]) STATS_START(stats_ts);
         for (num = 0; net_funcs[num]; num++)
 	  (*net_funcs[num])(&nt, &nc, &data->primitives, &dummy_pbgp, &nfd);
+        if (net_funcs[0]) STATS_STOP(STATS_NET, stats_ts);
 
 	/* hacky: bgp next-hop */
         if (config.nfacctd_net & NF_NET_NEW && dummy_pbgp.peer_dst_ip.family) {
@@ -1726,5 +1822,9 @@ expiry_check:
 		
 exit_lane:
   if (!graceful_shutdown_request) Log(LOG_ERR, "ERROR ( %s/%s ): Exiting immediately on internal error.\n", config.name, config.type);
+  if (dest.ss_family != 0)
+    Log(LOG_INFO, "INFO ( %s/%s ): Exported to [%s]:%s: datagrams=%llu bytes=%llu errors=%llu\n", config.name, config.type,
+	dest_addr, dest_serv, (unsigned long long)nf_sendq.datagrams, (unsigned long long)nf_sendq.bytes,
+	(unsigned long long)nf_sendq.errors);
   if (target.fd != -1) close(target.fd);
 }
@@ -68,6 +68,9 @@
  */
 #define DEFAULT_MAX_FLOWS	8192
 
+/* Flow hash table is sized to the next power of 2 of max flows */
+#define MIN_FLOW_BUCKETS	1024
+
 /* Return values from process_packet */
 #define PP_OK           0
 #define PP_BAD_PACKET   -2
@@ -80,13 +83,19 @@ struct STATISTIC {
 
 /*
  * This structure is the root of the flow tracking system.
- * It holds the root of the tree of active flows and the head of the
- * tree of expiry events. It also collects miscellaneous statistics
+ * It holds the hash table of active flows, the timer wheel of expiry
+ * events and the queue of flows scheduled for immediate disposal. It
+ * also collects miscellaneous statistics
  */
 struct FLOWTRACK {
 	/* The flows and their expiry events */
-	FLOW_HEAD(FLOWS, FLOW) flows;		/* Top of flow tree */
-	EXPIRY_HEAD(EXPIRIES, EXPIRY) expiries;	/* Top of expiries tree */
+	struct FLOW **flows;			/* Flow hash buckets */
+	u_int32_t flows_mask;			/* # of buckets - 1 */
+	struct pm_slab flow_slab;		/* struct FLOW allocator */
+	struct pm_timer_wheel expiries;		/* Timed expiry events */
+	struct FLOW *expire_now;		/* Flows to expire immediately */
+	struct FLOW **expire_now_tail;
+	u_int32_t next_expiry_check;		/* time_t of next wheel scan */
 
 	unsigned int num_flows;			/* # of active flows */
 	u_int64_t next_flow_seq;		/* Next flow ID */
@@ -139,7 +148,29 @@ struct FLOWTRACK {
 };
 
 /*
- * This structure is an entry in the tree of flows that we are 
+ * This is the expiry event of a flow. Flows with a timed expiry are
+ * filed in the timer wheel of the flow tracking system by "expires_at";
+ * flows scheduled for immediate disposal (expires_at zero) are instead
+ * queued to the expire_now list.
+ *
+ * When a flow which hasn't been scheduled for immediate expiry registers 
+ * traffic, its timer is re-armed subject to its updated timeout.
+ *
+ * Expiry scans operate by advancing the wheel and expiring each entry
+ * with expires_at < now
+ */
+struct EXPIRY {
+	struct pm_timer tmr;			/* Timer wheel linkage */
+
+	u_int32_t expires_at;			/* time_t */
+	enum { 
+		R_GENERAL, R_TCP, R_TCP_RST, R_TCP_FIN, R_UDP, R_ICMP, 
+		R_MAXLIFE, R_OVERBYTES, R_OVERFLOWS, R_FLUSH
+	} reason;
+};
+
+/*
+ * This structure is an entry in the hash table of flows that we are 
  * currently tracking. 
  *
  * Because flows are matched _bi-directionally_, they must be stored in
@@ -148,8 +179,10 @@ struct FLOWTRACK {
  */
 struct FLOW {
 	/* Housekeeping */
-	struct EXPIRY *expiry;			/* Pointer to expiry record */
-	FLOW_ENTRY(FLOW) trp;			/* Tree pointer */
+	struct EXPIRY expiry;			/* Expiry record */
+	struct FLOW *hnext, *hprev;		/* Hash chain */
+	struct FLOW *expire_next;		/* expire_now queue */
+	u_int32_t hash;				/* Hash of flow identity */
 
 	/* Flow identity (all are in network byte order) */
 	int af;					/* Address family of flow */
@@ -206,34 +239,12 @@ struct FLOW {
 	struct pkt_vlen_hdr_primitives *pvlen[2]; 	/* space for vlen primitives */
 };
 
-/*
- * This is an entry in the tree of expiry events. The tree is used to 
- * avoid traversion the whole tree of active flows looking for ones to
- * expire. "expires_at" is the time at which the flow should be discarded,
- * or zero if it is scheduled for immediate disposal. 
- *
- * When a flow which hasn't been scheduled for immediate expiry registers 
- * traffic, it is deleted from its current position in the tree and 
- * re-inserted (subject to its updated timeout).
- *
- * Expiry scans operate by starting at the head of the tree and expiring
- * each entry with expires_at < now
- * 
- */
-struct EXPIRY {
-	EXPIRY_ENTRY(EXPIRY) trp;		/* Tree pointer */
-	struct FLOW *flow;			/* pointer to flow */
-
-	u_int32_t expires_at;			/* time_t */
-	enum { 
-		R_GENERAL, R_TCP, R_TCP_RST, R_TCP_FIN, R_UDP, R_ICMP, 
-		R_MAXLIFE, R_OVERBYTES, R_OVERFLOWS, R_FLUSH
-	} reason;
-};
-
 /* Prototype for functions shared from softflowd.c */
 u_int32_t timeval_sub_ms(const struct timeval *t1, const struct timeval *t2);
 
+/* Export datagrams are queued here and sent out in batches */
+extern struct pm_sendq nf_sendq;
+
 /* Prototypes for functions to send NetFlow packets, from netflow*.c */
 int send_netflow_v1(struct FLOW **flows, int num_flows, int nfsock,
     u_int64_t *flows_exported, struct timeval *system_boot_time, 
@@ -33,6 +33,7 @@
 #include "ip_flow.h"
 #include "net_aggr.h"
 #include "thread_pool.h"
+#include "tpacket.h"
 #include "isis/isis.h"
 #include "bgp/bgp.h"
 #include "bmp/bmp.h"
@@ -46,10 +47,12 @@ void pcap_cb(u_char *user, const struct pcap_pkthdr *pkthdr, const u_char *buf)
   struct pcap_callback_data *cb_data = (struct pcap_callback_data *) user;
   struct pcap_device *device = cb_data->device;
   struct plugin_requests req;
+  struct timespec stats_ts;
 
   /* We process the packet with the appropriate
      data link layer function */
   if (buf) {
+    STATS_START(stats_ts);
     memset(&pptrs, 0, sizeof(pptrs));
 
     pptrs.pkthdr = (struct pcap_pkthdr *) pkthdr;
@@ -73,6 +76,11 @@ void pcap_cb(u_char *user, const struct pcap_pkthdr *pkthdr, const u_char *buf)
 	}
 #endif
 
+#if defined (HAVE_TPACKET_V3)
+        /* capture threads: maps and plugin channels are shared, single-producer */
+        if (cb_data->serialize) pthread_mutex_lock(&tpacket_exec_mutex);
+#endif
+
         if (config.nfacctd_isis) {
           isis_srcdst_lookup(&pptrs);
         }
@@ -90,11 +98,30 @@ void pcap_cb(u_char *user, const struct pcap_pkthdr *pkthdr, const u_char *buf)
 
 	set_index_pkt_ptrs(&pptrs);
         exec_plugins(&pptrs, &req);
+        commit_expired_pipe_buffers();
+
+#if defined (HAVE_TPACKET_V3)
+        if (cb_data->serialize) pthread_mutex_unlock(&tpacket_exec_mutex);
+#endif
       }
     }
+
+    STATS_STOP(STATS_DECODE, stats_ts);
   }
 
   if (reload_map) {
+#if defined (HAVE_TPACKET_V3)
+    if (cb_data->serialize) {
+      pthread_mutex_lock(&tpacket_exec_mutex);
+
+      /* another capture thread got here first */
+      if (!reload_map) {
+        pthread_mutex_unlock(&tpacket_exec_mutex);
+        return;
+      }
+    }
+#endif
+
     bta_map_caching = FALSE;
     sampling_map_caching = FALSE;
 
@@ -111,6 +138,10 @@ void pcap_cb(u_char *user, const struct pcap_pkthdr *pkthdr, const u_char *buf)
 
     reload_map = FALSE;
     gettimeofday(&reload_map_tstamp, NULL);
+
+#if defined (HAVE_TPACKET_V3)
+    if (cb_data->serialize) pthread_mutex_unlock(&tpacket_exec_mutex);
+#endif
   }
 }
 
@@ -596,6 +627,8 @@ ssize_t recvfrom_savefile(struct pcap_device *device, void **buf, struct sockadd
     }
   }
   else if (pcap_ret == -2 /* last packet in a pcap_savefile */) {
+    if (config.stats_file) stats_dump();
+
     if (config.sf_wait) {
       fill_pipe_buffer();
       Log(LOG_INFO, "INFO ( %s/core ): finished reading PCAP capture file\n", config.name);
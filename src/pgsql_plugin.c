@@ -29,6 +29,11 @@
 #include "pgsql_plugin.h"
 #include "sql_common_m.c"
 
+/* variables */
+static char PG_stmt_errmsg[SRVBUFLEN];
+static char PG_batch_tail[LONGSRVBUFLEN];
+static int PG_batch_failed;
+
 /* Functions */
 void pgsql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr) 
 {
@@ -46,6 +51,7 @@ void pgsql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   u_int32_t bufsz = ((struct channels_list_entry *)ptr)->bufsize;
   pid_t core_pid = ((struct channels_list_entry *)ptr)->core_pid;
   struct networks_file_data nfd;
+  struct timespec stats_ts;
   char *dataptr;
 
   unsigned char *rgptr;
@@ -104,6 +110,8 @@ void pgsql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   /* building up static SQL clauses */
   idata.num_primitives = PG_compose_static_queries();
   glob_num_primitives = idata.num_primitives; 
+  if (config.sql_upsert) sql_upsert_init(SQL_UPSERT_PGSQL);
+  if (config.sql_prepared_statements) sql_bind_init(idata.num_primitives, SQL_BIND_STYLE_DOLLAR);
 
   /* setting up environment variables */
   SQL_SetENV();
@@ -233,8 +241,10 @@ void pgsql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
         for (num = 0; primptrs_funcs[num]; num++)
           (*primptrs_funcs[num])((u_char *)data, &extras, &prim_ptrs);
 
+	if (net_funcs[0]) STATS_START(stats_ts);
 	for (num = 0; net_funcs[num]; num++)
 	  (*net_funcs[num])(&nt, &nc, &data->primitives, prim_ptrs.pbgp, &nfd);
+	if (net_funcs[0]) STATS_STOP(STATS_NET, stats_ts);
 
 	if (config.ports_file) {
           if (!pt.table[data->primitives.src_port]) data->primitives.src_port = 0;
@@ -246,7 +256,9 @@ void pgsql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
           evaluate_pkt_len_distrib(data);
 
         prim_ptrs.data = data;
+        STATS_START(stats_ts);
         (*insert_func)(&prim_ptrs, &idata);
+        STATS_STOP(STATS_INSERT, stats_ts);
 
         ((struct ch_buf_hdr *)pipebuf)->num--;
         if (((struct ch_buf_hdr *)pipebuf)->num) {
@@ -321,12 +333,84 @@ int PG_cache_dbop_copy(struct DBdesc *db, struct db_cache *cache_elem, struct in
   return FALSE;
 }
 
+/*
+   Upsert with sql_multi_values: rows are accumulated into a multi-row
+   INSERT, the conflict clause is appended once when the buffer is sent.
+   A failed batch makes the whole purge to be reprocessed, see
+   PG_batch_end().
+*/
+static int PG_batch_flush(struct DBdesc *db, struct insert_data *idata)
+{
+  PGresult *ret;
+  int err = FALSE;
+
+  strcpy(multi_values_buffer+idata->mv.buffer_offset, PG_batch_tail);
+
+  ret = PQexec(db->desc, multi_values_buffer);
+  if (PQresultStatus(ret) != PGRES_COMMAND_OK) {
+    strlcpy(PG_stmt_errmsg, PQresultErrorMessage(ret), sizeof(PG_stmt_errmsg));
+    db->errmsg = PG_stmt_errmsg;
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED query follows:\n%s\n", config.name, config.type, multi_values_buffer);
+    if (db->errmsg) Log(LOG_ERR, "ERROR ( %s/%s ): %s\n\n", config.name, config.type, db->errmsg);
+    PG_batch_failed = TRUE;
+    sql_db_fail(db);
+    err = TRUE;
+  }
+  else {
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d VALUES statements sent to the PostgreSQL server.\n",
+		config.name, config.type, idata->mv.buffer_elem_num);
+    idata->iqn++;
+  }
+  PQclear(ret);
+
+  idata->mv.buffer_elem_num = 0;
+  idata->mv.buffer_offset = 0;
+
+  return err;
+}
+
+static int PG_batch_add(struct DBdesc *db, struct insert_data *idata, char *head, char *values, char *tail)
+{
+  int head_len = strlen(head), row_len = strlen(values+7), tail_len = strlen(tail);
+
+  if (idata->mv.buffer_elem_num) {
+    if (strncmp(multi_values_buffer, head, head_len) || strcmp(PG_batch_tail, tail) ||
+	(idata->mv.buffer_offset + 1 + row_len + tail_len) >= config.sql_multi_values) {
+      if (PG_batch_flush(db, idata)) return TRUE;
+    }
+  }
+
+  if (!idata->mv.buffer_elem_num) {
+    if ((head_len + row_len + tail_len + 8) >= config.sql_multi_values || tail_len >= sizeof(PG_batch_tail)) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): 'sql_multi_values' is too small (%d). Try with a larger value.\n",
+		config.name, config.type, config.sql_multi_values);
+      exit_plugin(1);
+    }
+
+    idata->mv.buffer_offset = snprintf(multi_values_buffer, config.sql_multi_values, "%s VALUES", head);
+    strlcpy(PG_batch_tail, tail, sizeof(PG_batch_tail));
+  }
+  else multi_values_buffer[idata->mv.buffer_offset++] = ',';
+
+  strcpy(multi_values_buffer+idata->mv.buffer_offset, values+7); /* cut the initial ' VALUES' */
+  idata->mv.buffer_offset += row_len;
+  idata->mv.buffer_elem_num++;
+
+  return FALSE;
+}
+
 int PG_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata)
 {
   PGresult *ret;
-  char *ptr_values, *ptr_where, *ptr_set, *ptr_insert;
+  char *ptr_values, *ptr_where, *ptr_set, *ptr_insert, *tail = NULL;
   int num=0, num_set=0, have_flows=0;
 
+  if (idata->mv.last_queue_elem) {
+    if (!idata->mv.buffer_elem_num) return FALSE;
+
+    return PG_batch_flush(db, idata);
+  }
+
   if (config.what_to_count & COUNT_FLOWS) have_flows = TRUE;
 
   /* constructing SQL query */
@@ -353,7 +437,7 @@ int PG_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
 
   /* sending UPDATE query a) if not switched off and
      b) if we actually have something to update */
-  if (!config.sql_dont_try_update && num_set) {
+  if (!config.sql_dont_try_update && !config.sql_upsert && num_set) {
     strncpy(sql_data, update_clause, SPACELEFT(sql_data));
     strncat(sql_data, set_clause, SPACELEFT(sql_data));
     strncat(sql_data, where_clause, SPACELEFT(sql_data));
@@ -371,7 +455,7 @@ int PG_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
     PQclear(ret);
   }
 
-  if (config.sql_dont_try_update || !num_set || (!PG_affected_rows(ret))) {
+  if (config.sql_dont_try_update || config.sql_upsert || !num_set || (!PG_affected_rows(ret))) {
     /* UPDATE failed, trying with an INSERT query */ 
     if (cache_elem->flow_type == NF9_FTYPE_EVENT || cache_elem->flow_type == NF9_FTYPE_OPTION) {
       strncpy(insert_full_clause, insert_clause, SPACELEFT(insert_full_clause));
@@ -389,8 +473,19 @@ int PG_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
       else snprintf(ptr_values, SPACELEFT(values_clause), ", %lu, %lu)", cache_elem->packet_counter, cache_elem->bytes_counter);
 #endif
     }
+    if (config.sql_upsert) tail = sql_upsert_clause(idata, (cache_elem->flow_type == NF9_FTYPE_EVENT ||
+			cache_elem->flow_type == NF9_FTYPE_OPTION));
+
+    if (config.sql_upsert && config.sql_multi_values) {
+      if (PG_batch_add(db, idata, insert_full_clause, values_clause, tail)) return TRUE;
+      idata->een++;
+
+      return FALSE;
+    }
+
     strncpy(sql_data, insert_full_clause, sizeof(sql_data));
     strncat(sql_data, values_clause, SPACELEFT(sql_data));
+    if (tail) strncat(sql_data, tail, SPACELEFT(sql_data));
 
     ret = PQexec(db->desc, sql_data);
     if (PQresultStatus(ret) != PGRES_COMMAND_OK) {
@@ -413,12 +508,227 @@ int PG_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
   return FALSE;
 }
 
+/*
+   Prepared statements. Statements are named after their slot and are
+   prepared server-side once per writer; when sql_dont_try_update or
+   sql_upsert are set nothing depends on the outcome of the single INSERT,
+   so these are sent
+   in a pipeline and results are collected every PG_PIPELINE_DEPTH rows
+   and, last, before the COMMIT.
+*/
+static char *PG_stmt_names[SQL_STMT_MAX] = { "pmacct_update", "pmacct_insert", "pmacct_insert_batch" };
+static int PG_pipeline_queued;
+
+static int PG_stmt_prepare(struct DBdesc *db, int slot, struct sql_bind_query *q)
+{
+  struct sql_stmt *stmt = &db->stmt[slot];
+  char dealloc[SRVBUFLEN];
+  PGresult *ret;
+
+  if (!sql_stmt_changed(stmt, q->text)) return FALSE;
+
+  if (stmt->handle) {
+    snprintf(dealloc, sizeof(dealloc), "DEALLOCATE %s", PG_stmt_names[slot]);
+    ret = PQexec(db->desc, dealloc);
+    PQclear(ret);
+    sql_stmt_set(stmt, NULL, NULL);
+  }
+
+  ret = PQprepare(db->desc, PG_stmt_names[slot], q->text, 0, NULL);
+  if (PQresultStatus(ret) != PGRES_COMMAND_OK) {
+    strlcpy(PG_stmt_errmsg, PQresultErrorMessage(ret), sizeof(PG_stmt_errmsg));
+    db->errmsg = PG_stmt_errmsg;
+    PQclear(ret);
+
+    return TRUE;
+  }
+  PQclear(ret);
+
+  sql_stmt_set(stmt, PG_stmt_names[slot], q->text);
+
+  return FALSE;
+}
+
+#if defined LIBPQ_HAS_PIPELINING
+static int PG_pipeline_drain(struct DBdesc *db)
+{
+  PGresult *ret;
+  int status, err = FALSE;
+
+  if (!PQpipelineSync(db->desc)) {
+    strlcpy(PG_stmt_errmsg, PQerrorMessage(db->desc), sizeof(PG_stmt_errmsg));
+    db->errmsg = PG_stmt_errmsg;
+    return TRUE;
+  }
+
+  for (;;) {
+    ret = PQgetResult(db->desc);
+    if (!ret) {
+      if (PQstatus(db->desc) == CONNECTION_BAD) {
+	strlcpy(PG_stmt_errmsg, PQerrorMessage(db->desc), sizeof(PG_stmt_errmsg));
+	db->errmsg = PG_stmt_errmsg;
+	err = TRUE;
+	break;
+      }
+      continue;
+    }
+
+    status = PQresultStatus(ret);
+    if (status == PGRES_PIPELINE_SYNC) {
+      PQclear(ret);
+      break;
+    }
+
+    if (status != PGRES_COMMAND_OK && !err) {
+      strlcpy(PG_stmt_errmsg, PQresultErrorMessage(ret), sizeof(PG_stmt_errmsg));
+      db->errmsg = PG_stmt_errmsg;
+      err = TRUE;
+    }
+    PQclear(ret);
+  }
+
+  PG_pipeline_queued = 0;
+
+  return err;
+}
+
+static int PG_pipeline_send(struct DBdesc *db, int slot, struct sql_bind_query *q)
+{
+  struct sql_stmt *stmt = &db->stmt[slot];
+  char dealloc[SRVBUFLEN];
+
+  if (PQpipelineStatus(db->desc) == PQ_PIPELINE_OFF) {
+    if (!PQenterPipelineMode(db->desc)) goto signal_error;
+    PG_pipeline_queued = 0;
+  }
+
+  if (sql_stmt_changed(stmt, q->text)) {
+    if (stmt->handle) {
+      snprintf(dealloc, sizeof(dealloc), "DEALLOCATE %s", PG_stmt_names[slot]);
+      if (!PQsendQueryParams(db->desc, dealloc, 0, NULL, NULL, NULL, NULL, 0)) goto signal_error;
+      sql_stmt_set(stmt, NULL, NULL);
+      PG_pipeline_queued++;
+    }
+
+    if (!PQsendPrepare(db->desc, PG_stmt_names[slot], q->text, 0, NULL)) goto signal_error;
+    sql_stmt_set(stmt, PG_stmt_names[slot], q->text);
+    PG_pipeline_queued++;
+  }
+
+  if (!PQsendQueryPrepared(db->desc, PG_stmt_names[slot], q->nparams, (const char * const *) q->params, NULL, NULL, 0))
+    goto signal_error;
+  PG_pipeline_queued++;
+
+  if (PG_pipeline_queued >= PG_PIPELINE_DEPTH) return PG_pipeline_drain(db);
+
+  return FALSE;
+
+  signal_error:
+  strlcpy(PG_stmt_errmsg, PQerrorMessage(db->desc), sizeof(PG_stmt_errmsg));
+  db->errmsg = PG_stmt_errmsg;
+
+  return TRUE;
+}
+#endif
+
+/* Collects outstanding pipelined results ahead of the COMMIT; TRUE if any of
+   the rows sent along the purge, pipelined or batched, failed */
+static int PG_batch_end(struct DBdesc *db)
+{
+  int err = PG_batch_failed;
+
+#if defined LIBPQ_HAS_PIPELINING
+  if (db->desc && PQpipelineStatus(db->desc) != PQ_PIPELINE_OFF) {
+    if (PG_pipeline_drain(db)) err = TRUE;
+    PQexitPipelineMode(db->desc);
+  }
+#endif
+
+  PG_batch_failed = FALSE;
+
+  return err;
+}
+
+int PG_cache_dbop_bind(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata)
+{
+  static struct sql_bind_query upd, ins;
+  PGresult *ret = NULL;
+  int num_set, affected = 0;
+
+  num_set = sql_bind_compose(cache_elem, idata, &upd, &ins);
+  if (config.sql_upsert) strlcat(ins.text, sql_upsert_clause(idata, (cache_elem->flow_type == NF9_FTYPE_EVENT ||
+			cache_elem->flow_type == NF9_FTYPE_OPTION)), sizeof(ins.text));
+
+#if defined LIBPQ_HAS_PIPELINING
+  if (config.sql_dont_try_update || config.sql_upsert) {
+    if (PG_pipeline_send(db, SQL_STMT_INSERT, &ins)) {
+      PG_batch_failed = TRUE;
+      goto signal_error;
+    }
+    idata->iqn++;
+    idata->een++;
+
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): %s\n\n", config.name, config.type, ins.text);
+
+    return FALSE;
+  }
+#endif
+
+  if (!config.sql_dont_try_update && !config.sql_upsert && num_set) {
+    if (PG_stmt_prepare(db, SQL_STMT_UPDATE, &upd)) goto signal_error;
+
+    ret = PQexecPrepared(db->desc, PG_stmt_names[SQL_STMT_UPDATE], upd.nparams, (const char * const *) upd.params, NULL, NULL, 0);
+    if (PQresultStatus(ret) != PGRES_COMMAND_OK) {
+      strlcpy(PG_stmt_errmsg, PQresultErrorMessage(ret), sizeof(PG_stmt_errmsg));
+      db->errmsg = PG_stmt_errmsg;
+      PQclear(ret);
+      goto signal_error;
+    }
+    affected = PG_affected_rows(ret);
+    PQclear(ret);
+  }
+
+  if (config.sql_dont_try_update || config.sql_upsert || !num_set || !affected) {
+    if (PG_stmt_prepare(db, SQL_STMT_INSERT, &ins)) goto signal_error;
+
+    ret = PQexecPrepared(db->desc, PG_stmt_names[SQL_STMT_INSERT], ins.nparams, (const char * const *) ins.params, NULL, NULL, 0);
+    if (PQresultStatus(ret) != PGRES_COMMAND_OK) {
+      strlcpy(PG_stmt_errmsg, PQresultErrorMessage(ret), sizeof(PG_stmt_errmsg));
+      db->errmsg = PG_stmt_errmsg;
+      PQclear(ret);
+      goto signal_error;
+    }
+    PQclear(ret);
+    idata->iqn++;
+
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): %s\n\n", config.name, config.type, ins.text);
+  }
+  else {
+    idata->uqn++;
+
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): %s\n\n", config.name, config.type, upd.text);
+  }
+  idata->een++;
+
+  return FALSE;
+
+  signal_error:
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED prepared statement follows:\n%s\n", config.name, config.type,
+	(config.sql_dont_try_update || config.sql_upsert || !num_set || !affected) ? ins.text : upd.text);
+  if (db->errmsg) Log(LOG_ERR, "ERROR ( %s/%s ): %s\n\n", config.name, config.type, db->errmsg);
+  sql_db_fail(db);
+
+  return TRUE;
+}
+
 void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *idata)
 {
+  struct db_cache *LastElemCommitted = NULL;
   PGresult *ret;
   struct db_cache **reprocess_queries_queue, **bulk_reprocess_queries_queue;
   char orig_insert_clause[LONGSRVBUFLEN], orig_update_clause[LONGSRVBUFLEN], orig_lock_clause[LONGSRVBUFLEN];
   char orig_copy_clause[LONGSRVBUFLEN], tmpbuf[LONGLONGSRVBUFLEN], tmptable[SRVBUFLEN];
+  struct timeval start_tv;
   time_t start;
   int j, r, reprocess = 0, stop, go_to_pending, reprocess_idx, bulk_reprocess_idx, saved_index = index;
   struct primitives_ptrs prim_ptrs;
@@ -451,6 +761,7 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
 
   Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - START (PID: %u) ***\n", config.name, config.type, writer_pid);
   start = time(NULL);
+  gettimeofday(&start_tv, NULL);
 
   /* re-using pending queries queue stuff from parent and saving clauses */
   memcpy(pending_queries_queue, queue, index*sizeof(struct db_cache *));
@@ -462,6 +773,7 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
   strlcpy(orig_lock_clause, lock_clause, LONGSRVBUFLEN);
 
   start:
+  memset(&idata->mv, 0, sizeof(struct multi_values));
   memcpy(queue, pending_queries_queue, pqq_ptr*sizeof(struct db_cache *));
   memset(pending_queries_queue, 0, pqq_ptr*sizeof(struct db_cache *));
   index = pqq_ptr; pqq_ptr = 0;
@@ -539,6 +851,7 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
 	/* note down all elements in case of a reprocess due to COMMIT failure */
 	bulk_reprocess_queries_queue[bulk_reprocess_idx] = queue[j];
 	bulk_reprocess_idx++;
+	LastElemCommitted = queue[j];
       }
       else r = FALSE; /* not valid elements are marked as not to be reprocessed */ 
       if (r) {
@@ -551,7 +864,20 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
     }
   }
 
+  /* multi-value INSERT query: wrap-up */
+  if (idata->mv.buffer_elem_num && LastElemCommitted) {
+    idata->mv.last_queue_elem = TRUE;
+    sql_query(&bed, LastElemCommitted, idata);
+    idata->qn--; /* increased by sql_query() one time too much */
+    idata->mv.last_queue_elem = FALSE;
+  }
+
   /* Finalizing DB transaction */
+  if (PG_batch_end(&p)) {
+    if (!reprocess) sql_db_fail(&p);
+    reprocess = REPROCESS_BULK;
+  }
+
   if (!p.fail) {
     if (config.sql_use_copy) {
       if (PQputCopyEnd(p.desc, NULL) < 0) Log(LOG_ERR, "ERROR ( %s/%s ): COPY failed!\n\n", config.name, config.type); 
@@ -579,6 +905,11 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
     }
   }
 
+  if (b.connected) {
+    if (idata->mv.buffer_elem_num) PG_batch_flush(&b, idata);
+    if (PG_batch_end(&b)) sql_db_fail(&b);
+  }
+
   if (b.connected) {
     if (config.sql_use_copy) {
       if (PQputCopyEnd(b.desc, NULL) < 0) Log(LOG_ERR, "ERROR ( %s/%s ): COPY failed!\n\n", config.name, config.type);
@@ -592,8 +923,9 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
   if (pqq_ptr) goto start;
 
   idata->elap_time = time(NULL)-start;
-  Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %u) ***\n",
-		config.name, config.type, writer_pid, idata->qn, saved_index, idata->elap_time);
+  Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %u, RPS: %u) ***\n",
+		config.name, config.type, writer_pid, idata->qn, saved_index, idata->elap_time,
+		sql_purge_rate(idata, &start_tv));
 
   if (config.sql_trigger_exec) {
     if (queue && queue[0]) idata->basetime = queue[0]->basetime;
@@ -842,6 +1174,13 @@ void PG_DB_Connect(struct DBdesc *db, char *host)
 
 void PG_DB_Close(struct BE_descs *bed)
 {
+  int idx;
+
+  for (idx = 0; idx < SQL_STMT_MAX; idx++) {
+    sql_stmt_set(&bed->p->stmt[idx], NULL, NULL);
+    sql_stmt_set(&bed->b->stmt[idx], NULL, NULL);
+  }
+
   if (bed->p->connected) PQfinish(bed->p->desc);
   if (bed->b->connected) PQfinish(bed->b->desc);
 }
@@ -885,8 +1224,9 @@ void PG_set_callbacks(struct sqlfunc_cb_registry *cbr)
   cbr->close = PG_DB_Close;
   cbr->lock = PG_Lock;
   /* cbr->unlock */ 
-  if (!config.sql_use_copy) cbr->op = PG_cache_dbop;
-  else cbr->op = PG_cache_dbop_copy;
+  if (config.sql_use_copy) cbr->op = PG_cache_dbop_copy;
+  else if (config.sql_prepared_statements) cbr->op = PG_cache_dbop_bind;
+  else cbr->op = PG_cache_dbop;
   cbr->create_table = PG_create_dyn_table;
   cbr->purge = PG_cache_purge;
   cbr->create_backend = PG_create_backend;
@@ -970,7 +1310,29 @@ void PG_init_default_values(struct insert_data *idata)
   glob_dyn_table_time_only = idata->dyn_table_time_only;
 
   if (config.sql_backup_host) idata->recover = TRUE;
+
+  if (config.sql_upsert && config.sql_dont_try_update) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_upsert is incompatible with sql_dont_try_update. Ignored.\n", config.name, config.type);
+    config.sql_upsert = FALSE;
+  }
   if (!config.sql_dont_try_update && config.sql_use_copy) config.sql_use_copy = FALSE; 
+  if (config.sql_use_copy && config.sql_prepared_statements) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_prepared_statements does not apply along with sql_use_copy. Ignored.\n", config.name, config.type);
+    config.sql_prepared_statements = FALSE;
+  }
+
+  /* multi-values are only used to batch upserts; prepared statements are pipelined instead */
+  if (!config.sql_upsert || config.sql_prepared_statements) config.sql_multi_values = FALSE;
+
+  if (config.sql_multi_values) {
+    multi_values_buffer = malloc(config.sql_multi_values);
+    if (!multi_values_buffer) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): Unable to get enough room (%d) for multi value queries.\n",
+		config.name, config.type, config.sql_multi_values);
+      config.sql_multi_values = FALSE;
+    }
+    else memset(multi_values_buffer, 0, config.sql_multi_values);
+  }
 
   if (config.sql_locking_style) idata->locks = sql_select_locking_style(config.sql_locking_style);
 }
@@ -25,11 +25,13 @@
 /* defines */
 #define REPROCESS_SPECIFIC	1
 #define REPROCESS_BULK		2
+#define PG_PIPELINE_DEPTH	512
 
 /* prototypes */
 void pgsql_plugin(int, struct configuration *, void *);
 int PG_cache_dbop(struct DBdesc *, struct db_cache *, struct insert_data *);
 int PG_cache_dbop_copy(struct DBdesc *, struct db_cache *, struct insert_data *);
+int PG_cache_dbop_bind(struct DBdesc *, struct db_cache *, struct insert_data *);
 void PG_cache_purge(struct db_cache *[], int, struct insert_data *);
 int PG_evaluate_history(int);
 int PG_compose_static_queries();
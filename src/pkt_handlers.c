@@ -840,7 +840,16 @@ void evaluate_packet_handlers()
 
     if (channels_list[index].aggregation_2 & COUNT_LABEL) {
       if (channels_list[index].plugin->cfg.pre_tag_map) {
-        channels_list[index].phandler[primitives] = pre_tag_label_handler;
+	struct configuration *cfg = &channels_list[index].plugin->cfg;
+
+	/* plugins forked off this core can resolve interned labels; the memory
+	   plugin (pmacct client), probes, tee and remote plugins need strings */
+	if ((cfg->type_id == PLUGIN_ID_PRINT || cfg->type_id == PLUGIN_ID_MYSQL || cfg->type_id == PLUGIN_ID_PGSQL ||
+	     cfg->type_id == PLUGIN_ID_SQLITE3 || cfg->type_id == PLUGIN_ID_MONGODB || cfg->type_id == PLUGIN_ID_AMQP ||
+	     cfg->type_id == PLUGIN_ID_KAFKA) && !cfg->pipe_zmq_export)
+          channels_list[index].phandler[primitives] = pre_tag_label_id_handler;
+	else
+          channels_list[index].phandler[primitives] = pre_tag_label_handler;
         primitives++;
       }
 
@@ -2768,6 +2777,13 @@ void pre_tag_label_handler(struct channels_list_entry *chptr, struct packet_ptrs
   else vlen_prims_insert(pvlen, COUNT_INT_LABEL, pptrs->label.len, pptrs->label.val, PM_MSG_STR_COPY);
 }
 
+void pre_tag_label_id_handler(struct channels_list_entry *chptr, struct packet_ptrs *pptrs, char **data)
+{
+  struct pkt_data *pdata = (struct pkt_data *) *data;
+
+  pdata->primitives.label_id = pptrs->label.id;
+}
+
 void NF_flows_handler(struct channels_list_entry *chptr, struct packet_ptrs *pptrs, char **data)
 {
   struct pkt_data *pdata = (struct pkt_data *) *data;
@@ -308,7 +308,7 @@ avro_value_t compose_avro(u_int64_t wtc, u_int64_t wtc_2, u_int8_t flow_type, st
   }
 
   if (wtc_2 & COUNT_LABEL) {
-    vlen_prims_get(pvlen, COUNT_INT_LABEL, &str_ptr);
+    str_ptr = pretag_label_get(pbase, pvlen);
     if (!str_ptr) str_ptr = empty_string;
 
     check_i(avro_value_get_by_name(&value, "label", &field, NULL));
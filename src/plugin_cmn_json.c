@@ -432,7 +432,7 @@ void compose_json_label(json_t *obj, struct chained_cache *cc)
 {
   char empty_string[] = "", *str_ptr;
 
-  vlen_prims_get(cc->pvlen, COUNT_INT_LABEL, &str_ptr);
+  str_ptr = pretag_label_get(&cc->primitives, cc->pvlen);
   if (!str_ptr) str_ptr = empty_string;
 
   json_object_set_new_nocheck(obj, "label", json_string(str_ptr));
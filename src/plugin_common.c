@@ -89,10 +89,10 @@ void P_init_default_values()
 	config.print_cache_entries, ((config.print_cache_entries * dbc_size) + (2 * ((sa.num +
 	config.print_cache_entries) * sizeof(struct chained_cache *))) + sa.size));
 
-  cache = (struct chained_cache *) pm_malloc(config.print_cache_entries*dbc_size);
+  cache = (struct chained_cache *) pm_malloc_hugepages(config.print_cache_entries*dbc_size, config.hugepages, "cache");
   queries_queue = (struct chained_cache **) pm_malloc((sa.num+config.print_cache_entries)*sizeof(struct chained_cache *));
   pending_queries_queue = (struct chained_cache **) pm_malloc((sa.num+config.print_cache_entries)*sizeof(struct chained_cache *));
-  sa.base = (unsigned char *) pm_malloc(sa.size);
+  sa.base = (unsigned char *) pm_malloc_hugepages(sa.size, config.hugepages, "cache arena");
   sa.ptr = sa.base;
   sa.next = NULL;
 
@@ -611,6 +611,7 @@ void P_cache_insert_pending(struct chained_cache *queue[], int index, struct cha
 
 void P_cache_handle_flush_event(struct ports_table *pt)
 {
+  struct timespec stats_ts;
   pid_t ret;
 
   if (qq_ptr) P_cache_mark_flush(queries_queue, qq_ptr, FALSE);
@@ -620,7 +621,11 @@ void P_cache_handle_flush_event(struct ports_table *pt)
     switch (ret = fork()) {
     case 0: /* Child */
       pm_setproctitle("%s %s [%s]", config.type, "Plugin -- Writer", config.name);
+      stats_reset("writer");
+      STATS_START(stats_ts);
       (*purge_func)(queries_queue, qq_ptr, FALSE);
+      STATS_STOP_N(STATS_PURGE, stats_ts, qq_ptr);
+      if (config.stats_file) stats_dump();
       exit(0);
     default: /* Parent */
       if (ret == -1) Log(LOG_WARNING, "WARN ( %s/%s ): Unable to fork writer: %s\n", config.name, config.type, strerror(errno));
@@ -777,6 +782,7 @@ void P_sum_mac_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *ida
 
 void P_exit_now(int signum)
 {
+  if (config.stats_file) stats_dump();
   if (qq_ptr) P_cache_mark_flush(queries_queue, qq_ptr, TRUE);
 
   dump_writers_count();
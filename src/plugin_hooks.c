@@ -28,6 +28,7 @@
 #include "plugin_hooks.h"
 #include "plugin_common.h"
 #include "pkt_handlers.h"
+#include "jhash.h"
 
 /* functions */
 
@@ -50,6 +51,15 @@ void load_plugins(struct plugin_requests *req)
   init_random_seed(); 
   init_pipe_channels();
 
+  /* labels table has to be mapped before plugins are forked off */
+  for (list = plugins_list; list; list = list->next) {
+    if (list->cfg.pre_tag_map) {
+      if (pretag_label_table_init()) exit(1);
+      break;
+    }
+  }
+  list = plugins_list;
+
   while (list) {
     if ((*list->type.func)) {
       if (list->cfg.data_type & (PIPE_TYPE_METADATA|PIPE_TYPE_PAYLOAD|PIPE_TYPE_MSG));
@@ -96,6 +106,21 @@ void load_plugins(struct plugin_requests *req)
 	}
       }
 
+      if ((list->cfg.pipe_zmq_export || list->cfg.pipe_zmq_import) && !list->cfg.pipe_zmq_secret) {
+	Log(LOG_ERR, "ERROR ( %s/%s ): 'plugin_pipe_zmq_export' and 'plugin_pipe_zmq_import' require 'plugin_pipe_zmq_secret'.\n", list->name, list->type.string);
+	exit_all(1);
+      }
+
+      if ((list->cfg.pipe_zmq_export || list->cfg.pipe_zmq_import) && !list->cfg.pipe_zmq) {
+	Log(LOG_ERR, "ERROR ( %s/%s ): 'plugin_pipe_zmq_export' and 'plugin_pipe_zmq_import' require 'plugin_pipe_zmq'.\n", list->name, list->type.string);
+	exit_all(1);
+      }
+
+      if (list->cfg.shard_num && !(list->cfg.data_type & PIPE_TYPE_METADATA)) {
+	Log(LOG_WARNING, "WARN ( %s/%s ): 'plugin_shard' not supported by this plugin. Ignored.\n", list->name, list->type.string);
+	list->cfg.shard_num = 0;
+      }
+
       /* some validations */
       if (list->cfg.pipe_size < min_sz) list->cfg.pipe_size = min_sz;
       if (list->cfg.buffer_size < min_sz) list->cfg.buffer_size = min_sz;
@@ -245,7 +270,33 @@ void load_plugins(struct plugin_requests *req)
 #ifdef WITH_ZMQ
       if (list->cfg.pipe_zmq) {
 	p_zmq_plugin_pipe_init_core(&chptr->zmq_host, list->id);
-	p_zmq_plugin_pipe_publish(&chptr->zmq_host);
+	chptr->zmq_host.ipc = list->cfg.pipe_zmq_ipc;
+
+	if (list->cfg.pipe_zmq_compress) {
+#if defined (HAVE_ZLIB)
+	  chptr->zmq_host.compress = TRUE;
+#else
+	  Log(LOG_WARNING, "WARN ( %s/%s ): 'plugin_pipe_zmq_compress' requires zlib. Disabled.\n", list->name, list->type.string);
+#endif
+	}
+
+	if (list->cfg.pipe_zmq_zerocopy)
+	  p_zmq_plugin_pipe_set_zerocopy(&chptr->zmq_host, chptr->rg.base, chptr->bufsize,
+					 ((chptr->rg.end - chptr->rg.base) / chptr->bufsize));
+
+	if (list->cfg.pipe_zmq_export || list->cfg.pipe_zmq_import)
+	  p_zmq_set_secret(&chptr->zmq_host, list->cfg.pipe_zmq_secret);
+
+	/* buffers come from remote Core Processes: this channel is not fed */
+	if (list->cfg.pipe_zmq_import) {
+	  chptr->zmq_host.remote = list->cfg.pipe_zmq_import;
+	  chptr->zmq_host.import = TRUE;
+	  list->cfg.pipe_check_core_pid = FALSE;
+	}
+	else {
+	  chptr->zmq_host.remote = list->cfg.pipe_zmq_export;
+	  p_zmq_plugin_pipe_publish(&chptr->zmq_host);
+	}
       }
 #endif
       
@@ -270,6 +321,8 @@ void load_plugins(struct plugin_requests *req)
 	close(config.sock);
 	close(config.bgp_sock);
 	if (!list->cfg.pipe_zmq) close(list->pipe[1]);
+	pm_set_placement(list->cfg.cpu_affinity, list->cfg.numa_bind, list->name, list->type.string);
+	if (list->cfg.pipe_zmq_export) plugin_pipe_zmq_export_idle(list);
 	(*list->type.func)(list->pipe[0], &list->cfg, chptr);
 	exit(0);
       default: /* Parent */
@@ -340,13 +393,16 @@ void exec_plugins(struct packet_ptrs *pptrs, struct plugin_requests *req)
   pm_id_t saved_tag = 0, saved_tag2 = 0;
   pt_label_t saved_label;
 
-  int num, ret, fixed_size;
+  int num, fixed_size;
   u_int32_t savedptr;
   char *bptr;
   int index, got_tags = FALSE;
+  struct timespec stats_ts;
 
   pretag_init_label(&saved_label);
 
+  STATS_RECORDS(STATS_DECODE, 1);
+
 #if defined WITH_GEOIPV2
   if (reload_geoipv2_file && config.geoipv2_file) {
     pm_geoipv2_close();
@@ -361,6 +417,8 @@ void exec_plugins(struct packet_ptrs *pptrs, struct plugin_requests *req)
 
     channels_list[index].already_reprocessed = FALSE;
 
+    if (p->cfg.pipe_zmq_import) continue;
+
     if (p->cfg.pre_tag_map && find_id_func) {
       if (p->cfg.type_id == PLUGIN_ID_TEE) {
 	if ((req->ptm_c.exec_ptm_res && !p->cfg.ptm_complex) ||
@@ -371,19 +429,21 @@ void exec_plugins(struct packet_ptrs *pptrs, struct plugin_requests *req)
       if (p->cfg.ptm_global && got_tags) {
         pptrs->tag = saved_tag;
         pptrs->tag2 = saved_tag2;
-	pretag_copy_label(&pptrs->label, &saved_label);
+	pptrs->label = saved_label;
 
         pptrs->have_tag = saved_have_tag;
         pptrs->have_tag2 = saved_have_tag2;
         pptrs->have_label = saved_have_label;
       }
       else {
+        STATS_START(stats_ts);
         find_id_func(&p->cfg.ptm, pptrs, &pptrs->tag, &pptrs->tag2);
+        STATS_STOP(STATS_PRE_TAG, stats_ts);
 
 	if (p->cfg.ptm_global) {
 	  saved_tag = pptrs->tag;
 	  saved_tag2 = pptrs->tag2;
-	  pretag_copy_label(&saved_label, &pptrs->label);
+	  saved_label = pptrs->label;
 
 	  saved_have_tag = pptrs->have_tag;
 	  saved_have_tag2 = pptrs->have_tag2;
@@ -417,7 +477,8 @@ reprocess:
         num++;
       }
 
-      if (channels_list[index].s.rate && !channels_list[index].s.sampled_pkts) {
+      if ((channels_list[index].s.rate && !channels_list[index].s.sampled_pkts) ||
+	  (p->cfg.shard_num && plugin_shard_get(&channels_list[index], (channels_list[index].rg.ptr+ChBufHdrSz+savedptr)) != p->cfg.shard_id)) {
 	channels_list[index].reprocess = FALSE;
 	channels_list[index].bufptr = savedptr;
 	channels_list[index].hdr.num--; /* let's cheat this value as it will get increased later */
@@ -442,71 +503,27 @@ reprocess:
       else {
         channels_list[index].hdr.num++;
         channels_list[index].bufptr += (fixed_size + channels_list[index].var_size);
+        if (!channels_list[index].buffer_first && channels_list[index].hdr.num)
+	  channels_list[index].buffer_first = pipe_buffer_msecs();
       }
 
       if (((channels_list[index].bufptr + fixed_size) > channels_list[index].bufend) ||
 	  (channels_list[index].hdr.num == INT_MAX) || channels_list[index].buffer_immediate) {
-	channels_list[index].hdr.seq++;
-	channels_list[index].hdr.seq %= MAX_SEQNUM;
-
-	/* let's commit the buffer we just finished writing */
-	((struct ch_buf_hdr *)channels_list[index].rg.ptr)->len = channels_list[index].bufptr;
-	((struct ch_buf_hdr *)channels_list[index].rg.ptr)->seq = channels_list[index].hdr.seq;
-	((struct ch_buf_hdr *)channels_list[index].rg.ptr)->num = channels_list[index].hdr.num;
-	((struct ch_buf_hdr *)channels_list[index].rg.ptr)->core_pid = channels_list[index].core_pid;
-
-	channels_list[index].status->last_buf_off = (u_int64_t)(channels_list[index].rg.ptr - channels_list[index].rg.base);
-
-        if (config.debug_internal_msg) {
-	  struct plugins_list_entry *list = channels_list[index].plugin;
-	  Log(LOG_DEBUG, "DEBUG ( %s/%s ): buffer released cpid=%u len=%llu seq=%u num_entries=%u off=%llu\n",
-		list->name, list->type.string, channels_list[index].core_pid, channels_list[index].bufptr,
-		channels_list[index].hdr.seq, channels_list[index].hdr.num, channels_list[index].status->last_buf_off);
-	}
-
-	/* sending buffer to connected ZMQ subscriber(s) */
-	if (channels_list[index].plugin->cfg.pipe_zmq) {
-#ifdef WITH_ZMQ
-          struct channels_list_entry *chptr = &channels_list[index];
-
-	  ret = p_zmq_plugin_pipe_send(&chptr->zmq_host, chptr->rg.ptr, chptr->bufsize);
-#endif
-	}
-	else {
-	  if (channels_list[index].status->wakeup) {
-	    channels_list[index].status->wakeup = channels_list[index].request;
-	    if (write(channels_list[index].pipe, &channels_list[index].rg.ptr, CharPtrSz) != CharPtrSz) {
-	      struct plugins_list_entry *list = channels_list[index].plugin;
-	      Log(LOG_WARNING, "WARN ( %s/%s ): Failed during write: %s\n", list->name, list->type.string, strerror(errno));
-	    }
-	  }
-	}
-
-	channels_list[index].rg.ptr += channels_list[index].bufsize;
-
-	if ((channels_list[index].rg.ptr+channels_list[index].bufsize) > channels_list[index].rg.end)
-	  channels_list[index].rg.ptr = channels_list[index].rg.base;
-
-	/* let's protect the buffer we are going to write */
-        ((struct ch_buf_hdr *)channels_list[index].rg.ptr)->seq = -1;
-        ((struct ch_buf_hdr *)channels_list[index].rg.ptr)->num = 0;
-        ((struct ch_buf_hdr *)channels_list[index].rg.ptr)->core_pid = 0;
-
-        /* rewind pointer */
-        channels_list[index].bufptr = channels_list[index].buf;
-        channels_list[index].hdr.num = 0;
+	commit_pipe_buffer(&channels_list[index]);
 
 	if (channels_list[index].reprocess) goto reprocess;
 
 	/* if reading from a savefile, let's sleep a bit after
-	   having sent over a buffer worth of data */
-	if (channels_list[index].plugin->cfg.pcap_savefile) usleep(1000); /* 1 msec */ 
+	   having sent over a buffer worth of data, unless told
+	   to replay at full speed, ie. benchmarking */
+	if (channels_list[index].plugin->cfg.pcap_savefile && channels_list[index].plugin->cfg.pcap_savefile_pace == TRUE)
+	  usleep(1000); /* 1 msec */ 
       }
     }
 
     pptrs->tag = 0;
     pptrs->tag2 = 0;
-    pretag_free_label(&pptrs->label);
+    pretag_init_label(&pptrs->label);
   }
 
   /* check if we have to reload the map: new loop is to
@@ -537,12 +554,146 @@ reprocess:
 
   /* cleanups */
   reload_map_exec_plugins = FALSE;
-  pretag_free_label(&saved_label);
+}
+
+u_int64_t pipe_buffer_msecs()
+{
+  struct timespec ts;
+
+  stats_now(&ts);
+
+  return (((u_int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000));
+}
+
+/* commit_pipe_buffer(): hands the buffer being written over to the plugin
+   and moves on to the next slot of the ring */
+void commit_pipe_buffer(struct channels_list_entry *chptr)
+{
+  struct timespec stats_ts;
+  u_int64_t now;
+
+  chptr->hdr.seq++;
+  chptr->hdr.seq %= MAX_SEQNUM;
+  STATS_START(stats_ts);
+
+  /* let's commit the buffer we just finished writing */
+  ((struct ch_buf_hdr *)chptr->rg.ptr)->len = chptr->bufptr;
+  ((struct ch_buf_hdr *)chptr->rg.ptr)->seq = chptr->hdr.seq;
+  ((struct ch_buf_hdr *)chptr->rg.ptr)->num = chptr->hdr.num;
+  ((struct ch_buf_hdr *)chptr->rg.ptr)->core_pid = chptr->core_pid;
+
+  chptr->status->last_buf_off = (u_int64_t)(chptr->rg.ptr - chptr->rg.base);
+
+  /* fill ratio and age of committed buffers, see pipe_buffer_stats_log() */
+  chptr->bstats.commits++;
+  chptr->bstats.fill += chptr->bufptr;
+  if (chptr->buffer_first) {
+    now = pipe_buffer_msecs();
+    chptr->bstats.latency += (now - chptr->buffer_first);
+    if ((now - chptr->buffer_first) > chptr->bstats.latency_max) chptr->bstats.latency_max = (now - chptr->buffer_first);
+    chptr->buffer_first = 0;
+  }
+
+  if (config.debug_internal_msg) {
+    struct plugins_list_entry *list = chptr->plugin;
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): buffer released cpid=%u len=%llu seq=%u num_entries=%u off=%llu\n",
+	list->name, list->type.string, chptr->core_pid, chptr->bufptr,
+	chptr->hdr.seq, chptr->hdr.num, chptr->status->last_buf_off);
+  }
+
+  /* sending buffer to connected ZMQ subscriber(s) */
+  if (chptr->plugin->cfg.pipe_zmq) {
+#ifdef WITH_ZMQ
+    /* only the committed part of the buffer is sent */
+    p_zmq_plugin_pipe_send(&chptr->zmq_host, chptr->rg.ptr, (ChBufHdrSz + chptr->bufptr));
+#endif
+  }
+  else {
+    if (chptr->status->wakeup) {
+      chptr->status->wakeup = chptr->request;
+      if (write(chptr->pipe, &chptr->rg.ptr, CharPtrSz) != CharPtrSz) {
+	struct plugins_list_entry *list = chptr->plugin;
+	Log(LOG_WARNING, "WARN ( %s/%s ): Failed during write: %s\n", list->name, list->type.string, strerror(errno));
+      }
+    }
+  }
+
+  chptr->rg.ptr += chptr->bufsize;
+
+  if ((chptr->rg.ptr+chptr->bufsize) > chptr->rg.end)
+    chptr->rg.ptr = chptr->rg.base;
+
+#ifdef WITH_ZMQ
+  if (chptr->plugin->cfg.pipe_zmq)
+    p_zmq_plugin_pipe_wait(&chptr->zmq_host, chptr->rg.ptr);
+#endif
+
+  /* let's protect the buffer we are going to write */
+  ((struct ch_buf_hdr *)chptr->rg.ptr)->seq = -1;
+  ((struct ch_buf_hdr *)chptr->rg.ptr)->num = 0;
+  ((struct ch_buf_hdr *)chptr->rg.ptr)->core_pid = 0;
+
+  /* rewind pointer */
+  chptr->bufptr = chptr->buf;
+  chptr->hdr.num = 0;
+  STATS_STOP_N(STATS_RING, stats_ts, chptr->hdr.num);
+}
+
+/* commit_expired_pipe_buffers(): commits non-empty buffers held for longer
+   than plugin_buffer_latency; meant to be called on the receive path and
+   on receive timeouts, it's a no-op unless the feature is enabled */
+void commit_expired_pipe_buffers()
+{
+  struct channels_list_entry *chptr;
+  u_int64_t now;
+  int index;
+
+  if (!pipe_buffer_latency) return;
+
+  now = pipe_buffer_msecs();
+  if (now < pipe_buffer_next_check) return;
+  pipe_buffer_next_check = (now + pipe_buffer_latency);
+
+  for (index = 0; channels_list[index].aggregation || channels_list[index].aggregation_2; index++) {
+    chptr = &channels_list[index];
+
+    if (!chptr->buffer_latency || !chptr->hdr.num || !chptr->buffer_first) continue;
+
+    if ((now - chptr->buffer_first) >= chptr->buffer_latency) {
+      chptr->bstats.expired++;
+      commit_pipe_buffer(chptr);
+    }
+    else if ((chptr->buffer_first + chptr->buffer_latency) < pipe_buffer_next_check)
+      pipe_buffer_next_check = (chptr->buffer_first + chptr->buffer_latency);
+  }
+}
+
+/* pipe_buffer_stats_log(): helps sizing plugin_buffer_size; logged upon SIGUSR1 */
+void pipe_buffer_stats_log()
+{
+  struct channels_list_entry *chptr;
+  struct plugins_list_entry *list;
+  int index;
+
+  for (index = 0; channels_list[index].aggregation || channels_list[index].aggregation_2; index++) {
+    chptr = &channels_list[index];
+    list = chptr->plugin;
+
+    if (!chptr->bstats.commits) continue;
+
+    Log(LOG_NOTICE, "NOTICE ( %s/%s ): buffers committed=%llu on_latency=%llu avg_fill=%.1f%% avg_age=%llu ms max_age=%llu ms\n",
+	list->name, list->type.string, (unsigned long long) chptr->bstats.commits,
+	(unsigned long long) chptr->bstats.expired,
+	(chptr->bufend ? ((double) chptr->bstats.fill * 100 / ((double) chptr->bstats.commits * chptr->bufend)) : 0),
+	(unsigned long long) (chptr->bstats.latency / chptr->bstats.commits),
+	(unsigned long long) chptr->bstats.latency_max);
+  }
 }
 
 struct channels_list_entry *insert_pipe_channel(int plugin_type, struct configuration *cfg, int pipe)
 {
   struct channels_list_entry *chptr; 
+  char what[SRVBUFLEN];
   int index = 0, x;  
 
   while (index < MAX_N_PLUGINS) {
@@ -555,6 +706,11 @@ struct channels_list_entry *insert_pipe_channel(int plugin_type, struct configur
       chptr->agg_filter.num = (int *) &cfg->bpfp_a_num; 
       chptr->bufsize = cfg->buffer_size;
       chptr->buffer_immediate = cfg->buffer_immediate;
+      if (!cfg->buffer_immediate && cfg->buffer_latency) {
+	chptr->buffer_latency = cfg->buffer_latency;
+	if (!pipe_buffer_latency || chptr->buffer_latency < pipe_buffer_latency)
+	  pipe_buffer_latency = chptr->buffer_latency;
+      }
       chptr->core_pid = getpid();
       chptr->tag = cfg->post_tag;
       chptr->tag2 = cfg->post_tag2;
@@ -575,7 +731,8 @@ struct channels_list_entry *insert_pipe_channel(int plugin_type, struct configur
       /* +PKT_MSG_SIZE has been introduced as a margin as a
          countermeasure against the reception of malicious NetFlow v9
 	 templates */
-      chptr->rg.base = map_shared(0, cfg->pipe_size+PKT_MSG_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+      snprintf(what, sizeof(what), "pipe buffer of plugin %s/%s", cfg->name, cfg->type);
+      chptr->rg.base = map_hugepages(cfg->pipe_size+PKT_MSG_SIZE, &chptr->rg.mlen, cfg->hugepages, MAP_SHARED, what);
       if (chptr->rg.base == MAP_FAILED) {
         Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate pipe buffer. Exiting ...\n", cfg->name, cfg->type); 
 	exit_all(1);
@@ -761,7 +918,7 @@ void recollect_pipe_memory(struct channels_list_entry *mychptr)
   while (index < MAX_N_PLUGINS) {
     chptr = &channels_list[index];
     if (mychptr->rg.base != chptr->rg.base) {
-      munmap(chptr->rg.base, (chptr->rg.end-chptr->rg.base)+PKT_MSG_SIZE);
+      munmap(chptr->rg.base, chptr->rg.mlen);
       munmap(chptr->status, sizeof(struct ch_status));
     }
     index++;
@@ -784,16 +941,19 @@ void fill_pipe_buffer()
   for (index = 0; channels_list[index].aggregation || channels_list[index].aggregation_2; index++) {
     chptr = &channels_list[index];
 
+    if (chptr->plugin->cfg.pipe_zmq_import) continue;
+
     chptr->hdr.seq++;
     chptr->hdr.seq %= MAX_SEQNUM;
 
+    ((struct ch_buf_hdr *)chptr->rg.ptr)->len = chptr->bufptr;
     ((struct ch_buf_hdr *)chptr->rg.ptr)->seq = chptr->hdr.seq;
     ((struct ch_buf_hdr *)chptr->rg.ptr)->num = chptr->hdr.num;
     ((struct ch_buf_hdr *)chptr->rg.ptr)->core_pid = chptr->core_pid;
 
     if (chptr->plugin->cfg.pipe_zmq) {
 #ifdef WITH_ZMQ
-      p_zmq_plugin_pipe_send(&chptr->zmq_host, chptr->rg.ptr, chptr->bufsize);
+      p_zmq_plugin_pipe_send(&chptr->zmq_host, chptr->rg.ptr, (ChBufHdrSz + chptr->bufptr));
 #endif
     }
     else {
@@ -926,6 +1086,32 @@ void plugin_pipe_zmq_compile_check()
 #endif
 }
 
+/*
+  Entries with the same primitives go to the same shard, so that partial
+  aggregates can be merged downstream as in a local cache. Counters and
+  variable-length primitives are not part of the hash.
+*/
+int plugin_shard_get(struct channels_list_entry *chptr, char *entry)
+{
+  struct pkt_data *pdata = (struct pkt_data *) entry;
+
+  return (jhash(&pdata->primitives, sizeof(struct pkt_primitives), 0) % chptr->plugin->cfg.shard_num);
+}
+
+/* buffers of an exported plugin are consumed by a remote one: idle here */
+void plugin_pipe_zmq_export_idle(struct plugins_list_entry *list)
+{
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGHUP, SIG_IGN);
+  signal(SIGUSR1, SIG_IGN);
+  signal(SIGUSR2, SIG_IGN);
+
+  Log(LOG_INFO, "INFO ( %s/%s ): buffers exported to %s\n", list->name, list->type.string, list->cfg.pipe_zmq_export);
+
+  while (TRUE) pause();
+}
+
 void plugin_pipe_check(struct configuration *cfg)
 {
   if (!cfg->pipe_zmq) cfg->pipe_homegrown = TRUE;
@@ -40,6 +40,7 @@ struct ring {
   char *base;
   char *ptr;
   char *end;
+  size_t mlen;		/* mapped length, may be rounded up to hugepage size */
 };
 
 struct ch_buf_hdr {
@@ -87,6 +88,15 @@ struct plugins_list_entry {
 #include "zmq_common.h"
 #endif
 
+/* committed buffers, to help sizing plugin_buffer_size */
+struct pipe_buffer_stats {
+  u_int64_t commits;
+  u_int64_t expired;					/* committed because of plugin_buffer_latency */
+  u_int64_t fill;					/* bytes */
+  u_int64_t latency;					/* age of the first record at commit, msecs */
+  u_int64_t latency_max;
+};
+
 struct channels_list_entry {
   pm_cfgreg_t aggregation;
   pm_cfgreg_t aggregation_2;
@@ -104,6 +114,9 @@ struct channels_list_entry {
   u_int64_t bufsize;		
   int var_size;
   int buffer_immediate;
+  u_int32_t buffer_latency;				/* max msecs a non-empty buffer is held before commit */
+  u_int64_t buffer_first;				/* msecs timestamp of the first record in the buffer */
+  struct pipe_buffer_stats bstats;
   int same_aggregate;
   pkt_handler phandler[N_PRIMITIVES];
   int pipe;
@@ -155,6 +168,16 @@ EXT pm_counter_t take_simple_random_skip(pm_counter_t);
 EXT pm_counter_t take_simple_systematic_skip(pm_counter_t);
 EXT void plugin_pipe_zmq_compile_check();
 EXT void plugin_pipe_check(struct configuration *);
+EXT int plugin_shard_get(struct channels_list_entry *, char *);
+EXT void plugin_pipe_zmq_export_idle(struct plugins_list_entry *);
+EXT u_int64_t pipe_buffer_msecs();
+EXT void commit_pipe_buffer(struct channels_list_entry *);
+EXT void commit_expired_pipe_buffers();
+EXT void pipe_buffer_stats_log();
+
+/* global variables */
+EXT u_int32_t pipe_buffer_latency;			/* lowest plugin_buffer_latency across plugins, msecs */
+EXT u_int64_t pipe_buffer_next_check;			/* next time buffers may need a commit, msecs */
 #undef EXT
 
 #if (defined __PLUGIN_HOOKS_C)
@@ -323,8 +323,13 @@ static const struct _dictionary_line dictionary[] = {
   {"pcap_protocol", cfg_key_pcap_protocol},
   {"pcap_savefile", cfg_key_pcap_savefile},
   {"pcap_savefile_wait", cfg_key_pcap_savefile_wait},
+  {"pcap_savefile_pace", cfg_key_pcap_savefile_pace},
+  {"stats_file", cfg_key_stats_file},
+  {"stats_refresh_time", cfg_key_stats_refresh_time},
   {"core_proc_name", cfg_key_proc_name},
   {"proc_priority", cfg_key_proc_priority},
+  {"cpu_affinity", cfg_key_cpu_affinity},
+  {"numa_bind", cfg_key_numa_bind},
   {"pmacctd_as", cfg_key_nfacctd_as_new},
   {"uacctd_as", cfg_key_nfacctd_as_new},
   {"pmacctd_net", cfg_key_nfacctd_net},
@@ -333,11 +338,20 @@ static const struct _dictionary_line dictionary[] = {
   {"thread_stack", cfg_key_thread_stack},
   {"plugins", NULL},
   {"plugin_pipe_size", cfg_key_plugin_pipe_size},
+  {"plugin_hugepages", cfg_key_plugin_hugepages},
   {"plugin_buffer_size", cfg_key_plugin_buffer_size},
+  {"plugin_buffer_latency", cfg_key_plugin_buffer_latency},
   {"plugin_pipe_check_core_pid", cfg_key_plugin_pipe_check_core_pid},
   {"plugin_pipe_zmq", cfg_key_plugin_pipe_zmq},
   {"plugin_pipe_zmq_retry", cfg_key_plugin_pipe_zmq_retry},
   {"plugin_pipe_zmq_profile", cfg_key_plugin_pipe_zmq_profile},
+  {"plugin_pipe_zmq_ipc", cfg_key_plugin_pipe_zmq_ipc},
+  {"plugin_pipe_zmq_zerocopy", cfg_key_plugin_pipe_zmq_zerocopy},
+  {"plugin_pipe_zmq_compress", cfg_key_plugin_pipe_zmq_compress},
+  {"plugin_pipe_zmq_export", cfg_key_plugin_pipe_zmq_export},
+  {"plugin_pipe_zmq_import", cfg_key_plugin_pipe_zmq_import},
+  {"plugin_pipe_zmq_secret", cfg_key_plugin_pipe_zmq_secret},
+  {"plugin_shard", cfg_key_plugin_shard},
   {"interface", cfg_key_interface},
   {"interface_wait", cfg_key_interface_wait},
   {"files_umask", cfg_key_files_umask},
@@ -358,6 +372,7 @@ static const struct _dictionary_line dictionary[] = {
   {"imt_buckets", cfg_key_imt_buckets},
   {"imt_mem_pools_number", cfg_key_imt_mem_pools_number},
   {"imt_mem_pools_size", cfg_key_imt_mem_pools_size},
+  {"imt_snapshot_refresh_time", cfg_key_imt_snapshot_refresh_time},
   {"sql_db", cfg_key_sql_db},
   {"sql_table", cfg_key_sql_table},
   {"sql_table_schema", cfg_key_sql_table_schema},
@@ -387,6 +402,8 @@ static const struct _dictionary_line dictionary[] = {
   {"sql_multi_values", cfg_key_sql_multi_values},
   {"sql_locking_style", cfg_key_sql_locking_style},
   {"sql_use_copy", cfg_key_sql_use_copy},
+  {"sql_prepared_statements", cfg_key_sql_prepared_statements},
+  {"sql_upsert", cfg_key_sql_upsert},
   {"sql_num_protos", cfg_key_num_protos},
   {"sql_num_hosts", cfg_key_num_hosts},
   {"print_refresh_time", cfg_key_sql_refresh_time},
@@ -395,6 +412,8 @@ static const struct _dictionary_line dictionary[] = {
   {"print_output", cfg_key_print_output},
   {"print_output_file", cfg_key_print_output_file},
   {"print_output_file_append", cfg_key_print_output_file_append},
+  {"print_output_threads", cfg_key_print_output_threads},
+  {"print_output_threads_unordered", cfg_key_print_output_threads_unordered},
   {"print_output_lock_file", cfg_key_print_output_lock_file},
   {"print_output_separator", cfg_key_print_output_separator},
   {"print_latest_file", cfg_key_print_latest_file},
@@ -506,6 +525,10 @@ static const struct _dictionary_line dictionary[] = {
   {"pmacctd_conntrack_buffer_size", cfg_key_pmacctd_conntrack_buffer_size},
   {"pmacctd_flow_lifetime", cfg_key_pmacctd_flow_lifetime},
   {"pmacctd_flow_tcp_lifetime", cfg_key_pmacctd_flow_tcp_lifetime},
+  {"pmacctd_capture_threads", cfg_key_pmacctd_capture_threads},
+  {"pmacctd_fanout_mode", cfg_key_pmacctd_fanout_mode},
+  {"pmacctd_ring_block_size", cfg_key_pmacctd_ring_block_size},
+  {"pmacctd_ring_blocks", cfg_key_pmacctd_ring_blocks},
   {"pmacctd_ext_sampling_rate", cfg_key_pmacctd_ext_sampling_rate},
   {"pmacctd_pipe_size", cfg_key_nfacctd_pipe_size},
   {"pmacctd_stitching", cfg_key_nfacctd_stitching},
@@ -530,6 +553,9 @@ static const struct _dictionary_line dictionary[] = {
   {"telemetry_daemon_decoder", cfg_key_telemetry_decoder},
   {"telemetry_daemon_max_peers", cfg_key_telemetry_max_peers},
   {"telemetry_daemon_udp_timeout", cfg_key_telemetry_udp_timeout},
+  {"telemetry_daemon_validate_json", cfg_key_telemetry_validate_json},
+  {"telemetry_daemon_gpb_kv_decode", cfg_key_telemetry_gpb_kv_decode},
+  {"telemetry_daemon_gpb_kv_filter_file", cfg_key_telemetry_gpb_kv_filter_file},
   {"telemetry_daemon_allow_file", cfg_key_telemetry_allow_file},
   {"telemetry_daemon_pipe_size", cfg_key_telemetry_pipe_size},
   {"telemetry_daemon_ipprec", cfg_key_telemetry_ip_precedence},
@@ -602,12 +628,14 @@ static const struct _dictionary_line dictionary[] = {
   {"sfacctd_time_new", cfg_key_nfacctd_time_new},
   {"sfacctd_pipe_size", cfg_key_nfacctd_pipe_size},
   {"sfacctd_renormalize", cfg_key_sfacctd_renormalize},
+  {"sfacctd_full_decode", cfg_key_sfacctd_full_decode},
   {"sfacctd_disable_checks", cfg_key_nfacctd_disable_checks},
   {"sfacctd_mcast_groups", cfg_key_nfacctd_mcast_groups},
   {"sfacctd_stitching", cfg_key_nfacctd_stitching},
   {"sfacctd_ext_sampling_rate", cfg_key_pmacctd_ext_sampling_rate},
   {"sfacctd_counter_output", cfg_key_sfacctd_counter_output},
   {"sfacctd_counter_file", cfg_key_sfacctd_counter_file},
+  {"sfacctd_counter_refresh_time", cfg_key_sfacctd_counter_refresh_time},
   {"sfacctd_counter_amqp_host", cfg_key_sfacctd_counter_amqp_host},
   {"sfacctd_counter_amqp_vhost", cfg_key_sfacctd_counter_amqp_vhost},
   {"sfacctd_counter_amqp_user", cfg_key_sfacctd_counter_amqp_user},
@@ -666,6 +694,7 @@ static const struct _dictionary_line dictionary[] = {
   {"tee_max_receiver_pools", cfg_key_tee_max_receiver_pools},
   {"tee_ipprec", cfg_key_nfprobe_ip_precedence},
   {"tee_pipe_size", cfg_key_tee_pipe_size},
+  {"tee_batch_size", cfg_key_tee_batch_size},
   {"tee_dissect_send_full_pkt", cfg_key_tee_dissect_send_full_pkt},
   {"bgp_daemon", cfg_key_nfacctd_bgp},
   {"bgp_daemon_ip", cfg_key_nfacctd_bgp_ip},
@@ -673,7 +702,9 @@ static const struct _dictionary_line dictionary[] = {
   {"bgp_daemon_as", cfg_key_nfacctd_bgp_as},
   {"bgp_daemon_port", cfg_key_nfacctd_bgp_port},
   {"bgp_daemon_pipe_size", cfg_key_nfacctd_bgp_pipe_size},
+  {"bgp_daemon_cpu_affinity", cfg_key_nfacctd_bgp_cpu_affinity},
   {"bgp_daemon_max_peers", cfg_key_nfacctd_bgp_max_peers},
+  {"bgp_daemon_max_peers_limit", cfg_key_nfacctd_bgp_max_peers_limit},
   {"bgp_daemon_msglog_output", cfg_key_nfacctd_bgp_msglog_output},
   {"bgp_daemon_msglog_file", cfg_key_nfacctd_bgp_msglog_file},
   {"bgp_daemon_msglog_amqp_host", cfg_key_nfacctd_bgp_msglog_amqp_host},
@@ -692,6 +723,8 @@ static const struct _dictionary_line dictionary[] = {
   {"bgp_daemon_msglog_kafka_broker_port", cfg_key_nfacctd_bgp_msglog_kafka_broker_port},
   {"bgp_daemon_msglog_kafka_topic", cfg_key_nfacctd_bgp_msglog_kafka_topic},
   {"bgp_daemon_msglog_kafka_topic_rr", cfg_key_nfacctd_bgp_msglog_kafka_topic_rr},
+  {"bgp_daemon_msglog_batch_size", cfg_key_nfacctd_bgp_msglog_batch_size},
+  {"bgp_daemon_msglog_batch_interval", cfg_key_nfacctd_bgp_msglog_batch_interval},
   {"bgp_daemon_msglog_kafka_partition", cfg_key_nfacctd_bgp_msglog_kafka_partition},
   {"bgp_daemon_msglog_kafka_partition_key", cfg_key_nfacctd_bgp_msglog_kafka_partition_key},
   {"bgp_daemon_msglog_kafka_retry", cfg_key_nfacctd_bgp_msglog_kafka_retry},
@@ -754,7 +787,9 @@ static const struct _dictionary_line dictionary[] = {
   {"bmp_daemon_ip", cfg_key_nfacctd_bmp_ip},
   {"bmp_daemon_port", cfg_key_nfacctd_bmp_port},
   {"bmp_daemon_pipe_size", cfg_key_nfacctd_bmp_pipe_size},
+  {"bmp_daemon_cpu_affinity", cfg_key_nfacctd_bmp_cpu_affinity},
   {"bmp_daemon_max_peers", cfg_key_nfacctd_bmp_max_peers},
+  {"bmp_daemon_max_peers_limit", cfg_key_nfacctd_bmp_max_peers_limit},
   {"bmp_daemon_allow_file", cfg_key_nfacctd_bmp_allow_file},
   {"bmp_daemon_ipprec", cfg_key_nfacctd_bmp_ip_precedence},
   {"bmp_daemon_batch", cfg_key_nfacctd_bmp_batch},
@@ -777,6 +812,8 @@ static const struct _dictionary_line dictionary[] = {
   {"bmp_daemon_msglog_kafka_broker_port", cfg_key_nfacctd_bmp_msglog_kafka_broker_port},
   {"bmp_daemon_msglog_kafka_topic", cfg_key_nfacctd_bmp_msglog_kafka_topic},
   {"bmp_daemon_msglog_kafka_topic_rr", cfg_key_nfacctd_bmp_msglog_kafka_topic_rr},
+  {"bmp_daemon_msglog_batch_size", cfg_key_nfacctd_bmp_msglog_batch_size},
+  {"bmp_daemon_msglog_batch_interval", cfg_key_nfacctd_bmp_msglog_batch_interval},
   {"bmp_daemon_msglog_kafka_partition", cfg_key_nfacctd_bmp_msglog_kafka_partition},
   {"bmp_daemon_msglog_kafka_partition_key", cfg_key_nfacctd_bmp_msglog_kafka_partition_key},
   {"bmp_daemon_msglog_kafka_retry", cfg_key_nfacctd_bmp_msglog_kafka_retry},
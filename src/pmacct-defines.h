@@ -27,7 +27,8 @@
 #define ARGS_PMTELEMETRYD "hVL:l:f:dDS:F:o:O:i:"
 #define ARGS_PMBGPD "hVL:l:f:dDS:F:o:O:i:"
 #define ARGS_PMBMPD "hVL:l:f:dDS:F:o:O:i:"
-#define ARGS_PMACCT "Ssc:Cetm:p:P:M:arN:n:lT:O:E:uDVUiI"
+#define ARGS_PMACCT "Ssc:Cetm:p:P:M:arN:n:lT:L:F:O:E:uDVUiI"
+#define ARGS_PMBENCH "hP:d:w:e:b:T:k:z:r:n:t:R:p:s:"
 #define N_PRIMITIVES 75
 #define N_FUNCS 10 
 #define MAX_N_PLUGINS 32
@@ -100,6 +101,7 @@
 #define PMTELEMETRYD_USAGE_HEADER "Streaming Network Telemetry Daemon, pmtelemetryd 1.7.0"
 #define PMBGPD_USAGE_HEADER "pmacct BGP Collector Daemon, pmbgpd 1.7.0"
 #define PMBMPD_USAGE_HEADER "pmacct BMP Collector Daemon, pmbmpd 1.7.0"
+#define PMBENCH_USAGE_HEADER "pmacct synthetic traffic generator, pmbench 1.7.0"
 #define PMACCT_COMPILE_ARGS COMPILE_ARGS
 #ifndef TRUE
 #define TRUE 1
@@ -360,6 +362,7 @@
 #define WANT_LOCK_OP			0x00000100
 #define WANT_CUSTOM_PRIMITIVES_TABLE	0x00000200
 #define WANT_ERASE_LAST_TSTAMP		0x00000400
+#define WANT_STREAM			0x00000800
 
 #define PIPE_TYPE_METADATA	0x00000001
 #define PIPE_TYPE_PAYLOAD	0x00000002
@@ -440,6 +443,7 @@ typedef struct {
 
 /* one-off: pt_ structures should all be defined in pretag.h */
 typedef struct {
+  u_int32_t id; /* into the interned labels table, see pretag_label_intern() */
   u_int32_t len;
   char *val;
 } pt_label_t;
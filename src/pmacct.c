@@ -31,6 +31,8 @@
 
 /* prototypes */
 int Recv(int, unsigned char **);
+int RecvStream(int, unsigned char **, struct query_stream_end *);
+int pmc_recv_all(int, void *, int);
 void print_ex_options_error();
 void write_status_header_formatted();
 void write_status_header_csv();
@@ -91,6 +93,8 @@ void usage_client(char *prog)
   printf("  -a\tDisplay all table fields (even those currently unused)\n");
   printf("  -c\t< src_mac | dst_mac | vlan | cos | src_host | dst_host | src_net | dst_net | src_mask | dst_mask | \n\t src_port | dst_port | tos | proto | src_as | dst_as | sum_mac | sum_host | sum_net | sum_as | \n\t sum_port | in_iface | out_iface | tag | tag2 | flows | class | std_comm | ext_comm | lrg_comm | as_path | \n\t peer_src_ip | peer_dst_ip | peer_src_as | peer_dst_as | src_as_path | src_std_comm | src_med | \n\t src_ext_comm | src_lrg_comm | src_local_pref | mpls_vpn_rd | etype | sampling_rate | pkt_len_distrib |\n\t post_nat_src_host | post_nat_dst_host | post_nat_src_port | post_nat_dst_port | nat_event |\n\t tunnel_src_host | tunnel_dst_host | tunnel_protocol | tunnel_tos | \n\t timestamp_start | timestamp_end | timestamp_arrival | mpls_label_top | mpls_label_bottom | \n\t mpls_stack_depth | label | src_host_country | dst_host_country | export_proto_seqno | \n\t export_proto_version | src_host_pocode | dst_host_pocode> \n\tSelect primitives to match (required by -N and -M)\n");
   printf("  -T\t<bytes | packets | flows>,[<# how many>] \n\tOutput top N statistics (applies to -M and -s)\n");
+  printf("  -L\t<# entries>,[<cursor>] \n\tOutput a page of statistics, starting at cursor (applies to -M and -s)\n");
+  printf("  -F\t<bytes | packets | flows>,<min value> \n\tOutput only entries whose counter is at least min value (applies to -M and -s)\n");
   printf("  -e\tClear statistics\n");
   printf("  -i\tShow time (in seconds) since statistics were last cleared (ie. pmacct -e)\n");
   printf("  -r\tReset counters (applies to -N and -M)\n");
@@ -671,10 +675,12 @@ int build_query_client(char *path_ptr)
 
 int main(int argc,char **argv)
 {
-  int clibufsz = (MAX_QUERIES*sizeof(struct query_entry))+sizeof(struct query_header)+2;
+  int clibufsz = (MAX_QUERIES*sizeof(struct query_entry))+sizeof(struct query_header)+sizeof(struct query_stream)+2;
   struct pkt_data *acc_elem;
   struct bucket_desc *bd;
   struct query_header q; 
+  struct query_stream qstream;
+  struct query_stream_end qstream_end;
   struct pkt_primitives empty_addr;
   struct pkt_bgp_primitives empty_pbgp;
   struct pkt_legacy_bgp_primitives empty_plbgp;
@@ -713,7 +719,7 @@ int main(int argc,char **argv)
   int errflag, cp, want_stats, want_erase, want_reset, want_class_table; 
   int want_status, want_mrtg, want_counter, want_match, want_all_fields;
   int want_output, want_pkt_len_distrib_table, want_custom_primitives_table;
-  int want_erase_last_tstamp;
+  int want_erase_last_tstamp, want_stream;
   int which_counter, topN_counter, fetch_from_file, sum_counters, num_counters;
   int topN_howmany, topN_printed;
   int datasize;
@@ -726,6 +732,8 @@ int main(int argc,char **argv)
   clibuf = malloc(clibufsz);
 
   memset(&q, 0, sizeof(struct query_header));
+  memset(&qstream, 0, sizeof(struct query_stream));
+  memset(&qstream_end, 0, sizeof(struct query_stream_end));
   memset(&empty_addr, 0, sizeof(struct pkt_primitives));
   memset(&empty_pbgp, 0, sizeof(struct pkt_bgp_primitives));
   memset(&empty_plbgp, 0, sizeof(struct pkt_legacy_bgp_primitives));
@@ -747,6 +755,7 @@ int main(int argc,char **argv)
   want_stats = FALSE;
   want_erase = FALSE;
   want_erase_last_tstamp = FALSE;
+  want_stream = FALSE;
   want_status = FALSE;
   want_counter = FALSE;
   want_mrtg = FALSE;
@@ -1146,6 +1155,34 @@ int main(int argc,char **argv)
       else if (!strcmp(tmpbuf, "flows")) topN_counter = 3;
       else printf("WARN: -T, ignoring unknown counter type: %s.\n", tmpbuf);
       break;
+    case 'L':
+      strlcpy(tmpbuf, optarg, sizeof(tmpbuf));
+      endptr = strchr(tmpbuf, ',');
+      if (endptr) {
+	*endptr = '\0';
+	endptr++;
+	qstream.cursor = strtoull(endptr, NULL, 10);
+      }
+      qstream.page_size = strtoul(tmpbuf, NULL, 10);
+      if (!qstream.page_size) printf("WARN: -L, ignoring invalid number of entries: %s.\n", tmpbuf);
+      break;
+    case 'F':
+      strlcpy(tmpbuf, optarg, sizeof(tmpbuf));
+      pmc_lower_string(tmpbuf);
+      endptr = strchr(tmpbuf, ',');
+      if (!endptr) {
+	printf("WARN: -F, ignoring filter without a min value: %s.\n", tmpbuf);
+	break;
+      }
+      *endptr = '\0';
+      endptr++;
+      qstream.filter_min = strtoull(endptr, NULL, 10);
+
+      if (!strcmp(tmpbuf, "bytes")) qstream.filter_counter = 1;
+      else if (!strcmp(tmpbuf, "packets")) qstream.filter_counter = 2;
+      else if (!strcmp(tmpbuf, "flows")) qstream.filter_counter = 3;
+      else printf("WARN: -F, ignoring unknown counter type: %s.\n", tmpbuf);
+      break;
     case 'S':
       sum_counters = TRUE;
       break;
@@ -1313,6 +1350,27 @@ int main(int argc,char **argv)
     exit(1);
   }
 
+  if ((qstream.page_size || qstream.filter_counter) && (!want_match && !want_stats)) {
+    printf("ERROR: -L and -F options apply only to -M or -s\n  Exiting...\n\n");
+    usage_client(argv[0]);
+    exit(1);
+  }
+
+  if ((qstream.page_size || qstream.filter_counter) && want_reset) {
+    printf("ERROR: -L and -F options can't be mixed with -r\n  Exiting...\n\n");
+    usage_client(argv[0]);
+    exit(1);
+  }
+
+  /* ranking, filtering and paging are performed by the server; counter
+     resets are left to the legacy query */
+  if ((topN_counter || qstream.page_size || qstream.filter_counter) && !want_reset) {
+    want_stream = TRUE;
+    q.type |= WANT_STREAM;
+    qstream.topN_counter = topN_counter;
+    qstream.topN = topN_howmany;
+  }
+
   if (want_counter || want_match) {
     char *ptr = match_string, prefix[] = "file:";
 
@@ -2022,6 +2080,10 @@ int main(int argc,char **argv)
   /* arranging header and size of buffer to send */
   memcpy(clibuf, &q, sizeof(struct query_header)); 
   buflen = sizeof(struct query_header)+(q.num*sizeof(struct query_entry));
+  if (want_stream) {
+    memcpy(clibuf+buflen, &qstream, sizeof(struct query_stream));
+    buflen += sizeof(struct query_stream);
+  }
   buflen++;
   clibuf[buflen] = '\x4'; /* EOT */
   buflen++;
@@ -2031,7 +2093,8 @@ int main(int argc,char **argv)
 
   /* reading results */ 
   if (want_stats || want_match) {
-    unpacked = Recv(sd, &largebuf);
+    if (want_stream) unpacked = RecvStream(sd, &largebuf, &qstream_end);
+    else unpacked = Recv(sd, &largebuf);
  
     if (!unpacked) {
       printf("ERROR: missing EOF from server (4)\n");
@@ -2126,7 +2189,7 @@ int main(int argc,char **argv)
     acc_elem = (struct pkt_data *) elem;
 
     topN_printed = 0;
-    if (topN_counter) {
+    if (topN_counter && !want_stream) {
       int num = unpacked/datasize;
 
       client_counters_merge_sort((void *)acc_elem, 0, num, datasize, topN_counter);
@@ -2885,6 +2948,10 @@ int main(int argc,char **argv)
       printed += datasize;
     }
     if (want_output & PRINT_OUTPUT_FORMATTED) printf("\nFor a total of: %d entries\n", counter);
+    if (want_stream && qstream_end.next_cursor) {
+      if (want_output & PRINT_OUTPUT_FORMATTED) printf("Next cursor: %llu\n", (unsigned long long)qstream_end.next_cursor);
+      else fprintf(stderr, "INFO: next cursor: %llu\n", (unsigned long long)qstream_end.next_cursor);
+    }
   }
   else if (want_erase) printf("OK: Clearing stats.\n");
   else if (want_erase_last_tstamp) {
@@ -3105,6 +3172,58 @@ int Recv(int sd, unsigned char **buf)
   else return 0;
 }
 
+/* reads a WANT_STREAM reply: frames are reassembled in the same layout Recv() returns */
+int RecvStream(int sd, unsigned char **buf, struct query_stream_end *qse)
+{
+  struct query_frame qf;
+  int unpacked = 0, allocated = LARGEBUFLEN;
+
+  *buf = (unsigned char *) malloc(allocated);
+  if (!(*buf)) {
+    printf("ERROR: malloc() out of memory (RecvStream)\n");
+    exit(1);
+  }
+  memset(*buf, 0, allocated);
+  memset(qse, 0, sizeof(struct query_stream_end));
+
+  for (;;) {
+    if (pmc_recv_all(sd, &qf, sizeof(qf)) != sizeof(qf)) return 0;
+
+    if (qf.type == QUERY_FRAME_END) {
+      if (qf.len != sizeof(struct query_stream_end)) return 0;
+      if (pmc_recv_all(sd, qse, qf.len) != qf.len) return 0;
+      return unpacked;
+    }
+    else if (qf.type != QUERY_FRAME_HEADER && qf.type != QUERY_FRAME_DATA) return 0;
+    else if (qf.len > LARGEBUFLEN) return 0;
+
+    if ((unpacked+qf.len) > allocated) {
+      while ((unpacked+qf.len) > allocated) allocated *= 2;
+      *buf = realloc((unsigned char *) *buf, allocated);
+      if (!(*buf)) {
+        printf("ERROR: realloc() out of memory (RecvStream)\n");
+        exit(1);
+      }
+    }
+
+    if (pmc_recv_all(sd, (*buf)+unpacked, qf.len) != qf.len) return 0;
+    unpacked += qf.len;
+  }
+}
+
+int pmc_recv_all(int sd, void *buf, int len)
+{
+  int num, received = 0;
+
+  while (received < len) {
+    num = recv(sd, ((char *)buf)+received, len-received, 0);
+    if (num <= 0) break;
+    received += num;
+  }
+
+  return received;
+}
+
 int check_data_sizes(struct query_header *qh, struct pkt_data *acc_elem)
 {
   if (qh->cnt_sz != sizeof(acc_elem->pkt_len)) {
@@ -147,6 +147,13 @@
 #define Inline static inline
 #endif
 
+/* state private to each capture worker, ie. flow and fragment tables */
+#if defined ENABLE_THREADS
+#define PM_TLS __thread
+#else
+#define PM_TLS
+#endif
+
 /* Let work the unaligned copy macros the hard way: byte-per byte copy via
    u_char pointers. We discard the packed attribute way because it fits just
    to GNU compiler */
@@ -236,6 +243,12 @@ typedef struct {
 #include "log.h"
 #include "once.h"
 #include "mpls.h"
+#include "timer_wheel.h"
+#include "slab.h"
+#include "sendq.h"
+#include "jsonbuf.h"
+#include "arena.h"
+#include "stats.h"
 
 /*
  * htonvl(): host to network (byte ordering) variable length
@@ -273,6 +286,8 @@ struct pcap_callback_data {
   struct pcap_device *device;
   u_int32_t ifindex_in;
   u_int32_t ifindex_out;
+  int worker_id;
+  u_int8_t serialize;
 };
 
 struct _protocols_struct {
@@ -369,6 +384,7 @@ EXT ssize_t recvfrom_savefile(struct pcap_device *, void **, struct sockaddr *,
 
 #ifndef HAVE_STRLCPY
 size_t strlcpy(char *, const char *, size_t);
+size_t strlcat(char *, const char *, size_t); /* nfprobe_plugin/strlcat.c */
 #endif
 
 #if (defined WITH_JANSSON)
@@ -33,6 +33,7 @@
 #include "ip_flow.h"
 #include "net_aggr.h"
 #include "thread_pool.h"
+#include "tpacket.h"
 #include "bgp/bgp.h"
 #include "classifier.h"
 #include "isis/isis.h"
@@ -452,6 +453,8 @@ int main(int argc,char **argv, char **envp)
     else Log(LOG_INFO, "INFO ( %s/core ): proc_priority set to %d\n", config.name, getpriority(PRIO_PROCESS, 0));
   }
 
+  if (config.cpu_affinity) pm_set_placement(config.cpu_affinity, config.numa_bind, config.name, "core");
+
   Log(LOG_INFO, "INFO ( %s/core ): %s (%s)\n", config.name, PMACCTD_USAGE_HEADER, PMACCT_BUILD);
   Log(LOG_INFO, "INFO ( %s/core ): %s\n", config.name, PMACCT_COMPILE_ARGS);
 
@@ -728,10 +731,29 @@ int main(int argc,char **argv, char **envp)
     list = list->next;
   }
 
+  if (config.capture_threads) {
+#if defined (HAVE_TPACKET_V3)
+    if (config.pcap_savefile) {
+      Log(LOG_WARNING, "WARN ( %s/core ): 'pmacctd_capture_threads' does not apply to 'pcap_savefile'. Ignored.\n", config.name);
+      config.capture_threads = 0;
+    }
+#if defined (WITH_NDPI)
+    if (config.classifier_ndpi && config.capture_threads > 1) {
+      Log(LOG_ERR, "ERROR ( %s/core ): nDPI classification does not support 'pmacctd_capture_threads' > 1. Exiting.\n", config.name);
+      exit(1);
+    }
+#endif
+#else
+    Log(LOG_ERR, "ERROR ( %s/core ): 'pmacctd_capture_threads' requires Linux TPACKET_V3 support and threads (--enable-threads). Exiting.\n", config.name);
+    exit(1);
+#endif
+  }
+
   load_plugins(&req);
 
-  if (config.handle_fragments) init_ip_fragment_handler();
-  if (config.handle_flows) init_ip_flow_handler();
+  /* capture threads set up their own fragment and flow tables */
+  if (config.handle_fragments && !config.capture_threads) init_ip_fragment_handler();
+  if (config.handle_flows && !config.capture_threads) init_ip_flow_handler();
   load_networks(config.networks_file, &nt, &nc);
 
   /* If any device/savefile have been specified, choose a suitable device
@@ -815,13 +837,23 @@ int main(int argc,char **argv, char **envp)
     if (config.dev) Log(LOG_WARNING, "WARN ( %s/core ): %s\n", config.name, errbuf);
   }
 
-  if (pcap_compile(device.dev_desc, &filter, config.clbuf, 0, netmask) < 0)
+  if (pcap_compile(device.dev_desc, &filter, config.clbuf, 0, netmask) < 0) {
     Log(LOG_WARNING, "WARN ( %s/core ): %s (going on without a filter)\n", config.name, pcap_geterr(device.dev_desc));
+    memset(&filter, 0, sizeof(filter));
+  }
   else {
     if (pcap_setfilter(device.dev_desc, &filter) < 0)
       Log(LOG_WARNING, "WARN ( %s/core ): %s (going on without a filter)\n", config.name, pcap_geterr(device.dev_desc));
   }
 
+  /* capture threads: the libpcap handle was only needed to learn the
+     link type and compile the filter; keep a dead one for pcap_geterr() */
+  if (config.capture_threads) {
+    pcap_close(device.dev_desc);
+    device.dev_desc = pcap_open_dead(device.link_type, psize);
+    glob_pcapt = device.dev_desc;
+  }
+
   /* signal handling we want to inherit to plugins (when not re-defined elsewhere) */
   signal(SIGCHLD, startup_handle_falling_child); /* takes note of plugins failed during startup phase */
   signal(SIGHUP, reload); /* handles reopening of syslog channel */
@@ -895,6 +927,7 @@ int main(int argc,char **argv, char **envp)
        but in case maps are reloadable (ie. bta), it could be handy
        to keep a backup feed in memory */
     config.nfacctd_bgp_max_peers = 2;
+    config.nfacctd_bgp_max_peers_limit = 2;
 
     cb_data.f_agent = (char *)&client;
     nfacctd_bgp_wrapper();
@@ -953,6 +986,15 @@ int main(int argc,char **argv, char **envp)
     sleep(2);
   }
 
+#if defined (HAVE_TPACKET_V3)
+  if (config.capture_threads) {
+    if (tpacket_workers_init(&cb_data, &filter) == ERR) exit_all(1);
+
+    /* the core process is left to signals handling */
+    for(;;) sleep(60);
+  }
+#endif
+
   /* Main loop: if pcap_loop() exits maybe an error occurred; we will try closing
      and reopening again our listening device */
   for(;;) {
@@ -0,0 +1,822 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* defines */
+#define __PMBENCH_C
+
+/* includes */
+#include "pmacct.h"
+#include "nfacctd.h"
+#include "sflow.h"
+#include "jhash.h"
+#include "pmbench.h"
+#include <math.h>
+
+/* Functions */
+void usage_pmbench(char *prog_name)
+{
+  printf("%s (%s)\n", PMBENCH_USAGE_HEADER, PMACCT_BUILD);
+  printf("Usage: %s [ -P nfv5 | nfv9 | ipfix | sflow5 ] [ -d host:port | -w pcap_file ] [ options ]\n", prog_name);
+  printf("       %s [ -h ]\n", prog_name);
+  printf("\nGenerates synthetic NetFlow/IPFIX/sFlow traffic at maximum speed in order to benchmark\n");
+  printf("nfacctd and sfacctd, either over a local socket or, via a pcap_savefile, in-process.\n");
+  printf("\nOptions:\n");
+  printf("  -h  \tShow this page\n");
+  printf("  -P  \tProtocol to generate. Default: nfv9\n");
+  printf("  -d  \tSend to the specified IPv4 host:port. Default: 127.0.0.1:2100 (6343 for sFlow)\n");
+  printf("  -w  \tWrite datagrams to the specified pcap file instead, see pcap_savefile\n");
+  printf("  -e  \tNumber of exporters. Default: 1\n");
+  printf("  -b  \tAddress of the first exporter; on a loopback destination each exporter sends from\n\tits own address. Default: %s\n", PMBENCH_DEFAULT_BASE_ADDR);
+  printf("  -T  \tNumber of NetFlow v9/IPFIX templates per exporter (max %u). Default: 1\n", PMBENCH_MAX_TEMPLATES);
+  printf("  -k  \tFlow key cardinality. Default: %u\n", PMBENCH_DEFAULT_KEYS);
+  printf("  -z  \tZipf exponent of the flow key distribution; 0 is uniform. Default: 0\n");
+  printf("  -r  \tMax records per datagram. Default: as many as fit\n");
+  printf("  -n  \tNumber of datagrams to generate. Default: %u when writing a pcap file\n", PMBENCH_DEFAULT_PCAP_DGRAMS);
+  printf("  -t  \tSeconds to generate for. Default: %u when sending\n", PMBENCH_DEFAULT_SECS);
+  printf("  -R  \tDatagrams between NetFlow v9/IPFIX template refreshes. Default: %u\n", PMBENCH_DEFAULT_REFRESH);
+  printf("  -p  \tCap the rate to the specified datagrams/s. Default: none\n");
+  printf("  -s  \tRandom seed. Default: 1\n");
+  printf("\nA summary line is printed on exit; daemons can report per-stage throughput via the\n");
+  printf("stats_file config key.\n");
+  printf("\n");
+  printf("For suggestions, critics, bugs, contact me: %s.\n", MANTAINER);
+}
+
+/* xorshift64*: fast and good enough to shape traffic */
+u_int64_t pmbench_rand(struct pmbench_ctx *ctx)
+{
+  ctx->rng ^= ctx->rng >> 12;
+  ctx->rng ^= ctx->rng << 25;
+  ctx->rng ^= ctx->rng >> 27;
+
+  return ctx->rng * 0x2545F4914F6CDD1DULL;
+}
+
+int pmbench_zipf_init(struct pmbench_ctx *ctx)
+{
+  double sum = 0;
+  u_int32_t idx;
+
+  if (ctx->zipf_s <= 0) return SUCCESS;
+
+  ctx->zipf_cdf = malloc(ctx->keys * sizeof(double));
+  if (!ctx->zipf_cdf) return ERR;
+
+  for (idx = 0; idx < ctx->keys; idx++) {
+    sum += 1.0 / pow((double)(idx + 1), ctx->zipf_s);
+    ctx->zipf_cdf[idx] = sum;
+  }
+
+  for (idx = 0; idx < ctx->keys; idx++) ctx->zipf_cdf[idx] /= sum;
+
+  return SUCCESS;
+}
+
+u_int32_t pmbench_key(struct pmbench_ctx *ctx)
+{
+  u_int32_t low = 0, high = (ctx->keys - 1), mid;
+  double u;
+
+  if (!ctx->zipf_cdf) return (pmbench_rand(ctx) % ctx->keys);
+
+  u = ((pmbench_rand(ctx) >> 11) * (1.0 / 9007199254740992.0));
+
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (ctx->zipf_cdf[mid] < u) low = mid + 1;
+    else high = mid;
+  }
+
+  return low;
+}
+
+/* the same key always yields the same flow primitives; counters and
+   timestamps change every time */
+void pmbench_flow(struct pmbench_ctx *ctx, u_int32_t key, struct pmbench_flow *flow)
+{
+  static const u_int16_t dports[] = { 80, 443, 53, 22, 25, 123, 8080, 3306 };
+  u_int32_t h1, h2, h3, uptime;
+
+  h1 = jhash_1word(key, 0x9e3779b9);
+  h2 = jhash_1word(key, h1);
+  h3 = jhash_1word(key, h2);
+
+  flow->src = (0x0A000000 | (h1 & 0x00FFFFFF));
+  flow->dst = (0xAC100000 | (h2 & 0x000FFFFF));
+  flow->nexthop = (0xC0000200 | (1 + (h1 % 254)));
+  flow->sport = (1024 + (h3 % 64000));
+  flow->dport = dports[(h3 >> 16) & 0x7];
+  flow->proto = ((flow->dport == 53 || flow->dport == 123) ? IPPROTO_UDP : IPPROTO_TCP);
+  flow->tos = 0;
+  flow->tcp_flags = (flow->proto == IPPROTO_TCP ? 0x18 : 0);
+  flow->src_mask = 24;
+  flow->dst_mask = 20;
+  flow->src_as = (64512 + ((h1 >> 24) % 1000));
+  flow->dst_as = (64512 + ((h2 >> 20) % 1000));
+  flow->input = (1 + (h3 % 48));
+  flow->output = (1 + ((h3 >> 8) % 48));
+
+  flow->pkts = (1 + (pmbench_rand(ctx) % 100));
+  flow->bytes = (flow->pkts * (64 + (pmbench_rand(ctx) % 1400)));
+
+  /* msecs since the (fake) exporter boot, one hour ago */
+  uptime = ((ctx->now.tv_sec - ctx->start.tv_sec + 3600) * 1000) + (ctx->now.tv_usec / 1000);
+  flow->last = (uptime - (pmbench_rand(ctx) % 1000));
+  flow->first = (flow->last - (pmbench_rand(ctx) % 5000));
+}
+
+static void pmbench_put(u_char **ptr, u_int64_t val, int len)
+{
+  int idx;
+
+  for (idx = (len - 1); idx >= 0; idx--) {
+    (*ptr)[idx] = (val & 0xFF);
+    val >>= 8;
+  }
+
+  (*ptr) += len;
+}
+
+/* template 'idx' carries the mandatory fields plus the optional ones
+   not masked out by its index, so that templates are all different */
+void pmbench_templates_init(struct pmbench_ctx *ctx)
+{
+  int ipfix = (ctx->proto == PMBENCH_IPFIX);
+  struct pmbench_field mandatory[] = {
+    { NF9_IPV4_SRC_ADDR, 4 }, { NF9_IPV4_DST_ADDR, 4 }, { NF9_L4_SRC_PORT, 2 },
+    { NF9_L4_DST_PORT, 2 }, { NF9_L4_PROTOCOL, 1 }, { NF9_IN_BYTES, (ipfix ? 8 : 4) },
+    { NF9_IN_PACKETS, (ipfix ? 8 : 4) }, { (ipfix ? NF9_FIRST_SWITCHED_SEC : NF9_FIRST_SWITCHED), 4 },
+    { (ipfix ? NF9_LAST_SWITCHED_SEC : NF9_LAST_SWITCHED), 4 }
+  };
+  struct pmbench_field optional[] = {
+    { NF9_INPUT_SNMP, (ipfix ? 4 : 2) }, { NF9_OUTPUT_SNMP, (ipfix ? 4 : 2) }, { NF9_SRC_TOS, 1 },
+    { NF9_TCP_FLAGS, 1 }, { NF9_SRC_AS, 4 }, { NF9_DST_AS, 4 }, { NF9_IPV4_NEXT_HOP, 4 },
+    { NF9_SRC_MASK, 1 }, { NF9_DST_MASK, 1 }
+  };
+  int num_mandatory = (sizeof(mandatory) / sizeof(struct pmbench_field));
+  int num_optional = (sizeof(optional) / sizeof(struct pmbench_field));
+  struct pmbench_template *tpl;
+  u_int32_t idx, mask;
+  int j;
+
+  for (idx = 0; idx < ctx->num_templates; idx++) {
+    tpl = &ctx->templates[idx];
+    memset(tpl, 0, sizeof(struct pmbench_template));
+    tpl->id = (256 + idx);
+
+    for (j = 0; j < num_mandatory; j++) {
+      tpl->fields[tpl->num++] = mandatory[j];
+      tpl->rec_len += mandatory[j].len;
+    }
+
+    mask = (((1 << num_optional) - 1) ^ idx);
+    for (j = 0; j < num_optional; j++) {
+      if (mask & (1 << j)) {
+        tpl->fields[tpl->num++] = optional[j];
+        tpl->rec_len += optional[j].len;
+      }
+    }
+  }
+}
+
+static void pmbench_put_field(u_char **ptr, struct pmbench_field *field, struct pmbench_flow *flow, struct timeval *now)
+{
+  u_int64_t val = 0;
+
+  switch (field->type) {
+  case NF9_IPV4_SRC_ADDR: val = flow->src; break;
+  case NF9_IPV4_DST_ADDR: val = flow->dst; break;
+  case NF9_IPV4_NEXT_HOP: val = flow->nexthop; break;
+  case NF9_L4_SRC_PORT: val = flow->sport; break;
+  case NF9_L4_DST_PORT: val = flow->dport; break;
+  case NF9_L4_PROTOCOL: val = flow->proto; break;
+  case NF9_SRC_TOS: val = flow->tos; break;
+  case NF9_TCP_FLAGS: val = flow->tcp_flags; break;
+  case NF9_IN_BYTES: val = flow->bytes; break;
+  case NF9_IN_PACKETS: val = flow->pkts; break;
+  case NF9_FIRST_SWITCHED: val = flow->first; break;
+  case NF9_LAST_SWITCHED: val = flow->last; break;
+  case NF9_FIRST_SWITCHED_SEC: val = (now->tv_sec - 1 - ((flow->last - flow->first) / 1000)); break;
+  case NF9_LAST_SWITCHED_SEC: val = (now->tv_sec - 1); break;
+  case NF9_INPUT_SNMP: val = flow->input; break;
+  case NF9_OUTPUT_SNMP: val = flow->output; break;
+  case NF9_SRC_AS: val = flow->src_as; break;
+  case NF9_DST_AS: val = flow->dst_as; break;
+  case NF9_SRC_MASK: val = flow->src_mask; break;
+  case NF9_DST_MASK: val = flow->dst_mask; break;
+  default: break;
+  }
+
+  pmbench_put(ptr, val, field->len);
+}
+
+int pmbench_build_nfv5(struct pmbench_ctx *ctx, struct pmbench_exporter *exp, u_char *buf)
+{
+  struct struct_header_v5 *hdr = (struct struct_header_v5 *) buf;
+  struct struct_export_v5 *rec;
+  struct pmbench_flow flow;
+  u_int32_t num = V5_MAXFLOWS, idx;
+
+  if (ctx->max_records && ctx->max_records < num) num = ctx->max_records;
+
+  memset(buf, 0, sizeof(struct struct_header_v5) + (num * sizeof(struct struct_export_v5)));
+  rec = (struct struct_export_v5 *) (buf + sizeof(struct struct_header_v5));
+
+  for (idx = 0; idx < num; idx++, rec++) {
+    pmbench_flow(ctx, pmbench_key(ctx), &flow);
+
+    rec->srcaddr.s_addr = htonl(flow.src);
+    rec->dstaddr.s_addr = htonl(flow.dst);
+    rec->nexthop.s_addr = htonl(flow.nexthop);
+    rec->input = htons(flow.input);
+    rec->output = htons(flow.output);
+    rec->dPkts = htonl(flow.pkts);
+    rec->dOctets = htonl(flow.bytes);
+    rec->First = htonl(flow.first);
+    rec->Last = htonl(flow.last);
+    rec->srcport = htons(flow.sport);
+    rec->dstport = htons(flow.dport);
+    rec->tcp_flags = flow.tcp_flags;
+    rec->prot = flow.proto;
+    rec->tos = flow.tos;
+    rec->src_as = htons(flow.src_as);
+    rec->dst_as = htons(flow.dst_as);
+    rec->src_mask = flow.src_mask;
+    rec->dst_mask = flow.dst_mask;
+  }
+
+  hdr->version = htons(5);
+  hdr->count = htons(num);
+  hdr->SysUptime = htonl(flow.last + 1000);
+  hdr->unix_secs = htonl(ctx->now.tv_sec);
+  hdr->unix_nsecs = htonl(ctx->now.tv_usec * 1000);
+  hdr->flow_sequence = htonl(exp->flows);
+  hdr->engine_type = ((exp - ctx->exporters) >> 8);
+  hdr->engine_id = ((exp - ctx->exporters) & 0xFF);
+
+  exp->flows += num;
+  ctx->stats.records += num;
+
+  return (sizeof(struct struct_header_v5) + (num * sizeof(struct struct_export_v5)));
+}
+
+static int pmbench_build_hdr(struct pmbench_ctx *ctx, struct pmbench_exporter *exp, u_char *buf, u_int16_t count, int len)
+{
+  u_int32_t uptime = (((ctx->now.tv_sec - ctx->start.tv_sec + 3600) * 1000) + (ctx->now.tv_usec / 1000));
+  u_int32_t source_id = (exp - ctx->exporters);
+
+  if (ctx->proto == PMBENCH_NFV9) {
+    struct struct_header_v9 *hdr = (struct struct_header_v9 *) buf;
+
+    hdr->version = htons(9);
+    hdr->count = htons(count);
+    hdr->SysUptime = htonl(uptime);
+    hdr->unix_secs = htonl(ctx->now.tv_sec);
+    hdr->flow_sequence = htonl(exp->seq++);
+    hdr->source_id = htonl(source_id);
+
+    return sizeof(struct struct_header_v9);
+  }
+  else {
+    struct struct_header_ipfix *hdr = (struct struct_header_ipfix *) buf;
+
+    hdr->version = htons(10);
+    hdr->len = htons(len);
+    hdr->unix_secs = htonl(ctx->now.tv_sec);
+    hdr->flow_sequence = htonl(exp->flows);
+    hdr->source_id = htonl(source_id);
+
+    return sizeof(struct struct_header_ipfix);
+  }
+}
+
+static int pmbench_hdr_len(struct pmbench_ctx *ctx)
+{
+  return (ctx->proto == PMBENCH_NFV9 ? sizeof(struct struct_header_v9) : sizeof(struct struct_header_ipfix));
+}
+
+/* pmbench_build_template(): packs as many templates as fit, starting
+   from '*next'; returns datagram length */
+int pmbench_build_template(struct pmbench_ctx *ctx, struct pmbench_exporter *exp, u_char *buf, u_int32_t *next)
+{
+  struct pmbench_template *tpl;
+  u_char *ptr, *set;
+  u_int16_t count = 0;
+  int j;
+
+  set = (buf + pmbench_hdr_len(ctx));
+  ptr = (set + sizeof(struct data_hdr_v9));
+
+  for (; (*next) < ctx->num_templates; (*next)++, count++) {
+    tpl = &ctx->templates[*next];
+    if ((ptr - buf) + sizeof(struct template_hdr_v9) + (tpl->num * sizeof(struct template_field_v9)) > PMBENCH_DGRAM_LEN) break;
+
+    pmbench_put(&ptr, tpl->id, 2);
+    pmbench_put(&ptr, tpl->num, 2);
+    for (j = 0; j < tpl->num; j++) {
+      pmbench_put(&ptr, tpl->fields[j].type, 2);
+      pmbench_put(&ptr, tpl->fields[j].len, 2);
+    }
+  }
+
+  ((struct data_hdr_v9 *)set)->flow_id = htons(ctx->proto == PMBENCH_NFV9 ? 0 : 2);
+  ((struct data_hdr_v9 *)set)->flow_len = htons(ptr - set);
+  pmbench_build_hdr(ctx, exp, buf, count, (ptr - buf));
+
+  return (ptr - buf);
+}
+
+int pmbench_build_data(struct pmbench_ctx *ctx, struct pmbench_exporter *exp, u_char *buf)
+{
+  struct pmbench_template *tpl = &ctx->templates[exp->dgrams % ctx->num_templates];
+  struct pmbench_flow flow;
+  u_char *ptr, *set;
+  u_int32_t num, idx;
+  int j, hdr_len = pmbench_hdr_len(ctx);
+
+  num = ((PMBENCH_DGRAM_LEN - hdr_len - sizeof(struct data_hdr_v9)) / tpl->rec_len);
+  if (ctx->max_records && ctx->max_records < num) num = ctx->max_records;
+
+  set = (buf + hdr_len);
+  ptr = (set + sizeof(struct data_hdr_v9));
+
+  for (idx = 0; idx < num; idx++) {
+    pmbench_flow(ctx, pmbench_key(ctx), &flow);
+    for (j = 0; j < tpl->num; j++) pmbench_put_field(&ptr, &tpl->fields[j], &flow, &ctx->now);
+  }
+
+  /* padding to a 32-bit boundary */
+  while ((ptr - set) % 4) *ptr++ = '\0';
+
+  ((struct data_hdr_v9 *)set)->flow_id = htons(tpl->id);
+  ((struct data_hdr_v9 *)set)->flow_len = htons(ptr - set);
+  pmbench_build_hdr(ctx, exp, buf, num, (ptr - buf));
+
+  exp->flows += num;
+  ctx->stats.records += num;
+
+  return (ptr - buf);
+}
+
+static u_int16_t pmbench_ip_csum(u_int16_t *hdr, int len)
+{
+  u_int32_t sum = 0;
+
+  for (; len > 1; len -= 2) sum += *hdr++;
+  while (sum >> 16) sum = ((sum & 0xFFFF) + (sum >> 16));
+
+  return (~sum & 0xFFFF);
+}
+
+/* Ethernet + IPv4 + TCP/UDP headers of a packet belonging to 'flow' */
+static int pmbench_build_pkt_hdr(struct pmbench_flow *flow, u_char *buf, u_int32_t frame_len)
+{
+  u_char *ptr = buf, *iph;
+  int l4_len = (flow->proto == IPPROTO_TCP ? 20 : 8);
+
+  /* Ethernet */
+  memset(ptr, 0, 12);
+  ptr[5] = 0x01; ptr[11] = 0x02;
+  ptr += 12;
+  pmbench_put(&ptr, ETHERTYPE_IP, 2);
+
+  /* IPv4 */
+  iph = ptr;
+  pmbench_put(&ptr, 0x45, 1);
+  pmbench_put(&ptr, flow->tos, 1);
+  pmbench_put(&ptr, (frame_len - 14), 2);
+  pmbench_put(&ptr, 0, 4);
+  pmbench_put(&ptr, 64, 1);
+  pmbench_put(&ptr, flow->proto, 1);
+  pmbench_put(&ptr, 0, 2);
+  pmbench_put(&ptr, flow->src, 4);
+  pmbench_put(&ptr, flow->dst, 4);
+  ((u_int16_t *)iph)[5] = pmbench_ip_csum((u_int16_t *) iph, 20);
+
+  /* TCP or UDP */
+  pmbench_put(&ptr, flow->sport, 2);
+  pmbench_put(&ptr, flow->dport, 2);
+  if (flow->proto == IPPROTO_TCP) {
+    pmbench_put(&ptr, 1, 4);
+    pmbench_put(&ptr, 0, 4);
+    pmbench_put(&ptr, 0x50, 1);
+    pmbench_put(&ptr, flow->tcp_flags, 1);
+    pmbench_put(&ptr, 65535, 2);
+    pmbench_put(&ptr, 0, 4);
+  }
+  else {
+    pmbench_put(&ptr, (frame_len - 14 - 20), 2);
+    pmbench_put(&ptr, 0, 2);
+  }
+
+  return (14 + 20 + l4_len);
+}
+
+int pmbench_build_sflow5(struct pmbench_ctx *ctx, struct pmbench_exporter *exp, u_char *buf)
+{
+  struct pmbench_flow flow;
+  u_char *ptr = buf, *num_ptr, *sample, *record, pkt[64];
+  u_int32_t num = 0, frame_len, hdr_len, uptime;
+
+  uptime = (((ctx->now.tv_sec - ctx->start.tv_sec + 3600) * 1000) + (ctx->now.tv_usec / 1000));
+
+  pmbench_put(&ptr, SFLDATAGRAM_VERSION5, 4);
+  pmbench_put(&ptr, SFLADDRESSTYPE_IP_V4, 4);
+  pmbench_put(&ptr, ntohl(exp->addr.s_addr), 4);
+  pmbench_put(&ptr, 0, 4);
+  pmbench_put(&ptr, exp->seq++, 4);
+  pmbench_put(&ptr, uptime, 4);
+  num_ptr = ptr;
+  pmbench_put(&ptr, 0, 4);
+
+  /* one flow sample, raw packet header record, per flow */
+  while (!ctx->max_records || num < ctx->max_records) {
+    pmbench_flow(ctx, pmbench_key(ctx), &flow);
+
+    frame_len = (flow.bytes / flow.pkts);
+    hdr_len = pmbench_build_pkt_hdr(&flow, pkt, frame_len);
+    if (((ptr - buf) + 48 + 16 + ((hdr_len + 3) & ~3)) > PMBENCH_DGRAM_LEN) break;
+
+    sample = ptr;
+    pmbench_put(&ptr, SFLFLOW_SAMPLE, 4);
+    pmbench_put(&ptr, 0, 4);
+    pmbench_put(&ptr, exp->flows + num, 4);
+    pmbench_put(&ptr, flow.input, 4);
+    pmbench_put(&ptr, 1, 4);				/* sampling rate */
+    pmbench_put(&ptr, exp->flows + num, 4);		/* sample pool */
+    pmbench_put(&ptr, 0, 4);				/* drops */
+    pmbench_put(&ptr, flow.input, 4);
+    pmbench_put(&ptr, flow.output, 4);
+    pmbench_put(&ptr, 1, 4);				/* records */
+
+    record = ptr;
+    pmbench_put(&ptr, SFLFLOW_HEADER, 4);
+    pmbench_put(&ptr, 0, 4);
+    pmbench_put(&ptr, SFLHEADER_ETHERNET_ISO8023, 4);
+    pmbench_put(&ptr, frame_len, 4);
+    pmbench_put(&ptr, 4, 4);				/* stripped */
+    pmbench_put(&ptr, hdr_len, 4);
+    memcpy(ptr, pkt, hdr_len);
+    ptr += hdr_len;
+    while ((ptr - record) % 4) *ptr++ = '\0';
+
+    ((u_int32_t *)record)[1] = htonl(ptr - record - 8);
+    ((u_int32_t *)sample)[1] = htonl(ptr - sample - 8);
+
+    num++;
+  }
+
+  pmbench_put(&num_ptr, num, 4);
+
+  exp->flows += num;
+  ctx->stats.records += num;
+
+  return (ptr - buf);
+}
+
+int pmbench_send(struct pmbench_ctx *ctx, struct pmbench_exporter *exp, u_char *buf, int len)
+{
+  int ret;
+
+  if (ctx->dumper) {
+    u_char frame[14 + 20 + 8 + PMBENCH_DGRAM_LEN], *ptr = frame, *iph;
+    struct pcap_pkthdr pkthdr;
+
+    memset(frame, 0, 12);
+    frame[5] = 0x01; frame[11] = 0x02;
+    ptr += 12;
+    pmbench_put(&ptr, ETHERTYPE_IP, 2);
+
+    iph = ptr;
+    pmbench_put(&ptr, 0x45, 1);
+    pmbench_put(&ptr, 0, 1);
+    pmbench_put(&ptr, (20 + 8 + len), 2);
+    pmbench_put(&ptr, 0, 4);
+    pmbench_put(&ptr, 64, 1);
+    pmbench_put(&ptr, IPPROTO_UDP, 1);
+    pmbench_put(&ptr, 0, 2);
+    memcpy(ptr, &exp->addr.s_addr, 4); ptr += 4;
+    memcpy(ptr, &ctx->dst.sin_addr.s_addr, 4); ptr += 4;
+    ((u_int16_t *)iph)[5] = pmbench_ip_csum((u_int16_t *) iph, 20);
+
+    pmbench_put(&ptr, 1024 + ((exp - ctx->exporters) % 64000), 2);
+    memcpy(ptr, &ctx->dst.sin_port, 2); ptr += 2;
+    pmbench_put(&ptr, (8 + len), 2);
+    pmbench_put(&ptr, 0, 2);
+    memcpy(ptr, buf, len);
+
+    pkthdr.ts = ctx->now;
+    pkthdr.caplen = pkthdr.len = (14 + 20 + 8 + len);
+    pcap_dump((u_char *) ctx->dumper, &pkthdr, frame);
+  }
+  else {
+#if defined IP_PKTINFO
+    if (ctx->spoof) {
+      char cbuf[CMSG_SPACE(sizeof(struct in_pktinfo))];
+      struct msghdr msg;
+      struct iovec iov;
+      struct cmsghdr *cmsg;
+      struct in_pktinfo *pi;
+
+      memset(&msg, 0, sizeof(msg));
+      memset(cbuf, 0, sizeof(cbuf));
+      iov.iov_base = buf;
+      iov.iov_len = len;
+      msg.msg_name = &ctx->dst;
+      msg.msg_namelen = sizeof(ctx->dst);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = cbuf;
+      msg.msg_controllen = sizeof(cbuf);
+
+      cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = IPPROTO_IP;
+      cmsg->cmsg_type = IP_PKTINFO;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+      pi = (struct in_pktinfo *) CMSG_DATA(cmsg);
+      pi->ipi_spec_dst = exp->addr;
+
+      ret = sendmsg(ctx->sock, &msg, 0);
+    }
+    else
+#endif
+    ret = sendto(ctx->sock, buf, len, 0, (struct sockaddr *) &ctx->dst, sizeof(ctx->dst));
+
+    /* a full socket buffer is expected when going at full speed */
+    if (ret < 0 && errno != ENOBUFS && errno != EAGAIN) {
+      fprintf(stderr, "ERROR: send() failed: %s\n", strerror(errno));
+      return ERR;
+    }
+  }
+
+  exp->dgrams++;
+  ctx->stats.dgrams++;
+  ctx->stats.bytes += len;
+
+  return SUCCESS;
+}
+
+void pmbench_report(struct pmbench_ctx *ctx, struct pmbench_stats *stats, double secs, FILE *out, int final)
+{
+  const char *proto;
+
+  if (secs <= 0) secs = 1;
+
+  switch (ctx->proto) {
+  case PMBENCH_NFV5: proto = "nfv5"; break;
+  case PMBENCH_NFV9: proto = "nfv9"; break;
+  case PMBENCH_IPFIX: proto = "ipfix"; break;
+  default: proto = "sflow5"; break;
+  }
+
+  if (final)
+    fprintf(out, "pmbench: proto=%s exporters=%u templates=%u keys=%u zipf=%.2f dgrams=%llu tpl_dgrams=%llu records=%llu "
+	    "bytes=%llu secs=%.3f dgrams_per_sec=%.0f records_per_sec=%.0f\n", proto, ctx->num_exporters,
+	    ((ctx->proto == PMBENCH_NFV9 || ctx->proto == PMBENCH_IPFIX) ? ctx->num_templates : 0), ctx->keys,
+	    ctx->zipf_s, (unsigned long long) stats->dgrams, (unsigned long long) stats->tpl_dgrams, (unsigned long long) stats->records,
+	    (unsigned long long) stats->bytes, secs, (stats->dgrams / secs), (stats->records / secs));
+  else
+    fprintf(out, "pmbench: %.0f dgrams/s %.0f records/s %.1f Mbps\n", (stats->dgrams / secs),
+	    (stats->records / secs), ((stats->bytes * 8) / secs / 1000000));
+}
+
+static double pmbench_elapsed(struct timeval *from, struct timeval *to)
+{
+  return ((to->tv_sec - from->tv_sec) + ((double)(to->tv_usec - from->tv_usec) / 1000000));
+}
+
+int main(int argc, char **argv)
+{
+  struct pmbench_ctx ctx;
+  struct pmbench_stats last;
+  struct pmbench_exporter *exp;
+  struct timeval last_report;
+  struct in_addr base;
+  u_char buf[PMBENCH_DGRAM_LEN + 64];
+  char *dst_str = NULL, *pcap_file = NULL, *base_str = NULL, *port_str;
+  u_int32_t idx, next;
+  int cp, len, errflag = 0;
+
+  /* getopt() stuff */
+  extern char *optarg;
+  extern int optind, opterr, optopt;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.proto = PMBENCH_NFV9;
+  ctx.num_exporters = 1;
+  ctx.num_templates = 1;
+  ctx.keys = PMBENCH_DEFAULT_KEYS;
+  ctx.refresh = PMBENCH_DEFAULT_REFRESH;
+  ctx.rng = 1;
+  ctx.sock = ERR;
+
+  while (!errflag && ((cp = getopt(argc, argv, ARGS_PMBENCH)) != -1)) {
+    switch (cp) {
+    case 'P':
+      if (!strcmp(optarg, "nfv5")) ctx.proto = PMBENCH_NFV5;
+      else if (!strcmp(optarg, "nfv9")) ctx.proto = PMBENCH_NFV9;
+      else if (!strcmp(optarg, "ipfix")) ctx.proto = PMBENCH_IPFIX;
+      else if (!strcmp(optarg, "sflow5")) ctx.proto = PMBENCH_SFLOW5;
+      else errflag++;
+      break;
+    case 'd':
+      dst_str = optarg;
+      break;
+    case 'w':
+      pcap_file = optarg;
+      break;
+    case 'e':
+      ctx.num_exporters = atoi(optarg);
+      break;
+    case 'b':
+      base_str = optarg;
+      break;
+    case 'T':
+      ctx.num_templates = atoi(optarg);
+      break;
+    case 'k':
+      ctx.keys = strtoul(optarg, NULL, 10);
+      break;
+    case 'z':
+      ctx.zipf_s = atof(optarg);
+      break;
+    case 'r':
+      ctx.max_records = atoi(optarg);
+      break;
+    case 'n':
+      ctx.max_dgrams = strtoull(optarg, NULL, 10);
+      break;
+    case 't':
+      ctx.secs = atoi(optarg);
+      break;
+    case 'R':
+      ctx.refresh = atoi(optarg);
+      break;
+    case 'p':
+      ctx.pps = atoi(optarg);
+      break;
+    case 's':
+      ctx.rng = strtoull(optarg, NULL, 10);
+      if (!ctx.rng) ctx.rng = 1;
+      break;
+    case 'h':
+      usage_pmbench(argv[0]);
+      exit(0);
+    default:
+      errflag++;
+      break;
+    }
+  }
+
+  if (errflag || ctx.num_exporters < 1 || ctx.num_templates < 1 || ctx.num_templates > PMBENCH_MAX_TEMPLATES ||
+      ctx.keys < 1 || ctx.keys > PMBENCH_MAX_KEYS || ctx.zipf_s < 0 || !ctx.refresh) {
+    usage_pmbench(argv[0]);
+    exit(1);
+  }
+
+  /* destination */
+  ctx.dst.sin_family = AF_INET;
+  ctx.dst.sin_port = htons(ctx.proto == PMBENCH_SFLOW5 ? PMBENCH_DEFAULT_SFLOW_PORT : DEFAULT_NFACCTD_PORT);
+  ctx.dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (dst_str) {
+    if ((port_str = strrchr(dst_str, ':'))) {
+      *port_str++ = '\0';
+      ctx.dst.sin_port = htons(atoi(port_str));
+    }
+    if (!inet_aton(dst_str, &ctx.dst.sin_addr)) {
+      fprintf(stderr, "ERROR: invalid destination address '%s'.\n", dst_str);
+      exit(1);
+    }
+  }
+
+  /* exporters: consecutive addresses starting from base */
+  if (!inet_aton((base_str ? base_str : PMBENCH_DEFAULT_BASE_ADDR), &base)) {
+    fprintf(stderr, "ERROR: invalid exporter address '%s'.\n", base_str);
+    exit(1);
+  }
+
+  ctx.exporters = calloc(ctx.num_exporters, sizeof(struct pmbench_exporter));
+  if (!ctx.exporters) {
+    fprintf(stderr, "ERROR: unable to allocate %u exporters.\n", ctx.num_exporters);
+    exit(1);
+  }
+  for (idx = 0; idx < ctx.num_exporters; idx++) ctx.exporters[idx].addr.s_addr = htonl(ntohl(base.s_addr) + idx);
+
+  if (pmbench_zipf_init(&ctx) == ERR) {
+    fprintf(stderr, "ERROR: unable to allocate Zipf distribution for %u keys.\n", ctx.keys);
+    exit(1);
+  }
+
+  if (ctx.proto == PMBENCH_NFV9 || ctx.proto == PMBENCH_IPFIX) pmbench_templates_init(&ctx);
+
+  /* output */
+  if (pcap_file) {
+    ctx.pcap = pcap_open_dead(DLT_EN10MB, 65535);
+    if (ctx.pcap) ctx.dumper = pcap_dump_open(ctx.pcap, pcap_file);
+    if (!ctx.dumper) {
+      fprintf(stderr, "ERROR: unable to open pcap file '%s'.\n", pcap_file);
+      exit(1);
+    }
+
+    if (!ctx.max_dgrams && !ctx.secs) ctx.max_dgrams = PMBENCH_DEFAULT_PCAP_DGRAMS;
+  }
+  else {
+    ctx.sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (ctx.sock < 0) {
+      fprintf(stderr, "ERROR: socket() failed: %s\n", strerror(errno));
+      exit(1);
+    }
+
+    /* on loopback any 127/8 source can be used: one per exporter */
+    if ((ntohl(ctx.dst.sin_addr.s_addr) >> 24) == 127 && (ntohl(base.s_addr) >> 24) == 127) ctx.spoof = TRUE;
+
+    if (!ctx.max_dgrams && !ctx.secs) ctx.secs = PMBENCH_DEFAULT_SECS;
+  }
+
+  gettimeofday(&ctx.start, NULL);
+  ctx.now = ctx.start;
+  last_report = ctx.start;
+  memset(&last, 0, sizeof(last));
+
+  for (idx = 0; ; idx = ((idx + 1) % ctx.num_exporters)) {
+    exp = &ctx.exporters[idx];
+
+    if ((exp->dgrams % ctx.refresh) == 0 && (ctx.proto == PMBENCH_NFV9 || ctx.proto == PMBENCH_IPFIX)) {
+      for (next = 0; next < ctx.num_templates; ) {
+        len = pmbench_build_template(&ctx, exp, buf, &next);
+        if (pmbench_send(&ctx, exp, buf, len) == ERR) exit(1);
+        ctx.stats.tpl_dgrams++;
+      }
+    }
+
+    switch (ctx.proto) {
+    case PMBENCH_NFV5:
+      len = pmbench_build_nfv5(&ctx, exp, buf);
+      break;
+    case PMBENCH_SFLOW5:
+      len = pmbench_build_sflow5(&ctx, exp, buf);
+      break;
+    default:
+      len = pmbench_build_data(&ctx, exp, buf);
+      break;
+    }
+
+    if (pmbench_send(&ctx, exp, buf, len) == ERR) exit(1);
+
+    if (ctx.max_dgrams && ctx.stats.dgrams >= ctx.max_dgrams) break;
+
+    /* clock is checked once in a while */
+    if (!(ctx.stats.dgrams & 0xFF) || ctx.pps) {
+      gettimeofday(&ctx.now, NULL);
+
+      if (ctx.secs && pmbench_elapsed(&ctx.start, &ctx.now) >= ctx.secs) break;
+
+      if (ctx.pps) {
+        double ahead = ((double) ctx.stats.dgrams / ctx.pps) - pmbench_elapsed(&ctx.start, &ctx.now);
+
+        if (ahead > 0.001) usleep(ahead * 1000000);
+      }
+
+      if (ctx.now.tv_sec > last_report.tv_sec && !ctx.dumper) {
+        struct pmbench_stats delta;
+
+        delta.dgrams = (ctx.stats.dgrams - last.dgrams);
+        delta.records = (ctx.stats.records - last.records);
+        delta.bytes = (ctx.stats.bytes - last.bytes);
+        pmbench_report(&ctx, &delta, pmbench_elapsed(&last_report, &ctx.now), stderr, FALSE);
+
+        last = ctx.stats;
+        last_report = ctx.now;
+      }
+    }
+  }
+
+  gettimeofday(&ctx.now, NULL);
+  pmbench_report(&ctx, &ctx.stats, pmbench_elapsed(&ctx.start, &ctx.now), stdout, TRUE);
+
+  if (ctx.dumper) {
+    pcap_dump_close(ctx.dumper);
+    pcap_close(ctx.pcap);
+  }
+  if (ctx.sock >= 0) close(ctx.sock);
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* defines */
+#define PMBENCH_NFV5			5
+#define PMBENCH_NFV9			9
+#define PMBENCH_IPFIX			10
+#define PMBENCH_SFLOW5			105
+#define PMBENCH_DGRAM_LEN		1400	/* max payload per datagram */
+#define PMBENCH_MAX_TEMPLATES		512	/* one per combination of optional fields */
+#define PMBENCH_MAX_FIELDS		18
+#define PMBENCH_DEFAULT_KEYS		100000
+#define PMBENCH_DEFAULT_REFRESH		100	/* datagrams between template refreshes */
+#define PMBENCH_DEFAULT_SECS		10
+#define PMBENCH_DEFAULT_PCAP_DGRAMS	100000
+#define PMBENCH_DEFAULT_BASE_ADDR	"127.0.1.1"
+#define PMBENCH_DEFAULT_SFLOW_PORT	6343	/* sfacctd default */
+#define PMBENCH_MAX_KEYS		50000000
+
+/* structures */
+struct pmbench_field {
+  u_int16_t type;
+  u_int16_t len;
+};
+
+struct pmbench_template {
+  u_int16_t id;
+  u_int16_t num;
+  u_int16_t rec_len;
+  struct pmbench_field fields[PMBENCH_MAX_FIELDS];
+};
+
+struct pmbench_exporter {
+  struct in_addr addr;
+  u_int32_t seq;		/* datagrams (NetFlow v9, sFlow) */
+  u_int32_t flows;		/* records (NetFlow v5, IPFIX) */
+  u_int64_t dgrams;
+};
+
+struct pmbench_flow {
+  u_int32_t src;
+  u_int32_t dst;
+  u_int32_t nexthop;
+  u_int32_t src_as;
+  u_int32_t dst_as;
+  u_int32_t pkts;
+  u_int32_t bytes;
+  u_int32_t first;
+  u_int32_t last;
+  u_int16_t sport;
+  u_int16_t dport;
+  u_int16_t input;
+  u_int16_t output;
+  u_int8_t proto;
+  u_int8_t tos;
+  u_int8_t tcp_flags;
+  u_int8_t src_mask;
+  u_int8_t dst_mask;
+};
+
+struct pmbench_stats {
+  u_int64_t dgrams;
+  u_int64_t records;
+  u_int64_t bytes;
+  u_int64_t tpl_dgrams;
+};
+
+struct pmbench_ctx {
+  int proto;
+  struct sockaddr_in dst;
+  int sock;
+  int spoof;			/* set source address via IP_PKTINFO */
+  pcap_t *pcap;
+  pcap_dumper_t *dumper;
+  struct pmbench_exporter *exporters;
+  u_int32_t num_exporters;
+  struct pmbench_template templates[PMBENCH_MAX_TEMPLATES];
+  u_int32_t num_templates;
+  u_int32_t keys;
+  double zipf_s;
+  double *zipf_cdf;
+  u_int32_t max_records;
+  u_int64_t max_dgrams;
+  u_int32_t secs;
+  u_int32_t refresh;
+  u_int32_t pps;
+  u_int64_t rng;
+  struct timeval start;
+  struct timeval now;
+  struct pmbench_stats stats;
+};
+
+/* prototypes */
+#if (!defined __PMBENCH_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT void usage_pmbench(char *);
+EXT u_int64_t pmbench_rand(struct pmbench_ctx *);
+EXT int pmbench_zipf_init(struct pmbench_ctx *);
+EXT u_int32_t pmbench_key(struct pmbench_ctx *);
+EXT void pmbench_flow(struct pmbench_ctx *, u_int32_t, struct pmbench_flow *);
+EXT void pmbench_templates_init(struct pmbench_ctx *);
+EXT int pmbench_build_nfv5(struct pmbench_ctx *, struct pmbench_exporter *, u_char *);
+EXT int pmbench_build_template(struct pmbench_ctx *, struct pmbench_exporter *, u_char *, u_int32_t *);
+EXT int pmbench_build_data(struct pmbench_ctx *, struct pmbench_exporter *, u_char *);
+EXT int pmbench_build_sflow5(struct pmbench_ctx *, struct pmbench_exporter *, u_char *);
+EXT int pmbench_send(struct pmbench_ctx *, struct pmbench_exporter *, u_char *, int);
+EXT void pmbench_report(struct pmbench_ctx *, struct pmbench_stats *, double, FILE *, int);
+#undef EXT
@@ -33,6 +33,7 @@
 #include "isis/isis.h"
 #include "isis/isis-data.h"
 #include "crc32.h"
+#include "jhash.h"
 #include "pmacct-data.h"
 
 /*
@@ -117,7 +118,6 @@ void load_id_file(int acct_type, char *filename, struct id_table *t, struct plug
 	}
 	for (index = 0; index < t->num; index++) {
 	  pcap_freecode(&t->e[index].key.filter);
-	  pretag_free_label(&t->e[index].label);
 	}
 
         memset(t, 0, sizeof(struct id_table));
@@ -707,8 +707,8 @@ void pretag_init_vars(struct packet_ptrs *pptrs, struct id_table *t)
   if (t->type == ACCT_NF) memset(&pptrs->set_tos, 0, sizeof(s_uint8_t));
   if (t->type == MAP_BGP_TO_XFLOW_AGENT) memset(&pptrs->lookup_bgp_port, 0, sizeof(s_uint16_t));
 
-  if (pptrs->label.val) {
-    pretag_free_label(&pptrs->label);
+  if (pptrs->label.id) {
+    pretag_init_label(&pptrs->label);
     pptrs->have_label = FALSE;
   }
 }
@@ -720,65 +720,126 @@ void pretag_init_label(pt_label_t *label)
   memset(label, 0, sizeof(pt_label_t));
 }
 
-int pretag_malloc_label(pt_label_t *label, int len)
+int pretag_label_table_init()
 {
-  if (!label) return ERR;
+  char *base;
+  size_t size;
 
-  label->val = malloc(len);
-  if (!label->val) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (pretag_malloc_label).\n", config.name, config.type);
+  if (pt_labels) return SUCCESS;
+
+  size = sizeof(struct pretag_label_table) + (PRETAG_LABEL_TABLE_BUCKETS * sizeof(u_int32_t)) +
+	 (PRETAG_LABEL_TABLE_ENTRIES * sizeof(struct pretag_label_entry)) + PRETAG_LABEL_TABLE_POOL;
+
+  base = map_shared(0, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate labels table (pretag_label_table_init).\n", config.name, config.type);
     return ERR;
   }
-  label->len = len;
+
+  pt_labels = (struct pretag_label_table *) base;
+  pt_labels->buckets = (u_int32_t *) (base + sizeof(struct pretag_label_table));
+  pt_labels->e = (struct pretag_label_entry *) (pt_labels->buckets + PRETAG_LABEL_TABLE_BUCKETS);
+  pt_labels->pool = (char *) (pt_labels->e + PRETAG_LABEL_TABLE_ENTRIES);
+  pt_labels->num = 1;
+  pt_labels->pool_len = 0;
 
   return SUCCESS;
 }
 
-int pretag_realloc_label(pt_label_t *label, int len)
+/* len does not include the terminating null; label gets a reference into the table */
+int pretag_label_intern(char *str, u_int32_t len, pt_label_t *label)
 {
-  if (!label) return ERR;
+  struct pretag_label_entry *e;
+  u_int32_t bucket, id;
+  static int warned = FALSE;
 
-  label->val = realloc(label->val, len);
-  if (!label->val) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (pretag_realloc_label).\n", config.name, config.type);
-    return ERR;
+  if (!str || !label) return ERR;
+  if (!pt_labels && pretag_label_table_init()) return ERR;
+
+  bucket = jhash(str, len, 0) & (PRETAG_LABEL_TABLE_BUCKETS - 1);
+  for (id = pt_labels->buckets[bucket]; id; id = pt_labels->e[id].next) {
+    e = &pt_labels->e[id];
+    if (e->len == (len + 1) && !memcmp(pt_labels->pool + e->off, str, len)) break;
   }
-  label->len = len;
+
+  if (!id) {
+    if (pt_labels->num >= PRETAG_LABEL_TABLE_ENTRIES || (pt_labels->pool_len + len + 1) > PRETAG_LABEL_TABLE_POOL) {
+      if (!warned) {
+        Log(LOG_WARNING, "WARN ( %s/%s ): labels table is full (pretag_label_intern).\n", config.name, config.type);
+        warned = TRUE;
+      }
+      return ERR;
+    }
+
+    id = pt_labels->num;
+    e = &pt_labels->e[id];
+    e->off = pt_labels->pool_len;
+    e->len = (len + 1);
+    memcpy(pt_labels->pool + e->off, str, len);
+    pt_labels->pool[e->off + len] = '\0';
+    e->next = pt_labels->buckets[bucket];
+
+    pt_labels->buckets[bucket] = id;
+    pt_labels->pool_len += e->len;
+    pt_labels->num++;
+  }
+
+  label->id = id;
+  label->val = pt_labels->pool + pt_labels->e[id].off;
+  label->len = pt_labels->e[id].len;
 
   return SUCCESS;
 }
 
-int pretag_copy_label(pt_label_t *dst, pt_label_t *src)
+/* appends 'add' to 'label' with the default separator; results are cached per id pair */
+int pretag_label_stack(pt_label_t *label, pt_label_t *add)
 {
-  if (!src || !dst) return ERR;
+  static struct pretag_label_stack_entry cache[PRETAG_LABEL_STACK_CACHE];
+  struct pretag_label_stack_entry *ce;
+  char buf[LARGEBUFLEN];
+  u_int32_t base;
+  int len;
 
-  if (dst->val) {
-    Log(LOG_WARNING, "WARN ( %s/%s ): pretag_copy_label failed: dst->val not null\n", config.name, config.type);
-    return ERR;
-  }
-  else {
-    if (src->len) {
-      pretag_malloc_label(dst, src->len);
-      if (!dst->val) {
-        Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (pretag_copy_label).\n", config.name, config.type);
-        return ERR;
-      }
+  if (!label || !add || !pt_labels) return ERR;
 
-      strncpy(dst->val, src->val, src->len);
-      dst->val[dst->len] = '\0';
-    }
+  ce = &cache[jhash_2words(label->id, add->id, 0) & (PRETAG_LABEL_STACK_CACHE - 1)];
+  if (ce->res && ce->base == label->id && ce->add == add->id) {
+    label->id = ce->res;
+    label->val = pt_labels->pool + pt_labels->e[ce->res].off;
+    label->len = pt_labels->e[ce->res].len;
+
+    return SUCCESS;
   }
-  
+
+  len = snprintf(buf, sizeof(buf), "%s,%s", label->val, add->val);
+  if (len >= sizeof(buf)) return ERR;
+
+  base = label->id;
+  if (pretag_label_intern(buf, len, label)) return ERR;
+
+  ce->base = base;
+  ce->add = add->id;
+  ce->res = label->id;
+
   return SUCCESS;
 }
 
-void pretag_free_label(pt_label_t *label)
+char *pretag_label_resolve(u_int32_t id)
 {
-  if (label && label->val) {
-    free(label->val); 
-    label->val = NULL;
-    label->len = 0;
-  }
+  if (!pt_labels || !id || id >= pt_labels->num) return NULL;
+
+  return (pt_labels->pool + pt_labels->e[id].off);
+}
+
+/* a label supplied by flow data travels as a variable-length primitive and wins */
+char *pretag_label_get(struct pkt_primitives *prim, struct pkt_vlen_hdr_primitives *pvlen)
+{
+  char *str = NULL;
+
+  vlen_prims_get(pvlen, COUNT_INT_LABEL, &str);
+  if (!str && prim) str = pretag_label_resolve(prim->label_id);
+
+  return str;
 }
 
 int pretag_entry_process(struct id_entry *e, struct packet_ptrs *pptrs, pm_id_t *tag, pm_id_t *tag2)
@@ -815,18 +876,9 @@ int pretag_entry_process(struct id_entry *e, struct packet_ptrs *pptrs, pm_id_t
     else if (stop & PRETAG_MAP_RCODE_LABEL) {
       /* auto-stacking if value exists */
       if (pptrs->label.len) {
-	char default_sep[] = ",";
-
-        if (pretag_realloc_label(&pptrs->label, label_local.len + pptrs->label.len + 1 /* sep */ + 1 /* null */)) return TRUE;
-	strncat(pptrs->label.val, default_sep, 1);
-        strncat(pptrs->label.val, label_local.val, label_local.len);
-        pptrs->label.val[pptrs->label.len] = '\0';
-      }
-      else {
-	if (pretag_malloc_label(&pptrs->label, label_local.len + 1 /* null */)) return TRUE;
-	strncpy(pptrs->label.val, label_local.val, label_local.len);
-	pptrs->label.val[pptrs->label.len] = '\0';
+        if (pretag_label_stack(&pptrs->label, &label_local)) return TRUE;
       }
+      else pptrs->label = label_local;
 
       pptrs->have_label = TRUE;
     }
@@ -844,7 +896,7 @@ int pretag_entry_process(struct id_entry *e, struct packet_ptrs *pptrs, pm_id_t
 	set_shadow_status(pptrs);
 	*tag = 0;
 	*tag2 = 0;
-	if (pptrs->label.val) pretag_free_label(&pptrs->label);
+	pretag_init_label(&pptrs->label);
 
 	pptrs->have_tag = FALSE;
 	pptrs->have_tag2 = FALSE;
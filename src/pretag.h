@@ -249,6 +249,37 @@ struct pretag_label_filter {
   ptlt_t table[MAX_PRETAG_MAP_ENTRIES/4];
 };
 
+/*
+   Labels are interned, append-only, into a table mapped shared before
+   plugins are forked: the core hands out label ids, plugins resolve them
+   back to strings when writing out. Ids are never recycled, so a map
+   reload can't invalidate an id still travelling through a ring.
+*/
+#define PRETAG_LABEL_TABLE_ENTRIES	65536
+#define PRETAG_LABEL_TABLE_POOL		(4*1024*1024)
+#define PRETAG_LABEL_TABLE_BUCKETS	16384	/* power of 2 */
+#define PRETAG_LABEL_STACK_CACHE	256	/* power of 2 */
+
+struct pretag_label_entry {
+  u_int32_t off;		/* into the strings pool */
+  u_int32_t len;		/* including the terminating null */
+  u_int32_t next;		/* hash chaining */
+};
+
+struct pretag_label_table {
+  u_int32_t num;		/* id 0 is reserved: no label */
+  u_int32_t pool_len;
+  u_int32_t *buckets;
+  struct pretag_label_entry *e;
+  char *pool;
+};
+
+struct pretag_label_stack_entry {
+  u_int32_t base;
+  u_int32_t add;
+  u_int32_t res;
+};
+
 /* prototypes */
 #if (!defined __PRETAG_C)
 #define EXT extern
@@ -261,10 +292,11 @@ EXT u_int8_t pt_check_neg(char **, u_int32_t *);
 EXT char * pt_check_range(char *);
 EXT void pretag_init_vars(struct packet_ptrs *, struct id_table *);
 EXT void pretag_init_label(pt_label_t *);
-EXT int pretag_malloc_label(pt_label_t *, int);
-EXT int pretag_realloc_label(pt_label_t *, int);
-EXT int pretag_copy_label(pt_label_t *, pt_label_t *);
-EXT void pretag_free_label(pt_label_t *);
+EXT int pretag_label_table_init();
+EXT int pretag_label_intern(char *, u_int32_t, pt_label_t *);
+EXT int pretag_label_stack(pt_label_t *, pt_label_t *);
+EXT char *pretag_label_resolve(u_int32_t);
+EXT char *pretag_label_get(struct pkt_primitives *, struct pkt_vlen_hdr_primitives *);
 EXT int pretag_entry_process(struct id_entry *, struct packet_ptrs *, pm_id_t *, pm_id_t *);
 EXT pt_bitmap_t pretag_index_build_bitmap(struct id_entry *, int);
 EXT int pretag_index_insert_bitmap(struct id_table *, pt_bitmap_t);
@@ -292,4 +324,5 @@ EXT int bta_map_caching;
 EXT int sampling_map_caching; 
 
 EXT int (*find_id_func)(struct id_table *, struct packet_ptrs *, pm_id_t *, pm_id_t *);
+EXT struct pretag_label_table *pt_labels;
 #undef EXT
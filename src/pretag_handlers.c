@@ -161,13 +161,10 @@ int PT_map_label_handler(char *filename, struct id_entry *e, char *value, struct
 
   len = strlen(value);
   if (!strchr(value, default_sep)) {
-    if (pretag_malloc_label(&e->label, len + 1 /* null */)) return TRUE;
-    strcpy(e->label.val, value);
-    e->label.val[e->label.len] = '\0';
+    if (pretag_label_intern(value, len, &e->label)) return TRUE;
   }
   else {
-    e->label.val = NULL;
-    e->label.len = 0;
+    pretag_init_label(&e->label);
 
     Log(LOG_WARNING, "WARN ( %s/%s ): [%s] Invalid set_label specified.\n", config.name, config.type, filename);
     return TRUE;
@@ -55,6 +55,7 @@ void print_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   u_int32_t bufsz = ((struct channels_list_entry *)ptr)->bufsize;
   pid_t core_pid = ((struct channels_list_entry *)ptr)->core_pid;
   struct networks_file_data nfd;
+  struct timespec stats_ts;
   char default_separator[] = ",";
 
   unsigned char *rgptr;
@@ -296,8 +297,10 @@ void print_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	for (num = 0; primptrs_funcs[num]; num++)
 	  (*primptrs_funcs[num])((u_char *)data, &extras, &prim_ptrs);
 
+	if (net_funcs[0]) STATS_START(stats_ts);
 	for (num = 0; net_funcs[num]; num++)
 	  (*net_funcs[num])(&nt, &nc, &data->primitives, prim_ptrs.pbgp, &nfd);
+	if (net_funcs[0]) STATS_STOP(STATS_NET, stats_ts);
 
 	if (config.ports_file) {
           if (!pt.table[data->primitives.src_port]) data->primitives.src_port = 0;
@@ -309,7 +312,9 @@ void print_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
           evaluate_pkt_len_distrib(data);
 
         prim_ptrs.data = data;
+        STATS_START(stats_ts);
         (*insert_func)(&prim_ptrs, &idata);
+        STATS_STOP(STATS_INSERT, stats_ts);
 
 	((struct ch_buf_hdr *)pipebuf)->num--;
         if (((struct ch_buf_hdr *)pipebuf)->num) {
@@ -328,30 +333,26 @@ void print_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 
 void P_cache_purge(struct chained_cache *queue[], int index, int safe_action)
 {
-  struct pkt_primitives *data = NULL;
-  struct pkt_bgp_primitives *pbgp = NULL;
-  struct pkt_nat_primitives *pnat = NULL;
-  struct pkt_mpls_primitives *pmpls = NULL;
-  struct pkt_tunnel_primitives *ptun = NULL;
-  char *pcust = NULL;
-  struct pkt_vlen_hdr_primitives *pvlen = NULL;
-  struct pkt_bgp_primitives empty_pbgp;
-  struct pkt_nat_primitives empty_pnat;
-  struct pkt_mpls_primitives empty_pmpls;
-  struct pkt_tunnel_primitives empty_ptun;
-  char *empty_pcust = NULL;
-  char src_mac[18], dst_mac[18], src_host[INET6_ADDRSTRLEN], dst_host[INET6_ADDRSTRLEN], ip_address[INET6_ADDRSTRLEN];
-  char rd_str[SRVBUFLEN], *sep = config.print_output_separator, *fd_buf;
-  char *as_path, *bgp_comm, empty_string[] = "", empty_aspath[] = "^$", empty_ip4[] = "0.0.0.0", empty_ip6[] = "::";
-  char empty_macaddress[] = "00:00:00:00:00:00", empty_rd[] = "0:0", ndpi_class[SUPERSHORTBUFLEN];
+  struct print_purge_empty empty;
+  char *fd_buf;
   FILE *f = NULL, *lockf = NULL;
   int j, stop, is_event = FALSE, qn = 0, go_to_pending, saved_index = index, file_to_be_created;
+  int pq_ptr, purge_threads = FALSE;
   time_t start, duration;
   char tmpbuf[LONGLONGSRVBUFLEN], current_table[SRVBUFLEN], elem_table[SRVBUFLEN];
   struct primitives_ptrs prim_ptrs, elem_prim_ptrs;
   struct pkt_data dummy_data, elem_dummy_data;
   pid_t writer_pid = getpid();
+#if defined ENABLE_THREADS && defined HAVE_OPEN_MEMSTREAM
+  struct print_purge_threads ppt;
+#endif
 #ifdef WITH_AVRO
+  struct pkt_bgp_primitives *pbgp = NULL;
+  struct pkt_nat_primitives *pnat = NULL;
+  struct pkt_mpls_primitives *pmpls = NULL;
+  struct pkt_tunnel_primitives *ptun = NULL;
+  char *pcust = NULL;
+  struct pkt_vlen_hdr_primitives *pvlen = NULL;
   avro_file_writer_t avro_writer;
 #endif
 
@@ -361,17 +362,15 @@ void P_cache_purge(struct chained_cache *queue[], int index, int safe_action)
     return;
   }
 
-  empty_pcust = malloc(config.cpptrs.len);
-  if (!empty_pcust) {
+  memset(&empty, 0, sizeof(empty));
+
+  empty.pcust = malloc(config.cpptrs.len);
+  if (!empty.pcust) {
     Log(LOG_ERR, "ERROR ( %s/%s ): Unable to malloc() empty_pcust. Exiting.\n", config.name, config.type);
     exit_plugin(1);
   }
 
-  memset(&empty_pbgp, 0, sizeof(struct pkt_bgp_primitives));
-  memset(&empty_pnat, 0, sizeof(struct pkt_nat_primitives));
-  memset(&empty_pmpls, 0, sizeof(struct pkt_mpls_primitives));
-  memset(&empty_ptun, 0, sizeof(struct pkt_tunnel_primitives));
-  memset(empty_pcust, 0, config.cpptrs.len);
+  memset(empty.pcust, 0, config.cpptrs.len);
   memset(&prim_ptrs, 0, sizeof(prim_ptrs));
   memset(&dummy_data, 0, sizeof(dummy_data));
   memset(&elem_prim_ptrs, 0, sizeof(elem_prim_ptrs));
@@ -385,6 +384,14 @@ void P_cache_purge(struct chained_cache *queue[], int index, int safe_action)
   memcpy(pending_queries_queue, queue, index*sizeof(struct db_cache *));
   pqq_ptr = index;
 
+  if (config.print_output_threads > 1 && (config.print_output & (PRINT_OUTPUT_FORMATTED|PRINT_OUTPUT_CSV|PRINT_OUTPUT_JSON))) {
+#if defined ENABLE_THREADS && defined HAVE_OPEN_MEMSTREAM
+    if (!P_cache_purge_threads_init(&ppt, &empty)) purge_threads = TRUE;
+#else
+    Log(LOG_WARNING, "WARN ( %s/%s ): print_output_threads not supported (requires --enable-threads and open_memstream()). Ignored.\n", config.name, config.type);
+#endif
+  }
+
   Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - START (PID: %u) ***\n", config.name, config.type, writer_pid);
   start = time(NULL);
 
@@ -495,8 +502,7 @@ void P_cache_purge(struct chained_cache *queue[], int index, int safe_action)
     }
   }
 
-  for (j = 0; j < index; j++) {
-    int count = 0;
+  for (j = 0, pq_ptr = 0; j < index; j++) {
     go_to_pending = FALSE;
 
     if (queue[j]->valid != PRINT_CACHE_COMMITTED) continue;
@@ -524,880 +530,1085 @@ void P_cache_purge(struct chained_cache *queue[], int index, int safe_action)
     if (!go_to_pending) {
       qn++;
 
-      data = &queue[j]->primitives;
-      if (queue[j]->pbgp) pbgp = queue[j]->pbgp;
-      else pbgp = &empty_pbgp;
-  
-      if (queue[j]->pnat) pnat = queue[j]->pnat;
-      else pnat = &empty_pnat;
-  
-      if (queue[j]->pmpls) pmpls = queue[j]->pmpls;
-      else pmpls = &empty_pmpls;
-
-      if (queue[j]->ptun) ptun = queue[j]->ptun;
-      else ptun = &empty_ptun;
-  
-      if (queue[j]->pcust) pcust = queue[j]->pcust;
-      else pcust = empty_pcust;
-
-      if (queue[j]->pvlen) pvlen = queue[j]->pvlen;
-      else pvlen = NULL;
-  
       if (queue[j]->valid == PRINT_CACHE_FREE) continue;
   
-      if (f && config.print_output & PRINT_OUTPUT_FORMATTED) {
-        if (config.what_to_count & COUNT_TAG) fprintf(f, "%-10llu  ", data->tag);
-        if (config.what_to_count & COUNT_TAG2) fprintf(f, "%-10llu  ", data->tag2);
-        if (config.what_to_count & COUNT_CLASS) fprintf(f, "%-16s  ", ((data->class && class[(data->class)-1].id) ? class[(data->class)-1].protocol : "unknown" ));
-  #if defined (WITH_NDPI)
-	if (config.what_to_count_2 & COUNT_NDPI_CLASS) {
-	  snprintf(ndpi_class, SUPERSHORTBUFLEN, "%s/%s",
-		ndpi_get_proto_name(pm_ndpi_wfl->ndpi_struct, data->ndpi_class.master_protocol),
-		ndpi_get_proto_name(pm_ndpi_wfl->ndpi_struct, data->ndpi_class.app_protocol));
-	  fprintf(f, "%-16s  ", ndpi_class);
+      if (f && (config.print_output & (PRINT_OUTPUT_FORMATTED|PRINT_OUTPUT_CSV|PRINT_OUTPUT_JSON))) {
+	/* compacting entries to be written at the head of the queue; they
+	   are formatted in parallel by P_cache_purge_threads() below */
+	if (purge_threads) {
+	  queue[pq_ptr] = queue[j];
+	  pq_ptr++;
 	}
-  #endif
-  #if defined HAVE_L2
-        if (config.what_to_count & (COUNT_SRC_MAC|COUNT_SUM_MAC)) {
-          etheraddr_string(data->eth_shost, src_mac);
-  	if (strlen(src_mac))
-            fprintf(f, "%-17s  ", src_mac);
-          else
-            fprintf(f, "%-17s  ", empty_macaddress);
-        }
-        if (config.what_to_count & COUNT_DST_MAC) {
-          etheraddr_string(data->eth_dhost, dst_mac);
-  	if (strlen(dst_mac))
-            fprintf(f, "%-17s  ", dst_mac);
-  	else
-            fprintf(f, "%-17s  ", empty_macaddress);
-        }
-        if (config.what_to_count & COUNT_VLAN) fprintf(f, "%-5u  ", data->vlan_id); 
-        if (config.what_to_count & COUNT_COS) fprintf(f, "%-2u  ", data->cos); 
-        if (config.what_to_count & COUNT_ETHERTYPE) fprintf(f, "%-5x  ", data->etype); 
-  #endif
-        if (config.what_to_count & (COUNT_SRC_AS|COUNT_SUM_AS)) fprintf(f, "%-10u  ", data->src_as); 
-        if (config.what_to_count & COUNT_DST_AS) fprintf(f, "%-10u  ", data->dst_as); 
-  
-        if (config.what_to_count & COUNT_LOCAL_PREF) fprintf(f, "%-7u  ", pbgp->local_pref);
-        if (config.what_to_count & COUNT_SRC_LOCAL_PREF) fprintf(f, "%-7u  ", pbgp->src_local_pref);
-        if (config.what_to_count & COUNT_MED) fprintf(f, "%-6u  ", pbgp->med);
-        if (config.what_to_count & COUNT_SRC_MED) fprintf(f, "%-6u  ", pbgp->src_med);
+	else P_cache_purge_entry(f, queue[j], &empty, is_event);
+      }
+      else if (f && config.print_output & PRINT_OUTPUT_AVRO) {
+#ifdef WITH_AVRO
+        if (queue[j]->pbgp) pbgp = queue[j]->pbgp;
+        else pbgp = &empty.pbgp;
 
-        if (config.what_to_count & COUNT_PEER_SRC_AS) fprintf(f, "%-10u  ", pbgp->peer_src_as);
-        if (config.what_to_count & COUNT_PEER_DST_AS) fprintf(f, "%-10u  ", pbgp->peer_dst_as);
-  
-        if (config.what_to_count & COUNT_PEER_SRC_IP) {
-          addr_to_str(ip_address, &pbgp->peer_src_ip);
-  #if defined ENABLE_IPV6
-          if (strlen(ip_address))
-            fprintf(f, "%-45s  ", ip_address);
-  	else
-            fprintf(f, "%-45s  ", empty_ip6);
-  #else
-  	if (strlen(ip_address))
-            fprintf(f, "%-15s  ", ip_address);
-  	else
-            fprintf(f, "%-15s  ", empty_ip4);
-  #endif
-        }
-        if (config.what_to_count & COUNT_PEER_DST_IP) {
-          addr_to_str(ip_address, &pbgp->peer_dst_ip);
-  #if defined ENABLE_IPV6
-          if (strlen(ip_address))
-            fprintf(f, "%-45s  ", ip_address);
-          else
-            fprintf(f, "%-45s  ", empty_ip6);
-  #else
-          if (strlen(ip_address))
-            fprintf(f, "%-15s  ", ip_address);
-          else 
-            fprintf(f, "%-15s  ", empty_ip4);
-  #endif
-        }
-  
-        if (config.what_to_count & COUNT_IN_IFACE) fprintf(f, "%-10u  ", data->ifindex_in);
-        if (config.what_to_count & COUNT_OUT_IFACE) fprintf(f, "%-10u  ", data->ifindex_out);
-  
-        if (config.what_to_count & COUNT_MPLS_VPN_RD) {
-          bgp_rd2str(rd_str, &pbgp->mpls_vpn_rd);
-  	if (strlen(rd_str))
-            fprintf(f, "%-18s  ", rd_str);
-  	else
-            fprintf(f, "%-18s  ", empty_rd);
-        }
-  
-        if (config.what_to_count & (COUNT_SRC_HOST|COUNT_SUM_HOST)) {
-          addr_to_str(src_host, &data->src_ip);
-  #if defined ENABLE_IPV6
-  	if (strlen(src_host))
-            fprintf(f, "%-45s  ", src_host);
-  	else
-            fprintf(f, "%-45s  ", empty_ip6);
-  #else
-  	if (strlen(src_host))
-            fprintf(f, "%-15s  ", src_host);
-  	else
-            fprintf(f, "%-15s  ", empty_ip4);
-  #endif
-        }
+        if (queue[j]->pnat) pnat = queue[j]->pnat;
+        else pnat = &empty.pnat;
 
-        if (config.what_to_count & (COUNT_SRC_NET|COUNT_SUM_NET)) {
-          addr_to_str(src_host, &data->src_net);
-  #if defined ENABLE_IPV6
-        if (strlen(src_host))
-            fprintf(f, "%-45s  ", src_host);
-        else
-            fprintf(f, "%-45s  ", empty_ip6);
-  #else
-        if (strlen(src_host))
-            fprintf(f, "%-15s  ", src_host);
-        else
-            fprintf(f, "%-15s  ", empty_ip4);
-  #endif
-        }
+        if (queue[j]->pmpls) pmpls = queue[j]->pmpls;
+        else pmpls = &empty.pmpls;
 
-        if (config.what_to_count & COUNT_DST_HOST) {
-          addr_to_str(dst_host, &data->dst_ip);
-  #if defined ENABLE_IPV6
-  	if (strlen(dst_host))
-            fprintf(f, "%-45s  ", dst_host);
-  	else
-            fprintf(f, "%-45s  ", empty_ip6);
-  #else
-  	if (strlen(dst_host))
-            fprintf(f, "%-15s  ", dst_host);
-  	else
-            fprintf(f, "%-15s  ", empty_ip4);
-  #endif
-        }
+        if (queue[j]->ptun) ptun = queue[j]->ptun;
+        else ptun = &empty.ptun;
 
-        if (config.what_to_count & COUNT_DST_NET) {
-          addr_to_str(dst_host, &data->dst_net);
-  #if defined ENABLE_IPV6
-        if (strlen(dst_host))
-            fprintf(f, "%-45s  ", dst_host);
-        else
-            fprintf(f, "%-45s  ", empty_ip6);
-  #else
-        if (strlen(dst_host))
-            fprintf(f, "%-15s  ", dst_host);
-        else
-            fprintf(f, "%-15s  ", empty_ip4);
-  #endif
-        }
+        if (queue[j]->pcust) pcust = queue[j]->pcust;
+        else pcust = empty.pcust;
 
-        if (config.what_to_count & COUNT_SRC_NMASK) fprintf(f, "%-3u       ", data->src_nmask);
-        if (config.what_to_count & COUNT_DST_NMASK) fprintf(f, "%-3u       ", data->dst_nmask);
-        if (config.what_to_count & (COUNT_SRC_PORT|COUNT_SUM_PORT)) fprintf(f, "%-5u     ", data->src_port);
-        if (config.what_to_count & COUNT_DST_PORT) fprintf(f, "%-5u     ", data->dst_port);
-        if (config.what_to_count & COUNT_TCPFLAGS) fprintf(f, "%-3u        ", queue[j]->tcp_flags);
-  
-        if (config.what_to_count & COUNT_IP_PROTO) {
-          if (!config.num_protos && (data->proto < protocols_number))
-	    fprintf(f, "%-10s  ", _protocols[data->proto].name);
-          else
-	    fprintf(f, "%-10d  ", data->proto);
-        }
-  
-        if (config.what_to_count & COUNT_IP_TOS) fprintf(f, "%-3u    ", data->tos);
-  
-  #if defined WITH_GEOIP
-        if (config.what_to_count_2 & COUNT_SRC_HOST_COUNTRY) fprintf(f, "%-5s       ", GeoIP_code_by_id(data->src_ip_country.id));
-        if (config.what_to_count_2 & COUNT_DST_HOST_COUNTRY) fprintf(f, "%-5s       ", GeoIP_code_by_id(data->dst_ip_country.id));
-  #endif
-  #if defined WITH_GEOIPV2
-        if (config.what_to_count_2 & COUNT_SRC_HOST_COUNTRY) fprintf(f, "%-5s       ", data->src_ip_country.str);
-        if (config.what_to_count_2 & COUNT_DST_HOST_COUNTRY) fprintf(f, "%-5s       ", data->dst_ip_country.str);
-        if (config.what_to_count_2 & COUNT_SRC_HOST_POCODE) fprintf(f, "%-12s  ", data->src_ip_pocode.str);
-        if (config.what_to_count_2 & COUNT_DST_HOST_POCODE) fprintf(f, "%-12s  ", data->dst_ip_pocode.str);
-  #endif
-  
-        if (config.what_to_count_2 & COUNT_SAMPLING_RATE) fprintf(f, "%-7u       ", data->sampling_rate);
-        if (config.what_to_count_2 & COUNT_PKT_LEN_DISTRIB) fprintf(f, "%-10s      ", config.pkt_len_distrib_bins[data->pkt_len_distrib]);
-  
-        if (config.what_to_count_2 & COUNT_POST_NAT_SRC_HOST) {
-          addr_to_str(ip_address, &pnat->post_nat_src_ip);
-  
-  #if defined ENABLE_IPV6
-          if (strlen(ip_address))
-            fprintf(f, "%-45s  ", ip_address);
-          else
-            fprintf(f, "%-45s  ", empty_ip6);
-  #else
-          if (strlen(ip_address))
-            fprintf(f, "%-15s  ", ip_address);
-          else
-            fprintf(f, "%-15s  ", empty_ip4);
-  #endif
-        }
-  
-        if (config.what_to_count_2 & COUNT_POST_NAT_DST_HOST) {
-          addr_to_str(ip_address, &pnat->post_nat_dst_ip);
-  
-  #if defined ENABLE_IPV6
-          if (strlen(ip_address))
-            fprintf(f, "%-45s  ", ip_address);
-          else
-            fprintf(f, "%-45s  ", empty_ip6);
-  #else 
-          if (strlen(ip_address))
-            fprintf(f, "%-15s  ", ip_address);
-          else
-            fprintf(f, "%-15s  ", empty_ip4);
-  #endif
-        }
-  
-        if (config.what_to_count_2 & COUNT_POST_NAT_SRC_PORT) fprintf(f, "%-5u              ", pnat->post_nat_src_port);
-        if (config.what_to_count_2 & COUNT_POST_NAT_DST_PORT) fprintf(f, "%-5u              ", pnat->post_nat_dst_port);
-        if (config.what_to_count_2 & COUNT_NAT_EVENT) fprintf(f, "%-3u       ", pnat->nat_event);
-  
-        if (config.what_to_count_2 & COUNT_MPLS_LABEL_TOP) {
-  	fprintf(f, "%-7u         ", pmpls->mpls_label_top);
-        }
-        if (config.what_to_count_2 & COUNT_MPLS_LABEL_BOTTOM) {
-  	fprintf(f, "%-7u            ", pmpls->mpls_label_bottom);
+        if (queue[j]->pvlen) pvlen = queue[j]->pvlen;
+        else pvlen = NULL;
+
+        avro_value_iface_t *avro_iface = avro_generic_class_from_schema(avro_acct_schema);
+
+        avro_value_t avro_value = compose_avro(config.what_to_count, config.what_to_count_2, queue[j]->flow_type,
+                         &queue[j]->primitives, pbgp, pnat, pmpls, ptun, pcust, pvlen, queue[j]->bytes_counter,
+                         queue[j]->packet_counter, queue[j]->flow_counter, queue[j]->tcp_flags, NULL,
+                         queue[j]->stitch, avro_iface);
+
+        if (config.sql_table) {
+          if (avro_file_writer_append_value(avro_writer, &avro_value)) {
+            Log(LOG_ERR, "ERROR ( %s/%s ): AVRO: failed writing the value: %s\n",
+                config.name, config.type, avro_strerror());
+            exit_plugin(1);
+          }
         }
-        if (config.what_to_count_2 & COUNT_MPLS_STACK_DEPTH) {
-  	fprintf(f, "%-2u                ", pmpls->mpls_stack_depth);
+        else {
+          char *json_str;
+
+          if (avro_value_to_json(&avro_value, TRUE, &json_str)) {
+            Log(LOG_ERR, "ERROR ( %s/%s ): AVRO: unable to value to JSON: %s\n",
+                config.name, config.type, avro_strerror());
+            exit_plugin(1);
+          }
+
+          fprintf(f, "%s\n", json_str);
+          free(json_str);
         }
 
-	if (config.what_to_count_2 & COUNT_TUNNEL_SRC_HOST) {
-          addr_to_str(ip_address, &ptun->tunnel_src_ip);
+        avro_value_iface_decref(avro_iface);
+        avro_value_decref(&avro_value);
+#else
+        if (config.debug) Log(LOG_DEBUG, "DEBUG ( %s/%s ): compose_avro(): AVRO object not created due to missing --enable-avro\n", config.name, config.type);
+#endif
+      }
+    }
+  }
+
+#if defined ENABLE_THREADS && defined HAVE_OPEN_MEMSTREAM
+  if (purge_threads && pq_ptr) P_cache_purge_threads(&ppt, f, queue, pq_ptr, is_event);
+#endif
+
+  duration = time(NULL)-start;
+
+  if (f && config.print_markers) {
+    if ((config.print_output & PRINT_OUTPUT_CSV) || (config.print_output & PRINT_OUTPUT_FORMATTED))
+      fprintf(f, "--END (%u)--\n", writer_pid);
+    else if (config.print_output & PRINT_OUTPUT_JSON) {
+      void *json_obj;
+
+      json_obj = compose_purge_close_json(config.name, writer_pid, qn, saved_index, duration);
+      if (json_obj) write_and_free_json(f, json_obj);
+    }
+  }
+    
+  if (config.sql_table) {
+#ifdef WITH_AVRO
+    if (config.print_output & PRINT_OUTPUT_AVRO)
+      avro_file_writer_flush(avro_writer);
+#endif
+
+    if (config.print_latest_file) {
+      if (!safe_action) {
+        memset(tmpbuf, 0, LONGLONGSRVBUFLEN);
+        handle_dynname_internal_strings(tmpbuf, LONGSRVBUFLEN, config.print_latest_file, &prim_ptrs);
+        link_latest_output_file(tmpbuf, current_table);
+      }
+    }
+
+#ifdef WITH_AVRO
+    if (config.print_output & PRINT_OUTPUT_AVRO) {
+      avro_file_writer_close(avro_writer);
+    }
+#endif
+    else {
+      if (f) close_output_file(f);
+    }
+  }
+  else {
+    /* writing to stdout: releasing lock */
+    fflush(f);
+    close_output_file(lockf);
+  }
+
+  /* If we have pending queries then start again */
+  if (pqq_ptr) goto start;
+
+#if defined ENABLE_THREADS && defined HAVE_OPEN_MEMSTREAM
+  if (purge_threads) {
+    char rps_str[SRVBUFLEN];
+
+    P_cache_purge_threads_rps(&ppt, rps_str, SRVBUFLEN);
+    Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %u, TH: %u, RPS: %s) ***\n",
+		config.name, config.type, writer_pid, qn, saved_index, duration, ppt.num_workers, rps_str);
+
+    P_cache_purge_threads_destroy(&ppt);
+  }
+  else
+#endif
+  Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %u) ***\n",
+		config.name, config.type, writer_pid, qn, saved_index, duration);
+
+  if (config.sql_trigger_exec && !safe_action) P_trigger_exec(config.sql_trigger_exec); 
+
+  if (empty.pcust) free(empty.pcust);
+}
+
+void P_cache_purge_entry(FILE *f, struct chained_cache *elem, struct print_purge_empty *empty, int is_event)
+{
+  struct pkt_primitives *data = &elem->primitives;
+  struct pkt_bgp_primitives *pbgp;
+  struct pkt_nat_primitives *pnat;
+  struct pkt_mpls_primitives *pmpls;
+  struct pkt_tunnel_primitives *ptun;
+  struct pkt_vlen_hdr_primitives *pvlen;
+  char *pcust;
+  char src_mac[18], dst_mac[18], src_host[INET6_ADDRSTRLEN], dst_host[INET6_ADDRSTRLEN], ip_address[INET6_ADDRSTRLEN];
+  char rd_str[SRVBUFLEN], *sep = config.print_output_separator;
+  char *as_path, *bgp_comm, empty_string[] = "", empty_ip4[] = "0.0.0.0", empty_ip6[] = "::";
+  char empty_macaddress[] = "00:00:00:00:00:00", empty_rd[] = "0:0", ndpi_class[SUPERSHORTBUFLEN];
+  int count = 0;
+
+  if (elem->pbgp) pbgp = elem->pbgp;
+  else pbgp = &empty->pbgp;
+
+  if (elem->pnat) pnat = elem->pnat;
+  else pnat = &empty->pnat;
 
+  if (elem->pmpls) pmpls = elem->pmpls;
+  else pmpls = &empty->pmpls;
+
+  if (elem->ptun) ptun = elem->ptun;
+  else ptun = &empty->ptun;
+
+  if (elem->pcust) pcust = elem->pcust;
+  else pcust = empty->pcust;
+
+  if (elem->pvlen) pvlen = elem->pvlen;
+  else pvlen = NULL;
+
+  if (config.print_output & PRINT_OUTPUT_FORMATTED) {
+    if (config.what_to_count & COUNT_TAG) fprintf(f, "%-10llu  ", data->tag);
+    if (config.what_to_count & COUNT_TAG2) fprintf(f, "%-10llu  ", data->tag2);
+    if (config.what_to_count & COUNT_CLASS) fprintf(f, "%-16s  ", ((data->class && class[(data->class)-1].id) ? class[(data->class)-1].protocol : "unknown" ));
+#if defined (WITH_NDPI)
+    if (config.what_to_count_2 & COUNT_NDPI_CLASS) {
+      snprintf(ndpi_class, SUPERSHORTBUFLEN, "%s/%s",
+	    ndpi_get_proto_name(pm_ndpi_wfl->ndpi_struct, data->ndpi_class.master_protocol),
+	    ndpi_get_proto_name(pm_ndpi_wfl->ndpi_struct, data->ndpi_class.app_protocol));
+      fprintf(f, "%-16s  ", ndpi_class);
+    }
+#endif
+#if defined HAVE_L2
+    if (config.what_to_count & (COUNT_SRC_MAC|COUNT_SUM_MAC)) {
+      etheraddr_string(data->eth_shost, src_mac);
+    if (strlen(src_mac))
+        fprintf(f, "%-17s  ", src_mac);
+      else
+        fprintf(f, "%-17s  ", empty_macaddress);
+    }
+    if (config.what_to_count & COUNT_DST_MAC) {
+      etheraddr_string(data->eth_dhost, dst_mac);
+    if (strlen(dst_mac))
+        fprintf(f, "%-17s  ", dst_mac);
+    else
+        fprintf(f, "%-17s  ", empty_macaddress);
+    }
+    if (config.what_to_count & COUNT_VLAN) fprintf(f, "%-5u  ", data->vlan_id); 
+    if (config.what_to_count & COUNT_COS) fprintf(f, "%-2u  ", data->cos); 
+    if (config.what_to_count & COUNT_ETHERTYPE) fprintf(f, "%-5x  ", data->etype); 
+#endif
+    if (config.what_to_count & (COUNT_SRC_AS|COUNT_SUM_AS)) fprintf(f, "%-10u  ", data->src_as); 
+    if (config.what_to_count & COUNT_DST_AS) fprintf(f, "%-10u  ", data->dst_as); 
+
+    if (config.what_to_count & COUNT_LOCAL_PREF) fprintf(f, "%-7u  ", pbgp->local_pref);
+    if (config.what_to_count & COUNT_SRC_LOCAL_PREF) fprintf(f, "%-7u  ", pbgp->src_local_pref);
+    if (config.what_to_count & COUNT_MED) fprintf(f, "%-6u  ", pbgp->med);
+    if (config.what_to_count & COUNT_SRC_MED) fprintf(f, "%-6u  ", pbgp->src_med);
+
+    if (config.what_to_count & COUNT_PEER_SRC_AS) fprintf(f, "%-10u  ", pbgp->peer_src_as);
+    if (config.what_to_count & COUNT_PEER_DST_AS) fprintf(f, "%-10u  ", pbgp->peer_dst_as);
+
+    if (config.what_to_count & COUNT_PEER_SRC_IP) {
+      addr_to_str(ip_address, &pbgp->peer_src_ip);
 #if defined ENABLE_IPV6
-	  if (strlen(ip_address))
-	    fprintf(f, "%-45s  ", ip_address);
-	  else
-	    fprintf(f, "%-45s  ", empty_ip6);
+      if (strlen(ip_address))
+        fprintf(f, "%-45s  ", ip_address);
+    else
+        fprintf(f, "%-45s  ", empty_ip6);
 #else
-	  if (strlen(ip_address))
-	    fprintf(f, "%-15s  ", ip_address);
-	  else
-	    fprintf(f, "%-15s  ", empty_ip4);
+    if (strlen(ip_address))
+        fprintf(f, "%-15s  ", ip_address);
+    else
+        fprintf(f, "%-15s  ", empty_ip4);
 #endif
-	}
+    }
+    if (config.what_to_count & COUNT_PEER_DST_IP) {
+      addr_to_str(ip_address, &pbgp->peer_dst_ip);
+#if defined ENABLE_IPV6
+      if (strlen(ip_address))
+        fprintf(f, "%-45s  ", ip_address);
+      else
+        fprintf(f, "%-45s  ", empty_ip6);
+#else
+      if (strlen(ip_address))
+        fprintf(f, "%-15s  ", ip_address);
+      else 
+        fprintf(f, "%-15s  ", empty_ip4);
+#endif
+    }
 
-	if (config.what_to_count_2 & COUNT_TUNNEL_DST_HOST) {
-	   addr_to_str(ip_address, &ptun->tunnel_dst_ip);
+    if (config.what_to_count & COUNT_IN_IFACE) fprintf(f, "%-10u  ", data->ifindex_in);
+    if (config.what_to_count & COUNT_OUT_IFACE) fprintf(f, "%-10u  ", data->ifindex_out);
 
+    if (config.what_to_count & COUNT_MPLS_VPN_RD) {
+      bgp_rd2str(rd_str, &pbgp->mpls_vpn_rd);
+    if (strlen(rd_str))
+        fprintf(f, "%-18s  ", rd_str);
+    else
+        fprintf(f, "%-18s  ", empty_rd);
+    }
+
+    if (config.what_to_count & (COUNT_SRC_HOST|COUNT_SUM_HOST)) {
+      addr_to_str(src_host, &data->src_ip);
 #if defined ENABLE_IPV6
-	  if (strlen(ip_address))
-	    fprintf(f, "%-45s  ", ip_address);
-	  else
-	    fprintf(f, "%-45s  ", empty_ip6);
+    if (strlen(src_host))
+        fprintf(f, "%-45s  ", src_host);
+    else
+        fprintf(f, "%-45s  ", empty_ip6);
 #else
-	  if (strlen(ip_address))
-	    fprintf(f, "%-15s  ", ip_address);
-	  else
-	    fprintf(f, "%-15s  ", empty_ip4);
+    if (strlen(src_host))
+        fprintf(f, "%-15s  ", src_host);
+    else
+        fprintf(f, "%-15s  ", empty_ip4);
+#endif
+    }
+
+    if (config.what_to_count & (COUNT_SRC_NET|COUNT_SUM_NET)) {
+      addr_to_str(src_host, &data->src_net);
+#if defined ENABLE_IPV6
+    if (strlen(src_host))
+        fprintf(f, "%-45s  ", src_host);
+    else
+        fprintf(f, "%-45s  ", empty_ip6);
+#else
+    if (strlen(src_host))
+        fprintf(f, "%-15s  ", src_host);
+    else
+        fprintf(f, "%-15s  ", empty_ip4);
+#endif
+    }
+
+    if (config.what_to_count & COUNT_DST_HOST) {
+      addr_to_str(dst_host, &data->dst_ip);
+#if defined ENABLE_IPV6
+    if (strlen(dst_host))
+        fprintf(f, "%-45s  ", dst_host);
+    else
+        fprintf(f, "%-45s  ", empty_ip6);
+#else
+    if (strlen(dst_host))
+        fprintf(f, "%-15s  ", dst_host);
+    else
+        fprintf(f, "%-15s  ", empty_ip4);
+#endif
+    }
+
+    if (config.what_to_count & COUNT_DST_NET) {
+      addr_to_str(dst_host, &data->dst_net);
+#if defined ENABLE_IPV6
+    if (strlen(dst_host))
+        fprintf(f, "%-45s  ", dst_host);
+    else
+        fprintf(f, "%-45s  ", empty_ip6);
+#else
+    if (strlen(dst_host))
+        fprintf(f, "%-15s  ", dst_host);
+    else
+        fprintf(f, "%-15s  ", empty_ip4);
+#endif
+    }
+
+    if (config.what_to_count & COUNT_SRC_NMASK) fprintf(f, "%-3u       ", data->src_nmask);
+    if (config.what_to_count & COUNT_DST_NMASK) fprintf(f, "%-3u       ", data->dst_nmask);
+    if (config.what_to_count & (COUNT_SRC_PORT|COUNT_SUM_PORT)) fprintf(f, "%-5u     ", data->src_port);
+    if (config.what_to_count & COUNT_DST_PORT) fprintf(f, "%-5u     ", data->dst_port);
+    if (config.what_to_count & COUNT_TCPFLAGS) fprintf(f, "%-3u        ", elem->tcp_flags);
+
+    if (config.what_to_count & COUNT_IP_PROTO) {
+      if (!config.num_protos && (data->proto < protocols_number))
+	fprintf(f, "%-10s  ", _protocols[data->proto].name);
+      else
+	fprintf(f, "%-10d  ", data->proto);
+    }
+
+    if (config.what_to_count & COUNT_IP_TOS) fprintf(f, "%-3u    ", data->tos);
+
+#if defined WITH_GEOIP
+    if (config.what_to_count_2 & COUNT_SRC_HOST_COUNTRY) fprintf(f, "%-5s       ", GeoIP_code_by_id(data->src_ip_country.id));
+    if (config.what_to_count_2 & COUNT_DST_HOST_COUNTRY) fprintf(f, "%-5s       ", GeoIP_code_by_id(data->dst_ip_country.id));
+#endif
+#if defined WITH_GEOIPV2
+    if (config.what_to_count_2 & COUNT_SRC_HOST_COUNTRY) fprintf(f, "%-5s       ", data->src_ip_country.str);
+    if (config.what_to_count_2 & COUNT_DST_HOST_COUNTRY) fprintf(f, "%-5s       ", data->dst_ip_country.str);
+    if (config.what_to_count_2 & COUNT_SRC_HOST_POCODE) fprintf(f, "%-12s  ", data->src_ip_pocode.str);
+    if (config.what_to_count_2 & COUNT_DST_HOST_POCODE) fprintf(f, "%-12s  ", data->dst_ip_pocode.str);
+#endif
+
+    if (config.what_to_count_2 & COUNT_SAMPLING_RATE) fprintf(f, "%-7u       ", data->sampling_rate);
+    if (config.what_to_count_2 & COUNT_PKT_LEN_DISTRIB) fprintf(f, "%-10s      ", config.pkt_len_distrib_bins[data->pkt_len_distrib]);
+
+    if (config.what_to_count_2 & COUNT_POST_NAT_SRC_HOST) {
+      addr_to_str(ip_address, &pnat->post_nat_src_ip);
+
+#if defined ENABLE_IPV6
+      if (strlen(ip_address))
+        fprintf(f, "%-45s  ", ip_address);
+      else
+        fprintf(f, "%-45s  ", empty_ip6);
+#else
+      if (strlen(ip_address))
+        fprintf(f, "%-15s  ", ip_address);
+      else
+        fprintf(f, "%-15s  ", empty_ip4);
+#endif
+    }
+
+    if (config.what_to_count_2 & COUNT_POST_NAT_DST_HOST) {
+      addr_to_str(ip_address, &pnat->post_nat_dst_ip);
+
+#if defined ENABLE_IPV6
+      if (strlen(ip_address))
+        fprintf(f, "%-45s  ", ip_address);
+      else
+        fprintf(f, "%-45s  ", empty_ip6);
+#else 
+      if (strlen(ip_address))
+        fprintf(f, "%-15s  ", ip_address);
+      else
+        fprintf(f, "%-15s  ", empty_ip4);
+#endif
+    }
+
+    if (config.what_to_count_2 & COUNT_POST_NAT_SRC_PORT) fprintf(f, "%-5u              ", pnat->post_nat_src_port);
+    if (config.what_to_count_2 & COUNT_POST_NAT_DST_PORT) fprintf(f, "%-5u              ", pnat->post_nat_dst_port);
+    if (config.what_to_count_2 & COUNT_NAT_EVENT) fprintf(f, "%-3u       ", pnat->nat_event);
+
+    if (config.what_to_count_2 & COUNT_MPLS_LABEL_TOP) {
+    fprintf(f, "%-7u         ", pmpls->mpls_label_top);
+    }
+    if (config.what_to_count_2 & COUNT_MPLS_LABEL_BOTTOM) {
+    fprintf(f, "%-7u            ", pmpls->mpls_label_bottom);
+    }
+    if (config.what_to_count_2 & COUNT_MPLS_STACK_DEPTH) {
+    fprintf(f, "%-2u                ", pmpls->mpls_stack_depth);
+    }
+
+    if (config.what_to_count_2 & COUNT_TUNNEL_SRC_HOST) {
+      addr_to_str(ip_address, &ptun->tunnel_src_ip);
+
+#if defined ENABLE_IPV6
+      if (strlen(ip_address))
+	fprintf(f, "%-45s  ", ip_address);
+      else
+	fprintf(f, "%-45s  ", empty_ip6);
+#else
+      if (strlen(ip_address))
+	fprintf(f, "%-15s  ", ip_address);
+      else
+	fprintf(f, "%-15s  ", empty_ip4);
+#endif
+    }
+
+    if (config.what_to_count_2 & COUNT_TUNNEL_DST_HOST) {
+       addr_to_str(ip_address, &ptun->tunnel_dst_ip);
+
+#if defined ENABLE_IPV6
+      if (strlen(ip_address))
+	fprintf(f, "%-45s  ", ip_address);
+      else
+	fprintf(f, "%-45s  ", empty_ip6);
+#else
+      if (strlen(ip_address))
+	fprintf(f, "%-15s  ", ip_address);
+      else
+	fprintf(f, "%-15s  ", empty_ip4);
+#endif
+    }
+
+    if (config.what_to_count_2 & COUNT_TUNNEL_IP_PROTO) {
+      if (!config.num_protos && (ptun->tunnel_proto < protocols_number))
+	fprintf(f, "%-10s       ", _protocols[ptun->tunnel_proto].name);
+      else
+	fprintf(f, "%-10d       ", ptun->tunnel_proto);
+    }
+
+    if (config.what_to_count_2 & COUNT_TUNNEL_IP_TOS) fprintf(f, "%-3u         ", ptun->tunnel_tos);
+
+    if (config.what_to_count_2 & COUNT_TIMESTAMP_START) {
+      char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
+      time_t time1;
+      struct tm *time2, time_tm;
+
+      if (config.timestamps_since_epoch) {
+	snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_start.tv_sec, pnat->timestamp_start.tv_usec);
+      }
+      else {
+        time1 = pnat->timestamp_start.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_start.tv_usec);
+      }
+
+      fprintf(f, "%-30s ", buf2);
+    }
+
+    if (config.what_to_count_2 & COUNT_TIMESTAMP_END) {
+      char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
+      time_t time1;
+      struct tm *time2, time_tm;
+
+      if (config.timestamps_since_epoch) {
+        snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_end.tv_sec, pnat->timestamp_end.tv_usec);
+      }
+      else {
+        time1 = pnat->timestamp_end.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_end.tv_usec);
+      }
+
+      fprintf(f, "%-30s ", buf2);
+    }
+
+    if (config.what_to_count_2 & COUNT_TIMESTAMP_ARRIVAL) {
+      char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
+      time_t time1;
+      struct tm *time2, time_tm;
+
+      if (config.timestamps_since_epoch) {
+        snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_arrival.tv_sec, pnat->timestamp_arrival.tv_usec);
+      }
+      else {
+        time1 = pnat->timestamp_arrival.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_arrival.tv_usec);
+      }
+
+      fprintf(f, "%-30s ", buf2);
+    }
+
+    if (config.nfacctd_stitching && elem->stitch) {
+      char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
+      time_t time1;
+      struct tm *time2, time_tm;
+
+      if (config.timestamps_since_epoch) {
+        snprintf(buf2, SRVBUFLEN, "%u.%u", elem->stitch->timestamp_min.tv_sec, elem->stitch->timestamp_min.tv_usec);
+        fprintf(f, "%-30s ", buf2);
+
+        snprintf(buf2, SRVBUFLEN, "%u.%u", elem->stitch->timestamp_max.tv_sec, elem->stitch->timestamp_max.tv_usec);
+        fprintf(f, "%-30s ", buf2);
+      }
+      else {
+	time1 = elem->stitch->timestamp_min.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, elem->stitch->timestamp_min.tv_usec);
+        fprintf(f, "%-30s ", buf2);
+
+        time1 = elem->stitch->timestamp_max.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, elem->stitch->timestamp_max.tv_usec);
+        fprintf(f, "%-30s ", buf2);
+      }
+    }
+
+    if (config.what_to_count_2 & COUNT_EXPORT_PROTO_SEQNO) fprintf(f, "%-18u  ", data->export_proto_seqno);
+    if (config.what_to_count_2 & COUNT_EXPORT_PROTO_VERSION) fprintf(f, "%-20u  ", data->export_proto_version);
+
+    /* all custom primitives printed here */
+    {
+      int cp_idx;
+
+      for (cp_idx = 0; cp_idx < config.cpptrs.num; cp_idx++) {
+	if (config.cpptrs.primitive[cp_idx].ptr->len != PM_VARIABLE_LENGTH) {
+          char cp_str[SRVBUFLEN];
+
+          custom_primitive_value_print(cp_str, SRVBUFLEN, pcust, &config.cpptrs.primitive[cp_idx], TRUE);
+	  fprintf(f, "%s  ", cp_str);
+	}
+	else {
+	  /* vlen primitives not supported in formatted outputs: we should never get here */
+          char *label_ptr = NULL;
+
+          vlen_prims_get(pvlen, config.cpptrs.primitive[cp_idx].ptr->type, &label_ptr);
+          if (!label_ptr) label_ptr = empty_string;
+          fprintf(f, "%s  ", label_ptr);
+	}
+      }
+    }
+
+    if (!is_event) {
+#if defined HAVE_64BIT_COUNTERS
+      fprintf(f, "%-20llu  ", elem->packet_counter);
+      if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%-20llu  ", elem->flow_counter);
+      fprintf(f, "%llu\n", elem->bytes_counter);
+#else
+      fprintf(f, "%-10lu  ", elem->packet_counter);
+      if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%-10lu  ", elem->flow_counter);
+      fprintf(f, "%lu\n", elem->bytes_counter);
+#endif
+    }
+    else fprintf(f, "\n");
+  }
+  else if (config.print_output & PRINT_OUTPUT_CSV) {
+    if (config.what_to_count & COUNT_TAG) fprintf(f, "%s%llu", write_sep(sep, &count), data->tag);
+    if (config.what_to_count & COUNT_TAG2) fprintf(f, "%s%llu", write_sep(sep, &count), data->tag2);
+    if (config.what_to_count_2 & COUNT_LABEL) P_fprintf_csv_label(f, data, pvlen, write_sep(sep, &count), empty_string);
+    if (config.what_to_count & COUNT_CLASS) fprintf(f, "%s%s", write_sep(sep, &count), ((data->class && class[(data->class)-1].id) ? class[(data->class)-1].protocol : "unknown" ));
+#if defined (WITH_NDPI)
+    if (config.what_to_count_2 & COUNT_NDPI_CLASS) {
+      snprintf(ndpi_class, SUPERSHORTBUFLEN, "%s/%s",
+	    ndpi_get_proto_name(pm_ndpi_wfl->ndpi_struct, data->ndpi_class.master_protocol),
+	    ndpi_get_proto_name(pm_ndpi_wfl->ndpi_struct, data->ndpi_class.app_protocol));
+      fprintf(f, "%s%s", write_sep(sep, &count), ndpi_class);
+    }
+#endif
+#if defined (HAVE_L2)
+    if (config.what_to_count & (COUNT_SRC_MAC|COUNT_SUM_MAC)) {
+      etheraddr_string(data->eth_shost, src_mac);
+      fprintf(f, "%s%s", write_sep(sep, &count), src_mac);
+    }
+    if (config.what_to_count & COUNT_DST_MAC) {
+      etheraddr_string(data->eth_dhost, dst_mac);
+      fprintf(f, "%s%s", write_sep(sep, &count), dst_mac);
+    }
+    if (config.what_to_count & COUNT_VLAN) fprintf(f, "%s%u", write_sep(sep, &count), data->vlan_id); 
+    if (config.what_to_count & COUNT_COS) fprintf(f, "%s%u", write_sep(sep, &count), data->cos); 
+    if (config.what_to_count & COUNT_ETHERTYPE) fprintf(f, "%s%x", write_sep(sep, &count), data->etype); 
 #endif
-	}
+    if (config.what_to_count & (COUNT_SRC_AS|COUNT_SUM_AS)) fprintf(f, "%s%u", write_sep(sep, &count), data->src_as); 
+    if (config.what_to_count & COUNT_DST_AS) fprintf(f, "%s%u", write_sep(sep, &count), data->dst_as); 
+
+    if (config.what_to_count & COUNT_STD_COMM) {
+      char *str_ptr = NULL;
+
+      vlen_prims_get(pvlen, COUNT_INT_STD_COMM, &str_ptr);
+      if (str_ptr) {
+        bgp_comm = str_ptr;
+        while (bgp_comm) {
+          bgp_comm = strchr(str_ptr, ' ');
+          if (bgp_comm) *bgp_comm = '_';
+        }
 
-	if (config.what_to_count_2 & COUNT_TUNNEL_IP_PROTO) {
-	  if (!config.num_protos && (ptun->tunnel_proto < protocols_number))
-	    fprintf(f, "%-10s       ", _protocols[ptun->tunnel_proto].name);
-	  else
-	    fprintf(f, "%-10d       ", ptun->tunnel_proto);
-	}
+      }
 
-	if (config.what_to_count_2 & COUNT_TUNNEL_IP_TOS) fprintf(f, "%-3u         ", ptun->tunnel_tos);
-  
-        if (config.what_to_count_2 & COUNT_TIMESTAMP_START) {
-          char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
-          time_t time1;
-          struct tm *time2;
-  
-          if (config.timestamps_since_epoch) {
-	    snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_start.tv_sec, pnat->timestamp_start.tv_usec);
-	  }
-	  else {
-            time1 = pnat->timestamp_start.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_start.tv_usec);
-	  }
+      P_fprintf_csv_string(f, pvlen, COUNT_INT_STD_COMM, write_sep(sep, &count), empty_string);
+    }
 
-          fprintf(f, "%-30s ", buf2);
-        }
-  
-        if (config.what_to_count_2 & COUNT_TIMESTAMP_END) {
-          char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
-          time_t time1;
-          struct tm *time2;
-        
-          if (config.timestamps_since_epoch) {
-            snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_end.tv_sec, pnat->timestamp_end.tv_usec);
-          }
-          else {
-            time1 = pnat->timestamp_end.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_end.tv_usec);
-	  }
+    if (config.what_to_count & COUNT_EXT_COMM) {
+      char *str_ptr = NULL;
 
-          fprintf(f, "%-30s ", buf2);
+      vlen_prims_get(pvlen, COUNT_INT_EXT_COMM, &str_ptr);
+      if (str_ptr) {
+        bgp_comm = str_ptr;
+        while (bgp_comm) {
+          bgp_comm = strchr(str_ptr, ' ');
+          if (bgp_comm) *bgp_comm = '_';
         }
+      }
 
-        if (config.what_to_count_2 & COUNT_TIMESTAMP_ARRIVAL) {
-          char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
-          time_t time1;
-          struct tm *time2;
+      P_fprintf_csv_string(f, pvlen, COUNT_INT_EXT_COMM, write_sep(sep, &count), empty_string);
+    }
 
-          if (config.timestamps_since_epoch) {
-            snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_arrival.tv_sec, pnat->timestamp_arrival.tv_usec);
-          }
-          else {
-            time1 = pnat->timestamp_arrival.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_arrival.tv_usec);
-          }
+    if (config.what_to_count_2 & COUNT_LRG_COMM) {
+      char *str_ptr = NULL;
 
-          fprintf(f, "%-30s ", buf2);
+      vlen_prims_get(pvlen, COUNT_INT_LRG_COMM, &str_ptr);
+      if (str_ptr) {
+        bgp_comm = str_ptr;
+        while (bgp_comm) {
+          bgp_comm = strchr(str_ptr, ' ');
+          if (bgp_comm) *bgp_comm = '_';
         }
+      }
 
-        if (config.nfacctd_stitching && queue[j]->stitch) {
-          char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
-          time_t time1;
-          struct tm *time2;
+      P_fprintf_csv_string(f, pvlen, COUNT_INT_LRG_COMM, write_sep(sep, &count), empty_string);
+    }
 
-          if (config.timestamps_since_epoch) {
-            snprintf(buf2, SRVBUFLEN, "%u.%u", queue[j]->stitch->timestamp_min.tv_sec, queue[j]->stitch->timestamp_min.tv_usec);
-            fprintf(f, "%-30s ", buf2);
+    if (config.what_to_count & COUNT_SRC_STD_COMM) {
+      char *str_ptr = NULL;
 
-            snprintf(buf2, SRVBUFLEN, "%u.%u", queue[j]->stitch->timestamp_max.tv_sec, queue[j]->stitch->timestamp_max.tv_usec);
-            fprintf(f, "%-30s ", buf2);
-          }
-          else {
-	    time1 = queue[j]->stitch->timestamp_min.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, queue[j]->stitch->timestamp_min.tv_usec);
-            fprintf(f, "%-30s ", buf2);
-
-            time1 = queue[j]->stitch->timestamp_max.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, queue[j]->stitch->timestamp_max.tv_usec);
-            fprintf(f, "%-30s ", buf2);
-	  }
+      vlen_prims_get(pvlen, COUNT_INT_SRC_STD_COMM, &str_ptr);
+      if (str_ptr) {
+        bgp_comm = str_ptr;
+        while (bgp_comm) {
+          bgp_comm = strchr(str_ptr, ' ');
+          if (bgp_comm) *bgp_comm = '_';
         }
 
-        if (config.what_to_count_2 & COUNT_EXPORT_PROTO_SEQNO) fprintf(f, "%-18u  ", data->export_proto_seqno);
-        if (config.what_to_count_2 & COUNT_EXPORT_PROTO_VERSION) fprintf(f, "%-20u  ", data->export_proto_version);
+      }
 
-        /* all custom primitives printed here */
-        {
-          int cp_idx;
-  
-          for (cp_idx = 0; cp_idx < config.cpptrs.num; cp_idx++) {
-	    if (config.cpptrs.primitive[cp_idx].ptr->len != PM_VARIABLE_LENGTH) {
-              char cp_str[SRVBUFLEN];
-
-              custom_primitive_value_print(cp_str, SRVBUFLEN, pcust, &config.cpptrs.primitive[cp_idx], TRUE);
-	      fprintf(f, "%s  ", cp_str);
-	    }
-	    else {
-	      /* vlen primitives not supported in formatted outputs: we should never get here */
-              char *label_ptr = NULL;
-
-              vlen_prims_get(pvlen, config.cpptrs.primitive[cp_idx].ptr->type, &label_ptr);
-              if (!label_ptr) label_ptr = empty_string;
-              fprintf(f, "%s  ", label_ptr);
-	    }
-          }
-        }
+      P_fprintf_csv_string(f, pvlen, COUNT_INT_SRC_STD_COMM, write_sep(sep, &count), empty_string);
+    }
+
+    if (config.what_to_count & COUNT_SRC_EXT_COMM) {
+      char *str_ptr = NULL;
 
-        if (!is_event) {
-  #if defined HAVE_64BIT_COUNTERS
-          fprintf(f, "%-20llu  ", queue[j]->packet_counter);
-          if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%-20llu  ", queue[j]->flow_counter);
-          fprintf(f, "%llu\n", queue[j]->bytes_counter);
-  #else
-          fprintf(f, "%-10lu  ", queue[j]->packet_counter);
-          if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%-10lu  ", queue[j]->flow_counter);
-          fprintf(f, "%lu\n", queue[j]->bytes_counter);
-  #endif
+      vlen_prims_get(pvlen, COUNT_INT_SRC_EXT_COMM, &str_ptr);
+      if (str_ptr) {
+        bgp_comm = str_ptr;
+        while (bgp_comm) {
+          bgp_comm = strchr(str_ptr, ' ');
+          if (bgp_comm) *bgp_comm = '_';
         }
-        else fprintf(f, "\n");
       }
-      else if (f && config.print_output & PRINT_OUTPUT_CSV) {
-        if (config.what_to_count & COUNT_TAG) fprintf(f, "%s%llu", write_sep(sep, &count), data->tag);
-        if (config.what_to_count & COUNT_TAG2) fprintf(f, "%s%llu", write_sep(sep, &count), data->tag2);
-	if (config.what_to_count_2 & COUNT_LABEL) P_fprintf_csv_string(f, pvlen, COUNT_INT_LABEL, write_sep(sep, &count), empty_string);
-        if (config.what_to_count & COUNT_CLASS) fprintf(f, "%s%s", write_sep(sep, &count), ((data->class && class[(data->class)-1].id) ? class[(data->class)-1].protocol : "unknown" ));
-  #if defined (WITH_NDPI)
-        if (config.what_to_count_2 & COUNT_NDPI_CLASS) {
-	  snprintf(ndpi_class, SUPERSHORTBUFLEN, "%s/%s",
-		ndpi_get_proto_name(pm_ndpi_wfl->ndpi_struct, data->ndpi_class.master_protocol),
-		ndpi_get_proto_name(pm_ndpi_wfl->ndpi_struct, data->ndpi_class.app_protocol));
-	  fprintf(f, "%s%s", write_sep(sep, &count), ndpi_class);
-	}
-  #endif
-  #if defined (HAVE_L2)
-        if (config.what_to_count & (COUNT_SRC_MAC|COUNT_SUM_MAC)) {
-          etheraddr_string(data->eth_shost, src_mac);
-          fprintf(f, "%s%s", write_sep(sep, &count), src_mac);
-        }
-        if (config.what_to_count & COUNT_DST_MAC) {
-          etheraddr_string(data->eth_dhost, dst_mac);
-          fprintf(f, "%s%s", write_sep(sep, &count), dst_mac);
-        }
-        if (config.what_to_count & COUNT_VLAN) fprintf(f, "%s%u", write_sep(sep, &count), data->vlan_id); 
-        if (config.what_to_count & COUNT_COS) fprintf(f, "%s%u", write_sep(sep, &count), data->cos); 
-        if (config.what_to_count & COUNT_ETHERTYPE) fprintf(f, "%s%x", write_sep(sep, &count), data->etype); 
-  #endif
-        if (config.what_to_count & (COUNT_SRC_AS|COUNT_SUM_AS)) fprintf(f, "%s%u", write_sep(sep, &count), data->src_as); 
-        if (config.what_to_count & COUNT_DST_AS) fprintf(f, "%s%u", write_sep(sep, &count), data->dst_as); 
-  
-        if (config.what_to_count & COUNT_STD_COMM) {
-          char *str_ptr = NULL;
-
-          vlen_prims_get(pvlen, COUNT_INT_STD_COMM, &str_ptr);
-          if (str_ptr) {
-            bgp_comm = str_ptr;
-            while (bgp_comm) {
-              bgp_comm = strchr(str_ptr, ' ');
-              if (bgp_comm) *bgp_comm = '_';
-            }
 
-          }
+      P_fprintf_csv_string(f, pvlen, COUNT_INT_SRC_EXT_COMM, write_sep(sep, &count), empty_string);
+    }
+
+    if (config.what_to_count_2 & COUNT_SRC_LRG_COMM) {
+      char *str_ptr = NULL;
 
-          P_fprintf_csv_string(f, pvlen, COUNT_INT_STD_COMM, write_sep(sep, &count), empty_string);
+      vlen_prims_get(pvlen, COUNT_INT_SRC_LRG_COMM, &str_ptr);
+      if (str_ptr) {
+        bgp_comm = str_ptr;
+        while (bgp_comm) {
+          bgp_comm = strchr(str_ptr, ' ');
+          if (bgp_comm) *bgp_comm = '_';
         }
+      }
 
-        if (config.what_to_count & COUNT_EXT_COMM) {
-          char *str_ptr = NULL;
+      P_fprintf_csv_string(f, pvlen, COUNT_INT_SRC_LRG_COMM, write_sep(sep, &count), empty_string);
+    }
 
-          vlen_prims_get(pvlen, COUNT_INT_EXT_COMM, &str_ptr);
-          if (str_ptr) {
-            bgp_comm = str_ptr;
-            while (bgp_comm) {
-              bgp_comm = strchr(str_ptr, ' ');
-              if (bgp_comm) *bgp_comm = '_';
-            }
-          }
+    if (config.what_to_count & COUNT_AS_PATH) {
+      char *str_ptr = NULL;
 
-          P_fprintf_csv_string(f, pvlen, COUNT_INT_EXT_COMM, write_sep(sep, &count), empty_string);
-        }
+      vlen_prims_get(pvlen, COUNT_INT_AS_PATH, &str_ptr);
+      if (str_ptr) {
+	as_path = str_ptr;
+        while (as_path) {
+          as_path = strchr(str_ptr, ' ');
+          if (as_path) *as_path = '_';
+	}
 
-        if (config.what_to_count_2 & COUNT_LRG_COMM) {
-          char *str_ptr = NULL;
+      }
 
-          vlen_prims_get(pvlen, COUNT_INT_LRG_COMM, &str_ptr);
-          if (str_ptr) {
-            bgp_comm = str_ptr;
-            while (bgp_comm) {
-              bgp_comm = strchr(str_ptr, ' ');
-              if (bgp_comm) *bgp_comm = '_';
-            }
-          }
+      P_fprintf_csv_string(f, pvlen, COUNT_INT_AS_PATH, write_sep(sep, &count), empty_string);
+    }
 
-          P_fprintf_csv_string(f, pvlen, COUNT_INT_LRG_COMM, write_sep(sep, &count), empty_string);
-        }
+    if (config.what_to_count & COUNT_SRC_AS_PATH) {
+      char *str_ptr = NULL;
 
-        if (config.what_to_count & COUNT_SRC_STD_COMM) {
-          char *str_ptr = NULL;
+      vlen_prims_get(pvlen, COUNT_INT_SRC_AS_PATH, &str_ptr);
+      if (str_ptr) {
+        as_path = str_ptr;
+        while (as_path) {
+          as_path = strchr(str_ptr, ' ');
+          if (as_path) *as_path = '_';
+        }
 
-          vlen_prims_get(pvlen, COUNT_INT_SRC_STD_COMM, &str_ptr);
-          if (str_ptr) {
-            bgp_comm = str_ptr;
-            while (bgp_comm) {
-              bgp_comm = strchr(str_ptr, ' ');
-              if (bgp_comm) *bgp_comm = '_';
-            }
+      }
 
-          }
+      P_fprintf_csv_string(f, pvlen, COUNT_INT_SRC_AS_PATH, write_sep(sep, &count), empty_string);
+    }
 
-          P_fprintf_csv_string(f, pvlen, COUNT_INT_SRC_STD_COMM, write_sep(sep, &count), empty_string);
-        }
+    if (config.what_to_count & COUNT_LOCAL_PREF) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->local_pref);
+    if (config.what_to_count & COUNT_SRC_LOCAL_PREF) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->src_local_pref);
+    if (config.what_to_count & COUNT_MED) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->med);
+    if (config.what_to_count & COUNT_SRC_MED) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->src_med);
 
-        if (config.what_to_count & COUNT_SRC_EXT_COMM) {
-          char *str_ptr = NULL;
+    if (config.what_to_count & COUNT_PEER_SRC_AS) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->peer_src_as);
+    if (config.what_to_count & COUNT_PEER_DST_AS) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->peer_dst_as);
 
-          vlen_prims_get(pvlen, COUNT_INT_SRC_EXT_COMM, &str_ptr);
-          if (str_ptr) {
-            bgp_comm = str_ptr;
-            while (bgp_comm) {
-              bgp_comm = strchr(str_ptr, ' ');
-              if (bgp_comm) *bgp_comm = '_';
-            }
-          }
+    if (config.what_to_count & COUNT_PEER_SRC_IP) {
+      addr_to_str(ip_address, &pbgp->peer_src_ip);
+      fprintf(f, "%s%s", write_sep(sep, &count), ip_address);
+    }
+    if (config.what_to_count & COUNT_PEER_DST_IP) {
+      addr_to_str(ip_address, &pbgp->peer_dst_ip);
+      fprintf(f, "%s%s", write_sep(sep, &count), ip_address);
+    }
 
-          P_fprintf_csv_string(f, pvlen, COUNT_INT_SRC_EXT_COMM, write_sep(sep, &count), empty_string);
-        }
+    if (config.what_to_count & COUNT_IN_IFACE) fprintf(f, "%s%u", write_sep(sep, &count), data->ifindex_in);
+    if (config.what_to_count & COUNT_OUT_IFACE) fprintf(f, "%s%u", write_sep(sep, &count), data->ifindex_out);
 
-        if (config.what_to_count_2 & COUNT_SRC_LRG_COMM) {
-          char *str_ptr = NULL;
+    if (config.what_to_count & COUNT_MPLS_VPN_RD) {
+      bgp_rd2str(rd_str, &pbgp->mpls_vpn_rd);
+      fprintf(f, "%s%s", write_sep(sep, &count), rd_str);
+    }
 
-          vlen_prims_get(pvlen, COUNT_INT_SRC_LRG_COMM, &str_ptr);
-          if (str_ptr) {
-            bgp_comm = str_ptr;
-            while (bgp_comm) {
-              bgp_comm = strchr(str_ptr, ' ');
-              if (bgp_comm) *bgp_comm = '_';
-            }
-          }
+    if (config.what_to_count & (COUNT_SRC_HOST|COUNT_SUM_HOST)) {
+      addr_to_str(src_host, &data->src_ip);
+      fprintf(f, "%s%s", write_sep(sep, &count), src_host);
+    }
+    if (config.what_to_count & (COUNT_SRC_NET|COUNT_SUM_NET)) {
+      addr_to_str(src_host, &data->src_net);
+      fprintf(f, "%s%s", write_sep(sep, &count), src_host);
+    }
 
-          P_fprintf_csv_string(f, pvlen, COUNT_INT_SRC_LRG_COMM, write_sep(sep, &count), empty_string);
-        }
-  
-	if (config.what_to_count & COUNT_AS_PATH) {
-	  char *str_ptr = NULL;
+    if (config.what_to_count & COUNT_DST_HOST) {
+      addr_to_str(dst_host, &data->dst_ip);
+      fprintf(f, "%s%s", write_sep(sep, &count), dst_host);
+    }
+    if (config.what_to_count & COUNT_DST_NET) {
+      addr_to_str(dst_host, &data->dst_net);
+      fprintf(f, "%s%s", write_sep(sep, &count), dst_host);
+    }
 
-	  vlen_prims_get(pvlen, COUNT_INT_AS_PATH, &str_ptr);
-	  if (str_ptr) {
-	    as_path = str_ptr;
-            while (as_path) {
-              as_path = strchr(str_ptr, ' ');
-              if (as_path) *as_path = '_';
-	    }
+    if (config.what_to_count & COUNT_SRC_NMASK) fprintf(f, "%s%u", write_sep(sep, &count), data->src_nmask);
+    if (config.what_to_count & COUNT_DST_NMASK) fprintf(f, "%s%u", write_sep(sep, &count), data->dst_nmask);
+    if (config.what_to_count & (COUNT_SRC_PORT|COUNT_SUM_PORT)) fprintf(f, "%s%u", write_sep(sep, &count), data->src_port);
+    if (config.what_to_count & COUNT_DST_PORT) fprintf(f, "%s%u", write_sep(sep, &count), data->dst_port);
+    if (config.what_to_count & COUNT_TCPFLAGS) fprintf(f, "%s%u", write_sep(sep, &count), elem->tcp_flags);
 
-	  }
+    if (config.what_to_count & COUNT_IP_PROTO) {
+      if (!config.num_protos && (data->proto < protocols_number))
+	fprintf(f, "%s%s", write_sep(sep, &count), _protocols[data->proto].name);
+      else
+	fprintf(f, "%s%d", write_sep(sep, &count), data->proto);
+    }
 
-	  P_fprintf_csv_string(f, pvlen, COUNT_INT_AS_PATH, write_sep(sep, &count), empty_string);
-	}
+    if (config.what_to_count & COUNT_IP_TOS) fprintf(f, "%s%u", write_sep(sep, &count), data->tos);
 
-        if (config.what_to_count & COUNT_SRC_AS_PATH) {
-          char *str_ptr = NULL;
+#if defined WITH_GEOIP
+    if (config.what_to_count_2 & COUNT_SRC_HOST_COUNTRY) fprintf(f, "%s%s", write_sep(sep, &count), GeoIP_code_by_id(data->src_ip_country.id));
+    if (config.what_to_count_2 & COUNT_DST_HOST_COUNTRY) fprintf(f, "%s%s", write_sep(sep, &count), GeoIP_code_by_id(data->dst_ip_country.id));
+#endif
+#if defined WITH_GEOIPV2
+    if (config.what_to_count_2 & COUNT_SRC_HOST_COUNTRY) fprintf(f, "%s%s", write_sep(sep, &count), data->src_ip_country.str);
+    if (config.what_to_count_2 & COUNT_DST_HOST_COUNTRY) fprintf(f, "%s%s", write_sep(sep, &count), data->dst_ip_country.str);
+    if (config.what_to_count_2 & COUNT_SRC_HOST_POCODE) fprintf(f, "%s%s", write_sep(sep, &count), data->src_ip_pocode.str);
+    if (config.what_to_count_2 & COUNT_DST_HOST_POCODE) fprintf(f, "%s%s", write_sep(sep, &count), data->dst_ip_pocode.str);
+#endif
 
-          vlen_prims_get(pvlen, COUNT_INT_SRC_AS_PATH, &str_ptr);
-          if (str_ptr) {
-            as_path = str_ptr;
-            while (as_path) {
-              as_path = strchr(str_ptr, ' ');
-              if (as_path) *as_path = '_';
-            }
+    if (config.what_to_count_2 & COUNT_SAMPLING_RATE) fprintf(f, "%s%u", write_sep(sep, &count), data->sampling_rate);
+    if (config.what_to_count_2 & COUNT_PKT_LEN_DISTRIB) fprintf(f, "%s%s", write_sep(sep, &count), config.pkt_len_distrib_bins[data->pkt_len_distrib]);
 
-          }
+    if (config.what_to_count_2 & COUNT_POST_NAT_SRC_HOST) {
+      addr_to_str(src_host, &pnat->post_nat_src_ip);
+      fprintf(f, "%s%s", write_sep(sep, &count), src_host);
+    }
+    if (config.what_to_count_2 & COUNT_POST_NAT_DST_HOST) {
+      addr_to_str(dst_host, &pnat->post_nat_dst_ip);
+      fprintf(f, "%s%s", write_sep(sep, &count), dst_host);
+    }
+    if (config.what_to_count_2 & COUNT_POST_NAT_SRC_PORT) fprintf(f, "%s%u", write_sep(sep, &count), pnat->post_nat_src_port);
+    if (config.what_to_count_2 & COUNT_POST_NAT_DST_PORT) fprintf(f, "%s%u", write_sep(sep, &count), pnat->post_nat_dst_port);
+    if (config.what_to_count_2 & COUNT_NAT_EVENT) fprintf(f, "%s%u", write_sep(sep, &count), pnat->nat_event);
 
-          P_fprintf_csv_string(f, pvlen, COUNT_INT_SRC_AS_PATH, write_sep(sep, &count), empty_string);
-        }
+    if (config.what_to_count_2 & COUNT_MPLS_LABEL_TOP) fprintf(f, "%s%u", write_sep(sep, &count), pmpls->mpls_label_top);
+    if (config.what_to_count_2 & COUNT_MPLS_LABEL_BOTTOM) fprintf(f, "%s%u", write_sep(sep, &count), pmpls->mpls_label_bottom);
+    if (config.what_to_count_2 & COUNT_MPLS_STACK_DEPTH) fprintf(f, "%s%u", write_sep(sep, &count), pmpls->mpls_stack_depth);
 
-        if (config.what_to_count & COUNT_LOCAL_PREF) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->local_pref);
-        if (config.what_to_count & COUNT_SRC_LOCAL_PREF) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->src_local_pref);
-        if (config.what_to_count & COUNT_MED) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->med);
-        if (config.what_to_count & COUNT_SRC_MED) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->src_med);
+    if (config.what_to_count_2 & COUNT_TUNNEL_SRC_HOST) {
+      addr_to_str(src_host, &ptun->tunnel_src_ip);
+      fprintf(f, "%s%s", write_sep(sep, &count), src_host);
+    }
+    if (config.what_to_count_2 & COUNT_TUNNEL_DST_HOST) {
+      addr_to_str(dst_host, &ptun->tunnel_dst_ip);
+      fprintf(f, "%s%s", write_sep(sep, &count), dst_host);
+    }
 
-        if (config.what_to_count & COUNT_PEER_SRC_AS) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->peer_src_as);
-        if (config.what_to_count & COUNT_PEER_DST_AS) fprintf(f, "%s%u", write_sep(sep, &count), pbgp->peer_dst_as);
-  
-        if (config.what_to_count & COUNT_PEER_SRC_IP) {
-          addr_to_str(ip_address, &pbgp->peer_src_ip);
-          fprintf(f, "%s%s", write_sep(sep, &count), ip_address);
-        }
-        if (config.what_to_count & COUNT_PEER_DST_IP) {
-          addr_to_str(ip_address, &pbgp->peer_dst_ip);
-          fprintf(f, "%s%s", write_sep(sep, &count), ip_address);
-        }
-  
-        if (config.what_to_count & COUNT_IN_IFACE) fprintf(f, "%s%u", write_sep(sep, &count), data->ifindex_in);
-        if (config.what_to_count & COUNT_OUT_IFACE) fprintf(f, "%s%u", write_sep(sep, &count), data->ifindex_out);
-  
-        if (config.what_to_count & COUNT_MPLS_VPN_RD) {
-          bgp_rd2str(rd_str, &pbgp->mpls_vpn_rd);
-          fprintf(f, "%s%s", write_sep(sep, &count), rd_str);
-        }
-  
-        if (config.what_to_count & (COUNT_SRC_HOST|COUNT_SUM_HOST)) {
-          addr_to_str(src_host, &data->src_ip);
-          fprintf(f, "%s%s", write_sep(sep, &count), src_host);
-        }
-        if (config.what_to_count & (COUNT_SRC_NET|COUNT_SUM_NET)) {
-          addr_to_str(src_host, &data->src_net);
-          fprintf(f, "%s%s", write_sep(sep, &count), src_host);
-        }
+    if (config.what_to_count_2 & COUNT_TUNNEL_IP_PROTO) {
+      if (!config.num_protos && (ptun->tunnel_proto < protocols_number))
+	fprintf(f, "%s%s", write_sep(sep, &count), _protocols[ptun->tunnel_proto].name);
+      else
+	fprintf(f, "%s%d", write_sep(sep, &count), ptun->tunnel_proto);
+    }
 
-        if (config.what_to_count & COUNT_DST_HOST) {
-          addr_to_str(dst_host, &data->dst_ip);
-          fprintf(f, "%s%s", write_sep(sep, &count), dst_host);
-        }
-        if (config.what_to_count & COUNT_DST_NET) {
-          addr_to_str(dst_host, &data->dst_net);
-          fprintf(f, "%s%s", write_sep(sep, &count), dst_host);
-        }
-  
-        if (config.what_to_count & COUNT_SRC_NMASK) fprintf(f, "%s%u", write_sep(sep, &count), data->src_nmask);
-        if (config.what_to_count & COUNT_DST_NMASK) fprintf(f, "%s%u", write_sep(sep, &count), data->dst_nmask);
-        if (config.what_to_count & (COUNT_SRC_PORT|COUNT_SUM_PORT)) fprintf(f, "%s%u", write_sep(sep, &count), data->src_port);
-        if (config.what_to_count & COUNT_DST_PORT) fprintf(f, "%s%u", write_sep(sep, &count), data->dst_port);
-        if (config.what_to_count & COUNT_TCPFLAGS) fprintf(f, "%s%u", write_sep(sep, &count), queue[j]->tcp_flags);
-  
-        if (config.what_to_count & COUNT_IP_PROTO) {
-          if (!config.num_protos && (data->proto < protocols_number))
-	    fprintf(f, "%s%s", write_sep(sep, &count), _protocols[data->proto].name);
-          else
-	    fprintf(f, "%s%d", write_sep(sep, &count), data->proto);
-        }
-  
-        if (config.what_to_count & COUNT_IP_TOS) fprintf(f, "%s%u", write_sep(sep, &count), data->tos);
-  
-  #if defined WITH_GEOIP
-        if (config.what_to_count_2 & COUNT_SRC_HOST_COUNTRY) fprintf(f, "%s%s", write_sep(sep, &count), GeoIP_code_by_id(data->src_ip_country.id));
-        if (config.what_to_count_2 & COUNT_DST_HOST_COUNTRY) fprintf(f, "%s%s", write_sep(sep, &count), GeoIP_code_by_id(data->dst_ip_country.id));
-  #endif
-  #if defined WITH_GEOIPV2
-        if (config.what_to_count_2 & COUNT_SRC_HOST_COUNTRY) fprintf(f, "%s%s", write_sep(sep, &count), data->src_ip_country.str);
-        if (config.what_to_count_2 & COUNT_DST_HOST_COUNTRY) fprintf(f, "%s%s", write_sep(sep, &count), data->dst_ip_country.str);
-        if (config.what_to_count_2 & COUNT_SRC_HOST_POCODE) fprintf(f, "%s%s", write_sep(sep, &count), data->src_ip_pocode.str);
-        if (config.what_to_count_2 & COUNT_DST_HOST_POCODE) fprintf(f, "%s%s", write_sep(sep, &count), data->dst_ip_pocode.str);
-  #endif
-  
-        if (config.what_to_count_2 & COUNT_SAMPLING_RATE) fprintf(f, "%s%u", write_sep(sep, &count), data->sampling_rate);
-        if (config.what_to_count_2 & COUNT_PKT_LEN_DISTRIB) fprintf(f, "%s%s", write_sep(sep, &count), config.pkt_len_distrib_bins[data->pkt_len_distrib]);
-  
-        if (config.what_to_count_2 & COUNT_POST_NAT_SRC_HOST) {
-          addr_to_str(src_host, &pnat->post_nat_src_ip);
-          fprintf(f, "%s%s", write_sep(sep, &count), src_host);
-        }
-        if (config.what_to_count_2 & COUNT_POST_NAT_DST_HOST) {
-          addr_to_str(dst_host, &pnat->post_nat_dst_ip);
-          fprintf(f, "%s%s", write_sep(sep, &count), dst_host);
-        }
-        if (config.what_to_count_2 & COUNT_POST_NAT_SRC_PORT) fprintf(f, "%s%u", write_sep(sep, &count), pnat->post_nat_src_port);
-        if (config.what_to_count_2 & COUNT_POST_NAT_DST_PORT) fprintf(f, "%s%u", write_sep(sep, &count), pnat->post_nat_dst_port);
-        if (config.what_to_count_2 & COUNT_NAT_EVENT) fprintf(f, "%s%u", write_sep(sep, &count), pnat->nat_event);
-  
-        if (config.what_to_count_2 & COUNT_MPLS_LABEL_TOP) fprintf(f, "%s%u", write_sep(sep, &count), pmpls->mpls_label_top);
-        if (config.what_to_count_2 & COUNT_MPLS_LABEL_BOTTOM) fprintf(f, "%s%u", write_sep(sep, &count), pmpls->mpls_label_bottom);
-        if (config.what_to_count_2 & COUNT_MPLS_STACK_DEPTH) fprintf(f, "%s%u", write_sep(sep, &count), pmpls->mpls_stack_depth);
+    if (config.what_to_count_2 & COUNT_TUNNEL_IP_TOS) fprintf(f, "%s%u", write_sep(sep, &count), ptun->tunnel_tos);
 
-	if (config.what_to_count_2 & COUNT_TUNNEL_SRC_HOST) {
-	  addr_to_str(src_host, &ptun->tunnel_src_ip);
-	  fprintf(f, "%s%s", write_sep(sep, &count), src_host);
-	}
-	if (config.what_to_count_2 & COUNT_TUNNEL_DST_HOST) {
-	  addr_to_str(dst_host, &ptun->tunnel_dst_ip);
-	  fprintf(f, "%s%s", write_sep(sep, &count), dst_host);
-	}
+    if (config.what_to_count_2 & COUNT_TIMESTAMP_START) {
+      char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
+      time_t time1;
+      struct tm *time2, time_tm;
 
-	if (config.what_to_count_2 & COUNT_TUNNEL_IP_PROTO) {
-	  if (!config.num_protos && (ptun->tunnel_proto < protocols_number))
-	    fprintf(f, "%s%s", write_sep(sep, &count), _protocols[ptun->tunnel_proto].name);
-	  else
-	    fprintf(f, "%s%d", write_sep(sep, &count), ptun->tunnel_proto);
-	}
+      if (config.timestamps_since_epoch) {
+        snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_start.tv_sec, pnat->timestamp_start.tv_usec);
+      }
+      else {
+        time1 = pnat->timestamp_start.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_start.tv_usec);
+      }
 
-	if (config.what_to_count_2 & COUNT_TUNNEL_IP_TOS) fprintf(f, "%s%u", write_sep(sep, &count), ptun->tunnel_tos);
-  
-        if (config.what_to_count_2 & COUNT_TIMESTAMP_START) {
-          char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
-          time_t time1;
-          struct tm *time2;
- 
-          if (config.timestamps_since_epoch) {
-            snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_start.tv_sec, pnat->timestamp_start.tv_usec);
-          }
-          else {
-            time1 = pnat->timestamp_start.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_start.tv_usec);
-	  }
+      fprintf(f, "%s%s", write_sep(sep, &count), buf2);
+    }
 
-          fprintf(f, "%s%s", write_sep(sep, &count), buf2);
-        }
-  
-        if (config.what_to_count_2 & COUNT_TIMESTAMP_END) {
-          char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
-          time_t time1;
-          struct tm *time2;
-  
-          if (config.timestamps_since_epoch) {
-            snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_end.tv_sec, pnat->timestamp_end.tv_usec);
-          }
-          else {
-            time1 = pnat->timestamp_end.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_end.tv_usec);
-	  }
+    if (config.what_to_count_2 & COUNT_TIMESTAMP_END) {
+      char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
+      time_t time1;
+      struct tm *time2, time_tm;
 
-          fprintf(f, "%s%s", write_sep(sep, &count), buf2);
-        }
+      if (config.timestamps_since_epoch) {
+        snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_end.tv_sec, pnat->timestamp_end.tv_usec);
+      }
+      else {
+        time1 = pnat->timestamp_end.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_end.tv_usec);
+      }
 
-        if (config.what_to_count_2 & COUNT_TIMESTAMP_ARRIVAL) {
-          char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
-          time_t time1;
-          struct tm *time2;
+      fprintf(f, "%s%s", write_sep(sep, &count), buf2);
+    }
 
-          if (config.timestamps_since_epoch) {
-            snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_arrival.tv_sec, pnat->timestamp_arrival.tv_usec);
-          }
-          else {
-            time1 = pnat->timestamp_arrival.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_arrival.tv_usec);
-          }
+    if (config.what_to_count_2 & COUNT_TIMESTAMP_ARRIVAL) {
+      char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
+      time_t time1;
+      struct tm *time2, time_tm;
 
-          fprintf(f, "%s%s", write_sep(sep, &count), buf2);
-        }
+      if (config.timestamps_since_epoch) {
+        snprintf(buf2, SRVBUFLEN, "%u.%u", pnat->timestamp_arrival.tv_sec, pnat->timestamp_arrival.tv_usec);
+      }
+      else {
+        time1 = pnat->timestamp_arrival.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, pnat->timestamp_arrival.tv_usec);
+      }
 
-        if (config.nfacctd_stitching && queue[j]->stitch) {
-          char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
-          time_t time1;
-          struct tm *time2;
+      fprintf(f, "%s%s", write_sep(sep, &count), buf2);
+    }
 
-          if (config.timestamps_since_epoch) {
-            snprintf(buf2, SRVBUFLEN, "%u.%u", queue[j]->stitch->timestamp_min.tv_sec, queue[j]->stitch->timestamp_min.tv_usec);
-	    fprintf(f, "%s%s", write_sep(sep, &count), buf2);
+    if (config.nfacctd_stitching && elem->stitch) {
+      char buf1[SRVBUFLEN], buf2[SRVBUFLEN];
+      time_t time1;
+      struct tm *time2, time_tm;
 
-            snprintf(buf2, SRVBUFLEN, "%u.%u", queue[j]->stitch->timestamp_max.tv_sec, queue[j]->stitch->timestamp_max.tv_usec);
-	    fprintf(f, "%s%s", write_sep(sep, &count), buf2);
-          }
-	  else {
-            time1 = queue[j]->stitch->timestamp_min.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, queue[j]->stitch->timestamp_min.tv_usec);
-            fprintf(f, "%s%s", write_sep(sep, &count), buf2);
-
-            time1 = queue[j]->stitch->timestamp_max.tv_sec;
-            time2 = localtime(&time1);
-            strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
-            snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, queue[j]->stitch->timestamp_max.tv_usec);
-            fprintf(f, "%s%s", write_sep(sep, &count), buf2);
-	  }
-        }
+      if (config.timestamps_since_epoch) {
+        snprintf(buf2, SRVBUFLEN, "%u.%u", elem->stitch->timestamp_min.tv_sec, elem->stitch->timestamp_min.tv_usec);
+	fprintf(f, "%s%s", write_sep(sep, &count), buf2);
 
-        if (config.what_to_count_2 & COUNT_EXPORT_PROTO_SEQNO) fprintf(f, "%s%u", write_sep(sep, &count), data->export_proto_seqno);
-        if (config.what_to_count_2 & COUNT_EXPORT_PROTO_VERSION) fprintf(f, "%s%u", write_sep(sep, &count), data->export_proto_version);
-  
-        /* all custom primitives printed here */
-        {
-          int cp_idx;
-  
-          for (cp_idx = 0; cp_idx < config.cpptrs.num; cp_idx++) {
-            if (config.cpptrs.primitive[cp_idx].ptr->len != PM_VARIABLE_LENGTH) {
-              char cp_str[SRVBUFLEN];
-
-	      custom_primitive_value_print(cp_str, SRVBUFLEN, pcust, &config.cpptrs.primitive[cp_idx], FALSE);
-              fprintf(f, "%s%s", write_sep(sep, &count), cp_str);
-	    }
-	    else {
-	      char *label_ptr = NULL;
-
-	      vlen_prims_get(pvlen, config.cpptrs.primitive[cp_idx].ptr->type, &label_ptr);
-	      if (!label_ptr) label_ptr = empty_string;
-	      fprintf(f, "%s%s", write_sep(sep, &count), label_ptr);
-	    }
-          }
-        }
-  
-        if (!is_event) {
-  #if defined HAVE_64BIT_COUNTERS
-          fprintf(f, "%s%llu", write_sep(sep, &count), queue[j]->packet_counter);
-          if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%s%llu", write_sep(sep, &count), queue[j]->flow_counter);
-          fprintf(f, "%s%llu\n", write_sep(sep, &count), queue[j]->bytes_counter);
-  #else
-          fprintf(f, "%s%lu", write_sep(sep, &count), queue[j]->packet_counter);
-          if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%s%lu", write_sep(sep, &count), queue[j]->flow_counter);
-          fprintf(f, "%s%lu\n", write_sep(sep, &count), queue[j]->bytes_counter);
-  #endif
-        }
-        else fprintf(f, "\n");
+        snprintf(buf2, SRVBUFLEN, "%u.%u", elem->stitch->timestamp_max.tv_sec, elem->stitch->timestamp_max.tv_usec);
+	fprintf(f, "%s%s", write_sep(sep, &count), buf2);
       }
-      else if (f && config.print_output & PRINT_OUTPUT_JSON) {
-#ifdef WITH_JANSSON
-	json_t *json_obj = json_object();
-	int idx;
-
-	for (idx = 0; idx < N_PRIMITIVES && cjhandler[idx]; idx++) cjhandler[idx](json_obj, queue[j]);
-        if (json_obj) write_and_free_json(f, json_obj);
-#endif
+      else {
+        time1 = elem->stitch->timestamp_min.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, elem->stitch->timestamp_min.tv_usec);
+        fprintf(f, "%s%s", write_sep(sep, &count), buf2);
+
+        time1 = elem->stitch->timestamp_max.tv_sec;
+        time2 = localtime_r(&time1, &time_tm);
+        strftime(buf1, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
+        snprintf(buf2, SRVBUFLEN, "%s.%u", buf1, elem->stitch->timestamp_max.tv_usec);
+        fprintf(f, "%s%s", write_sep(sep, &count), buf2);
       }
-      else if (f && config.print_output & PRINT_OUTPUT_AVRO) {
-#ifdef WITH_AVRO
-        avro_value_iface_t *avro_iface = avro_generic_class_from_schema(avro_acct_schema);
+    }
 
-        avro_value_t avro_value = compose_avro(config.what_to_count, config.what_to_count_2, queue[j]->flow_type,
-                         &queue[j]->primitives, pbgp, pnat, pmpls, ptun, pcust, pvlen, queue[j]->bytes_counter,
-                         queue[j]->packet_counter, queue[j]->flow_counter, queue[j]->tcp_flags, NULL,
-                         queue[j]->stitch, avro_iface);
+    if (config.what_to_count_2 & COUNT_EXPORT_PROTO_SEQNO) fprintf(f, "%s%u", write_sep(sep, &count), data->export_proto_seqno);
+    if (config.what_to_count_2 & COUNT_EXPORT_PROTO_VERSION) fprintf(f, "%s%u", write_sep(sep, &count), data->export_proto_version);
 
-        if (config.sql_table) {
-          if (avro_file_writer_append_value(avro_writer, &avro_value)) {
-            Log(LOG_ERR, "ERROR ( %s/%s ): AVRO: failed writing the value: %s\n",
-                config.name, config.type, avro_strerror());
-            exit_plugin(1);
-          }
-        }
-        else {
-          char *json_str;
+    /* all custom primitives printed here */
+    {
+      int cp_idx;
 
-          if (avro_value_to_json(&avro_value, TRUE, &json_str)) {
-            Log(LOG_ERR, "ERROR ( %s/%s ): AVRO: unable to value to JSON: %s\n",
-                config.name, config.type, avro_strerror());
-            exit_plugin(1);
-          }
+      for (cp_idx = 0; cp_idx < config.cpptrs.num; cp_idx++) {
+        if (config.cpptrs.primitive[cp_idx].ptr->len != PM_VARIABLE_LENGTH) {
+          char cp_str[SRVBUFLEN];
 
-          fprintf(f, "%s\n", json_str);
-          free(json_str);
-        }
+	  custom_primitive_value_print(cp_str, SRVBUFLEN, pcust, &config.cpptrs.primitive[cp_idx], FALSE);
+          fprintf(f, "%s%s", write_sep(sep, &count), cp_str);
+	}
+	else {
+	  char *label_ptr = NULL;
 
-        avro_value_iface_decref(avro_iface);
-        avro_value_decref(&avro_value);
+	  vlen_prims_get(pvlen, config.cpptrs.primitive[cp_idx].ptr->type, &label_ptr);
+	  if (!label_ptr) label_ptr = empty_string;
+	  fprintf(f, "%s%s", write_sep(sep, &count), label_ptr);
+	}
+      }
+    }
+
+    if (!is_event) {
+#if defined HAVE_64BIT_COUNTERS
+      fprintf(f, "%s%llu", write_sep(sep, &count), elem->packet_counter);
+      if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%s%llu", write_sep(sep, &count), elem->flow_counter);
+      fprintf(f, "%s%llu\n", write_sep(sep, &count), elem->bytes_counter);
 #else
-        if (config.debug) Log(LOG_DEBUG, "DEBUG ( %s/%s ): compose_avro(): AVRO object not created due to missing --enable-avro\n", config.name, config.type);
+      fprintf(f, "%s%lu", write_sep(sep, &count), elem->packet_counter);
+      if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%s%lu", write_sep(sep, &count), elem->flow_counter);
+      fprintf(f, "%s%lu\n", write_sep(sep, &count), elem->bytes_counter);
 #endif
-      }
     }
+    else fprintf(f, "\n");
   }
+  else if (config.print_output & PRINT_OUTPUT_JSON) {
+#ifdef WITH_JANSSON
+    json_t *json_obj = json_object();
+    int idx;
 
-  duration = time(NULL)-start;
+    for (idx = 0; idx < N_PRIMITIVES && cjhandler[idx]; idx++) cjhandler[idx](json_obj, elem);
+    if (json_obj) write_and_free_json(f, json_obj);
+#endif
+  }
+}
 
-  if (f && config.print_markers) {
-    if ((config.print_output & PRINT_OUTPUT_CSV) || (config.print_output & PRINT_OUTPUT_FORMATTED))
-      fprintf(f, "--END (%u)--\n", writer_pid);
-    else if (config.print_output & PRINT_OUTPUT_JSON) {
-      void *json_obj;
+#if defined ENABLE_THREADS && defined HAVE_OPEN_MEMSTREAM
+int P_cache_purge_threads_init(struct print_purge_threads *ppt, struct print_purge_empty *empty)
+{
+  memset(ppt, 0, sizeof(struct print_purge_threads));
 
-      json_obj = compose_purge_close_json(config.name, writer_pid, qn, saved_index, duration);
-      if (json_obj) write_and_free_json(f, json_obj);
-    }
+  ppt->num_workers = config.print_output_threads;
+  ppt->empty = empty;
+
+  ppt->workers = malloc(ppt->num_workers * sizeof(struct print_purge_worker));
+  if (!ppt->workers) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to malloc() print_output_threads workers. Purging single-threaded.\n", config.name, config.type);
+    return ERR;
   }
-    
-  if (config.sql_table) {
-#ifdef WITH_AVRO
-    if (config.print_output & PRINT_OUTPUT_AVRO)
-      avro_file_writer_flush(avro_writer);
-#endif
 
-    if (config.print_latest_file) {
-      if (!safe_action) {
-        memset(tmpbuf, 0, LONGLONGSRVBUFLEN);
-        handle_dynname_internal_strings(tmpbuf, LONGSRVBUFLEN, config.print_latest_file, &prim_ptrs);
-        link_latest_output_file(tmpbuf, current_table);
-      }
-    }
+  memset(ppt->workers, 0, ppt->num_workers * sizeof(struct print_purge_worker));
 
-#ifdef WITH_AVRO
-    if (config.print_output & PRINT_OUTPUT_AVRO) {
-      avro_file_writer_close(avro_writer);
+  ppt->pool = allocate_thread_pool(ppt->num_workers);
+  if (!ppt->pool) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to allocate print_output_threads pool. Purging single-threaded.\n", config.name, config.type);
+    free(ppt->workers);
+    ppt->workers = NULL;
+    return ERR;
+  }
+
+  pthread_mutex_init(&ppt->mutex, NULL);
+  pthread_cond_init(&ppt->cond, NULL);
+
+  return SUCCESS;
+}
+
+void P_cache_purge_threads_destroy(struct print_purge_threads *ppt)
+{
+  deallocate_thread_pool(&ppt->pool);
+
+  pthread_mutex_destroy(&ppt->mutex);
+  pthread_cond_destroy(&ppt->cond);
+
+  if (ppt->workers) free(ppt->workers);
+  ppt->workers = NULL;
+}
+
+/*
+   Splits the (compacted) purge queue in chunks of PRINT_PURGE_CHUNK_ENTRIES
+   entries; each worker picks the next available chunk, formats it into its
+   own memory stream and writes it out to 'f'. Unless
+   print_output_threads_unordered is set, chunks are written in the original
+   queue order, ie. a worker waits for all preceding chunks to be written.
+*/
+void P_cache_purge_threads(struct print_purge_threads *ppt, FILE *f, struct chained_cache *queue[], int index, int is_event)
+{
+  int idx;
+
+  ppt->f = f;
+  ppt->is_event = is_event;
+  ppt->queue = queue;
+  ppt->index = index;
+  ppt->next_chunk = 0;
+  ppt->next_write = 0;
+  ppt->num_chunks = (index + PRINT_PURGE_CHUNK_ENTRIES - 1) / PRINT_PURGE_CHUNK_ENTRIES;
+  ppt->active = ppt->num_workers;
+
+  for (idx = 0; idx < ppt->num_workers; idx++) {
+    ppt->workers[idx].ppt = ppt;
+    send_to_pool(ppt->pool, P_cache_purge_worker, &ppt->workers[idx]);
+  }
+
+  pthread_mutex_lock(&ppt->mutex);
+  while (ppt->active) pthread_cond_wait(&ppt->cond, &ppt->mutex);
+  pthread_mutex_unlock(&ppt->mutex);
+}
+
+void P_cache_purge_worker(struct print_purge_worker *ppw)
+{
+  struct print_purge_threads *ppt = ppw->ppt;
+  struct timeval t_start, t_end;
+  char *buf = NULL;
+  size_t buflen = 0;
+  FILE *mf;
+  int chunk, idx, last;
+
+  for (;;) {
+    pthread_mutex_lock(&ppt->mutex);
+    chunk = ppt->next_chunk;
+    if (chunk < ppt->num_chunks) ppt->next_chunk++;
+    pthread_mutex_unlock(&ppt->mutex);
+
+    if (chunk >= ppt->num_chunks) break;
+
+    idx = chunk * PRINT_PURGE_CHUNK_ENTRIES;
+    last = MIN(idx + PRINT_PURGE_CHUNK_ENTRIES, ppt->index);
+
+    gettimeofday(&t_start, NULL);
+
+    mf = open_memstream(&buf, &buflen);
+    if (!mf) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): P_cache_purge_worker(): open_memstream() failed: %s\n", config.name, config.type, strerror(errno));
+      buf = NULL;
+      buflen = 0;
     }
-#endif
     else {
-      if (f) close_output_file(f);
+      for (; idx < last; idx++) P_cache_purge_entry(mf, ppt->queue[idx], ppt->empty, ppt->is_event);
+      fclose(mf);
     }
-  }
-  else {
-    /* writing to stdout: releasing lock */
-    fflush(f);
-    close_output_file(lockf);
+
+    gettimeofday(&t_end, NULL);
+    ppw->records += (last - (chunk * PRINT_PURGE_CHUNK_ENTRIES));
+    ppw->usecs += ((t_end.tv_sec - t_start.tv_sec) * 1000000) + (t_end.tv_usec - t_start.tv_usec);
+
+    pthread_mutex_lock(&ppt->mutex);
+    if (!config.print_output_threads_unordered) {
+      while (ppt->next_write != chunk) pthread_cond_wait(&ppt->cond, &ppt->mutex);
+    }
+
+    if (buf && buflen) fwrite(buf, 1, buflen, ppt->f);
+    ppt->next_write++;
+    pthread_cond_broadcast(&ppt->cond);
+    pthread_mutex_unlock(&ppt->mutex);
+
+    if (buf) free(buf);
+    buf = NULL;
+    buflen = 0;
   }
 
-  /* If we have pending queries then start again */
-  if (pqq_ptr) goto start;
+  pthread_mutex_lock(&ppt->mutex);
+  ppt->active--;
+  pthread_cond_broadcast(&ppt->cond);
+  pthread_mutex_unlock(&ppt->mutex);
+}
 
-  Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %u) ***\n",
-		config.name, config.type, writer_pid, qn, saved_index, duration);
+void P_cache_purge_threads_rps(struct print_purge_threads *ppt, char *buf, int len)
+{
+  u_int64_t rps;
+  int idx, ret, off = 0;
 
-  if (config.sql_trigger_exec && !safe_action) P_trigger_exec(config.sql_trigger_exec); 
+  memset(buf, 0, len);
+
+  for (idx = 0; idx < ppt->num_workers && off < len; idx++) {
+    if (ppt->workers[idx].usecs) rps = (ppt->workers[idx].records * 1000000) / ppt->workers[idx].usecs;
+    else rps = ppt->workers[idx].records;
 
-  if (empty_pcust) free(empty_pcust);
+    ret = snprintf(buf + off, len - off, "%s%llu", (idx ? "/" : ""), (unsigned long long) rps);
+    if (ret > 0) off += ret;
+  }
 }
+#endif
 
 void P_write_stats_header_formatted(FILE *f, int is_event)
 {
@@ -1619,6 +1830,14 @@ void P_write_stats_header_csv(FILE *f, int is_event)
   else fprintf(f, "\n");
 }
 
+void P_fprintf_csv_label(FILE *f, struct pkt_primitives *data, struct pkt_vlen_hdr_primitives *pvlen, char *sep, char *empty_string)
+{
+  char *string_ptr = pretag_label_get(data, pvlen);
+
+  if (!string_ptr) string_ptr = empty_string;
+  fprintf(f, "%s%s", sep, string_ptr);
+}
+
 void P_fprintf_csv_string(FILE *f, struct pkt_vlen_hdr_primitives *pvlen, pm_cfgreg_t wtc, char *sep, char *empty_string)
 {
   char *string_ptr = NULL;
@@ -21,6 +21,48 @@
 
 /* includes */
 #include <sys/poll.h>
+#if defined ENABLE_THREADS
+#include "thread_pool.h"
+#endif
+
+/* defines */
+#define PRINT_PURGE_CHUNK_ENTRIES	4096
+
+/* structures */
+struct print_purge_empty {
+  struct pkt_bgp_primitives pbgp;
+  struct pkt_nat_primitives pnat;
+  struct pkt_mpls_primitives pmpls;
+  struct pkt_tunnel_primitives ptun;
+  char *pcust;
+};
+
+#if defined ENABLE_THREADS
+struct print_purge_worker {
+  struct print_purge_threads *ppt;
+  u_int64_t records;
+  u_int64_t usecs;
+};
+
+struct print_purge_threads {
+  thread_pool_t *pool;
+  struct print_purge_worker *workers;
+  int num_workers;
+  int active;
+
+  FILE *f;
+  struct chained_cache **queue;
+  struct print_purge_empty *empty;
+  int index;
+  int is_event;
+  int num_chunks;
+  int next_chunk;
+  int next_write;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+#endif
 
 /* prototypes */
 #if (!defined __PRINT_PLUGIN_C)
@@ -30,9 +72,18 @@
 #endif
 EXT void print_plugin(int, struct configuration *, void *);
 EXT void P_cache_purge(struct chained_cache *[], int, int);
+EXT void P_cache_purge_entry(FILE *, struct chained_cache *, struct print_purge_empty *, int);
+#if defined ENABLE_THREADS
+EXT int P_cache_purge_threads_init(struct print_purge_threads *, struct print_purge_empty *);
+EXT void P_cache_purge_threads_destroy(struct print_purge_threads *);
+EXT void P_cache_purge_threads(struct print_purge_threads *, FILE *, struct chained_cache *[], int, int);
+EXT void P_cache_purge_worker(struct print_purge_worker *);
+EXT void P_cache_purge_threads_rps(struct print_purge_threads *, char *, int);
+#endif
 EXT void P_write_stats_header_formatted(FILE *, int);
 EXT void P_write_stats_header_csv(FILE *, int);
 EXT void P_fprintf_csv_string(FILE *, struct pkt_vlen_hdr_primitives *, pm_cfgreg_t, char *, char *);
+EXT void P_fprintf_csv_label(FILE *, struct pkt_primitives *, struct pkt_vlen_hdr_primitives *, char *, char *);
 #undef EXT
 
 /* global variables */
@@ -0,0 +1,641 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+#define __REGEXP_DFA_C
+
+/* includes */
+#include "pmacct.h"
+#include "regexp_dfa.h"
+#include "jhash.h"
+
+/* defines */
+#define DFA_AT_START	0x01
+#define DFA_AT_END	0x02
+
+/* structures */
+struct dfa_frag {
+  int start;
+  int end;	/* NFA_EPS node whose 'out' is still to be patched */
+};
+
+/* global variables */
+static PM_TLS struct pm_dfa_cache *dfa_cache = NULL;
+
+/* Functions */
+static int dfa_node(struct pm_dfa *dfa, u_int8_t type)
+{
+  struct pm_nfa_node *nodes;
+  u_int32_t max;
+
+  if (dfa->num_nodes == dfa->max_nodes) {
+    max = dfa->max_nodes ? dfa->max_nodes*2 : 1024;
+    nodes = realloc(dfa->nodes, max*sizeof(struct pm_nfa_node));
+    if (!nodes) return ERR;
+
+    dfa->nodes = nodes;
+    dfa->max_nodes = max;
+  }
+
+  memset(&dfa->nodes[dfa->num_nodes], 0, sizeof(struct pm_nfa_node));
+  dfa->nodes[dfa->num_nodes].type = type;
+  dfa->nodes[dfa->num_nodes].out = -1;
+  dfa->nodes[dfa->num_nodes].out1 = -1;
+
+  return dfa->num_nodes++;
+}
+
+static int dfa_set(struct pm_dfa *dfa, u_int8_t *bits)
+{
+  u_int8_t (*sets)[32];
+  u_int32_t max;
+
+  if (dfa->num_sets == dfa->max_sets) {
+    max = dfa->max_sets ? dfa->max_sets*2 : 64;
+    sets = realloc(dfa->sets, max*32);
+    if (!sets) return ERR;
+
+    dfa->sets = sets;
+    dfa->max_sets = max;
+  }
+
+  memcpy(dfa->sets[dfa->num_sets], bits, 32);
+
+  return dfa->num_sets++;
+}
+
+/* single node fragment: 'type' followed by an open end */
+static int dfa_frag_single(struct pm_dfa *dfa, u_int8_t type, struct dfa_frag *f)
+{
+  int n, e;
+
+  if ((n = dfa_node(dfa, type)) == ERR) return ERR;
+  if ((e = dfa_node(dfa, NFA_EPS)) == ERR) return ERR;
+
+  dfa->nodes[n].out = e;
+  f->start = n;
+  f->end = e;
+
+  return SUCCESS;
+}
+
+static int dfa_parse_reg(struct pm_dfa *, char **, int, struct dfa_frag *);
+
+/*
+   The parser follows pm_regcomp() in regexp.c so that anything it accepts
+   is read the same way: '^', '$', '.', bracket expressions (ranges, leading
+   ']' or '-', complement), groups, alternation, '*', '+', '?' and '\'
+   quoting a single char. Everything else is a literal.
+*/
+static int dfa_parse_class(struct pm_dfa *dfa, char **pp, struct dfa_frag *f)
+{
+  u_char *p = (u_char *) *pp;
+  u_int8_t bits[32];
+  int negate = FALSE, lo, hi, idx, set;
+
+  memset(bits, 0, sizeof(bits));
+
+  if (*p == '^') {
+    negate = TRUE;
+    p++;
+  }
+
+  if (*p == ']' || *p == '-') {
+    bits[*p >> 3] |= (1 << (*p & 7));
+    p++;
+  }
+
+  while (*p != '\0' && *p != ']') {
+    if (*p == '-') {
+      p++;
+      if (*p == ']' || *p == '\0') bits['-' >> 3] |= (1 << ('-' & 7));
+      else {
+        lo = *(p-2)+1;
+        hi = *p;
+        if (lo > hi+1) return ERR;
+        for (; lo <= hi; lo++) bits[lo >> 3] |= (1 << (lo & 7));
+        p++;
+      }
+    }
+    else {
+      bits[*p >> 3] |= (1 << (*p & 7));
+      p++;
+    }
+  }
+
+  if (*p != ']') return ERR;
+  p++;
+
+  if (negate) for (idx = 0; idx < 32; idx++) bits[idx] = ~bits[idx];
+  bits[0] &= ~1; /* NUL never gets to the matcher */
+
+  if ((set = dfa_set(dfa, bits)) == ERR) return ERR;
+  if (dfa_frag_single(dfa, NFA_SET, f) == ERR) return ERR;
+  dfa->nodes[f->start].set = set;
+
+  *pp = (char *) p;
+
+  return SUCCESS;
+}
+
+static int dfa_parse_atom(struct pm_dfa *dfa, char **pp, struct dfa_frag *f)
+{
+  u_int8_t bits[32];
+  char c = *(*pp)++;
+  int set;
+
+  switch (c) {
+  case '^':
+    return dfa_frag_single(dfa, NFA_BOL, f);
+  case '$':
+    return dfa_frag_single(dfa, NFA_EOL, f);
+  case '.':
+    memset(bits, 0xff, sizeof(bits));
+    bits[0] &= ~1;
+    if ((set = dfa_set(dfa, bits)) == ERR) return ERR;
+    if (dfa_frag_single(dfa, NFA_SET, f) == ERR) return ERR;
+    dfa->nodes[f->start].set = set;
+    return SUCCESS;
+  case '[':
+    return dfa_parse_class(dfa, pp, f);
+  case '(':
+    return dfa_parse_reg(dfa, pp, TRUE, f);
+  case '\0':
+  case '|':
+  case ')':
+  case '?':
+  case '+':
+  case '*':
+    return ERR;
+  case '\\':
+    if (**pp == '\0') return ERR;
+    c = *(*pp)++;
+    /* fall through */
+  default:
+    if (dfa_frag_single(dfa, NFA_LITERAL, f) == ERR) return ERR;
+    dfa->nodes[f->start].c = (u_char) c;
+    return SUCCESS;
+  }
+}
+
+static int dfa_parse_piece(struct pm_dfa *dfa, char **pp, struct dfa_frag *f)
+{
+  struct dfa_frag atom;
+  char op;
+  int split, end;
+
+  if (dfa_parse_atom(dfa, pp, &atom) == ERR) return ERR;
+
+  op = **pp;
+  if (op != '*' && op != '+' && op != '?') {
+    *f = atom;
+    return SUCCESS;
+  }
+
+  (*pp)++;
+  if (**pp == '*' || **pp == '+' || **pp == '?') return ERR;
+
+  if ((split = dfa_node(dfa, NFA_SPLIT)) == ERR) return ERR;
+  if ((end = dfa_node(dfa, NFA_EPS)) == ERR) return ERR;
+
+  dfa->nodes[split].out = atom.start;
+  dfa->nodes[split].out1 = end;
+  dfa->nodes[atom.end].out = (op == '?') ? end : split;
+
+  f->start = (op == '+') ? atom.start : split;
+  f->end = end;
+
+  return SUCCESS;
+}
+
+static int dfa_parse_branch(struct pm_dfa *dfa, char **pp, struct dfa_frag *f)
+{
+  struct dfa_frag piece;
+  int e;
+
+  if ((e = dfa_node(dfa, NFA_EPS)) == ERR) return ERR;
+  f->start = f->end = e;
+
+  while (**pp != '\0' && **pp != '|' && **pp != ')') {
+    if (dfa_parse_piece(dfa, pp, &piece) == ERR) return ERR;
+
+    dfa->nodes[f->end].out = piece.start;
+    f->end = piece.end;
+  }
+
+  return SUCCESS;
+}
+
+static int dfa_parse_reg(struct pm_dfa *dfa, char **pp, int paren, struct dfa_frag *f)
+{
+  struct dfa_frag alt;
+  int split, end;
+
+  if (dfa_parse_branch(dfa, pp, f) == ERR) return ERR;
+
+  while (**pp == '|') {
+    (*pp)++;
+    if (dfa_parse_branch(dfa, pp, &alt) == ERR) return ERR;
+
+    if ((split = dfa_node(dfa, NFA_SPLIT)) == ERR) return ERR;
+    if ((end = dfa_node(dfa, NFA_EPS)) == ERR) return ERR;
+
+    dfa->nodes[split].out = f->start;
+    dfa->nodes[split].out1 = alt.start;
+    dfa->nodes[f->end].out = end;
+    dfa->nodes[alt.end].out = end;
+
+    f->start = split;
+    f->end = end;
+  }
+
+  if (paren) {
+    if (**pp != ')') return ERR;
+    (*pp)++;
+  }
+  else if (**pp != '\0') return ERR;
+
+  return SUCCESS;
+}
+
+struct pm_dfa *pm_dfa_new()
+{
+  struct pm_dfa *dfa;
+
+  dfa = malloc(sizeof(struct pm_dfa));
+  if (dfa) {
+    memset(dfa, 0, sizeof(struct pm_dfa));
+    dfa->start = -1;
+  }
+
+  return dfa;
+}
+
+/* pm_dfa_add() adds a pattern, in the form pm_regcomp() takes it, to be
+   reported as 'id' (> 0) when matching; lower ids win when several patterns
+   match the same input. Returns ERR if the pattern can't be handled, in
+   which case the automaton is left untouched */
+int pm_dfa_add(struct pm_dfa *dfa, char *pattern, int id)
+{
+  u_int32_t saved_nodes = dfa->num_nodes, saved_sets = dfa->num_sets;
+  struct dfa_frag f;
+  char *p = pattern;
+  int match, split;
+
+  if (id <= 0 || dfa_parse_reg(dfa, &p, FALSE, &f) == ERR) goto rollback;
+
+  if ((match = dfa_node(dfa, NFA_MATCH)) == ERR) goto rollback;
+  dfa->nodes[match].id = id;
+  dfa->nodes[f.end].out = match;
+
+  if (dfa->start == -1) dfa->start = f.start;
+  else {
+    if ((split = dfa_node(dfa, NFA_SPLIT)) == ERR) goto rollback;
+    dfa->nodes[split].out = dfa->start;
+    dfa->nodes[split].out1 = f.start;
+    dfa->start = split;
+  }
+
+  if (!dfa->min_id || id < dfa->min_id) dfa->min_id = id;
+  dfa->num_patterns++;
+
+  return SUCCESS;
+
+  rollback:
+  dfa->num_nodes = saved_nodes;
+  dfa->num_sets = saved_sets;
+
+  return ERR;
+}
+
+/* splits byte classes so that every byte in a class is either in 'bits'
+   or not */
+static void dfa_refine(u_int8_t *cls, int *num_classes, u_int8_t *bits)
+{
+  int remap[256][2], idx, in, num = 0;
+
+  memset(remap, 0xff, sizeof(remap));
+
+  for (idx = 0; idx < 256; idx++) {
+    in = (bits[idx >> 3] & (1 << (idx & 7))) ? 1 : 0;
+    if (remap[cls[idx]][in] == -1) remap[cls[idx]][in] = num++;
+    cls[idx] = remap[cls[idx]][in];
+  }
+
+  *num_classes = num;
+}
+
+/* pm_dfa_compile() is to be called once all patterns are added: it works
+   out byte classes for the transition tables */
+void pm_dfa_compile(struct pm_dfa *dfa)
+{
+  u_int8_t cls[256], bits[32], used[256];
+  u_int32_t idx;
+  int b, num = 1;
+
+  memset(cls, 0, sizeof(cls));
+  memset(used, 0, sizeof(used));
+
+  for (idx = 0; idx < dfa->num_nodes; idx++) {
+    if (dfa->nodes[idx].type == NFA_LITERAL) used[dfa->nodes[idx].c] = TRUE;
+  }
+
+  for (b = 0; b < 256; b++) {
+    if (!used[b]) continue;
+
+    memset(bits, 0, sizeof(bits));
+    bits[b >> 3] |= (1 << (b & 7));
+    dfa_refine(cls, &num, bits);
+  }
+
+  for (idx = 0; idx < dfa->num_sets; idx++) dfa_refine(cls, &num, dfa->sets[idx]);
+
+  /* payloads are matched lowercase */
+  for (b = 0; b < 256; b++) {
+    dfa->bmap[b] = cls[isascii(b) ? tolower(b) : b];
+    dfa->rep[cls[b]] = b;
+  }
+
+  dfa->num_classes = num;
+}
+
+static void dfa_closure(struct pm_dfa_cache *c, int from, int flags, int *out, u_int32_t *num)
+{
+  struct pm_nfa_node *nodes = c->dfa->nodes;
+  int sp = 0, n;
+
+  if (from < 0 || c->mark[from] == c->gen) return;
+
+  c->mark[from] = c->gen;
+  c->stack[sp++] = from;
+
+  while (sp) {
+    n = c->stack[--sp];
+
+    switch (nodes[n].type) {
+    case NFA_BOL:
+      if (!(flags & DFA_AT_START)) break;
+      /* fall through */
+    case NFA_EPS:
+      if (nodes[n].out >= 0 && c->mark[nodes[n].out] != c->gen) {
+        c->mark[nodes[n].out] = c->gen;
+        c->stack[sp++] = nodes[n].out;
+      }
+      break;
+    case NFA_SPLIT:
+      if (nodes[n].out >= 0 && c->mark[nodes[n].out] != c->gen) {
+        c->mark[nodes[n].out] = c->gen;
+        c->stack[sp++] = nodes[n].out;
+      }
+      if (nodes[n].out1 >= 0 && c->mark[nodes[n].out1] != c->gen) {
+        c->mark[nodes[n].out1] = c->gen;
+        c->stack[sp++] = nodes[n].out1;
+      }
+      break;
+    case NFA_EOL:
+      if (flags & DFA_AT_END) {
+        if (nodes[n].out >= 0 && c->mark[nodes[n].out] != c->gen) {
+          c->mark[nodes[n].out] = c->gen;
+          c->stack[sp++] = nodes[n].out;
+        }
+        break;
+      }
+      /* fall through */
+    default:
+      out[(*num)++] = n;
+      break;
+    }
+  }
+}
+
+static void dfa_next_gen(struct pm_dfa_cache *c)
+{
+  c->gen++;
+  if (!c->gen) {
+    memset(c->mark, 0, c->dfa->num_nodes*sizeof(u_int32_t));
+    c->gen = 1;
+  }
+}
+
+static int dfa_cmp_int(const void *a, const void *b)
+{
+  return (*(int *)a - *(int *)b);
+}
+
+static void dfa_cache_flush(struct pm_dfa_cache *c)
+{
+  u_int32_t idx;
+
+  for (idx = 0; idx < c->num_states; idx++) free(c->states[idx]);
+
+  memset(c->buckets, 0, sizeof(c->buckets));
+  c->num_states = 0;
+  c->size = 0;
+  c->initial = NULL;
+  c->flushes++;
+}
+
+/* dfa_state() returns the DFA state for the set of NFA nodes in 'set',
+   building it if needed; the initial state is kept apart since '^' holds
+   there only. Returns NULL if out of memory */
+static struct pm_dfa_state *dfa_state(struct pm_dfa_cache *c, int *set, u_int32_t num, int initial)
+{
+  struct pm_dfa *dfa = c->dfa;
+  struct pm_dfa_state *s, **states;
+  u_int32_t hash, idx, eol_num, max;
+  size_t len;
+
+  qsort(set, num, sizeof(int), dfa_cmp_int);
+  hash = jhash2((u_int32_t *) set, num, 0);
+
+  if (!initial) {
+    for (s = c->buckets[hash % DFA_HASH_SIZE]; s; s = s->hnext) {
+      if (s->hash == hash && s->num == num && !memcmp(s->nodes, set, num*sizeof(int))) return s;
+    }
+  }
+
+  len = sizeof(struct pm_dfa_state) + (num + dfa->num_classes)*sizeof(int);
+  if (c->size + len > DFA_CACHE_SIZE && c->num_states) dfa_cache_flush(c);
+
+  if (c->num_states == c->max_states) {
+    max = c->max_states ? c->max_states*2 : 256;
+    states = realloc(c->states, max*sizeof(struct pm_dfa_state *));
+    if (!states) return NULL;
+
+    c->states = states;
+    c->max_states = max;
+  }
+
+  if (!(s = malloc(len))) return NULL;
+
+  s->hash = hash;
+  s->num = num;
+  s->next = (int *) (s + 1);
+  s->nodes = s->next + dfa->num_classes;
+  memset(s->next, 0xff, dfa->num_classes*sizeof(int));
+  memcpy(s->nodes, set, num*sizeof(int));
+
+  s->accept = 0;
+  s->eol_accept = 0;
+  eol_num = 0;
+  dfa_next_gen(c);
+
+  for (idx = 0; idx < num; idx++) {
+    if (dfa->nodes[set[idx]].type == NFA_MATCH) {
+      if (!s->accept || dfa->nodes[set[idx]].id < s->accept) s->accept = dfa->nodes[set[idx]].id;
+    }
+    else if (dfa->nodes[set[idx]].type == NFA_EOL) {
+      dfa_closure(c, dfa->nodes[set[idx]].out, DFA_AT_END | (initial ? DFA_AT_START : 0), c->aux, &eol_num);
+    }
+  }
+
+  s->eol_accept = s->accept;
+  for (idx = 0; idx < eol_num; idx++) {
+    if (dfa->nodes[c->aux[idx]].type == NFA_MATCH) {
+      if (!s->eol_accept || dfa->nodes[c->aux[idx]].id < s->eol_accept) s->eol_accept = dfa->nodes[c->aux[idx]].id;
+    }
+  }
+
+  if (!initial) {
+    s->hnext = c->buckets[hash % DFA_HASH_SIZE];
+    c->buckets[hash % DFA_HASH_SIZE] = s;
+  }
+  else s->hnext = NULL;
+
+  s->idx = c->num_states;
+  c->states[c->num_states++] = s;
+  c->size += len;
+
+  return s;
+}
+
+static struct pm_dfa_state *dfa_initial(struct pm_dfa_cache *c)
+{
+  u_int32_t num = 0;
+
+  dfa_next_gen(c);
+  dfa_closure(c, c->dfa->start, DFA_AT_START, c->set, &num);
+
+  return dfa_state(c, c->set, num, TRUE);
+}
+
+/* dfa_step() builds the transition out of 's' on byte class 'k' */
+static struct pm_dfa_state *dfa_step(struct pm_dfa_cache *c, struct pm_dfa_state *s, int k)
+{
+  struct pm_dfa *dfa = c->dfa;
+  struct pm_nfa_node *n;
+  struct pm_dfa_state *t;
+  u_int32_t idx, num = 0, flushes = c->flushes;
+  u_int8_t b = dfa->rep[k];
+
+  dfa_next_gen(c);
+
+  for (idx = 0; idx < s->num; idx++) {
+    n = &dfa->nodes[s->nodes[idx]];
+
+    if ((n->type == NFA_LITERAL && n->c == b) ||
+        (n->type == NFA_SET && (dfa->sets[n->set][b >> 3] & (1 << (b & 7)))))
+      dfa_closure(c, n->out, 0, c->set, &num);
+  }
+
+  /* unanchored: a match can start at any position */
+  for (idx = 0; idx < c->num_restart; idx++) {
+    if (c->mark[c->restart[idx]] != c->gen) {
+      c->mark[c->restart[idx]] = c->gen;
+      c->set[num++] = c->restart[idx];
+    }
+  }
+
+  t = dfa_state(c, c->set, num, FALSE);
+
+  /* if the cache got flushed 's' is gone: nothing to link */
+  if (t && flushes == c->flushes) s->next[k] = t->idx;
+
+  return t;
+}
+
+static struct pm_dfa_cache *dfa_cache_get(struct pm_dfa *dfa)
+{
+  struct pm_dfa_cache *c = dfa_cache;
+
+  if (c && c->dfa == dfa) return c;
+
+  if (!(c = malloc(sizeof(struct pm_dfa_cache)))) return NULL;
+  memset(c, 0, sizeof(struct pm_dfa_cache));
+
+  c->dfa = dfa;
+  c->mark = calloc(dfa->num_nodes, sizeof(u_int32_t));
+  c->stack = malloc(dfa->num_nodes*sizeof(int));
+  c->set = malloc(dfa->num_nodes*sizeof(int));
+  c->aux = malloc(dfa->num_nodes*sizeof(int));
+  c->restart = malloc(dfa->num_nodes*sizeof(int));
+
+  if (!c->mark || !c->stack || !c->set || !c->aux || !c->restart) {
+    free(c->mark);
+    free(c->stack);
+    free(c->set);
+    free(c->aux);
+    free(c->restart);
+    free(c);
+    return NULL;
+  }
+
+  dfa_next_gen(c);
+  dfa_closure(c, dfa->start, 0, c->restart, &c->num_restart);
+
+  dfa_cache = c;
+
+  return c;
+}
+
+/* pm_dfa_exec() scans 'buf' once, skipping NUL bytes and stopping after
+   'max' non-NUL ones, and returns the lowest id among the patterns that
+   match, 0 if none does */
+int pm_dfa_exec(struct pm_dfa *dfa, u_char *buf, int len, int max)
+{
+  struct pm_dfa_cache *c;
+  struct pm_dfa_state *s;
+  int x, y, best, k;
+
+  if (!dfa || !dfa->num_patterns) return 0;
+  if (!(c = dfa_cache_get(dfa))) return 0;
+
+  if (!c->initial && !(c->initial = dfa_initial(c))) return 0;
+
+  s = c->initial;
+  best = s->accept;
+
+  for (x = 0, y = 0; x < len && y < max; x++) {
+    if (!buf[x]) continue;
+    if (best == dfa->min_id) return best;
+
+    k = dfa->bmap[buf[x]];
+    if (s->next[k] >= 0) s = c->states[s->next[k]];
+    else if (!(s = dfa_step(c, s, k))) return best;
+
+    if (s->accept && (!best || s->accept < best)) best = s->accept;
+    y++;
+  }
+
+  if (s->eol_accept && (!best || s->eol_accept < best)) best = s->eol_accept;
+
+  return best;
+}
@@ -0,0 +1,111 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+#ifndef _REGEXP_DFA_H_
+#define _REGEXP_DFA_H_
+
+/* defines */
+#define DFA_CACHE_SIZE		(8*1024*1024)	/* bytes of DFA states per thread */
+#define DFA_HASH_SIZE		4096
+
+#define NFA_EPS			0
+#define NFA_SPLIT		1
+#define NFA_LITERAL		2
+#define NFA_SET			3
+#define NFA_BOL			4
+#define NFA_EOL			5
+#define NFA_MATCH		6
+
+/* structures */
+struct pm_nfa_node {
+  u_int8_t type;
+  u_int8_t c;				/* NFA_LITERAL: byte */
+  u_int32_t set;			/* NFA_SET: index in sets */
+  int out;
+  int out1;				/* NFA_SPLIT only */
+  int id;				/* NFA_MATCH: pattern id */
+};
+
+/*
+   All the patterns loaded are compiled in a single Thompson NFA whose
+   entry node branches off to each of them; matching runs a DFA which is
+   built lazily out of it, one state at a time, and cached per thread.
+   Input bytes are case-folded and mapped to equivalence classes before
+   being looked up in the transition table; NUL bytes are skipped.
+*/
+struct pm_dfa {
+  struct pm_nfa_node *nodes;
+  u_int32_t num_nodes;
+  u_int32_t max_nodes;
+  u_int8_t (*sets)[32];
+  u_int32_t num_sets;
+  u_int32_t max_sets;
+  int start;
+  int num_patterns;
+  int min_id;
+  u_int8_t bmap[256];			/* input byte -> byte class */
+  u_int8_t rep[256];			/* byte class -> a byte in it */
+  int num_classes;
+};
+
+struct pm_dfa_state {
+  struct pm_dfa_state *hnext;
+  u_int32_t hash;
+  u_int32_t idx;			/* position in states */
+  u_int32_t num;			/* NFA nodes in this state */
+  int accept;				/* lowest pattern id matched once here, 0 if none */
+  int eol_accept;			/* same, if the input ends here */
+  int *nodes;
+  int *next;				/* per byte class: index in states, -1 if not yet built */
+};
+
+struct pm_dfa_cache {
+  struct pm_dfa *dfa;
+  struct pm_dfa_state **states;
+  u_int32_t num_states;
+  u_int32_t max_states;
+  size_t size;
+  u_int32_t flushes;
+  struct pm_dfa_state *initial;
+  struct pm_dfa_state *buckets[DFA_HASH_SIZE];
+  u_int32_t *mark;
+  u_int32_t gen;
+  int *stack;
+  int *set;
+  int *aux;
+  int *restart;
+  u_int32_t num_restart;
+};
+
+/* prototypes */
+#if (!defined __REGEXP_DFA_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT struct pm_dfa *pm_dfa_new();
+EXT int pm_dfa_add(struct pm_dfa *, char *, int);
+EXT void pm_dfa_compile(struct pm_dfa *);
+EXT int pm_dfa_exec(struct pm_dfa *, u_char *, int, int);
+#undef EXT
+
+#endif /* _REGEXP_DFA_H_ */
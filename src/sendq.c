@@ -0,0 +1,167 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+#define __SENDQ_C
+
+/* includes */
+#include "pmacct.h"
+
+/* Functions */
+/* pm_sendq_init() sets up a queue towards 'fd': if 'dest' is given,
+   datagrams are addressed to it, otherwise the socket is expected to be
+   connected. 'batch' is the number of datagrams per flush; 'max_dgram' is
+   the largest datagram the owner is going to queue */
+int pm_sendq_init(struct pm_sendq *q, int fd, struct sockaddr *dest, socklen_t dest_len,
+		  u_int32_t batch, u_int32_t max_dgram)
+{
+  memset(q, 0, sizeof(struct pm_sendq));
+
+  if (!batch) batch = SENDQ_DEFAULT_BATCH;
+  if (batch > SENDQ_MAX_BATCH) batch = SENDQ_MAX_BATCH;
+
+  q->fd = fd;
+  q->batch = batch;
+  if (dest && dest_len && dest_len <= sizeof(q->dest)) {
+    memcpy(&q->dest, dest, dest_len);
+    q->dest_len = dest_len;
+  }
+
+  q->bufsz = batch * SENDQ_DGRAM_HINT;
+  if (q->bufsz < max_dgram) q->bufsz = max_dgram;
+
+  q->buf = malloc(q->bufsz);
+  q->iov = malloc(batch * sizeof(struct iovec));
+#if defined SENDQ_USE_MMSG
+  q->msgs = malloc(batch * sizeof(struct mmsghdr));
+  if (q->msgs) memset(q->msgs, 0, batch * sizeof(struct mmsghdr));
+#endif
+
+  if (!q->buf || !q->iov
+#if defined SENDQ_USE_MMSG
+      || !q->msgs
+#endif
+     ) {
+    pm_sendq_destroy(q);
+    return ERR;
+  }
+
+  return SUCCESS;
+}
+
+/* pm_sendq_add() copies the datagram in the queue, flushing first if it
+   would not fit; returns the outcome of any flush triggered */
+int pm_sendq_add(struct pm_sendq *q, void *data, u_int32_t len)
+{
+  int ret = SUCCESS;
+
+  if (q->num == q->batch || q->used + len > q->bufsz) ret = pm_sendq_flush(q);
+
+  /* larger than the whole buffer: should not happen, sent as-is */
+  if (len > q->bufsz) {
+    q->iov[0].iov_base = data;
+    q->iov[0].iov_len = len;
+    q->num = 1;
+    if (pm_sendq_flush(q) == ERR) ret = ERR;
+    return ret;
+  }
+
+  memcpy(q->buf + q->used, data, len);
+  q->iov[q->num].iov_base = q->buf + q->used;
+  q->iov[q->num].iov_len = len;
+  q->used += len;
+  q->num++;
+
+  if (q->num == q->batch) {
+    if (pm_sendq_flush(q) == ERR) ret = ERR;
+  }
+
+  return ret;
+}
+
+/* pm_sendq_flush() sends out whatever is queued. A datagram that can't be
+   sent is counted as an error and dropped; returns ERR if any was */
+int pm_sendq_flush(struct pm_sendq *q)
+{
+  u_int32_t idx = 0, errors = 0;
+  int ret, err;
+  socklen_t errsz = sizeof(err);
+
+  if (!q->num) return SUCCESS;
+
+  /* clear ICMP errors left over on connected sockets */
+  if (!q->dest_len) getsockopt(q->fd, SOL_SOCKET, SO_ERROR, &err, &errsz);
+
+#if defined SENDQ_USE_MMSG
+  for (idx = 0; idx < q->num; idx++) {
+    q->msgs[idx].msg_hdr.msg_iov = &q->iov[idx];
+    q->msgs[idx].msg_hdr.msg_iovlen = 1;
+    q->msgs[idx].msg_hdr.msg_name = (q->dest_len ? &q->dest : NULL);
+    q->msgs[idx].msg_hdr.msg_namelen = q->dest_len;
+    q->msgs[idx].msg_len = 0;
+  }
+
+  idx = 0;
+  while (idx < q->num) {
+    ret = sendmmsg(q->fd, &q->msgs[idx], q->num - idx, 0);
+
+    if (ret > 0) {
+      for (; ret > 0; ret--, idx++) q->bytes += q->msgs[idx].msg_len;
+    }
+    else if (ret == -1 && errno == EINTR) continue;
+    else {
+      /* the datagram at the head of the batch is what failed */
+      q->last_errno = errno;
+      errors++;
+      idx++;
+    }
+  }
+#else
+  for (idx = 0; idx < q->num; idx++) {
+    if (q->dest_len) ret = sendto(q->fd, q->iov[idx].iov_base, q->iov[idx].iov_len, 0, (struct sockaddr *) &q->dest, q->dest_len);
+    else ret = send(q->fd, q->iov[idx].iov_base, q->iov[idx].iov_len, 0);
+
+    if (ret >= 0) q->bytes += ret;
+    else {
+      q->last_errno = errno;
+      errors++;
+    }
+  }
+#endif
+
+  q->datagrams += (q->num - errors);
+  q->errors += errors;
+  q->num = 0;
+  q->used = 0;
+
+  return (errors ? ERR : SUCCESS);
+}
+
+void pm_sendq_destroy(struct pm_sendq *q)
+{
+  if (q->buf) free(q->buf);
+  if (q->iov) free(q->iov);
+#if defined SENDQ_USE_MMSG
+  if (q->msgs) free(q->msgs);
+#endif
+
+  memset(q, 0, sizeof(struct pm_sendq));
+}
@@ -0,0 +1,84 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+#ifndef _SENDQ_H_
+#define _SENDQ_H_
+
+/* includes */
+#include <sys/uio.h>
+
+/* defines */
+#define SENDQ_DEFAULT_BATCH	32
+#define SENDQ_MAX_BATCH		1024	/* UIO_MAXIOV: sendmmsg() vlen cap */
+#define SENDQ_DGRAM_HINT	1500	/* typical datagram, sizes the buffer */
+
+#if defined (HAVE_SENDMMSG) && defined (_GNU_SOURCE)
+#define SENDQ_USE_MMSG
+#endif
+
+/* structures */
+/*
+   Per-destination UDP send queue: datagrams are copied back to back in
+   a single buffer and handed to the kernel in one sendmmsg() call when
+   either the batch or the buffer fills up or the owner flushes. Where
+   sendmmsg() is not available the flush falls back to one send() per
+   datagram.
+*/
+struct pm_sendq {
+  int fd;
+#if defined ENABLE_IPV6
+  struct sockaddr_storage dest;
+#else
+  struct sockaddr dest;
+#endif
+  socklen_t dest_len;			/* zero: connected socket */
+
+  u_int32_t batch;			/* flush threshold, datagrams */
+  u_int32_t num;			/* datagrams queued */
+  char *buf;
+  u_int32_t bufsz;
+  u_int32_t used;
+  struct iovec *iov;
+#if defined SENDQ_USE_MMSG
+  struct mmsghdr *msgs;
+#endif
+
+  /* counters */
+  u_int64_t bytes;
+  u_int64_t datagrams;
+  u_int64_t errors;
+  int last_errno;
+};
+
+/* prototypes */
+#if (!defined __SENDQ_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT int pm_sendq_init(struct pm_sendq *, int, struct sockaddr *, socklen_t, u_int32_t, u_int32_t);
+EXT int pm_sendq_add(struct pm_sendq *, void *, u_int32_t);
+EXT int pm_sendq_flush(struct pm_sendq *);
+EXT void pm_sendq_destroy(struct pm_sendq *);
+#undef EXT
+
+#endif /* _SENDQ_H_ */
@@ -26,6 +26,7 @@
 #include "imt_plugin.h"
 #include "ip_flow.h"
 #include "classifier.h"
+#include "crc32.h"
 #include "bgp/bgp_packet.h"
 #include "bgp/bgp.h"
 
@@ -63,7 +64,8 @@ int build_query_server(char *path_ptr)
 }
 
 
-void process_query_data(int sd, unsigned char *buf, int len, struct extra_primitives *extras, int datasize, int forked)
+void process_query_data(int sd, unsigned char *buf, int len, struct extra_primitives *extras, int datasize, int forked,
+			struct imt_snapshot *snap)
 {
   struct acc *acc_elem = 0, tmpbuf;
   struct bucket_desc bd;
@@ -164,62 +166,39 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
 
   reset_counter = q->type & WANT_RESET;
 
-  if (q->type & WANT_STATS) {
+  if (q->type & WANT_STREAM) {
+    process_stream_query(sd, &rb, buf, len, extras, datasize, snap);
+  }
+  else if (q->type & WANT_STATS) {
     q->what_to_count = config.what_to_count; 
     q->what_to_count_2 = config.what_to_count_2; 
-    for (idx = 0; idx < config.buckets; idx++) {
-      if (!following_chain) acc_elem = (struct acc *) elem;
-      if (!test_zero_elem(acc_elem)) {
-	enQueue_elem(sd, &rb, acc_elem, PdataSz, datasize);
-
-        if (extras->off_pkt_bgp_primitives && acc_elem->pbgp) {
-          enQueue_elem(sd, &rb, acc_elem->pbgp, PbgpSz, datasize - extras->off_pkt_bgp_primitives);
-        }
-
-        if (extras->off_pkt_lbgp_primitives) {
-          if (acc_elem->clbgp) {
-            struct pkt_legacy_bgp_primitives tmp_plbgp;
-
-            cache_to_pkt_legacy_bgp_primitives(&tmp_plbgp, acc_elem->clbgp);
-            enQueue_elem(sd, &rb, &tmp_plbgp, PlbgpSz, datasize - extras->off_pkt_lbgp_primitives);
-          }
-        }
-
-        if (extras->off_pkt_nat_primitives && acc_elem->pnat) {
-          enQueue_elem(sd, &rb, acc_elem->pnat, PnatSz, datasize - extras->off_pkt_nat_primitives);
-	}
-
-        if (extras->off_pkt_mpls_primitives && acc_elem->pmpls) {
-          enQueue_elem(sd, &rb, acc_elem->pmpls, PmplsSz, datasize - extras->off_pkt_mpls_primitives);
-	}
-
-        if (extras->off_pkt_tun_primitives && acc_elem->ptun) {
-          enQueue_elem(sd, &rb, acc_elem->ptun, PtunSz, datasize - extras->off_pkt_tun_primitives);
-	}
-
-        if (extras->off_custom_primitives && acc_elem->pcust) {
-          enQueue_elem(sd, &rb, acc_elem->pcust, config.cpptrs.len, datasize - extras->off_custom_primitives);
+    if (snap) {
+      for (idx = 0; idx < snap->num; idx++) enQueue_acc(sd, &rb, &snap->entries[idx], extras, datasize);
+    }
+    else {
+      for (idx = 0; idx < config.buckets; idx++) {
+        if (!following_chain) acc_elem = (struct acc *) elem;
+        if (!test_zero_elem(acc_elem)) enQueue_acc(sd, &rb, acc_elem, extras, datasize);
+        if (acc_elem->next != NULL) {
+          Log(LOG_DEBUG, "DEBUG ( %s/%s ): Following chain in reply ...\n", config.name, config.type);
+          acc_elem = acc_elem->next;
+          following_chain = TRUE;
+          idx--;
         }
-
-        if (extras->off_pkt_vlen_hdr_primitives && acc_elem->pvlen) {
-          enQueue_elem(sd, &rb, acc_elem->pvlen, PvhdrSz + acc_elem->pvlen->tot_len, datasize - extras->off_pkt_vlen_hdr_primitives);
+        else {
+          elem += sizeof(struct acc);
+          following_chain = FALSE;
         }
-      } 
-      if (acc_elem->next != NULL) {
-        Log(LOG_DEBUG, "DEBUG ( %s/%s ): Following chain in reply ...\n", config.name, config.type);
-        acc_elem = acc_elem->next;
-        following_chain = TRUE;
-        idx--;
-      }
-      else {
-        elem += sizeof(struct acc);
-        following_chain = FALSE;
       }
     }
     if (rb.packed) send(sd, rb.buf, rb.packed, 0); /* send remainder data */
   }
   else if (q->type & WANT_STATUS) {
-    for (idx = 0; idx < config.buckets; idx++) {
+    if (snap) {
+      for (idx = 0; idx < config.buckets; idx++)
+        enQueue_elem(sd, &rb, &snap->bdesc[idx], sizeof(struct bucket_desc), sizeof(struct bucket_desc));
+    }
+    else for (idx = 0; idx < config.buckets; idx++) {
 
       /* Administrativia */
       following_chain = FALSE;
@@ -263,43 +242,11 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
 	prim_ptrs.pcust = request.pcust;
 	prim_ptrs.pvlen = request.pvlen;
 
-        acc_elem = search_accounting_structure(&prim_ptrs);
+        if (snap) acc_elem = imt_snapshot_search(snap, &prim_ptrs);
+        else acc_elem = search_accounting_structure(&prim_ptrs);
         if (acc_elem) { 
 	  if (!test_zero_elem(acc_elem)) {
-	    enQueue_elem(sd, &rb, acc_elem, PdataSz, datasize);
-
-            if (extras->off_pkt_bgp_primitives && acc_elem->pbgp) {
-              enQueue_elem(sd, &rb, acc_elem->pbgp, PbgpSz, datasize - extras->off_pkt_bgp_primitives);
-            }
-
-            if (extras->off_pkt_lbgp_primitives) {
-              if (acc_elem->clbgp) {
-                struct pkt_legacy_bgp_primitives tmp_plbgp;
-
-                cache_to_pkt_legacy_bgp_primitives(&tmp_plbgp, acc_elem->clbgp);
-                enQueue_elem(sd, &rb, &tmp_plbgp, PlbgpSz, datasize - extras->off_pkt_lbgp_primitives);
-              }
-            }
-
-            if (extras->off_pkt_nat_primitives && acc_elem->pnat) {
-              enQueue_elem(sd, &rb, acc_elem->pnat, PnatSz, datasize - extras->off_pkt_nat_primitives);
-            }
-
-	    if (extras->off_pkt_mpls_primitives && acc_elem->pmpls) {
-	      enQueue_elem(sd, &rb, acc_elem->pmpls, PmplsSz, datasize - extras->off_pkt_mpls_primitives);
-	    }
-
-            if (extras->off_pkt_tun_primitives && acc_elem->ptun) {
-              enQueue_elem(sd, &rb, acc_elem->ptun, PtunSz, datasize - extras->off_pkt_tun_primitives);
-            }
-
-	    if (extras->off_custom_primitives && acc_elem->pcust) {
-	      enQueue_elem(sd, &rb, acc_elem->pcust, config.cpptrs.len, datasize - extras->off_custom_primitives);
-	    }
-
-	    if (extras->off_pkt_vlen_hdr_primitives && acc_elem->pvlen) {
-	      enQueue_elem(sd, &rb, acc_elem->pvlen, PvhdrSz + acc_elem->pvlen->tot_len, datasize - extras->off_pkt_vlen_hdr_primitives);
-	    }
+	    enQueue_acc(sd, &rb, acc_elem, extras, datasize);
 
 	    if (reset_counter) {
 	      if (forked) set_reset_flag(acc_elem);
@@ -361,74 +308,52 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
 	}
       }
       else {
-        struct pkt_primitives tbuf;  
-	struct pkt_bgp_primitives bbuf;
-	struct pkt_legacy_bgp_primitives lbbuf;
-	struct pkt_nat_primitives nbuf;
-	struct pkt_mpls_primitives mbuf;
-	struct pkt_tunnel_primitives ubuf;
 	struct pkt_data abuf;
+	struct imt_snapshot_index *sidx;
+	u_int32_t pos;
+
         following_chain = FALSE;
 	elem = (unsigned char *) a;
 	memset(&abuf, 0, sizeof(abuf));
 
-        for (idx = 0; idx < config.buckets; idx++) {
-          if (!following_chain) acc_elem = (struct acc *) elem;
-	  if (!test_zero_elem(acc_elem)) {
-	    /* XXX: support for custom and vlen primitives */
-	    mask_elem(&tbuf, &bbuf, &lbbuf, &nbuf, &mbuf, &ubuf, acc_elem, request.what_to_count, request.what_to_count_2, extras); 
-            if (!memcmp(&tbuf, &request.data, sizeof(struct pkt_primitives)) &&
-		!memcmp(&bbuf, &request.pbgp, sizeof(struct pkt_bgp_primitives)) &&
-		!memcmp(&lbbuf, &request.plbgp, sizeof(struct pkt_legacy_bgp_primitives)) &&
-		!memcmp(&nbuf, &request.pnat, sizeof(struct pkt_nat_primitives)) &&
-		!memcmp(&mbuf, &request.pmpls, sizeof(struct pkt_mpls_primitives)) &&
-		!memcmp(&ubuf, &request.ptun, sizeof(struct pkt_tunnel_primitives))) {
-	      if (q->type & WANT_COUNTER) Accumulate_Counters(&abuf, acc_elem); 
-	      else {
-		enQueue_elem(sd, &rb, acc_elem, PdataSz, datasize); /* q->type == WANT_MATCH */
-
-                if (extras->off_pkt_bgp_primitives && acc_elem->pbgp) {
-                  enQueue_elem(sd, &rb, acc_elem->pbgp, PbgpSz, datasize - extras->off_pkt_bgp_primitives);
-                }
-
-                if (extras->off_pkt_lbgp_primitives) {
-                  if (acc_elem->clbgp) {
-                    struct pkt_legacy_bgp_primitives tmp_plbgp;
-
-                    cache_to_pkt_legacy_bgp_primitives(&tmp_plbgp, acc_elem->clbgp);
-                    enQueue_elem(sd, &rb, &tmp_plbgp, PlbgpSz, datasize - extras->off_pkt_lbgp_primitives);
-                  }
-                }
-
-                if (extras->off_pkt_nat_primitives && acc_elem->pnat) {
-                  enQueue_elem(sd, &rb, acc_elem->pnat, PnatSz, datasize - extras->off_pkt_nat_primitives);
-                }
-		if (extras->off_pkt_mpls_primitives && acc_elem->pmpls) {
-		  enQueue_elem(sd, &rb, acc_elem->pmpls, PmplsSz, datasize - extras->off_pkt_mpls_primitives);
-		}
-                if (extras->off_pkt_tun_primitives && acc_elem->ptun) {
-                  enQueue_elem(sd, &rb, acc_elem->ptun, PtunSz, datasize - extras->off_pkt_tun_primitives);
-                }
-                if (extras->off_custom_primitives && acc_elem->pcust) {
-                  enQueue_elem(sd, &rb, acc_elem->pcust, config.cpptrs.len, datasize - extras->off_custom_primitives);
-                }
-		if (extras->off_pkt_vlen_hdr_primitives && acc_elem->pvlen) {
-		  enQueue_elem(sd, &rb, acc_elem->pvlen, PvhdrSz + acc_elem->pvlen->tot_len, datasize - extras->off_pkt_vlen_hdr_primitives);
-		}
-	      }
-	      if (reset_counter) set_reset_flag(acc_elem);
+	if (snap) {
+	  /* walk only the chain of a secondary index, if the query fixes an indexed primitive */
+	  sidx = imt_snapshot_select_index(snap, &request);
+	  if (sidx) pos = sidx->head[imt_snapshot_key(sidx->type, &request.data, &request.pbgp) % sidx->modulo];
+	  else pos = (snap->num ? 1 : 0);
+
+	  while (pos) {
+	    acc_elem = &snap->entries[pos-1];
+	    if (match_elem(acc_elem, &request, extras)) {
+	      if (q->type & WANT_COUNTER) Accumulate_Counters(&abuf, acc_elem);
+	      else enQueue_acc(sd, &rb, acc_elem, extras, datasize); /* q->type == WANT_MATCH */
 	    }
+
+	    if (sidx) pos = sidx->next[pos-1];
+	    else pos = (pos < snap->num ? pos+1 : 0);
+	  }
+	}
+	else {
+          for (idx = 0; idx < config.buckets; idx++) {
+            if (!following_chain) acc_elem = (struct acc *) elem;
+	    if (!test_zero_elem(acc_elem)) {
+	      if (match_elem(acc_elem, &request, extras)) {
+	        if (q->type & WANT_COUNTER) Accumulate_Counters(&abuf, acc_elem); 
+	        else enQueue_acc(sd, &rb, acc_elem, extras, datasize); /* q->type == WANT_MATCH */
+	        if (reset_counter) set_reset_flag(acc_elem);
+	      }
+            }
+            if (acc_elem->next) {
+              acc_elem = acc_elem->next;
+              following_chain = TRUE;
+              idx--;
+            }
+            else {
+              elem += sizeof(struct acc);
+              following_chain = FALSE;
+            }
           }
-          if (acc_elem->next) {
-            acc_elem = acc_elem->next;
-            following_chain = TRUE;
-            idx--;
-          }
-          else {
-            elem += sizeof(struct acc);
-            following_chain = FALSE;
-          }
-        }
+	}
 	if (q->type & WANT_COUNTER) enQueue_elem(sd, &rb, &abuf, PdataSz, PdataSz); /* enqueue accumulated data */
       }
     }
@@ -498,9 +423,11 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
     if (rb.packed) send(sd, rb.buf, rb.packed, 0); /* send remainder data */
   }
 
-  /* wait a bit due to setnonblocking() then send EOF */
-  usleep(1000);
-  send(sd, emptybuf, LARGEBUFLEN, 0);
+  /* wait a bit due to setnonblocking() then send EOF; streams end with their own frame */
+  if (!(q->type & WANT_STREAM)) {
+    usleep(1000);
+    send(sd, emptybuf, LARGEBUFLEN, 0);
+  }
 
   if (dummy_pcust) free(dummy_pcust);
   if (custbuf) free(custbuf);
@@ -616,6 +543,65 @@ void mask_elem(struct pkt_primitives *d1, struct pkt_bgp_primitives *d2, struct
   }
 }
 
+int match_elem(struct acc *acc_elem, struct query_entry *request, struct extra_primitives *extras)
+{
+  struct pkt_primitives tbuf;
+  struct pkt_bgp_primitives bbuf;
+  struct pkt_legacy_bgp_primitives lbbuf;
+  struct pkt_nat_primitives nbuf;
+  struct pkt_mpls_primitives mbuf;
+  struct pkt_tunnel_primitives ubuf;
+
+  /* XXX: support for custom and vlen primitives */
+  mask_elem(&tbuf, &bbuf, &lbbuf, &nbuf, &mbuf, &ubuf, acc_elem, request->what_to_count, request->what_to_count_2, extras);
+  if (!memcmp(&tbuf, &request->data, sizeof(struct pkt_primitives)) &&
+      !memcmp(&bbuf, &request->pbgp, sizeof(struct pkt_bgp_primitives)) &&
+      !memcmp(&lbbuf, &request->plbgp, sizeof(struct pkt_legacy_bgp_primitives)) &&
+      !memcmp(&nbuf, &request->pnat, sizeof(struct pkt_nat_primitives)) &&
+      !memcmp(&mbuf, &request->pmpls, sizeof(struct pkt_mpls_primitives)) &&
+      !memcmp(&ubuf, &request->ptun, sizeof(struct pkt_tunnel_primitives))) return TRUE;
+
+  return FALSE;
+}
+
+void enQueue_acc(int sd, struct reply_buffer *rb, struct acc *acc_elem, struct extra_primitives *extras, int datasize)
+{
+  enQueue_elem(sd, rb, acc_elem, PdataSz, datasize);
+
+  if (extras->off_pkt_bgp_primitives && acc_elem->pbgp) {
+    enQueue_elem(sd, rb, acc_elem->pbgp, PbgpSz, datasize - extras->off_pkt_bgp_primitives);
+  }
+
+  if (extras->off_pkt_lbgp_primitives) {
+    if (acc_elem->clbgp) {
+      struct pkt_legacy_bgp_primitives tmp_plbgp;
+
+      cache_to_pkt_legacy_bgp_primitives(&tmp_plbgp, acc_elem->clbgp);
+      enQueue_elem(sd, rb, &tmp_plbgp, PlbgpSz, datasize - extras->off_pkt_lbgp_primitives);
+    }
+  }
+
+  if (extras->off_pkt_nat_primitives && acc_elem->pnat) {
+    enQueue_elem(sd, rb, acc_elem->pnat, PnatSz, datasize - extras->off_pkt_nat_primitives);
+  }
+
+  if (extras->off_pkt_mpls_primitives && acc_elem->pmpls) {
+    enQueue_elem(sd, rb, acc_elem->pmpls, PmplsSz, datasize - extras->off_pkt_mpls_primitives);
+  }
+
+  if (extras->off_pkt_tun_primitives && acc_elem->ptun) {
+    enQueue_elem(sd, rb, acc_elem->ptun, PtunSz, datasize - extras->off_pkt_tun_primitives);
+  }
+
+  if (extras->off_custom_primitives && acc_elem->pcust) {
+    enQueue_elem(sd, rb, acc_elem->pcust, config.cpptrs.len, datasize - extras->off_custom_primitives);
+  }
+
+  if (extras->off_pkt_vlen_hdr_primitives && acc_elem->pvlen) {
+    enQueue_elem(sd, rb, acc_elem->pvlen, PvhdrSz + acc_elem->pvlen->tot_len, datasize - extras->off_pkt_vlen_hdr_primitives);
+  }
+}
+
 void enQueue_elem(int sd, struct reply_buffer *rb, void *elem, int size, int tot_size)
 {
   if ((rb->packed + tot_size) < rb->len) {
@@ -624,7 +610,7 @@ void enQueue_elem(int sd, struct reply_buffer *rb, void *elem, int size, int tot
     rb->packed += size; 
   }
   else {
-    send(sd, rb->buf, rb->packed, 0);
+    reply_buffer_flush(sd, rb);
     rb->len = LARGEBUFLEN;
     memset(rb->buf, 0, sizeof(rb->buf));
     rb->packed = 0;
@@ -635,6 +621,24 @@ void enQueue_elem(int sd, struct reply_buffer *rb, void *elem, int size, int tot
   }
 }
 
+void reply_buffer_flush(int sd, struct reply_buffer *rb)
+{
+  if (!rb->packed) return;
+
+  if (rb->framed) send_query_frame(sd, QUERY_FRAME_DATA, rb->buf, rb->packed);
+  else send(sd, rb->buf, rb->packed, 0);
+}
+
+void send_query_frame(int sd, u_int32_t type, void *payload, u_int32_t len)
+{
+  struct query_frame qf;
+
+  qf.type = type;
+  qf.len = len;
+  send(sd, &qf, sizeof(qf), 0);
+  if (len) send(sd, payload, len, 0);
+}
+
 void Accumulate_Counters(struct pkt_data *abuf, struct acc *elem)
 {
   abuf->pkt_len += elem->bytes_counter;
@@ -662,3 +666,545 @@ int test_zero_elem(struct acc *elem)
 
   return TRUE;
 }
+
+void process_stream_query(int sd, struct reply_buffer *rb, unsigned char *buf, int len, struct extra_primitives *extras,
+			  int datasize, struct imt_snapshot *snap)
+{
+  struct query_header *uq = (struct query_header *) buf, *q = (struct query_header *) rb->buf;
+  struct query_entry *requests = NULL;
+  struct query_stream qs;
+  struct query_stream_end qse;
+  struct acc *acc_elem = NULL, **ranked = NULL, *tmp;
+  u_int64_t walked = 0, limit = 0, eligible, pos;
+  u_int32_t num_requests = 0, ranked_num = 0, ranked_max = 0, idx = 0;
+  int stream_off = sizeof(struct query_header)+(uq->num*sizeof(struct query_entry));
+
+  memset(&qs, 0, sizeof(qs));
+  memset(&qse, 0, sizeof(qse));
+
+  if (len >= (stream_off + sizeof(struct query_stream))) memcpy(&qs, buf+stream_off, sizeof(struct query_stream));
+
+  if ((uq->type & WANT_MATCH) && uq->num) {
+    requests = malloc(uq->num*sizeof(struct query_entry));
+    if (!requests) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (process_stream_query). Exiting ..\n", config.name, config.type);
+      exit_plugin(1);
+    }
+    memcpy(requests, buf+sizeof(struct query_header), uq->num*sizeof(struct query_entry));
+    num_requests = uq->num;
+  }
+
+  /* ranking needs only enough entries to fill the requested page */
+  if (qs.topN_counter) {
+    if (qs.topN) limit = qs.topN;
+    if (qs.page_size && (!limit || (qs.cursor+qs.page_size) < limit)) limit = qs.cursor+qs.page_size;
+  }
+
+  q->what_to_count = config.what_to_count;
+  q->what_to_count_2 = config.what_to_count_2;
+  send_query_frame(sd, QUERY_FRAME_HEADER, rb->buf, sizeof(struct query_header));
+
+  memset(rb->buf, 0, sizeof(rb->buf));
+  rb->ptr = rb->buf;
+  rb->len = LARGEBUFLEN;
+  rb->packed = 0;
+  rb->framed = TRUE;
+
+  /* walk the snapshot, if any, or the live table */
+  for (;;) {
+    if (snap) {
+      if (idx < snap->num) acc_elem = &snap->entries[idx++];
+      else break;
+    }
+    else {
+      if (acc_elem && acc_elem->next) acc_elem = acc_elem->next;
+      else if (idx < config.buckets) acc_elem = (struct acc *) (a+(idx++*sizeof(struct acc)));
+      else break;
+    }
+
+    if (!stream_test_elem(acc_elem, requests, num_requests, &qs, extras)) continue;
+
+    if (qs.topN_counter) {
+      if (!limit || ranked_num < limit) {
+	if (ranked_num == ranked_max) {
+	  ranked_max = (ranked_max ? ranked_max*2 : 1024);
+	  if (limit && ranked_max > limit) ranked_max = limit;
+	  ranked = realloc(ranked, ranked_max*sizeof(struct acc *));
+	  if (!ranked) {
+	    Log(LOG_ERR, "ERROR ( %s/%s ): realloc() failed (process_stream_query). Exiting ..\n", config.name, config.type);
+	    exit_plugin(1);
+	  }
+	}
+	ranked[ranked_num++] = acc_elem;
+	if (limit) stream_heap_sift_up(ranked, ranked_num-1, qs.topN_counter);
+      }
+      else if (stream_counter(acc_elem, qs.topN_counter) > stream_counter(ranked[0], qs.topN_counter)) {
+	ranked[0] = acc_elem;
+	stream_heap_sift_down(ranked, ranked_num, 0, qs.topN_counter);
+      }
+    }
+    else if (walked >= qs.cursor) {
+      if (qs.page_size && qse.records == qs.page_size) {
+	qse.next_cursor = walked;
+	break;
+      }
+      enQueue_acc(sd, rb, acc_elem, extras, datasize);
+      qse.records++;
+    }
+
+    walked++;
+  }
+
+  if (qs.topN_counter) {
+    /* unbounded ranking collected entries unordered: heapify them first */
+    if (!limit) {
+      for (pos = ranked_num/2; pos > 0; pos--) stream_heap_sift_down(ranked, ranked_num, pos-1, qs.topN_counter);
+    }
+
+    /* in-place heapsort off a min-heap leaves entries in descending order */
+    for (pos = ranked_num; pos > 1; pos--) {
+      tmp = ranked[0];
+      ranked[0] = ranked[pos-1];
+      ranked[pos-1] = tmp;
+      stream_heap_sift_down(ranked, pos-1, 0, qs.topN_counter);
+    }
+
+    for (pos = qs.cursor; pos < ranked_num; pos++) {
+      if (qs.page_size && qse.records == qs.page_size) break;
+      enQueue_acc(sd, rb, ranked[pos], extras, datasize);
+      qse.records++;
+    }
+
+    eligible = walked;
+    if (qs.topN && qs.topN < eligible) eligible = qs.topN;
+    if ((qs.cursor+qse.records) < eligible) qse.next_cursor = qs.cursor+qse.records;
+  }
+
+  reply_buffer_flush(sd, rb);
+  send_query_frame(sd, QUERY_FRAME_END, &qse, sizeof(qse));
+
+  if (ranked) free(ranked);
+  if (requests) free(requests);
+}
+
+int stream_test_elem(struct acc *acc_elem, struct query_entry *requests, u_int32_t num_requests,
+		     struct query_stream *qs, struct extra_primitives *extras)
+{
+  u_int32_t idx;
+
+  if (test_zero_elem(acc_elem)) return FALSE;
+  if (qs->filter_counter && stream_counter(acc_elem, qs->filter_counter) < qs->filter_min) return FALSE;
+  if (!num_requests) return TRUE;
+
+  for (idx = 0; idx < num_requests; idx++) {
+    if (match_elem(acc_elem, &requests[idx], extras)) return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* same counter numbering as the -T client option: 1 bytes, 2 packets, 3 flows */
+pm_counter_t stream_counter(struct acc *acc_elem, int which)
+{
+  if (which == 2) return acc_elem->packet_counter;
+  else if (which == 3) return acc_elem->flow_counter;
+  else return acc_elem->bytes_counter;
+}
+
+void stream_heap_sift_up(struct acc **heap, u_int32_t pos, int which)
+{
+  struct acc *tmp;
+  u_int32_t parent;
+
+  while (pos) {
+    parent = (pos-1)/2;
+    if (stream_counter(heap[pos], which) >= stream_counter(heap[parent], which)) break;
+
+    tmp = heap[pos];
+    heap[pos] = heap[parent];
+    heap[parent] = tmp;
+    pos = parent;
+  }
+}
+
+void stream_heap_sift_down(struct acc **heap, u_int32_t num, u_int32_t pos, int which)
+{
+  struct acc *tmp;
+  u_int32_t child;
+
+  for (child = (2*pos)+1; child < num; child = (2*pos)+1) {
+    if ((child+1) < num && stream_counter(heap[child+1], which) < stream_counter(heap[child], which)) child++;
+    if (stream_counter(heap[pos], which) <= stream_counter(heap[child], which)) break;
+
+    tmp = heap[pos];
+    heap[pos] = heap[child];
+    heap[child] = tmp;
+    pos = child;
+  }
+}
+
+struct imt_snapshot *imt_snapshot_build(struct extra_primitives *extras)
+{
+  struct imt_snapshot *snap;
+  struct acc *acc_elem, *snap_elem;
+  struct pkt_legacy_bgp_primitives tmp_plbgp;
+  unsigned char *elem;
+  u_int32_t idx, num = 0;
+  struct timeval start, end;
+
+  gettimeofday(&start, NULL);
+
+  snap = malloc(sizeof(struct imt_snapshot));
+  if (!snap) goto malloc_failed;
+  memset(snap, 0, sizeof(struct imt_snapshot));
+
+  snap->bdesc = malloc(config.buckets*sizeof(struct bucket_desc));
+  if (!snap->bdesc) goto malloc_failed;
+  memset(snap->bdesc, 0, config.buckets*sizeof(struct bucket_desc));
+
+  /* first pass: size the snapshot and compose the WANT_STATUS reply */
+  for (idx = 0, elem = a; idx < config.buckets; idx++, elem += sizeof(struct acc)) {
+    snap->bdesc[idx].num = idx;
+    for (acc_elem = (struct acc *) elem; acc_elem; acc_elem = acc_elem->next) {
+      if (!test_zero_elem(acc_elem)) {
+	snap->bdesc[idx].howmany++;
+	num++;
+      }
+    }
+  }
+
+  snap->num = num;
+  if (!num) num = 1; /* keep allocations below valid */
+
+  snap->entries = malloc(num*sizeof(struct acc));
+  if (!snap->entries) goto malloc_failed;
+  memset(snap->entries, 0, num*sizeof(struct acc));
+
+  if (extras->off_pkt_bgp_primitives) {
+    snap->pbgp = malloc(num*sizeof(struct pkt_bgp_primitives));
+    if (!snap->pbgp) goto malloc_failed;
+  }
+  if (extras->off_pkt_nat_primitives) {
+    snap->pnat = malloc(num*sizeof(struct pkt_nat_primitives));
+    if (!snap->pnat) goto malloc_failed;
+  }
+  if (extras->off_pkt_mpls_primitives) {
+    snap->pmpls = malloc(num*sizeof(struct pkt_mpls_primitives));
+    if (!snap->pmpls) goto malloc_failed;
+  }
+  if (extras->off_pkt_tun_primitives) {
+    snap->ptun = malloc(num*sizeof(struct pkt_tunnel_primitives));
+    if (!snap->ptun) goto malloc_failed;
+  }
+  if (extras->off_custom_primitives && config.cpptrs.len) {
+    snap->pcust = malloc(num*config.cpptrs.len);
+    if (!snap->pcust) goto malloc_failed;
+  }
+
+  /* second pass: copy entries over; extras land in the backing arrays */
+  for (idx = 0, num = 0, elem = a; idx < config.buckets; idx++, elem += sizeof(struct acc)) {
+    for (acc_elem = (struct acc *) elem; acc_elem; acc_elem = acc_elem->next) {
+      if (test_zero_elem(acc_elem)) continue;
+
+      snap_elem = &snap->entries[num];
+      memcpy(snap_elem, acc_elem, sizeof(struct acc));
+      snap_elem->pbgp = NULL;
+      snap_elem->clbgp = NULL;
+      snap_elem->pnat = NULL;
+      snap_elem->pmpls = NULL;
+      snap_elem->ptun = NULL;
+      snap_elem->pcust = NULL;
+      snap_elem->pvlen = NULL;
+      snap_elem->next = NULL;
+
+      if (snap->pbgp && acc_elem->pbgp) {
+	snap_elem->pbgp = &snap->pbgp[num];
+	memcpy(snap_elem->pbgp, acc_elem->pbgp, sizeof(struct pkt_bgp_primitives));
+      }
+      if (acc_elem->clbgp) {
+	snap_elem->clbgp = malloc(sizeof(struct cache_legacy_bgp_primitives));
+	if (!snap_elem->clbgp) goto malloc_failed;
+	memset(snap_elem->clbgp, 0, sizeof(struct cache_legacy_bgp_primitives));
+	cache_to_pkt_legacy_bgp_primitives(&tmp_plbgp, acc_elem->clbgp);
+	pkt_to_cache_legacy_bgp_primitives(snap_elem->clbgp, &tmp_plbgp, config.what_to_count, config.what_to_count_2);
+      }
+      if (snap->pnat && acc_elem->pnat) {
+	snap_elem->pnat = &snap->pnat[num];
+	memcpy(snap_elem->pnat, acc_elem->pnat, sizeof(struct pkt_nat_primitives));
+      }
+      if (snap->pmpls && acc_elem->pmpls) {
+	snap_elem->pmpls = &snap->pmpls[num];
+	memcpy(snap_elem->pmpls, acc_elem->pmpls, sizeof(struct pkt_mpls_primitives));
+      }
+      if (snap->ptun && acc_elem->ptun) {
+	snap_elem->ptun = &snap->ptun[num];
+	memcpy(snap_elem->ptun, acc_elem->ptun, sizeof(struct pkt_tunnel_primitives));
+      }
+      if (snap->pcust && acc_elem->pcust) {
+	snap_elem->pcust = &snap->pcust[num*config.cpptrs.len];
+	memcpy(snap_elem->pcust, acc_elem->pcust, config.cpptrs.len);
+      }
+      if (acc_elem->pvlen) {
+	snap_elem->pvlen = (struct pkt_vlen_hdr_primitives *) vlen_prims_copy(acc_elem->pvlen);
+	if (!snap_elem->pvlen) goto malloc_failed;
+      }
+
+      num++;
+    }
+  }
+
+  imt_snapshot_index_build(snap, &snap->exact, FALSE);
+  if (config.what_to_count & COUNT_SRC_HOST)
+    imt_snapshot_index_build(snap, &snap->index[snap->num_indexes++], COUNT_SRC_HOST);
+  if (config.what_to_count & COUNT_DST_HOST)
+    imt_snapshot_index_build(snap, &snap->index[snap->num_indexes++], COUNT_DST_HOST);
+  if (config.what_to_count & COUNT_SRC_AS)
+    imt_snapshot_index_build(snap, &snap->index[snap->num_indexes++], COUNT_SRC_AS);
+  if (config.what_to_count & COUNT_DST_AS)
+    imt_snapshot_index_build(snap, &snap->index[snap->num_indexes++], COUNT_DST_AS);
+  if (extras->off_pkt_bgp_primitives && (config.what_to_count & COUNT_PEER_SRC_IP))
+    imt_snapshot_index_build(snap, &snap->index[snap->num_indexes++], COUNT_PEER_SRC_IP);
+  if (extras->off_pkt_bgp_primitives && (config.what_to_count & COUNT_PEER_DST_IP))
+    imt_snapshot_index_build(snap, &snap->index[snap->num_indexes++], COUNT_PEER_DST_IP);
+
+  snap->refcnt = 1;
+  memcpy(&snap->stamp, &cycle_stamp, sizeof(struct timeval));
+
+  gettimeofday(&end, NULL);
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): Snapshot built: entries=%u indexes=%d (%ld usecs)\n", config.name, config.type,
+	snap->num, snap->num_indexes, (long)((end.tv_sec-start.tv_sec)*1000000+(end.tv_usec-start.tv_usec)));
+
+  return snap;
+
+  malloc_failed:
+  Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (imt_snapshot_build). Exiting ..\n", config.name, config.type);
+  exit_plugin(1);
+
+  return NULL;
+}
+
+u_int32_t imt_snapshot_key(pm_cfgreg_t type, struct pkt_primitives *p, struct pkt_bgp_primitives *pbgp)
+{
+  struct host_addr zero_addr;
+
+  /* hashed exactly as mask_elem() lays the primitive out, so that index slots agree with memcmp() */
+  switch (type) {
+  case COUNT_SRC_HOST:
+    return cache_crc32((unsigned char *) &p->src_ip, sizeof(struct host_addr));
+  case COUNT_DST_HOST:
+    return cache_crc32((unsigned char *) &p->dst_ip, sizeof(struct host_addr));
+  case COUNT_SRC_AS:
+    return p->src_as;
+  case COUNT_DST_AS:
+    return p->dst_as;
+  case COUNT_PEER_SRC_IP:
+  case COUNT_PEER_DST_IP:
+    if (!pbgp) {
+      memset(&zero_addr, 0, sizeof(zero_addr));
+      return cache_crc32((unsigned char *) &zero_addr, sizeof(struct host_addr));
+    }
+    if (type == COUNT_PEER_SRC_IP) return cache_crc32((unsigned char *) &pbgp->peer_src_ip, sizeof(struct host_addr));
+    else return cache_crc32((unsigned char *) &pbgp->peer_dst_ip, sizeof(struct host_addr));
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+void imt_snapshot_index_build(struct imt_snapshot *snap, struct imt_snapshot_index *sidx, pm_cfgreg_t type)
+{
+  struct acc *snap_elem;
+  u_int32_t idx, key, slot;
+
+  sidx->type = type;
+  sidx->modulo = (snap->num ? snap->num : 1);
+  sidx->head = malloc(sidx->modulo*sizeof(u_int32_t));
+  sidx->next = malloc(sidx->modulo*sizeof(u_int32_t));
+  if (!sidx->head || !sidx->next) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (imt_snapshot_index_build). Exiting ..\n", config.name, config.type);
+    exit_plugin(1);
+  }
+  memset(sidx->head, 0, sidx->modulo*sizeof(u_int32_t));
+  memset(sidx->next, 0, sidx->modulo*sizeof(u_int32_t));
+
+  /* insert backwards so that chains are walked in table order */
+  for (idx = snap->num; idx > 0; idx--) {
+    snap_elem = &snap->entries[idx-1];
+
+    if (type) key = imt_snapshot_key(type, &snap_elem->primitives, snap_elem->pbgp);
+    else key = snap_elem->signature;
+
+    slot = key % sidx->modulo;
+    sidx->next[idx-1] = sidx->head[slot];
+    sidx->head[slot] = idx;
+  }
+}
+
+struct imt_snapshot_index *imt_snapshot_select_index(struct imt_snapshot *snap, struct query_entry *request)
+{
+  int idx;
+
+  for (idx = 0; idx < snap->num_indexes; idx++) {
+    if (request->what_to_count & snap->index[idx].type) return &snap->index[idx];
+  }
+
+  return NULL;
+}
+
+struct acc *imt_snapshot_search(struct imt_snapshot *snap, struct primitives_ptrs *prim_ptrs)
+{
+  struct acc *snap_elem;
+  unsigned int hash;
+  u_int32_t pos;
+
+  hash = hash_accounting_structure(prim_ptrs);
+
+  for (pos = snap->exact.head[hash % snap->exact.modulo]; pos; pos = snap->exact.next[pos-1]) {
+    snap_elem = &snap->entries[pos-1];
+    if (snap_elem->signature == hash && !compare_accounting_structure(snap_elem, prim_ptrs)) return snap_elem;
+  }
+
+  return NULL;
+}
+
+void imt_snapshot_release(struct imt_snapshot *snap)
+{
+  u_int32_t idx;
+  int refcnt;
+
+  if (!snap) return;
+
+#if defined ENABLE_THREADS
+  pthread_mutex_lock(&imt_query_mutex);
+#endif
+  refcnt = --snap->refcnt;
+#if defined ENABLE_THREADS
+  pthread_mutex_unlock(&imt_query_mutex);
+#endif
+
+  if (refcnt > 0) return;
+
+  for (idx = 0; idx < snap->num; idx++) {
+    if (snap->entries[idx].clbgp) free_cache_legacy_bgp_primitives(&snap->entries[idx].clbgp);
+    if (snap->entries[idx].pvlen) vlen_prims_free(snap->entries[idx].pvlen);
+  }
+
+  free(snap->exact.head);
+  free(snap->exact.next);
+  for (idx = 0; idx < snap->num_indexes; idx++) {
+    free(snap->index[idx].head);
+    free(snap->index[idx].next);
+  }
+
+  if (snap->pbgp) free(snap->pbgp);
+  if (snap->pnat) free(snap->pnat);
+  if (snap->pmpls) free(snap->pmpls);
+  if (snap->ptun) free(snap->ptun);
+  if (snap->pcust) free(snap->pcust);
+  free(snap->entries);
+  free(snap->bdesc);
+  free(snap);
+}
+
+/* drops the plugin's own reference; queries in flight keep theirs */
+void imt_snapshot_invalidate()
+{
+  if (imt_snap_current) {
+    imt_snapshot_release(imt_snap_current);
+    imt_snap_current = NULL;
+  }
+}
+
+#if defined ENABLE_THREADS
+void imt_query_thread_wrapper()
+{
+  pthread_mutex_init(&imt_query_mutex, NULL);
+  pthread_cond_init(&imt_query_cond, NULL);
+  imt_query_head = imt_query_tail = NULL;
+
+  /* initialize threads pool */
+  imt_query_pool = allocate_thread_pool(1);
+  assert(imt_query_pool);
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d query thread(s) initialized\n", config.name, config.type, 1);
+
+  /* giving a kick to the query thread */
+  send_to_pool(imt_query_pool, imt_query_daemon, NULL);
+}
+
+void imt_query_daemon()
+{
+  struct imt_query_job *job;
+
+  for (;;) {
+    pthread_mutex_lock(&imt_query_mutex);
+    while (!imt_query_head) pthread_cond_wait(&imt_query_cond, &imt_query_mutex);
+    job = imt_query_head;
+    imt_query_head = job->next;
+    if (!imt_query_head) imt_query_tail = NULL;
+    pthread_mutex_unlock(&imt_query_mutex);
+
+    process_query_data(job->sd, job->buf, job->len, &job->extras, job->datasize, TRUE, job->snap);
+    close(job->sd);
+
+    imt_snapshot_release(job->snap);
+    free(job->buf);
+    free(job);
+  }
+}
+
+/* parks a read-only query until the next imt_query_dispatch(); ownership of 'sd' goes with it */
+void imt_query_enqueue(int sd, unsigned char *buf, int len, struct extra_primitives *extras, int datasize)
+{
+  struct imt_query_job *job;
+
+  job = malloc(sizeof(struct imt_query_job));
+  if (job) job->buf = malloc(len);
+  if (!job || !job->buf) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (imt_query_enqueue). Exiting ..\n", config.name, config.type);
+    exit_plugin(1);
+  }
+
+  memcpy(job->buf, buf, len);
+  job->sd = sd;
+  job->len = len;
+  memcpy(&job->extras, extras, sizeof(struct extra_primitives));
+  job->datasize = datasize;
+  job->snap = NULL;
+  job->stamp = cycle_stamp.tv_sec;
+  job->next = NULL;
+
+  if (imt_query_pending_tail) imt_query_pending_tail->next = job;
+  else imt_query_pending_head = job;
+  imt_query_pending_tail = job;
+}
+
+/*
+   called by the plugin loop at its idle point: (re)builds the snapshot,
+   if needed, and hands all parked queries over to the query thread
+*/
+void imt_query_dispatch(struct extra_primitives *extras)
+{
+  struct imt_query_job *job;
+
+  if (!imt_query_pending_head) return;
+
+  if (imt_snap_current && (cycle_stamp.tv_sec - imt_snap_current->stamp.tv_sec) >= config.imt_snapshot_refresh_time)
+    imt_snapshot_invalidate();
+
+  if (!imt_snap_current) imt_snap_current = imt_snapshot_build(extras);
+
+  pthread_mutex_lock(&imt_query_mutex);
+  for (job = imt_query_pending_head; job; job = job->next) {
+    job->snap = imt_snap_current;
+    imt_snap_current->refcnt++;
+  }
+  if (imt_query_tail) imt_query_tail->next = imt_query_pending_head;
+  else imt_query_head = imt_query_pending_head;
+  imt_query_tail = imt_query_pending_tail;
+  pthread_cond_signal(&imt_query_cond);
+  pthread_mutex_unlock(&imt_query_mutex);
+
+  imt_query_pending_head = imt_query_pending_tail = NULL;
+}
+#endif
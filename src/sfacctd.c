@@ -38,6 +38,7 @@
 #include "classifier.h"
 #include "net_aggr.h"
 #include "crc32.h"
+#include "jhash.h"
 #include "isis/isis.h"
 #include "bmp/bmp.h"
 #ifdef WITH_RABBITMQ
@@ -130,6 +131,7 @@ int main(int argc,char **argv, char **envp)
   struct ip_mreq multi_req4;
 
   struct pcap_device device;
+  struct timespec stats_ts;
 
   unsigned char dummy_packet[64]; 
   unsigned char dummy_packet_vlan[64]; 
@@ -418,6 +420,8 @@ int main(int argc,char **argv, char **envp)
     else Log(LOG_INFO, "INFO ( %s/core ): proc_priority set to %d\n", config.name, getpriority(PRIO_PROCESS, 0));
   }
 
+  if (config.cpu_affinity) pm_set_placement(config.cpu_affinity, config.numa_bind, config.name, "core");
+
   Log(LOG_INFO, "INFO ( %s/core ): %s (%s)\n", config.name, SFACCTD_USAGE_HEADER, PMACCT_BUILD);
   Log(LOG_INFO, "INFO ( %s/core ): %s\n", config.name, PMACCT_COMPILE_ARGS);
 
@@ -806,6 +810,7 @@ int main(int argc,char **argv, char **envp)
   load_plugins(&req);
   load_plugin_filters(1);
   evaluate_packet_handlers();
+  sf_decode_init(&req);
   pm_setproctitle("%s [%s]", "Core Process", config.proc_name);
   if (config.pidfile) write_pid_file(config.pidfile);
   load_networks(config.networks_file, &nt, &nc);
@@ -1015,14 +1020,40 @@ int main(int argc,char **argv, char **envp)
 #endif
   }
 
+  if (config.sfacctd_counter_refresh_time) {
+    if (sfacctd_counter_backend_methods) sf_cnt_table_init();
+    else {
+      Log(LOG_WARNING, "WARN ( %s/core ): 'sfacctd_counter_refresh_time' set but no sFlow counters backend is configured. Ignored.\n", config.name);
+      config.sfacctd_counter_refresh_time = 0;
+    }
+  }
+
+  /* wake up periodically to commit buffers held for too long, see plugin_buffer_latency */
+  if (pipe_buffer_latency && !config.pcap_savefile) {
+    struct timeval rcvtimeo;
+
+    rcvtimeo.tv_sec = (pipe_buffer_latency / 1000);
+    rcvtimeo.tv_usec = ((pipe_buffer_latency % 1000) * 1000);
+    if (setsockopt(config.sock, SOL_SOCKET, SO_RCVTIMEO, &rcvtimeo, sizeof(rcvtimeo)) < 0)
+      Log(LOG_WARNING, "WARN ( %s/core ): setsockopt() failed for SO_RCVTIMEO.\n", config.name);
+  }
+
   /* Main loop */
   for (;;) {
     if (!config.pcap_savefile) {
+      STATS_START(stats_ts);
       ret = recvfrom(config.sock, sflow_packet, SFLOW_MAX_MSG_SIZE, 0, (struct sockaddr *) &client, &clen);
+      STATS_STOP(STATS_RECV, stats_ts);
     }
     else {
       ret = recvfrom_savefile(&device, (void **) &sflow_packet, (struct sockaddr *) &client, &spp.ts);
     }
+
+    commit_expired_pipe_buffers();
+
+    /* ie. receive timeout */
+    if (ret < 0) continue;
+
     spp.rawSample = pptrs.v4.f_header = sflow_packet;
     spp.rawSampleLen = pptrs.v4.f_len = ret;
     spp.datap = (u_int32_t *) spp.rawSample;
@@ -1101,9 +1132,14 @@ int main(int argc,char **argv, char **envp)
           sfacctd_counter_init_kafka_host();
       }
 #endif
+
+      if (config.sfacctd_counter_refresh_time && sf_cnt_misc_db->log_tstamp.tv_sec >= sf_cnt_table.next_publish)
+	sf_cnt_table_publish(sf_cnt_misc_db->log_tstamp.tv_sec);
     }
 
     if (data_plugins) {
+      STATS_START(stats_ts);
+
       switch(spp.datagramVersion = getData32(&spp)) {
       case 5:
 	getAddress(&spp, &spp.agent_addr);
@@ -1159,6 +1195,8 @@ int main(int argc,char **argv, char **envp)
 	}
 	break;
       }
+
+      STATS_STOP(STATS_DECODE, stats_ts);
     }
     else if (tee_plugins) {
       process_SF_raw_packet(&spp, &pptrs, &req, (struct sockaddr *) &client);
@@ -1922,6 +1960,77 @@ u_int8_t SF_evaluate_flow_type(struct packet_ptrs *pptrs)
   return ret;
 }
 
+/*
+   Works out, from the union of what plugins aggregate on, how deep flow
+   samples need to be decoded. Anything that may look at arbitrary fields
+   of a sample (maps, filters, BGP/BMP/IGP correlation, classifiers, custom
+   primitives) gets the full decode.
+*/
+void sf_decode_init(struct plugin_requests *req)
+{
+  struct plugins_list_entry *list;
+  u_int64_t wtc, wtc_2;
+  int full = FALSE;
+
+  sf_decode = 0;
+
+  if (config.sfacctd_full_decode || req->bpf_filter || config.nfacctd_flow_to_rd_map ||
+      config.classifiers_path || config.classifier_ndpi) full = TRUE;
+
+  /* BGP, BMP and IS-IS lookups are keyed on addresses of the sampled packet */
+  if (config.nfacctd_bgp || config.nfacctd_bmp || config.nfacctd_isis) full = TRUE;
+
+  for (list = plugins_list; list && !full; list = list->next) {
+    if (list->type.id == PLUGIN_ID_CORE) continue;
+
+    if (list->cfg.pre_tag_map || list->cfg.cpptrs.num) {
+      full = TRUE;
+      break;
+    }
+
+    wtc = list->cfg.what_to_count;
+    wtc_2 = list->cfg.what_to_count_2;
+
+    if (wtc & (COUNT_SRC_PORT|COUNT_DST_PORT|COUNT_SUM_PORT|COUNT_TCPFLAGS))
+      sf_decode |= (SF_DECODE_L3|SF_DECODE_L4);
+
+    if (wtc_2 & (COUNT_TUNNEL_SRC_HOST|COUNT_TUNNEL_DST_HOST|COUNT_TUNNEL_IP_PROTO|COUNT_TUNNEL_IP_TOS))
+      sf_decode |= (SF_DECODE_L3|SF_DECODE_L4);
+
+    if (wtc & (COUNT_SRC_AS|COUNT_DST_AS|COUNT_SUM_AS|COUNT_STD_COMM|COUNT_EXT_COMM|COUNT_AS_PATH|
+	       COUNT_LOCAL_PREF|COUNT_MED|COUNT_PEER_SRC_AS|COUNT_PEER_DST_AS|COUNT_PEER_DST_IP|
+	       COUNT_SRC_AS_PATH|COUNT_SRC_STD_COMM|COUNT_SRC_EXT_COMM|COUNT_SRC_LOCAL_PREF|
+	       COUNT_SRC_MED) || wtc_2 & (COUNT_LRG_COMM|COUNT_SRC_LRG_COMM)) {
+      sf_decode |= SF_DECODE_GATEWAY;
+      if ((list->cfg.nfacctd_as & ~NF_AS_FALLBACK) != NF_AS_KEEP) sf_decode |= SF_DECODE_L3;
+    }
+
+    if (list->cfg.nfacctd_net && (list->cfg.nfacctd_net & ~NF_NET_FALLBACK) != NF_NET_KEEP)
+      sf_decode |= SF_DECODE_L3;
+
+    /* anything not known to be served by link layer, switch, router or
+       gateway elements needs the IP layer */
+    wtc &= ~(COUNT_SRC_PORT|COUNT_DST_PORT|COUNT_SUM_PORT|COUNT_TCPFLAGS|COUNT_SRC_MAC|
+	     COUNT_DST_MAC|COUNT_SUM_MAC|COUNT_VLAN|COUNT_COS|COUNT_ETHERTYPE|COUNT_IN_IFACE|
+	     COUNT_OUT_IFACE|COUNT_SRC_NMASK|COUNT_DST_NMASK|COUNT_TAG|COUNT_TAG2|COUNT_CLASS|
+	     COUNT_COUNTERS|COUNT_FLOWS|COUNT_SRC_AS|COUNT_DST_AS|COUNT_SUM_AS|COUNT_STD_COMM|
+	     COUNT_EXT_COMM|COUNT_AS_PATH|COUNT_LOCAL_PREF|COUNT_MED|COUNT_PEER_SRC_AS|
+	     COUNT_PEER_DST_AS|COUNT_PEER_DST_IP|COUNT_SRC_AS_PATH|COUNT_SRC_STD_COMM|
+	     COUNT_SRC_EXT_COMM|COUNT_SRC_LOCAL_PREF|COUNT_SRC_MED|COUNT_PEER_SRC_IP);
+    wtc_2 &= ~(COUNT_SAMPLING_RATE|COUNT_TIMESTAMP_START|COUNT_TIMESTAMP_END|COUNT_TIMESTAMP_ARRIVAL|
+	       COUNT_MPLS_LABEL_TOP|COUNT_MPLS_LABEL_BOTTOM|COUNT_MPLS_STACK_DEPTH|COUNT_EXPORT_PROTO_SEQNO|
+	       COUNT_EXPORT_PROTO_VERSION|COUNT_LRG_COMM|COUNT_SRC_LRG_COMM|COUNT_TUNNEL_SRC_HOST|
+	       COUNT_TUNNEL_DST_HOST|COUNT_TUNNEL_IP_PROTO|COUNT_TUNNEL_IP_TOS);
+    if (wtc || wtc_2) sf_decode |= SF_DECODE_L3;
+  }
+
+  if (full) sf_decode = SF_DECODE_ALL;
+
+  Log(LOG_INFO, "INFO ( %s/core ): sFlow decoding: ip=%s transport=%s gateway=%s extra=%s\n", config.name,
+	(sf_decode & SF_DECODE_L3) ? "yes" : "no", (sf_decode & SF_DECODE_L4) ? "yes" : "no",
+	(sf_decode & SF_DECODE_GATEWAY) ? "yes" : "no", (sf_decode & SF_DECODE_EXTRA) ? "yes" : "no");
+}
+
 void set_vector_sample_type(struct packet_ptrs_vector *pptrsv, u_int32_t sample_type)
 {
   pptrsv->v4.sample_type = sample_type;
@@ -2136,15 +2245,8 @@ int sf_cnt_log_msg(struct bgp_peer *peer, SFSample *sample, int version, u_int32
   return (ret | amqp_ret | kafka_ret);
 }
 
-int readCounters_generic(struct bgp_peer *peer, SFSample *sample, char *event_type, int output, void *vobj)
+void sf_cnt_read_generic(SFSample *sample)
 {
-  char msg_type[] = "sflow_cnt_generic";
-  int ret = 0;
-#ifdef WITH_JANSSON
-  char ip_address[INET6_ADDRSTRLEN];
-  json_t *obj = (json_t *) vobj, *kv;
-
-  /* parse sFlow first and foremost */
   sample->ifCounters.ifIndex = getData32(sample);
   sample->ifCounters.ifType = getData32(sample);
   sample->ifCounters.ifSpeed = getData64(sample);
@@ -2165,6 +2267,18 @@ int readCounters_generic(struct bgp_peer *peer, SFSample *sample, char *event_ty
   sample->ifCounters.ifOutDiscards = getData32(sample);
   sample->ifCounters.ifOutErrors = getData32(sample);
   sample->ifCounters.ifPromiscuousMode = getData32(sample);
+}
+
+int readCounters_generic(struct bgp_peer *peer, SFSample *sample, char *event_type, int output, void *vobj)
+{
+  char msg_type[] = "sflow_cnt_generic";
+  int ret = 0;
+#ifdef WITH_JANSSON
+  char ip_address[INET6_ADDRSTRLEN];
+  json_t *obj = (json_t *) vobj, *kv;
+
+  /* parse sFlow first and foremost */
+  sf_cnt_read_generic(sample);
 
   if (!peer || !sample || !vobj) return ret;
 
@@ -2388,3 +2502,218 @@ void sf_cnt_link_misc_structs(struct bgp_misc_structs *bms)
 
   /* dump not supported */
 }
+
+void sf_cnt_table_init()
+{
+  sf_cnt_table.buckets = malloc(SF_CNT_TABLE_BUCKETS * sizeof(struct sf_cnt_entry *));
+  if (!sf_cnt_table.buckets) {
+    Log(LOG_ERR, "ERROR ( %s/core ): Unable to malloc() sFlow counters table. Exiting.\n", config.name);
+    exit(1);
+  }
+
+  memset(sf_cnt_table.buckets, 0, SF_CNT_TABLE_BUCKETS * sizeof(struct sf_cnt_entry *));
+  sf_cnt_table.entries = 0;
+  sf_cnt_table.next_publish = 0;
+}
+
+/*
+   Counters are accounted as deltas against the previous sample of the
+   same interface; the agent sysUpTime is the time base. An uptime or an
+   octets counter going backwards means the agent (or the interface) was
+   reset: the entry is rebased without accounting anything.
+*/
+void sf_cnt_table_update(struct xflow_status_entry *xse, SFSample *sample)
+{
+  SFLIf_counters *cnt = &sample->ifCounters;
+  struct sf_cnt_entry *entry;
+  u_int32_t bucket, in_pkts, out_pkts;
+  static int warned = FALSE;
+
+  if (!xse || !sf_cnt_table.buckets) return;
+
+  bucket = jhash_2words((u_int32_t)(unsigned long) xse, cnt->ifIndex, 0) & (SF_CNT_TABLE_BUCKETS - 1);
+  for (entry = sf_cnt_table.buckets[bucket]; entry; entry = entry->next) {
+    if (entry->agent == xse && entry->ifIndex == cnt->ifIndex) break;
+  }
+
+  in_pkts = cnt->ifInUcastPkts + cnt->ifInMulticastPkts + cnt->ifInBroadcastPkts;
+  out_pkts = cnt->ifOutUcastPkts + cnt->ifOutMulticastPkts + cnt->ifOutBroadcastPkts;
+
+  if (!entry) {
+    if (sf_cnt_table.entries >= SF_CNT_TABLE_MAX_ENTRIES) {
+      if (!warned) {
+        Log(LOG_WARNING, "WARN ( %s/core ): sFlow counters table is full (%u entries). New interfaces are ignored.\n", config.name, SF_CNT_TABLE_MAX_ENTRIES);
+        warned = TRUE;
+      }
+      return;
+    }
+
+    entry = malloc(sizeof(struct sf_cnt_entry));
+    if (!entry) {
+      Log(LOG_WARNING, "WARN ( %s/core ): Unable to malloc() sFlow counters table entry.\n", config.name);
+      return;
+    }
+
+    memset(entry, 0, sizeof(struct sf_cnt_entry));
+    entry->agent = xse;
+    entry->ifIndex = cnt->ifIndex;
+    entry->next = sf_cnt_table.buckets[bucket];
+    sf_cnt_table.buckets[bucket] = entry;
+    sf_cnt_table.entries++;
+  }
+  else if (sample->sysUpTime > entry->uptime && cnt->ifInOctets >= entry->in_octets &&
+	   cnt->ifOutOctets >= entry->out_octets) {
+    entry->d_msecs += (sample->sysUpTime - entry->uptime);
+    entry->d_in_octets += (cnt->ifInOctets - entry->in_octets);
+    entry->d_out_octets += (cnt->ifOutOctets - entry->out_octets);
+
+    /* 32 bits counters: unsigned arithmetics takes care of wraps */
+    entry->d_in_pkts += (u_int32_t)(in_pkts - entry->in_pkts);
+    entry->d_out_pkts += (u_int32_t)(out_pkts - entry->out_pkts);
+    entry->d_in_errors += (u_int32_t)(cnt->ifInErrors - entry->in_errors);
+    entry->d_out_errors += (u_int32_t)(cnt->ifOutErrors - entry->out_errors);
+    entry->d_in_discards += (u_int32_t)(cnt->ifInDiscards - entry->in_discards);
+    entry->d_out_discards += (u_int32_t)(cnt->ifOutDiscards - entry->out_discards);
+    entry->updated = TRUE;
+  }
+
+  entry->ifStatus = cnt->ifStatus;
+  entry->ifSpeed = cnt->ifSpeed;
+  entry->uptime = sample->sysUpTime;
+  entry->last_update = sf_cnt_misc_db->log_tstamp.tv_sec;
+
+  entry->in_octets = cnt->ifInOctets;
+  entry->out_octets = cnt->ifOutOctets;
+  entry->in_pkts = in_pkts;
+  entry->out_pkts = out_pkts;
+  entry->in_errors = cnt->ifInErrors;
+  entry->out_errors = cnt->ifOutErrors;
+  entry->in_discards = cnt->ifInDiscards;
+  entry->out_discards = cnt->ifOutDiscards;
+}
+
+void sf_cnt_table_publish(time_t now)
+{
+  struct sf_cnt_entry *entry, **prev;
+  struct xflow_status_entry *xse;
+  time_t expire = now - (SF_CNT_TABLE_EXPIRE * config.sfacctd_counter_refresh_time);
+  u_int32_t bucket;
+
+  for (bucket = 0; bucket < SF_CNT_TABLE_BUCKETS; bucket++) {
+    prev = &sf_cnt_table.buckets[bucket];
+
+    while ((entry = *prev)) {
+      if (entry->last_update < expire) {
+        *prev = entry->next;
+        free(entry);
+        sf_cnt_table.entries--;
+        continue;
+      }
+
+      if (entry->updated && entry->d_msecs) {
+        xse = (struct xflow_status_entry *) entry->agent;
+        sf_cnt_rate_log_msg((struct bgp_peer *) xse->sf_cnt, entry, "log", config.sfacctd_counter_output);
+
+        entry->d_in_octets = entry->d_out_octets = 0;
+        entry->d_in_pkts = entry->d_out_pkts = 0;
+        entry->d_in_errors = entry->d_out_errors = 0;
+        entry->d_in_discards = entry->d_out_discards = 0;
+        entry->d_msecs = 0;
+        entry->updated = FALSE;
+      }
+
+      prev = &entry->next;
+    }
+  }
+
+  sf_cnt_table.next_publish = now - (now % config.sfacctd_counter_refresh_time) + config.sfacctd_counter_refresh_time;
+}
+
+int sf_cnt_rate_log_msg(struct bgp_peer *peer, struct sf_cnt_entry *entry, char *event_type, int output)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_SFLOW_COUNTER);
+  char msg_type[] = "sflow_cnt_rate";
+  int ret = 0, amqp_ret = 0, kafka_ret = 0;
+
+  if (!bms || !peer || !peer->log || !entry || !event_type) return ret;
+
+#ifdef WITH_RABBITMQ
+  if (config.sfacctd_counter_amqp_routing_key)
+    p_amqp_set_routing_key(peer->log->amqp_host, peer->log->filename);
+#endif
+
+#ifdef WITH_KAFKA
+  if (config.sfacctd_counter_kafka_topic)
+    p_kafka_set_topic(peer->log->kafka_host, peer->log->filename);
+#endif
+
+  if (output == PRINT_OUTPUT_JSON) {
+#ifdef WITH_JANSSON
+    char ip_address[INET6_ADDRSTRLEN];
+    json_t *obj = json_object();
+
+    json_object_set_new_nocheck(obj, "seq", json_integer((json_int_t)bms->log_seq));
+    bgp_peer_log_seq_increment(&bms->log_seq);
+
+    json_object_set_new_nocheck(obj, "timestamp", json_string(bms->log_tstamp_str));
+
+    addr_to_str(ip_address, &peer->addr);
+    json_object_set_new_nocheck(obj, "peer_ip_src", json_string(ip_address));
+
+    json_object_set_new_nocheck(obj, "event_type", json_string(event_type));
+
+    json_object_set_new_nocheck(obj, "sf_cnt_type", json_string(msg_type));
+
+    json_object_set_new_nocheck(obj, "ifIndex", json_integer((json_int_t)entry->ifIndex));
+
+    json_object_set_new_nocheck(obj, "ifSpeed", json_integer((json_int_t)entry->ifSpeed));
+
+    json_object_set_new_nocheck(obj, "ifStatus", json_integer((json_int_t)entry->ifStatus));
+
+    json_object_set_new_nocheck(obj, "interval_msecs", json_integer((json_int_t)entry->d_msecs));
+
+    json_object_set_new_nocheck(obj, "ifInOctets", json_integer((json_int_t)entry->d_in_octets));
+
+    json_object_set_new_nocheck(obj, "ifOutOctets", json_integer((json_int_t)entry->d_out_octets));
+
+    json_object_set_new_nocheck(obj, "ifInPkts", json_integer((json_int_t)entry->d_in_pkts));
+
+    json_object_set_new_nocheck(obj, "ifOutPkts", json_integer((json_int_t)entry->d_out_pkts));
+
+    json_object_set_new_nocheck(obj, "ifInErrors", json_integer((json_int_t)entry->d_in_errors));
+
+    json_object_set_new_nocheck(obj, "ifOutErrors", json_integer((json_int_t)entry->d_out_errors));
+
+    json_object_set_new_nocheck(obj, "ifInDiscards", json_integer((json_int_t)entry->d_in_discards));
+
+    json_object_set_new_nocheck(obj, "ifOutDiscards", json_integer((json_int_t)entry->d_out_discards));
+
+    json_object_set_new_nocheck(obj, "ifInBps", json_integer((json_int_t)(entry->d_in_octets * 8 * 1000 / entry->d_msecs)));
+
+    json_object_set_new_nocheck(obj, "ifOutBps", json_integer((json_int_t)(entry->d_out_octets * 8 * 1000 / entry->d_msecs)));
+
+    json_object_set_new_nocheck(obj, "ifInPps", json_integer((json_int_t)(entry->d_in_pkts * 1000 / entry->d_msecs)));
+
+    json_object_set_new_nocheck(obj, "ifOutPps", json_integer((json_int_t)(entry->d_out_pkts * 1000 / entry->d_msecs)));
+
+    if (config.sfacctd_counter_file)
+      write_and_free_json(peer->log->fd, obj);
+
+#ifdef WITH_RABBITMQ
+    if (config.sfacctd_counter_amqp_routing_key) {
+      amqp_ret = write_and_free_json_amqp(peer->log->amqp_host, obj);
+      p_amqp_unset_routing_key(peer->log->amqp_host);
+    }
+#endif
+
+#ifdef WITH_KAFKA
+    if (config.sfacctd_counter_kafka_topic) {
+      kafka_ret = write_and_free_json_kafka(peer->log->kafka_host, obj);
+      p_kafka_unset_topic(peer->log->kafka_host);
+    }
+#endif
+#endif
+  }
+
+  return (ret | amqp_ret | kafka_ret);
+}
@@ -29,6 +29,17 @@
 #define SFLOW_MIN_MSG_SIZE 200 
 #define SFLOW_MAX_MSG_SIZE 65536 /* inflated ? */
 #define MAX_SF_CNT_LOG_ENTRIES 1024
+#define SF_CNT_GENERIC_LEN 88 /* generic interface counters block */
+#define SF_CNT_TABLE_BUCKETS 4096 /* power of 2 */
+#define SF_CNT_TABLE_MAX_ENTRIES 65536
+#define SF_CNT_TABLE_EXPIRE 3 /* refresh intervals an idle interface is kept around */
+
+/* sFlow decoding depth, computed once by sf_decode_init() */
+#define SF_DECODE_L3		0x00000001 /* sampled header: IP layer */
+#define SF_DECODE_L4		0x00000002 /* sampled header: transport layer, tunnels */
+#define SF_DECODE_GATEWAY	0x00000004 /* extended gateway element */
+#define SF_DECODE_EXTRA		0x00000008 /* user, url, mpls, nat, vlan tunnel, process elements */
+#define SF_DECODE_ALL		(SF_DECODE_L3|SF_DECODE_L4|SF_DECODE_GATEWAY|SF_DECODE_EXTRA)
 
 enum INMPacket_information_type {
   INMPACKETTYPE_HEADER  = 1,      /* Packet headers are sampled */
@@ -262,6 +273,44 @@ struct SF_icmphdr
   /* ignore the rest */
 };
 
+/* latest counters of an (agent, ifIndex) plus deltas since last publish */
+struct sf_cnt_entry {
+  void *agent;			/* struct xflow_status_entry */
+  u_int32_t ifIndex;
+  u_int32_t ifStatus;
+  u_int64_t ifSpeed;
+  u_int32_t uptime;		/* agent sysUpTime at last update, msecs */
+  time_t last_update;
+  u_int8_t updated;
+
+  u_int64_t in_octets;
+  u_int64_t out_octets;
+  u_int32_t in_pkts;		/* ucast + mcast + bcast, wraps as the 32 bits counters do */
+  u_int32_t out_pkts;
+  u_int32_t in_errors;
+  u_int32_t out_errors;
+  u_int32_t in_discards;
+  u_int32_t out_discards;
+
+  u_int64_t d_in_octets;
+  u_int64_t d_out_octets;
+  u_int64_t d_in_pkts;
+  u_int64_t d_out_pkts;
+  u_int64_t d_in_errors;
+  u_int64_t d_out_errors;
+  u_int64_t d_in_discards;
+  u_int64_t d_out_discards;
+  u_int64_t d_msecs;
+
+  struct sf_cnt_entry *next;
+};
+
+struct sf_cnt_table {
+  struct sf_cnt_entry **buckets;
+  u_int32_t entries;
+  time_t next_publish;
+};
+
 struct SF_dissect {
   char *hdrBasePtr;
   char *hdrEndPtr;
@@ -339,17 +388,25 @@ EXT int readCounters_vlan(struct bgp_peer *, SFSample *, char *, int, void *);
 EXT void sfacctd_counter_init_amqp_host();
 EXT int sfacctd_counter_init_kafka_host();
 EXT void sf_cnt_link_misc_structs(struct bgp_misc_structs *);
+EXT void sf_cnt_read_generic(SFSample *);
+EXT void sf_cnt_table_init();
+EXT void sf_cnt_table_update(struct xflow_status_entry *, SFSample *);
+EXT void sf_cnt_table_publish(time_t);
+EXT int sf_cnt_rate_log_msg(struct bgp_peer *, struct sf_cnt_entry *, char *, int);
 
 EXT char *sfv245_check_status(SFSample *spp, struct sockaddr *);
 EXT void sfv245_check_counter_log_init(struct packet_ptrs *);
 
 EXT void usage_daemon(char *);
 EXT void compute_once();
+EXT void sf_decode_init(struct plugin_requests *);
 
 /* global variables */
 EXT int sfacctd_counter_backend_methods;
 EXT struct bgp_misc_structs *sf_cnt_misc_db;
+EXT struct sf_cnt_table sf_cnt_table;
 EXT struct host_addr debug_a;
 EXT u_char debug_agent_addr[50];
 EXT u_int16_t debug_agent_port;
+EXT u_int32_t sf_decode;
 #undef EXT
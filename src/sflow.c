@@ -266,6 +266,8 @@ void decodeIPV4(SFSample *sample)
       /* ip headerLen is expressed as a number of quads */
       ptr += (ip.version_and_headerLen & 0x0f) * 4;
 
+      if (!(sf_decode & SF_DECODE_L4)) return;
+
       if (ip.protocol == 4 /* ipencap */ || ip.protocol == 94 /* ipip */) {
 	sample->got_inner_IPV4 = TRUE;
 	decodeIPV4_inner(sample, ptr);
@@ -348,6 +350,8 @@ void decodeIPV6(SFSample *sample)
     // remember as the ip protocol...
     sample->dcd_ipProtocol = nextHeader;
 
+    if (!(sf_decode & SF_DECODE_L4)) return;
+
     if (sample->dcd_ipProtocol == 4 /* ipencap */ || sample->dcd_ipProtocol == 94 /* ipip */) {
       sample->got_inner_IPV4 = TRUE;
       decodeIPV4_inner(sample, ptr); 
@@ -922,10 +926,13 @@ void readFlowSample_header(SFSample *sample)
     break;
   }
   
-  if (sample->gotIPV4) decodeIPV4(sample);
+  /* link layer is always decoded: flow type and MPLS/VLAN stacks depend on it */
+  if (sf_decode & SF_DECODE_L3) {
+    if (sample->gotIPV4) decodeIPV4(sample);
 #if defined ENABLE_IPV6
-  else if (sample->gotIPV6) decodeIPV6(sample);
+    else if (sample->gotIPV6) decodeIPV6(sample);
 #endif
+  }
 
   skipBytes(sample, sample->headerLen);
 }
@@ -1056,6 +1063,7 @@ void readv2v4FlowSample(SFSample *sample, struct packet_ptrs_vector *pptrsv, str
       case INMEXTENDED_SWITCH: readExtendedSwitch(sample); break;
       case INMEXTENDED_ROUTER: readExtendedRouter(sample); break;
       case INMEXTENDED_GATEWAY:
+	/* v2/v4 elements carry no length: they can't be skipped, only decoded */
 	if(sample->datagramVersion == 2) readExtendedGateway_v2(sample);
 	else readExtendedGateway(sample);
 	break;
@@ -1072,6 +1080,32 @@ void readv2v4FlowSample(SFSample *sample, struct packet_ptrs_vector *pptrsv, str
   finalizeSample(sample, pptrsv, req);
 }
 
+/*_________________---------------------------__________________
+  _________________  sf_flow_element_needed   __________________
+  -----------------___________________________------------------
+*/
+
+static int sf_flow_element_needed(u_int32_t tag)
+{
+  switch(tag) {
+  case SFLFLOW_EX_GATEWAY:
+    return (sf_decode & SF_DECODE_GATEWAY);
+  case SFLFLOW_EX_USER:
+  case SFLFLOW_EX_URL:
+  case SFLFLOW_EX_MPLS:
+  case SFLFLOW_EX_NAT:
+  case SFLFLOW_EX_MPLS_TUNNEL:
+  case SFLFLOW_EX_MPLS_VC:
+  case SFLFLOW_EX_MPLS_FTN:
+  case SFLFLOW_EX_MPLS_LDP_FEC:
+  case SFLFLOW_EX_VLAN_TUNNEL:
+  case SFLFLOW_EX_PROCESS:
+    return (sf_decode & SF_DECODE_EXTRA);
+  default:
+    return TRUE;
+  }
+}
+
 /*_________________---------------------------__________________
   _________________    readv5FlowSample         __________________
   -----------------___________________________------------------
@@ -1125,30 +1159,37 @@ void readv5FlowSample(SFSample *sample, int expanded, struct packet_ptrs_vector
       length = getData32(sample);
       start = (u_char *)sample->datap;
 
-      switch(tag) {
-      case SFLFLOW_HEADER:     readFlowSample_header(sample); break;
-      case SFLFLOW_ETHERNET:   readFlowSample_ethernet(sample); break;
-      case SFLFLOW_IPV4:       readFlowSample_IPv4(sample); break;
-      case SFLFLOW_IPV6:       readFlowSample_IPv6(sample); break;
-      case SFLFLOW_EX_SWITCH:  readExtendedSwitch(sample); break;
-      case SFLFLOW_EX_ROUTER:  readExtendedRouter(sample); break;
-      case SFLFLOW_EX_GATEWAY: readExtendedGateway(sample); break;
-      case SFLFLOW_EX_USER:    readExtendedUser(sample); break;
-      case SFLFLOW_EX_URL:     readExtendedUrl(sample); break;
-      case SFLFLOW_EX_MPLS:    readExtendedMpls(sample); break;
-      case SFLFLOW_EX_NAT:     readExtendedNat(sample); break;
-      case SFLFLOW_EX_MPLS_TUNNEL:  readExtendedMplsTunnel(sample); break;
-      case SFLFLOW_EX_MPLS_VC:      readExtendedMplsVC(sample); break;
-      case SFLFLOW_EX_MPLS_FTN:     readExtendedMplsFTN(sample); break;
-      case SFLFLOW_EX_MPLS_LDP_FEC: readExtendedMplsLDP_FEC(sample); break;
-      case SFLFLOW_EX_VLAN_TUNNEL:  readExtendedVlanTunnel(sample); break;
-      case SFLFLOW_EX_PROCESS:      readExtendedProcess(sample); break;
-      case SFLFLOW_EX_CLASS:	    readExtendedClass(sample); break;
-      case SFLFLOW_EX_CLASS2:	    readExtendedClass2(sample); break;
-      case SFLFLOW_EX_TAG:	    readExtendedTag(sample); break;
-      default:
+      /* elements not read by any configured primitive are skipped by
+	 length; they still make it to the modules db below */
+      if (!sf_flow_element_needed(tag)) {
 	if (skipBytesAndCheck(sample, length) == ERR) return;
-	break;
+      }
+      else {
+	switch(tag) {
+	case SFLFLOW_HEADER:     readFlowSample_header(sample); break;
+	case SFLFLOW_ETHERNET:   readFlowSample_ethernet(sample); break;
+	case SFLFLOW_IPV4:       readFlowSample_IPv4(sample); break;
+	case SFLFLOW_IPV6:       readFlowSample_IPv6(sample); break;
+	case SFLFLOW_EX_SWITCH:  readExtendedSwitch(sample); break;
+	case SFLFLOW_EX_ROUTER:  readExtendedRouter(sample); break;
+	case SFLFLOW_EX_GATEWAY: readExtendedGateway(sample); break;
+	case SFLFLOW_EX_USER:    readExtendedUser(sample); break;
+	case SFLFLOW_EX_URL:     readExtendedUrl(sample); break;
+	case SFLFLOW_EX_MPLS:    readExtendedMpls(sample); break;
+	case SFLFLOW_EX_NAT:     readExtendedNat(sample); break;
+	case SFLFLOW_EX_MPLS_TUNNEL:  readExtendedMplsTunnel(sample); break;
+	case SFLFLOW_EX_MPLS_VC:      readExtendedMplsVC(sample); break;
+	case SFLFLOW_EX_MPLS_FTN:     readExtendedMplsFTN(sample); break;
+	case SFLFLOW_EX_MPLS_LDP_FEC: readExtendedMplsLDP_FEC(sample); break;
+	case SFLFLOW_EX_VLAN_TUNNEL:  readExtendedVlanTunnel(sample); break;
+	case SFLFLOW_EX_PROCESS:      readExtendedProcess(sample); break;
+	case SFLFLOW_EX_CLASS:	    readExtendedClass(sample); break;
+	case SFLFLOW_EX_CLASS2:	    readExtendedClass2(sample); break;
+	case SFLFLOW_EX_TAG:	    readExtendedTag(sample); break;
+	default:
+	  if (skipBytesAndCheck(sample, length) == ERR) return;
+	  break;
+	}
       }
 
       db_field = sfv5_modules_db_get_next_ie(tag);
@@ -1214,7 +1255,16 @@ void readv5CountersSample(SFSample *sample, int expanded, struct packet_ptrs_vec
     }
     else Log(LOG_WARNING, "WARN ( %s/core ): readv5CountersSample(): no IEs available in SFv5 modules DB.\n", config.name);
 
-    if (sfacctd_counter_backend_methods) sf_cnt_log_msg(peer, sample, sample->datagramVersion, length, "log", config.sfacctd_counter_output, tag);
+    if (config.sfacctd_counter_refresh_time) {
+      /* fast path: generic counters only, into the (agent, ifIndex) table */
+      if (tag == SFLCOUNTERS_GENERIC && length >= SF_CNT_GENERIC_LEN) {
+	sf_cnt_read_generic(sample);
+	sf_cnt_table_update(xse, sample);
+	skipBytes(sample, length - SF_CNT_GENERIC_LEN);
+      }
+      else skipBytes(sample, length);
+    }
+    else if (sfacctd_counter_backend_methods) sf_cnt_log_msg(peer, sample, sample->datagramVersion, length, "log", config.sfacctd_counter_output, tag);
     else skipBytes(sample, length);
   }
 
@@ -1272,7 +1322,15 @@ void readv2v4CountersSample(SFSample *sample, struct packet_ptrs_vector *pptrsv)
   default: return; 
   }
 
-  if (sfacctd_counter_backend_methods && have_sample)
+  if (config.sfacctd_counter_refresh_time) {
+    if (length >= SF_CNT_GENERIC_LEN) {
+      sf_cnt_read_generic(sample);
+      sf_cnt_table_update(xse, sample);
+      skipBytes(sample, length - SF_CNT_GENERIC_LEN);
+    }
+    else skipBytes(sample, length);
+  }
+  else if (sfacctd_counter_backend_methods && have_sample)
     sf_cnt_log_msg(peer, sample, sample->datagramVersion, length, "log", config.sfacctd_counter_output, sample->counterBlockVersion);
   else
     skipBytes(sample, length);
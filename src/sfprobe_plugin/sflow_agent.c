@@ -97,6 +97,7 @@ void sfl_agent_release(SFLAgent *agent)
   /* release and free the receivers */
   for(rcv = agent->receivers; rcv != NULL; ) {
     SFLReceiver *nextRcv = rcv->nxt;
+    sfl_receiver_release(rcv);
     sflFree(agent, rcv);
     rcv = nextRcv;
   }
@@ -93,6 +93,7 @@ typedef struct _SFLReceiver {
   /* private fields */
   SFLSampleCollector sampleCollector;
   struct sockaddr_in receiver;
+  struct pm_sendq sendq;      /* datagrams batched until the next tick */
 } SFLReceiver;
 
 typedef struct _SFLSampler {
@@ -290,6 +291,7 @@ void sfl_poller_init(SFLPoller *poller, SFLAgent *agent, SFLDataSource_instance
 
 
 void sfl_receiver_tick(SFLReceiver *receiver, time_t now);
+void sfl_receiver_release(SFLReceiver *receiver);
 void sfl_poller_tick(SFLPoller *poller, time_t now);
 void sfl_sampler_tick(SFLSampler *sampler, time_t now);
 
@@ -61,6 +61,8 @@ void sfl_receiver_init(SFLReceiver *receiver, SFLAgent *agent)
 static void reset(SFLReceiver *receiver) {
   // ask agent to tell samplers and pollers to stop sending samples
   sfl_agent_resetReceiver(receiver->agent, receiver);
+  // drop the send queue, sfl_receiver_init() wipes it
+  sfl_receiver_release(receiver);
   // reinitialize
   sfl_receiver_init(receiver, receiver->agent);
 }
@@ -120,6 +122,11 @@ void sfl_receiver_tick(SFLReceiver *receiver, time_t now)
 {
   // if there are any samples to send, flush them now
   if(receiver->sampleCollector.numSamples > 0) sendSample(receiver);
+  // and push out the datagrams queued since the last tick
+  if(receiver->sendq.num > 0 && pm_sendq_flush(&receiver->sendq) == ERR) {
+    errno = receiver->sendq.last_errno;
+    sfl_agent_sysError(receiver->agent, "receiver", "socket sendmmsg error");
+  }
   // check the timeout
   if(receiver->sFlowRcvrTimeout && receiver->sFlowRcvrTimeout != 0xFFFFFFFF) {
     // count down one tick and reset if we reach 0
@@ -127,6 +134,19 @@ void sfl_receiver_tick(SFLReceiver *receiver, time_t now)
   }
 }
 
+/*_________________---------------------------__________________
+  _________________   sfl_receiver_release    __________________
+  -----------------___________________________------------------
+*/
+
+void sfl_receiver_release(SFLReceiver *receiver)
+{
+  if(receiver->sendq.buf) {
+    pm_sendq_flush(&receiver->sendq);
+    pm_sendq_destroy(&receiver->sendq);
+  }
+}
+
 /*_________________-----------------------------__________________
   _________________   receiver write utilities  __________________
   -----------------_____________________________------------------
@@ -791,15 +811,30 @@ static void sendSample(SFLReceiver *receiver)
 						     (u_char *)receiver->sampleCollector.data, 
 						     receiver->sampleCollector.pktlen);
   else {
-    /* send it myself */
-    int result = sendto(receiver->agent->receiverSocket,
-			receiver->sampleCollector.data,
-			receiver->sampleCollector.pktlen,
-			0,
-			(struct sockaddr *)&receiver->receiver,
-			sizeof(receiver->receiver));
-    if(result == -1 && errno != EINTR) sfl_agent_sysError(receiver->agent, "receiver", "socket sendto error");
-    if(result == 0) sfl_agent_error(receiver->agent, "receiver", "socket sendto returned 0");
+    /* send it myself: queue it, the queue is flushed on every tick */
+    if(!receiver->sendq.buf)
+      pm_sendq_init(&receiver->sendq, receiver->agent->receiverSocket,
+		    (struct sockaddr *)&receiver->receiver, sizeof(receiver->receiver),
+		    SENDQ_DEFAULT_BATCH, SFL_MAX_DATAGRAM_SIZE);
+
+    if(receiver->sendq.buf) {
+      /* address may have been changed via the MIB setters */
+      memcpy(&receiver->sendq.dest, &receiver->receiver, sizeof(receiver->receiver));
+      if(pm_sendq_add(&receiver->sendq, receiver->sampleCollector.data, receiver->sampleCollector.pktlen) == ERR) {
+	errno = receiver->sendq.last_errno;
+	sfl_agent_sysError(receiver->agent, "receiver", "socket sendmmsg error");
+      }
+    }
+    else {
+      int result = sendto(receiver->agent->receiverSocket,
+			  receiver->sampleCollector.data,
+			  receiver->sampleCollector.pktlen,
+			  0,
+			  (struct sockaddr *)&receiver->receiver,
+			  sizeof(receiver->receiver));
+      if(result == -1 && errno != EINTR) sfl_agent_sysError(receiver->agent, "receiver", "socket sendto error");
+      if(result == 0) sfl_agent_error(receiver->agent, "receiver", "socket sendto returned 0");
+    }
   }
   /* reset for the next time */
   resetSampleCollector(receiver);
@@ -593,6 +593,7 @@ void sfprobe_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   int pollagain = TRUE;
   u_int32_t seq = 1, rg_err_count = 0;
   struct networks_file_data nfd;
+  struct timespec stats_ts;
 
   time_t clk, test_clk;
   SflSp sp;
@@ -760,7 +761,9 @@ read_data:
 	  dummy.primitives.src_nmask = hdr->src_nmask;
 	  dummy.primitives.dst_nmask = hdr->dst_nmask;
 
+	  if (net_funcs[0]) STATS_START(stats_ts);
 	  for (num = 0; net_funcs[num]; num++) (*net_funcs[num])(&nt, &nc, &dummy.primitives, &dummy_pbgp, &nfd);
+	  if (net_funcs[0]) STATS_STOP(STATS_NET, stats_ts);
 
 	  /* hacky */
 	  if (config.nfacctd_as & NF_AS_NEW && dummy.primitives.src_as)
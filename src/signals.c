@@ -27,6 +27,10 @@
 #include "pmacct-data.h"
 #include "plugin_hooks.h"
 #include "bgp/bgp.h"
+#include "tpacket.h"
+#if defined (WITH_NDPI)
+#include "ndpi/ndpi.h"
+#endif
 
 /* extern */
 extern struct plugins_list_entry *plugin_list;
@@ -138,6 +142,11 @@ void my_sigint_handler(int signum)
   signal(SIGINT, SIG_IGN);
   signal(SIGTERM, SIG_IGN);
 
+#if defined (HAVE_TPACKET_V3)
+  /* capture threads may be in the middle of writing to the plugins buffers */
+  if (tpacket_num_workers) pthread_mutex_lock(&tpacket_exec_mutex);
+#endif
+
   fill_pipe_buffer();
   sleep(2); /* XXX: we should really choose an adaptive value here. It should be
 	            closely bound to, say, biggest plugin_buffer_size value */ 
@@ -152,6 +161,10 @@ void my_sigint_handler(int signum)
   Log(LOG_INFO, "INFO ( %s/%s ): OK, Exiting ...\n", config.name, config.type);
 
   if (config.acct_type == ACCT_PM && !config.uacctd_group /* XXX */) {
+#if defined (HAVE_TPACKET_V3)
+    if (config.dev && tpacket_num_workers) tpacket_workers_stats(TRUE);
+    else
+#endif
     if (config.dev) {
       if (pcap_stats(glob_pcapt, &ps) < 0) printf("\npcap_stats: %s\n", pcap_geterr(glob_pcapt));
       printf("\n");
@@ -197,6 +210,10 @@ void push_stats()
   time_t now = time(NULL);
 
   if (config.acct_type == ACCT_PM) {
+#if defined (HAVE_TPACKET_V3)
+    if (config.dev && tpacket_num_workers) tpacket_workers_stats(FALSE);
+    else
+#endif
     if (config.dev) {
       if (pcap_stats(glob_pcapt, &ps) < 0) Log(LOG_INFO, "INFO ( %s/%s ): pcap_stats: %s\n",
 						config.name, config.type, pcap_geterr(glob_pcapt));
@@ -209,6 +226,14 @@ void push_stats()
   else if (config.acct_type == ACCT_NF || config.acct_type == ACCT_SF)
     print_status_table(now, XFLOW_STATUS_TABLE_SZ);
 
+#if defined (WITH_NDPI)
+  if (config.classifier_ndpi && pm_ndpi_wfl) pm_ndpi_workflow_stats(pm_ndpi_wfl);
+#endif
+
+  bgp_attr_parse_stats_log(FUNC_TYPE_BGP);
+  bgp_attr_parse_stats_log(FUNC_TYPE_BMP);
+  pipe_buffer_stats_log();
+
   signal(SIGUSR1, push_stats);
 }
 
@@ -0,0 +1,74 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#define __SLAB_C
+
+/* includes */
+#include "pmacct.h"
+
+/* Functions */
+void pm_slab_init(struct pm_slab *slab, size_t size)
+{
+  memset(slab, 0, sizeof(struct pm_slab));
+
+  /* objects have to hold a free list pointer and keep it aligned */
+  if (size < sizeof(void *)) size = sizeof(void *);
+  slab->size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+  slab->per_chunk = (SLAB_DEFAULT_CHUNK - sizeof(struct pm_slab_chunk)) / slab->size;
+  if (!slab->per_chunk) slab->per_chunk = 1;
+}
+
+void *pm_slab_alloc(struct pm_slab *slab)
+{
+  struct pm_slab_chunk *chunk;
+  char *obj;
+  u_int32_t idx;
+
+  if (!slab->free_list) {
+    chunk = malloc(sizeof(struct pm_slab_chunk) + (slab->per_chunk * slab->size));
+    if (!chunk) return NULL;
+
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+
+    obj = (char *) (chunk + 1);
+    for (idx = 0; idx < slab->per_chunk; idx++, obj += slab->size) {
+      *(void **) obj = slab->free_list;
+      slab->free_list = obj;
+    }
+  }
+
+  obj = slab->free_list;
+  slab->free_list = *(void **) obj;
+  slab->in_use++;
+
+  return obj;
+}
+
+void pm_slab_free(struct pm_slab *slab, void *obj)
+{
+  if (!obj) return;
+
+  *(void **) obj = slab->free_list;
+  slab->free_list = obj;
+  slab->in_use--;
+}
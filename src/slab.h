@@ -0,0 +1,57 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+/* defines */
+#define SLAB_DEFAULT_CHUNK	65536 /* bytes */
+
+/* structures */
+struct pm_slab_chunk {
+  struct pm_slab_chunk *next;
+};
+
+/*
+   Fixed-size object cache: objects are carved out of large chunks and
+   recycled through a free list; chunks are kept until the process ends
+   since callers already bound the number of live objects.
+*/
+struct pm_slab {
+  size_t size;
+  u_int32_t per_chunk;
+  void *free_list;
+  struct pm_slab_chunk *chunks;
+  u_int32_t in_use;
+};
+
+/* prototypes */
+#if (!defined __SLAB_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT void pm_slab_init(struct pm_slab *, size_t);
+EXT void *pm_slab_alloc(struct pm_slab *);
+EXT void pm_slab_free(struct pm_slab *, void *);
+#undef EXT
+
+#endif /* _SLAB_H_ */
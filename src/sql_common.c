@@ -98,7 +98,7 @@ void sql_init_global_buffers()
 	(2 * (qq_size * sizeof(struct db_cache *)))));
 
   pipebuf = (unsigned char *) malloc(config.buffer_size);
-  cache = (struct db_cache *) malloc(config.sql_cache_entries*sizeof(struct db_cache));
+  cache = (struct db_cache *) pm_malloc_hugepages(config.sql_cache_entries*sizeof(struct db_cache), config.hugepages, "cache");
   queries_queue = (struct db_cache **) malloc(qq_size*sizeof(struct db_cache *));
   pending_queries_queue = (struct db_cache **) malloc(qq_size*sizeof(struct db_cache *));
 
@@ -411,6 +411,7 @@ int sql_cache_flush_pending(struct db_cache *queue[], int index, struct insert_d
 
 void sql_cache_handle_flush_event(struct insert_data *idata, time_t *refresh_deadline, struct ports_table *pt)
 {
+  struct timespec stats_ts;
   int ret;
 
   dump_writers_count();
@@ -421,6 +422,8 @@ void sql_cache_handle_flush_event(struct insert_data *idata, time_t *refresh_dea
       signal(SIGINT, SIG_IGN);
       signal(SIGHUP, SIG_IGN);
       pm_setproctitle("%s %s [%s]", config.type, "Plugin -- DB Writer", config.name);
+      stats_reset("writer");
+      STATS_START(stats_ts);
 
       if (qq_ptr) {
         if (dump_writers_get_flags() == CHLD_WARNING) sql_db_fail(&p);
@@ -434,6 +437,8 @@ void sql_cache_handle_flush_event(struct insert_data *idata, time_t *refresh_dea
       (*sqlfunc_cbr.purge)(queries_queue, qq_ptr, idata);
 
       if (qq_ptr) (*sqlfunc_cbr.close)(&bed);
+      STATS_STOP_N(STATS_PURGE, stats_ts, qq_ptr);
+      if (config.stats_file) stats_dump();
 
       if (config.sql_trigger_exec) {
         if (idata->now > idata->triggertime) sql_trigger_exec(config.sql_trigger_exec);
@@ -1050,6 +1055,7 @@ void sql_exit_gracefully(int signum)
   signal(SIGHUP, SIG_IGN);
 
   Log(LOG_DEBUG, "( %s/%s ) *** Purging queries queue ***\n", config.name, config.type);
+  if (config.stats_file) stats_dump();
   if (config.syslog) closelog();
 
   memset(&idata, 0, sizeof(idata));
@@ -3152,9 +3158,13 @@ int sql_evaluate_primitives(int primitive)
 
 int sql_query(struct BE_descs *bed, struct db_cache *elem, struct insert_data *idata)
 {
+  struct timespec stats_ts;
+
   if (!bed->p->fail && elem->valid == SQL_CACHE_COMMITTED) {
-    if ((*sqlfunc_cbr.op)(bed->p, elem, idata)); /* failed */
+    STATS_START(stats_ts);
+    if ((*sqlfunc_cbr.op)(bed->p, elem, idata)) STATS_STOP(STATS_WRITE, stats_ts); /* failed */
     else {
+      STATS_STOP(STATS_WRITE, stats_ts);
       idata->qn++;
       return FALSE;
     }
@@ -3298,3 +3308,381 @@ void primptrs_set_all_from_db_cache(struct primitives_ptrs *prim_ptrs, struct db
     prim_ptrs->pvlen = entry->pvlen;
   }
 }
+
+/*
+   Prepared statements. The literal SQL path renders each row through the
+   where[], values[] and set[] format strings; sql_bind_init() splits those
+   once into a statement template, in which every printf conversion is
+   replaced by a parameter marker, and a capture format, so that the very
+   same handlers emit just the arguments, each terminated by SQL_BIND_SEP.
+*/
+static char bind_where_tpl[LONGLONGSRVBUFLEN], bind_values_tpl[LONGLONGSRVBUFLEN];
+static char bind_set_tpl[LONGSRVBUFLEN], bind_set_event_tpl[LONGSRVBUFLEN];
+static char bind_counters_tpl[SRVBUFLEN];
+static int bind_style;
+
+static void sql_bind_split_fmt(char *tpl, int tpl_len, char *fmt, int fmt_len, int verbatim)
+{
+  char capture[SRVBUFLEN], *tpl_ptr;
+  int idx, end, cap_len = 0, len;
+
+  len = strlen(tpl);
+  tpl_ptr = tpl + len;
+  tpl_len -= len;
+  memset(capture, 0, sizeof(capture));
+
+  /* noop handlers copy the fragment as-is, nothing to capture */
+  if (verbatim) {
+    strlcpy(tpl_ptr, fmt, tpl_len);
+    fmt[0] = '\0';
+    return;
+  }
+
+  for (idx = 0; fmt[idx] && tpl_len > 1; idx++) {
+    if (fmt[idx] != '%') {
+      *tpl_ptr++ = fmt[idx]; tpl_len--;
+      continue;
+    }
+
+    /* flags, width, precision, length modifiers */
+    for (end = idx+1; fmt[end] && strchr("-+ #0'", fmt[end]); end++);
+    for (; fmt[end] && (isdigit(fmt[end]) || fmt[end] == '.'); end++);
+    for (; fmt[end] && strchr("hlLqjzt", fmt[end]); end++);
+    if (!fmt[end]) break;
+
+    if (fmt[end] == '%') {
+      *tpl_ptr++ = '%'; tpl_len--;
+      idx = end;
+      continue;
+    }
+
+    if ((cap_len + (end-idx+2)) < sizeof(capture)) {
+      memcpy(capture+cap_len, fmt+idx, end-idx+1);
+      cap_len += end-idx+1;
+      capture[cap_len++] = SQL_BIND_SEP;
+    }
+
+    /* '%s' -> parameter: quotes are the backend's business now */
+    if (idx && fmt[idx-1] == '\'' && fmt[end+1] == '\'') {
+      tpl_ptr--; tpl_len++;
+      *tpl_ptr++ = SQL_BIND_PARAM; tpl_len--;
+      end++;
+    }
+    else if (fmt[end+1] == '(') {
+      *tpl_ptr++ = SQL_BIND_INLINE; tpl_len--;
+    }
+    else if (idx && fmt[idx-1] == '(' && strchr("uid", fmt[end])) {
+      *tpl_ptr++ = SQL_BIND_PARAM_INT; tpl_len--;
+    }
+    else {
+      *tpl_ptr++ = SQL_BIND_PARAM; tpl_len--;
+    }
+
+    idx = end;
+  }
+
+  *tpl_ptr = '\0';
+  strlcpy(fmt, capture, fmt_len);
+}
+
+void sql_bind_init(int primitives, int style)
+{
+  int num, have_flows = FALSE;
+
+  bind_style = style;
+  memset(bind_where_tpl, 0, sizeof(bind_where_tpl));
+  memset(bind_values_tpl, 0, sizeof(bind_values_tpl));
+  memset(bind_set_tpl, 0, sizeof(bind_set_tpl));
+  memset(bind_set_event_tpl, 0, sizeof(bind_set_event_tpl));
+
+  for (num = 0; num < primitives; num++) {
+    sql_bind_split_fmt(bind_where_tpl, sizeof(bind_where_tpl), where[num].string, sizeof(where[num].string), FALSE);
+    sql_bind_split_fmt(bind_values_tpl, sizeof(bind_values_tpl), values[num].string, sizeof(values[num].string), FALSE);
+  }
+
+  for (num = 0; set[num].type; num++)
+    sql_bind_split_fmt(bind_set_tpl, sizeof(bind_set_tpl), set[num].string, sizeof(set[num].string),
+		       (set[num].handler == count_noop_setclause_handler));
+
+  for (num = 0; set_event[num].type; num++)
+    sql_bind_split_fmt(bind_set_event_tpl, sizeof(bind_set_event_tpl), set_event[num].string, sizeof(set_event[num].string),
+		       (set_event[num].handler == count_noop_setclause_event_handler));
+
+  if (config.what_to_count & COUNT_FLOWS) have_flows = TRUE;
+  if (have_flows) snprintf(bind_counters_tpl, sizeof(bind_counters_tpl), ", %c, %c, %c)", SQL_BIND_PARAM, SQL_BIND_PARAM, SQL_BIND_PARAM);
+  else snprintf(bind_counters_tpl, sizeof(bind_counters_tpl), ", %c, %c)", SQL_BIND_PARAM, SQL_BIND_PARAM);
+
+  Log(LOG_INFO, "INFO ( %s/%s ): sql_prepared_statements: rows are written through prepared statements.\n", config.name, config.type);
+}
+
+static int sql_bind_split_args(char *buf, char **args, int max)
+{
+  char *ptr = buf, *sep;
+  int num = 0;
+
+  while (num < max && (sep = strchr(ptr, SQL_BIND_SEP))) {
+    *sep = '\0';
+    args[num++] = ptr;
+    ptr = sep+1;
+  }
+
+  return num;
+}
+
+static void sql_bind_render(struct sql_bind_query *q, char *tpl, char **args, int num_args)
+{
+  char *ptr, placeholder[SRVBUFLEN], *arg;
+  int len, arg_idx = 0;
+
+  len = strlen(q->text);
+
+  for (ptr = tpl; *ptr && len < (sizeof(q->text) - 1); ptr++) {
+    if (*ptr != SQL_BIND_PARAM && *ptr != SQL_BIND_PARAM_INT && *ptr != SQL_BIND_INLINE) {
+      q->text[len++] = *ptr;
+      continue;
+    }
+
+    arg = (arg_idx < num_args) ? args[arg_idx] : "";
+    arg_idx++;
+
+    if (*ptr == SQL_BIND_INLINE) strlcpy(placeholder, arg, sizeof(placeholder));
+    else {
+      if (q->nparams == SQL_BIND_MAX_PARAMS) continue;
+      q->params[q->nparams++] = arg;
+
+      if (bind_style == SQL_BIND_STYLE_DOLLAR) {
+	if (*ptr == SQL_BIND_PARAM_INT) snprintf(placeholder, sizeof(placeholder), "$%u::int4", q->nparams);
+	else snprintf(placeholder, sizeof(placeholder), "$%u", q->nparams);
+      }
+      else strlcpy(placeholder, "?", sizeof(placeholder));
+    }
+
+    len += strlcpy(q->text+len, placeholder, sizeof(q->text)-len);
+    if (len >= sizeof(q->text)) len = sizeof(q->text) - 1;
+  }
+
+  q->text[len] = '\0';
+}
+
+/* Runs the handlers of cache_elem in capture mode and composes both the
+   UPDATE and the INSERT statement; returns the number of SET fragments,
+   ie. zero if there is nothing to UPDATE, as the literal path does */
+int sql_bind_compose(struct db_cache *cache_elem, struct insert_data *idata, struct sql_bind_query *upd, struct sql_bind_query *ins)
+{
+  static char *where_args[SQL_BIND_MAX_PARAMS], *values_args[SQL_BIND_MAX_PARAMS], *set_args[SQL_BIND_MAX_PARAMS];
+  static char counters[3][SRVBUFLEN];
+  char *ptr_values, *ptr_where, *ptr_set, *counters_args[3];
+  int num, num_set, num_where, num_values, num_set_args, event = FALSE;
+
+  ptr_where = where_clause;
+  ptr_values = values_clause;
+  ptr_set = set_clause;
+  where_clause[0] = '\0';
+  values_clause[0] = '\0';
+  set_clause[0] = '\0';
+
+  for (num = 0; num < idata->num_primitives; num++)
+    (*where[num].handler)(cache_elem, idata, num, &ptr_values, &ptr_where);
+
+  if (cache_elem->flow_type == NF9_FTYPE_EVENT || cache_elem->flow_type == NF9_FTYPE_OPTION) {
+    for (num_set = 0; set_event[num_set].type; num_set++)
+      (*set_event[num_set].handler)(cache_elem, idata, num_set, &ptr_set, NULL);
+    event = TRUE;
+  }
+  else {
+    for (num_set = 0; set[num_set].type; num_set++)
+      (*set[num_set].handler)(cache_elem, idata, num_set, &ptr_set, NULL);
+  }
+
+  num_where = sql_bind_split_args(where_clause, where_args, SQL_BIND_MAX_PARAMS);
+  num_values = sql_bind_split_args(values_clause, values_args, SQL_BIND_MAX_PARAMS);
+  num_set_args = sql_bind_split_args(set_clause, set_args, SQL_BIND_MAX_PARAMS);
+
+  upd->text[0] = '\0'; upd->nparams = 0;
+  strlcpy(upd->text, update_clause, sizeof(upd->text));
+  sql_bind_render(upd, event ? bind_set_event_tpl : bind_set_tpl, set_args, num_set_args);
+  sql_bind_render(upd, bind_where_tpl, where_args, num_where);
+
+  ins->text[0] = '\0'; ins->nparams = 0;
+  strlcpy(ins->text, insert_clause, sizeof(ins->text));
+  strlcat(ins->text, event ? insert_nocounters_clause : insert_counters_clause, sizeof(ins->text));
+  sql_bind_render(ins, bind_values_tpl, values_args, num_values);
+
+  if (event) strlcat(ins->text, ")", sizeof(ins->text));
+  else {
+    snprintf(counters[0], SRVBUFLEN, "%llu", (unsigned long long) cache_elem->packet_counter);
+    snprintf(counters[1], SRVBUFLEN, "%llu", (unsigned long long) cache_elem->bytes_counter);
+    snprintf(counters[2], SRVBUFLEN, "%llu", (unsigned long long) cache_elem->flows_counter);
+    for (num = 0; num < 3; num++) counters_args[num] = counters[num];
+
+    sql_bind_render(ins, bind_counters_tpl, counters_args, 3);
+  }
+
+  return num_set;
+}
+
+/* TRUE if the statement has to be (re-)prepared for the given text */
+int sql_stmt_changed(struct sql_stmt *stmt, char *text)
+{
+  if (!stmt->handle || !stmt->text) return TRUE;
+
+  return strcmp(stmt->text, text) ? TRUE : FALSE;
+}
+
+void sql_stmt_set(struct sql_stmt *stmt, void *handle, char *text)
+{
+  if (stmt->text) free(stmt->text);
+
+  stmt->handle = handle;
+  stmt->text = (handle && text) ? strdup(text) : NULL;
+}
+
+u_int32_t sql_purge_rate(struct insert_data *idata, struct timeval *start)
+{
+  struct timeval end;
+  u_int64_t msecs;
+
+  gettimeofday(&end, NULL);
+  msecs = (end.tv_sec - start->tv_sec) * 1000 + (end.tv_usec - start->tv_usec) / 1000;
+  if (!msecs) msecs = 1;
+
+  return (u_int32_t) (((u_int64_t) idata->een * 1000) / msecs);
+}
+
+/*
+   Upsert. Rather than an UPDATE followed, if no row was affected, by an
+   INSERT, the INSERT carries a conflict clause that adds counters up
+   server-side. Its SET list is derived from set[] (set_event[] for event
+   and option flows): each "col=col<op>%fmt" assignment becomes
+   "col=col<op><new value of col>", noop ones (ie. stamp_updated) are kept
+   verbatim. The conflict target is the list of inserted columns except
+   stamp_updated, which is the primary key of the stock schemas.
+*/
+static char upsert_target[LONGSRVBUFLEN];
+static char upsert_set[2][LONGSRVBUFLEN];
+static char upsert_clause[2][LONGSRVBUFLEN];
+static char upsert_table[SRVBUFLEN];
+static int upsert_style;
+
+static void sql_upsert_compose_set(char *buf, int len, struct frags *frags)
+{
+  char tmp[LONGSRVBUFLEN], assign[SRVBUFLEN], lhs[SRVBUFLEN], *ptr, *eq, *conv;
+  int num, depth = 0, quoted = FALSE, alen = 0, blen = 0;
+
+  memset(tmp, 0, sizeof(tmp));
+  for (num = 0; frags[num].type; num++) strlcat(tmp, frags[num].string, sizeof(tmp));
+
+  ptr = tmp;
+  if (!strncmp(ptr, "SET ", 4)) ptr += 4;
+  buf[0] = '\0';
+
+  for (;; ptr++) {
+    if (*ptr && (*ptr != ',' || depth || quoted)) {
+      if (*ptr == '\'') quoted = !quoted;
+      else if (!quoted && *ptr == '(') depth++;
+      else if (!quoted && *ptr == ')') depth--;
+
+      if (alen || *ptr != ' ') {
+	if (alen < (sizeof(assign) - 1)) assign[alen++] = *ptr;
+      }
+      continue;
+    }
+
+    assign[alen] = '\0';
+
+    if (alen && (eq = strchr(assign, '='))) {
+      memcpy(lhs, assign, eq - assign);
+      lhs[eq - assign] = '\0';
+      for (conv = eq; (conv = strchr(conv, '%')) && conv[1] == '%'; conv += 2);
+
+      if (blen) blen += snprintf(buf + blen, len - blen, ", ");
+
+      if (conv && conv > eq + 1) {
+	/* SQL_BIND_INLINE marks the table qualifier, resolved per table */
+	if (upsert_style == SQL_UPSERT_MYSQL)
+	  blen += snprintf(buf + blen, len - blen, "%s=%s%cVALUES(%s)", lhs, lhs, conv[-1], lhs);
+	else if (upsert_style == SQL_UPSERT_PGSQL)
+	  blen += snprintf(buf + blen, len - blen, "%s=%c%s%cEXCLUDED.%s", lhs, SQL_BIND_INLINE, lhs, conv[-1], lhs);
+	else
+	  blen += snprintf(buf + blen, len - blen, "%s=%s%cEXCLUDED.%s", lhs, lhs, conv[-1], lhs);
+      }
+      else {
+	/* not going through printf() anymore: unescape '%%' */
+	for (conv = assign; *conv && blen < (len - 1); conv++) {
+	  buf[blen++] = *conv;
+	  if (conv[0] == '%' && conv[1] == '%') conv++;
+	}
+	buf[blen] = '\0';
+      }
+
+      if (blen >= len) blen = len - 1;
+    }
+
+    if (!*ptr) break;
+    alen = 0;
+  }
+}
+
+void sql_upsert_init(int style)
+{
+  char *ptr, *next;
+  int len = 0;
+
+  upsert_style = style;
+  memset(upsert_target, 0, sizeof(upsert_target));
+  memset(upsert_table, 0, sizeof(upsert_table));
+  memset(upsert_clause, 0, sizeof(upsert_clause));
+
+  if ((ptr = strchr(insert_clause, '('))) {
+    for (ptr++; ptr && *ptr; ptr = next) {
+      next = strchr(ptr, ',');
+      if (next) *next = '\0';
+      while (*ptr == ' ') ptr++;
+
+      if (*ptr && strcmp(ptr, "stamp_updated"))
+	len += snprintf(upsert_target + len, sizeof(upsert_target) - len, "%s%s", len ? ", " : "", ptr);
+
+      if (next) *next++ = ',';
+      if (len >= sizeof(upsert_target)) break;
+    }
+  }
+
+  sql_upsert_compose_set(upsert_set[FALSE], sizeof(upsert_set[FALSE]), set);
+  sql_upsert_compose_set(upsert_set[TRUE], sizeof(upsert_set[TRUE]), set_event);
+
+  Log(LOG_INFO, "INFO ( %s/%s ): sql_upsert: conflict target is (%s).\n", config.name, config.type, upsert_target);
+}
+
+/* Returns the clause to be appended to the INSERT statement; event is TRUE
+   for event and option flows. Composed once per table name */
+char *sql_upsert_clause(struct insert_data *idata, int event)
+{
+  char *table, *src, qual[SRVBUFLEN + 1];
+  int idx, len;
+
+  table = idata->dyn_table ? idata->dyn_table_name : config.sql_table;
+  if (upsert_table[0] && !strcmp(upsert_table, table)) return upsert_clause[event ? TRUE : FALSE];
+
+  strlcpy(upsert_table, table, sizeof(upsert_table));
+  snprintf(qual, sizeof(qual), "%s.", table);
+
+  for (idx = 0; idx < 2; idx++) {
+    if (!upsert_set[idx][0]) {
+      if (upsert_style == SQL_UPSERT_MYSQL) upsert_clause[idx][0] = '\0';
+      else strlcpy(upsert_clause[idx], " ON CONFLICT DO NOTHING", sizeof(upsert_clause[idx]));
+      continue;
+    }
+
+    if (upsert_style == SQL_UPSERT_MYSQL) len = strlcpy(upsert_clause[idx], " ON DUPLICATE KEY UPDATE ", sizeof(upsert_clause[idx]));
+    else len = snprintf(upsert_clause[idx], sizeof(upsert_clause[idx]), " ON CONFLICT (%s) DO UPDATE SET ", upsert_target);
+
+    for (src = upsert_set[idx]; *src && len < (sizeof(upsert_clause[idx]) - 1); src++) {
+      if (*src == SQL_BIND_INLINE) len += strlcpy(upsert_clause[idx] + len, qual, sizeof(upsert_clause[idx]) - len);
+      else upsert_clause[idx][len++] = *src;
+    }
+    if (len >= sizeof(upsert_clause[idx])) len = sizeof(upsert_clause[idx]) - 1;
+    upsert_clause[idx][len] = '\0';
+  }
+
+  return upsert_clause[event ? TRUE : FALSE];
+}
@@ -72,6 +72,27 @@
 #define SPACELEFT_LEN(x,y) (sizeof(x)-y)
 #define SPACELEFT_PTR(x,y) (y-strlen(x))
 
+/* prepared statements: handlers write their arguments, each terminated
+   by SQL_BIND_SEP, and statement templates mark where they go */
+#define SQL_BIND_SEP		'\x1e'
+#define SQL_BIND_PARAM		'\x1f'	/* bound parameter */
+#define SQL_BIND_PARAM_INT	'\x1c'	/* bound parameter, integer function argument */
+#define SQL_BIND_INLINE		'\x1d'	/* part of the SQL text, ie. a function name */
+#define SQL_BIND_MAX_PARAMS	((N_PRIMITIVES+2)*4)
+
+#define SQL_BIND_STYLE_QMARK	0	/* MySQL, SQLite: ? */
+#define SQL_BIND_STYLE_DOLLAR	1	/* PostgreSQL: $n */
+
+#define SQL_STMT_UPDATE		0
+#define SQL_STMT_INSERT		1
+#define SQL_STMT_INSERT_BATCH	2
+#define SQL_STMT_MAX		3
+
+/* upsert: dialect of the INSERT conflict clause */
+#define SQL_UPSERT_PGSQL	0	/* ON CONFLICT (...) DO UPDATE, table qualified */
+#define SQL_UPSERT_SQLITE	1	/* ON CONFLICT (...) DO UPDATE */
+#define SQL_UPSERT_MYSQL	2	/* ON DUPLICATE KEY UPDATE */
+
 #define SQL_INSERT_INSERT	0x00000001
 #define SQL_INSERT_UPDATE	0x00000002
 #define SQL_INSERT_PRO_RATING	0x00000004
@@ -152,6 +173,18 @@ struct frags {
   char string[SRVBUFLEN];
 };
 
+struct sql_bind_query {
+  char text[LARGEBUFLEN];
+  char *params[SQL_BIND_MAX_PARAMS];
+  int nparams;
+};
+
+/* a statement prepared on a backend connection along with its SQL text */
+struct sql_stmt {
+  void *handle;
+  char *text;
+};
+
 /* Backend descriptors */
 struct DBdesc {
   void *desc;
@@ -161,6 +194,7 @@ struct DBdesc {
   short int type;
   short int connected;
   short int fail;
+  struct sql_stmt stmt[SQL_STMT_MAX];
 };
 
 struct BE_descs { 
@@ -350,6 +384,13 @@ EXT int sql_select_locking_style(char *);
 EXT int sql_compose_static_set(int); 
 EXT int sql_compose_static_set_event(); 
 EXT void primptrs_set_all_from_db_cache(struct primitives_ptrs *, struct db_cache *);
+EXT void sql_bind_init(int, int);
+EXT int sql_bind_compose(struct db_cache *, struct insert_data *, struct sql_bind_query *, struct sql_bind_query *);
+EXT int sql_stmt_changed(struct sql_stmt *, char *);
+EXT void sql_stmt_set(struct sql_stmt *, void *, char *);
+EXT u_int32_t sql_purge_rate(struct insert_data *, struct timeval *);
+EXT void sql_upsert_init(int);
+EXT char *sql_upsert_clause(struct insert_data *, int);
 
 EXT void sql_sum_host_insert(struct primitives_ptrs *, struct insert_data *);
 EXT void sql_sum_port_insert(struct primitives_ptrs *, struct insert_data *);
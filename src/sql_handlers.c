@@ -867,7 +867,7 @@ void count_label_handler(const struct db_cache *cache_elem, struct insert_data *
 {
   char *label_ptr = NULL, empty_string[] = "";
 
-  vlen_prims_get(cache_elem->pvlen, COUNT_INT_LABEL, &label_ptr);
+  label_ptr = pretag_label_get((struct pkt_primitives *) &cache_elem->primitives, cache_elem->pvlen);
   if (!label_ptr) label_ptr = empty_string;
 
   snprintf(*ptr_where, SPACELEFT(where_clause), where[num].string, label_ptr);
@@ -46,6 +46,7 @@ void sqlite3_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   u_int32_t bufsz = ((struct channels_list_entry *)ptr)->bufsize;
   pid_t core_pid = ((struct channels_list_entry *)ptr)->core_pid;
   struct networks_file_data nfd;
+  struct timespec stats_ts;
   char *dataptr;
 
   unsigned char *rgptr;
@@ -107,6 +108,8 @@ void sqlite3_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   /* building up static SQL clauses */
   idata.num_primitives = SQLI_compose_static_queries();
   glob_num_primitives = idata.num_primitives; 
+  if (config.sql_upsert) sql_upsert_init(SQL_UPSERT_SQLITE);
+  if (config.sql_prepared_statements) sql_bind_init(idata.num_primitives, SQL_BIND_STYLE_QMARK);
 
   /* setting up environment variables */
   SQL_SetENV();
@@ -234,8 +237,10 @@ void sqlite3_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
         for (num = 0; primptrs_funcs[num]; num++)
           (*primptrs_funcs[num])((u_char *)data, &extras, &prim_ptrs);
 
+	if (net_funcs[0]) STATS_START(stats_ts);
 	for (num = 0; net_funcs[num]; num++)
 	  (*net_funcs[num])(&nt, &nc, &data->primitives, prim_ptrs.pbgp, &nfd);
+	if (net_funcs[0]) STATS_STOP(STATS_NET, stats_ts);
 
 	if (config.ports_file) {
 	  if (!pt.table[data->primitives.src_port]) data->primitives.src_port = 0;
@@ -247,7 +252,9 @@ void sqlite3_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
           evaluate_pkt_len_distrib(data);
 
         prim_ptrs.data = data;
+        STATS_START(stats_ts);
         (*insert_func)(&prim_ptrs, &idata);
+        STATS_STOP(STATS_INSERT, stats_ts);
 
         ((struct ch_buf_hdr *)pipebuf)->num--;
         if (((struct ch_buf_hdr *)pipebuf)->num) {
@@ -307,7 +314,7 @@ int SQLI_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct inser
   
   /* sending UPDATE query a) if not switched off and
      b) if we actually have something to update */
-  if (!config.sql_dont_try_update && num_set) {
+  if (!config.sql_dont_try_update && !config.sql_upsert && num_set) {
     strncpy(sql_data, update_clause, SPACELEFT(sql_data));
     strncat(sql_data, set_clause, SPACELEFT(sql_data));
     strncat(sql_data, where_clause, SPACELEFT(sql_data));
@@ -316,7 +323,7 @@ int SQLI_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct inser
     if (ret) goto signal_error; 
   }
 
-  if (config.sql_dont_try_update || !num_set || (sqlite3_changes(db->desc) == 0)) {
+  if (config.sql_dont_try_update || config.sql_upsert || !num_set || (sqlite3_changes(db->desc) == 0)) {
     /* UPDATE failed, trying with an INSERT query */ 
     if (cache_elem->flow_type == NF9_FTYPE_EVENT || cache_elem->flow_type == NF9_FTYPE_OPTION) {
       strncpy(insert_full_clause, insert_clause, SPACELEFT(insert_full_clause));
@@ -337,11 +344,14 @@ int SQLI_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct inser
     
     strncpy(sql_data, insert_full_clause, sizeof(sql_data));
     strncat(sql_data, values_clause, SPACELEFT(sql_data));
+    if (config.sql_upsert) strncat(sql_data, sql_upsert_clause(idata, (cache_elem->flow_type == NF9_FTYPE_EVENT ||
+			cache_elem->flow_type == NF9_FTYPE_OPTION)), SPACELEFT(sql_data));
 
     if (config.sql_multi_values) {
       multi_values_handling:
+      /* whole statements are queued: room for the '; ' separator and the NUL */
       len = config.sql_multi_values-idata->mv.buffer_offset;
-      if (strlen(values_clause) < len) {
+      if (strlen(sql_data) + (idata->mv.buffer_elem_num ? 2 : 0) < len) {
 	if (idata->mv.buffer_elem_num) {
 	  strcpy(multi_values_buffer+idata->mv.buffer_offset, "; ");
 	  idata->mv.buffer_offset++;
@@ -403,9 +413,73 @@ int SQLI_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct inser
   return ret;
 }
 
+static int SQLI_stmt_exec(struct DBdesc *db, struct sql_stmt *stmt, struct sql_bind_query *q)
+{
+  sqlite3_stmt *handle;
+  int idx, ret;
+
+  if (sql_stmt_changed(stmt, q->text)) {
+    if (stmt->handle) sqlite3_finalize(stmt->handle);
+    sql_stmt_set(stmt, NULL, NULL);
+
+    ret = sqlite3_prepare_v2(db->desc, q->text, -1, &handle, NULL);
+    if (ret != SQLITE_OK) return ret;
+
+    sql_stmt_set(stmt, handle, q->text);
+  }
+
+  handle = stmt->handle;
+  for (idx = 0; idx < q->nparams; idx++) sqlite3_bind_text(handle, idx+1, q->params[idx], -1, SQLITE_STATIC);
+
+  ret = sqlite3_step(handle);
+  sqlite3_reset(handle);
+  sqlite3_clear_bindings(handle);
+
+  return (ret == SQLITE_DONE) ? SQLITE_OK : ret;
+}
+
+int SQLI_cache_dbop_bind(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata)
+{
+  static struct sql_bind_query upd, ins;
+  int num_set, ret = 0;
+
+  num_set = sql_bind_compose(cache_elem, idata, &upd, &ins);
+
+  if (!config.sql_dont_try_update && !config.sql_upsert && num_set) {
+    ret = SQLI_stmt_exec(db, &db->stmt[SQL_STMT_UPDATE], &upd);
+    if (ret) goto signal_error;
+  }
+
+  if (config.sql_dont_try_update || config.sql_upsert || !num_set || (sqlite3_changes(db->desc) == 0)) {
+    if (config.sql_upsert) strlcat(ins.text, sql_upsert_clause(idata, (cache_elem->flow_type == NF9_FTYPE_EVENT ||
+			cache_elem->flow_type == NF9_FTYPE_OPTION)), sizeof(ins.text));
+    ret = SQLI_stmt_exec(db, &db->stmt[SQL_STMT_INSERT], &ins);
+    Log(LOG_DEBUG, "( %s/%s ): %s\n\n", config.name, config.type, ins.text);
+    if (ret) goto signal_error;
+    idata->iqn++;
+  }
+  else {
+    Log(LOG_DEBUG, "( %s/%s ): %s\n\n", config.name, config.type, upd.text);
+    idata->uqn++;
+  }
+
+  idata->een++;
+
+  return ret;
+
+  signal_error:
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED prepared statement follows:\n%s\n", config.name, config.type,
+	(config.sql_dont_try_update || config.sql_upsert || !num_set) ? ins.text : upd.text);
+  SQLI_get_errmsg(db);
+  if (db->errmsg) Log(LOG_ERR, "ERROR ( %s/%s ): %s\n\n", config.name, config.type, db->errmsg);
+
+  return ret;
+}
+
 void SQLI_cache_purge(struct db_cache *queue[], int index, struct insert_data *idata)
 {
   struct db_cache *LastElemCommitted = NULL;
+  struct timeval start_tv;
   time_t start;
   int j, stop, ret, go_to_pending, saved_index = index;
   char orig_insert_clause[LONGSRVBUFLEN], orig_update_clause[LONGSRVBUFLEN], orig_lock_clause[LONGSRVBUFLEN];
@@ -433,6 +507,7 @@ void SQLI_cache_purge(struct db_cache *queue[], int index, struct insert_data *i
 
   Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - START (PID: %u) ***\n", config.name, config.type, writer_pid);
   start = time(NULL);
+  gettimeofday(&start_tv, NULL);
 
   /* re-using pending queries queue stuff from parent and saving clauses */
   memcpy(pending_queries_queue, queue, index*sizeof(struct db_cache *));
@@ -523,8 +598,9 @@ void SQLI_cache_purge(struct db_cache *queue[], int index, struct insert_data *i
   if (pqq_ptr) goto start;
   
   idata->elap_time = time(NULL)-start; 
-  Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %u) ***\n", 
-		config.name, config.type, writer_pid, idata->qn, saved_index, idata->elap_time); 
+  Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %u, RPS: %u) ***\n", 
+		config.name, config.type, writer_pid, idata->qn, saved_index, idata->elap_time,
+		sql_purge_rate(idata, &start_tv)); 
 
   if (config.sql_trigger_exec) {
     if (queue && queue[0]) idata->basetime = queue[0]->basetime;
@@ -663,8 +739,20 @@ void SQLI_DB_Connect(struct DBdesc *db, char *host)
   }
 }
 
+static void SQLI_stmt_close(struct DBdesc *db)
+{
+  int idx;
+
+  for (idx = 0; idx < SQL_STMT_MAX; idx++) {
+    if (db->stmt[idx].handle) sqlite3_finalize(db->stmt[idx].handle);
+    sql_stmt_set(&db->stmt[idx], NULL, NULL);
+  }
+}
+
 void SQLI_DB_Close(struct BE_descs *bed)
 {
+  SQLI_stmt_close(bed->p);
+  SQLI_stmt_close(bed->b);
   if (bed->p->connected) sqlite3_close(bed->p->desc);
   if (bed->b->connected) sqlite3_close(bed->b->desc);
 }
@@ -699,7 +787,8 @@ void SQLI_set_callbacks(struct sqlfunc_cb_registry *cbr)
   cbr->close = SQLI_DB_Close;
   cbr->lock = SQLI_Lock;
   cbr->unlock = SQLI_Unlock;
-  cbr->op = SQLI_cache_dbop;
+  if (!config.sql_prepared_statements) cbr->op = SQLI_cache_dbop;
+  else cbr->op = SQLI_cache_dbop_bind;
   cbr->create_table = SQLI_create_dyn_table; 
   cbr->purge = SQLI_cache_purge;
   cbr->create_backend = SQLI_create_backend;
@@ -729,6 +818,16 @@ void SQLI_init_default_values(struct insert_data *idata)
   
   if (config.sql_backup_host) idata->recover = TRUE;
 
+  if (config.sql_upsert && config.sql_dont_try_update) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_upsert is incompatible with sql_dont_try_update. Ignored.\n", config.name, config.type);
+    config.sql_upsert = FALSE;
+  }
+
+  if (config.sql_multi_values && config.sql_prepared_statements) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_multi_values is not supported along with sql_prepared_statements. Ignored.\n", config.name, config.type);
+    config.sql_multi_values = FALSE;
+  }
+
   if (config.sql_multi_values) {
     multi_values_buffer = malloc(config.sql_multi_values);
     if (!multi_values_buffer) {
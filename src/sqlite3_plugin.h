@@ -25,6 +25,7 @@
 /* prototypes */
 void sqlite3_plugin(int, struct configuration *, void *);
 int SQLI_cache_dbop(struct DBdesc *, struct db_cache *, struct insert_data *);
+int SQLI_cache_dbop_bind(struct DBdesc *, struct db_cache *, struct insert_data *);
 void SQLI_cache_purge(struct db_cache *[], int, struct insert_data *);
 int SQLI_evaluate_history(int);
 int SQLI_compose_static_queries();
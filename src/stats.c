@@ -0,0 +1,211 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#define __STATS_C
+
+/* includes */
+#include "pmacct.h"
+
+/* Functions */
+static const char *stats_stage_names[] = { "recv", "decode", "pre_tag", "bgp", "bmp", "isis",
+					   "net", "ring", "insert", "purge", "write" };
+
+void stats_now(struct timespec *ts)
+{
+#if defined CLOCK_MONOTONIC
+  clock_gettime(CLOCK_MONOTONIC, ts);
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  ts->tv_sec = tv.tv_sec;
+  ts->tv_nsec = (tv.tv_usec * 1000);
+#endif
+}
+
+static int stats_bucket(u_int64_t value)
+{
+  int msb = 0, shift;
+
+  if (value < STATS_HIST_SUB) return value;
+
+  for (shift = 32; shift; shift >>= 1) {
+    if (value >> (msb + shift)) msb += shift;
+  }
+
+  shift = (msb - STATS_HIST_SUB_BITS);
+
+  return (((msb - 1) * STATS_HIST_SUB) + ((value >> shift) & (STATS_HIST_SUB - 1)));
+}
+
+/* stats_bucket_value(): highest value falling in the given bucket */
+static u_int64_t stats_bucket_value(int idx)
+{
+  int msb, shift;
+
+  if (idx < STATS_HIST_SUB) return idx;
+
+  msb = ((idx / STATS_HIST_SUB) + 1);
+  shift = (msb - STATS_HIST_SUB_BITS);
+
+  return ((((u_int64_t) (STATS_HIST_SUB + (idx % STATS_HIST_SUB))) << shift) + ((1ULL << shift) - 1));
+}
+
+/* stats_percentile(): 'permille' being ie. 990 for the 99th percentile */
+static u_int64_t stats_percentile(struct stats_stage *s, int permille)
+{
+  u_int64_t target, seen = 0;
+  int idx;
+
+  target = (((s->count * permille) + 999) / 1000);
+  if (!target) target = 1;
+
+  for (idx = 0; idx < STATS_HIST_BUCKETS; idx++) {
+    seen += s->hist[idx];
+    if (seen >= target) return MIN(stats_bucket_value(idx), s->max);
+  }
+
+  return s->max;
+}
+
+void stats_start(struct timespec *start)
+{
+  if (stats_w.depth < STATS_MAX_DEPTH) stats_w.nested[stats_w.depth] = 0;
+  stats_w.depth++;
+
+  stats_now(start);
+}
+
+/* stats_account(): closes the stage opened by the matching stats_start();
+   time spent in stages nested into it is not accounted again */
+void stats_account(int stage, struct timespec *start, u_int64_t records)
+{
+  struct stats_stage *s = &stats_w.stage[stage];
+  struct timespec now;
+  int64_t delta, self;
+
+  stats_now(&now);
+
+  delta = (((int64_t) (now.tv_sec - start->tv_sec) * 1000000000) + (now.tv_nsec - start->tv_nsec));
+  if (delta < 0) delta = 0;
+  self = delta;
+
+  if (stats_w.depth) {
+    stats_w.depth--;
+    if (stats_w.depth < STATS_MAX_DEPTH) self -= stats_w.nested[stats_w.depth];
+    if (stats_w.depth && stats_w.depth <= STATS_MAX_DEPTH) stats_w.nested[stats_w.depth - 1] += delta;
+    if (self < 0) self = 0;
+  }
+
+  if (!s->count || self < s->min) s->min = self;
+  if (self > s->max) s->max = self;
+  s->count++;
+  s->records += records;
+  s->sum += self;
+  s->hist[stats_bucket(self)]++;
+
+  /* checking whether it's time to dump once in a while is enough */
+  if (++stats_w.calls & STATS_CHECK_EVERY) return;
+
+  if (!stats_w.last_dump.tv_sec) stats_w.last_dump = now;
+  else if ((now.tv_sec - stats_w.last_dump.tv_sec) >= (config.stats_refresh_time ? config.stats_refresh_time : STATS_REFRESH_TIME_DEFAULT))
+    stats_dump();
+}
+
+void stats_set_worker(char *name)
+{
+  strlcpy(stats_w.name, name, sizeof(stats_w.name));
+}
+
+/* stats_reset(): ie. in writer processes, not to report again what was
+   inherited from the parent */
+void stats_reset(char *name)
+{
+  memset(&stats_w, 0, sizeof(stats_w));
+  stats_now(&stats_w.last_dump);
+  if (name) stats_set_worker(name);
+}
+
+/* stats_dump(): appends one JSON record per active stage to 'stats_file';
+   records/s are over the interval since the previous dump */
+void stats_dump()
+{
+  struct pm_jsonbuf jb;
+  struct stats_stage *s;
+  struct timespec now;
+  struct timeval tv;
+  char tstamp[SRVBUFLEN];
+  FILE *file;
+  double secs;
+  int stage;
+
+  stats_now(&now);
+  secs = ((now.tv_sec - stats_w.last_dump.tv_sec) + ((double) (now.tv_nsec - stats_w.last_dump.tv_nsec) / 1000000000));
+  if (!stats_w.last_dump.tv_sec || secs <= 0) secs = 0;
+  stats_w.last_dump = now;
+
+  if (!config.stats_file) return;
+
+  gettimeofday(&tv, NULL);
+  compose_timestamp(tstamp, SRVBUFLEN, &tv, FALSE, config.timestamps_since_epoch);
+
+  pm_jsonbuf_init(&jb, 0);
+
+  for (stage = 0; stage < STATS_MAX; stage++) {
+    s = &stats_w.stage[stage];
+    if (!s->count) continue;
+
+    pm_jsonbuf_obj_open(&jb);
+    pm_jsonbuf_add_str(&jb, "event_type", "stats");
+    pm_jsonbuf_add_str(&jb, "timestamp", tstamp);
+    pm_jsonbuf_add_str(&jb, "name", config.name);
+    pm_jsonbuf_add_str(&jb, "type", config.type);
+    pm_jsonbuf_add_int(&jb, "pid", getpid());
+    pm_jsonbuf_add_str(&jb, "worker", (stats_w.name[0] ? stats_w.name : "main"));
+    pm_jsonbuf_add_str(&jb, "stage", stats_stage_names[stage]);
+    pm_jsonbuf_add_int(&jb, "count", s->count);
+    if (s->records) {
+      pm_jsonbuf_add_int(&jb, "records", s->records);
+      if (secs) pm_jsonbuf_add_int(&jb, "records_per_sec", (u_int64_t) ((s->records - s->last_records) / secs));
+      s->last_records = s->records;
+    }
+    pm_jsonbuf_add_int(&jb, "sum_ns", s->sum);
+    pm_jsonbuf_add_int(&jb, "min_ns", s->min);
+    pm_jsonbuf_add_int(&jb, "mean_ns", (s->sum / s->count));
+    pm_jsonbuf_add_int(&jb, "p50_ns", stats_percentile(s, 500));
+    pm_jsonbuf_add_int(&jb, "p90_ns", stats_percentile(s, 900));
+    pm_jsonbuf_add_int(&jb, "p99_ns", stats_percentile(s, 990));
+    pm_jsonbuf_add_int(&jb, "p999_ns", stats_percentile(s, 999));
+    pm_jsonbuf_add_int(&jb, "max_ns", s->max);
+    pm_jsonbuf_obj_close(&jb);
+    pm_jsonbuf_append(&jb, "\n", 1);
+  }
+
+  if (jb.len && !jb.err) {
+    file = open_output_file(config.stats_file, "a", TRUE);
+    if (file) {
+      fwrite(jb.base, jb.len, 1, file);
+      close_output_file(file);
+    }
+  }
+
+  pm_jsonbuf_destroy(&jb);
+}
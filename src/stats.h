@@ -0,0 +1,102 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+/* defines */
+#define STATS_RECV		0	/* time spent in recvfrom(), ie. waiting for data */
+#define STATS_DECODE		1	/* datagram (or captured packet) processing */
+#define STATS_PRE_TAG		2	/* pre_tag_map evaluation, per plugin */
+#define STATS_BGP		3	/* BGP lookups */
+#define STATS_BMP		4	/* BMP lookups */
+#define STATS_ISIS		5	/* IS-IS lookups */
+#define STATS_NET		6	/* networks_file lookups, per plugin */
+#define STATS_RING		7	/* commit of a buffer to a plugin ring */
+#define STATS_INSERT		8	/* insert in plugin cache or memory table */
+#define STATS_PURGE		9	/* purge of a plugin cache, writer process */
+#define STATS_WRITE		10	/* single write to a backend, ie. SQL query */
+#define STATS_MAX		11
+
+/* log-linear histogram: 2^STATS_HIST_SUB_BITS buckets per power of two,
+   ie. values are recorded with a precision of 25% up to 2^64 nsecs */
+#define STATS_HIST_SUB_BITS	2
+#define STATS_HIST_SUB		(1 << STATS_HIST_SUB_BITS)
+#define STATS_HIST_BUCKETS	(64 * STATS_HIST_SUB)
+
+#define STATS_REFRESH_TIME_DEFAULT	60
+#define STATS_CHECK_EVERY	0xFF	/* stats_account() calls between clock checks */
+#define STATS_WORKER_LEN	32
+#define STATS_MAX_DEPTH		8	/* stages nested into each other */
+
+/* STATS_STOP_N() for stages handling a batch of records per call, ie. the
+   ring; STATS_RECORDS() counts records of a stage timed elsewhere */
+#define STATS_START(ts)		do { if (config.stats_file) stats_start(&(ts)); } while (0)
+#define STATS_STOP(stage, ts)	do { if (config.stats_file) stats_account((stage), &(ts), 1); } while (0)
+#define STATS_STOP_N(stage, ts, n) do { if (config.stats_file) stats_account((stage), &(ts), (n)); } while (0)
+#define STATS_RECORDS(idx, n)	do { if (config.stats_file) stats_w.stage[(idx)].records += (n); } while (0)
+
+/* structures */
+struct stats_stage {
+  u_int64_t count;
+  u_int64_t records;
+  u_int64_t last_records;		/* as of the previous dump */
+  u_int64_t sum;			/* nsecs, nested stages excluded */
+  u_int64_t min;
+  u_int64_t max;
+  u_int64_t hist[STATS_HIST_BUCKETS];
+};
+
+/*
+   Counters and latency histograms of the data path stages, kept per
+   thread (capture workers, BGP/BMP threads) so to need no locking; each
+   thread appends its own records to 'stats_file' once every
+   'stats_refresh_time' seconds, if it has been active meanwhile.
+   Values are cumulative since the thread (or writer process) started.
+   Stages nest, ie. 'bgp' and 'ring' within 'decode': 'nested' keeps, per
+   open stage, the time of inner ones so that each stage reports its own.
+*/
+struct stats_worker {
+  struct stats_stage stage[STATS_MAX];
+  char name[STATS_WORKER_LEN];
+  u_int32_t calls;
+  int depth;
+  u_int64_t nested[STATS_MAX_DEPTH];
+  struct timespec last_dump;
+};
+
+/* prototypes */
+#if (!defined __STATS_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT void stats_now(struct timespec *);
+EXT void stats_start(struct timespec *);
+EXT void stats_account(int, struct timespec *, u_int64_t);
+EXT void stats_set_worker(char *);
+EXT void stats_reset(char *);
+EXT void stats_dump();
+
+/* global variables */
+EXT PM_TLS struct stats_worker stats_w;
+#undef EXT
+#endif /* _STATS_H_ */
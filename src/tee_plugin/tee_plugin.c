@@ -71,7 +71,7 @@ void tee_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 
   /* signal handling */
   signal(SIGINT, Tee_exit_now);
-  signal(SIGUSR1, SIG_IGN);
+  signal(SIGUSR1, Tee_stats_request); /* logs per-receiver counters via Log() calls */
   signal(SIGUSR2, reload_maps); /* sets to true the reload_maps flag */
   signal(SIGPIPE, SIG_IGN);
   signal(SIGCHLD, SIG_IGN);
@@ -89,6 +89,7 @@ void tee_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   memset(&receivers, 0, sizeof(receivers));
   memset(&req, 0, sizeof(req));
   reload_map = FALSE;
+  stats_request = FALSE;
 
   /* Setting up pools */
   if (!config.tee_max_receiver_pools) config.tee_max_receiver_pools = MAX_TEE_POOLS;
@@ -104,12 +105,12 @@ void tee_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   if (!config.tee_max_receivers) config.tee_max_receivers = MAX_TEE_RECEIVERS;
 
   for (pool_idx = 0; pool_idx < config.tee_max_receiver_pools; pool_idx++) { 
-    receivers.pools[pool_idx].receivers = malloc(config.tee_max_receivers*sizeof(struct tee_receivers));
+    receivers.pools[pool_idx].receivers = malloc(config.tee_max_receivers*sizeof(struct tee_receiver));
     if (!receivers.pools[pool_idx].receivers) {
       Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate receivers for pool #%u. Exiting ...\n", config.name, config.type, pool_idx);
       exit_plugin(1);
     }
-    else memset(receivers.pools[pool_idx].receivers, 0, config.tee_max_receivers*sizeof(struct tee_receivers));
+    else memset(receivers.pools[pool_idx].receivers, 0, config.tee_max_receivers*sizeof(struct tee_receiver));
   }
 
   if (config.tee_receivers) {
@@ -149,6 +150,14 @@ void tee_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
     poll_again:
     status->wakeup = TRUE;
 
+    /* About to wait for more data: push out what has been batched so far */
+    Tee_flush_recvs();
+
+    if (stats_request) {
+      Tee_stats_recvs();
+      stats_request = FALSE;
+    }
+
     pfd.fd = pipe_fd;
     pfd.events = POLLIN;
 
@@ -173,7 +182,7 @@ void tee_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 
     switch (ret) {
     case 0: /* timeout */
-      /* reserved for future since we don't currently cache/batch/etc */
+      /* nothing to do: batches are flushed before polling */
       break;
     default: /* we received data */
       read_data:
@@ -243,12 +252,12 @@ void tee_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	    if (!receivers.pools[pool_idx].balance.func) {
 	      for (recv_idx = 0; recv_idx < receivers.pools[pool_idx].num; recv_idx++) {
 	        target = &receivers.pools[pool_idx].receivers[recv_idx];
-	        Tee_send(msg, (struct sockaddr *) &target->dest, target->fd);
+	        Tee_send(msg, target);
 	      }
 	    }
 	    else {
 	      target = receivers.pools[pool_idx].balance.func(&receivers.pools[pool_idx], msg);
-	      Tee_send(msg, (struct sockaddr *) &target->dest, target->fd);
+	      if (target) Tee_send(msg, target);
 	    }
 	  }
 	}
@@ -274,8 +283,14 @@ void Tee_exit_now(int signum)
   exit_plugin(0);
 }
 
-void Tee_send(struct pkt_msg *msg, struct sockaddr *target, int fd)
+void Tee_stats_request(int signum)
+{
+  stats_request = TRUE;
+}
+
+void Tee_send(struct pkt_msg *msg, struct tee_receiver *receiver)
 {
+  struct sockaddr *target = (struct sockaddr *) &receiver->dest;
   struct host_addr r;
   u_char recv_addr[50];
   u_int16_t recv_port;
@@ -301,20 +316,12 @@ void Tee_send(struct pkt_msg *msg, struct sockaddr *target, int fd)
   }
 
   if (!config.tee_transparent) {
-    if (send(fd, msg->payload, msg->len, 0) == -1) {
-      struct host_addr a;
-      u_char agent_addr[50];
-      u_int16_t agent_port;
-
-      sa_to_addr((struct sockaddr *)msg, &a, &agent_port);
-      addr_to_str(agent_addr, &a);
-
+    if (pm_sendq_add(&receiver->sendq, msg->payload, msg->len) == ERR) {
       sa_to_addr((struct sockaddr *)target, &r, &recv_port);
       addr_to_str(recv_addr, &r);
 
-      Log(LOG_ERR, "ERROR ( %s/%s ): send() from [%s:%u] seqno [%u] to [%s:%u] failed (%s)\n",
-			config.name, config.type, agent_addr, agent_port, msg->seqno, recv_addr,
-			recv_port, strerror(errno));
+      Log(LOG_ERR, "ERROR ( %s/%s ): send() to [%s:%u] failed (%s)\n",
+			config.name, config.type, recv_addr, recv_port, strerror(receiver->sendq.last_errno));
     }
   }
   else {
@@ -388,20 +395,12 @@ void Tee_send(struct pkt_msg *msg, struct sockaddr *target, int fd)
       buf_ptr += UDPHdrSz;
       memcpy(buf_ptr, msg->payload, msg->len);
 
-      if (send(fd, tee_send_buf, IP4HdrSz+UDPHdrSz+msg->len, 0) == -1) {
-        struct host_addr a;
-        u_char agent_addr[50];
-        u_int16_t agent_port;
-
-        sa_to_addr((struct sockaddr *)msg, &a, &agent_port);
-        addr_to_str(agent_addr, &a);
-
+      if (pm_sendq_add(&receiver->sendq, tee_send_buf, IP4HdrSz+UDPHdrSz+msg->len) == ERR) {
 	sa_to_addr((struct sockaddr *)target, &r, &recv_port);
 	addr_to_str(recv_addr, &r);
 
-        Log(LOG_ERR, "ERROR ( %s/%s ): raw send() from [%s:%u] seqno [%u] to [%s:%u] failed (%s)\n",
-			config.name, config.type, agent_addr, agent_port, msg->seqno, recv_addr,
-			recv_port, strerror(errno));
+        Log(LOG_ERR, "ERROR ( %s/%s ): raw send() to [%s:%u] failed (%s)\n",
+			config.name, config.type, recv_addr, recv_port, strerror(receiver->sendq.last_errno));
       }
     }
     else {
@@ -423,10 +422,12 @@ void Tee_destroy_recvs()
   for (pool_idx = 0; pool_idx < receivers.num; pool_idx++) {
     for (recv_idx = 0; recv_idx < receivers.pools[pool_idx].num; recv_idx++) {
       target = &receivers.pools[pool_idx].receivers[recv_idx];
+      pm_sendq_flush(&target->sendq);
+      pm_sendq_destroy(&target->sendq);
       if (target->fd) close(target->fd);
     }
 
-    memset(receivers.pools[pool_idx].receivers, 0, config.tee_max_receivers*sizeof(struct tee_receivers));
+    memset(receivers.pools[pool_idx].receivers, 0, config.tee_max_receivers*sizeof(struct tee_receiver));
     memset(&receivers.pools[pool_idx].tag_filter, 0, sizeof(struct pretag_filter));
     memset(&receivers.pools[pool_idx].balance, 0, sizeof(struct tee_balance));
     receivers.pools[pool_idx].id = 0;
@@ -436,6 +437,52 @@ void Tee_destroy_recvs()
   receivers.num = 0;
 }
 
+void Tee_flush_recvs()
+{
+  struct tee_receiver *target = NULL;
+  struct host_addr r;
+  u_char recv_addr[50];
+  u_int16_t recv_port;
+  int pool_idx, recv_idx;
+
+  for (pool_idx = 0; pool_idx < receivers.num; pool_idx++) {
+    for (recv_idx = 0; recv_idx < receivers.pools[pool_idx].num; recv_idx++) {
+      target = &receivers.pools[pool_idx].receivers[recv_idx];
+
+      if (target->sendq.num && pm_sendq_flush(&target->sendq) == ERR) {
+        sa_to_addr((struct sockaddr *)&target->dest, &r, &recv_port);
+        addr_to_str(recv_addr, &r);
+
+        Log(LOG_ERR, "ERROR ( %s/%s ): send() to [%s:%u] failed (%s)\n",
+			config.name, config.type, recv_addr, recv_port, strerror(target->sendq.last_errno));
+      }
+    }
+  }
+}
+
+void Tee_stats_recvs()
+{
+  struct tee_receiver *target = NULL;
+  struct host_addr r;
+  u_char recv_addr[50];
+  u_int16_t recv_port;
+  int pool_idx, recv_idx;
+
+  for (pool_idx = 0; pool_idx < receivers.num; pool_idx++) {
+    for (recv_idx = 0; recv_idx < receivers.pools[pool_idx].num; recv_idx++) {
+      target = &receivers.pools[pool_idx].receivers[recv_idx];
+
+      sa_to_addr((struct sockaddr *)&target->dest, &r, &recv_port);
+      addr_to_str(recv_addr, &r);
+
+      Log(LOG_INFO, "INFO ( %s/%s ): pool ID: %u :: receiver: [%s:%u] :: datagrams=%llu bytes=%llu errors=%llu\n",
+		config.name, config.type, receivers.pools[pool_idx].id, recv_addr, recv_port,
+		(unsigned long long)target->sendq.datagrams, (unsigned long long)target->sendq.bytes,
+		(unsigned long long)target->sendq.errors);
+    }
+  }
+}
+
 void Tee_init_socks()
 {
   struct tee_receiver *target = NULL;
@@ -459,6 +506,12 @@ void Tee_init_socks()
 
       target->fd = Tee_prepare_sock((struct sockaddr *) &target->dest, target->dest_len, receivers.pools[pool_idx].src_port);
 
+      /* datagrams are connected-socket sends; biggest is a full tee_send_buf */
+      if (pm_sendq_init(&target->sendq, target->fd, NULL, 0, config.tee_batch_size, sizeof(tee_send_buf)) == ERR) {
+        Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate send queue for pool #%u. Exiting ...\n", config.name, config.type, receivers.pools[pool_idx].id);
+        exit_plugin(1);
+      }
+
       if (config.debug) {
 	struct host_addr recv_addr;
         u_char recv_addr_str[INET6_ADDRSTRLEN];
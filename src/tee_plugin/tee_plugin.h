@@ -45,6 +45,7 @@ struct tee_receiver {
 #endif
   socklen_t dest_len;
   int fd;
+  struct pm_sendq sendq;		/* datagrams pending to this receiver, counters */
 };
 
 struct tee_balance {
@@ -77,7 +78,10 @@ struct tee_receivers {
 EXT void Tee_exit_now(int);
 EXT void Tee_init_socks();
 EXT void Tee_destroy_recvs();
-EXT void Tee_send(struct pkt_msg *, struct sockaddr *, int);
+EXT void Tee_flush_recvs();
+EXT void Tee_stats_recvs();
+EXT void Tee_stats_request(int);
+EXT void Tee_send(struct pkt_msg *, struct tee_receiver *);
 EXT int Tee_prepare_sock(struct sockaddr *, socklen_t, u_int16_t);
 EXT int Tee_parse_hostport(const char *, struct sockaddr *, socklen_t *);
 EXT struct tee_receiver *Tee_rr_balance(void *, struct pkt_msg *);
@@ -88,5 +92,6 @@ EXT struct tee_receiver *Tee_hash_tag_balance(void *, struct pkt_msg *);
 EXT char tee_send_buf[65535];
 EXT struct tee_receivers receivers; 
 EXT int err_cant_bridge_af;
+EXT int stats_request;
 
 #undef EXT
@@ -195,6 +195,15 @@ void telemetry_daemon(void *t_data_void)
     }
   }
 
+  if (config.telemetry_gpb_kv_decode) {
+#if !defined (WITH_JANSSON)
+    Log(LOG_WARNING, "WARN ( %s/%s ): telemetry_daemon_gpb_kv_decode requires --enable-jansson. Disabled.\n", config.name, t_data->log_str);
+    config.telemetry_gpb_kv_decode = FALSE;
+#endif
+  }
+
+  if (config.telemetry_gpb_kv_filter_file) telemetry_gpb_kv_filter_load(config.telemetry_gpb_kv_filter_file);
+
   if (!config.telemetry_max_peers) config.telemetry_max_peers = TELEMETRY_MAX_PEERS_DEFAULT;
   Log(LOG_INFO, "INFO ( %s/%s ): maximum telemetry peers allowed: %d\n", config.name, t_data->log_str, config.telemetry_max_peers);
 
@@ -714,7 +723,7 @@ void telemetry_daemon(void *t_data_void)
       break;
     case TELEMETRY_DECODER_CISCO_GPB_KV:
       ret = telemetry_recv_cisco_gpb_kv(peer, &recv_flags);
-      data_decoder = TELEMETRY_DATA_DECODER_GPB;
+      data_decoder = (config.telemetry_gpb_kv_decode ? TELEMETRY_DATA_DECODER_GPB_KV : TELEMETRY_DATA_DECODER_GPB);
       break;
     default:
       ret = TRUE; recv_flags = ERR;
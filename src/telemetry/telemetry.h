@@ -30,6 +30,8 @@
 #define TELEMETRY_UDP_TIMEOUT_INTERVAL	60
 #define TELEMETRY_UDP_MAXMSG		65535
 #define TELEMETRY_CISCO_HDR_LEN		12
+#define TELEMETRY_INFLATE_BUF_MAX	(16*1024*1024)
+#define TELEMETRY_JSON_MAX_DEPTH	256
 #define TELEMETRY_LOG_STATS_INTERVAL	120	
 
 #define TELEMETRY_DECODER_UNKNOWN	0
@@ -44,6 +46,7 @@
 #define TELEMETRY_DATA_DECODER_UNKNOWN	0
 #define TELEMETRY_DATA_DECODER_JSON	1
 #define TELEMETRY_DATA_DECODER_GPB	2
+#define TELEMETRY_DATA_DECODER_GPB_KV	3	/* decoded in-daemon */
 
 #define TELEMETRY_CISCO_RESET_COMPRESSOR	1
 #define TELEMETRY_CISCO_JSON			2
@@ -64,8 +67,14 @@ struct telemetry_data {
   time_t now;
 };
 
+/*
+   zjson: messages are inflated into inflate_buf which is then swapped with
+   the peer receive buffer, so to be processed in place; it grows, up to
+   TELEMETRY_INFLATE_BUF_MAX, for messages that don't fit.
+*/
 struct _telemetry_peer_z {
-  char inflate_buf[BGP_BUFFER_SIZE];
+  char *inflate_buf;
+  u_int32_t inflate_buf_len;
 #if defined (HAVE_ZLIB)
   z_stream stm;
 #endif
@@ -110,6 +119,7 @@ typedef struct _telemetry_peer_udp_timeout telemetry_peer_udp_timeout;
 #include "telemetry_logdump.h"
 #include "telemetry_msg.h"
 #include "telemetry_util.h"
+#include "telemetry_gpb.h"
 
 /* prototypes */
 #if (!defined __TELEMETRY_C)
@@ -0,0 +1,435 @@
+/*  
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* defines */
+#define __TELEMETRY_GPB_C
+
+/* includes */
+#include "pmacct.h"
+#include "../bgp/bgp.h"
+#include "telemetry.h"
+
+/* Functions */
+static int telemetry_gpb_varint(u_char **ptr, u_char *end, u_int64_t *value)
+{
+  u_int64_t result = 0;
+  int shift;
+
+  for (shift = 0; (*ptr) < end && shift < 64; shift += 7) {
+    result |= ((u_int64_t) ((**ptr) & 0x7f) << shift);
+    if (!((*(*ptr)++) & 0x80)) {
+      (*value) = result;
+      return SUCCESS;
+    }
+  }
+
+  return ERR;
+}
+
+/* telemetry_gpb_next() decodes the protobuf wire-format field at *ptr and
+   moves *ptr past it; no copies are made, length-delimited fields point
+   into the buffer */
+int telemetry_gpb_next(u_char **ptr, u_char *end, struct telemetry_gpb_field *field)
+{
+  u_int64_t key, len;
+  int idx;
+
+  if (telemetry_gpb_varint(ptr, end, &key) == ERR) return ERR;
+
+  field->tag = (key >> 3);
+  field->wire_type = (key & 0x07);
+  field->value = 0;
+  field->data = NULL;
+  field->len = 0;
+
+  switch (field->wire_type) {
+  case TELEMETRY_GPB_WT_VARINT:
+    return telemetry_gpb_varint(ptr, end, &field->value);
+  case TELEMETRY_GPB_WT_FIXED64:
+    if ((end - (*ptr)) < 8) return ERR;
+    for (idx = 7; idx >= 0; idx--) field->value = ((field->value << 8) | (*ptr)[idx]);
+    (*ptr) += 8;
+    return SUCCESS;
+  case TELEMETRY_GPB_WT_LEN:
+    if (telemetry_gpb_varint(ptr, end, &len) == ERR) return ERR;
+    if (len > (u_int64_t) (end - (*ptr))) return ERR;
+    field->data = (*ptr);
+    field->len = len;
+    (*ptr) += len;
+    return SUCCESS;
+  case TELEMETRY_GPB_WT_FIXED32:
+    if ((end - (*ptr)) < 4) return ERR;
+    for (idx = 3; idx >= 0; idx--) field->value = ((field->value << 8) | (*ptr)[idx]);
+    (*ptr) += 4;
+    return SUCCESS;
+  default:
+    return ERR;
+  }
+}
+
+int telemetry_gpb_kv_get_path(u_char *buf, u_int32_t len, char **path, u_int32_t *path_len)
+{
+  struct telemetry_gpb_field field;
+  u_char *ptr = buf, *end = buf + len;
+
+  while (ptr < end) {
+    if (telemetry_gpb_next(&ptr, end, &field) == ERR) return ERR;
+
+    if (field.tag == TELEMETRY_GPB_ENCODING_PATH && field.wire_type == TELEMETRY_GPB_WT_LEN) {
+      (*path) = (char *) field.data;
+      (*path_len) = field.len;
+      return SUCCESS;
+    }
+  }
+
+  return ERR;
+}
+
+/*
+   Filter file format, one sensor path per line, optionally followed by a
+   comma-separated list of the content fields to keep:
+
+   Cisco-IOS-XR-infra-statsd-oper:infra-statistics/interfaces/interface/latest/generic-counters bytes-received,bytes-sent
+   Cisco-IOS-XR-nto-misc-oper:memory-summary/nodes/node/summary
+
+   Messages for sensor paths not listed are dropped.
+*/
+void telemetry_gpb_kv_filter_load(char *filename)
+{
+  struct telemetry_gpb_kv_filter *filters = NULL, *filter;
+  char buf[LARGEBUFLEN], *path, *fields, *token, *saveptr;
+  int num = 0, lineno = 0;
+  FILE *file;
+
+  if (!filename) return;
+
+  if (!(file = fopen(filename, "r"))) {
+    Log(LOG_ERR, "ERROR ( %s/core/TELE ): [%s] file not found.\n", config.name, filename);
+    exit_all(1);
+  }
+
+  while (fgets(buf, sizeof(buf), file)) {
+    lineno++;
+
+    path = strtok_r(buf, " \t\r\n", &saveptr);
+    if (!path || path[0] == '#') continue;
+    fields = strtok_r(NULL, " \t\r\n", &saveptr);
+
+    filters = realloc(filters, (num + 1) * sizeof(struct telemetry_gpb_kv_filter));
+    if (!filters) {
+      Log(LOG_ERR, "ERROR ( %s/core/TELE ): [%s:%u] realloc() failed. Terminating.\n", config.name, filename, lineno);
+      exit_all(1);
+    }
+
+    filter = &filters[num++];
+    memset(filter, 0, sizeof(struct telemetry_gpb_kv_filter));
+    filter->path = strdup(path);
+
+    for (token = fields ? strtok_r(fields, ",", &saveptr) : NULL; token; token = strtok_r(NULL, ",", &saveptr)) {
+      filter->fields = realloc(filter->fields, (filter->num_fields + 1) * sizeof(char *));
+      if (!filter->fields) {
+        Log(LOG_ERR, "ERROR ( %s/core/TELE ): [%s:%u] realloc() failed. Terminating.\n", config.name, filename, lineno);
+        exit_all(1);
+      }
+
+      filter->fields[filter->num_fields++] = strdup(token);
+    }
+  }
+
+  fclose(file);
+
+  telemetry_gpb_kv_filters = filters;
+  telemetry_gpb_kv_num_filters = num;
+
+  Log(LOG_INFO, "INFO ( %s/core/TELE ): [%s] %u sensor paths loaded.\n", config.name, filename, num);
+}
+
+struct telemetry_gpb_kv_filter *telemetry_gpb_kv_filter_find(char *path, u_int32_t path_len)
+{
+  int idx;
+
+  for (idx = 0; idx < telemetry_gpb_kv_num_filters; idx++) {
+    if (strlen(telemetry_gpb_kv_filters[idx].path) == path_len &&
+	!memcmp(telemetry_gpb_kv_filters[idx].path, path, path_len))
+      return &telemetry_gpb_kv_filters[idx];
+  }
+
+  return NULL;
+}
+
+/* telemetry_gpb_kv_accept() returns TRUE if a message is to be processed
+   according to the sensor path filter, if any */
+int telemetry_gpb_kv_accept(u_char *buf, u_int32_t len)
+{
+  u_int32_t path_len;
+  char *path;
+
+  if (!config.telemetry_gpb_kv_filter_file) return TRUE;
+  if (telemetry_gpb_kv_get_path(buf, len, &path, &path_len) == ERR) return FALSE;
+
+  return (telemetry_gpb_kv_filter_find(path, path_len) ? TRUE : FALSE);
+}
+
+#ifdef WITH_JANSSON
+static json_t *telemetry_gpb_kv_string(u_char *data, u_int32_t len)
+{
+  char sbuf[SRVBUFLEN], *str = sbuf;
+  json_t *value;
+
+  /* strings are not NUL-terminated on the wire */
+  if (len >= sizeof(sbuf) && !(str = malloc(len + 1))) return json_null();
+
+  if (len) memcpy(str, data, len);
+  str[len] = '\0';
+
+  value = json_string(str);
+  if (str != sbuf) free(str);
+
+  return (value ? value : json_null());
+}
+
+static int telemetry_gpb_kv_keep(struct telemetry_gpb_kv_filter *filter, u_char *name, u_int32_t len)
+{
+  int idx;
+
+  if (!filter || !filter->num_fields) return TRUE;
+
+  for (idx = 0; idx < filter->num_fields; idx++) {
+    if (strlen(filter->fields[idx]) == len && !memcmp(filter->fields[idx], name, len)) return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* adds 'value' to 'parent' under 'name'; repeated names, ie. list
+   entries, are gathered in an array */
+static void telemetry_gpb_kv_set(json_t *parent, char *name, json_t *value)
+{
+  json_t *prev, *list;
+
+  if (!(prev = json_object_get(parent, name))) {
+    json_object_set_new_nocheck(parent, name, value);
+    return;
+  }
+
+  if (json_is_array(prev)) json_array_append_new(prev, value);
+  else {
+    list = json_array();
+    json_array_append(list, prev);
+    json_array_append_new(list, value);
+    json_object_set_new_nocheck(parent, name, list);
+  }
+}
+
+/*
+   Decodes a TelemetryField. Leaves become JSON values, fields with children
+   become objects keyed by the children names. 'filter' applies to the
+   children of a row 'content' field.
+*/
+static json_t *telemetry_gpb_kv_field(u_char *buf, u_int32_t len, int depth, struct telemetry_gpb_kv_filter *filter,
+				      u_char **name, u_int32_t *name_len)
+{
+  struct telemetry_gpb_field field;
+  u_char *ptr, *end = buf + len, *child_name;
+  u_int32_t child_name_len;
+  json_t *value = NULL, *obj = NULL, *child, *leaf;
+  u_int64_t timestamp = 0;
+  char key[SRVBUFLEN], *base64;
+  size_t base64_len;
+  int is_row = (depth == 0), is_content;
+
+  (*name) = NULL;
+  (*name_len) = 0;
+
+  if (depth > TELEMETRY_GPB_MAX_DEPTH) return NULL;
+
+  /* pass 1: name and value */
+  for (ptr = buf; ptr < end; ) {
+    if (telemetry_gpb_next(&ptr, end, &field) == ERR) goto error;
+    leaf = NULL;
+
+    switch (field.tag) {
+    case TELEMETRY_GPB_KV_TIMESTAMP:
+      timestamp = field.value;
+      break;
+    case TELEMETRY_GPB_KV_NAME:
+      (*name) = field.data;
+      (*name_len) = field.len;
+      break;
+    case TELEMETRY_GPB_KV_BYTES:
+      base64 = (char *) base64_encode(field.data, field.len, &base64_len);
+      if (base64) {
+	leaf = json_string(base64);
+	base64_freebuf(base64);
+      }
+      break;
+    case TELEMETRY_GPB_KV_STRING:
+      leaf = telemetry_gpb_kv_string(field.data, field.len);
+      break;
+    case TELEMETRY_GPB_KV_BOOL:
+      leaf = json_boolean(field.value);
+      break;
+    case TELEMETRY_GPB_KV_UINT32:
+    case TELEMETRY_GPB_KV_UINT64:
+      leaf = json_integer((json_int_t) field.value);
+      break;
+    case TELEMETRY_GPB_KV_SINT32:
+    case TELEMETRY_GPB_KV_SINT64:
+      leaf = json_integer((json_int_t) ((field.value >> 1) ^ (-(field.value & 1))));
+      break;
+    case TELEMETRY_GPB_KV_DOUBLE:
+      {
+	double d;
+
+	memcpy(&d, &field.value, sizeof(d));
+	leaf = json_real(d);
+      }
+      break;
+    case TELEMETRY_GPB_KV_FLOAT:
+      {
+	u_int32_t u32 = field.value;
+	float f;
+
+	memcpy(&f, &u32, sizeof(f));
+	leaf = json_real(f);
+      }
+      break;
+    default:
+      break;
+    }
+
+    /* a repeated value field: the last one wins */
+    if (leaf) {
+      if (value) json_decref(value);
+      value = leaf;
+    }
+  }
+
+  is_content = (depth == 1 && (*name_len) == strlen("content") && !memcmp((*name), "content", (*name_len)));
+
+  /* pass 2: children */
+  for (ptr = buf; ptr < end; ) {
+    if (telemetry_gpb_next(&ptr, end, &field) == ERR) goto error;
+    if (field.tag != TELEMETRY_GPB_KV_FIELDS || field.wire_type != TELEMETRY_GPB_WT_LEN) continue;
+
+    if (!obj) obj = json_object();
+
+    child = telemetry_gpb_kv_field(field.data, field.len, depth + 1, is_row ? filter : NULL, &child_name, &child_name_len);
+    if (!child) goto error;
+
+    if (is_content && !telemetry_gpb_kv_keep(filter, child_name, child_name_len)) {
+      json_decref(child);
+      continue;
+    }
+
+    if (child_name_len >= sizeof(key)) child_name_len = (sizeof(key) - 1);
+    if (child_name_len) memcpy(key, child_name, child_name_len);
+    key[child_name_len] = '\0';
+
+    telemetry_gpb_kv_set(obj, key, child);
+  }
+
+  /* rows: keep the timestamp, content filter passed down */
+  if (is_row) {
+    if (!obj) obj = json_object();
+    if (timestamp) json_object_set_new_nocheck(obj, "timestamp", json_integer((json_int_t) timestamp));
+  }
+
+  if (obj) {
+    if (value) json_decref(value);
+    return obj;
+  }
+
+  return (value ? value : json_null());
+
+  error:
+  if (value) json_decref(value);
+  if (obj) json_decref(obj);
+
+  return NULL;
+}
+
+/* telemetry_gpb_kv_decode() turns a GPB-KV Telemetry message into a JSON
+   object, applying the sensor path filter, if any */
+json_t *telemetry_gpb_kv_decode(u_char *buf, u_int32_t len)
+{
+  struct telemetry_gpb_field field;
+  struct telemetry_gpb_kv_filter *filter = NULL;
+  u_char *ptr, *end = buf + len, *name;
+  u_int32_t name_len, path_len;
+  json_t *obj, *rows = NULL, *row;
+  char *path;
+
+  if (config.telemetry_gpb_kv_filter_file) {
+    if (telemetry_gpb_kv_get_path(buf, len, &path, &path_len) == ERR) return NULL;
+    if (!(filter = telemetry_gpb_kv_filter_find(path, path_len))) return NULL;
+  }
+
+  obj = json_object();
+
+  for (ptr = buf; ptr < end; ) {
+    if (telemetry_gpb_next(&ptr, end, &field) == ERR) goto error;
+
+    switch (field.tag) {
+    case TELEMETRY_GPB_NODE_ID_STR:
+      json_object_set_new_nocheck(obj, "node_id_str", telemetry_gpb_kv_string(field.data, field.len));
+      break;
+    case TELEMETRY_GPB_SUBSCRIPTION_ID_STR:
+      json_object_set_new_nocheck(obj, "subscription_id_str", telemetry_gpb_kv_string(field.data, field.len));
+      break;
+    case TELEMETRY_GPB_ENCODING_PATH:
+      json_object_set_new_nocheck(obj, "encoding_path", telemetry_gpb_kv_string(field.data, field.len));
+      break;
+    case TELEMETRY_GPB_COLLECTION_ID:
+      json_object_set_new_nocheck(obj, "collection_id", json_integer((json_int_t) field.value));
+      break;
+    case TELEMETRY_GPB_COLLECTION_START_TIME:
+      json_object_set_new_nocheck(obj, "collection_start_time", json_integer((json_int_t) field.value));
+      break;
+    case TELEMETRY_GPB_MSG_TIMESTAMP:
+      json_object_set_new_nocheck(obj, "msg_timestamp", json_integer((json_int_t) field.value));
+      break;
+    case TELEMETRY_GPB_COLLECTION_END_TIME:
+      json_object_set_new_nocheck(obj, "collection_end_time", json_integer((json_int_t) field.value));
+      break;
+    case TELEMETRY_GPB_DATA_GPBKV:
+      if (field.wire_type != TELEMETRY_GPB_WT_LEN) goto error;
+      if (!(row = telemetry_gpb_kv_field(field.data, field.len, 0, filter, &name, &name_len))) goto error;
+
+      if (!rows) {
+	rows = json_array();
+	json_object_set_new_nocheck(obj, "data_gpbkv", rows);
+      }
+      json_array_append_new(rows, row);
+      break;
+    default:
+      break;
+    }
+  }
+
+  return obj;
+
+  error:
+  json_decref(obj);
+
+  return NULL;
+}
+#endif
@@ -0,0 +1,87 @@
+/*  
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* defines */
+#define TELEMETRY_GPB_MAX_DEPTH		32
+
+#define TELEMETRY_GPB_WT_VARINT		0
+#define TELEMETRY_GPB_WT_FIXED64	1
+#define TELEMETRY_GPB_WT_LEN		2
+#define TELEMETRY_GPB_WT_FIXED32	5
+
+/* Cisco telemetry.proto, Telemetry message */
+#define TELEMETRY_GPB_NODE_ID_STR		1
+#define TELEMETRY_GPB_SUBSCRIPTION_ID_STR	3
+#define TELEMETRY_GPB_ENCODING_PATH		6
+#define TELEMETRY_GPB_COLLECTION_ID		8
+#define TELEMETRY_GPB_COLLECTION_START_TIME	9
+#define TELEMETRY_GPB_MSG_TIMESTAMP		10
+#define TELEMETRY_GPB_DATA_GPBKV		11
+#define TELEMETRY_GPB_COLLECTION_END_TIME	13
+
+/* Cisco telemetry.proto, TelemetryField message */
+#define TELEMETRY_GPB_KV_TIMESTAMP		1
+#define TELEMETRY_GPB_KV_NAME			2
+#define TELEMETRY_GPB_KV_BYTES			4
+#define TELEMETRY_GPB_KV_STRING			5
+#define TELEMETRY_GPB_KV_BOOL			6
+#define TELEMETRY_GPB_KV_UINT32			7
+#define TELEMETRY_GPB_KV_UINT64			8
+#define TELEMETRY_GPB_KV_SINT32			9
+#define TELEMETRY_GPB_KV_SINT64			10
+#define TELEMETRY_GPB_KV_DOUBLE			11
+#define TELEMETRY_GPB_KV_FLOAT			12
+#define TELEMETRY_GPB_KV_FIELDS			15
+
+/* structures */
+struct telemetry_gpb_field {
+  u_int32_t tag;
+  u_int8_t wire_type;
+  u_int64_t value;		/* varint, fixed64, fixed32 */
+  u_char *data;			/* length-delimited */
+  u_int32_t len;
+};
+
+/* sensor path filter: a NULL fields list keeps the whole content */
+struct telemetry_gpb_kv_filter {
+  char *path;
+  char **fields;
+  int num_fields;
+};
+
+/* prototypes */
+#if (!defined __TELEMETRY_GPB_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT int telemetry_gpb_next(u_char **, u_char *, struct telemetry_gpb_field *);
+EXT int telemetry_gpb_kv_get_path(u_char *, u_int32_t, char **, u_int32_t *);
+EXT void telemetry_gpb_kv_filter_load(char *);
+EXT struct telemetry_gpb_kv_filter *telemetry_gpb_kv_filter_find(char *, u_int32_t);
+EXT int telemetry_gpb_kv_accept(u_char *, u_int32_t);
+#ifdef WITH_JANSSON
+EXT json_t *telemetry_gpb_kv_decode(u_char *, u_int32_t);
+#endif
+
+EXT struct telemetry_gpb_kv_filter *telemetry_gpb_kv_filters;
+EXT int telemetry_gpb_kv_num_filters;
+#undef EXT
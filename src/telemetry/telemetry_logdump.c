@@ -102,6 +102,14 @@ int telemetry_log_msg(telemetry_peer *peer, struct telemetry_data *t_data, void
 
       json_object_set_new_nocheck(obj, "serialization", json_string("gpb"));
     }
+    else if (data_decoder == TELEMETRY_DATA_DECODER_GPB_KV) {
+      json_t *tdata = telemetry_gpb_kv_decode(log_data, log_data_len);
+
+      if (tdata) json_object_set_new_nocheck(obj, "telemetry_data", tdata);
+      else json_object_set_new_nocheck(obj, "telemetry_data", json_null());
+
+      json_object_set_new_nocheck(obj, "serialization", json_string("gpb_kv"));
+    }
 
     if ((config.telemetry_msglog_file && etype == TELEMETRY_LOGDUMP_ET_LOG) ||
         (config.telemetry_dump_file && etype == TELEMETRY_LOGDUMP_ET_DUMP))
@@ -136,20 +136,73 @@ int telemetry_recv_zjson(telemetry_peer *peer, telemetry_peer_z *peer_z, u_int32
 
 
   if (ret > 0) { 
-    int zret;
-
-    memset(peer_z->inflate_buf, 0, sizeof(peer_z->inflate_buf));
-    peer_z->stm.avail_out = (uInt) sizeof(peer_z->inflate_buf);
-    peer_z->stm.next_out = (Bytef *) peer_z->inflate_buf;
+    u_int32_t produced = 0, base_len;
+    char *base, *new_buf, scratch[SRVBUFLEN];
+    int zret, dropped = FALSE;
 
     peer_z->stm.avail_in = (uInt) peer->msglen;
     peer_z->stm.next_in = (Bytef *) peer->buf.base;
 
+    /* one byte is kept for the string terminator */
+    for (;;) {
+      peer_z->stm.avail_out = (uInt) (peer_z->inflate_buf_len - produced - 1);
+      peer_z->stm.next_out = (Bytef *) &peer_z->inflate_buf[produced];
+
+      zret = inflate(&peer_z->stm, Z_NO_FLUSH);
+      produced = (peer_z->inflate_buf_len - 1 - peer_z->stm.avail_out);
+
+      /* no progress possible: either the output is full or the input is
+         used up, ie. the message filled the buffer exactly */
+      if (zret == Z_BUF_ERROR && (!peer_z->stm.avail_out || !peer_z->stm.avail_in)) zret = Z_OK;
+      if (zret != Z_OK || peer_z->stm.avail_out) break;
+
+      /* output buffer full: grow it and carry on */
+      if (peer_z->inflate_buf_len >= TELEMETRY_INFLATE_BUF_MAX ||
+	  !(new_buf = realloc(peer_z->inflate_buf, peer_z->inflate_buf_len * 2))) {
+	/* inflate the rest of the message to nowhere so that the stream stays in sync */
+	do {
+	  peer_z->stm.avail_out = (uInt) sizeof(scratch);
+	  peer_z->stm.next_out = (Bytef *) scratch;
+	  zret = inflate(&peer_z->stm, Z_NO_FLUSH);
+	  if (peer_z->stm.avail_out != sizeof(scratch)) dropped = TRUE;
+	} while (zret == Z_OK && !peer_z->stm.avail_out);
+
+	if (zret == Z_BUF_ERROR) zret = Z_OK;
+
+	/* nothing left over: the message did fit */
+	if (!dropped) break;
+
+	Log(LOG_WARNING, "WARN ( %s/%s ): [%s] zjson message larger than %u bytes. Dropped.\n",
+	    config.name, config.type, peer->addr_str, peer_z->inflate_buf_len);
+
+	if (zret == Z_STREAM_END) inflateReset(&peer_z->stm);
+	else if (zret != Z_OK) dropped = FALSE; /* broken stream */
+	zret = Z_MEM_ERROR;
+	break;
+      }
+
+      peer_z->inflate_buf = new_buf;
+      peer_z->inflate_buf_len *= 2;
+    }
+
     ret = FALSE;
-    zret = inflate(&peer_z->stm, Z_NO_FLUSH);
-    if (zret == Z_OK || zret == Z_STREAM_END) {
-      strlcpy(peer->buf.base, peer_z->inflate_buf, peer->buf.len);
-      peer->msglen = strlen(peer->buf.base) + 1;
+    if (dropped) {
+      /* the session is fine, only this message is skipped */
+      ret = peer->msglen;
+      (*flags) = ERR;
+    }
+    else if (zret == Z_OK || zret == Z_STREAM_END) {
+      peer_z->inflate_buf[produced] = '\0';
+
+      /* hand the inflated message over as the peer buffer, no copy back */
+      base = peer->buf.base;
+      base_len = peer->buf.len;
+      peer->buf.base = peer_z->inflate_buf;
+      peer->buf.len = peer_z->inflate_buf_len;
+      peer_z->inflate_buf = base;
+      peer_z->inflate_buf_len = base_len;
+
+      peer->msglen = (produced + 1);
       ret = peer->msglen;
 
       (*flags) = telemetry_basic_validate_json(peer);
@@ -224,7 +277,8 @@ int telemetry_recv_cisco(telemetry_peer *peer, int *flags, int *data_decoder)
       break;
     case TELEMETRY_CISCO_GPB_KV:
       ret = telemetry_recv_generic(peer, len);
-      (*data_decoder) = TELEMETRY_DATA_DECODER_GPB;
+      if (ret > 0 && !telemetry_gpb_kv_accept((u_char *) peer->buf.base, peer->msglen)) (*flags) = ERR;
+      (*data_decoder) = (config.telemetry_gpb_kv_decode ? TELEMETRY_DATA_DECODER_GPB_KV : TELEMETRY_DATA_DECODER_GPB);
       break;
     }
   }
@@ -265,10 +319,16 @@ int telemetry_recv_cisco_gpb_kv(telemetry_peer *peer, int *flags)
   int ret = 0;
   u_int32_t len;
 
+  if (!flags) return ret;
+  (*flags) = FALSE;
+
   ret = telemetry_recv_generic(peer, TELEMETRY_CISCO_HDR_LEN);
   if (ret == TELEMETRY_CISCO_HDR_LEN) {
     len = telemetry_cisco_hdr_get_len(peer);
     ret = telemetry_recv_generic(peer, len);
+
+    /* sensor paths not of interest are dropped before any processing */
+    if (ret > 0 && !telemetry_gpb_kv_accept((u_char *) peer->buf.base, peer->msglen)) (*flags) = ERR;
   }
 
   return ret;
@@ -276,10 +336,70 @@ int telemetry_recv_cisco_gpb_kv(telemetry_peer *peer, int *flags)
 
 int telemetry_basic_validate_json(telemetry_peer *peer)
 {
-  if (peer->buf.base[peer->buf.truncated_len] != '{') {
+  if (peer->buf.base[peer->buf.truncated_len] != '{' ||
+      (config.telemetry_validate_json && telemetry_validate_json_structure(&peer->buf.base[peer->buf.truncated_len],
+									   (peer->msglen - peer->buf.truncated_len)))) {
     peer->stats.msg_errors++;
     return ERR;
   }
   else
     return FALSE;
 }
+
+/*
+   Single pass structural check, no parsing nor allocations: one top-level
+   object, brackets balanced and properly nested, strings terminated and
+   escapes well-formed; only whitespace or NULs (see telemetry_basic_process_json())
+   may be found outside of it.
+   Scalars are not checked.
+*/
+int telemetry_validate_json_structure(char *buf, u_int32_t len)
+{
+  u_int8_t stack[TELEMETRY_JSON_MAX_DEPTH / 8];
+  u_int32_t idx, depth = 0;
+  int in_string = FALSE, closed = FALSE;
+  u_char c;
+
+  for (idx = 0; idx < len; idx++) {
+    c = buf[idx];
+
+    if (in_string) {
+      if (c == '\\') {
+        if (++idx == len) return ERR;
+      }
+      else if (c == '"') in_string = FALSE;
+      else if (c < 0x20) return ERR;
+
+      continue;
+    }
+
+    if (closed) {
+      if (c == '\0' || isspace(c)) continue;
+      else return ERR;
+    }
+
+    switch (c) {
+    case '"':
+      in_string = TRUE;
+      break;
+    case '{':
+    case '[':
+      if (depth == TELEMETRY_JSON_MAX_DEPTH) return ERR;
+      if (c == '{') stack[depth / 8] |= (1 << (depth % 8));
+      else stack[depth / 8] &= ~(1 << (depth % 8));
+      depth++;
+      break;
+    case '}':
+    case ']':
+      if (!depth) return ERR;
+      depth--;
+      if (((stack[depth / 8] >> (depth % 8)) & 1) != (c == '}')) return ERR;
+      if (!depth) closed = TRUE;
+      break;
+    default:
+      break;
+    }
+  }
+
+  return (closed ? FALSE : ERR);
+}
@@ -42,4 +42,5 @@ EXT int telemetry_recv_cisco_gpb(telemetry_peer *);
 EXT int telemetry_recv_cisco_gpb_kv(telemetry_peer *, int *);
 EXT void telemetry_basic_process_json(telemetry_peer *);
 EXT int telemetry_basic_validate_json(telemetry_peer *);
+EXT int telemetry_validate_json_structure(char *, u_int32_t);
 #undef EXT
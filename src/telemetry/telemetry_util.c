@@ -48,6 +48,12 @@ int telemetry_peer_z_init(telemetry_peer_z *peer_z)
   peer_z->stm.avail_in = 0;
   peer_z->stm.next_in = Z_NULL;
 
+  if (!peer_z->inflate_buf) {
+    peer_z->inflate_buf_len = BGP_BUFFER_SIZE;
+    peer_z->inflate_buf = malloc(peer_z->inflate_buf_len);
+    if (!peer_z->inflate_buf) return ERR;
+  }
+
   if (inflateInit(&peer_z->stm) != Z_OK) return ERR;
 #endif
 
@@ -90,6 +96,10 @@ void telemetry_peer_z_close(telemetry_peer_z *peer_z)
 {
 #if defined (HAVE_ZLIB)
   inflateEnd(&peer_z->stm);
+
+  free(peer_z->inflate_buf);
+  peer_z->inflate_buf = NULL;
+  peer_z->inflate_buf_len = 0;
 #endif
 }
 
@@ -154,10 +164,15 @@ int telemetry_validate_input_output_decoders(int input, int output)
     if (output == PRINT_OUTPUT_JSON) return FALSE;
     /* else if (output == PRINT_OUTPUT_GPB) return FALSE; */
   }
+  else if (input == TELEMETRY_DATA_DECODER_GPB_KV) {
+    if (output == PRINT_OUTPUT_JSON) return FALSE;
+  }
   else if (input == TELEMETRY_DATA_DECODER_JSON) {
     if (output == PRINT_OUTPUT_JSON) return FALSE;
     /* else if (output == PRINT_OUTPUT_GPB) return ERR; */
   }
+
+  return ERR;
 }
 
 void telemetry_log_peer_stats(telemetry_peer *peer, struct telemetry_data *t_data)
@@ -147,17 +147,28 @@ thread_pool_t *allocate_thread_pool(int count)
   return pool;
 }
 
-/* XXX: case not supported: thread running and not in pool->free_list
-   at time of deallocate_thread_pool() execution; potential future need
-   for a worker_list in thread_pool_t */
+/* Threads still running at time of deallocate_thread_pool() execution
+   are waited for, ie. until they are back in pool->free_list: calling
+   this on pools whose threads never return (ie. BGP, BMP daemons) does
+   hang */
 void deallocate_thread_pool(thread_pool_t **pool)
 {
   thread_pool_t *pool_ptr = NULL;
-  thread_pool_item_t *worker = NULL;
+  thread_pool_item_t *worker = NULL, *next = NULL;
+  int free_count;
 
   if (!pool || !(*pool)) return;
 
   pool_ptr = (*pool); 
+
+  pthread_mutex_lock(pool_ptr->mutex);
+  for (;;) {
+    for (free_count = 0, worker = pool_ptr->free_list; worker; worker = worker->next) free_count++;
+    if (free_count == pool_ptr->count) break;
+    pthread_cond_wait(pool_ptr->cond, pool_ptr->mutex);
+  }
+  pthread_mutex_unlock(pool_ptr->mutex);
+
   worker = pool_ptr->free_list;
 
   while (worker) {
@@ -179,12 +190,20 @@ void deallocate_thread_pool(thread_pool_t **pool)
  
     free(worker->thread);
 
-    worker = worker->next;
+    next = worker->next;
     free(worker);
+    worker = next;
   }
 
-  if (pool_ptr->mutex) free(pool_ptr->mutex);
-  if (pool_ptr->cond) free(pool_ptr->cond);
+  if (pool_ptr->mutex) {
+    pthread_mutex_destroy(pool_ptr->mutex);
+    free(pool_ptr->mutex);
+  }
+
+  if (pool_ptr->cond) {
+    pthread_cond_destroy(pool_ptr->cond);
+    free(pool_ptr->cond);
+  }
 
   free((*pool));
   (*pool) = NULL;
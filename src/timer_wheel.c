@@ -0,0 +1,113 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#define __TIMER_WHEEL_C
+
+/* includes */
+#include "pmacct.h"
+
+/* Functions */
+void pm_timer_wheel_init(struct pm_timer_wheel *tw, u_int32_t slots, time_t now)
+{
+  u_int32_t idx, size = 1;
+
+  /* rounding up to a power of 2 */
+  while (size < slots) size <<= 1;
+
+  tw->slots = malloc(size * sizeof(struct pm_timer));
+  assert(tw->slots);
+
+  for (idx = 0; idx < size; idx++) {
+    tw->slots[idx].next = &tw->slots[idx];
+    tw->slots[idx].prev = &tw->slots[idx];
+    tw->slots[idx].deadline = 0;
+  }
+
+  tw->mask = size-1;
+  tw->clock = now;
+  tw->count = 0;
+}
+
+void pm_timer_add(struct pm_timer_wheel *tw, struct pm_timer *t, time_t deadline)
+{
+  struct pm_timer *head;
+  time_t slot = deadline;
+
+  if (t->next) pm_timer_del(tw, t);
+
+  if (slot <= tw->clock) slot = tw->clock+1;
+  else if (slot > tw->clock+tw->mask) slot = tw->clock+tw->mask;
+
+  head = &tw->slots[slot & tw->mask];
+  t->deadline = deadline;
+  t->prev = head->prev;
+  t->next = head;
+  head->prev->next = t;
+  head->prev = t;
+  tw->count++;
+}
+
+void pm_timer_del(struct pm_timer_wheel *tw, struct pm_timer *t)
+{
+  if (!t->next) return;
+
+  t->prev->next = t->next;
+  t->next->prev = t->prev;
+  t->next = NULL;
+  t->prev = NULL;
+  tw->count--;
+}
+
+/* pm_timer_wheel_expire() advances the wheel up to 'now' and hands every
+   due timer, already unlinked, to the callback; the callback either frees
+   the owner or re-arms the timer with a fresh deadline */
+void pm_timer_wheel_expire(struct pm_timer_wheel *tw, time_t now, pm_timer_cb cb)
+{
+  struct pm_timer pending, *head, *t;
+  u_int32_t ticks = 0;
+
+  while (tw->clock < now && ticks <= tw->mask) {
+    tw->clock++;
+    ticks++;
+
+    head = &tw->slots[tw->clock & tw->mask];
+    if (head->next == head) continue;
+
+    /* detaching the slot: timers may be re-armed into it */
+    pending.next = head->next;
+    pending.prev = head->prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    head->next = head;
+    head->prev = head;
+
+    while (pending.next != &pending) {
+      t = pending.next;
+      pm_timer_del(tw, t);
+
+      if (t->deadline > now) pm_timer_add(tw, t, t->deadline);
+      else cb(t, now);
+    }
+  }
+
+  /* idle for longer than the horizon: every slot was visited once */
+  if (tw->clock < now) tw->clock = now;
+}
@@ -0,0 +1,61 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+/* defines */
+#define TW_DEFAULT_SLOTS	4096	/* 1 sec granularity: ~68 mins horizon */
+
+/* structures */
+struct pm_timer {
+  struct pm_timer *next;
+  struct pm_timer *prev;
+  time_t deadline;
+};
+
+/*
+   Single level wheel with one slot per second. Timers farther than the
+   horizon are parked in the last slot and re-filed when that fires, so
+   a pass costs one slot plus whatever actually expires in it.
+*/
+struct pm_timer_wheel {
+  struct pm_timer *slots;
+  u_int32_t mask;
+  time_t clock;
+  u_int32_t count;
+};
+
+typedef void (*pm_timer_cb)(struct pm_timer *, time_t);
+
+/* prototypes */
+#if (!defined __TIMER_WHEEL_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+EXT void pm_timer_wheel_init(struct pm_timer_wheel *, u_int32_t, time_t);
+EXT void pm_timer_add(struct pm_timer_wheel *, struct pm_timer *, time_t);
+EXT void pm_timer_del(struct pm_timer_wheel *, struct pm_timer *);
+EXT void pm_timer_wheel_expire(struct pm_timer_wheel *, time_t, pm_timer_cb);
+#undef EXT
+
+#endif /* _TIMER_WHEEL_H_ */
@@ -0,0 +1,297 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+/* defines */
+#define __TPACKET_C
+
+/* includes */
+#include "pmacct.h"
+#include "pmacct-dlt.h"
+#include "ip_frag.h"
+#include "ip_flow.h"
+#include "conntrack.h"
+#include "thread_pool.h"
+#include "tpacket.h"
+
+#if defined (HAVE_TPACKET_V3)
+/* Functions */
+int tpacket_workers_init(struct pcap_callback_data *cb_data, struct bpf_program *filter)
+{
+  thread_pool_t *pool;
+  sigset_t mask, oldmask;
+  int idx;
+
+  if (config.capture_threads > TPACKET_MAX_WORKERS) {
+    Log(LOG_WARNING, "WARN ( %s/core ): 'pmacctd_capture_threads' capped to %u.\n", config.name, TPACKET_MAX_WORKERS);
+    config.capture_threads = TPACKET_MAX_WORKERS;
+  }
+
+  if (!config.tpacket_block_size) config.tpacket_block_size = TPACKET_DEFAULT_BLOCK_SIZE;
+  if (!config.tpacket_blocks) config.tpacket_blocks = TPACKET_DEFAULT_BLOCKS;
+
+  tpacket_num_workers = config.capture_threads;
+  tpacket_workers = malloc(tpacket_num_workers * sizeof(struct tpacket_worker));
+  if (!tpacket_workers) {
+    Log(LOG_ERR, "ERROR ( %s/core ): tpacket_workers_init(): unable to allocate workers. Exiting.\n", config.name);
+    return ERR;
+  }
+  memset(tpacket_workers, 0, tpacket_num_workers * sizeof(struct tpacket_worker));
+  pthread_mutex_init(&tpacket_exec_mutex, NULL);
+
+  /* all sockets have to join the fanout group before any traffic is read */
+  for (idx = 0; idx < tpacket_num_workers; idx++) {
+    tpacket_workers[idx].id = idx;
+    memcpy(&tpacket_workers[idx].cb_data, cb_data, sizeof(struct pcap_callback_data));
+    tpacket_workers[idx].cb_data.worker_id = idx;
+    tpacket_workers[idx].cb_data.serialize = TRUE;
+
+    if (tpacket_setup_socket(&tpacket_workers[idx], filter) == ERR) return ERR;
+  }
+
+  /* signals are left to the main thread: workers inherit a blocked mask */
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+
+  pool = allocate_thread_pool(tpacket_num_workers);
+  assert(pool);
+  Log(LOG_DEBUG, "DEBUG ( %s/core ): %d capture thread(s) initialized\n", config.name, tpacket_num_workers);
+
+  for (idx = 0; idx < tpacket_num_workers; idx++)
+    send_to_pool(pool, tpacket_worker, &tpacket_workers[idx]);
+
+  pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+
+  return SUCCESS;
+}
+
+int tpacket_setup_socket(struct tpacket_worker *w, struct bpf_program *filter)
+{
+  struct sockaddr_ll sll;
+  struct packet_mreq mr;
+  int version = TPACKET_V3, fanout, idx;
+
+  w->fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if (w->fd == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/core ): tpacket: socket() failed: %s\n", config.name, strerror(errno));
+    return ERR;
+  }
+
+  if (setsockopt(w->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/core ): tpacket: TPACKET_V3 not supported: %s\n", config.name, strerror(errno));
+    return ERR;
+  }
+
+  /* pcap_compile() output is laid out as a classic BPF program */
+  if (filter && filter->bf_len) {
+    struct sock_fprog fprog;
+
+    fprog.len = filter->bf_len;
+    fprog.filter = (struct sock_filter *) filter->bf_insns;
+    if (setsockopt(w->fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) == ERR)
+      Log(LOG_WARNING, "WARN ( %s/core ): tpacket: unable to attach filter (going on without a filter): %s\n", config.name, strerror(errno));
+  }
+
+  memset(&w->req, 0, sizeof(w->req));
+  w->req.tp_block_size = config.tpacket_block_size;
+  w->req.tp_block_nr = config.tpacket_blocks;
+  w->req.tp_frame_size = TPACKET_FRAME_SIZE;
+  w->req.tp_frame_nr = (w->req.tp_block_size * w->req.tp_block_nr) / w->req.tp_frame_size;
+  w->req.tp_retire_blk_tov = TPACKET_BLOCK_TIMEOUT;
+  w->req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+
+  if (setsockopt(w->fd, SOL_PACKET, PACKET_RX_RING, &w->req, sizeof(w->req)) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/core ): tpacket: unable to set up RX ring (block_size=%u blocks=%u): %s\n",
+	config.name, w->req.tp_block_size, w->req.tp_block_nr, strerror(errno));
+    return ERR;
+  }
+
+  w->map = mmap(NULL, w->req.tp_block_size * w->req.tp_block_nr, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, w->fd, 0);
+  if (w->map == MAP_FAILED) {
+    Log(LOG_ERR, "ERROR ( %s/core ): tpacket: mmap() failed: %s\n", config.name, strerror(errno));
+    return ERR;
+  }
+
+  w->blocks = malloc(w->req.tp_block_nr * sizeof(struct iovec));
+  w->vlan_buf = malloc(config.snaplen + 4);
+  if (!w->blocks || !w->vlan_buf) {
+    Log(LOG_ERR, "ERROR ( %s/core ): tpacket: unable to allocate ring descriptors.\n", config.name);
+    return ERR;
+  }
+
+  for (idx = 0; idx < w->req.tp_block_nr; idx++) {
+    w->blocks[idx].iov_base = w->map + (idx * w->req.tp_block_size);
+    w->blocks[idx].iov_len = w->req.tp_block_size;
+  }
+
+  memset(&sll, 0, sizeof(sll));
+  sll.sll_family = PF_PACKET;
+  sll.sll_protocol = htons(ETH_P_ALL);
+  sll.sll_ifindex = if_nametoindex(config.dev);
+  if (!sll.sll_ifindex || bind(w->fd, (struct sockaddr *) &sll, sizeof(sll)) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/core ): tpacket: unable to bind to %s: %s\n", config.name, config.dev, strerror(errno));
+    return ERR;
+  }
+
+  if (config.promisc) {
+    memset(&mr, 0, sizeof(mr));
+    mr.mr_ifindex = sll.sll_ifindex;
+    mr.mr_type = PACKET_MR_PROMISC;
+    if (setsockopt(w->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof(mr)) == ERR)
+      Log(LOG_WARNING, "WARN ( %s/core ): tpacket: unable to set promiscuous mode on %s: %s\n", config.name, config.dev, strerror(errno));
+  }
+
+  /* flows are kept whole on the same worker: flow and fragment tables are per-thread */
+  if (config.tpacket_fanout_mode == TPACKET_FANOUT_CPU) fanout = PACKET_FANOUT_CPU;
+  else fanout = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+  fanout = ((getpid() & 0xffff) | (fanout << 16));
+
+  if (setsockopt(w->fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/core ): tpacket: unable to join fanout group: %s\n", config.name, strerror(errno));
+    return ERR;
+  }
+
+  return SUCCESS;
+}
+
+void tpacket_worker(void *arg)
+{
+  struct tpacket_worker *w = (struct tpacket_worker *) arg;
+  struct tpacket_block_desc *bd;
+  struct pollfd pfd;
+  unsigned int block = 0;
+  char worker[STATS_WORKER_LEN];
+
+  snprintf(worker, sizeof(worker), "capture/%u", w->id);
+  stats_set_worker(worker);
+
+  pthread_mutex_lock(&tpacket_exec_mutex);
+  if (config.handle_fragments) init_ip_fragment_handler();
+  if (config.handle_flows) init_ip_flow_handler();
+  if (config.classifiers_path) init_conntrack_table();
+  pthread_mutex_unlock(&tpacket_exec_mutex);
+
+  Log(LOG_INFO, "INFO ( %s/core ): capture thread #%u reading from %s\n", config.name, w->id, config.dev);
+
+  memset(&pfd, 0, sizeof(pfd));
+  pfd.fd = w->fd;
+  pfd.events = POLLIN | POLLERR;
+
+  for (;;) {
+    bd = (struct tpacket_block_desc *) w->blocks[block].iov_base;
+
+    if (!(bd->hdr.bh1.block_status & TP_STATUS_USER)) {
+      poll(&pfd, 1, -1);
+      continue;
+    }
+
+    tpacket_walk_block(w, bd);
+
+    /* give the block back to the kernel */
+    bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    __sync_synchronize();
+
+    block = (block + 1) % w->req.tp_block_nr;
+  }
+}
+
+void tpacket_walk_block(struct tpacket_worker *w, struct tpacket_block_desc *bd)
+{
+  struct tpacket3_hdr *tph;
+  struct pcap_pkthdr hdr;
+  u_int32_t num_pkts = bd->hdr.bh1.num_pkts, idx;
+  u_char *pkt;
+
+  tph = (struct tpacket3_hdr *) ((u_char *) bd + bd->hdr.bh1.offset_to_first_pkt);
+
+  for (idx = 0; idx < num_pkts; idx++) {
+    hdr.ts.tv_sec = tph->tp_sec;
+    hdr.ts.tv_usec = tph->tp_nsec / 1000;
+    hdr.caplen = MIN(tph->tp_snaplen, config.snaplen);
+    hdr.len = tph->tp_len;
+    pkt = (u_char *) tph + tph->tp_mac;
+
+    /* the kernel strips the 802.1Q tag off the frame; put it back in place
+       so that the link layer handler can account for it as with libpcap */
+    if ((tph->tp_status & TP_STATUS_VLAN_VALID) && w->cb_data.device->link_type == DLT_EN10MB && hdr.caplen >= 12) {
+      u_int16_t tpid = htons(ETHERTYPE_8021Q), tci = htons(tph->hv1.tp_vlan_tci);
+      u_int32_t rest = MIN(hdr.caplen, config.snaplen - 4) - 12;
+
+#if defined (TP_STATUS_VLAN_TPID_VALID)
+      if (tph->tp_status & TP_STATUS_VLAN_TPID_VALID) tpid = htons(tph->hv1.tp_vlan_tpid);
+#endif
+
+      memcpy(w->vlan_buf, pkt, 12);
+      memcpy(w->vlan_buf + 12, &tpid, 2);
+      memcpy(w->vlan_buf + 14, &tci, 2);
+      memcpy(w->vlan_buf + 16, pkt + 12, rest);
+
+      hdr.caplen = rest + 16;
+      hdr.len += 4;
+      pkt = w->vlan_buf;
+    }
+
+    pcap_cb((u_char *) &w->cb_data, &hdr, pkt);
+    tph = (struct tpacket3_hdr *) ((u_char *) tph + tph->tp_next_offset);
+  }
+}
+
+void tpacket_workers_stats(int to_stdout)
+{
+  struct tpacket_stats_v3 st;
+  socklen_t slen;
+  u_int64_t packets = 0, drops = 0, freezes = 0;
+  time_t now = time(NULL);
+  int idx;
+
+  for (idx = 0; idx < tpacket_num_workers; idx++) {
+    struct tpacket_worker *w = &tpacket_workers[idx];
+
+    /* counters are reset by the kernel upon every read */
+    slen = sizeof(st);
+    if (!getsockopt(w->fd, SOL_PACKET, PACKET_STATISTICS, &st, &slen)) {
+      w->packets += st.tp_packets;
+      w->drops += st.tp_drops;
+      w->freezes += st.tp_freeze_q_cnt;
+    }
+
+    if (!to_stdout)
+      Log(LOG_NOTICE, "NOTICE ( %s/core ): %s: (%u) thread #%u: %llu packets received, %llu dropped, %llu queue freezes\n",
+		config.name, config.dev, now, w->id, (unsigned long long) w->packets, (unsigned long long) w->drops,
+		(unsigned long long) w->freezes);
+
+    packets += w->packets;
+    drops += w->drops;
+    freezes += w->freezes;
+  }
+
+  if (to_stdout) {
+    printf("\n%llu packets received by filter\n", (unsigned long long) packets);
+    printf("%llu packets dropped by kernel\n", (unsigned long long) drops);
+  }
+  else {
+    Log(LOG_NOTICE, "NOTICE ( %s/%s ): %s: (%u) %llu packets received by filter\n",
+		config.name, config.type, config.dev, now, (unsigned long long) packets);
+    Log(LOG_NOTICE, "NOTICE ( %s/%s ): %s: (%u) %llu packets dropped by kernel\n",
+		config.name, config.type, config.dev, now, (unsigned long long) drops);
+  }
+}
+#endif
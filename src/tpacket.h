@@ -0,0 +1,80 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2016 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+/* includes */
+#if defined (LINUX) && defined (ENABLE_THREADS)
+#include <pthread.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#if defined (TPACKET3_HDRLEN) && defined (PACKET_FANOUT)
+#define HAVE_TPACKET_V3
+#endif
+#endif
+
+/* defines */
+#define TPACKET_DEFAULT_BLOCK_SIZE	(1 << 20) /* 1 Mb */
+#define TPACKET_DEFAULT_BLOCKS		64
+#define TPACKET_FRAME_SIZE		2048
+#define TPACKET_BLOCK_TIMEOUT		60 /* msecs */
+#define TPACKET_MAX_WORKERS		64
+
+#define TPACKET_FANOUT_HASH		0
+#define TPACKET_FANOUT_CPU		1
+
+/* structures */
+#if defined (HAVE_TPACKET_V3)
+struct tpacket_worker {
+  int id;
+  int fd;
+  struct tpacket_req3 req;
+  u_char *map;
+  struct iovec *blocks;
+  u_char *vlan_buf;
+  struct pcap_callback_data cb_data;
+  u_int64_t packets;
+  u_int64_t drops;
+  u_int64_t freezes;
+};
+#endif
+
+/* prototypes */
+#if (!defined __TPACKET_C)
+#define EXT extern
+#else
+#define EXT
+#endif
+#if defined (HAVE_TPACKET_V3)
+EXT int tpacket_workers_init(struct pcap_callback_data *, struct bpf_program *);
+EXT void tpacket_workers_stats(int);
+EXT void tpacket_worker(void *);
+EXT int tpacket_setup_socket(struct tpacket_worker *, struct bpf_program *);
+EXT void tpacket_walk_block(struct tpacket_worker *, struct tpacket_block_desc *);
+
+EXT struct tpacket_worker *tpacket_workers;
+EXT int tpacket_num_workers;
+EXT pthread_mutex_t tpacket_exec_mutex;
+#endif
+#undef EXT
@@ -450,6 +450,8 @@ int main(int argc,char **argv, char **envp)
     else Log(LOG_INFO, "INFO ( %s/core ): proc_priority set to %d\n", config.name, getpriority(PRIO_PROCESS, 0));
   }
 
+  if (config.cpu_affinity) pm_set_placement(config.cpu_affinity, config.numa_bind, config.name, "core");
+
   Log(LOG_INFO, "INFO ( %s/core ): %s (%s)\n", config.name, UACCTD_USAGE_HEADER, PMACCT_BUILD);
   Log(LOG_INFO, "INFO ( %s/core ): %s\n", config.name, PMACCT_COMPILE_ARGS);
 
@@ -895,6 +897,7 @@ int main(int argc,char **argv, char **envp)
        but in case maps are reloadable (ie. bta), it could be handy
        to keep a backup feed in memory */
     config.nfacctd_bgp_max_peers = 2;
+    config.nfacctd_bgp_max_peers_limit = 2;
 
     cb_data.f_agent = (char *)&client;
     nfacctd_bgp_wrapper();
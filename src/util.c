@@ -30,6 +30,10 @@
 #include "plugin_hooks.h"
 #include <sys/file.h>
 #include <sys/utsname.h>
+#if defined HAVE_SCHED_SETAFFINITY && defined _GNU_SOURCE
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
 
 /* functions */
 void setnonblocking(int sock)
@@ -845,6 +849,55 @@ void *map_shared(void *addr, size_t len, int prot, int flags, int fd, off_t off)
 #endif
 }
 
+/* map_hugepages(): anonymous mapping backed by 2M or 1G hugepages; length is
+   rounded up to the hugepage size and handed back via 'mlen' so that it can
+   be munmap()'ed later. If hugepages are not available (ie. none reserved
+   via vm.nr_hugepages) we fall back to regular pages and say so, unless
+   'what' is NULL (ie. repeated allocations that were already reported). */
+void *map_hugepages(size_t len, size_t *mlen, int hugepages, int flags, char *what)
+{
+  void *mem;
+
+  if (mlen) *mlen = len;
+
+  if (hugepages) {
+#if defined MAP_HUGETLB
+    size_t hp_size, hp_len;
+    int hp_flags = MAP_HUGETLB;
+
+#if !defined MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+    if (hugepages == HUGEPAGES_1G) {
+      hp_size = HUGEPAGES_1G_SIZE;
+      hp_flags |= (30 << MAP_HUGE_SHIFT);
+    }
+    else {
+      hp_size = HUGEPAGES_2M_SIZE;
+      hp_flags |= (21 << MAP_HUGE_SHIFT);
+    }
+
+    hp_len = ((len + hp_size - 1) / hp_size) * hp_size;
+    mem = mmap(0, hp_len, PROT_READ|PROT_WRITE, flags|hp_flags|MAP_ANONYMOUS, -1, 0);
+    if (mem != MAP_FAILED) {
+      if (mlen) *mlen = hp_len;
+      if (what) Log(LOG_INFO, "INFO ( %s/%s ): %s backed by %s hugepages (%llu bytes)\n", config.name, config.type,
+	  what, (hugepages == HUGEPAGES_1G ? "1G" : "2M"), (unsigned long long) hp_len);
+
+      return mem;
+    }
+
+    if (what) Log(LOG_WARNING, "WARN ( %s/%s ): unable to back %s by %s hugepages (errno: %d). Falling back to regular pages.\n",
+	config.name, config.type, what, (hugepages == HUGEPAGES_1G ? "1G" : "2M"), errno);
+#else
+    if (what) Log(LOG_WARNING, "WARN ( %s/%s ): hugepages not supported on this platform; %s backed by regular pages.\n",
+	config.name, config.type, what);
+#endif
+  }
+
+  return map_shared(0, len, PROT_READ|PROT_WRITE, flags|MAP_ANONYMOUS, -1, 0);
+}
+
 void lower_string(char *string)
 {
   int i = 0;
@@ -1064,10 +1117,10 @@ void reset_tag_label_status(struct packet_ptrs_vector *pptrsv)
   pptrsv->vlan4.tag2 = FALSE;
   pptrsv->mpls4.tag2 = FALSE;
   pptrsv->vlanmpls4.tag2 = FALSE;
-  pretag_free_label(&pptrsv->v4.label);
-  pretag_free_label(&pptrsv->vlan4.label);
-  pretag_free_label(&pptrsv->mpls4.label);
-  pretag_free_label(&pptrsv->vlanmpls4.label);
+  pretag_init_label(&pptrsv->v4.label);
+  pretag_init_label(&pptrsv->vlan4.label);
+  pretag_init_label(&pptrsv->mpls4.label);
+  pretag_init_label(&pptrsv->vlanmpls4.label);
 
 #if defined ENABLE_IPV6
   pptrsv->v6.tag = FALSE;
@@ -1078,10 +1131,10 @@ void reset_tag_label_status(struct packet_ptrs_vector *pptrsv)
   pptrsv->vlan6.tag2 = FALSE;
   pptrsv->mpls6.tag2 = FALSE;
   pptrsv->vlanmpls6.tag2 = FALSE;
-  pretag_free_label(&pptrsv->v6.label);
-  pretag_free_label(&pptrsv->vlan6.label);
-  pretag_free_label(&pptrsv->mpls6.label);
-  pretag_free_label(&pptrsv->vlanmpls6.label);
+  pretag_init_label(&pptrsv->v6.label);
+  pretag_init_label(&pptrsv->vlan6.label);
+  pretag_init_label(&pptrsv->mpls6.label);
+  pretag_init_label(&pptrsv->vlanmpls6.label);
 #endif
 }
 
@@ -1161,6 +1214,7 @@ void set_default_preferences(struct configuration *cfg)
     set_truefalse_nonzero(&cfg->nfacctd_disable_checks);
   }
   set_truefalse_nonzero(&cfg->pipe_check_core_pid);
+  set_truefalse_nonzero(&cfg->pcap_savefile_pace);
   if (!cfg->nfacctd_bgp_peer_as_src_type) cfg->nfacctd_bgp_peer_as_src_type = BGP_SRC_PRIMITIVES_KEEP;
   if (!cfg->nfacctd_bgp_src_std_comm_type) cfg->nfacctd_bgp_src_std_comm_type = BGP_SRC_PRIMITIVES_KEEP;
   if (!cfg->nfacctd_bgp_src_ext_comm_type) cfg->nfacctd_bgp_src_ext_comm_type = BGP_SRC_PRIMITIVES_KEEP;
@@ -1208,6 +1262,192 @@ void *pm_malloc(size_t size)
   return obj;
 }
 
+/* pm_malloc_hugepages(): long-lived, never free()'d, allocations (ie. plugin
+   caches) that may be backed by hugepages */
+void *pm_malloc_hugepages(size_t size, int hugepages, char *what)
+{
+  void *obj;
+
+  if (hugepages) {
+    obj = map_hugepages(size, NULL, hugepages, MAP_PRIVATE, what);
+    if (obj != MAP_FAILED) return obj;
+  }
+
+  return pm_malloc(size);
+}
+
+#if defined HAVE_SCHED_SETAFFINITY && defined _GNU_SOURCE
+static cpu_set_t pm_placement_orig_cpus;
+static int pm_placement_changed;
+
+static int pm_cpu_list_parse(char *str, cpu_set_t *set)
+{
+  char *ptr = str, *endptr;
+  long first, last;
+
+  CPU_ZERO(set);
+
+  while (*ptr) {
+    first = strtol(ptr, &endptr, 10);
+    if (endptr == ptr || first < 0) return ERR;
+    last = first;
+    ptr = endptr;
+
+    if (*ptr == '-') {
+      ptr++;
+      last = strtol(ptr, &endptr, 10);
+      if (endptr == ptr || last < first) return ERR;
+      ptr = endptr;
+    }
+
+    if (last >= CPU_SETSIZE) return ERR;
+    for (; first <= last; first++) CPU_SET(first, set);
+
+    if (*ptr == ',') ptr++;
+    else if (*ptr) return ERR;
+  }
+
+  return CPU_COUNT(set) ? SUCCESS : ERR;
+}
+
+static void pm_bitmask_print(unsigned long *mask, int bits, char *buf, int len)
+{
+  int idx, first, cur = 0, bits_per_long = (8 * sizeof(unsigned long));
+
+  buf[0] = '\0';
+
+  for (idx = 0; idx < bits; idx++) {
+    if (!(mask[idx / bits_per_long] & (1UL << (idx % bits_per_long)))) continue;
+
+    for (first = idx; (idx + 1) < bits && (mask[(idx + 1) / bits_per_long] & (1UL << ((idx + 1) % bits_per_long))); idx++);
+
+    if (first == idx) cur += snprintf(buf + cur, len - cur, "%s%d", (cur ? "," : ""), first);
+    else cur += snprintf(buf + cur, len - cur, "%s%d-%d", (cur ? "," : ""), first, idx);
+
+    if (cur >= len) break;
+  }
+
+  if (!buf[0]) strlcpy(buf, "none", len);
+}
+
+static void pm_cpu_list_print(cpu_set_t *set, char *buf, int len)
+{
+  unsigned long mask[CPU_SETSIZE / (8 * sizeof(unsigned long))];
+  int cpu, bits_per_long = (8 * sizeof(unsigned long));
+
+  memset(mask, 0, sizeof(mask));
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, set)) mask[cpu / bits_per_long] |= (1UL << (cpu % bits_per_long));
+  }
+
+  pm_bitmask_print(mask, CPU_SETSIZE, buf, len);
+}
+
+/* NUMA nodes a CPU belongs to are read from sysfs, ie. /sys/devices/system/cpu/cpuN/nodeM,
+   so to avoid depending on libnuma */
+static int pm_cpu_list_to_nodes(cpu_set_t *set, unsigned long *nodes)
+{
+  char path[SRVBUFLEN];
+  struct dirent *de;
+  DIR *dir;
+  int cpu, node, found = FALSE, bits_per_long = (8 * sizeof(unsigned long));
+
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, set)) continue;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    if (!(dir = opendir(path))) continue;
+
+    while ((de = readdir(dir))) {
+      if (!strncmp(de->d_name, "node", strlen("node")) && isdigit(de->d_name[strlen("node")])) {
+	node = atoi(de->d_name + strlen("node"));
+	if (node >= 0 && node < PM_NUMA_MAX_NODES) {
+	  nodes[node / bits_per_long] |= (1UL << (node % bits_per_long));
+	  found = TRUE;
+	}
+      }
+    }
+
+    closedir(dir);
+  }
+
+  return found;
+}
+#endif
+
+/* pm_set_placement(): pins the calling process (or thread, as Linux affinity
+   and memory policy are per-thread) to the 'cpus' list, ie. "0-3,8", and, if
+   'numa_bind' is set, binds its memory to the NUMA nodes local to those CPUs.
+   A NULL 'cpus' reverts whatever placement was inherited from the parent, ie.
+   plugins forked by a pinned core process. What was actually obtained is read
+   back and logged. */
+void pm_set_placement(char *cpus, int numa_bind, char *name, char *type)
+{
+#if defined HAVE_SCHED_SETAFFINITY && defined _GNU_SOURCE
+  unsigned long nodes[PM_NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+  char cpus_str[LONGSRVBUFLEN], nodes_str[SRVBUFLEN];
+  cpu_set_t set;
+  int mode = 0;
+
+  if (!cpus) {
+    if (pm_placement_changed) {
+      sched_setaffinity(0, sizeof(cpu_set_t), &pm_placement_orig_cpus);
+#if defined SYS_set_mempolicy
+      syscall(SYS_set_mempolicy, 0 /* MPOL_DEFAULT */, NULL, 0);
+#endif
+      pm_placement_changed = FALSE;
+    }
+
+    return;
+  }
+
+  if (pm_cpu_list_parse(cpus, &set) == ERR) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): cpu_affinity: invalid CPU list '%s'. Ignored.\n", name, type, cpus);
+    return;
+  }
+
+  if (!pm_placement_changed) sched_getaffinity(0, sizeof(cpu_set_t), &pm_placement_orig_cpus);
+
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &set)) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): cpu_affinity: unable to pin to CPUs %s (errno: %d)\n", name, type, cpus, errno);
+    return;
+  }
+  pm_placement_changed = TRUE;
+
+  if (numa_bind) {
+#if defined SYS_set_mempolicy
+    memset(nodes, 0, sizeof(nodes));
+    if (!pm_cpu_list_to_nodes(&set, nodes))
+      Log(LOG_WARNING, "WARN ( %s/%s ): numa_bind: unable to find NUMA nodes for CPUs %s\n", name, type, cpus);
+    else if (syscall(SYS_set_mempolicy, 2 /* MPOL_BIND */, nodes, PM_NUMA_MAX_NODES + 1))
+      Log(LOG_WARNING, "WARN ( %s/%s ): numa_bind: set_mempolicy() failed (errno: %d)\n", name, type, errno);
+#else
+    Log(LOG_WARNING, "WARN ( %s/%s ): numa_bind: not supported on this platform\n", name, type);
+#endif
+  }
+#if defined SYS_set_mempolicy
+  /* do not inherit the binding of a parent placed elsewhere */
+  else syscall(SYS_set_mempolicy, 0 /* MPOL_DEFAULT */, NULL, 0);
+#endif
+
+  /* reporting placement actually obtained */
+  CPU_ZERO(&set);
+  sched_getaffinity(0, sizeof(cpu_set_t), &set);
+  pm_cpu_list_print(&set, cpus_str, sizeof(cpus_str));
+
+  strlcpy(nodes_str, "any", sizeof(nodes_str));
+#if defined SYS_get_mempolicy
+  memset(nodes, 0, sizeof(nodes));
+  if (!syscall(SYS_get_mempolicy, &mode, nodes, PM_NUMA_MAX_NODES + 1, NULL, 0) && mode == 2 /* MPOL_BIND */)
+    pm_bitmask_print(nodes, PM_NUMA_MAX_NODES, nodes_str, sizeof(nodes_str));
+#endif
+
+  Log(LOG_INFO, "INFO ( %s/%s ): placement: CPUs %s, memory on NUMA nodes %s\n", name, type, cpus_str, nodes_str);
+#else
+  if (cpus) Log(LOG_WARNING, "WARN ( %s/%s ): cpu_affinity: not supported on this platform. Ignored.\n", name, type);
+#endif
+}
+
 void *pm_tsearch(const void *key, void **rootp, int (*compar)(const void *key1, const void *key2), size_t alloc_size)
 {
   void *alloc_key, *ret_key;
@@ -1694,7 +1934,7 @@ void compose_timestamp(char *buf, int buflen, struct timeval *tv, int usec, int
 {
   char tmpbuf[SRVBUFLEN];
   time_t time1;
-  struct tm *time2;
+  struct tm *time2, time_tm;
 
   if (config.timestamps_since_epoch) {
     if (usec) snprintf(buf, buflen, "%u.%u", tv->tv_sec, tv->tv_usec);
@@ -1702,7 +1942,7 @@ void compose_timestamp(char *buf, int buflen, struct timeval *tv, int usec, int
   }
   else {
     time1 = tv->tv_sec;
-    time2 = localtime(&time1);
+    time2 = localtime_r(&time1, &time_tm);
     strftime(tmpbuf, SRVBUFLEN, "%Y-%m-%d %H:%M:%S", time2);
 
     if (usec) snprintf(buf, buflen, "%s.%u", tmpbuf, tv->tv_usec);
@@ -23,6 +23,14 @@
 #define ADD 0
 #define SUB 1
 
+#define HUGEPAGES_NONE	0
+#define HUGEPAGES_2M	1
+#define HUGEPAGES_1G	2
+#define HUGEPAGES_2M_SIZE	(2*1024*1024)
+#define HUGEPAGES_1G_SIZE	(1024*1024*1024)
+
+#define PM_NUMA_MAX_NODES	1024
+
 #ifdef WITH_AVRO
 #define check_i(call) \
   do { \
@@ -62,6 +70,7 @@ EXT int sanitize_buf(char *);
 EXT void mark_columns(char *);
 EXT int Setsocksize(int, int, int, void *, int);
 EXT void *map_shared(void *, size_t, int, int, int, off_t);
+EXT void *map_hugepages(size_t, size_t *, int, int, char *);
 EXT void lower_string(char *);
 EXT void evaluate_sums(u_int64_t *, u_int64_t *, char *, char *);
 EXT void stop_all_childs();
@@ -91,6 +100,8 @@ EXT void handle_dynname_internal_strings_same(char *, int, char *, struct primit
 EXT void escape_ip_uscores(char *);
 EXT int sql_history_to_secs(int, int);
 EXT void *pm_malloc(size_t);
+EXT void *pm_malloc_hugepages(size_t, int, char *);
+EXT void pm_set_placement(char *, int, char *, char *);
 EXT void load_allow_file(char *, struct hosts_table *);
 EXT int check_allow(struct hosts_table *, struct sockaddr *);
 EXT int BTA_find_id(struct id_table *, struct packet_ptrs *, pm_id_t *, pm_id_t *);
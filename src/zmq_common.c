@@ -24,7 +24,7 @@
 /* includes */
 #include "pmacct.h"
 #include "pmacct-data.h"
-#include "zmq_common.h"
+#include "plugin_hooks.h" /* includes zmq_common.h */
 
 /* Functions */
 void p_zmq_set_topic(struct p_zmq_host *zmq_host, u_int8_t topic)
@@ -56,6 +56,15 @@ void p_zmq_set_password(struct p_zmq_host *zmq_host)
   if (zmq_host) generate_random_string(zmq_host->zap.password, (sizeof(zmq_host->zap.password) - 1));
 }
 
+/* export/import ends share credentials, as neither can pass them to the other */
+void p_zmq_set_secret(struct p_zmq_host *zmq_host, char *secret)
+{
+  if (zmq_host && secret) {
+    strlcpy(zmq_host->zap.username, "pmacct", sizeof(zmq_host->zap.username));
+    strlcpy(zmq_host->zap.password, secret, sizeof(zmq_host->zap.password));
+  }
+}
+
 int p_zmq_get_fd(struct p_zmq_host *zmq_host)
 {
   int fd = ERR;
@@ -169,7 +178,9 @@ void p_zmq_plugin_pipe_publish(struct p_zmq_host *zmq_host)
     exit(1);
   }
 
-  ret = zmq_bind(zmq_host->sock, "tcp://127.0.0.1:*");
+  if (zmq_host->remote) ret = zmq_bind(zmq_host->sock, zmq_host->remote);
+  else ret = zmq_bind(zmq_host->sock, (zmq_host->ipc ? "ipc://*" : "tcp://127.0.0.1:*"));
+
   if (ret == ERR) {
     Log(LOG_ERR, "ERROR ( %s/%s ): zmq_bind() failed for topic %u: %s\nExiting.\n",
 	config.name, config.type, zmq_host->topic, zmq_strerror(errno));
@@ -214,6 +225,32 @@ void p_zmq_plugin_pipe_consume(struct p_zmq_host *zmq_host)
     exit_plugin(1);
   }
 
+  if (zmq_host->import) {
+    char remote[SRVBUFLEN], *token, *saveptr = NULL;
+
+    /* remote ends each publish a single plugin: all topics are taken */
+    strlcpy(remote, zmq_host->remote, sizeof(remote));
+    for (token = strtok_r(remote, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+      trim_spaces(token);
+
+      ret = zmq_connect(zmq_host->sock, token);
+      if (ret == ERR) {
+        Log(LOG_ERR, "ERROR ( %s/%s ): zmq_connect() failed: %s (%s)\nExiting.\n",
+	    config.name, config.type, token, zmq_strerror(errno));
+        exit_plugin(1);
+      }
+    }
+
+    ret = zmq_setsockopt(zmq_host->sock, ZMQ_SUBSCRIBE, "", 0);
+    if (ret == ERR) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): zmq_setsockopt() SUBSCRIBE failed: %s\nExiting.\n",
+          config.name, config.type, zmq_strerror(errno));
+      exit_plugin(1);
+    }
+
+    return;
+  }
+
   ret = zmq_connect(zmq_host->sock, zmq_host->bind_str);
   if (ret == ERR) {
     Log(LOG_ERR, "ERROR ( %s/%s ): zmq_connect() failed: %s (%s)\nExiting.\n",
@@ -229,10 +266,60 @@ void p_zmq_plugin_pipe_consume(struct p_zmq_host *zmq_host)
   }
 }
 
+/*
+  Zero-copy: the ring slot itself is handed to ZMQ; its flag is set until
+  the I/O thread is done with it and calls back here.
+*/
+static void p_zmq_plugin_pipe_release(void *data, void *hint)
+{
+  volatile u_int8_t *inflight = hint;
+
+  (*inflight) = FALSE;
+}
+
+void p_zmq_plugin_pipe_set_zerocopy(struct p_zmq_host *zmq_host, char *ring_base, u_int64_t slot_size, u_int32_t slots)
+{
+  if (!zmq_host || !ring_base || !slot_size || !slots) return;
+
+  zmq_host->ring_inflight = calloc(slots, sizeof(u_int8_t));
+  if (!zmq_host->ring_inflight) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): p_zmq_plugin_pipe_set_zerocopy(): calloc() failed. Zero-copy disabled.\n", config.name, config.type);
+    return;
+  }
+
+  zmq_host->ring_base = ring_base;
+  zmq_host->ring_slot_size = slot_size;
+  zmq_host->ring_slots = slots;
+}
+
+static int p_zmq_plugin_pipe_slot(struct p_zmq_host *zmq_host, void *buf, u_int32_t *slot)
+{
+  char *ptr = buf;
+
+  if (!zmq_host->ring_inflight || ptr < zmq_host->ring_base) return FALSE;
+
+  (*slot) = ((ptr - zmq_host->ring_base) / zmq_host->ring_slot_size);
+  if ((*slot) >= zmq_host->ring_slots) return FALSE;
+
+  return TRUE;
+}
+
+/* to be called before a ring slot is written again */
+void p_zmq_plugin_pipe_wait(struct p_zmq_host *zmq_host, void *buf)
+{
+  u_int32_t slot;
+
+  if (!zmq_host || !p_zmq_plugin_pipe_slot(zmq_host, buf, &slot)) return;
+
+  /* the subscriber is a full ring behind: back-pressure the core */
+  while (zmq_host->ring_inflight[slot]) usleep(100);
+}
+
 int p_zmq_plugin_pipe_send(struct p_zmq_host *zmq_host, void *buf, u_int64_t len)
 {
-  zmq_msg_t topic, msg;
-  int ret;
+  zmq_msg_t msg;
+  u_int32_t slot;
+  int ret, compressed = FALSE;
 
   ret = zmq_send(zmq_host->sock, &zmq_host->topic, sizeof(zmq_host->topic), ZMQ_SNDMORE);
   if (ret == ERR) {
@@ -241,7 +328,40 @@ int p_zmq_plugin_pipe_send(struct p_zmq_host *zmq_host, void *buf, u_int64_t len
     return ret;
   }
 
-  ret = zmq_send(zmq_host->sock, buf, len, 0);
+#if defined (HAVE_ZLIB)
+  /* buffer header is left as-is; payload is sent compressed only if it pays off */
+  if (zmq_host->compress && len > ChBufHdrSz) {
+    uLongf zlen = compressBound(len - ChBufHdrSz);
+
+    if ((ChBufHdrSz + zlen) > zmq_host->zbuf_len) {
+      char *zbuf = realloc(zmq_host->zbuf, (ChBufHdrSz + zlen));
+
+      if (zbuf) {
+	zmq_host->zbuf = zbuf;
+	zmq_host->zbuf_len = (ChBufHdrSz + zlen);
+      }
+    }
+
+    zlen = (zmq_host->zbuf_len - ChBufHdrSz);
+    if (zmq_host->zbuf && compress2((Bytef *)(zmq_host->zbuf + ChBufHdrSz), &zlen, (Bytef *)((char *)buf + ChBufHdrSz),
+		(len - ChBufHdrSz), Z_BEST_SPEED) == Z_OK && (ChBufHdrSz + zlen) < len) {
+      memcpy(zmq_host->zbuf, buf, ChBufHdrSz);
+      buf = zmq_host->zbuf;
+      len = (ChBufHdrSz + zlen);
+      compressed = TRUE;
+    }
+  }
+#endif
+
+  if (!compressed && p_zmq_plugin_pipe_slot(zmq_host, buf, &slot)) {
+    zmq_host->ring_inflight[slot] = TRUE;
+    zmq_msg_init_data(&msg, buf, len, p_zmq_plugin_pipe_release, (void *) &zmq_host->ring_inflight[slot]);
+
+    ret = zmq_msg_send(&msg, zmq_host->sock, 0);
+    if (ret == ERR) zmq_msg_close(&msg);
+  }
+  else ret = zmq_send(zmq_host->sock, buf, len, 0);
+
   if (ret == ERR) {
     Log(LOG_ERR, "ERROR ( %s/%s ): publishing data to ZMQ: p_zmq_send(): %s [topic=%u]\n",
 		config.name, config.type, zmq_strerror(errno), zmq_host->topic);
@@ -254,8 +374,10 @@ int p_zmq_plugin_pipe_send(struct p_zmq_host *zmq_host, void *buf, u_int64_t len
 int p_zmq_plugin_pipe_recv(struct p_zmq_host *zmq_host, void *buf, u_int64_t len)
 {
   int ret = 0, events;
-  size_t elen = sizeof(events);
+  size_t elen = sizeof(events), msglen;
   u_int8_t topic;
+  zmq_msg_t msg;
+  char *data;
 
   zmq_getsockopt(zmq_host->sock, ZMQ_EVENTS, &events, &elen); 
 
@@ -267,15 +389,59 @@ int p_zmq_plugin_pipe_recv(struct p_zmq_host *zmq_host, void *buf, u_int64_t len
       return ret;
     }
 
-    ret = zmq_recv(zmq_host->sock, buf, len, 0); /* read actual data then */
-    if (ret == ERR)
+    /* read actual data then */
+    zmq_msg_init(&msg);
+    ret = zmq_msg_recv(&msg, zmq_host->sock, 0);
+    if (ret == ERR) {
       Log(LOG_ERR, "ERROR ( %s/%s ): consuming data from ZMQ: p_zmq_recv(): %s [topic=%u]\n",
 		config.name, config.type, zmq_strerror(errno), zmq_host->topic);
-    else if (ret > len) {
+      zmq_msg_close(&msg);
+      return ret;
+    }
+
+    data = zmq_msg_data(&msg);
+    msglen = zmq_msg_size(&msg);
+
+    if (msglen > len) {
       Log(LOG_ERR, "ERROR ( %s/%s ): consuming data from ZMQ: p_zmq_recv(): buffer overrun [topic=%u]\n",
 		config.name, config.type, zmq_host->topic);
       ret = ERR;
     }
+    /* compressed payloads are told apart by not matching the committed length,
+       whatever the local setting: the sender may be on a different host */
+    else if (msglen > ChBufHdrSz && msglen != (ChBufHdrSz + ((struct ch_buf_hdr *)data)->len)) {
+#if defined (HAVE_ZLIB)
+      uLongf dlen = (len - ChBufHdrSz);
+
+      memcpy(buf, data, ChBufHdrSz);
+      if (uncompress((Bytef *)((char *)buf + ChBufHdrSz), &dlen, (Bytef *)(data + ChBufHdrSz), (msglen - ChBufHdrSz)) != Z_OK) {
+	Log(LOG_ERR, "ERROR ( %s/%s ): consuming data from ZMQ: p_zmq_recv(): uncompress() failed [topic=%u]\n",
+		config.name, config.type, zmq_host->topic);
+	ret = ERR;
+      }
+      else ret = (ChBufHdrSz + dlen);
+#else
+      Log(LOG_ERR, "ERROR ( %s/%s ): consuming data from ZMQ: p_zmq_recv(): compressed buffer but no zlib support [topic=%u]\n",
+		config.name, config.type, zmq_host->topic);
+      ret = ERR;
+#endif
+    }
+    else {
+      memcpy(buf, data, msglen);
+      ret = msglen;
+    }
+
+    zmq_msg_close(&msg);
+
+    /*
+      Buffers from several remote ends interleave: sequencing is made local
+      here, so that plugins don't warn about missing data (ZMQ queues are
+      configured not to drop anyway).
+    */
+    if (ret > 0 && zmq_host->import) {
+      ((struct ch_buf_hdr *)buf)->seq = zmq_host->import_seq;
+      zmq_host->import_seq = ((zmq_host->import_seq + 1) % MAX_SEQNUM);
+    }
   }
 
   return ret;
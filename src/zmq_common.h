@@ -49,6 +49,22 @@ struct p_zmq_host {
 
   char bind_str[SHORTBUFLEN];
   u_int8_t topic;
+
+  u_int8_t ipc;			/* bind ipc:// rather than tcp://127.0.0.1 */
+  u_int8_t compress;		/* deflate buffer payloads */
+  char *zbuf;			/* compressed buffer, sent by copy */
+  u_int64_t zbuf_len;
+
+  /* zero-copy: ring slots are handed to ZMQ and held until released */
+  char *ring_base;
+  u_int64_t ring_slot_size;
+  u_int32_t ring_slots;
+  volatile u_int8_t *ring_inflight;
+
+  /* distributed: export binds remote, import connects to it (comma-separated list) */
+  char *remote;
+  u_int8_t import;
+  u_int32_t import_seq;
 };
 
 /* prototypes */
@@ -61,6 +77,7 @@ EXT void p_zmq_set_topic(struct p_zmq_host *, u_int8_t);
 EXT void p_zmq_set_retry_timeout(struct p_zmq_host *, int);
 EXT void p_zmq_set_username(struct p_zmq_host *);
 EXT void p_zmq_set_password(struct p_zmq_host *);
+EXT void p_zmq_set_secret(struct p_zmq_host *, char *);
 
 EXT int p_zmq_get_fd(struct p_zmq_host *);
 
@@ -71,6 +88,8 @@ EXT void p_zmq_plugin_pipe_publish(struct p_zmq_host *);
 EXT void p_zmq_plugin_pipe_consume(struct p_zmq_host *);
 EXT int p_zmq_plugin_pipe_recv(struct p_zmq_host *, void *, u_int64_t);
 EXT int p_zmq_plugin_pipe_send(struct p_zmq_host *, void *, u_int64_t);
+EXT void p_zmq_plugin_pipe_set_zerocopy(struct p_zmq_host *, char *, u_int64_t, u_int32_t);
+EXT void p_zmq_plugin_pipe_wait(struct p_zmq_host *, void *);
 
 EXT char *p_zmq_recv_str(void *);
 EXT int p_zmq_send_str(void *, char *);